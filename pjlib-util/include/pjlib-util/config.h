@@ -211,6 +211,28 @@
 #endif
 
 
+/**
+ * Macro PJ_SCANNER_USE_SIMD is defined and non-zero will enable the use
+ * of SSE2 (x86) or NEON (AArch64) instructions to search for terminating
+ * characters, such as newline and quote, sixteen characters at a time.
+ * Character specifications are matched sixteen characters at a time too,
+ * using a nibble lookup table with SSSE3 (x86, selected at run-time
+ * unless the compiler already targets it) or NEON. The scanner falls
+ * back to plain C when the instruction set is not available.
+ *
+ * Default: 1 if the compiler targets SSE2 or AArch64 NEON, otherwise 0.
+ */
+#ifndef PJ_SCANNER_USE_SIMD
+#  if defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+      (defined(__aarch64__) && defined(__ARM_NEON))
+#    define PJ_SCANNER_USE_SIMD		    1
+#  else
+#    define PJ_SCANNER_USE_SIMD		    0
+#  endif
+#endif
+
+
 
 /* **************************************************************************
  * STUN CLIENT CONFIGURATION
@@ -188,6 +188,18 @@ struct pj_scanner;
 typedef void (*pj_syn_err_func_ptr)(struct pj_scanner *scanner);
 
 
+/**
+ * This structure can be used by application to store the state of the parser,
+ * so that the scanner state can be rollback to this state when necessary.
+ */
+typedef struct pj_scan_state
+{
+    char *curptr;       /**< Current scanner's pointer. */
+    int   line;         /**< Current line.		*/
+    char *start_line;   /**< Start of current line.	*/
+} pj_scan_state;
+
+
 /**
  * The text scanner structure.
  */
@@ -200,21 +212,11 @@ typedef struct pj_scanner
     char *start_line;   /**< Where current line starts.	*/
     int   skip_ws;      /**< Skip whitespace flag.	*/
     pj_syn_err_func_ptr callback;   /**< Syntax error callback. */
+    pj_bool_t has_err;  /**< Syntax error has been recorded.	*/
+    pj_scan_state err_state;	    /**< Where the error was recorded. */
 } pj_scanner;
 
 
-/**
- * This structure can be used by application to store the state of the parser,
- * so that the scanner state can be rollback to this state when necessary.
- */
-typedef struct pj_scan_state
-{
-    char *curptr;       /**< Current scanner's pointer. */
-    int   line;         /**< Current line.		*/
-    char *start_line;   /**< Start of current line.	*/
-} pj_scan_state;
-
-
 /**
  * Initialize the scanner. Note that the input string buffer must have
  * length at least buflen+1 because the scanner will NULL terminate the
@@ -229,7 +231,9 @@ typedef struct pj_scan_state
  * @param options   Zero, or combination of PJ_SCAN_AUTOSKIP_WS or
  *		    PJ_SCAN_AUTOSKIP_WS_HEADER
  * @param callback  Callback to be called when the scanner encounters syntax
- *		    error condition.
+ *		    error condition. If NULL, the scanner records the error
+ *		    instead (see #pj_scan_has_err()), so that the input can
+ *		    be scanned without using exception.
  */
 PJ_DECL(void) pj_scan_init( pj_scanner *scanner, char *bufstart, 
 			    pj_size_t buflen, 
@@ -245,6 +249,43 @@ PJ_DECL(void) pj_scan_init( pj_scanner *scanner, char *bufstart,
 PJ_DECL(void) pj_scan_fini( pj_scanner *scanner );
 
 
+/**
+ * Report syntax error to the scanner. If the scanner has a syntax error
+ * callback, the callback will be called (which normally throws exception).
+ * Otherwise the error is recorded in the scanner, and the scanner is moved
+ * to EOF so that subsequent scanning stops immediately. Only the first
+ * error is recorded.
+ *
+ * @param scanner   The scanner.
+ */
+PJ_DECL(void) pj_scan_syntax_err( pj_scanner *scanner );
+
+
+/**
+ * Determine whether syntax error has been recorded by the scanner. This is
+ * only applicable when the scanner was initialized without syntax error
+ * callback.
+ *
+ * @param scanner   The scanner.
+ *
+ * @return	    Non-zero if syntax error has been encountered.
+ */
+PJ_INLINE(pj_bool_t) pj_scan_has_err( const pj_scanner *scanner )
+{
+    return scanner->has_err;
+}
+
+
+/**
+ * Clear the syntax error that was recorded by the scanner, and move the
+ * scanner back to the position where the error was encountered, e.g. so
+ * that application can resume scanning from the next line.
+ *
+ * @param scanner   The scanner.
+ */
+PJ_DECL(void) pj_scan_clear_err( pj_scanner *scanner );
+
+
 /** 
  * Determine whether the EOF condition for the scanner has been met.
  *
@@ -60,6 +60,9 @@ typedef struct pj_cis_t
 {
     pj_cis_elem_t   *cis_buf;       /**< Pointer to buffer.     */
     int              cis_id;        /**< Id.                    */
+    pj_uint8_t       nib_lo[16];    /**< Low nibble classifier. */
+    pj_uint8_t       nib_hi[16];    /**< High nibble classifier.*/
+    pj_bool_t        nib_ok;        /**< Classifier is valid.   */
 } pj_cis_t;
 
 
@@ -70,7 +73,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character.
  */
-#define PJ_CIS_SET(cis,c)   ((cis)->cis_buf[(int)(c)] |= (1 << (cis)->cis_id))
+#define PJ_CIS_SET(cis,c)   ((cis)->cis_buf[(int)(c)] |= (1 << (cis)->cis_id), \
+			     (cis)->nib_ok = PJ_FALSE)
 
 /**
  * Remove the membership of the specified character.
@@ -79,7 +83,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character to be removed from the membership.
  */
-#define PJ_CIS_CLR(cis,c)   ((cis)->cis_buf[(int)c] &= ~(1 << (cis)->cis_id))
+#define PJ_CIS_CLR(cis,c)   ((cis)->cis_buf[(int)c] &= ~(1 << (cis)->cis_id), \
+			     (cis)->nib_ok = PJ_FALSE)
 
 /**
  * Check the membership of the specified character.
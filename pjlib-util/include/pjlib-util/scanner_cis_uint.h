@@ -47,6 +47,9 @@ typedef int pj_cis_buf_t;
 typedef struct pj_cis_t
 {
     PJ_CIS_ELEM_TYPE	cis_buf[256];	/**< Internal buffer.	*/
+    pj_uint8_t		nib_lo[16];	/**< Low nibble classifier.*/
+    pj_uint8_t		nib_hi[16];	/**< High nibble classifier.*/
+    pj_bool_t		nib_ok;		/**< Classifier is valid.	*/
 } pj_cis_t;
 
 
@@ -57,7 +60,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character.
  */
-#define PJ_CIS_SET(cis,c)   ((cis)->cis_buf[(int)(c)] = 1)
+#define PJ_CIS_SET(cis,c)   ((cis)->cis_buf[(int)(c)] = 1, \
+			     (cis)->nib_ok = PJ_FALSE)
 
 /**
  * Remove the membership of the specified character.
@@ -66,7 +70,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character to be removed from the membership.
  */
-#define PJ_CIS_CLR(cis,c)   ((cis)->cis_buf[(int)c] = 0)
+#define PJ_CIS_CLR(cis,c)   ((cis)->cis_buf[(int)c] = 0, \
+			     (cis)->nib_ok = PJ_FALSE)
 
 /**
  * Check the membership of the specified character.
@@ -31,16 +31,318 @@
 #define PJ_SCAN_CHECK_EOF(s)		(s != scanner->end)
 
 
+static void cis_update_classifier(pj_cis_t *cis);
+
 #if defined(PJ_SCANNER_USE_BITWISE) && PJ_SCANNER_USE_BITWISE != 0
 #  include "scanner_cis_bitwise.c"
 #else
 #  include "scanner_cis_uint.c"
 #endif
 
+#if defined(PJ_SCANNER_USE_SIMD) && PJ_SCANNER_USE_SIMD != 0
+#  if defined(__aarch64__)
+#    include <arm_neon.h>
+#    define USE_NEON			1
+#  else
+#    include <emmintrin.h>
+#    define USE_SSE2			1
+#  endif
+#endif
+
+/* The character class classifier needs SSSE3 (pshufb) on x86. It is used
+ * directly when the compiler targets SSSE3, otherwise GCC and Clang build
+ * it as a separate function and select it at run-time.
+ */
+#if defined(USE_SSE2)
+#  if defined(__SSSE3__) || defined(__AVX__)
+#    include <tmmintrin.h>
+#    define USE_SSSE3			1
+#    define SSSE3_TARGET
+#  elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    include <tmmintrin.h>
+#    define USE_SSSE3			1
+#    define SSSE3_RUNTIME		1
+#    define SSSE3_TARGET		__attribute__((target("ssse3")))
+#  endif
+#endif
+
+/* Maximum number of characters that find_chr() can search at once. */
+#define FIND_CHR_MAX			4
+
+
+#if defined(USE_SSE2)
+/* Get the index of the lowest bit that is set in a non-zero mask. */
+static unsigned first_bit(unsigned mask)
+{
+#  if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(mask);
+#  else
+    unsigned i = 0;
+    while ((mask & 1) == 0) {
+	mask >>= 1;
+	++i;
+    }
+    return i;
+#  endif
+}
+#endif
+
+/*
+ * Find the first occurrence of any of the characters in chars (there are
+ * cnt of them, up to FIND_CHR_MAX) in [s, end). Sixteen characters are
+ * tested at a time when SIMD is enabled. Returns end if none is found.
+ */
+static char *find_chr(const char *s, const char *end,
+		      const char *chars, unsigned cnt)
+{
+    char c0 = chars[0];
+    char c1 = chars[cnt > 1 ? 1 : 0];
+    char c2 = chars[cnt > 2 ? 2 : 0];
+    char c3 = chars[cnt > 3 ? 3 : 0];
+
+    pj_assert(cnt > 0 && cnt <= FIND_CHR_MAX);
+
+#if defined(USE_SSE2)
+    if (end - s >= 16) {
+	__m128i v0 = _mm_set1_epi8(c0);
+	__m128i v1 = _mm_set1_epi8(c1);
+	__m128i v2 = _mm_set1_epi8(c2);
+	__m128i v3 = _mm_set1_epi8(c3);
+
+	do {
+	    __m128i v = _mm_loadu_si128((const __m128i*)s);
+	    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, v0),
+						  _mm_cmpeq_epi8(v, v1)),
+				     _mm_or_si128(_mm_cmpeq_epi8(v, v2),
+						  _mm_cmpeq_epi8(v, v3)));
+	    unsigned mask = (unsigned)_mm_movemask_epi8(m);
+
+	    if (mask)
+		return (char*)s + first_bit(mask);
+	    s += 16;
+	} while (end - s >= 16);
+    }
+#elif defined(USE_NEON)
+    if (end - s >= 16) {
+	uint8x16_t v0 = vdupq_n_u8((pj_uint8_t)c0);
+	uint8x16_t v1 = vdupq_n_u8((pj_uint8_t)c1);
+	uint8x16_t v2 = vdupq_n_u8((pj_uint8_t)c2);
+	uint8x16_t v3 = vdupq_n_u8((pj_uint8_t)c3);
+
+	do {
+	    uint8x16_t v = vld1q_u8((const pj_uint8_t*)s);
+	    uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, v0),
+					     vceqq_u8(v, v1)),
+				    vorrq_u8(vceqq_u8(v, v2),
+					     vceqq_u8(v, v3)));
+
+	    /* The exact position is located by the loop below */
+	    if (vmaxvq_u8(m))
+		break;
+	    s += 16;
+	} while (end - s >= 16);
+    }
+#endif
+
+    while (s != end && *s != c0 && *s != c1 && *s != c2 && *s != c3)
+	++s;
+
+    return (char*)s;
+}
+
+/*
+ * Build the nibble classifier of the spec, so that character c matches
+ * iff (nib_lo[c & 15] & nib_hi[c >> 4]) is non-zero. Each distinct set
+ * of low nibbles that occurs under some high nibble gets one bit, hence
+ * the classifier is only usable when there are at most eight of them.
+ */
+static void cis_update_classifier(pj_cis_t *cis)
+{
+    pj_uint16_t rows[16];
+    pj_uint16_t groups[8];
+    unsigned i, j, group_cnt = 0;
+
+    cis->nib_ok = PJ_FALSE;
+    pj_bzero(cis->nib_lo, sizeof(cis->nib_lo));
+    pj_bzero(cis->nib_hi, sizeof(cis->nib_hi));
+
+    for (i=0; i<16; ++i) {
+	rows[i] = 0;
+	for (j=0; j<16; ++j) {
+	    if (PJ_CIS_ISSET(cis, (i << 4) | j))
+		rows[i] |= (pj_uint16_t)(1 << j);
+	}
+    }
+
+    for (i=0; i<16; ++i) {
+	if (rows[i] == 0)
+	    continue;
+
+	for (j=0; j<group_cnt && groups[j] != rows[i]; ++j)
+	    ;
+	if (j == group_cnt) {
+	    if (group_cnt == PJ_ARRAY_SIZE(groups))
+		return;
+	    groups[group_cnt++] = rows[i];
+	}
+	cis->nib_hi[i] = (pj_uint8_t)(1 << j);
+    }
+
+    for (j=0; j<group_cnt; ++j) {
+	for (i=0; i<16; ++i) {
+	    if (groups[j] & (1 << i))
+		cis->nib_lo[i] |= (pj_uint8_t)(1 << j);
+	}
+    }
+
+    cis->nib_ok = PJ_TRUE;
+}
+
+#if defined(SSSE3_RUNTIME)
+static pj_bool_t cpu_has_ssse3(void)
+{
+    static int has_ssse3 = -1;
+
+    if (has_ssse3 < 0) {
+	__builtin_cpu_init();
+	has_ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+    }
+    return has_ssse3;
+}
+#endif
+
+#if defined(USE_SSSE3)
+static SSSE3_TARGET const char *cis_span_ssse3(const pj_cis_t *spec,
+					       const char *s,
+					       const char *end,
+					       pj_bool_t stop_on_match)
+{
+    __m128i lo_tbl = _mm_loadu_si128((const __m128i*)spec->nib_lo);
+    __m128i hi_tbl = _mm_loadu_si128((const __m128i*)spec->nib_hi);
+    __m128i nib_mask = _mm_set1_epi8(0x0f);
+    __m128i zero = _mm_setzero_si128();
+    unsigned stop_mask = stop_on_match ? 0xFFFF : 0;
+
+    do {
+	__m128i v = _mm_loadu_si128((const __m128i*)s);
+	__m128i lo = _mm_shuffle_epi8(lo_tbl, _mm_and_si128(v, nib_mask));
+	__m128i hi = _mm_shuffle_epi8(hi_tbl,
+				      _mm_and_si128(_mm_srli_epi16(v, 4),
+						    nib_mask));
+	__m128i no_match = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero);
+	unsigned mask = (unsigned)_mm_movemask_epi8(no_match) ^ stop_mask;
+
+	if (mask)
+	    return s + first_bit(mask);
+	s += 16;
+    } while (end - s >= 16);
+
+    return s;
+}
+#elif defined(USE_NEON)
+static const char *cis_span_neon(const pj_cis_t *spec, const char *s,
+				 const char *end, pj_bool_t stop_on_match)
+{
+    uint8x16_t lo_tbl = vld1q_u8(spec->nib_lo);
+    uint8x16_t hi_tbl = vld1q_u8(spec->nib_hi);
+    uint8x16_t nib_mask = vdupq_n_u8(0x0f);
+    uint8x16_t stop_mask = vdupq_n_u8(stop_on_match ? 0xFF : 0);
+
+    do {
+	uint8x16_t v = vld1q_u8((const pj_uint8_t*)s);
+	uint8x16_t lo = vqtbl1q_u8(lo_tbl, vandq_u8(v, nib_mask));
+	uint8x16_t hi = vqtbl1q_u8(hi_tbl, vshrq_n_u8(v, 4));
+	uint8x16_t no_match = vceqq_u8(vandq_u8(lo, hi), vdupq_n_u8(0));
+
+	/* The exact position is located by the caller's scalar loop */
+	if (vmaxvq_u8(veorq_u8(no_match, stop_mask)))
+	    break;
+	s += 16;
+    } while (end - s >= 16);
+
+    return s;
+}
+#endif
+
+/*
+ * Skip sixteen characters at a time while they all match the spec (or,
+ * when stop_on_match is set, while none of them matches), using the
+ * nibble classifier. Returns the position where the scalar loop should
+ * continue.
+ */
+static const char *cis_span_simd(const pj_cis_t *spec, const char *s,
+				 const char *end, pj_bool_t stop_on_match)
+{
+    if (!spec->nib_ok || end - s < 16)
+	return s;
+
+#if defined(USE_SSSE3)
+#  if defined(SSSE3_RUNTIME)
+    if (!cpu_has_ssse3())
+	return s;
+#  endif
+    return cis_span_ssse3(spec, s, end, stop_on_match);
+#elif defined(USE_NEON)
+    return cis_span_neon(spec, s, end, stop_on_match);
+#else
+    PJ_UNUSED_ARG(stop_on_match);
+    return s;
+#endif
+}
+
+/*
+ * Skip characters that match the spec, starting from s. The vector loop
+ * stays within end, and the scalar loop relies on the buffer being NULL
+ * terminated and pj_cis_match(spec,0) being false.
+ */
+static char *cis_span(const pj_cis_t *spec, const char *s, const char *end)
+{
+    s = cis_span_simd(spec, s, end, PJ_FALSE);
+
+    while (pj_cis_match(spec, *s))
+	++s;
+
+    return (char*)s;
+}
 
-static void pj_scan_syntax_err(pj_scanner *scanner)
+/*
+ * Skip characters that don't match the spec, starting from s until end.
+ */
+static char *cis_span_not(const pj_cis_t *spec, const char *s,
+			  const char *end)
 {
-    (*scanner->callback)(scanner);
+    s = cis_span_simd(spec, s, end, PJ_TRUE);
+
+    while (s != end && !pj_cis_match(spec, *s))
+	++s;
+
+    return (char*)s;
+}
+
+
+PJ_DEF(void) pj_scan_syntax_err( pj_scanner *scanner )
+{
+    if (scanner->callback) {
+	(*scanner->callback)(scanner);
+	return;
+    }
+
+    /* No callback, record the first error and stop scanning. The buffer
+     * is NULL terminated, so the scanner at EOF is safe to peek.
+     */
+    if (!scanner->has_err) {
+	scanner->has_err = PJ_TRUE;
+	pj_scan_save_state(scanner, &scanner->err_state);
+    }
+    scanner->curptr = scanner->end;
+}
+
+PJ_DEF(void) pj_scan_clear_err( pj_scanner *scanner )
+{
+    if (scanner->has_err) {
+	pj_scan_restore_state(scanner, &scanner->err_state);
+	scanner->has_err = PJ_FALSE;
+    }
 }
 
 
@@ -53,6 +355,7 @@ PJ_DEF(void) pj_cis_add_range(pj_cis_t *cis, int cstart, int cend)
         PJ_CIS_SET(cis, cstart);
 	++cstart;
     }
+    cis_update_classifier(cis);
 }
 
 PJ_DEF(void) pj_cis_add_alpha(pj_cis_t *cis)
@@ -72,6 +375,7 @@ PJ_DEF(void) pj_cis_add_str( pj_cis_t *cis, const char *str)
         PJ_CIS_SET(cis, *str);
 	++str;
     }
+    cis_update_classifier(cis);
 }
 
 PJ_DEF(void) pj_cis_add_cis( pj_cis_t *cis, const pj_cis_t *rhs)
@@ -81,6 +385,7 @@ PJ_DEF(void) pj_cis_add_cis( pj_cis_t *cis, const pj_cis_t *rhs)
 	if (PJ_CIS_ISSET(rhs, i))
 	    PJ_CIS_SET(cis, i);
     }
+    cis_update_classifier(cis);
 }
 
 PJ_DEF(void) pj_cis_del_range( pj_cis_t *cis, int cstart, int cend)
@@ -89,6 +394,7 @@ PJ_DEF(void) pj_cis_del_range( pj_cis_t *cis, int cstart, int cend)
         PJ_CIS_CLR(cis, cstart);
         cstart++;
     }
+    cis_update_classifier(cis);
 }
 
 PJ_DEF(void) pj_cis_del_str( pj_cis_t *cis, const char *str)
@@ -97,6 +403,7 @@ PJ_DEF(void) pj_cis_del_str( pj_cis_t *cis, const char *str)
         PJ_CIS_CLR(cis, *str);
 	++str;
     }
+    cis_update_classifier(cis);
 }
 
 PJ_DEF(void) pj_cis_invert( pj_cis_t *cis )
@@ -109,6 +416,7 @@ PJ_DEF(void) pj_cis_invert( pj_cis_t *cis )
         else
             PJ_CIS_SET(cis,i);
     }
+    cis_update_classifier(cis);
 }
 
 PJ_DEF(void) pj_scan_init( pj_scanner *scanner, char *bufstart, 
@@ -123,6 +431,7 @@ PJ_DEF(void) pj_scan_init( pj_scanner *scanner, char *bufstart,
     scanner->start_line = scanner->begin;
     scanner->callback = callback;
     scanner->skip_ws = options;
+    scanner->has_err = PJ_FALSE;
 
     if (scanner->skip_ws) 
 	pj_scan_skip_whitespace(scanner);
@@ -208,12 +517,12 @@ PJ_DEF(int) pj_scan_peek( pj_scanner *scanner,
 
     if (s >= scanner->end) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return -1;
     }
 
     /* Don't need to check EOF with PJ_SCAN_CHECK_EOF(s) */
-    while (pj_cis_match(spec, *s))
-	++s;
+    s = cis_span(spec, s, scanner->end);
 
     pj_strset3(out, scanner->curptr, s);
     return *s;
@@ -227,6 +536,7 @@ PJ_DEF(int) pj_scan_peek_n( pj_scanner *scanner,
 
     if (endpos > scanner->end) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return -1;
     }
 
@@ -243,11 +553,11 @@ PJ_DEF(int) pj_scan_peek_until( pj_scanner *scanner,
 
     if (s >= scanner->end) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return -1;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && !pj_cis_match( spec, *s))
-	++s;
+    s = cis_span_not(spec, s, scanner->end);
 
     pj_strset3(out, scanner->curptr, s);
     return *s;
@@ -264,12 +574,11 @@ PJ_DEF(void) pj_scan_get( pj_scanner *scanner,
     /* EOF is detected implicitly */
     if (!pj_cis_match(spec, *s)) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return;
     }
 
-    do {
-	++s;
-    } while (pj_cis_match(spec, *s));
+    s = cis_span(spec, s+1, scanner->end);
     /* No need to check EOF here (PJ_SCAN_CHECK_EOF(s)) because
      * buffer is NULL terminated and pj_cis_match(spec,0) should be
      * false.
@@ -299,6 +608,7 @@ PJ_DEF(void) pj_scan_get_unescape( pj_scanner *scanner,
     /* EOF is detected implicitly */
     if (!pj_cis_match(spec, *s) && *s != '%') {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return;
     }
 
@@ -321,9 +631,7 @@ PJ_DEF(void) pj_scan_get_unescape( pj_scanner *scanner,
 	
 	if (pj_cis_match(spec, *s)) {
 	    char *start = s;
-	    do {
-		++s;
-	    } while (pj_cis_match(spec, *s));
+	    s = cis_span(spec, s+1, scanner->end);
 
 	    if (dst != start) pj_memmove(dst, start, s-start);
 	    dst += (s-start);
@@ -354,6 +662,7 @@ PJ_DEF(void) pj_scan_get_quotes(pj_scanner *scanner,
                                 int qsize, pj_str_t *out)
 {
     register char *s = scanner->curptr;
+    char stop_chr[2];
     int qpair = -1;
     int i;
 
@@ -368,17 +677,19 @@ PJ_DEF(void) pj_scan_get_quotes(pj_scanner *scanner,
     }
     if (qpair == -1) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return;
     }
     ++s;
 
+    stop_chr[0] = '\n';
+    stop_chr[1] = end_quote[qpair];
+
     /* Loop until end_quote is found. 
      */
     do {
 	/* loop until end_quote is found. */
-	while (PJ_SCAN_CHECK_EOF(s) && *s != '\n' && *s != end_quote[qpair]) {
-	    ++s;
-	}
+	s = find_chr(s, scanner->end, stop_chr, 2);
 
 	/* check that no backslash character precedes the end_quote. */
 	if (*s == end_quote[qpair]) {
@@ -407,6 +718,7 @@ PJ_DEF(void) pj_scan_get_quotes(pj_scanner *scanner,
     /* Check and eat the end quote. */
     if (*s != end_quote[qpair]) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return;
     }
     ++s;
@@ -426,6 +738,7 @@ PJ_DEF(void) pj_scan_get_n( pj_scanner *scanner,
 {
     if (scanner->curptr + N > scanner->end) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return;
     }
 
@@ -501,12 +814,11 @@ PJ_DEF(void) pj_scan_get_until( pj_scanner *scanner,
 
     if (s >= scanner->end) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && !pj_cis_match(spec, *s)) {
-	++s;
-    }
+    s = cis_span_not(spec, s, scanner->end);
 
     pj_strset3(out, scanner->curptr, s);
 
@@ -525,12 +837,13 @@ PJ_DEF(void) pj_scan_get_until_ch( pj_scanner *scanner,
 
     if (s >= scanner->end) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && *s != until_char) {
-	++s;
-    }
+    s = (char*) memchr(s, until_char, scanner->end - s);
+    if (!s)
+	s = scanner->end;
 
     pj_strset3(out, scanner->curptr, s);
 
@@ -550,12 +863,17 @@ PJ_DEF(void) pj_scan_get_until_chr( pj_scanner *scanner,
 
     if (s >= scanner->end) {
 	pj_scan_syntax_err(scanner);
+	pj_strset(out, scanner->curptr, 0);
 	return;
     }
 
     speclen = strlen(until_spec);
-    while (PJ_SCAN_CHECK_EOF(s) && !memchr(until_spec, *s, speclen)) {
-	++s;
+    if (speclen > 0 && speclen <= FIND_CHR_MAX) {
+	s = find_chr(s, scanner->end, until_spec, (unsigned)speclen);
+    } else {
+	while (PJ_SCAN_CHECK_EOF(s) && !memchr(until_spec, *s, speclen)) {
+	    ++s;
+	}
     }
 
     pj_strset3(out, scanner->curptr, s);
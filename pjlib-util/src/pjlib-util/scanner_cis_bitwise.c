@@ -39,11 +39,13 @@ PJ_DEF(pj_status_t) pj_cis_init(pj_cis_buf_t *cis_buf, pj_cis_t *cis)
         if ((cis_buf->use_mask & (1 << i)) == 0) {
             cis->cis_id = i;
 	    cis_buf->use_mask |= (1 << i);
+	    cis_update_classifier(cis);
             return PJ_SUCCESS;
         }
     }
 
     cis->cis_id = PJ_CIS_MAX_INDEX;
+    cis->nib_ok = PJ_FALSE;
     return PJ_ETOOMANY;
 }
 
@@ -63,6 +65,7 @@ PJ_DEF(pj_status_t) pj_cis_dup( pj_cis_t *new_cis, pj_cis_t *existing)
         else
             PJ_CIS_CLR(new_cis, i);
     }
+    cis_update_classifier(new_cis);
 
     return PJ_SUCCESS;
 }
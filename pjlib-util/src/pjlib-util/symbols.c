@@ -41,6 +41,8 @@ PJ_EXPORT_SYMBOL(pj_cs_del_str)
 PJ_EXPORT_SYMBOL(pj_cs_invert)
 PJ_EXPORT_SYMBOL(pj_scan_init)
 PJ_EXPORT_SYMBOL(pj_scan_fini)
+PJ_EXPORT_SYMBOL(pj_scan_syntax_err)
+PJ_EXPORT_SYMBOL(pj_scan_clear_err)
 PJ_EXPORT_SYMBOL(pj_scan_peek)
 PJ_EXPORT_SYMBOL(pj_scan_peek_n)
 PJ_EXPORT_SYMBOL(pj_scan_peek_until)
@@ -189,6 +189,30 @@ typedef struct pj_activesock_cb
     pj_bool_t (*on_connect_complete)(pj_activesock_t *asock,
 				     pj_status_t status);
 
+    /**
+     * This callback is called when one or more packets arrive as the
+     * result of pj_activesock_start_recvfrom_batch(). If this callback is
+     * not set, \a on_data_recvfrom() will be called for each packet
+     * instead.
+     *
+     * @param asock	The active socket.
+     * @param pkt	Array of packets. The \a buf, \a len, \a addr and
+     *			\a addrlen fields contain the packet data, its
+     *			length, and the source address. If the status
+     *			argument is non-PJ_SUCCESS, this will be NULL.
+     * @param count	Number of packets in the array.
+     * @param status	The status of the read operation.
+     *
+     * @return		PJ_TRUE if further read is desired, and PJ_FALSE 
+     *			when application no longer wants to receive data.
+     *			Application may destroy the active socket in the
+     *			callback and return PJ_FALSE here.
+     */
+    pj_bool_t (*on_data_recvfrom_batch)(pj_activesock_t *asock,
+					const pj_ioqueue_mmsg pkt[],
+					unsigned count,
+					pj_status_t status);
+
 } pj_activesock_cb;
 
 
@@ -477,6 +501,35 @@ PJ_DECL(pj_status_t) pj_activesock_start_recvfrom2(pj_activesock_t *asock,
 						   void *readbuf[],
 						   pj_uint32_t flags);
 
+/**
+ * Same as #pj_activesock_start_recvfrom(), except that each read
+ * operation receives a batch of up to \a batch_cnt packets with a single
+ * system call (see #pj_ioqueue_recvmmsg()), which are then reported
+ * together with \a on_data_recvfrom_batch() callback (or one by one with
+ * \a on_data_recvfrom() callback, if the former is not set). This reduces
+ * the per packet cost on sockets with high packet rate.
+ *
+ * If the ioqueue backend does not support batch receive, the active
+ * socket will receive the packets one at a time, and report them as
+ * batches of one packet.
+ *
+ * @param asock	    The active socket.
+ * @param pool	    Pool used to allocate buffers for incoming data.
+ * @param buff_size The size of each buffer, in bytes.
+ * @param batch_cnt Maximum number of packets in a batch, capped at
+ *		    PJ_IOQUEUE_MAX_MMSG. The active socket allocates
+ *		    \a async_cnt times \a batch_cnt buffers.
+ * @param flags	    Flags to be given to pj_ioqueue_recvmmsg().
+ *
+ * @return	    PJ_SUCCESS if the operation has been successful,
+ *		    or the appropriate error code on failure.
+ */
+PJ_DECL(pj_status_t) pj_activesock_start_recvfrom_batch(pj_activesock_t *asock,
+							pj_pool_t *pool,
+							unsigned buff_size,
+							unsigned batch_cnt,
+							pj_uint32_t flags);
+
 /**
  * Send data using the socket.
  *
@@ -466,6 +466,63 @@
 #endif
 
 
+/**
+ * Specify whether caching pools cache released pools per thread by
+ * default (see pj_caching_pool_enable_magazine()). With this feature,
+ * each thread creates and releases pools through its own cache (magazine)
+ * without taking the caching pool lock, and the shared free lists are
+ * only used to refill or flush a batch of pools.
+ *
+ * The magazines need the compiler atomic builtins (GCC or Clang), and
+ * are not available when these are not available.
+ *
+ * Default: 0 (no)
+ */
+#ifndef PJ_CACHING_POOL_USE_MAGAZINE
+#   define PJ_CACHING_POOL_USE_MAGAZINE	    0
+#endif
+
+
+/**
+ * Maximum number of released pools of each size kept in the magazine of
+ * a thread (see PJ_CACHING_POOL_USE_MAGAZINE). When the magazine is
+ * full, half of the pools are moved to the shared free list of the
+ * caching pool. These pools are counted in the capacity of the caching
+ * pool. Set to zero to disable the magazines.
+ *
+ * Default: 8
+ */
+#ifndef PJ_CACHING_POOL_MAGAZINE_SIZE
+#   define PJ_CACHING_POOL_MAGAZINE_SIZE    8
+#endif
+
+
+/**
+ * Number of per-thread free lists (magazines) in each slab allocator
+ * (see @ref PJ_SLAB). Each thread is assigned one magazine (shared round
+ * robin if there are more threads than magazines), and objects are moved
+ * between the magazines and the shared free list of the slab in batches.
+ * Set to zero to disable the magazines.
+ *
+ * Default: 8
+ */
+#ifndef PJ_SLAB_MAGAZINE_CNT
+#   define PJ_SLAB_MAGAZINE_CNT		    8
+#endif
+
+
+/**
+ * Maximum number of free objects kept in a slab magazine (see
+ * PJ_SLAB_MAGAZINE_CNT). When the magazine is full, half of the objects
+ * are moved to the shared free list of the slab.
+ *
+ * Default: 32
+ */
+#ifndef PJ_SLAB_MAGAZINE_SIZE
+#   define PJ_SLAB_MAGAZINE_SIZE	    32
+#endif
+
+
 /**
  * If pool debugging is used, then each memory allocation from the pool
  * will call malloc(), and pool will release all memory chunks when it
@@ -492,6 +549,34 @@
 #endif
 
 
+/**
+ * Use the hierarchical timing wheel instead of the binary heap as the
+ * engine of timer heaps created with pj_timer_heap_create(). The timing
+ * wheel schedules and cancels timers in constant time, which helps when
+ * there are many (e.g. hundreds of thousands) active timers, at the cost
+ * of millisecond resolution and more memory per timer entry. See also
+ * pj_timer_heap_create2().
+ *
+ * Default: 0
+ */
+#ifndef PJ_TIMER_USE_WHEEL
+#  define PJ_TIMER_USE_WHEEL	    0
+#endif
+
+
+/**
+ * Implement atomic variables (pj_atomic_t) with the compiler atomic
+ * builtins instead of a mutex, when the compiler supports them. This is
+ * currently used on POSIX with GCC or Clang. Other platforms already use
+ * the native atomic operations.
+ *
+ * Default: 1
+ */
+#ifndef PJ_ATOMIC_USE_BUILTINS
+#  define PJ_ATOMIC_USE_BUILTINS    1
+#endif
+
+
 /**
  * Set this to 1 to enable debugging on the group lock. Default: 0
  */
@@ -646,6 +731,20 @@
 #endif
 
 
+/**
+ * Number of submission queue entries of the io_uring ioqueue backend
+ * (the completion queue is twice as large). Operations started by the
+ * callbacks during one poll are submitted together, so this should be
+ * larger than the number of operations a poll is expected to re-arm.
+ * The kernel clamps the value to its own maximum.
+ *
+ * Default: 256
+ */
+#ifndef PJ_IOQUEUE_URING_ENTRIES
+#   define PJ_IOQUEUE_URING_ENTRIES	256
+#endif
+
+
 /**
  * Determine if FD_SETSIZE is changeable/set-able. If so, then we will
  * set it to PJ_IOQUEUE_MAX_HANDLES. Currently we detect this by checking
@@ -35,8 +35,11 @@ PJ_BEGIN_DECL
  * @{
  * A hash table is a dictionary in which keys are mapped to array positions by
  * hash functions. Having the keys of more than one item map to the same 
- * position is called a collision. In this library, we will chain the nodes
- * that have the same key in a list.
+ * position is called a collision. By default, this library will chain the
+ * nodes that have the same key in a list. Alternatively, a hash table may
+ * be created with #PJ_HASH_OPEN_ADDRESSING option, where the entries are
+ * stored in an array and collisions are resolved by probing the next
+ * positions (see #pj_hash_create2()).
  */
 
 /**
@@ -85,6 +88,37 @@ PJ_DECL(pj_uint32_t) pj_hash_calc_tolower(pj_uint32_t hval,
                                           char *result,
                                           const pj_str_t *key);
 
+/**
+ * Hash table options, which can be bitmask combined and specified when
+ * creating the hash table with #pj_hash_create2().
+ */
+typedef enum pj_hash_option
+{
+    /**
+     * Store the entries and their hash values in an array, and resolve
+     * collisions with linear probing instead of chaining the entries in
+     * lists. The array position is derived from the hash value with a
+     * mixing function, so keys that share long prefixes (such as Call-ID
+     * or branch parameters) are still well distributed. The array grows
+     * when it is three quarters full, and the table keeps the pool
+     * specified in #pj_hash_create2() to allocate the new array.
+     *
+     * With this option, the entry_buf argument of #pj_hash_set_np() is
+     * not used. Entries may be removed while iterating the table, but
+     * adding entries may cause the iteration to skip or repeat entries.
+     */
+    PJ_HASH_OPEN_ADDRESSING = 1,
+
+    /**
+     * Instead of moving all entries to the new array at once when the
+     * open addressing table grows, move a few entries on each subsequent
+     * insertion, to bound the latency of each insertion. Lookups search
+     * both arrays until all entries have been moved.
+     */
+    PJ_HASH_INCREMENTAL_RESIZE = 2
+
+} pj_hash_option;
+
 /**
  * Create a hash table with the specified 'bucket' size.
  *
@@ -96,6 +130,24 @@ PJ_DECL(pj_uint32_t) pj_hash_calc_tolower(pj_uint32_t hval,
 PJ_DECL(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size);
 
 
+/**
+ * Create a hash table with the specified options. The table works with
+ * all the other hash table functions, so existing users of the table
+ * only need to change the creation.
+ *
+ * @param pool	    the pool from which the hash table will be allocated
+ *		    from.
+ * @param size	    the bucket size for chained table, or the expected
+ *		    number of entries for open addressing table.
+ * @param options   bitmask combination of #pj_hash_option, or zero to
+ *		    create the same table as #pj_hash_create().
+ *
+ * @return the hash table.
+ */
+PJ_DECL(pj_hash_table_t*) pj_hash_create2(pj_pool_t *pool, unsigned size,
+					  unsigned options);
+
+
 /**
  * Get the value associated with the specified key.
  *
@@ -94,6 +94,10 @@ PJ_BEGIN_DECL
  *  - <tt><b>/dev/epoll</b></tt> on Linux (user mode and kernel mode), 
  *    a much faster replacement for select() on Linux (and more importantly
  *    doesn't have limitation on number of descriptors).
+ *  - <tt><b>io_uring</b></tt> on Linux 5.11 or later. The socket operations
+ *    themselves are submitted to the kernel and their completions are
+ *    reaped in bulk, so one poll costs a single system call regardless of
+ *    the number of packets it handles.
  *  - <b>I/O Completion ports</b> on Windows NT/2000/XP, which is the most 
  *    efficient way to dispatch events in Windows NT based OSes, and most 
  *    importantly, it doesn't have the limit on how many handles to monitor.
@@ -286,6 +290,7 @@ typedef enum pj_ioqueue_operation_e
     PJ_IOQUEUE_OP_WRITE		= 8,	/**< write() operation.     */
     PJ_IOQUEUE_OP_SEND          = 16,   /**< send() operation.      */
     PJ_IOQUEUE_OP_SEND_TO	= 32,	/**< sendto() operation.    */
+    PJ_IOQUEUE_OP_RECV_MMSG	= 256,	/**< recvmmsg() operation.  */
 #if defined(PJ_HAS_TCP) && PJ_HAS_TCP != 0
     PJ_IOQUEUE_OP_ACCEPT	= 64,	/**< accept() operation.    */
     PJ_IOQUEUE_OP_CONNECT	= 128	/**< connect() operation.   */
@@ -303,12 +308,123 @@ typedef enum pj_ioqueue_operation_e
 #   define PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL     (16)
 #endif
 
+/**
+ * This macro specifies the maximum number of datagrams that can be
+ * transferred in a single #pj_ioqueue_recvmmsg() or #pj_ioqueue_sendmmsg()
+ * call. Larger batches are truncated to this value.
+ */
+#ifndef PJ_IOQUEUE_MAX_MMSG
+#   define PJ_IOQUEUE_MAX_MMSG			    (32)
+#endif
+
+/**
+ * This structure describes one datagram of a batch receive or send
+ * operation. See #pj_ioqueue_recvmmsg() and #pj_ioqueue_sendmmsg().
+ */
+typedef struct pj_ioqueue_mmsg
+{
+    /** The packet buffer. */
+    void	    *buf;
+
+    /**
+     * For receive, on input it specifies the size of the buffer, and on
+     * output it contains the length of the datagram. For send, it
+     * specifies the length of the datagram.
+     */
+    pj_ssize_t	     len;
+
+    /** Source address of received datagram, or destination address. */
+    pj_sockaddr_t   *addr;
+
+    /**
+     * For receive, on input it specifies the size of the address buffer
+     * and on output it contains the actual address length. For send,
+     * it specifies the length of the destination address.
+     */
+    int		     addrlen;
+
+} pj_ioqueue_mmsg;
+
 /**
  * When this flag is specified in ioqueue's recv() or send() operations,
  * the ioqueue will always mark the operation as asynchronous.
  */
 #define PJ_IOQUEUE_ALWAYS_ASYNC	    ((pj_uint32_t)1 << (pj_uint32_t)31)
 
+/**
+ * Flags to control how the epoll backend distributes events among threads
+ * that poll the same ioqueue. See pj_ioqueue_cfg.epoll_flags.
+ */
+typedef enum pj_ioqueue_epoll_flag
+{
+    /**
+     * Register the sockets with EPOLLEXCLUSIVE (Linux 4.5 or later), so
+     * that only one of the threads blocked in pj_ioqueue_poll() is woken
+     * up when a socket becomes ready. This avoids the thundering herd,
+     * although a socket that stays ready may still be reported to more
+     * than one thread.
+     */
+    PJ_IOQUEUE_EPOLL_EXCLUSIVE = 1,
+
+    /**
+     * Arm the sockets with EPOLLONESHOT. A ready socket is reported to
+     * exactly one polling thread, and it is re-armed only after its event
+     * has been dispatched, so threads never contend for the same key.
+     * This costs one extra epoll_ctl() call per event. The kernel does not
+     * allow EPOLLEXCLUSIVE to be combined with EPOLLONESHOT, so this flag
+     * takes precedence over PJ_IOQUEUE_EPOLL_EXCLUSIVE.
+     */
+    PJ_IOQUEUE_EPOLL_ONESHOT = 2
+
+} pj_ioqueue_epoll_flag;
+
+
+/**
+ * Default value of pj_ioqueue_cfg.epoll_flags. The default (zero) keeps
+ * the level-triggered behavior, which is the most efficient when only one
+ * thread polls the ioqueue.
+ */
+#ifndef PJ_IOQUEUE_DEFAULT_EPOLL_FLAGS
+#   define PJ_IOQUEUE_DEFAULT_EPOLL_FLAGS   0
+#endif
+
+
+/**
+ * Additional settings to be specified when creating an ioqueue with
+ * pj_ioqueue_create2(). Use pj_ioqueue_cfg_default() to initialize.
+ */
+typedef struct pj_ioqueue_cfg
+{
+    /**
+     * Combination of pj_ioqueue_epoll_flag. This is only used by the
+     * epoll backend and ignored by the others.
+     *
+     * Default: PJ_IOQUEUE_DEFAULT_EPOLL_FLAGS
+     */
+    unsigned epoll_flags;
+
+    /**
+     * Maximum number of events to be retrieved and dispatched by a single
+     * pj_ioqueue_poll() call. When several threads poll the same ioqueue,
+     * a smaller value spreads the load more evenly among them. The epoll
+     * backend allocates the event buffers of each polling thread with
+     * this size, the other backends cap the value at
+     * PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL.
+     *
+     * Default: PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL
+     */
+    unsigned max_events;
+
+} pj_ioqueue_cfg;
+
+
+/**
+ * Initialize the ioqueue settings with the default values.
+ *
+ * @param cfg		The settings to be initialized.
+ */
+PJ_DECL(void) pj_ioqueue_cfg_default(pj_ioqueue_cfg *cfg);
+
 /**
  * Return the name of the ioqueue implementation.
  *
@@ -331,6 +447,22 @@ PJ_DECL(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
 					pj_size_t max_fd,
 					pj_ioqueue_t **ioqueue);
 
+/**
+ * Create a new I/O Queue framework with the specified settings.
+ *
+ * @param pool		The pool to allocate the I/O queue structure. 
+ * @param max_fd	The maximum number of handles to be supported, which 
+ *			should not exceed PJ_IOQUEUE_MAX_HANDLES.
+ * @param cfg		Optional settings, NULL to use the default values.
+ * @param ioqueue	Pointer to hold the newly created I/O Queue.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_create2( pj_pool_t *pool, 
+					 pj_size_t max_fd,
+					 const pj_ioqueue_cfg *cfg,
+					 pj_ioqueue_t **ioqueue);
+
 /**
  * Destroy the I/O queue.
  *
@@ -808,6 +940,77 @@ PJ_DECL(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
 					int addrlen);
 
 
+/**
+ * Instruct the I/O Queue to receive a batch of datagrams from a datagram
+ * socket. This behaves like #pj_ioqueue_recvfrom(), except that a single
+ * readiness event (or completion) fills up to \a count messages, using
+ * \a recvmmsg() where the platform supports it, so the cost of the system
+ * call is shared among the datagrams.
+ *
+ * When the operation completes asynchronously, \a on_read_complete()
+ * callback will be called with \a bytes_read containing the number of
+ * datagrams received (which is at least one), or a negative error code.
+ * The \a len and \a addrlen fields of the received messages are updated.
+ *
+ * @param key	    The key that uniquely identifies the handle.
+ * @param op_key    An operation specific key to be associated with the
+ *                  pending operation.
+ * @param msg	    Array of messages. The caller MUST make sure that the
+ *		    array, and the buffers and addresses it refers to,
+ *		    remain valid until the operation completes.
+ * @param count	    On input, specifies the number of messages in the
+ *		    array, which is capped at PJ_IOQUEUE_MAX_MMSG. When data
+ *		    is received immediately, on output it contains the
+ *		    number of datagrams received.
+ * @param flags     Recv flag. If flags has PJ_IOQUEUE_ALWAYS_ASYNC then
+ *		    the function will never return PJ_SUCCESS.
+ *
+ * @return
+ *  - PJ_SUCCESS    If at least one datagram has been received immediately.
+ *		    In this case the callback WILL NOT be called.
+ *  - PJ_EPENDING   If the operation has been queued.
+ *  - PJ_ENOTSUP    If the ioqueue backend does not support batch receive.
+ *		    Use #pj_ioqueue_recvfrom() instead.
+ *  - non-zero      The return value indicates the error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_recvmmsg( pj_ioqueue_key_t *key,
+                                          pj_ioqueue_op_key_t *op_key,
+					  pj_ioqueue_mmsg msg[],
+					  unsigned *count,
+                                          pj_uint32_t flags);
+
+/**
+ * Send a batch of datagrams with a single system call (\a sendmmsg())
+ * where the platform supports it. Unlike #pj_ioqueue_sendto(), this
+ * function never schedules an asynchronous operation, hence there is no
+ * operation key and no completion callback: it sends what the socket can
+ * take right now, and leaves the rest to the caller, which would normally
+ * send the remaining messages with #pj_ioqueue_sendto(). The caller must
+ * be prepared for PJ_EBUSY, which is returned whenever the key already
+ * has pending write operations.
+ *
+ * @param key	    The key that identifies the handle.
+ * @param msg	    Array of messages to send.
+ * @param count	    On input, specifies the number of messages in the
+ *		    array. On output, it contains the number of messages
+ *		    that have been sent.
+ * @param flags     Send flags.
+ *
+ * @return
+ *  - PJ_SUCCESS    If at least one message has been sent.
+ *  - PJ_EBUSY      If nothing could be sent without blocking, or because
+ *		    there are pending write operations on the key that
+ *		    must complete first to preserve packet ordering. In
+ *		    this case \a count is set to zero.
+ *  - PJ_ENOTSUP    If the ioqueue backend does not support batch send.
+ *  - non-zero      The return value indicates the error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_sendmmsg( pj_ioqueue_key_t *key,
+					  const pj_ioqueue_mmsg msg[],
+					  unsigned *count,
+                                          pj_uint32_t flags);
+
+
 /**
  * !}
  */
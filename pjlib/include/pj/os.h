@@ -659,6 +659,51 @@ PJ_DECL(void) pj_atomic_add( pj_atomic_t *atomic_var,
 PJ_DECL(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
 			                          pj_atomic_value_t value);
 
+/**
+ * Get the value of an atomic type with acquire ordering. Unlike
+ * pj_atomic_get(), which is sequentially consistent, this only
+ * guarantees that memory accesses after this call are not reordered
+ * before it.
+ *
+ * @param atomic_var	the atomic variable.
+ *
+ * @return the value of the atomic variable.
+ */
+PJ_DECL(pj_atomic_value_t) pj_atomic_get_acquire(pj_atomic_t *atomic_var);
+
+/**
+ * Set the value of an atomic type with release ordering, i.e. memory
+ * accesses before this call are not reordered after it. Pair this with
+ * pj_atomic_get_acquire() to publish data to another thread.
+ *
+ * @param atomic_var	the atomic variable.
+ * @param value		value to be set to the variable.
+ */
+PJ_DECL(void) pj_atomic_set_release(pj_atomic_t *atomic_var,
+				    pj_atomic_value_t value);
+
+/**
+ * Increment the value of an atomic type without any ordering
+ * constraint. This is suitable for taking a new reference of an object
+ * while already holding one.
+ *
+ * @param atomic_var	the atomic variable.
+ */
+PJ_DECL(void) pj_atomic_inc_relaxed(pj_atomic_t *atomic_var);
+
+/**
+ * Decrement the value of an atomic type with release ordering, and get
+ * the result. When the result is zero, an acquire fence is issued too,
+ * so this is suitable for releasing a reference of an object and
+ * destroying the object when the last reference is gone.
+ *
+ * @param atomic_var	the atomic variable.
+ *
+ * @return              The decremented value.
+ */
+PJ_DECL(pj_atomic_value_t) pj_atomic_dec_and_get_release(
+						pj_atomic_t *atomic_var);
+
 /**
  * @}
  */
@@ -862,6 +862,27 @@ struct pj_caching_pool
      * Mutex.
      */
     pj_lock_t	   *lock;
+
+    /**
+     * Whether pools are cached per thread, see
+     * pj_caching_pool_enable_magazine().
+     */
+    pj_bool_t	    use_magazine;
+
+    /**
+     * List of the per-thread pool caches that have been created.
+     */
+    pj_list	    magazine_list;
+
+    /**
+     * Internal pool for the magazines.
+     */
+    pj_pool_t	   *magazine_pool;
+
+    /**
+     * Thread local storage index of the magazine of the thread.
+     */
+    long	    magazine_tls;
 };
 
 
@@ -882,6 +903,28 @@ PJ_DECL(void) pj_caching_pool_init( pj_caching_pool *ch_pool,
 				    pj_size_t max_capacity);
 
 
+/**
+ * Enable or disable caching the released pools per thread (magazines).
+ * Each thread then creates and releases pools through its own cache
+ * without taking the caching pool lock. The pools created through the
+ * magazines are not tracked by the caching pool, so they are not released
+ * by #pj_caching_pool_destroy() nor listed by the detailed dump. The
+ * pools cached by a thread that has exited are only released when the
+ * caching pool is destroyed.
+ *
+ * This must be called before any pool is created from the caching pool.
+ * The default is set by PJ_CACHING_POOL_USE_MAGAZINE.
+ *
+ * @param ch_pool	The caching pool.
+ * @param enable	PJ_TRUE to enable the magazines.
+ *
+ * @return		PJ_SUCCESS, or PJ_ENOTSUP if the magazines are not
+ *			available in this build.
+ */
+PJ_DECL(pj_status_t) pj_caching_pool_enable_magazine(pj_caching_pool *ch_pool,
+						     pj_bool_t enable);
+
+
 /**
  * Destroy caching pool, and release all the pools in the recycling list.
  *
@@ -0,0 +1,141 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_SLAB_H__
+#define __PJ_SLAB_H__
+
+/**
+ * @file slab.h
+ * @brief Fixed-size object allocator
+ */
+
+#include <pj/pool.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_SLAB Fixed-size Object Allocator
+ * @ingroup PJ_POOL_GROUP
+ * @brief
+ * The slab allocator hands out objects of one fixed size, and takes them
+ * back individually for reuse. This complements the memory pool, where
+ * memory can only be released all at once when the pool is released, for
+ * short-lived objects that are created and destroyed at a high rate.
+ *
+ * The objects are carved from chunks of memory allocated from a pool, and
+ * the memory of released objects is kept in free lists for the next
+ * allocation. Memory is only returned to the pool factory when the slab
+ * is destroyed, hence the slab grows to the peak number of objects in use.
+ *
+ * Each thread allocates and releases objects through its own free list
+ * (see #PJ_SLAB_MAGAZINE_CNT), and the shared free list of the slab is
+ * only used to move a batch of objects between threads.
+ *
+ * @{
+ */
+
+/**
+ * Opaque declaration of slab allocator.
+ */
+typedef struct pj_slab_t pj_slab_t;
+
+/**
+ * Create a slab allocator.
+ *
+ * @param factory	The pool factory, where the memory of the objects
+ *			will be allocated from.
+ * @param name		Name of the slab, for logging purpose. May be NULL.
+ * @param obj_size	Size of each object, in bytes.
+ * @param obj_per_chunk	Number of objects to be allocated from the pool
+ *			at once when the slab runs out of free objects. If
+ *			zero, a default value will be used.
+ * @param p_slab	Pointer to receive the slab allocator.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_slab_create(pj_pool_factory *factory,
+				    const char *name,
+				    pj_size_t obj_size,
+				    unsigned obj_per_chunk,
+				    pj_slab_t **p_slab);
+
+/**
+ * Allocate an object from the slab. The content of the object is not
+ * initialized.
+ *
+ * @param slab		The slab allocator.
+ *
+ * @return		The object, or NULL if memory could not be allocated.
+ */
+PJ_DECL(void*) pj_slab_alloc(pj_slab_t *slab);
+
+/**
+ * Allocate an object from the slab and initialize its content to zero.
+ *
+ * @param slab		The slab allocator.
+ *
+ * @return		The object, or NULL if memory could not be allocated.
+ */
+PJ_DECL(void*) pj_slab_zalloc(pj_slab_t *slab);
+
+/**
+ * Return an object to the slab. The object may be released by any thread,
+ * not necessarily the one that allocated it.
+ *
+ * @param slab		The slab allocator.
+ * @param obj		The object, which must have been allocated from
+ *			this slab.
+ */
+PJ_DECL(void) pj_slab_free(pj_slab_t *slab, void *obj);
+
+/**
+ * Get the size of the objects of the slab, which may be larger than the
+ * size specified when the slab was created due to alignment.
+ *
+ * @param slab		The slab allocator.
+ *
+ * @return		The object size, in bytes.
+ */
+PJ_DECL(pj_size_t) pj_slab_get_obj_size(const pj_slab_t *slab);
+
+/**
+ * Get the number of objects that have been carved from the memory of the
+ * slab, whether they are currently in use or not.
+ *
+ * @param slab		The slab allocator.
+ *
+ * @return		Number of objects.
+ */
+PJ_DECL(pj_size_t) pj_slab_get_capacity(pj_slab_t *slab);
+
+/**
+ * Destroy the slab allocator and release all of its memory. Objects that
+ * are still in use become invalid.
+ *
+ * @param slab		The slab allocator.
+ */
+PJ_DECL(void) pj_slab_destroy(pj_slab_t *slab);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJ_SLAB_H__ */
@@ -132,6 +132,27 @@ typedef struct pj_timer_entry
 } pj_timer_entry;
 
 
+/**
+ * The engine used by a timer heap, see pj_timer_heap_create2().
+ */
+typedef enum pj_timer_heap_type
+{
+    /**
+     * Binary heap. Scheduling, cancelling and expiring a timer is
+     * O(log N).
+     */
+    PJ_TIMER_HEAP_BINARY,
+
+    /**
+     * Hierarchical timing wheel with millisecond resolution. Scheduling
+     * and cancelling a timer is O(1), and timers expiring in the same
+     * millisecond are expired together.
+     */
+    PJ_TIMER_HEAP_WHEEL
+
+} pj_timer_heap_type;
+
+
 /**
  * Calculate memory size required to create a timer heap.
  *
@@ -140,6 +161,17 @@ typedef struct pj_timer_entry
  */
 PJ_DECL(pj_size_t) pj_timer_heap_mem_size(pj_size_t count);
 
+/**
+ * Calculate memory size required to create a timer heap with the
+ * specified engine, see pj_timer_heap_create2().
+ *
+ * @param count     Number of timer entries to be supported.
+ * @param type      The engine of the timer heap.
+ * @return          Memory size requirement in bytes.
+ */
+PJ_DECL(pj_size_t) pj_timer_heap_mem_size2(pj_size_t count,
+					   pj_timer_heap_type type);
+
 /**
  * Create a timer heap.
  *
@@ -159,6 +191,25 @@ PJ_DECL(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
 					   pj_size_t count,
                                            pj_timer_heap_t **ht);
 
+/**
+ * Create a timer heap with the specified engine. pj_timer_heap_create()
+ * uses the engine selected by PJ_TIMER_USE_WHEEL. All other timer heap
+ * functions work the same way with either engine.
+ *
+ * @param pool      The pool where allocations in the timer heap will be 
+ *                  allocated.
+ * @param count     The maximum number of timer entries to be supported 
+ *                  initially.
+ * @param type      The timer heap engine.
+ * @param ht        Pointer to receive the created timer heap.
+ *
+ * @return          PJ_SUCCESS, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_timer_heap_create2( pj_pool_t *pool,
+					    pj_size_t count,
+					    pj_timer_heap_type type,
+					    pj_timer_heap_t **ht);
+
 /**
  * Destroy the timer heap.
  *
@@ -40,7 +40,8 @@ enum read_type
 {
     TYPE_NONE,
     TYPE_RECV,
-    TYPE_RECV_FROM
+    TYPE_RECV_FROM,
+    TYPE_RECV_MMSG
 };
 
 enum shutdown_dir
@@ -58,6 +59,8 @@ struct read_op
     pj_size_t		 size;
     pj_sockaddr		 src_addr;
     int			 src_addr_len;
+    pj_ioqueue_mmsg	*mmsg;		/* Batch receive (TYPE_RECV_MMSG)   */
+    unsigned		 mmsg_cnt;
 };
 
 struct accept_op
@@ -102,6 +105,7 @@ struct pj_activesock_t
     struct read_op	*read_op;
     pj_uint32_t		 read_flags;
     enum read_type	 read_type;
+    pj_bool_t		 read_mmsg;	/* ioqueue supports recvmmsg()	    */
 
     struct accept_op	*accept_op;
 };
@@ -448,6 +452,184 @@ PJ_DEF(pj_status_t) pj_activesock_start_recvfrom2( pj_activesock_t *asock,
 }
 
 
+/* Prepare the batch receive buffers for the next read. */
+static void reset_mmsg(struct read_op *r)
+{
+    unsigned i;
+
+    for (i=0; i<r->mmsg_cnt; ++i) {
+	r->mmsg[i].len = r->max_size;
+	r->mmsg[i].addrlen = sizeof(pj_sockaddr);
+    }
+}
+
+/* Start batch read, or single read if ioqueue doesn't support batch. The
+ * number of packets received immediately is returned in bytes_read.
+ */
+static pj_status_t read_mmsg(pj_activesock_t *asock, struct read_op *r,
+			     pj_ssize_t *bytes_read, pj_uint32_t flags)
+{
+    pj_status_t status;
+
+    reset_mmsg(r);
+
+    if (asock->read_mmsg) {
+	unsigned count = r->mmsg_cnt;
+
+	status = pj_ioqueue_recvmmsg(asock->key, &r->op_key, r->mmsg,
+				     &count, flags);
+	*bytes_read = count;
+    } else {
+	*bytes_read = r->max_size;
+	status = pj_ioqueue_recvfrom(asock->key, &r->op_key, r->mmsg[0].buf,
+				     bytes_read, flags, r->mmsg[0].addr,
+				     &r->mmsg[0].addrlen);
+	if (status == PJ_SUCCESS && *bytes_read > 0) {
+	    r->mmsg[0].len = *bytes_read;
+	    *bytes_read = 1;
+	}
+    }
+
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_activesock_start_recvfrom_batch(pj_activesock_t *asock,
+						       pj_pool_t *pool,
+						       unsigned buff_size,
+						       unsigned batch_cnt,
+						       pj_uint32_t flags)
+{
+    unsigned i, j;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(asock && pool && buff_size && batch_cnt, PJ_EINVAL);
+    PJ_ASSERT_RETURN(asock->read_type == TYPE_NONE, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(!asock->stream_oriented, PJ_EINVALIDOP);
+
+    if (batch_cnt > PJ_IOQUEUE_MAX_MMSG)
+	batch_cnt = PJ_IOQUEUE_MAX_MMSG;
+
+    asock->read_op = (struct read_op*)
+		     pj_pool_calloc(pool, asock->async_count, 
+				    sizeof(struct read_op));
+    asock->read_type = TYPE_RECV_MMSG;
+    asock->read_flags = flags;
+    asock->read_mmsg = PJ_TRUE;
+
+    for (i=0; i<asock->async_count; ++i) {
+	struct read_op *r = &asock->read_op[i];
+	pj_sockaddr *addr;
+	pj_ssize_t cnt;
+
+	r->mmsg = (pj_ioqueue_mmsg*)
+		  pj_pool_calloc(pool, batch_cnt, sizeof(pj_ioqueue_mmsg));
+	addr = (pj_sockaddr*)
+	       pj_pool_calloc(pool, batch_cnt, sizeof(pj_sockaddr));
+	for (j=0; j<batch_cnt; ++j) {
+	    r->mmsg[j].buf = pj_pool_alloc(pool, buff_size);
+	    r->mmsg[j].addr = &addr[j];
+	}
+	r->mmsg_cnt = batch_cnt;
+	r->max_size = buff_size;
+
+	status = read_mmsg(asock, r, &cnt, PJ_IOQUEUE_ALWAYS_ASYNC | flags);
+	if (status == PJ_ENOTSUP && asock->read_mmsg) {
+	    /* Batch receive is not supported by the ioqueue */
+	    asock->read_mmsg = PJ_FALSE;
+	    status = read_mmsg(asock, r, &cnt,
+			       PJ_IOQUEUE_ALWAYS_ASYNC | flags);
+	}
+	PJ_ASSERT_RETURN(status != PJ_SUCCESS, PJ_EBUG);
+
+	if (status != PJ_EPENDING)
+	    return status;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/* Deliver received batch (or error) to application. Returns PJ_FALSE if
+ * application doesn't want to read any more.
+ */
+static pj_bool_t call_recvfrom_batch_cb(pj_activesock_t *asock,
+					const pj_ioqueue_mmsg pkt[],
+					unsigned count,
+					pj_status_t status)
+{
+    pj_bool_t ret = PJ_TRUE;
+    unsigned i;
+
+    if (asock->cb.on_data_recvfrom_batch) {
+	ret = (*asock->cb.on_data_recvfrom_batch)(asock, pkt, count, status);
+    } else if (asock->cb.on_data_recvfrom) {
+	if (status != PJ_SUCCESS) {
+	    return (*asock->cb.on_data_recvfrom)(asock, NULL, 0, NULL, 0,
+						 status);
+	}
+	for (i=0; i<count && ret; ++i) {
+	    ret = (*asock->cb.on_data_recvfrom)(asock, pkt[i].buf, pkt[i].len,
+						pkt[i].addr, pkt[i].addrlen,
+						PJ_SUCCESS);
+	}
+    }
+
+    return ret;
+}
+
+/* Read completion of batch receive. Here bytes_read is the number of
+ * packets (see pj_ioqueue_recvmmsg()).
+ */
+static void on_read_mmsg_complete(pj_activesock_t *asock,
+				  struct read_op *r,
+				  pj_ssize_t bytes_read)
+{
+    unsigned loop = 0;
+    pj_status_t status;
+
+    do {
+	pj_uint32_t flags;
+	pj_bool_t ret = PJ_TRUE;
+
+	if (bytes_read > 0) {
+	    ret = call_recvfrom_batch_cb(asock, r->mmsg, (unsigned)bytes_read,
+					 PJ_SUCCESS);
+	} else if (bytes_read < 0 &&
+		   -bytes_read != PJ_STATUS_FROM_OS(OSERR_EWOULDBLOCK) &&
+		   -bytes_read != PJ_STATUS_FROM_OS(OSERR_EINPROGRESS) && 
+		   -bytes_read != PJ_STATUS_FROM_OS(OSERR_ECONNRESET)) 
+	{
+	    ret = call_recvfrom_batch_cb(asock, NULL, 0,
+					 (pj_status_t)-bytes_read);
+	}
+
+	/* If callback returns false, we have been destroyed! */
+	if (!ret)
+	    return;
+
+	/* Also stop further read if we've been shutdown */
+	if (asock->shutdown & SHUT_RX)
+	    return;
+
+	/* Read next batch, see the loop in ioqueue_on_read_complete() */
+	flags = asock->read_flags;
+	if (++loop >= asock->max_loop)
+	    flags |= PJ_IOQUEUE_ALWAYS_ASYNC;
+
+	status = read_mmsg(asock, r, &bytes_read, flags);
+	if (status == PJ_SUCCESS) {
+	    /* Immediate data */
+	    ;
+	} else if (status != PJ_EPENDING && status != PJ_ECANCELLED) {
+	    /* Error */
+	    bytes_read = -status;
+	} else {
+	    break;
+	}
+    } while (1);
+}
+
+
 static void ioqueue_on_read_complete(pj_ioqueue_key_t *key, 
 				     pj_ioqueue_op_key_t *op_key, 
 				     pj_ssize_t bytes_read)
@@ -463,6 +645,16 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
     if (asock->shutdown & SHUT_RX)
 	return;
 
+    if (asock->read_type == TYPE_RECV_MMSG) {
+	/* Single read fallback reports bytes rather than packets */
+	if (!asock->read_mmsg && bytes_read > 0) {
+	    r->mmsg[0].len = bytes_read;
+	    bytes_read = 1;
+	}
+	on_read_mmsg_complete(asock, r, bytes_read);
+	return;
+    }
+
     do {
 	unsigned flags;
 
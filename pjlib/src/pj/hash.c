@@ -30,6 +30,19 @@
  */
 #define PJ_HASH_MULTIPLIER	33
 
+/**
+ * Number of slots of the old array moved on each insertion when the open
+ * addressing table is resized incrementally.
+ */
+#define RESIZE_STEP		8
+
+/* Minimum number of slots of open addressing table */
+#define MIN_SLOTS		16
+
+/* Key of a removed entry in open addressing table */
+static char tombstone;
+#define TOMBSTONE		((void*)&tombstone)
+
 
 struct pj_hash_entry
 {
@@ -41,11 +54,42 @@ struct pj_hash_entry
 };
 
 
+/* Entry of open addressing table. Empty slot has NULL key. */
+typedef struct pj_hash_slot
+{
+    void *key;
+    void *value;
+    pj_uint32_t hash;
+    pj_uint32_t keylen;
+} pj_hash_slot;
+
+
 struct pj_hash_table_t
 {
     pj_hash_entry     **table;
     unsigned		count, rows;
     pj_hash_iterator_t	iterator;
+
+    /* Open addressing table. The number of slots is mask+1, and used
+     * is the number of live and removed entries in the slots.
+     */
+    pj_pool_t	       *pool;
+    unsigned		options;
+    pj_hash_slot       *slots;
+    unsigned		mask;
+    unsigned		used;
+
+    /* Previous slots which entries are being moved to the new slots,
+     * starting from old_pos.
+     */
+    pj_hash_slot       *old_slots;
+    unsigned		old_mask;
+    unsigned		old_pos;
+
+    /* Array of the same size as the slots, kept from the previous resize
+     * to be reused when the table is rebuilt to clear removed entries.
+     */
+    pj_hash_slot       *spare_slots;
 };
 
 
@@ -101,42 +145,12 @@ PJ_DEF(pj_uint32_t) pj_hash_calc_tolower( pj_uint32_t hval,
 }
 
 
-PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
-{
-    pj_hash_table_t *h;
-    unsigned table_size;
-    
-    /* Check that PJ_HASH_ENTRY_BUF_SIZE is correct. */
-    PJ_ASSERT_RETURN(sizeof(pj_hash_entry)<=PJ_HASH_ENTRY_BUF_SIZE, NULL);
-
-    h = PJ_POOL_ALLOC_T(pool, pj_hash_table_t);
-    h->count = 0;
-
-    PJ_LOG( 6, ("hashtbl", "hash table %p created from pool %s", h, pj_pool_getobjname(pool)));
-
-    /* size must be 2^n - 1.
-       round-up the size to this rule, except when size is 2^n, then size
-       will be round-down to 2^n-1.
-     */
-    table_size = 8;
-    do {
-	table_size <<= 1;    
-    } while (table_size < size);
-    table_size -= 1;
-    
-    h->rows = table_size;
-    h->table = (pj_hash_entry**)
-    	       pj_pool_calloc(pool, table_size+1, sizeof(pj_hash_entry*));
-    return h;
-}
-
-static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht, 
-				   const void *key, unsigned keylen,
-				   void *val, pj_uint32_t *hval,
-				   void *entry_buf, pj_bool_t lower)
+/* Get the hash value and the length of the key. */
+static pj_uint32_t get_hash( const void *key, unsigned *p_keylen,
+			     pj_uint32_t *hval, pj_bool_t lower)
 {
+    unsigned keylen = *p_keylen;
     pj_uint32_t hash;
-    pj_hash_entry **p_entry, *entry;
 
     if (hval && *hval != 0) {
 	hash = *hval;
@@ -173,6 +187,297 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
 	    *hval = hash;
     }
 
+    *p_keylen = keylen;
+    return hash;
+}
+
+PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
+{
+    pj_hash_table_t *h;
+    unsigned table_size;
+    
+    /* Check that PJ_HASH_ENTRY_BUF_SIZE is correct. */
+    PJ_ASSERT_RETURN(sizeof(pj_hash_entry)<=PJ_HASH_ENTRY_BUF_SIZE, NULL);
+
+    h = PJ_POOL_ZALLOC_T(pool, pj_hash_table_t);
+
+    PJ_LOG( 6, ("hashtbl", "hash table %p created from pool %s", h, pj_pool_getobjname(pool)));
+
+    /* size must be 2^n - 1.
+       round-up the size to this rule, except when size is 2^n, then size
+       will be round-down to 2^n-1.
+     */
+    table_size = 8;
+    do {
+	table_size <<= 1;    
+    } while (table_size < size);
+    table_size -= 1;
+    
+    h->rows = table_size;
+    h->table = (pj_hash_entry**)
+    	       pj_pool_calloc(pool, table_size+1, sizeof(pj_hash_entry*));
+    return h;
+}
+
+
+PJ_DEF(pj_hash_table_t*) pj_hash_create2(pj_pool_t *pool, unsigned size,
+					 unsigned options)
+{
+    pj_hash_table_t *h;
+    unsigned slot_cnt;
+
+    if ((options & PJ_HASH_OPEN_ADDRESSING) == 0)
+	return pj_hash_create(pool, size);
+
+    h = PJ_POOL_ZALLOC_T(pool, pj_hash_table_t);
+    h->pool = pool;
+    h->options = options;
+
+    /* Keep the load below 3/4 for the expected number of entries */
+    slot_cnt = MIN_SLOTS;
+    while (slot_cnt / 4 * 3 < size)
+	slot_cnt <<= 1;
+
+    h->mask = slot_cnt - 1;
+    h->slots = (pj_hash_slot*)
+	       pj_pool_calloc(pool, slot_cnt, sizeof(pj_hash_slot));
+
+    PJ_LOG( 6, ("hashtbl", "hash table %p with %u slots created from pool %s",
+		h, slot_cnt, pj_pool_getobjname(pool)));
+
+    return h;
+}
+
+
+/*
+ * Open addressing table.
+ */
+
+/* Spread the bits of the hash value, so that keys which only differ in
+ * a few characters are not placed in adjacent slots. This is the
+ * finalizer of MurmurHash3.
+ */
+PJ_INLINE(pj_uint32_t) mix_hash(pj_uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static pj_hash_slot *oa_find( pj_hash_slot *slots, unsigned mask,
+			      const void *key, unsigned keylen,
+			      pj_uint32_t hash, pj_bool_t lower)
+{
+    unsigned i, n;
+
+    for (i=mix_hash(hash) & mask, n=0; n<=mask; i=(i+1) & mask, ++n) {
+	pj_hash_slot *slot = &slots[i];
+
+	if (slot->key == NULL)
+	    return NULL;
+
+	if (slot->key != TOMBSTONE && slot->hash==hash &&
+	    slot->keylen==keylen &&
+            ((lower && pj_ansi_strnicmp((const char*)slot->key,
+        			        (const char*)key, keylen)==0) ||
+	     (!lower && pj_memcmp(slot->key, key, keylen)==0)))
+	{
+	    return slot;
+	}
+    }
+
+    return NULL;
+}
+
+static pj_hash_slot *oa_lookup( pj_hash_table_t *ht,
+				const void *key, unsigned keylen,
+				pj_uint32_t hash, pj_bool_t lower)
+{
+    pj_hash_slot *slot;
+
+    slot = oa_find(ht->slots, ht->mask, key, keylen, hash, lower);
+    if (!slot && ht->old_slots) {
+	slot = oa_find(ht->old_slots, ht->old_mask, key, keylen, hash,
+		       lower);
+    }
+    return slot;
+}
+
+/* Get a free slot for a new entry. The table is never full since it is
+ * resized before it is three quarters full.
+ */
+static pj_hash_slot *oa_free_slot( pj_hash_table_t *ht, pj_uint32_t hash )
+{
+    unsigned i;
+
+    for (i=mix_hash(hash) & ht->mask; ; i=(i+1) & ht->mask) {
+	pj_hash_slot *slot = &ht->slots[i];
+
+	if (slot->key == NULL) {
+	    ++ht->used;
+	    return slot;
+	}
+	if (slot->key == TOMBSTONE)
+	    return slot;
+    }
+}
+
+/* Move up to max_cnt slots of the old array to the current array. */
+static void oa_move_old( pj_hash_table_t *ht, unsigned max_cnt )
+{
+    while (max_cnt-- && ht->old_pos <= ht->old_mask) {
+	pj_hash_slot *slot = &ht->old_slots[ht->old_pos++];
+
+	if (slot->key && slot->key != TOMBSTONE) {
+	    *oa_free_slot(ht, slot->hash) = *slot;
+	    slot->key = TOMBSTONE;
+	}
+    }
+
+    if (ht->old_pos > ht->old_mask) {
+	/* Keep the array for the next rebuild if it has the same size. The
+	 * smaller arrays of the previous sizes can't be reused, they are
+	 * at most as large as the current array in total.
+	 */
+	if (ht->old_mask == ht->mask)
+	    ht->spare_slots = ht->old_slots;
+	ht->old_slots = NULL;
+    }
+}
+
+/* Move the entries to an array which is at most half full after all
+ * entries are moved, which also clears the removed entries. The array
+ * only grows when the live entries need it, otherwise the table is
+ * rebuilt with the same size, reusing the array of the previous rebuild,
+ * so that inserting and removing entries doesn't use more memory.
+ */
+static void oa_resize( pj_hash_table_t *ht )
+{
+    unsigned slot_cnt = ht->mask + 1;
+    pj_hash_slot *slots;
+
+    /* Finish the previous resize */
+    if (ht->old_slots)
+	oa_move_old(ht, ht->old_mask + 1);
+
+    while (slot_cnt / 2 < ht->count + 1)
+	slot_cnt <<= 1;
+
+    PJ_LOG(6, ("hashtbl", "%p: resizing from %u to %u slots", ht,
+	       ht->mask + 1, slot_cnt));
+
+    if (slot_cnt == ht->mask + 1 && ht->spare_slots) {
+	slots = ht->spare_slots;
+	pj_bzero(slots, slot_cnt * sizeof(pj_hash_slot));
+    } else {
+	slots = (pj_hash_slot*)
+		pj_pool_calloc(ht->pool, slot_cnt, sizeof(pj_hash_slot));
+    }
+    ht->spare_slots = NULL;
+
+    ht->old_slots = ht->slots;
+    ht->old_mask = ht->mask;
+    ht->old_pos = 0;
+
+    ht->slots = slots;
+    ht->mask = slot_cnt - 1;
+    ht->used = 0;
+
+    if ((ht->options & PJ_HASH_INCREMENTAL_RESIZE) == 0)
+	oa_move_old(ht, ht->old_mask + 1);
+}
+
+static void oa_set( pj_pool_t *pool, pj_hash_table_t *ht,
+		    const void *key, unsigned keylen, pj_uint32_t hval,
+		    void *value, pj_bool_t lower )
+{
+    pj_uint32_t hash;
+    pj_hash_slot *slot;
+    void *new_key;
+
+    hash = get_hash(key, &keylen, &hval, lower);
+
+    slot = oa_lookup(ht, key, keylen, hash, lower);
+    if (slot) {
+	if (value == NULL) {
+	    /* delete entry */
+	    PJ_LOG(6, ("hashtbl", "%p: slot %p deleted", ht, slot));
+	    slot->key = TOMBSTONE;
+	    slot->value = NULL;
+	    --ht->count;
+	} else {
+	    /* overwrite */
+	    slot->value = value;
+	    PJ_LOG(6, ("hashtbl", "%p: slot %p value set to %p", ht,
+		       slot, value));
+	}
+	return;
+    }
+
+    if (value == NULL)
+	return;
+
+    if (pool) {
+	new_key = pj_pool_alloc(pool, keylen);
+	pj_memcpy(new_key, key, keylen);
+    } else {
+	new_key = (void*)key;
+    }
+
+    if ((ht->used + 1) * 4 > (ht->mask + 1) * 3)
+	oa_resize(ht);
+    else if (ht->old_slots)
+	oa_move_old(ht, RESIZE_STEP);
+
+    slot = oa_free_slot(ht, hash);
+    slot->key = new_key;
+    slot->value = value;
+    slot->hash = hash;
+    slot->keylen = keylen;
+
+    ++ht->count;
+}
+
+static pj_hash_iterator_t *oa_next( pj_hash_table_t *ht,
+				    pj_hash_iterator_t *it )
+{
+    unsigned slot_cnt = ht->mask + 1;
+    unsigned total = slot_cnt;
+
+    if (ht->old_slots)
+	total += ht->old_mask + 1;
+
+    for (; it->index < total; ++it->index) {
+	pj_hash_slot *slot;
+
+	if (it->index < slot_cnt)
+	    slot = &ht->slots[it->index];
+	else
+	    slot = &ht->old_slots[it->index - slot_cnt];
+
+	if (slot->key && slot->key != TOMBSTONE) {
+	    it->entry = (pj_hash_entry*)slot;
+	    return it;
+	}
+    }
+
+    it->entry = NULL;
+    return NULL;
+}
+
+static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht, 
+				   const void *key, unsigned keylen,
+				   void *val, pj_uint32_t *hval,
+				   void *entry_buf, pj_bool_t lower)
+{
+    pj_uint32_t hash;
+    pj_hash_entry **p_entry, *entry;
+
+    hash = get_hash(key, &keylen, hval, lower);
+
     /* scan the linked list */
     for (p_entry = &ht->table[hash & ht->rows], entry=*p_entry; 
 	 entry; 
@@ -227,6 +532,13 @@ PJ_DEF(void *) pj_hash_get( pj_hash_table_t *ht,
 			    pj_uint32_t *hval)
 {
     pj_hash_entry *entry;
+
+    if (ht->slots) {
+	pj_uint32_t hash = get_hash(key, &keylen, hval, PJ_FALSE);
+	pj_hash_slot *slot = oa_lookup(ht, key, keylen, hash, PJ_FALSE);
+	return slot ? slot->value : NULL;
+    }
+
     entry = *find_entry( NULL, ht, key, keylen, NULL, hval, NULL, PJ_FALSE);
     return entry ? entry->value : NULL;
 }
@@ -236,6 +548,13 @@ PJ_DEF(void *) pj_hash_get_lower( pj_hash_table_t *ht,
 			          pj_uint32_t *hval)
 {
     pj_hash_entry *entry;
+
+    if (ht->slots) {
+	pj_uint32_t hash = get_hash(key, &keylen, hval, PJ_TRUE);
+	pj_hash_slot *slot = oa_lookup(ht, key, keylen, hash, PJ_TRUE);
+	return slot ? slot->value : NULL;
+    }
+
     entry = *find_entry( NULL, ht, key, keylen, NULL, hval, NULL, PJ_TRUE);
     return entry ? entry->value : NULL;
 }
@@ -246,6 +565,11 @@ static void hash_set( pj_pool_t *pool, pj_hash_table_t *ht,
 {
     pj_hash_entry **p_entry;
 
+    if (ht->slots) {
+	oa_set(pool, ht, key, keylen, hval, value, lower);
+	return;
+    }
+
     p_entry = find_entry( pool, ht, key, keylen, value, &hval, entry_buf,
                           lower);
     if (*p_entry) {
@@ -306,6 +630,9 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
     it->index = 0;
     it->entry = NULL;
 
+    if (ht->slots)
+	return oa_next(ht, it);
+
     for (; it->index <= ht->rows; ++it->index) {
 	it->entry = ht->table[it->index];
 	if (it->entry) {
@@ -319,6 +646,11 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
 PJ_DEF(pj_hash_iterator_t*) pj_hash_next( pj_hash_table_t *ht, 
 					  pj_hash_iterator_t *it )
 {
+    if (ht->slots) {
+	++it->index;
+	return oa_next(ht, it);
+    }
+
     it->entry = it->entry->next;
     if (it->entry) {
 	return it;
@@ -337,7 +669,10 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_next( pj_hash_table_t *ht,
 PJ_DEF(void*) pj_hash_this( pj_hash_table_t *ht, pj_hash_iterator_t *it )
 {
     PJ_CHECK_STACK();
-    PJ_UNUSED_ARG(ht);
+
+    if (ht->slots)
+	return ((pj_hash_slot*)it->entry)->value;
+
     return it->entry->value;
 }
 
@@ -30,11 +30,26 @@
 
 #define PENDING_RETRY	2
 
-static void ioqueue_init( pj_ioqueue_t *ioqueue )
+/* The backend defines this to non-zero when recvmmsg()/sendmmsg() are
+ * available, otherwise batches are transferred one datagram at a time.
+ */
+#ifndef IOQUEUE_HAS_NATIVE_MMSG
+#   define IOQUEUE_HAS_NATIVE_MMSG	0
+#endif
+
+static void ioqueue_init( pj_ioqueue_t *ioqueue, const pj_ioqueue_cfg *cfg )
 {
     ioqueue->lock = NULL;
     ioqueue->auto_delete_lock = 0;
     ioqueue->default_concurrency = PJ_IOQUEUE_DEFAULT_ALLOW_CONCURRENCY;
+
+    if (cfg)
+	pj_memcpy(&ioqueue->cfg, cfg, sizeof(*cfg));
+    else
+	pj_ioqueue_cfg_default(&ioqueue->cfg);
+
+    if (ioqueue->cfg.max_events == 0)
+	ioqueue->cfg.max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
 }
 
 static pj_status_t ioqueue_destroy(pj_ioqueue_t *ioqueue)
@@ -47,6 +62,16 @@ static pj_status_t ioqueue_destroy(pj_ioqueue_t *ioqueue)
     return PJ_SUCCESS;
 }
 
+/*
+ * pj_ioqueue_cfg_default()
+ */
+PJ_DEF(void) pj_ioqueue_cfg_default(pj_ioqueue_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->epoll_flags = PJ_IOQUEUE_DEFAULT_EPOLL_FLAGS;
+    cfg->max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
+}
+
 /*
  * pj_ioqueue_set_lock()
  */
@@ -189,6 +214,115 @@ PJ_INLINE(int) key_has_pending_connect(pj_ioqueue_key_t *key)
 #endif
 
 
+/* Receive up to *count datagrams from the socket without blocking. On
+ * success, *count is set to the number of datagrams received, which is
+ * at least one.
+ */
+static pj_status_t sock_recvmmsg(pj_sock_t fd, pj_ioqueue_mmsg msg[],
+				 unsigned *count, unsigned flags)
+{
+#if IOQUEUE_HAS_NATIVE_MMSG
+    struct mmsghdr hdr[PJ_IOQUEUE_MAX_MMSG];
+    struct iovec iov[PJ_IOQUEUE_MAX_MMSG];
+    unsigned i;
+    int rc;
+
+    pj_bzero(hdr, *count * sizeof(hdr[0]));
+    for (i=0; i<*count; ++i) {
+	iov[i].iov_base = msg[i].buf;
+	iov[i].iov_len = msg[i].len;
+	hdr[i].msg_hdr.msg_iov = &iov[i];
+	hdr[i].msg_hdr.msg_iovlen = 1;
+	if (msg[i].addr) {
+	    hdr[i].msg_hdr.msg_name = msg[i].addr;
+	    hdr[i].msg_hdr.msg_namelen = msg[i].addrlen;
+	}
+    }
+
+    rc = recvmmsg(fd, hdr, *count, flags, NULL);
+    if (rc < 0)
+	return pj_get_netos_error();
+
+    for (i=0; i<(unsigned)rc; ++i) {
+	msg[i].len = hdr[i].msg_len;
+	msg[i].addrlen = hdr[i].msg_hdr.msg_namelen;
+    }
+    *count = rc;
+    return PJ_SUCCESS;
+#else
+    unsigned i;
+    pj_status_t status = PJ_SUCCESS;
+
+    for (i=0; i<*count; ++i) {
+	status = pj_sock_recvfrom(fd, msg[i].buf, &msg[i].len, flags,
+				  msg[i].addr, 
+				  (msg[i].addr? &msg[i].addrlen : NULL));
+	if (status != PJ_SUCCESS)
+	    break;
+    }
+
+    if (i == 0)
+	return status;
+
+    *count = i;
+    return PJ_SUCCESS;
+#endif
+}
+
+/* Send up to *count datagrams without blocking. On success, *count is set
+ * to the number of datagrams sent, which is at least one.
+ */
+static pj_status_t sock_sendmmsg(pj_sock_t fd, const pj_ioqueue_mmsg msg[],
+				 unsigned *count, unsigned flags)
+{
+#if IOQUEUE_HAS_NATIVE_MMSG
+    struct mmsghdr hdr[PJ_IOQUEUE_MAX_MMSG];
+    struct iovec iov[PJ_IOQUEUE_MAX_MMSG];
+    unsigned i;
+    int rc;
+
+    pj_bzero(hdr, *count * sizeof(hdr[0]));
+    for (i=0; i<*count; ++i) {
+	iov[i].iov_base = msg[i].buf;
+	iov[i].iov_len = msg[i].len;
+	hdr[i].msg_hdr.msg_iov = &iov[i];
+	hdr[i].msg_hdr.msg_iovlen = 1;
+	hdr[i].msg_hdr.msg_name = msg[i].addr;
+	hdr[i].msg_hdr.msg_namelen = msg[i].addr? msg[i].addrlen : 0;
+    }
+
+    rc = sendmmsg(fd, hdr, *count, flags | MSG_NOSIGNAL);
+    if (rc < 0)
+	return pj_get_netos_error();
+
+    *count = rc;
+    return PJ_SUCCESS;
+#else
+    unsigned i;
+    pj_status_t status = PJ_SUCCESS;
+
+    for (i=0; i<*count; ++i) {
+	pj_ssize_t sent = msg[i].len;
+
+	if (msg[i].addr) {
+	    status = pj_sock_sendto(fd, msg[i].buf, &sent, flags,
+				    msg[i].addr, msg[i].addrlen);
+	} else {
+	    status = pj_sock_send(fd, msg[i].buf, &sent, flags);
+	}
+	if (status != PJ_SUCCESS)
+	    break;
+    }
+
+    if (i == 0)
+	return status;
+
+    *count = i;
+    return PJ_SUCCESS;
+#endif
+}
+
+
 /*
  * ioqueue_dispatch_event()
  *
@@ -497,7 +631,15 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
 
         bytes_read = read_op->size;
 
-	if (read_op->op == PJ_IOQUEUE_OP_RECV_FROM) {
+	if (read_op->op == PJ_IOQUEUE_OP_RECV_MMSG) {
+	    unsigned count = (unsigned)read_op->size;
+
+	    /* For batch receive, report the number of datagrams */
+	    read_op->op = PJ_IOQUEUE_OP_NONE;
+	    rc = sock_recvmmsg(h->fd, (pj_ioqueue_mmsg*)read_op->buf, &count,
+			       read_op->flags);
+	    bytes_read = count;
+	} else if (read_op->op == PJ_IOQUEUE_OP_RECV_FROM) {
 	    read_op->op = PJ_IOQUEUE_OP_NONE;
 	    rc = pj_sock_recvfrom(h->fd, read_op->buf, &bytes_read, 
 				  read_op->flags,
@@ -820,6 +962,81 @@ PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
     return PJ_EPENDING;
 }
 
+/*
+ * pj_ioqueue_recvmmsg()
+ *
+ * Start asynchronous batch receive from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvmmsg( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+					 pj_ioqueue_mmsg msg[],
+					 unsigned *count,
+                                         pj_uint32_t flags)
+{
+    struct read_operation *read_op;
+
+    PJ_ASSERT_RETURN(key && op_key && msg && count && *count, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    read_op = (struct read_operation*)op_key;
+    read_op->op = PJ_IOQUEUE_OP_NONE;
+
+    if (*count > PJ_IOQUEUE_MAX_MMSG)
+	*count = PJ_IOQUEUE_MAX_MMSG;
+
+    /* Try to see if there's data immediately available. 
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0) {
+	pj_status_t status;
+	unsigned cnt = *count;
+
+	status = sock_recvmmsg(key->fd, msg, &cnt, flags);
+	if (status == PJ_SUCCESS) {
+	    /* Yes! Data is available! */
+	    *count = cnt;
+	    return PJ_SUCCESS;
+	} else {
+	    /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+	     * the error to caller.
+	     */
+	    if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+		return status;
+	}
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /*
+     * No data is immediately available.
+     * Must schedule asynchronous operation to the ioqueue.
+     */
+    read_op->op = PJ_IOQUEUE_OP_RECV_MMSG;
+    read_op->buf = msg;
+    read_op->size = *count;
+    read_op->flags = flags;
+    read_op->rmt_addr = NULL;
+    read_op->rmt_addrlen = NULL;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app. If we add bad handle to the set it will
+     * corrupt the ioqueue set. See #913
+     */
+    if (IS_CLOSING(key)) {
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+    pj_list_insert_before(&key->read_list, read_op);
+    ioqueue_add_to_set(key->ioqueue, key, READABLE_EVENT);
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EPENDING;
+}
+
 /*
  * pj_ioqueue_send()
  *
@@ -1080,6 +1297,48 @@ retry_on_restart:
     return PJ_EPENDING;
 }
 
+/*
+ * pj_ioqueue_sendmmsg()
+ *
+ * Send a batch of datagrams, without scheduling asynchronous operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendmmsg( pj_ioqueue_key_t *key,
+					 const pj_ioqueue_mmsg msg[],
+					 unsigned *count,
+                                         pj_uint32_t flags)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(key && msg && count && *count, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Sending now while there is pending write would break the order of
+     * the packets (see the note on the fast track in pj_ioqueue_sendto()).
+     */
+    if (!pj_list_empty(&key->write_list)) {
+	*count = 0;
+	return PJ_EBUSY;
+    }
+
+    if (*count > PJ_IOQUEUE_MAX_MMSG)
+	*count = PJ_IOQUEUE_MAX_MMSG;
+
+    status = sock_sendmmsg(key->fd, msg, count, flags);
+    if (status != PJ_SUCCESS) {
+	*count = 0;
+	if (status == PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+	    status = PJ_EBUSY;
+    }
+
+    return status;
+}
+
 #if PJ_HAS_TCP
 /*
  * Initiate overlapped accept() operation.
@@ -120,7 +120,8 @@ union operation_key
 #define DECLARE_COMMON_IOQUEUE                      \
     pj_lock_t          *lock;                       \
     pj_bool_t           auto_delete_lock;	    \
-    pj_bool_t		default_concurrency;
+    pj_bool_t		default_concurrency;	    \
+    pj_ioqueue_cfg	cfg;
 
 
 enum ioqueue_event_type
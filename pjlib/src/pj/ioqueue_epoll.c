@@ -24,6 +24,11 @@
  * API in _both_ Linux user-mode and kernel-mode.
  */
 
+/* For recvmmsg() and sendmmsg() */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
+
 #include <pj/ioqueue.h>
 #include <pj/os.h>
 #include <pj/lock.h>
@@ -42,9 +47,14 @@
      * Linux user mode
      */
 #   include <sys/epoll.h>
+#   include <sys/socket.h>
 #   include <errno.h>
 #   include <unistd.h>
 
+#   if defined(MSG_WAITFORONE)
+#	define IOQUEUE_HAS_NATIVE_MMSG	1
+#   endif
+
 #   define epoll_data		data.ptr
 #   define epoll_data_type	void*
 #   define ioctl_val_type	unsigned long
@@ -141,6 +151,14 @@
 #   define epoll_data_type	__u32
 #endif
 
+/* Older headers may not have these */
+#ifndef EPOLLONESHOT
+#   define EPOLLONESHOT		0
+#endif
+#ifndef EPOLLEXCLUSIVE
+#   define EPOLLEXCLUSIVE	0
+#endif
+
 #define THIS_FILE   "ioq_epoll"
 
 //#define TRACE_(expr) PJ_LOG(3,expr)
@@ -157,6 +175,9 @@
 struct pj_ioqueue_key_t
 {
     DECLARE_COMMON_KEY
+    pj_bool_t		     rearm_pending; /* One-shot key is being
+					       dispatched and will be
+					       re-armed by rearm_key() */
 };
 
 struct queue
@@ -165,6 +186,15 @@ struct queue
     enum ioqueue_event_type  event_type;
 };
 
+/* Buffers of a polling thread to retrieve and queue the events, sized
+ * from the max_events setting of the ioqueue.
+ */
+struct poll_buf
+{
+    struct epoll_event	    *events;
+    struct queue	    *queue;
+};
+
 /*
  * This describes the I/O queue.
  */
@@ -176,8 +206,14 @@ struct pj_ioqueue_t
     //pj_ioqueue_key_t	hlist;
     pj_ioqueue_key_t	active_list;    
     int			epfd;
-    //struct epoll_event *events;
-    //struct queue       *queue;
+    pj_uint32_t		epoll_flags;	/* EPOLLONESHOT/EPOLLEXCLUSIVE */
+
+    /* Several threads may poll the ioqueue at the same time, so each
+     * polling thread has its own buffers, allocated from poll_pool on
+     * its first poll.
+     */
+    pj_pool_t	       *poll_pool;
+    long		poll_buf_tls;
 
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     pj_mutex_t	       *ref_cnt_mutex;
@@ -211,11 +247,22 @@ PJ_DEF(const char*) pj_ioqueue_name(void)
 /*
  * pj_ioqueue_create()
  *
- * Create select ioqueue.
+ * Create epoll ioqueue.
  */
 PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool, 
                                        pj_size_t max_fd,
                                        pj_ioqueue_t **p_ioqueue)
+{
+    return pj_ioqueue_create2(pool, max_fd, NULL, p_ioqueue);
+}
+
+/*
+ * pj_ioqueue_create2()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create2( pj_pool_t *pool, 
+                                        pj_size_t max_fd,
+                                        const pj_ioqueue_cfg *cfg,
+                                        pj_ioqueue_t **p_ioqueue)
 {
     pj_ioqueue_t *ioqueue;
     pj_status_t rc;
@@ -232,12 +279,27 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
 
     ioqueue = pj_pool_alloc(pool, sizeof(pj_ioqueue_t));
 
-    ioqueue_init(ioqueue);
+    ioqueue_init(ioqueue, cfg);
 
     ioqueue->max = max_fd;
     ioqueue->count = 0;
     pj_list_init(&ioqueue->active_list);
 
+    /* One-shot re-arming needs the key to outlive the dispatch, which is
+     * only guaranteed with safe unregistration. EPOLLEXCLUSIVE can't be
+     * combined with EPOLLONESHOT.
+     */
+    ioqueue->epoll_flags = 0;
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    if (ioqueue->cfg.epoll_flags & PJ_IOQUEUE_EPOLL_ONESHOT)
+	ioqueue->epoll_flags = EPOLLONESHOT;
+#endif
+    if (ioqueue->epoll_flags == 0 &&
+	(ioqueue->cfg.epoll_flags & PJ_IOQUEUE_EPOLL_EXCLUSIVE))
+    {
+	ioqueue->epoll_flags = EPOLLEXCLUSIVE;
+    }
+
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     /* When safe unregistration is used (the default), we pre-create
      * all keys and put them in the free list.
@@ -286,19 +348,32 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
     if (rc != PJ_SUCCESS)
         return rc;
 
+    rc = pj_thread_local_alloc(&ioqueue->poll_buf_tls);
+    if (rc != PJ_SUCCESS) {
+	ioqueue_destroy(ioqueue);
+	return rc;
+    }
+
+    ioqueue->poll_pool = pj_pool_create(pool->factory, "ioqpoll%p",
+					ioqueue->cfg.max_events *
+					    (sizeof(struct epoll_event) +
+					     sizeof(struct queue)) + 64,
+					1024, NULL);
+    if (!ioqueue->poll_pool) {
+	pj_thread_local_free(ioqueue->poll_buf_tls);
+	ioqueue_destroy(ioqueue);
+	return PJ_ENOMEM;
+    }
+
     ioqueue->epfd = os_epoll_create(max_fd);
     if (ioqueue->epfd < 0) {
+	pj_pool_release(ioqueue->poll_pool);
+	pj_thread_local_free(ioqueue->poll_buf_tls);
 	ioqueue_destroy(ioqueue);
 	return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
     }
-    
-    /*ioqueue->events = pj_pool_calloc(pool, max_fd, sizeof(struct epoll_event));
-    PJ_ASSERT_RETURN(ioqueue->events != NULL, PJ_ENOMEM);
-
-    ioqueue->queue = pj_pool_calloc(pool, max_fd, sizeof(struct queue));
-    PJ_ASSERT_RETURN(ioqueue->queue != NULL, PJ_ENOMEM);
-   */
-    PJ_LOG(4, ("pjlib", "epoll I/O Queue created (%p)", ioqueue));
+    PJ_LOG(4, ("pjlib", "epoll I/O Queue created (%p), flags=0x%x",
+	       ioqueue, ioqueue->epoll_flags));
 
     *p_ioqueue = ioqueue;
     return PJ_SUCCESS;
@@ -320,6 +395,10 @@ PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
     os_close(ioqueue->epfd);
     ioqueue->epfd = 0;
 
+    pj_thread_local_free(ioqueue->poll_buf_tls);
+    pj_pool_release(ioqueue->poll_pool);
+    ioqueue->poll_pool = NULL;
+
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     /* Destroy reference counters */
     key = ioqueue->active_list.next;
@@ -410,6 +489,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
 	key = NULL;
 	goto on_return;
     }
+    key->rearm_pending = PJ_FALSE;
 
     /* Create key's mutex */
  /*   rc = pj_mutex_create_recursive(pool, NULL, &key->mutex);
@@ -419,9 +499,18 @@ PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
     }
 */
     /* os_epoll_ctl. */
-    ev.events = EPOLLIN | EPOLLERR;
+    ev.events = EPOLLIN | EPOLLERR | ioqueue->epoll_flags;
     ev.epoll_data = (epoll_data_type)key;
     status = os_epoll_ctl(ioqueue->epfd, EPOLL_CTL_ADD, sock, &ev);
+    if (status < 0 && errno == EINVAL &&
+	(ioqueue->epoll_flags & EPOLLEXCLUSIVE))
+    {
+	/* Kernel older than 4.5 doesn't support EPOLLEXCLUSIVE */
+	PJ_LOG(4, (THIS_FILE, "EPOLLEXCLUSIVE is not supported, disabled"));
+	ioqueue->epoll_flags &= ~EPOLLEXCLUSIVE;
+	ev.events = EPOLLIN | EPOLLERR | ioqueue->epoll_flags;
+	status = os_epoll_ctl(ioqueue->epfd, EPOLL_CTL_ADD, sock, &ev);
+    }
     if (status < 0) {
 	rc = pj_get_os_error();
 	pj_lock_destroy(key->lock);
@@ -581,6 +670,40 @@ PJ_DEF(pj_status_t) pj_ioqueue_unregister( pj_ioqueue_key_t *key)
     return PJ_SUCCESS;
 }
 
+/* Set the events to be monitored for the key. The key must be locked. */
+static void update_epoll_event_set( pj_ioqueue_t *ioqueue,
+                                    pj_ioqueue_key_t *key,
+                                    pj_uint32_t events)
+{
+    struct epoll_event ev;
+
+    ev.events = events | ioqueue->epoll_flags;
+    ev.epoll_data = (epoll_data_type)key;
+
+    if (ioqueue->epoll_flags & EPOLLEXCLUSIVE) {
+	/* EPOLLEXCLUSIVE is not allowed with EPOLL_CTL_MOD */
+	os_epoll_ctl( ioqueue->epfd, EPOLL_CTL_DEL, key->fd, &ev);
+	os_epoll_ctl( ioqueue->epfd, EPOLL_CTL_ADD, key->fd, &ev);
+    } else {
+	os_epoll_ctl( ioqueue->epfd, EPOLL_CTL_MOD, key->fd, &ev);
+    }
+}
+
+/* Get the events that the key is currently interested in, computed from
+ * all of its pending operations.
+ */
+static pj_uint32_t get_key_events(pj_ioqueue_key_t *key)
+{
+    pj_uint32_t events = EPOLLERR;
+
+    if (key_has_pending_read(key) || key_has_pending_accept(key))
+	events |= EPOLLIN;
+    if (key_has_pending_write(key) || key_has_pending_connect(key))
+	events |= EPOLLOUT;
+
+    return events;
+}
+
 /* ioqueue_remove_from_set()
  * This function is called from ioqueue_dispatch_event() to instruct
  * the ioqueue to remove the specified descriptor from ioqueue's descriptor
@@ -590,12 +713,14 @@ static void ioqueue_remove_from_set( pj_ioqueue_t *ioqueue,
                                      pj_ioqueue_key_t *key, 
                                      enum ioqueue_event_type event_type)
 {
-    if (event_type == WRITEABLE_EVENT) {
-	struct epoll_event ev;
+    /* With one-shot, the key is re-armed with the right events once the
+     * dispatching is done (see rearm_key()).
+     */
+    if (ioqueue->epoll_flags & EPOLLONESHOT)
+	return;
 
-	ev.events = EPOLLIN | EPOLLERR;
-	ev.epoll_data = (epoll_data_type)key;
-	os_epoll_ctl( ioqueue->epfd, EPOLL_CTL_MOD, key->fd, &ev);
+    if (event_type == WRITEABLE_EVENT) {
+	update_epoll_event_set(ioqueue, key, EPOLLIN | EPOLLERR);
     }	
 }
 
@@ -609,15 +734,43 @@ static void ioqueue_add_to_set( pj_ioqueue_t *ioqueue,
                                 pj_ioqueue_key_t *key,
                                 enum ioqueue_event_type event_type )
 {
-    if (event_type == WRITEABLE_EVENT) {
-	struct epoll_event ev;
-
-	ev.events = EPOLLIN | EPOLLOUT | EPOLLERR;
-	ev.epoll_data = (epoll_data_type)key;
-	os_epoll_ctl( ioqueue->epfd, EPOLL_CTL_MOD, key->fd, &ev);
+    if (ioqueue->epoll_flags & EPOLLONESHOT) {
+	/* The key may have been disarmed by an event reported while it had
+	 * no pending operation, so re-arm it for any kind of operation.
+	 * A key that is being dispatched will be re-armed with this
+	 * operation by the polling thread (see rearm_key()), so it doesn't
+	 * need to be modified twice.
+	 */
+	if (!key->rearm_pending)
+	    update_epoll_event_set(ioqueue, key, get_key_events(key));
+    } else if (event_type == WRITEABLE_EVENT) {
+	update_epoll_event_set(ioqueue, key, EPOLLIN | EPOLLOUT | EPOLLERR);
     }	
 }
 
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+/* Re-arm one-shot key after its event has been dispatched. */
+static void rearm_key(pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *key)
+{
+    /* The key's lock guards against the socket being closed (and its
+     * descriptor reused) by pj_ioqueue_unregister().
+     */
+    pj_ioqueue_lock_key(key);
+    key->rearm_pending = PJ_FALSE;
+    if (!IS_CLOSING(key)) {
+	pj_uint32_t events = get_key_events(key);
+
+	/* A key without pending operation is left disarmed (otherwise
+	 * a hangup would be reported over and over), it will be re-armed
+	 * when an operation is queued (see ioqueue_add_to_set()).
+	 */
+	if (events != EPOLLERR)
+	    update_epoll_event_set(ioqueue, key, events);
+    }
+    pj_ioqueue_unlock_key(key);
+}
+#endif
+
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
 /* Scan closing keys to be put to free list again */
 static void scan_closing_keys(pj_ioqueue_t *ioqueue)
@@ -645,29 +798,58 @@ static void scan_closing_keys(pj_ioqueue_t *ioqueue)
 }
 #endif
 
+/* Get the buffers of the calling thread, allocating them on its first
+ * poll.
+ */
+static struct poll_buf *get_poll_buf(pj_ioqueue_t *ioqueue)
+{
+    struct poll_buf *buf;
+
+    buf = (struct poll_buf*) pj_thread_local_get(ioqueue->poll_buf_tls);
+    if (buf)
+	return buf;
+
+    pj_lock_acquire(ioqueue->lock);
+    buf = PJ_POOL_ALLOC_T(ioqueue->poll_pool, struct poll_buf);
+    buf->events = (struct epoll_event*)
+		  pj_pool_calloc(ioqueue->poll_pool, ioqueue->cfg.max_events,
+				 sizeof(struct epoll_event));
+    buf->queue = (struct queue*)
+		 pj_pool_calloc(ioqueue->poll_pool, ioqueue->cfg.max_events,
+				sizeof(struct queue));
+    pj_lock_release(ioqueue->lock);
+
+    pj_thread_local_set(ioqueue->poll_buf_tls, buf);
+    return buf;
+}
+
 /*
  * pj_ioqueue_poll()
  *
  */
 PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 {
-    int i, count, processed;
+    int i, count, processed, nqueue;
     int msec;
-    //struct epoll_event *events = ioqueue->events;
-    //struct queue *queue = ioqueue->queue;
-    struct epoll_event events[PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL];
-    struct queue queue[PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL];
+    struct poll_buf *buf;
+    struct epoll_event *events;
+    struct queue *queue;
     pj_timestamp t1, t2;
     
     PJ_CHECK_STACK();
 
+    buf = get_poll_buf(ioqueue);
+    events = buf->events;
+    queue = buf->queue;
+
     msec = timeout ? PJ_TIME_VAL_MSEC(*timeout) : 9000;
 
     TRACE_((THIS_FILE, "start os_epoll_wait, msec=%d", msec));
     pj_get_timestamp(&t1);
  
     //count = os_epoll_wait( ioqueue->epfd, events, ioqueue->max, msec);
-    count = os_epoll_wait( ioqueue->epfd, events, PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL, msec);
+    count = os_epoll_wait( ioqueue->epfd, events, ioqueue->cfg.max_events,
+			   msec);
     if (count == 0) {
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     /* Check the closing keys only when there's no activity and when there are
@@ -694,7 +876,7 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     /* Lock ioqueue. */
     pj_lock_acquire(ioqueue->lock);
 
-    for (processed=0, i=0; i<count; ++i) {
+    for (processed=0, nqueue=0, i=0; i<count; ++i) {
 	pj_ioqueue_key_t *h = (pj_ioqueue_key_t*)(epoll_data_type)
 				events[i].epoll_data;
 
@@ -709,8 +891,9 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
 	    increment_counter(h);
 #endif
-	    queue[processed].key = h;
-	    queue[processed].event_type = READABLE_EVENT;
+	    queue[nqueue].key = h;
+	    queue[nqueue].event_type = READABLE_EVENT;
+	    ++nqueue;
 	    ++processed;
 	    continue;
 	}
@@ -723,8 +906,9 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
 	    increment_counter(h);
 #endif
-	    queue[processed].key = h;
-	    queue[processed].event_type = WRITEABLE_EVENT;
+	    queue[nqueue].key = h;
+	    queue[nqueue].event_type = WRITEABLE_EVENT;
+	    ++nqueue;
 	    ++processed;
 	    continue;
 	}
@@ -738,8 +922,9 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
 	    increment_counter(h);
 #endif
-	    queue[processed].key = h;
-	    queue[processed].event_type = WRITEABLE_EVENT;
+	    queue[nqueue].key = h;
+	    queue[nqueue].event_type = WRITEABLE_EVENT;
+	    ++nqueue;
 	    ++processed;
 	    continue;
 	}
@@ -758,23 +943,43 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
 		increment_counter(h);
 #endif
-		queue[processed].key = h;
-		queue[processed].event_type = EXCEPTION_EVENT;
+		queue[nqueue].key = h;
+		queue[nqueue].event_type = EXCEPTION_EVENT;
+		++nqueue;
 		++processed;
+		continue;
 	    } else if (key_has_pending_read(h) || key_has_pending_accept(h)) {
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
 		increment_counter(h);
 #endif
-		queue[processed].key = h;
-		queue[processed].event_type = READABLE_EVENT;
+		queue[nqueue].key = h;
+		queue[nqueue].event_type = READABLE_EVENT;
+		++nqueue;
 		++processed;
+		continue;
 	    }
-	    continue;
 	}
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+	/* With one-shot, the key is now disarmed even though the event didn't
+	 * match any pending operation (e.g. readable while only a write is
+	 * pending), so queue it to be re-armed as well.
+	 */
+	if ((ioqueue->epoll_flags & EPOLLONESHOT) && !IS_CLOSING(h)) {
+	    increment_counter(h);
+	    queue[nqueue].key = h;
+	    queue[nqueue].event_type = NO_EVENT;
+	    ++nqueue;
+	}
+#endif
     }
-    for (i=0; i<processed; ++i) {
+    for (i=0; i<nqueue; ++i) {
 	if (queue[i].key->grp_lock)
 	    pj_grp_lock_add_ref_dbg(queue[i].key->grp_lock, "ioqueue", 0);
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+	if (ioqueue->epoll_flags & EPOLLONESHOT)
+	    queue[i].key->rearm_pending = PJ_TRUE;
+#endif
     }
 
     PJ_RACE_ME(5);
@@ -784,7 +989,7 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     PJ_RACE_ME(5);
 
     /* Now process the events. */
-    for (i=0; i<processed; ++i) {
+    for (i=0; i<nqueue; ++i) {
 	switch (queue[i].event_type) {
         case READABLE_EVENT:
             ioqueue_dispatch_read_event(ioqueue, queue[i].key);
@@ -796,11 +1001,15 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
             ioqueue_dispatch_exception_event(ioqueue, queue[i].key);
             break;
         case NO_EVENT:
-            pj_assert(!"Invalid event!");
+	    /* Key only needs to be re-armed. */
+	    pj_assert(ioqueue->epoll_flags & EPOLLONESHOT);
             break;
         }
 
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
+	if (ioqueue->epoll_flags & EPOLLONESHOT)
+	    rearm_key(ioqueue, queue[i].key);
+
 	decrement_counter(queue[i].key);
 #endif
 
@@ -811,8 +1020,12 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 
     /* Special case:
      * When epoll returns > 0 but no descriptors are actually set!
+     * (not a problem with one-shot, as the keys are re-armed only for
+     * their pending operations).
      */
-    if (count > 0 && !processed && msec > 0) {
+    if (count > 0 && !processed && msec > 0 &&
+	(ioqueue->epoll_flags & EPOLLONESHOT) == 0)
+    {
 	pj_thread_sleep(msec);
     }
 
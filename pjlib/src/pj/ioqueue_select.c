@@ -183,6 +183,17 @@ static void rescan_fdset(pj_ioqueue_t *ioqueue)
 PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool, 
                                        pj_size_t max_fd,
                                        pj_ioqueue_t **p_ioqueue)
+{
+    return pj_ioqueue_create2(pool, max_fd, NULL, p_ioqueue);
+}
+
+/*
+ * pj_ioqueue_create2()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create2( pj_pool_t *pool, 
+                                        pj_size_t max_fd,
+                                        const pj_ioqueue_cfg *cfg,
+                                        pj_ioqueue_t **p_ioqueue)
 {
     pj_ioqueue_t *ioqueue;
     pj_lock_t *lock;
@@ -200,7 +211,11 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
 
     /* Create and init common ioqueue stuffs */
     ioqueue = PJ_POOL_ALLOC_T(pool, pj_ioqueue_t);
-    ioqueue_init(ioqueue);
+    ioqueue_init(ioqueue, cfg);
+
+    /* The events are scanned to a fixed size array in pj_ioqueue_poll() */
+    if (ioqueue->cfg.max_events > PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL)
+	ioqueue->cfg.max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
 
     ioqueue->max = (unsigned)max_fd;
     ioqueue->count = 0;
@@ -889,8 +904,8 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 	return 0;
     else if (count < 0)
 	return -pj_get_netos_error();
-    else if (count > PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL)
-        count = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
+    else if (count > (int)ioqueue->cfg.max_events)
+        count = ioqueue->cfg.max_events;
 
     /* Scan descriptor sets for event and add the events in the event
      * array to be processed later in this function. We do this so that
@@ -0,0 +1,2186 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/*
+ * ioqueue_uring.c
+ *
+ * This is the implementation of IOQueue framework using Linux io_uring.
+ *
+ * Unlike the select() and epoll backends, which emulate the proactor
+ * pattern on top of readiness notification (see ioqueue_common_abs.c),
+ * this backend hands the socket operations themselves (recv, recvfrom,
+ * send, sendto, accept and connect) to the kernel and reaps their
+ * completions. Operations started from inside a completion callback are
+ * only queued in the submission ring, and are submitted together with
+ * the next wait, so a busy poll cycle costs one io_uring_enter() call no
+ * matter how many packets it handles.
+ *
+ * Reads are always asynchronous. Writes are still attempted immediately
+ * (as with the other backends) unless PJ_IOQUEUE_ALWAYS_ASYNC is given,
+ * in which case they are batched with the rest of the submissions.
+ *
+ * Requires Linux 5.11 or later (IORING_FEAT_EXT_ARG).
+ */
+
+/* For recvmmsg() and sendmmsg() */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
+
+#include <pj/ioqueue.h>
+#include <pj/os.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/list.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/sock.h>
+#include <pj/compat/socket.h>
+
+#include <linux/io_uring.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#if !PJ_IOQUEUE_HAS_SAFE_UNREG
+#   error "ioqueue_uring requires PJ_IOQUEUE_HAS_SAFE_UNREG"
+#endif
+
+#define THIS_FILE   "ioq_uring"
+
+//#define TRACE_(expr) PJ_LOG(3,expr)
+#define TRACE_(expr)
+
+#define PENDING_RETRY	2
+
+/* Number of request slots to add to the ioqueue each time it runs out */
+#define SLOT_GROW	64
+
+/* Maximum time to wait for the cancelled requests of a key to complete
+ * when the key is unregistered, in msec.
+ */
+#define CANCEL_WAIT_TIMEOUT	5000
+
+/* The rings are shared with the kernel, and head/tail indexes must be
+ * accessed with acquire/release semantic.
+ */
+#define ring_load(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ring_store(p,v)		__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+struct uring_slot;
+
+/*
+ * Pending operation. This is overlaid on application's pj_ioqueue_op_key_t.
+ */
+struct uring_operation
+{
+    PJ_DECL_LIST_MEMBER(struct uring_operation);
+    pj_ioqueue_operation_e  op;
+
+    struct uring_slot	   *slot;	/* Kernel request, NULL if queued   */
+    char		   *buf;
+    pj_size_t		    size;
+    pj_ssize_t		    written;
+    unsigned		    flags;
+    pj_sockaddr_t	   *rmt_addr;
+    int			   *rmt_addrlen;
+    pj_sock_t		   *accept_fd;
+    pj_sockaddr_t	   *local_addr;
+    pj_sockaddr		    dst_addr;	/* Destination of sendto()	    */
+    int			    dst_addrlen;
+};
+
+/*
+ * Request submitted to the kernel. Slots belong to the ioqueue rather
+ * than to the application's op_key, so that the memory referenced by the
+ * kernel (message header, address) stays valid until the completion is
+ * reaped, even if the op_key has been freed after the key is unregistered.
+ */
+struct uring_slot
+{
+    PJ_DECL_LIST_MEMBER(struct uring_slot);
+    pj_ioqueue_key_t	   *key;
+    struct uring_operation *op;
+    pj_ioqueue_operation_e  op_type;
+    pj_bool_t		    orphaned;	/* Key unregistered/op cancelled    */
+    pj_bool_t		    cancel_pending; /* In ioqueue's cancel_slots    */
+    int			    res;	/* Result, if dispatching deferred  */
+    struct msghdr	    msg;
+    struct iovec	    iov;
+    pj_sockaddr		    addr;
+    socklen_t		    addrlen;
+};
+
+/*
+ * This describes each key.
+ */
+struct pj_ioqueue_key_t
+{
+    PJ_DECL_LIST_MEMBER(struct pj_ioqueue_key_t);
+    pj_ioqueue_t           *ioqueue;
+    pj_grp_lock_t 	   *grp_lock;
+    pj_lock_t              *lock;
+    pj_bool_t		    allow_concurrent;
+    pj_sock_t		    fd;
+    int                     fd_type;
+    void		   *user_data;
+    pj_ioqueue_callback	    cb;
+    struct uring_operation  read_list;
+    struct uring_operation  write_list;
+    struct uring_operation  accept_list;
+    int                     connecting;
+    struct uring_slot	   *connect_slot;
+
+    /* One reference for the registration plus one for each request
+     * that the kernel has not completed yet.
+     */
+    unsigned		    ref_count;
+
+    /* Number of requests whose completion has not been reaped, i.e. that
+     * the kernel may still be working on.
+     */
+    unsigned		    inflight;
+    pj_bool_t		    closing;
+    pj_time_val		    free_time;
+};
+
+/*
+ * This describes the I/O queue.
+ */
+struct pj_ioqueue_t
+{
+    pj_lock_t          *lock;
+    pj_bool_t           auto_delete_lock;
+    pj_bool_t		default_concurrency;
+    unsigned		max_events;
+
+    unsigned		max, count;
+    pj_ioqueue_key_t	active_list;
+    pj_ioqueue_key_t	closing_list;
+    pj_ioqueue_key_t	free_list;
+
+    /* Request slots */
+    pj_pool_t	       *slot_pool;
+    struct uring_slot	free_slots;
+
+    /* Completions reaped by pj_ioqueue_unregister(), to be dispatched by
+     * the next poll.
+     */
+    struct uring_slot	ready_slots;
+
+    /* Requests to be cancelled, for which no submission entry was
+     * available. The cancellation is queued once the ring has room.
+     */
+    struct uring_slot	cancel_slots;
+
+    /* Thread local flag, set while a thread is dispatching completions */
+    long		tls_id;
+
+    /* Writes were queued, submit them before poll returns */
+    pj_bool_t		flush_needed;
+
+    /* The ring */
+    int			ring_fd;
+    void	       *sq_ptr;
+    pj_size_t		sq_ptr_size;
+    void	       *cq_ptr;
+    pj_size_t		cq_ptr_size;
+    struct io_uring_sqe*sqes;
+    pj_size_t		sqes_size;
+
+    unsigned	       *sq_khead;
+    unsigned	       *sq_ktail;
+    unsigned		sq_mask;
+    unsigned		sq_entries;
+    unsigned		sq_tail;
+
+    unsigned	       *cq_khead;
+    unsigned	       *cq_ktail;
+    unsigned		cq_mask;
+    struct io_uring_cqe*cqes;
+};
+
+#define IS_CLOSING(key)  (key->closing)
+
+/* Scan closing keys to be put to free list again */
+static void scan_closing_keys(pj_ioqueue_t *ioqueue);
+
+static int sys_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+/* Returns the number of submitted entries, or negative errno */
+static int sys_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+			   unsigned flags, void *arg, pj_size_t argsz)
+{
+    int rc = (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			   flags, arg, argsz);
+    return rc < 0 ? -errno : rc;
+}
+
+/* Number of entries in the submission ring not yet seen by the kernel */
+PJ_INLINE(unsigned) sq_pending(pj_ioqueue_t *ioqueue)
+{
+    return ring_load(ioqueue->sq_ktail) - ring_load(ioqueue->sq_khead);
+}
+
+PJ_INLINE(unsigned) cq_ready(pj_ioqueue_t *ioqueue)
+{
+    return ring_load(ioqueue->cq_ktail) - *ioqueue->cq_khead;
+}
+
+/* Submit everything in the submission ring without waiting. */
+static void flush_sqes(pj_ioqueue_t *ioqueue)
+{
+    unsigned pending = sq_pending(ioqueue);
+    int rc;
+
+    if (pending == 0)
+	return;
+
+    rc = sys_uring_enter(ioqueue->ring_fd, pending, 0, 0, NULL, 0);
+    if (rc < 0 && rc != -EBUSY && rc != -EINTR) {
+	PJ_PERROR(4,(THIS_FILE, PJ_RETURN_OS_ERROR(-rc),
+		     "io_uring_enter() submit error"));
+    }
+}
+
+/* Check if the calling thread is dispatching completions of the ioqueue,
+ * in which case new requests are left for the poll to submit in one go.
+ */
+PJ_INLINE(pj_bool_t) is_dispatching(pj_ioqueue_t *ioqueue)
+{
+    return pj_thread_local_get(ioqueue->tls_id) != NULL;
+}
+
+/* Get a free submission entry. Must hold ioqueue's lock. */
+static struct io_uring_sqe *get_sqe(pj_ioqueue_t *ioqueue)
+{
+    struct io_uring_sqe *sqe;
+
+    if (ioqueue->sq_tail - ring_load(ioqueue->sq_khead) >=
+	ioqueue->sq_entries)
+    {
+	/* Ring is full, let the kernel consume it */
+	flush_sqes(ioqueue);
+	if (ioqueue->sq_tail - ring_load(ioqueue->sq_khead) >=
+	    ioqueue->sq_entries)
+	{
+	    return NULL;
+	}
+    }
+
+    sqe = &ioqueue->sqes[ioqueue->sq_tail & ioqueue->sq_mask];
+    pj_bzero(sqe, sizeof(*sqe));
+    return sqe;
+}
+
+/* Publish the entry returned by get_sqe(). Must hold ioqueue's lock. */
+PJ_INLINE(void) commit_sqe(pj_ioqueue_t *ioqueue)
+{
+    ++ioqueue->sq_tail;
+    ring_store(ioqueue->sq_ktail, ioqueue->sq_tail);
+}
+
+/* Allocate request slot. Must hold ioqueue's lock. */
+static struct uring_slot *alloc_slot(pj_ioqueue_t *ioqueue)
+{
+    struct uring_slot *slot;
+
+    if (pj_list_empty(&ioqueue->free_slots)) {
+	unsigned i;
+
+	for (i=0; i<SLOT_GROW; ++i) {
+	    slot = PJ_POOL_ZALLOC_T(ioqueue->slot_pool, struct uring_slot);
+	    if (!slot)
+		break;
+	    pj_list_push_back(&ioqueue->free_slots, slot);
+	}
+	if (pj_list_empty(&ioqueue->free_slots))
+	    return NULL;
+    }
+
+    slot = ioqueue->free_slots.next;
+    pj_list_erase(slot);
+    return slot;
+}
+
+/* Decrement the key's reference counter, and when the counter reach zero,
+ * move the key to closing list. Must hold ioqueue's lock.
+ */
+static void key_dec_ref(pj_ioqueue_key_t *key)
+{
+    pj_assert(key->ref_count > 0);
+    if (--key->ref_count == 0) {
+	pj_assert(key->closing == 1);
+	pj_gettickcount(&key->free_time);
+	key->free_time.msec += PJ_IOQUEUE_KEY_FREE_DELAY;
+	pj_time_val_normalize(&key->free_time);
+
+	pj_list_erase(key);
+	pj_list_push_back(&key->ioqueue->closing_list, key);
+    }
+}
+
+/* Release a request slot after its completion has been reaped. Must hold
+ * ioqueue's lock.
+ */
+static void release_slot(pj_ioqueue_t *ioqueue, struct uring_slot *slot)
+{
+    pj_ioqueue_key_t *key = slot->key;
+
+    slot->key = NULL;
+    slot->op = NULL;
+    pj_list_push_back(&ioqueue->free_slots, slot);
+    key_dec_ref(key);
+}
+
+/* Queue the cancel request of the slot. Must hold ioqueue's lock. */
+static pj_bool_t queue_cancel(pj_ioqueue_t *ioqueue, struct uring_slot *slot)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = get_sqe(ioqueue);
+    if (!sqe)
+	return PJ_FALSE;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (__u64)(pj_size_t)slot;
+    sqe->user_data = 0;
+    commit_sqe(ioqueue);
+    return PJ_TRUE;
+}
+
+/* Ask the kernel to cancel the request. The slot is released when its
+ * (cancelled) completion arrives. Must hold ioqueue's lock.
+ */
+static void cancel_slot(pj_ioqueue_t *ioqueue, struct uring_slot *slot)
+{
+    slot->orphaned = PJ_TRUE;
+    if (slot->op) {
+	slot->op->slot = NULL;
+	slot->op = NULL;
+    }
+
+    /* A request such as recv may never complete by itself, so keep the
+     * cancellation until it can be queued when the ring is full.
+     */
+    if (!slot->cancel_pending && !queue_cancel(ioqueue, slot)) {
+	slot->cancel_pending = PJ_TRUE;
+	pj_list_push_back(&ioqueue->cancel_slots, slot);
+    }
+}
+
+/* Queue the cancellations that couldn't be queued earlier. Must hold
+ * ioqueue's lock.
+ */
+static void queue_pending_cancels(pj_ioqueue_t *ioqueue)
+{
+    while (!pj_list_empty(&ioqueue->cancel_slots)) {
+	struct uring_slot *slot = ioqueue->cancel_slots.next;
+
+	if (!queue_cancel(ioqueue, slot))
+	    break;
+	pj_list_erase(slot);
+	slot->cancel_pending = PJ_FALSE;
+    }
+}
+
+/* Account a completion reaped from the completion ring. Must hold
+ * ioqueue's lock.
+ */
+static void slot_completed(struct uring_slot *slot)
+{
+    pj_assert(slot->key->inflight > 0);
+    --slot->key->inflight;
+
+    /* Nothing to cancel anymore */
+    if (slot->cancel_pending) {
+	pj_list_erase(slot);
+	slot->cancel_pending = PJ_FALSE;
+    }
+}
+
+/* Submit the operation to the kernel. Must hold key's lock. */
+static pj_status_t start_op(pj_ioqueue_key_t *key, struct uring_operation *op)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    struct io_uring_sqe *sqe;
+    struct uring_slot *slot;
+
+    pj_lock_acquire(ioqueue->lock);
+
+    sqe = get_sqe(ioqueue);
+    if (!sqe) {
+	pj_lock_release(ioqueue->lock);
+	return PJ_ETOOMANY;
+    }
+
+    slot = alloc_slot(ioqueue);
+    if (!slot) {
+	pj_lock_release(ioqueue->lock);
+	return PJ_ENOMEM;
+    }
+
+    slot->key = key;
+    slot->op = op;
+    slot->op_type = op->op;
+    slot->orphaned = PJ_FALSE;
+
+    sqe->fd = key->fd;
+    sqe->user_data = (__u64)(pj_size_t)slot;
+
+    switch (op->op) {
+    case PJ_IOQUEUE_OP_RECV:
+	sqe->opcode = IORING_OP_RECV;
+	sqe->addr = (__u64)(pj_size_t)op->buf;
+	sqe->len = (__u32)op->size;
+	sqe->msg_flags = op->flags;
+	break;
+    case PJ_IOQUEUE_OP_RECV_FROM:
+	slot->iov.iov_base = op->buf;
+	slot->iov.iov_len = op->size;
+	pj_bzero(&slot->msg, sizeof(slot->msg));
+	slot->msg.msg_name = &slot->addr;
+	slot->msg.msg_namelen = sizeof(slot->addr);
+	slot->msg.msg_iov = &slot->iov;
+	slot->msg.msg_iovlen = 1;
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->addr = (__u64)(pj_size_t)&slot->msg;
+	sqe->len = 1;
+	sqe->msg_flags = op->flags;
+	break;
+    case PJ_IOQUEUE_OP_RECV_MMSG:
+	/* The kernel has no batch receive request. Wait for the socket to
+	 * become readable instead, then drain it with recvmmsg().
+	 */
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->poll32_events = POLLIN;
+	break;
+    case PJ_IOQUEUE_OP_SEND:
+	sqe->opcode = IORING_OP_SEND;
+	sqe->addr = (__u64)(pj_size_t)(op->buf + op->written);
+	sqe->len = (__u32)(op->size - op->written);
+	sqe->msg_flags = op->flags | MSG_NOSIGNAL;
+	break;
+    case PJ_IOQUEUE_OP_SEND_TO:
+	slot->iov.iov_base = op->buf + op->written;
+	slot->iov.iov_len = op->size - op->written;
+	pj_memcpy(&slot->addr, &op->dst_addr, op->dst_addrlen);
+	pj_bzero(&slot->msg, sizeof(slot->msg));
+	slot->msg.msg_name = &slot->addr;
+	slot->msg.msg_namelen = op->dst_addrlen;
+	slot->msg.msg_iov = &slot->iov;
+	slot->msg.msg_iovlen = 1;
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->addr = (__u64)(pj_size_t)&slot->msg;
+	sqe->len = 1;
+	sqe->msg_flags = op->flags | MSG_NOSIGNAL;
+	break;
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+	slot->addrlen = sizeof(slot->addr);
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->addr = (__u64)(pj_size_t)&slot->addr;
+	sqe->addr2 = (__u64)(pj_size_t)&slot->addrlen;
+	break;
+#endif
+    default:
+	pj_assert(!"Invalid operation type!");
+	pj_list_push_back(&ioqueue->free_slots, slot);
+	pj_lock_release(ioqueue->lock);
+	return PJ_EBUG;
+    }
+
+    commit_sqe(ioqueue);
+    op->slot = slot;
+    ++key->ref_count;
+    ++key->inflight;
+
+    if (op->op == PJ_IOQUEUE_OP_SEND || op->op == PJ_IOQUEUE_OP_SEND_TO)
+	ioqueue->flush_needed = PJ_TRUE;
+
+    pj_lock_release(ioqueue->lock);
+
+    return PJ_SUCCESS;
+}
+
+/* For stream sockets, operations of the same kind are handed to the kernel
+ * one at a time to preserve the order of the byte stream. Start the next
+ * queued operation, if there is any. Must hold key's lock.
+ */
+static void start_next(pj_ioqueue_key_t *key, struct uring_operation *list)
+{
+    struct uring_operation *op;
+    pj_status_t status;
+
+    if (pj_list_empty(list) || list->next->slot != NULL)
+	return;
+
+    op = list->next;
+    status = start_op(key, op);
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(2,(THIS_FILE, status,
+		     "Unable to start queued operation on socket %d",
+		     key->fd));
+    }
+}
+
+/* Queue the operation to the key and submit it. */
+static pj_status_t queue_op(pj_ioqueue_key_t *key,
+			    struct uring_operation *list,
+			    struct uring_operation *op)
+{
+    pj_status_t status = PJ_SUCCESS;
+
+    op->slot = NULL;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app. See #913
+     */
+    if (IS_CLOSING(key)) {
+	pj_ioqueue_unlock_key(key);
+	op->op = PJ_IOQUEUE_OP_NONE;
+	return PJ_ECANCELLED;
+    }
+
+    pj_list_insert_before(list, op);
+    if (key->fd_type == pj_SOCK_DGRAM() || list->next == op) {
+	status = start_op(key, op);
+	if (status != PJ_SUCCESS) {
+	    pj_list_erase(op);
+	    op->op = PJ_IOQUEUE_OP_NONE;
+	}
+    }
+    pj_ioqueue_unlock_key(key);
+
+    if (status != PJ_SUCCESS)
+	return status;
+
+    if (!is_dispatching(key->ioqueue))
+	flush_sqes(key->ioqueue);
+
+    return PJ_EPENDING;
+}
+
+/*
+ * pj_ioqueue_name()
+ */
+PJ_DEF(const char*) pj_ioqueue_name(void)
+{
+    return "uring";
+}
+
+/* Map the rings shared with the kernel. */
+static pj_status_t init_ring(pj_ioqueue_t *ioqueue, unsigned entries)
+{
+    struct io_uring_params p;
+    unsigned *sq_array;
+    unsigned i;
+
+    pj_bzero(&p, sizeof(p));
+    p.flags = IORING_SETUP_CLAMP;
+
+    ioqueue->ring_fd = sys_uring_setup(entries, &p);
+    if (ioqueue->ring_fd < 0) {
+	ioqueue->ring_fd = -1;
+	return PJ_RETURN_OS_ERROR(errno);
+    }
+
+    if ((p.features & IORING_FEAT_EXT_ARG) == 0 ||
+	(p.features & IORING_FEAT_NODROP) == 0)
+    {
+	PJ_LOG(2,(THIS_FILE, "io_uring: kernel is too old (features=0x%x)",
+		  p.features));
+	return PJ_ENOTSUP;
+    }
+
+    ioqueue->sq_ptr_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ioqueue->cq_ptr_size = p.cq_off.cqes +
+			   p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+	if (ioqueue->cq_ptr_size > ioqueue->sq_ptr_size)
+	    ioqueue->sq_ptr_size = ioqueue->cq_ptr_size;
+	ioqueue->cq_ptr_size = ioqueue->sq_ptr_size;
+    }
+
+    ioqueue->sq_ptr = mmap(NULL, ioqueue->sq_ptr_size,
+			   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			   ioqueue->ring_fd, IORING_OFF_SQ_RING);
+    if (ioqueue->sq_ptr == MAP_FAILED) {
+	ioqueue->sq_ptr = NULL;
+	return PJ_RETURN_OS_ERROR(errno);
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+	ioqueue->cq_ptr = ioqueue->sq_ptr;
+    } else {
+	ioqueue->cq_ptr = mmap(NULL, ioqueue->cq_ptr_size,
+			       PROT_READ | PROT_WRITE,
+			       MAP_SHARED | MAP_POPULATE,
+			       ioqueue->ring_fd, IORING_OFF_CQ_RING);
+	if (ioqueue->cq_ptr == MAP_FAILED) {
+	    ioqueue->cq_ptr = NULL;
+	    return PJ_RETURN_OS_ERROR(errno);
+	}
+    }
+
+    ioqueue->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ioqueue->sqes = (struct io_uring_sqe*)
+		    mmap(NULL, ioqueue->sqes_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, ioqueue->ring_fd,
+			 IORING_OFF_SQES);
+    if (ioqueue->sqes == MAP_FAILED) {
+	ioqueue->sqes = NULL;
+	return PJ_RETURN_OS_ERROR(errno);
+    }
+
+    ioqueue->sq_khead = (unsigned*)((char*)ioqueue->sq_ptr + p.sq_off.head);
+    ioqueue->sq_ktail = (unsigned*)((char*)ioqueue->sq_ptr + p.sq_off.tail);
+    ioqueue->sq_mask = *(unsigned*)((char*)ioqueue->sq_ptr +
+				    p.sq_off.ring_mask);
+    ioqueue->sq_entries = p.sq_entries;
+    ioqueue->sq_tail = *ioqueue->sq_ktail;
+
+    /* Submission entries are always used in ring order */
+    sq_array = (unsigned*)((char*)ioqueue->sq_ptr + p.sq_off.array);
+    for (i=0; i<p.sq_entries; ++i)
+	sq_array[i] = i;
+
+    ioqueue->cq_khead = (unsigned*)((char*)ioqueue->cq_ptr + p.cq_off.head);
+    ioqueue->cq_ktail = (unsigned*)((char*)ioqueue->cq_ptr + p.cq_off.tail);
+    ioqueue->cq_mask = *(unsigned*)((char*)ioqueue->cq_ptr +
+				    p.cq_off.ring_mask);
+    ioqueue->cqes = (struct io_uring_cqe*)((char*)ioqueue->cq_ptr +
+					   p.cq_off.cqes);
+
+    return PJ_SUCCESS;
+}
+
+static void destroy_ring(pj_ioqueue_t *ioqueue)
+{
+    if (ioqueue->sqes)
+	munmap(ioqueue->sqes, ioqueue->sqes_size);
+    if (ioqueue->cq_ptr && ioqueue->cq_ptr != ioqueue->sq_ptr)
+	munmap(ioqueue->cq_ptr, ioqueue->cq_ptr_size);
+    if (ioqueue->sq_ptr)
+	munmap(ioqueue->sq_ptr, ioqueue->sq_ptr_size);
+    if (ioqueue->ring_fd >= 0)
+	close(ioqueue->ring_fd);
+
+    ioqueue->sqes = NULL;
+    ioqueue->cq_ptr = ioqueue->sq_ptr = NULL;
+    ioqueue->ring_fd = -1;
+}
+
+/* Release everything allocated by pj_ioqueue_create(). */
+static pj_status_t ioqueue_destroy(pj_ioqueue_t *ioqueue)
+{
+    pj_ioqueue_key_t *key;
+    pj_ioqueue_key_t *lists[3];
+    unsigned i;
+
+    destroy_ring(ioqueue);
+
+    lists[0] = &ioqueue->active_list;
+    lists[1] = &ioqueue->closing_list;
+    lists[2] = &ioqueue->free_list;
+    for (i=0; i<PJ_ARRAY_SIZE(lists); ++i) {
+	key = lists[i]->next;
+	while (key != lists[i]) {
+	    if (key->lock)
+		pj_lock_destroy(key->lock);
+	    key = key->next;
+	}
+    }
+
+    if (ioqueue->tls_id != -1) {
+	pj_thread_local_free(ioqueue->tls_id);
+	ioqueue->tls_id = -1;
+    }
+
+    if (ioqueue->slot_pool) {
+	pj_pool_release(ioqueue->slot_pool);
+	ioqueue->slot_pool = NULL;
+    }
+
+    if (ioqueue->auto_delete_lock && ioqueue->lock) {
+	pj_lock_release(ioqueue->lock);
+	pj_lock_destroy(ioqueue->lock);
+	ioqueue->lock = NULL;
+    }
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_cfg_default()
+ */
+PJ_DEF(void) pj_ioqueue_cfg_default(pj_ioqueue_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->epoll_flags = PJ_IOQUEUE_DEFAULT_EPOLL_FLAGS;
+    cfg->max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
+}
+
+/*
+ * pj_ioqueue_create()
+ *
+ * Create io_uring ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
+                                       pj_size_t max_fd,
+                                       pj_ioqueue_t **p_ioqueue)
+{
+    return pj_ioqueue_create2(pool, max_fd, NULL, p_ioqueue);
+}
+
+/*
+ * pj_ioqueue_create2()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create2( pj_pool_t *pool,
+                                        pj_size_t max_fd,
+                                        const pj_ioqueue_cfg *cfg,
+                                        pj_ioqueue_t **p_ioqueue)
+{
+    pj_ioqueue_t *ioqueue;
+    pj_lock_t *lock;
+    pj_status_t rc;
+    unsigned i;
+
+    /* Check that arguments are valid. */
+    PJ_ASSERT_RETURN(pool != NULL && p_ioqueue != NULL &&
+                     max_fd > 0, PJ_EINVAL);
+
+    /* Check that size of pj_ioqueue_op_key_t is sufficient */
+    PJ_ASSERT_RETURN(sizeof(pj_ioqueue_op_key_t)-sizeof(void*) >=
+                     sizeof(struct uring_operation), PJ_EBUG);
+
+    ioqueue = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_t);
+    ioqueue->default_concurrency = PJ_IOQUEUE_DEFAULT_ALLOW_CONCURRENCY;
+    ioqueue->max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
+    if (cfg && cfg->max_events && cfg->max_events < ioqueue->max_events)
+	ioqueue->max_events = cfg->max_events;
+    ioqueue->max = (unsigned)max_fd;
+    ioqueue->ring_fd = -1;
+    ioqueue->tls_id = -1;
+    pj_list_init(&ioqueue->active_list);
+    pj_list_init(&ioqueue->closing_list);
+    pj_list_init(&ioqueue->free_list);
+    pj_list_init(&ioqueue->free_slots);
+    pj_list_init(&ioqueue->ready_slots);
+    pj_list_init(&ioqueue->cancel_slots);
+
+    rc = pj_lock_create_simple_mutex(pool, "ioq%p", &lock);
+    if (rc != PJ_SUCCESS)
+	return rc;
+
+    rc = pj_ioqueue_set_lock(ioqueue, lock, PJ_TRUE);
+    if (rc != PJ_SUCCESS) {
+	pj_lock_destroy(lock);
+        return rc;
+    }
+
+    rc = pj_thread_local_alloc(&ioqueue->tls_id);
+    if (rc != PJ_SUCCESS) {
+	ioqueue->tls_id = -1;
+	goto on_error;
+    }
+
+    /* Pre-create all keys according to max_fd */
+    for (i=0; i<max_fd; ++i) {
+	pj_ioqueue_key_t *key;
+
+	key = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_key_t);
+	rc = pj_lock_create_recursive_mutex(pool, NULL, &key->lock);
+	if (rc != PJ_SUCCESS)
+	    goto on_error;
+
+	pj_list_push_back(&ioqueue->free_list, key);
+    }
+
+    /* Request slots are recycled, but their number depends on the number
+     * of operations in progress, so they get their own pool.
+     */
+    ioqueue->slot_pool = pj_pool_create(pool->factory, "ioqslot%p",
+					SLOT_GROW * sizeof(struct uring_slot),
+					SLOT_GROW * sizeof(struct uring_slot),
+					NULL);
+    if (!ioqueue->slot_pool) {
+	rc = PJ_ENOMEM;
+	goto on_error;
+    }
+
+    rc = init_ring(ioqueue, PJ_IOQUEUE_URING_ENTRIES);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    PJ_LOG(4, ("pjlib", "io_uring I/O Queue created (%p), %u entries",
+	       ioqueue, ioqueue->sq_entries));
+
+    *p_ioqueue = ioqueue;
+    return PJ_SUCCESS;
+
+on_error:
+    pj_lock_acquire(ioqueue->lock);
+    ioqueue_destroy(ioqueue);
+    return rc;
+}
+
+/*
+ * pj_ioqueue_destroy()
+ *
+ * Destroy ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
+{
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ioqueue->ring_fd >= 0, PJ_EINVALIDOP);
+
+    pj_lock_acquire(ioqueue->lock);
+
+    /* Closing the ring cancels all requests that are still in progress */
+    return ioqueue_destroy(ioqueue);
+}
+
+/*
+ * pj_ioqueue_set_lock()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_lock( pj_ioqueue_t *ioqueue,
+					 pj_lock_t *lock,
+					 pj_bool_t auto_delete )
+{
+    PJ_ASSERT_RETURN(ioqueue && lock, PJ_EINVAL);
+
+    if (ioqueue->auto_delete_lock && ioqueue->lock) {
+        pj_lock_destroy(ioqueue->lock);
+    }
+
+    ioqueue->lock = lock;
+    ioqueue->auto_delete_lock = auto_delete;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_default_concurrency( pj_ioqueue_t *ioqueue,
+							pj_bool_t allow)
+{
+    PJ_ASSERT_RETURN(ioqueue != NULL, PJ_EINVAL);
+    ioqueue->default_concurrency = allow;
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_register_sock()
+ *
+ * Register a socket to ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
+					      pj_ioqueue_t *ioqueue,
+					      pj_sock_t sock,
+					      pj_grp_lock_t *grp_lock,
+					      void *user_data,
+					      const pj_ioqueue_callback *cb,
+                                              pj_ioqueue_key_t **p_key)
+{
+    pj_ioqueue_key_t *key = NULL;
+    pj_uint32_t value;
+    int optlen;
+    pj_status_t rc = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(pool && ioqueue && sock != PJ_INVALID_SOCKET &&
+                     cb && p_key, PJ_EINVAL);
+
+    pj_lock_acquire(ioqueue->lock);
+
+    if (ioqueue->count >= ioqueue->max) {
+        rc = PJ_ETOOMANY;
+	TRACE_((THIS_FILE, "pj_ioqueue_register_sock error: too many files"));
+	goto on_return;
+    }
+
+    /* Set socket to nonblocking, for the direct send path. */
+    value = 1;
+    if (ioctl(sock, FIONBIO, &value)) {
+        rc = pj_get_netos_error();
+	goto on_return;
+    }
+
+    /* Scan closing_keys first to let them come back to free_list */
+    scan_closing_keys(ioqueue);
+
+    if (pj_list_empty(&ioqueue->free_list)) {
+	rc = PJ_ETOOMANY;
+	goto on_return;
+    }
+
+    key = ioqueue->free_list.next;
+    pj_list_erase(key);
+
+    key->ioqueue = ioqueue;
+    key->fd = sock;
+    key->user_data = user_data;
+    pj_list_init(&key->read_list);
+    pj_list_init(&key->write_list);
+    pj_list_init(&key->accept_list);
+    key->connecting = 0;
+    key->connect_slot = NULL;
+    pj_memcpy(&key->cb, cb, sizeof(pj_ioqueue_callback));
+    key->ref_count = 1;
+    key->inflight = 0;
+    key->closing = 0;
+    key->allow_concurrent = ioqueue->default_concurrency;
+
+    /* Get socket type. Datagram sockets may have several operations of
+     * the same kind in progress.
+     */
+    optlen = sizeof(key->fd_type);
+    rc = pj_sock_getsockopt(sock, pj_SOL_SOCKET(), pj_SO_TYPE(),
+                            &key->fd_type, &optlen);
+    if (rc != PJ_SUCCESS)
+        key->fd_type = pj_SOCK_STREAM();
+    rc = PJ_SUCCESS;
+
+    key->grp_lock = grp_lock;
+    if (key->grp_lock) {
+	pj_grp_lock_add_ref_dbg(key->grp_lock, "ioqueue", 0);
+    }
+
+    /* Register */
+    pj_list_insert_before(&ioqueue->active_list, key);
+    ++ioqueue->count;
+
+on_return:
+    *p_key = key;
+    pj_lock_release(ioqueue->lock);
+
+    return rc;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock( pj_pool_t *pool,
+					      pj_ioqueue_t *ioqueue,
+					      pj_sock_t sock,
+					      void *user_data,
+					      const pj_ioqueue_callback *cb,
+					      pj_ioqueue_key_t **p_key)
+{
+    return pj_ioqueue_register_sock2(pool, ioqueue, sock, NULL, user_data,
+                                     cb, p_key);
+}
+
+/* Cancel all requests of the operations in the list. Must hold key's
+ * and ioqueue's lock.
+ */
+static void cancel_list(pj_ioqueue_t *ioqueue, struct uring_operation *list)
+{
+    struct uring_operation *op = list->next;
+
+    while (op != list) {
+	struct uring_operation *next = op->next;
+
+	if (op->slot)
+	    cancel_slot(ioqueue, op->slot);
+	op->op = PJ_IOQUEUE_OP_NONE;
+	op = next;
+    }
+    pj_list_init(list);
+}
+
+/* Wait until the kernel has completed all requests of the key, which
+ * must have been cancelled. The completions of other keys reaped here are
+ * kept for the next poll to dispatch. Must hold key's lock.
+ */
+static void wait_key_requests(pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    pj_time_val end_time;
+
+    pj_gettickcount(&end_time);
+    end_time.msec += CANCEL_WAIT_TIMEOUT;
+    pj_time_val_normalize(&end_time);
+
+    pj_lock_acquire(ioqueue->lock);
+    while (key->inflight) {
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	pj_time_val now;
+	unsigned head, tail;
+
+	head = *ioqueue->cq_khead;
+	tail = ring_load(ioqueue->cq_ktail);
+	for (; head != tail; ++head) {
+	    struct io_uring_cqe *cqe = &ioqueue->cqes[head & ioqueue->cq_mask];
+	    struct uring_slot *slot = (struct uring_slot*)(pj_size_t)
+				      cqe->user_data;
+
+	    /* Completion of a cancel or wake up request */
+	    if (slot == NULL)
+		continue;
+
+	    slot_completed(slot);
+	    if (slot->orphaned || IS_CLOSING(slot->key)) {
+		release_slot(ioqueue, slot);
+	    } else {
+		slot->res = cqe->res;
+		pj_list_push_back(&ioqueue->ready_slots, slot);
+	    }
+	}
+	ring_store(ioqueue->cq_khead, head);
+
+	if (key->inflight == 0)
+	    break;
+
+	pj_gettickcount(&now);
+	if (PJ_TIME_VAL_GTE(now, end_time)) {
+	    PJ_LOG(2,(THIS_FILE, "Key %p still has %u request(s) in the "
+		      "kernel after %d ms, not waiting anymore",
+		      key, key->inflight, CANCEL_WAIT_TIMEOUT));
+	    break;
+	}
+
+	/* Reaping the completions has made room for the cancellations
+	 * that couldn't be submitted before.
+	 */
+	queue_pending_cancels(ioqueue);
+
+	/* The completions may also be reaped by a polling thread, so wait
+	 * for a short while only before checking again.
+	 */
+	pj_lock_release(ioqueue->lock);
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = 10 * 1000000;
+	pj_bzero(&arg, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+	arg.ts = (__u64)(pj_size_t)&ts;
+	sys_uring_enter(ioqueue->ring_fd, sq_pending(ioqueue), 1,
+			IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+			&arg, sizeof(arg));
+
+	pj_lock_acquire(ioqueue->lock);
+    }
+
+    /* Wake up the polling thread to dispatch the completions kept */
+    if (!pj_list_empty(&ioqueue->ready_slots)) {
+	struct io_uring_sqe *sqe = get_sqe(ioqueue);
+
+	if (sqe) {
+	    sqe->opcode = IORING_OP_NOP;
+	    sqe->user_data = 0;
+	    commit_sqe(ioqueue);
+	}
+    }
+    pj_lock_release(ioqueue->lock);
+
+    flush_sqes(ioqueue);
+}
+
+/*
+ * pj_ioqueue_unregister()
+ *
+ * Unregister handle from ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_unregister( pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue;
+
+    PJ_ASSERT_RETURN(key != NULL, PJ_EINVAL);
+
+    ioqueue = key->ioqueue;
+
+    /* Lock the key to make sure no callback is simultaneously modifying
+     * the key. We need to lock the key before ioqueue here to prevent
+     * deadlock.
+     */
+    pj_ioqueue_lock_key(key);
+
+    /* Also lock ioqueue */
+    pj_lock_acquire(ioqueue->lock);
+
+    pj_assert(ioqueue->count > 0);
+    --ioqueue->count;
+
+    /* Mark key is closing, and orphan all requests still in the kernel.
+     * Their completions will be discarded.
+     */
+    key->closing = 1;
+    cancel_list(ioqueue, &key->read_list);
+    cancel_list(ioqueue, &key->write_list);
+    cancel_list(ioqueue, &key->accept_list);
+    if (key->connect_slot) {
+	cancel_slot(ioqueue, key->connect_slot);
+	key->connect_slot = NULL;
+    }
+    key->connecting = 0;
+
+    pj_lock_release(ioqueue->lock);
+
+    /* Submit the cancellations now */
+    flush_sqes(ioqueue);
+
+    /* The application may free the buffers of the cancelled operations
+     * as soon as this function returns, so wait until the kernel is done
+     * with them.
+     */
+    wait_key_requests(key);
+
+    /* Close the socket. */
+    pj_sock_close(key->fd);
+
+    /* Drop the registration reference. */
+    pj_lock_acquire(ioqueue->lock);
+    key_dec_ref(key);
+    pj_lock_release(ioqueue->lock);
+
+    /* Done. */
+    if (key->grp_lock) {
+	/* just dec_ref and unlock. we will set grp_lock to NULL
+	 * elsewhere */
+	pj_grp_lock_t *grp_lock = key->grp_lock;
+	// Don't set grp_lock to NULL otherwise the other thread
+	// will crash. Just leave it as dangling pointer, but this
+	// should be safe
+	//key->grp_lock = NULL;
+	pj_grp_lock_dec_ref_dbg(grp_lock, "ioqueue", 0);
+	pj_grp_lock_release(grp_lock);
+    } else {
+	pj_ioqueue_unlock_key(key);
+    }
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_get_user_data()
+ *
+ * Obtain value associated with a key.
+ */
+PJ_DEF(void*) pj_ioqueue_get_user_data( pj_ioqueue_key_t *key )
+{
+    PJ_ASSERT_RETURN(key != NULL, NULL);
+    return key->user_data;
+}
+
+/*
+ * pj_ioqueue_set_user_data()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_user_data( pj_ioqueue_key_t *key,
+                                              void *user_data,
+                                              void **old_data)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    if (old_data)
+        *old_data = key->user_data;
+    key->user_data = user_data;
+
+    return PJ_SUCCESS;
+}
+
+/* Scan closing keys to be put to free list again */
+static void scan_closing_keys(pj_ioqueue_t *ioqueue)
+{
+    pj_time_val now;
+    pj_ioqueue_key_t *h;
+
+    pj_gettickcount(&now);
+    h = ioqueue->closing_list.next;
+    while (h != &ioqueue->closing_list) {
+	pj_ioqueue_key_t *next = h->next;
+
+	pj_assert(h->closing != 0 && h->ref_count == 0);
+
+	if (PJ_TIME_VAL_GTE(now, h->free_time)) {
+	    pj_list_erase(h);
+	    // Don't set grp_lock to NULL otherwise the other thread
+	    // will crash. Just leave it as dangling pointer, but this
+	    // should be safe
+	    //h->grp_lock = NULL;
+	    pj_list_push_back(&ioqueue->free_list, h);
+	}
+	h = next;
+    }
+}
+
+/* Receive up to *count datagrams without blocking. */
+static pj_status_t sock_recvmmsg(pj_sock_t fd, pj_ioqueue_mmsg msg[],
+				 unsigned *count, unsigned flags)
+{
+    struct mmsghdr hdr[PJ_IOQUEUE_MAX_MMSG];
+    struct iovec iov[PJ_IOQUEUE_MAX_MMSG];
+    unsigned i;
+    int rc;
+
+    pj_bzero(hdr, *count * sizeof(hdr[0]));
+    for (i=0; i<*count; ++i) {
+	iov[i].iov_base = msg[i].buf;
+	iov[i].iov_len = msg[i].len;
+	hdr[i].msg_hdr.msg_iov = &iov[i];
+	hdr[i].msg_hdr.msg_iovlen = 1;
+	if (msg[i].addr) {
+	    hdr[i].msg_hdr.msg_name = msg[i].addr;
+	    hdr[i].msg_hdr.msg_namelen = msg[i].addrlen;
+	}
+    }
+
+    rc = recvmmsg(fd, hdr, *count, flags | MSG_DONTWAIT, NULL);
+    if (rc < 0)
+	return pj_get_netos_error();
+
+    for (i=0; i<(unsigned)rc; ++i) {
+	msg[i].len = hdr[i].msg_len;
+	msg[i].addrlen = hdr[i].msg_hdr.msg_namelen;
+    }
+    *count = rc;
+    return PJ_SUCCESS;
+}
+
+/* Call the completion callback of an operation, honouring the key's
+ * concurrency setting. Called with key's lock held, returns with the lock
+ * released.
+ */
+static void call_read_cb(pj_ioqueue_key_t *h, struct uring_operation *op,
+			 pj_ssize_t bytes_read)
+{
+    pj_bool_t has_lock;
+
+    /* Unlock; from this point we don't need to hold key's mutex
+     * (unless concurrency is disabled, which in this case we should
+     * hold the mutex while calling the callback) */
+    if (h->allow_concurrent) {
+	/* concurrency may be changed while we're in the callback, so
+	 * save it to a flag.
+	 */
+	has_lock = PJ_FALSE;
+	pj_ioqueue_unlock_key(h);
+	PJ_RACE_ME(5);
+    } else {
+	has_lock = PJ_TRUE;
+    }
+
+    if (h->cb.on_read_complete && !IS_CLOSING(h)) {
+	(*h->cb.on_read_complete)(h, (pj_ioqueue_op_key_t*)op, bytes_read);
+    }
+
+    if (has_lock) {
+	pj_ioqueue_unlock_key(h);
+    }
+}
+
+static void call_write_cb(pj_ioqueue_key_t *h, struct uring_operation *op,
+			  pj_ssize_t bytes_sent)
+{
+    pj_bool_t has_lock;
+
+    if (h->allow_concurrent) {
+	has_lock = PJ_FALSE;
+	pj_ioqueue_unlock_key(h);
+	PJ_RACE_ME(5);
+    } else {
+	has_lock = PJ_TRUE;
+    }
+
+    if (h->cb.on_write_complete && !IS_CLOSING(h)) {
+	(*h->cb.on_write_complete)(h, (pj_ioqueue_op_key_t*)op, bytes_sent);
+    }
+
+    if (has_lock) {
+	pj_ioqueue_unlock_key(h);
+    }
+}
+
+/* Process one completion reaped from the ring. */
+static pj_bool_t dispatch_completion(pj_ioqueue_t *ioqueue,
+				     struct uring_slot *slot,
+				     int res)
+{
+    pj_ioqueue_key_t *h = slot->key;
+    struct uring_operation *op;
+    pj_bool_t has_lock;
+
+    pj_lock_acquire(ioqueue->lock);
+    if (slot->orphaned || IS_CLOSING(h)) {
+	release_slot(ioqueue, slot);
+	pj_lock_release(ioqueue->lock);
+	return PJ_FALSE;
+    }
+    if (h->grp_lock)
+	pj_grp_lock_add_ref_dbg(h->grp_lock, "ioqueue", 0);
+    pj_lock_release(ioqueue->lock);
+
+    PJ_RACE_ME(5);
+
+    pj_ioqueue_lock_key(h);
+
+    /* The key may have been unregistered or the operation cancelled
+     * while we were waiting for the lock.
+     */
+    if (slot->orphaned || IS_CLOSING(h)) {
+	pj_ioqueue_unlock_key(h);
+	goto on_done;
+    }
+
+    op = slot->op;
+    if (op)
+	op->slot = NULL;
+
+    switch (slot->op_type) {
+    case PJ_IOQUEUE_OP_RECV:
+    case PJ_IOQUEUE_OP_RECV_FROM:
+	{
+	    pj_ssize_t bytes_read;
+
+	    pj_list_erase(op);
+	    op->op = PJ_IOQUEUE_OP_NONE;
+
+	    if (res >= 0) {
+		bytes_read = res;
+		if (slot->op_type == PJ_IOQUEUE_OP_RECV_FROM &&
+		    op->rmt_addr && op->rmt_addrlen)
+		{
+		    int addrlen = (int)slot->msg.msg_namelen;
+		    if (addrlen > *op->rmt_addrlen)
+			addrlen = *op->rmt_addrlen;
+		    pj_memcpy(op->rmt_addr, &slot->addr, addrlen);
+		    *op->rmt_addrlen = (int)slot->msg.msg_namelen;
+		}
+	    } else {
+		bytes_read = -PJ_RETURN_OS_ERROR(-res);
+	    }
+
+	    if (h->fd_type != pj_SOCK_DGRAM())
+		start_next(h, &h->read_list);
+
+	    call_read_cb(h, op, bytes_read);
+	}
+	break;
+
+    case PJ_IOQUEUE_OP_RECV_MMSG:
+	{
+	    pj_ssize_t bytes_read;
+	    unsigned cnt = (unsigned)op->size;
+	    pj_status_t status;
+
+	    if (res >= 0) {
+		status = sock_recvmmsg(h->fd, (pj_ioqueue_mmsg*)op->buf,
+				       &cnt, op->flags);
+		/* Somebody else has drained the socket, wait again */
+		if (status == PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL) &&
+		    start_op(h, op) == PJ_SUCCESS)
+		{
+		    pj_ioqueue_unlock_key(h);
+		    break;
+		}
+		bytes_read = (status == PJ_SUCCESS) ? (pj_ssize_t)cnt :
+						      -status;
+	    } else {
+		bytes_read = -PJ_RETURN_OS_ERROR(-res);
+	    }
+
+	    pj_list_erase(op);
+	    op->op = PJ_IOQUEUE_OP_NONE;
+
+	    call_read_cb(h, op, bytes_read);
+	}
+	break;
+
+    case PJ_IOQUEUE_OP_SEND:
+    case PJ_IOQUEUE_OP_SEND_TO:
+	{
+	    pj_ssize_t bytes_sent;
+
+	    if (res >= 0) {
+		op->written += res;
+
+		/* Partial write on stream, send the remaining */
+		if (h->fd_type != pj_SOCK_DGRAM() && res > 0 &&
+		    op->written < (pj_ssize_t)op->size &&
+		    start_op(h, op) == PJ_SUCCESS)
+		{
+		    pj_ioqueue_unlock_key(h);
+		    break;
+		}
+		bytes_sent = op->written;
+	    } else {
+		bytes_sent = -PJ_RETURN_OS_ERROR(-res);
+	    }
+
+	    pj_list_erase(op);
+	    op->op = PJ_IOQUEUE_OP_NONE;
+
+	    if (h->fd_type != pj_SOCK_DGRAM())
+		start_next(h, &h->write_list);
+
+	    call_write_cb(h, op, bytes_sent);
+	}
+	break;
+
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+	{
+	    pj_status_t status = PJ_SUCCESS;
+
+	    pj_list_erase(op);
+	    op->op = PJ_IOQUEUE_OP_NONE;
+
+	    if (res >= 0) {
+		*op->accept_fd = res;
+		if (op->rmt_addr && op->rmt_addrlen) {
+		    int addrlen = (int)slot->addrlen;
+		    if (addrlen > *op->rmt_addrlen)
+			addrlen = *op->rmt_addrlen;
+		    pj_memcpy(op->rmt_addr, &slot->addr, addrlen);
+		    *op->rmt_addrlen = (int)slot->addrlen;
+		}
+		if (op->local_addr) {
+		    status = pj_sock_getsockname(res, op->local_addr,
+						 op->rmt_addrlen);
+		}
+	    } else {
+		*op->accept_fd = PJ_INVALID_SOCKET;
+		status = PJ_RETURN_OS_ERROR(-res);
+	    }
+
+	    if (h->allow_concurrent) {
+		has_lock = PJ_FALSE;
+		pj_ioqueue_unlock_key(h);
+		PJ_RACE_ME(5);
+	    } else {
+		has_lock = PJ_TRUE;
+	    }
+
+	    if (h->cb.on_accept_complete && !IS_CLOSING(h)) {
+		(*h->cb.on_accept_complete)(h, (pj_ioqueue_op_key_t*)op,
+					    *op->accept_fd, status);
+	    }
+
+	    if (has_lock) {
+		pj_ioqueue_unlock_key(h);
+	    }
+	}
+	break;
+
+    case PJ_IOQUEUE_OP_CONNECT:
+	{
+	    pj_status_t status;
+
+	    h->connecting = 0;
+	    h->connect_slot = NULL;
+	    status = (res == 0) ? PJ_SUCCESS : PJ_RETURN_OS_ERROR(-res);
+
+	    if (h->allow_concurrent) {
+		has_lock = PJ_FALSE;
+		pj_ioqueue_unlock_key(h);
+		PJ_RACE_ME(5);
+	    } else {
+		has_lock = PJ_TRUE;
+	    }
+
+	    if (h->cb.on_connect_complete && !IS_CLOSING(h))
+		(*h->cb.on_connect_complete)(h, status);
+
+	    if (has_lock) {
+		pj_ioqueue_unlock_key(h);
+	    }
+	}
+	break;
+#endif	/* PJ_HAS_TCP */
+
+    default:
+	pj_assert(!"Invalid operation type!");
+	pj_ioqueue_unlock_key(h);
+	break;
+    }
+
+on_done:
+    pj_lock_acquire(ioqueue->lock);
+    release_slot(ioqueue, slot);
+    pj_lock_release(ioqueue->lock);
+
+    if (h->grp_lock)
+	pj_grp_lock_dec_ref_dbg(h->grp_lock, "ioqueue", 0);
+
+    return PJ_TRUE;
+}
+
+/*
+ * pj_ioqueue_poll()
+ *
+ */
+PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
+{
+    struct io_uring_cqe cqes[PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL];
+    unsigned i, count, head, tail;
+    int processed;
+    void *prev_dispatching;
+
+    PJ_CHECK_STACK();
+
+    /* Submit whatever has been queued and wait for completions, with
+     * a single system call.
+     */
+    if (cq_ready(ioqueue) == 0 && pj_list_empty(&ioqueue->ready_slots)) {
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	long msec;
+	int rc;
+
+	msec = timeout ? PJ_TIME_VAL_MSEC(*timeout) : 9000;
+	ts.tv_sec = msec / 1000;
+	ts.tv_nsec = (msec % 1000) * 1000000;
+
+	pj_bzero(&arg, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+	arg.ts = (__u64)(pj_size_t)&ts;
+
+	TRACE_((THIS_FILE, "start io_uring_enter, msec=%ld", msec));
+
+	rc = sys_uring_enter(ioqueue->ring_fd, sq_pending(ioqueue), 1,
+			     IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+			     &arg, sizeof(arg));
+	if (rc < 0 && rc != -ETIME && rc != -EINTR && rc != -EBUSY) {
+	    TRACE_((THIS_FILE, "io_uring_enter error"));
+	    return -PJ_RETURN_OS_ERROR(-rc);
+	}
+    } else {
+	flush_sqes(ioqueue);
+    }
+
+    /* Reap completions. */
+    pj_lock_acquire(ioqueue->lock);
+
+    for (count=0; count < ioqueue->max_events &&
+		  !pj_list_empty(&ioqueue->ready_slots); ++count)
+    {
+	struct uring_slot *slot = ioqueue->ready_slots.next;
+
+	pj_list_erase(slot);
+	cqes[count].user_data = (__u64)(pj_size_t)slot;
+	cqes[count].res = slot->res;
+    }
+
+    head = *ioqueue->cq_khead;
+    tail = ring_load(ioqueue->cq_ktail);
+    for (; head != tail && count < ioqueue->max_events; ++head) {
+	struct uring_slot *slot;
+
+	cqes[count] = ioqueue->cqes[head & ioqueue->cq_mask];
+	slot = (struct uring_slot*)(pj_size_t)cqes[count].user_data;
+	if (slot)
+	    slot_completed(slot);
+	++count;
+    }
+    ring_store(ioqueue->cq_khead, head);
+
+    if (!pj_list_empty(&ioqueue->cancel_slots))
+	queue_pending_cancels(ioqueue);
+
+    /* Check the closing keys only when there's no activity and when there
+     * are pending closing keys.
+     */
+    if (count == 0 && !pj_list_empty(&ioqueue->closing_list))
+	scan_closing_keys(ioqueue);
+
+    pj_lock_release(ioqueue->lock);
+
+    /* Now process the completions. Operations started by the callbacks
+     * are left in the submission ring to be submitted in one go.
+     */
+    prev_dispatching = pj_thread_local_get(ioqueue->tls_id);
+    pj_thread_local_set(ioqueue->tls_id, (void*)ioqueue);
+
+    for (processed=0, i=0; i<count; ++i) {
+	struct uring_slot *slot = (struct uring_slot*)(pj_size_t)
+				  cqes[i].user_data;
+
+	/* Completion of a cancel or wake up request */
+	if (slot == NULL)
+	    continue;
+
+	if (dispatch_completion(ioqueue, slot, cqes[i].res))
+	    ++processed;
+    }
+
+    pj_thread_local_set(ioqueue->tls_id, prev_dispatching);
+
+    /* Outgoing data should not wait for the next poll */
+    if (ioqueue->flush_needed && prev_dispatching == NULL) {
+	ioqueue->flush_needed = PJ_FALSE;
+	flush_sqes(ioqueue);
+    }
+
+    TRACE_((THIS_FILE, "ioqueue_poll() returns %d", processed));
+
+    return processed;
+}
+
+/*
+ * pj_ioqueue_recv()
+ *
+ * Start asynchronous recv() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recv(  pj_ioqueue_key_t *key,
+                                      pj_ioqueue_op_key_t *op_key,
+				      void *buffer,
+				      pj_ssize_t *length,
+				      unsigned flags )
+{
+    struct uring_operation *read_op;
+
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing (need to do this first before accessing
+     * other variables, since they might have been destroyed. See ticket
+     * #469).
+     */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    /* Data is always delivered by the kernel's completion, trying to read
+     * it synchronously first would only cost another system call.
+     */
+    read_op = (struct uring_operation*)op_key;
+    read_op->op = PJ_IOQUEUE_OP_RECV;
+    read_op->buf = (char*)buffer;
+    read_op->size = *length;
+    read_op->flags = flags & ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    return queue_op(key, &key->read_list, read_op);
+}
+
+/*
+ * pj_ioqueue_recvfrom()
+ *
+ * Start asynchronous recvfrom() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+				         void *buffer,
+				         pj_ssize_t *length,
+                                         unsigned flags,
+				         pj_sockaddr_t *addr,
+				         int *addrlen)
+{
+    struct uring_operation *read_op;
+
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    read_op = (struct uring_operation*)op_key;
+    read_op->op = PJ_IOQUEUE_OP_RECV_FROM;
+    read_op->buf = (char*)buffer;
+    read_op->size = *length;
+    read_op->flags = flags & ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+    read_op->rmt_addr = addr;
+    read_op->rmt_addrlen = addrlen;
+
+    return queue_op(key, &key->read_list, read_op);
+}
+
+/*
+ * pj_ioqueue_recvmmsg()
+ *
+ * Start asynchronous batch receive from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvmmsg( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+					 pj_ioqueue_mmsg msg[],
+					 unsigned *count,
+                                         pj_uint32_t flags)
+{
+    struct uring_operation *read_op;
+
+    PJ_ASSERT_RETURN(key && op_key && msg && count && *count, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    if (*count > PJ_IOQUEUE_MAX_MMSG)
+	*count = PJ_IOQUEUE_MAX_MMSG;
+
+    /* Unlike single reads, the batch is drained by recvmmsg() anyway, so
+     * trying it right away saves the poll request when data is waiting.
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0) {
+	pj_status_t status;
+	unsigned cnt = *count;
+
+	status = sock_recvmmsg(key->fd, msg, &cnt, flags);
+	if (status == PJ_SUCCESS) {
+	    *count = cnt;
+	    return PJ_SUCCESS;
+	} else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+	    return status;
+	}
+    }
+
+    read_op = (struct uring_operation*)op_key;
+    read_op->op = PJ_IOQUEUE_OP_RECV_MMSG;
+    read_op->buf = (char*)msg;
+    read_op->size = *count;
+    read_op->flags = flags & ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+    read_op->rmt_addr = NULL;
+    read_op->rmt_addrlen = NULL;
+
+    return queue_op(key, &key->read_list, read_op);
+}
+
+/* Common part of pj_ioqueue_send() and pj_ioqueue_sendto(). */
+static pj_status_t prepare_write(pj_ioqueue_key_t *key,
+				 struct uring_operation *write_op)
+{
+    unsigned retry;
+
+    /* Spin if write_op has pending operation */
+    for (retry=0; write_op->op != 0 && retry<PENDING_RETRY; ++retry)
+	pj_thread_sleep(0);
+
+    /* Last chance */
+    if (write_op->op) {
+	/* Unable to send packet because there is already pending write on
+	 * the write_op. See the comment in ioqueue_common_abs.c.
+	 */
+	return PJ_EBUSY;
+    }
+
+    PJ_UNUSED_ARG(key);
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_send()
+ *
+ * Start asynchronous send() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_send( pj_ioqueue_key_t *key,
+                                     pj_ioqueue_op_key_t *op_key,
+			             const void *data,
+			             pj_ssize_t *length,
+                                     unsigned flags)
+{
+    struct uring_operation *write_op;
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write and
+     *   caller doesn't ask for the write to be batched.
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0 &&
+	pj_list_empty(&key->write_list))
+    {
+        sent = *length;
+        status = pj_sock_send(key->fd, data, &sent, flags);
+        if (status == PJ_SUCCESS) {
+            *length = sent;
+            return PJ_SUCCESS;
+        } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+	    return status;
+        }
+    }
+
+    write_op = (struct uring_operation*)op_key;
+    status = prepare_write(key, write_op);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    write_op->op = PJ_IOQUEUE_OP_SEND;
+    write_op->buf = (char*)data;
+    write_op->size = *length;
+    write_op->written = 0;
+    write_op->flags = flags & ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    return queue_op(key, &key->write_list, write_op);
+}
+
+
+/*
+ * pj_ioqueue_sendto()
+ *
+ * Start asynchronous write() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+			               const void *data,
+			               pj_ssize_t *length,
+                                       pj_uint32_t flags,
+			               const pj_sockaddr_t *addr,
+			               int addrlen)
+{
+    struct uring_operation *write_op;
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    /* Fast track, see pj_ioqueue_send() */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0 &&
+	pj_list_empty(&key->write_list))
+    {
+        sent = *length;
+        status = pj_sock_sendto(key->fd, data, &sent, flags, addr, addrlen);
+        if (status == PJ_SUCCESS) {
+            *length = sent;
+            return PJ_SUCCESS;
+        } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+	    return status;
+        }
+    }
+
+    /*
+     * Check that address storage can hold the address parameter.
+     */
+    PJ_ASSERT_RETURN(addrlen <= (int)sizeof(pj_sockaddr), PJ_EBUG);
+
+    write_op = (struct uring_operation*)op_key;
+    status = prepare_write(key, write_op);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    write_op->op = PJ_IOQUEUE_OP_SEND_TO;
+    write_op->buf = (char*)data;
+    write_op->size = *length;
+    write_op->written = 0;
+    write_op->flags = flags & ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+    pj_memcpy(&write_op->dst_addr, addr, addrlen);
+    write_op->dst_addrlen = addrlen;
+
+    return queue_op(key, &key->write_list, write_op);
+}
+
+/*
+ * pj_ioqueue_sendmmsg()
+ *
+ * Send a batch of datagrams, without scheduling asynchronous operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendmmsg( pj_ioqueue_key_t *key,
+					 const pj_ioqueue_mmsg msg[],
+					 unsigned *count,
+                                         pj_uint32_t flags)
+{
+    struct mmsghdr hdr[PJ_IOQUEUE_MAX_MMSG];
+    struct iovec iov[PJ_IOQUEUE_MAX_MMSG];
+    unsigned i;
+    int rc;
+
+    PJ_ASSERT_RETURN(key && msg && count && *count, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    /* Don't overtake pending writes, see pj_ioqueue_sendto() */
+    if (!pj_list_empty(&key->write_list)) {
+	*count = 0;
+	return PJ_EBUSY;
+    }
+
+    if (*count > PJ_IOQUEUE_MAX_MMSG)
+	*count = PJ_IOQUEUE_MAX_MMSG;
+
+    pj_bzero(hdr, *count * sizeof(hdr[0]));
+    for (i=0; i<*count; ++i) {
+	iov[i].iov_base = msg[i].buf;
+	iov[i].iov_len = msg[i].len;
+	hdr[i].msg_hdr.msg_iov = &iov[i];
+	hdr[i].msg_hdr.msg_iovlen = 1;
+	hdr[i].msg_hdr.msg_name = msg[i].addr;
+	hdr[i].msg_hdr.msg_namelen = msg[i].addr? msg[i].addrlen : 0;
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+    rc = sendmmsg(key->fd, hdr, *count, flags | MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (rc < 0) {
+	pj_status_t status = pj_get_netos_error();
+
+	*count = 0;
+	return (status == PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) ?
+	       PJ_EBUSY : status;
+    }
+
+    *count = rc;
+    return PJ_SUCCESS;
+}
+
+#if PJ_HAS_TCP
+/*
+ * Initiate overlapped accept() operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_accept( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+			               pj_sock_t *new_sock,
+			               pj_sockaddr_t *local,
+			               pj_sockaddr_t *remote,
+			               int *addrlen)
+{
+    struct uring_operation *accept_op;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && op_key && new_sock, PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    accept_op = (struct uring_operation*)op_key;
+    accept_op->op = PJ_IOQUEUE_OP_ACCEPT;
+    accept_op->accept_fd = new_sock;
+    accept_op->rmt_addr = remote;
+    accept_op->rmt_addrlen = addrlen;
+    accept_op->local_addr = local;
+
+    /* Listening socket may have several accepts in progress */
+    pj_ioqueue_lock_key(key);
+    if (IS_CLOSING(key)) {
+	pj_ioqueue_unlock_key(key);
+	accept_op->op = PJ_IOQUEUE_OP_NONE;
+	return PJ_ECANCELLED;
+    }
+    pj_list_insert_before(&key->accept_list, accept_op);
+    if (start_op(key, accept_op) != PJ_SUCCESS) {
+	pj_list_erase(accept_op);
+	accept_op->op = PJ_IOQUEUE_OP_NONE;
+	pj_ioqueue_unlock_key(key);
+	return PJ_ETOOMANY;
+    }
+    pj_ioqueue_unlock_key(key);
+
+    if (!is_dispatching(key->ioqueue))
+	flush_sqes(key->ioqueue);
+
+    return PJ_EPENDING;
+}
+
+/*
+ * Initiate asynchronous connect() operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_connect( pj_ioqueue_key_t *key,
+					const pj_sockaddr_t *addr,
+					int addrlen )
+{
+    pj_ioqueue_t *ioqueue;
+    struct io_uring_sqe *sqe;
+    struct uring_slot *slot;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && addr && addrlen, PJ_EINVAL);
+    PJ_ASSERT_RETURN(addrlen <= (int)sizeof(pj_sockaddr), PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (IS_CLOSING(key))
+	return PJ_ECANCELLED;
+
+    /* Check if socket has not been marked for connecting */
+    if (key->connecting != 0)
+        return PJ_EPENDING;
+
+    /* Connecting a datagram socket never blocks */
+    if (key->fd_type == pj_SOCK_DGRAM())
+	return pj_sock_connect(key->fd, addr, addrlen);
+
+    ioqueue = key->ioqueue;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous
+     * check in multithreaded app. See #913
+     */
+    if (IS_CLOSING(key)) {
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+
+    pj_lock_acquire(ioqueue->lock);
+    sqe = get_sqe(ioqueue);
+    slot = sqe ? alloc_slot(ioqueue) : NULL;
+    if (!slot) {
+	pj_lock_release(ioqueue->lock);
+	pj_ioqueue_unlock_key(key);
+	return PJ_ETOOMANY;
+    }
+
+    slot->key = key;
+    slot->op = NULL;
+    slot->op_type = PJ_IOQUEUE_OP_CONNECT;
+    slot->orphaned = PJ_FALSE;
+    pj_memcpy(&slot->addr, addr, addrlen);
+
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = key->fd;
+    sqe->addr = (__u64)(pj_size_t)&slot->addr;
+    sqe->off = addrlen;
+    sqe->user_data = (__u64)(pj_size_t)slot;
+    commit_sqe(ioqueue);
+
+    ++key->ref_count;
+    ++key->inflight;
+    key->connecting = PJ_TRUE;
+    key->connect_slot = slot;
+    ioqueue->flush_needed = PJ_TRUE;
+
+    pj_lock_release(ioqueue->lock);
+    pj_ioqueue_unlock_key(key);
+
+    if (!is_dispatching(ioqueue))
+	flush_sqes(ioqueue);
+
+    return PJ_EPENDING;
+}
+#endif	/* PJ_HAS_TCP */
+
+
+PJ_DEF(void) pj_ioqueue_op_key_init( pj_ioqueue_op_key_t *op_key,
+				     pj_size_t size )
+{
+    pj_bzero(op_key, size);
+}
+
+
+/*
+ * pj_ioqueue_is_pending()
+ */
+PJ_DEF(pj_bool_t) pj_ioqueue_is_pending( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key )
+{
+    struct uring_operation *op_rec;
+
+    PJ_UNUSED_ARG(key);
+
+    op_rec = (struct uring_operation*)op_key;
+    return op_rec->op != 0;
+}
+
+
+/* Find the operation in the list, and remove it together with its kernel
+ * request. Must hold key's lock.
+ */
+static pj_bool_t remove_op(pj_ioqueue_key_t *key,
+			   struct uring_operation *list,
+			   struct uring_operation *op_rec)
+{
+    struct uring_operation *op = list->next;
+
+    while (op != list) {
+	if (op == op_rec) {
+	    pj_list_erase(op);
+	    op->op = PJ_IOQUEUE_OP_NONE;
+	    if (op->slot) {
+		pj_lock_acquire(key->ioqueue->lock);
+		cancel_slot(key->ioqueue, op->slot);
+		pj_lock_release(key->ioqueue->lock);
+		if (key->fd_type != pj_SOCK_DGRAM())
+		    start_next(key, list);
+	    }
+	    return PJ_TRUE;
+	}
+	op = op->next;
+    }
+    return PJ_FALSE;
+}
+
+/*
+ * pj_ioqueue_post_completion()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
+                                                pj_ioqueue_op_key_t *op_key,
+                                                pj_ssize_t bytes_status )
+{
+    struct uring_operation *op_rec = (struct uring_operation*)op_key;
+    pj_status_t status = PJ_SUCCESS;
+
+    /*
+     * Find the operation key in all pending operation list to
+     * really make sure that it's still there; then call the callback.
+     */
+    pj_ioqueue_lock_key(key);
+
+    if (remove_op(key, &key->read_list, op_rec)) {
+	pj_ioqueue_unlock_key(key);
+	flush_sqes(key->ioqueue);
+	(*key->cb.on_read_complete)(key, op_key, bytes_status);
+    } else if (remove_op(key, &key->write_list, op_rec)) {
+	pj_ioqueue_unlock_key(key);
+	flush_sqes(key->ioqueue);
+	(*key->cb.on_write_complete)(key, op_key, bytes_status);
+    } else if (remove_op(key, &key->accept_list, op_rec)) {
+	pj_ioqueue_unlock_key(key);
+	flush_sqes(key->ioqueue);
+	(*key->cb.on_accept_complete)(key, op_key, PJ_INVALID_SOCKET,
+				      (pj_status_t)bytes_status);
+    } else {
+	pj_ioqueue_unlock_key(key);
+	status = PJ_EINVALIDOP;
+    }
+
+    return status;
+}
+
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
+					       pj_bool_t allow)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+    key->allow_concurrent = allow;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_lock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+	return pj_grp_lock_acquire(key->grp_lock);
+    else
+	return pj_lock_acquire(key->lock);
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_unlock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+	return pj_grp_lock_release(key->grp_lock);
+    else
+	return pj_lock_release(key->lock);
+}
@@ -320,6 +320,30 @@ PJ_DEF(const char*) pj_ioqueue_name(void)
     return "iocp";
 }
 
+/*
+ * pj_ioqueue_cfg_default()
+ */
+PJ_DEF(void) pj_ioqueue_cfg_default(pj_ioqueue_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->epoll_flags = PJ_IOQUEUE_DEFAULT_EPOLL_FLAGS;
+    cfg->max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
+}
+
+/*
+ * pj_ioqueue_create2()
+ *
+ * The settings are not used by IOCP.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create2( pj_pool_t *pool, 
+					pj_size_t max_fd,
+					const pj_ioqueue_cfg *cfg,
+					pj_ioqueue_t **p_ioqueue)
+{
+    PJ_UNUSED_ARG(cfg);
+    return pj_ioqueue_create(pool, max_fd, p_ioqueue);
+}
+
 /*
  * pj_ioqueue_create()
  */
@@ -1186,6 +1210,43 @@ PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
     return PJ_EPENDING;
 }
 
+
+/*
+ * pj_ioqueue_recvmmsg()
+ *
+ * Batch receive is not supported with IOCP.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvmmsg( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+					 pj_ioqueue_mmsg msg[],
+					 unsigned *count,
+                                         pj_uint32_t flags)
+{
+    PJ_UNUSED_ARG(key);
+    PJ_UNUSED_ARG(op_key);
+    PJ_UNUSED_ARG(msg);
+    PJ_UNUSED_ARG(count);
+    PJ_UNUSED_ARG(flags);
+    return PJ_ENOTSUP;
+}
+
+/*
+ * pj_ioqueue_sendmmsg()
+ *
+ * Batch send is not supported with IOCP.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendmmsg( pj_ioqueue_key_t *key,
+					 const pj_ioqueue_mmsg msg[],
+					 unsigned *count,
+                                         pj_uint32_t flags)
+{
+    PJ_UNUSED_ARG(key);
+    PJ_UNUSED_ARG(msg);
+    PJ_UNUSED_ARG(flags);
+    *count = 0;
+    return PJ_ENOTSUP;
+}
+
 #if PJ_HAS_TCP
 
 /*
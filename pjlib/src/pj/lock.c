@@ -544,14 +544,14 @@ PJ_DEF(pj_status_t) pj_grp_lock_del_handler( pj_grp_lock_t *glock,
 
 static pj_status_t grp_lock_add_ref(pj_grp_lock_t *glock)
 {
-    pj_atomic_inc(glock->ref_cnt);
+    pj_atomic_inc_relaxed(glock->ref_cnt);
     return PJ_SUCCESS;
 }
 
 static pj_status_t grp_lock_dec_ref(pj_grp_lock_t *glock)
 {
     int cnt; /* for debugging */
-    if ((cnt=pj_atomic_dec_and_get(glock->ref_cnt)) == 0) {
+    if ((cnt=pj_atomic_dec_and_get_release(glock->ref_cnt)) == 0) {
 	grp_lock_destroy(glock);
 	return PJ_EGONE;
     }
@@ -467,6 +467,33 @@ PJ_DEF(void) pj_atomic_add( pj_atomic_t *var, pj_atomic_value_t value )
     atomic_add(value, &var->atom);
 }
 
+/* The kernel atomic_t has no ordering variants, the ordering is provided
+ * by full memory barriers.
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_get_acquire(pj_atomic_t *var)
+{
+    pj_atomic_value_t value = atomic_read(&var->atom);
+    smp_mb();
+    return value;
+}
+
+PJ_DEF(void) pj_atomic_set_release(pj_atomic_t *var, pj_atomic_value_t value)
+{
+    smp_mb();
+    atomic_set(&var->atom, value);
+}
+
+PJ_DEF(void) pj_atomic_inc_relaxed(pj_atomic_t *var)
+{
+    atomic_inc(&var->atom);
+}
+
+PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get_release(pj_atomic_t *var)
+{
+    /* atomic_dec_return() implies a full memory barrier */
+    return atomic_dec_return(&var->atom);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 PJ_DEF(pj_status_t) pj_thread_local_alloc(long *index)
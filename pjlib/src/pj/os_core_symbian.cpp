@@ -827,6 +827,39 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
     return atomic_var->value;
 }
 
+/*
+ * pj_atomic_get_acquire()
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_get_acquire(pj_atomic_t *atomic_var)
+{
+    return pj_atomic_get(atomic_var);
+}
+
+/*
+ * pj_atomic_set_release()
+ */
+PJ_DEF(void) pj_atomic_set_release(pj_atomic_t *atomic_var,
+				   pj_atomic_value_t value)
+{
+    pj_atomic_set(atomic_var, value);
+}
+
+/*
+ * pj_atomic_inc_relaxed()
+ */
+PJ_DEF(void) pj_atomic_inc_relaxed(pj_atomic_t *atomic_var)
+{
+    pj_atomic_inc(atomic_var);
+}
+
+/*
+ * pj_atomic_dec_and_get_release()
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get_release(pj_atomic_t *atomic_var)
+{
+    return pj_atomic_dec_and_get(atomic_var);
+}
+
 
 
 /////////////////////////////////////////////////////////////////////////////
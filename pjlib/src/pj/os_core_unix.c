@@ -49,6 +49,16 @@
 #define SIGNATURE1  0xDEAFBEEF
 #define SIGNATURE2  0xDEADC0DE
 
+/* Implement atomic variables with the compiler builtins (GCC 4.7 or
+ * Clang), rather than with a mutex.
+ */
+#if defined(PJ_ATOMIC_USE_BUILTINS) && PJ_ATOMIC_USE_BUILTINS!=0 && \
+    defined(__ATOMIC_SEQ_CST) && PJ_HAS_THREADS
+#   define USE_ATOMIC_BUILTINS	1
+#else
+#   define USE_ATOMIC_BUILTINS	0
+#endif
+
 #ifndef PJ_JNI_HAS_JNI_ONLOAD
 #  define PJ_JNI_HAS_JNI_ONLOAD    PJ_ANDROID
 #endif
@@ -89,7 +99,9 @@ struct pj_thread_t
 
 struct pj_atomic_t
 {
+#if !USE_ATOMIC_BUILTINS
     pj_mutex_t	       *mutex;
+#endif
     pj_atomic_value_t	value;
 };
 
@@ -863,10 +875,12 @@ PJ_DEF(pj_status_t) pj_atomic_create( pj_pool_t *pool,
 
     PJ_ASSERT_RETURN(atomic_var, PJ_ENOMEM);
 
-#if PJ_HAS_THREADS
+#if PJ_HAS_THREADS && !USE_ATOMIC_BUILTINS
     rc = pj_mutex_create(pool, "atm%p", PJ_MUTEX_SIMPLE, &atomic_var->mutex);
     if (rc != PJ_SUCCESS)
 	return rc;
+#else
+    PJ_UNUSED_ARG(rc);
 #endif
     atomic_var->value = initial;
 
@@ -880,7 +894,7 @@ PJ_DEF(pj_status_t) pj_atomic_create( pj_pool_t *pool,
 PJ_DEF(pj_status_t) pj_atomic_destroy( pj_atomic_t *atomic_var )
 {
     PJ_ASSERT_RETURN(atomic_var, PJ_EINVAL);
-#if PJ_HAS_THREADS
+#if PJ_HAS_THREADS && !USE_ATOMIC_BUILTINS
     return pj_mutex_destroy( atomic_var->mutex );
 #else
     return 0;
@@ -894,6 +908,9 @@ PJ_DEF(void) pj_atomic_set(pj_atomic_t *atomic_var, pj_atomic_value_t value)
 {
     PJ_CHECK_STACK();
 
+#if USE_ATOMIC_BUILTINS
+    __atomic_store_n(&atomic_var->value, value, __ATOMIC_SEQ_CST);
+#else
 #if PJ_HAS_THREADS
     pj_mutex_lock( atomic_var->mutex );
 #endif
@@ -901,6 +918,7 @@ PJ_DEF(void) pj_atomic_set(pj_atomic_t *atomic_var, pj_atomic_value_t value)
 #if PJ_HAS_THREADS
     pj_mutex_unlock( atomic_var->mutex);
 #endif
+#endif	/* USE_ATOMIC_BUILTINS */
 }
 
 /*
@@ -912,6 +930,9 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
 
     PJ_CHECK_STACK();
 
+#if USE_ATOMIC_BUILTINS
+    oldval = __atomic_load_n(&atomic_var->value, __ATOMIC_SEQ_CST);
+#else
 #if PJ_HAS_THREADS
     pj_mutex_lock( atomic_var->mutex );
 #endif
@@ -919,6 +940,7 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
 #if PJ_HAS_THREADS
     pj_mutex_unlock( atomic_var->mutex);
 #endif
+#endif	/* USE_ATOMIC_BUILTINS */
     return oldval;
 }
 
@@ -927,26 +949,14 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
  */
 PJ_DEF(pj_atomic_value_t) pj_atomic_inc_and_get(pj_atomic_t *atomic_var)
 {
-    pj_atomic_value_t new_value;
-
-    PJ_CHECK_STACK();
-
-#if PJ_HAS_THREADS
-    pj_mutex_lock( atomic_var->mutex );
-#endif
-    new_value = ++atomic_var->value;
-#if PJ_HAS_THREADS
-    pj_mutex_unlock( atomic_var->mutex);
-#endif
-
-    return new_value;
+    return pj_atomic_add_and_get(atomic_var, 1);
 }
 /*
  * pj_atomic_inc()
  */
 PJ_DEF(void) pj_atomic_inc(pj_atomic_t *atomic_var)
 {
-    pj_atomic_inc_and_get(atomic_var);
+    pj_atomic_add_and_get(atomic_var, 1);
 }
 
 /*
@@ -954,19 +964,7 @@ PJ_DEF(void) pj_atomic_inc(pj_atomic_t *atomic_var)
  */
 PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get(pj_atomic_t *atomic_var)
 {
-    pj_atomic_value_t new_value;
-
-    PJ_CHECK_STACK();
-
-#if PJ_HAS_THREADS
-    pj_mutex_lock( atomic_var->mutex );
-#endif
-    new_value = --atomic_var->value;
-#if PJ_HAS_THREADS
-    pj_mutex_unlock( atomic_var->mutex);
-#endif
-
-    return new_value;
+    return pj_atomic_add_and_get(atomic_var, -1);
 }
 
 /*
@@ -974,7 +972,7 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get(pj_atomic_t *atomic_var)
  */
 PJ_DEF(void) pj_atomic_dec(pj_atomic_t *atomic_var)
 {
-    pj_atomic_dec_and_get(atomic_var);
+    pj_atomic_add_and_get(atomic_var, -1);
 }
 
 /*
@@ -985,6 +983,12 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
 {
     pj_atomic_value_t new_value;
 
+    PJ_CHECK_STACK();
+
+#if USE_ATOMIC_BUILTINS
+    new_value = __atomic_add_fetch(&atomic_var->value, value,
+				   __ATOMIC_SEQ_CST);
+#else
 #if PJ_HAS_THREADS
     pj_mutex_lock(atomic_var->mutex);
 #endif
@@ -995,6 +999,7 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
 #if PJ_HAS_THREADS
     pj_mutex_unlock(atomic_var->mutex);
 #endif
+#endif	/* USE_ATOMIC_BUILTINS */
 
     return new_value;
 }
@@ -1008,6 +1013,64 @@ PJ_DEF(void) pj_atomic_add( pj_atomic_t *atomic_var,
     pj_atomic_add_and_get(atomic_var, value);
 }
 
+/*
+ * pj_atomic_get_acquire()
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_get_acquire(pj_atomic_t *atomic_var)
+{
+#if USE_ATOMIC_BUILTINS
+    return __atomic_load_n(&atomic_var->value, __ATOMIC_ACQUIRE);
+#else
+    return pj_atomic_get(atomic_var);
+#endif
+}
+
+/*
+ * pj_atomic_set_release()
+ */
+PJ_DEF(void) pj_atomic_set_release(pj_atomic_t *atomic_var,
+				   pj_atomic_value_t value)
+{
+#if USE_ATOMIC_BUILTINS
+    __atomic_store_n(&atomic_var->value, value, __ATOMIC_RELEASE);
+#else
+    pj_atomic_set(atomic_var, value);
+#endif
+}
+
+/*
+ * pj_atomic_inc_relaxed()
+ */
+PJ_DEF(void) pj_atomic_inc_relaxed(pj_atomic_t *atomic_var)
+{
+#if USE_ATOMIC_BUILTINS
+    __atomic_add_fetch(&atomic_var->value, 1, __ATOMIC_RELAXED);
+#else
+    pj_atomic_inc(atomic_var);
+#endif
+}
+
+/*
+ * pj_atomic_dec_and_get_release()
+ */
+PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get_release(pj_atomic_t *atomic_var)
+{
+#if USE_ATOMIC_BUILTINS
+    pj_atomic_value_t new_value;
+
+    new_value = __atomic_sub_fetch(&atomic_var->value, 1, __ATOMIC_RELEASE);
+    if (new_value == 0) {
+	/* Synchronize with the releases of the other owners before the
+	 * caller destroys the object.
+	 */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+    }
+    return new_value;
+#else
+    return pj_atomic_dec_and_get(atomic_var);
+#endif
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /*
  * pj_thread_local_alloc()
@@ -21,6 +21,7 @@
 #include <pj/log.h>
 #include <pj/string.h>
 #include <pj/assert.h>
+#include <pj/errno.h>
 #include <pj/lock.h>
 #include <pj/os.h>
 #include <pj/pool_buf.h>
@@ -49,6 +50,93 @@ static pj_size_t pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE] =
  */
 #define START_SIZE  5
 
+/* The magazines update used_count and capacity outside of the caching
+ * pool lock, so they need atomic operations.
+ */
+#if PJ_CACHING_POOL_MAGAZINE_SIZE > 0 && PJ_HAS_THREADS && \
+    defined(__ATOMIC_SEQ_CST)
+#   define USE_MAGAZINE	    1
+#else
+#   define USE_MAGAZINE	    0
+#endif
+
+/* Pool's factory_data contains the index of the free list, and MAG_FLAG
+ * if the pool was created through a magazine.
+ */
+#define MAG_FLAG    0x100
+#define MAG_IDX(d)  ((unsigned)((pj_ssize_t)(d) & (MAG_FLAG - 1)))
+#define IS_MAG(d)   (((pj_ssize_t)(d) & MAG_FLAG) != 0)
+
+/* Number of pools moved between a magazine and the shared free list */
+#define MAG_BATCH   ((PJ_CACHING_POOL_MAGAZINE_SIZE + 1) / 2)
+
+#if USE_MAGAZINE
+/*
+ * Per-thread cache of pools. It is only accessed by its thread, so it
+ * doesn't need a lock.
+ */
+struct pj_caching_pool_magazine
+{
+    PJ_DECL_LIST_MEMBER(struct pj_caching_pool_magazine);
+    pj_list	    free_list[PJ_CACHING_POOL_ARRAY_SIZE];
+    unsigned	    free_cnt[PJ_CACHING_POOL_ARRAY_SIZE];
+};
+
+static pj_status_t init_magazines(pj_caching_pool *cp);
+static void destroy_magazines(pj_caching_pool *cp);
+static pj_pool_t *mag_create_pool(pj_caching_pool *cp, const char *name,
+				  int idx, pj_size_t increment_sz,
+				  pj_pool_callback *callback);
+static void mag_release_pool(pj_caching_pool *cp, pj_pool_t *pool);
+#endif
+
+
+PJ_INLINE(void) add_used_count(pj_caching_pool *cp, int delta)
+{
+#if USE_MAGAZINE
+    __atomic_add_fetch(&cp->used_count, (pj_size_t)delta, __ATOMIC_RELAXED);
+#else
+    cp->used_count += delta;
+#endif
+}
+
+/* Update the capacity when a pool is put to or taken from the cache. */
+PJ_INLINE(void) add_capacity(pj_caching_pool *cp, pj_ssize_t delta)
+{
+#if USE_MAGAZINE
+    __atomic_add_fetch(&cp->capacity, (pj_size_t)delta, __ATOMIC_RELAXED);
+#else
+    cp->capacity += delta;
+#endif
+}
+
+/* Get the index of the free list for the pool size. */
+static int get_size_index(pj_size_t initial_size)
+{
+    int idx;
+
+    /* Search the suitable size for the pool. 
+     * We'll just do linear search to the size array, as the array size itself
+     * is only a few elements. Binary search I suspect will be less efficient
+     * for this purpose.
+     */
+    if (initial_size <= pool_sizes[START_SIZE]) {
+	for (idx=START_SIZE-1; 
+	     idx >= 0 && pool_sizes[idx] >= initial_size;
+	     --idx)
+	    ;
+	++idx;
+    } else {
+	for (idx=START_SIZE+1; 
+	     idx < PJ_CACHING_POOL_ARRAY_SIZE && 
+		  pool_sizes[idx] < initial_size;
+	     ++idx)
+	    ;
+    }
+
+    return idx;
+}
+
 
 PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp, 
 				   const pj_pool_factory_policy *policy,
@@ -79,6 +167,29 @@ PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp,
 
     pool = pj_pool_create_on_buf("cachingpool", cp->pool_buf, sizeof(cp->pool_buf));
     pj_lock_create_simple_mutex(pool, "cachingpool", &cp->lock);
+
+#if USE_MAGAZINE
+    pj_list_init(&cp->magazine_list);
+#endif
+#if PJ_CACHING_POOL_USE_MAGAZINE
+    pj_caching_pool_enable_magazine(cp, PJ_TRUE);
+#endif
+}
+
+PJ_DEF(pj_status_t) pj_caching_pool_enable_magazine(pj_caching_pool *cp,
+						    pj_bool_t enable)
+{
+    PJ_ASSERT_RETURN(cp, PJ_EINVAL);
+
+#if USE_MAGAZINE
+    if (enable && !cp->use_magazine)
+	return init_magazines(cp);
+    else if (!enable && cp->use_magazine)
+	destroy_magazines(cp);
+    return PJ_SUCCESS;
+#else
+    return enable ? PJ_ENOTSUP : PJ_SUCCESS;
+#endif
 }
 
 PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
@@ -88,6 +199,10 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
 
     PJ_CHECK_STACK();
 
+#if USE_MAGAZINE
+    destroy_magazines(cp);
+#endif
+
     /* Delete all pool in free list */
     for (i=0; i < PJ_CACHING_POOL_ARRAY_SIZE; ++i) {
 	pj_pool_t *pool = (pj_pool_t*) cp->free_list[i].next;
@@ -128,31 +243,21 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
 
     PJ_CHECK_STACK();
 
-    pj_lock_acquire(cp->lock);
-
     /* Use pool factory's policy when callback is NULL */
     if (callback == NULL) {
 	callback = pf->policy.callback;
     }
 
-    /* Search the suitable size for the pool. 
-     * We'll just do linear search to the size array, as the array size itself
-     * is only a few elements. Binary search I suspect will be less efficient
-     * for this purpose.
-     */
-    if (initial_size <= pool_sizes[START_SIZE]) {
-	for (idx=START_SIZE-1; 
-	     idx >= 0 && pool_sizes[idx] >= initial_size;
-	     --idx)
-	    ;
-	++idx;
-    } else {
-	for (idx=START_SIZE+1; 
-	     idx < PJ_CACHING_POOL_ARRAY_SIZE && 
-		  pool_sizes[idx] < initial_size;
-	     ++idx)
-	    ;
+    idx = get_size_index(initial_size);
+
+#if USE_MAGAZINE
+    /* Use the magazine of this thread if the size is cached */
+    if (cp->use_magazine && idx < PJ_CACHING_POOL_ARRAY_SIZE) {
+	return mag_create_pool(cp, name, idx, increment_sz, callback);
     }
+#endif
+
+    pj_lock_acquire(cp->lock);
 
     /* Check whether there's a pool in the list. */
     if (idx==PJ_CACHING_POOL_ARRAY_SIZE || pj_list_empty(&cp->free_list[idx])) {
@@ -178,11 +283,7 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
 	pj_pool_init_int(pool, name, increment_sz, callback);
 
 	/* Update pool manager's free capacity. */
-	if (cp->capacity > pj_pool_get_capacity(pool)) {
-	    cp->capacity -= pj_pool_get_capacity(pool);
-	} else {
-	    cp->capacity = 0;
-	}
+	add_capacity(cp, -(pj_ssize_t)pj_pool_get_capacity(pool));
 
 	PJ_LOG(6, (pool->obj_name, "pool reused, size=%u", pool->capacity));
     }
@@ -194,7 +295,7 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
     pool->factory_data = (void*) (pj_ssize_t) idx;
 
     /* Increment used count. */
-    ++cp->used_count;
+    add_used_count(cp, 1);
 
     pj_lock_release(cp->lock);
     return pool;
@@ -210,6 +311,13 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
 
     PJ_ASSERT_ON_FAIL(pf && pool, return);
 
+#if USE_MAGAZINE
+    if (IS_MAG(pool->factory_data)) {
+	mag_release_pool(cp, pool);
+	return;
+    }
+#endif
+
     pj_lock_acquire(cp->lock);
 
 #if PJ_SAFE_POOL
@@ -224,7 +332,7 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     pj_list_erase(pool);
 
     /* Decrement used count. */
-    --cp->used_count;
+    add_used_count(cp, -1);
 
     pool_capacity = pj_pool_get_capacity(pool);
 
@@ -262,7 +370,7 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     }
 
     pj_list_insert_after(&cp->free_list[i], pool);
-    cp->capacity += pool_capacity;
+    add_capacity(cp, pool_capacity);
 
     pj_lock_release(cp->lock);
 }
@@ -292,6 +400,10 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
 	    total_capacity += pool_capacity;
 	    pool = pool->next;
 	}
+	if (cp->use_magazine) {
+	    PJ_LOG(3,("cachpool", "  (pools created through the magazines "
+				  "are not listed)"));
+	}
 	if (total_capacity) {
 	    PJ_LOG(3,("cachpool", "  Total %9d of %9d (%d %%) used!",
 				  total_used, total_capacity,
@@ -307,6 +419,190 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
 }
 
 
+#if USE_MAGAZINE
+
+static pj_status_t init_magazines(pj_caching_pool *cp)
+{
+    pj_status_t status;
+
+    status = pj_thread_local_alloc(&cp->magazine_tls);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    cp->magazine_pool = pj_pool_create_int(&cp->factory, "cpoolmag", 1024,
+					   1024, cp->factory.policy.callback);
+    if (!cp->magazine_pool) {
+	pj_thread_local_free(cp->magazine_tls);
+	return PJ_ENOMEM;
+    }
+
+    cp->use_magazine = PJ_TRUE;
+    return PJ_SUCCESS;
+}
+
+static void destroy_magazines(pj_caching_pool *cp)
+{
+    unsigned j;
+
+    if (!cp->use_magazine)
+	return;
+
+    while (!pj_list_empty(&cp->magazine_list)) {
+	struct pj_caching_pool_magazine *mag = cp->magazine_list.next;
+
+	for (j=0; j<PJ_CACHING_POOL_ARRAY_SIZE; ++j) {
+	    while (!pj_list_empty(&mag->free_list[j])) {
+		pj_pool_t *pool = (pj_pool_t*) mag->free_list[j].next;
+
+		pj_list_erase(pool);
+		add_capacity(cp, -(pj_ssize_t)pj_pool_get_capacity(pool));
+		pj_pool_destroy_int(pool);
+	    }
+	}
+	pj_list_erase(mag);
+    }
+
+    cp->use_magazine = PJ_FALSE;
+    pj_pool_destroy_int(cp->magazine_pool);
+    cp->magazine_pool = NULL;
+    pj_thread_local_free(cp->magazine_tls);
+}
+
+/* Get the magazine of the calling thread, creating it on first use. */
+static struct pj_caching_pool_magazine *get_magazine(pj_caching_pool *cp)
+{
+    struct pj_caching_pool_magazine *mag;
+    unsigned j;
+
+    mag = (struct pj_caching_pool_magazine*)
+	  pj_thread_local_get(cp->magazine_tls);
+    if (mag)
+	return mag;
+
+    pj_lock_acquire(cp->lock);
+    mag = PJ_POOL_ZALLOC_T(cp->magazine_pool,
+			   struct pj_caching_pool_magazine);
+    for (j=0; j<PJ_CACHING_POOL_ARRAY_SIZE; ++j)
+	pj_list_init(&mag->free_list[j]);
+    pj_list_push_back(&cp->magazine_list, mag);
+    pj_lock_release(cp->lock);
+
+    pj_thread_local_set(cp->magazine_tls, mag);
+    return mag;
+}
+
+/* Move a batch of pools from the shared free list to the magazine. */
+static void mag_refill(pj_caching_pool *cp,
+		       struct pj_caching_pool_magazine *mag,
+		       int idx)
+{
+    unsigned cnt = 0;
+
+    /* The pools stay in the capacity while they are in the magazine */
+    pj_lock_acquire(cp->lock);
+    while (cnt < MAG_BATCH && !pj_list_empty(&cp->free_list[idx])) {
+	pj_pool_t *pool = (pj_pool_t*) cp->free_list[idx].next;
+
+	pj_list_erase(pool);
+	pj_list_insert_before(&mag->free_list[idx], pool);
+	++cnt;
+    }
+    pj_lock_release(cp->lock);
+
+    mag->free_cnt[idx] += cnt;
+}
+
+/* Move a batch of the least recently used pools from the magazine to
+ * the shared free list.
+ */
+static void mag_flush(pj_caching_pool *cp,
+		      struct pj_caching_pool_magazine *mag,
+		      int idx)
+{
+    unsigned cnt;
+
+    pj_lock_acquire(cp->lock);
+    for (cnt=0; cnt<MAG_BATCH && !pj_list_empty(&mag->free_list[idx]); ++cnt)
+    {
+	pj_pool_t *pool = (pj_pool_t*) mag->free_list[idx].prev;
+
+	pj_list_erase(pool);
+	pj_list_insert_after(&cp->free_list[idx], pool);
+    }
+    pj_lock_release(cp->lock);
+
+    mag->free_cnt[idx] -= cnt;
+}
+
+static pj_pool_t *mag_create_pool(pj_caching_pool *cp, const char *name,
+				  int idx, pj_size_t increment_sz,
+				  pj_pool_callback *callback)
+{
+    struct pj_caching_pool_magazine *mag = get_magazine(cp);
+    pj_pool_t *pool;
+
+    if (pj_list_empty(&mag->free_list[idx]))
+	mag_refill(cp, mag, idx);
+
+    if (pj_list_empty(&mag->free_list[idx])) {
+	pool = pj_pool_create_int(&cp->factory, name, pool_sizes[idx], 
+				  increment_sz, callback);
+	if (!pool)
+	    return NULL;
+    } else {
+	pool = (pj_pool_t*) mag->free_list[idx].next;
+	pj_list_erase(pool);
+	--mag->free_cnt[idx];
+	add_capacity(cp, -(pj_ssize_t)pj_pool_get_capacity(pool));
+
+	pj_pool_init_int(pool, name, increment_sz, callback);
+
+	PJ_LOG(6, (pool->obj_name, "pool reused, size=%u", pool->capacity));
+    }
+
+    pool->factory_data = (void*)(pj_ssize_t)(MAG_FLAG | idx);
+    add_used_count(cp, 1);
+
+    return pool;
+}
+
+/* The pool goes to the magazine of the calling thread, which is not
+ * necessarily the thread that created it.
+ */
+static void mag_release_pool(pj_caching_pool *cp, pj_pool_t *pool)
+{
+    struct pj_caching_pool_magazine *mag = get_magazine(cp);
+    unsigned idx = MAG_IDX(pool->factory_data);
+    pj_size_t pool_capacity;
+
+    add_used_count(cp, -1);
+
+    if (pj_pool_get_capacity(pool) > pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE-1]) {
+	pj_pool_destroy_int(pool);
+	return;
+    }
+
+    PJ_LOG(6, (pool->obj_name, "recycle(): cap=%d, used=%d", 
+	       pj_pool_get_capacity(pool), pj_pool_get_used_size(pool)));
+    pj_pool_reset(pool);
+
+    pool_capacity = pj_pool_get_capacity(pool);
+    if (cp->capacity + pool_capacity > cp->max_capacity) {
+	pj_pool_destroy_int(pool);
+	return;
+    }
+
+    if (mag->free_cnt[idx] >= PJ_CACHING_POOL_MAGAZINE_SIZE)
+	mag_flush(cp, mag, idx);
+
+    pj_list_insert_after(&mag->free_list[idx], pool);
+    ++mag->free_cnt[idx];
+    add_capacity(cp, pool_capacity);
+}
+
+#endif	/* USE_MAGAZINE */
+
+
 static pj_bool_t cpool_on_block_alloc(pj_pool_factory *f, pj_size_t sz)
 {
     pj_caching_pool *cp = (pj_caching_pool*)f;
@@ -0,0 +1,395 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/slab.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/string.h>
+
+#if PJ_SLAB_MAGAZINE_CNT > 0 && PJ_SLAB_MAGAZINE_SIZE > 0 && PJ_HAS_THREADS
+#   define USE_MAGAZINE	    1
+#else
+#   define USE_MAGAZINE	    0
+#endif
+
+/* Number of objects moved between a magazine and the shared free list */
+#define MAG_BATCH	    ((PJ_SLAB_MAGAZINE_SIZE + 1) / 2)
+
+/* Default number of objects per chunk */
+#define DEFAULT_OBJ_PER_CHUNK	16
+
+/* Objects are aligned to the pool alignment, and must be able to hold
+ * the free list pointer.
+ */
+#if PJ_POOL_ALIGNMENT > 8
+#   define OBJ_ALIGNMENT    PJ_POOL_ALIGNMENT
+#else
+#   define OBJ_ALIGNMENT    8
+#endif
+
+/* Free objects are linked with the first pointer in the object. */
+#define NEXT_FREE(obj)	    (*(void**)(obj))
+
+#if USE_MAGAZINE
+/*
+ * Per-thread cache of free objects.
+ */
+struct slab_magazine
+{
+    pj_lock_t	   *lock;
+    void	   *free_list;
+    unsigned	    free_cnt;
+};
+#endif
+
+struct pj_slab_t
+{
+    char	    obj_name[PJ_MAX_OBJ_NAME];
+    pj_pool_t	   *pool;
+    pj_lock_t	   *lock;
+    pj_size_t	    obj_size;
+    unsigned	    obj_per_chunk;
+    pj_size_t	    capacity;
+    void	   *free_list;
+
+#if USE_MAGAZINE
+    struct slab_magazine *magazines;
+    long			  magazine_tls;
+    unsigned		  magazine_assigned;
+#endif
+};
+
+
+/* Silence the pool's out of memory callback, since pj_slab_alloc()
+ * reports the failure by returning NULL.
+ */
+static void on_no_memory(pj_pool_t *pool, pj_size_t size)
+{
+    PJ_UNUSED_ARG(pool);
+    PJ_UNUSED_ARG(size);
+}
+
+/*
+ * Allocate a new chunk and put its objects to the shared free list.
+ * Must be called with the slab lock held.
+ */
+static pj_bool_t grow_slab(pj_slab_t *slab)
+{
+    char *chunk;
+    unsigned i;
+
+    chunk = (char*) pj_pool_alloc(slab->pool,
+				  slab->obj_size * slab->obj_per_chunk);
+    if (!chunk) {
+	PJ_LOG(2,(slab->obj_name, "Unable to allocate %u objects",
+		  slab->obj_per_chunk));
+	return PJ_FALSE;
+    }
+
+    for (i=slab->obj_per_chunk; i>0; --i) {
+	void *obj = chunk + (i-1) * slab->obj_size;
+	NEXT_FREE(obj) = slab->free_list;
+	slab->free_list = obj;
+    }
+    slab->capacity += slab->obj_per_chunk;
+
+    return PJ_TRUE;
+}
+
+
+#if USE_MAGAZINE
+
+static void init_magazines(pj_slab_t *slab)
+{
+    unsigned i;
+    pj_status_t status;
+
+    status = pj_thread_local_alloc(&slab->magazine_tls);
+    if (status != PJ_SUCCESS)
+	return;
+
+    slab->magazines = (struct slab_magazine*)
+		      pj_pool_calloc(slab->pool, PJ_SLAB_MAGAZINE_CNT,
+				     sizeof(struct slab_magazine));
+    if (!slab->magazines) {
+	pj_thread_local_free(slab->magazine_tls);
+	return;
+    }
+
+    for (i=0; i<PJ_SLAB_MAGAZINE_CNT; ++i) {
+	status = pj_lock_create_simple_mutex(slab->pool, "slabmag%p",
+					     &slab->magazines[i].lock);
+	if (status != PJ_SUCCESS) {
+	    while (i-- > 0)
+		pj_lock_destroy(slab->magazines[i].lock);
+	    slab->magazines = NULL;
+	    pj_thread_local_free(slab->magazine_tls);
+	    return;
+	}
+    }
+}
+
+static void destroy_magazines(pj_slab_t *slab)
+{
+    unsigned i;
+
+    if (!slab->magazines)
+	return;
+
+    for (i=0; i<PJ_SLAB_MAGAZINE_CNT; ++i)
+	pj_lock_destroy(slab->magazines[i].lock);
+
+    slab->magazines = NULL;
+    pj_thread_local_free(slab->magazine_tls);
+}
+
+/* Get the magazine of the calling thread. */
+static struct slab_magazine *get_magazine(pj_slab_t *slab)
+{
+    unsigned mag_no;
+
+    mag_no = (unsigned)(pj_ssize_t)pj_thread_local_get(slab->magazine_tls);
+    if (mag_no == 0 || mag_no > PJ_SLAB_MAGAZINE_CNT) {
+	pj_lock_acquire(slab->lock);
+	mag_no = slab->magazine_assigned++ % PJ_SLAB_MAGAZINE_CNT + 1;
+	pj_lock_release(slab->lock);
+
+	pj_thread_local_set(slab->magazine_tls, (void*)(pj_ssize_t)mag_no);
+    }
+
+    return &slab->magazines[mag_no - 1];
+}
+
+/* Move a batch of objects from the shared free list to the magazine. */
+static void mag_refill(pj_slab_t *slab, struct slab_magazine *mag)
+{
+    pj_lock_acquire(slab->lock);
+    if (!slab->free_list)
+	grow_slab(slab);
+
+    while (mag->free_cnt < MAG_BATCH && slab->free_list) {
+	void *obj = slab->free_list;
+
+	slab->free_list = NEXT_FREE(obj);
+	NEXT_FREE(obj) = mag->free_list;
+	mag->free_list = obj;
+	++mag->free_cnt;
+    }
+    pj_lock_release(slab->lock);
+}
+
+/* Move a batch of objects from the magazine to the shared free list. */
+static void mag_flush(pj_slab_t *slab, struct slab_magazine *mag)
+{
+    unsigned cnt;
+
+    pj_lock_acquire(slab->lock);
+    for (cnt=0; cnt<MAG_BATCH && mag->free_list; ++cnt) {
+	void *obj = mag->free_list;
+
+	mag->free_list = NEXT_FREE(obj);
+	NEXT_FREE(obj) = slab->free_list;
+	slab->free_list = obj;
+    }
+    pj_lock_release(slab->lock);
+
+    mag->free_cnt -= cnt;
+}
+
+#endif	/* USE_MAGAZINE */
+
+
+/*
+ * pj_slab_create()
+ */
+PJ_DEF(pj_status_t) pj_slab_create( pj_pool_factory *factory,
+				    const char *name,
+				    pj_size_t obj_size,
+				    unsigned obj_per_chunk,
+				    pj_slab_t **p_slab)
+{
+    pj_pool_t *pool;
+    pj_slab_t *slab;
+    pj_size_t chunk_size;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(factory && obj_size && p_slab, PJ_EINVAL);
+
+    if (obj_per_chunk == 0)
+	obj_per_chunk = DEFAULT_OBJ_PER_CHUNK;
+
+    if (obj_size < sizeof(void*))
+	obj_size = sizeof(void*);
+    obj_size = (obj_size + OBJ_ALIGNMENT - 1) & ~(OBJ_ALIGNMENT - 1);
+
+    /* Make each pool block hold exactly one chunk */
+    chunk_size = obj_size * obj_per_chunk + OBJ_ALIGNMENT;
+
+    pool = pj_pool_create(factory, name ? name : "slab%p",
+			  sizeof(pj_slab_t) + 512 + chunk_size,
+			  chunk_size + sizeof(pj_pool_block),
+			  &on_no_memory);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    slab = PJ_POOL_ZALLOC_T(pool, pj_slab_t);
+    if (!slab) {
+	pj_pool_release(pool);
+	return PJ_ENOMEM;
+    }
+
+    slab->pool = pool;
+    slab->obj_size = obj_size;
+    slab->obj_per_chunk = obj_per_chunk;
+    pj_ansi_strncpy(slab->obj_name, pj_pool_getobjname(pool),
+		    sizeof(slab->obj_name)-1);
+
+    status = pj_lock_create_simple_mutex(pool, slab->obj_name, &slab->lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+#if USE_MAGAZINE
+    init_magazines(slab);
+#endif
+
+    *p_slab = slab;
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_slab_alloc()
+ */
+PJ_DEF(void*) pj_slab_alloc(pj_slab_t *slab)
+{
+    void *obj;
+
+    PJ_ASSERT_RETURN(slab, NULL);
+
+#if USE_MAGAZINE
+    if (slab->magazines) {
+	struct slab_magazine *mag = get_magazine(slab);
+
+	pj_lock_acquire(mag->lock);
+	if (!mag->free_list)
+	    mag_refill(slab, mag);
+
+	obj = mag->free_list;
+	if (obj) {
+	    mag->free_list = NEXT_FREE(obj);
+	    --mag->free_cnt;
+	}
+	pj_lock_release(mag->lock);
+
+	return obj;
+    }
+#endif
+
+    pj_lock_acquire(slab->lock);
+    if (!slab->free_list)
+	grow_slab(slab);
+
+    obj = slab->free_list;
+    if (obj)
+	slab->free_list = NEXT_FREE(obj);
+    pj_lock_release(slab->lock);
+
+    return obj;
+}
+
+/*
+ * pj_slab_zalloc()
+ */
+PJ_DEF(void*) pj_slab_zalloc(pj_slab_t *slab)
+{
+    void *obj = pj_slab_alloc(slab);
+    if (obj)
+	pj_bzero(obj, slab->obj_size);
+    return obj;
+}
+
+/*
+ * pj_slab_free()
+ */
+PJ_DEF(void) pj_slab_free(pj_slab_t *slab, void *obj)
+{
+    PJ_ASSERT_ON_FAIL(slab && obj, return);
+
+#if USE_MAGAZINE
+    if (slab->magazines) {
+	struct slab_magazine *mag = get_magazine(slab);
+
+	pj_lock_acquire(mag->lock);
+	if (mag->free_cnt >= PJ_SLAB_MAGAZINE_SIZE)
+	    mag_flush(slab, mag);
+
+	NEXT_FREE(obj) = mag->free_list;
+	mag->free_list = obj;
+	++mag->free_cnt;
+	pj_lock_release(mag->lock);
+	return;
+    }
+#endif
+
+    pj_lock_acquire(slab->lock);
+    NEXT_FREE(obj) = slab->free_list;
+    slab->free_list = obj;
+    pj_lock_release(slab->lock);
+}
+
+/*
+ * pj_slab_get_obj_size()
+ */
+PJ_DEF(pj_size_t) pj_slab_get_obj_size(const pj_slab_t *slab)
+{
+    return slab->obj_size;
+}
+
+/*
+ * pj_slab_get_capacity()
+ */
+PJ_DEF(pj_size_t) pj_slab_get_capacity(pj_slab_t *slab)
+{
+    pj_size_t capacity;
+
+    pj_lock_acquire(slab->lock);
+    capacity = slab->capacity;
+    pj_lock_release(slab->lock);
+
+    return capacity;
+}
+
+/*
+ * pj_slab_destroy()
+ */
+PJ_DEF(void) pj_slab_destroy(pj_slab_t *slab)
+{
+    PJ_ASSERT_ON_FAIL(slab, return);
+
+#if USE_MAGAZINE
+    destroy_magazines(slab);
+#endif
+
+    pj_lock_destroy(slab->lock);
+    pj_pool_release(slab->pool);
+}
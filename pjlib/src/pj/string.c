@@ -40,9 +40,14 @@ PJ_DEF(char*) pj_strstr(const pj_str_t *str, const pj_str_t *substr)
 
     s = str->ptr;
     ends = str->ptr + str->slen - substr->slen;
-    for (; s<=ends; ++s) {
+    while (s <= ends) {
+	/* Let pj_memchr() find the candidates, it is usually vectorized */
+	s = (const char*) pj_memchr(s, substr->ptr[0], ends - s + 1);
+	if (s == NULL)
+	    break;
 	if (pj_ansi_strncmp(s, substr->ptr, substr->slen)==0)
 	    return (char*)s;
+	++s;
     }
     return NULL;
 }
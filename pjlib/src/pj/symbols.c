@@ -78,6 +78,7 @@ PJ_EXPORT_SYMBOL(pj_create_unique_string)
  */
 PJ_EXPORT_SYMBOL(pj_hash_calc)
 PJ_EXPORT_SYMBOL(pj_hash_create)
+PJ_EXPORT_SYMBOL(pj_hash_create2)
 PJ_EXPORT_SYMBOL(pj_hash_get)
 PJ_EXPORT_SYMBOL(pj_hash_set)
 PJ_EXPORT_SYMBOL(pj_hash_count)
@@ -89,6 +90,8 @@ PJ_EXPORT_SYMBOL(pj_hash_this)
  * ioqueue.h
  */
 PJ_EXPORT_SYMBOL(pj_ioqueue_create)
+PJ_EXPORT_SYMBOL(pj_ioqueue_create2)
+PJ_EXPORT_SYMBOL(pj_ioqueue_cfg_default)
 PJ_EXPORT_SYMBOL(pj_ioqueue_destroy)
 PJ_EXPORT_SYMBOL(pj_ioqueue_set_lock)
 PJ_EXPORT_SYMBOL(pj_ioqueue_register_sock)
@@ -101,6 +104,8 @@ PJ_EXPORT_SYMBOL(pj_ioqueue_recvfrom)
 PJ_EXPORT_SYMBOL(pj_ioqueue_write)
 PJ_EXPORT_SYMBOL(pj_ioqueue_send)
 PJ_EXPORT_SYMBOL(pj_ioqueue_sendto)
+PJ_EXPORT_SYMBOL(pj_ioqueue_recvmmsg)
+PJ_EXPORT_SYMBOL(pj_ioqueue_sendmmsg)
 #if defined(PJ_HAS_TCP) && PJ_HAS_TCP != 0
 PJ_EXPORT_SYMBOL(pj_ioqueue_accept)
 PJ_EXPORT_SYMBOL(pj_ioqueue_connect)
@@ -173,6 +178,10 @@ PJ_EXPORT_SYMBOL(pj_atomic_set)
 PJ_EXPORT_SYMBOL(pj_atomic_get)
 PJ_EXPORT_SYMBOL(pj_atomic_inc)
 PJ_EXPORT_SYMBOL(pj_atomic_dec)
+PJ_EXPORT_SYMBOL(pj_atomic_get_acquire)
+PJ_EXPORT_SYMBOL(pj_atomic_set_release)
+PJ_EXPORT_SYMBOL(pj_atomic_inc_relaxed)
+PJ_EXPORT_SYMBOL(pj_atomic_dec_and_get_release)
 PJ_EXPORT_SYMBOL(pj_thread_local_alloc)
 PJ_EXPORT_SYMBOL(pj_thread_local_free)
 PJ_EXPORT_SYMBOL(pj_thread_local_set)
@@ -245,6 +254,17 @@ PJ_EXPORT_SYMBOL(pj_rbtree_erase)
 PJ_EXPORT_SYMBOL(pj_rbtree_max_height)
 PJ_EXPORT_SYMBOL(pj_rbtree_min_height)
 
+/*
+ * slab.h
+ */
+PJ_EXPORT_SYMBOL(pj_slab_create)
+PJ_EXPORT_SYMBOL(pj_slab_alloc)
+PJ_EXPORT_SYMBOL(pj_slab_zalloc)
+PJ_EXPORT_SYMBOL(pj_slab_free)
+PJ_EXPORT_SYMBOL(pj_slab_get_obj_size)
+PJ_EXPORT_SYMBOL(pj_slab_get_capacity)
+PJ_EXPORT_SYMBOL(pj_slab_destroy)
+
 /*
  * sock.h
  */
@@ -333,7 +353,9 @@ PJ_EXPORT_SYMBOL(pj_utoa_pad)
  * timer.h
  */
 PJ_EXPORT_SYMBOL(pj_timer_heap_mem_size)
+PJ_EXPORT_SYMBOL(pj_timer_heap_mem_size2)
 PJ_EXPORT_SYMBOL(pj_timer_heap_create)
+PJ_EXPORT_SYMBOL(pj_timer_heap_create2)
 PJ_EXPORT_SYMBOL(pj_timer_entry_init)
 PJ_EXPORT_SYMBOL(pj_timer_heap_schedule)
 PJ_EXPORT_SYMBOL(pj_timer_heap_cancel)
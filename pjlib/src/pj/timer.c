@@ -45,6 +45,16 @@
 
 #define DEFAULT_MAX_TIMED_OUT_PER_POLL  (64)
 
+/* Timing wheel geometry. Level 0 has one millisecond slots, each higher
+ * level covers WHEEL_SIZE slots of the level below it. Timers further
+ * than WHEEL_LEVELS levels away (about 49 days) go to the overflow list.
+ */
+#define WHEEL_BITS	8
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+#define WHEEL_LEVELS	4
+#define WHEEL_OVERFLOW	(WHEEL_LEVELS * WHEEL_SIZE)
+
 enum
 {
     F_DONT_CALL = 1,
@@ -105,6 +115,52 @@ struct pj_timer_heap_t
     /** Callback to be called when a timer expires. */
     pj_timer_heap_callback *callback;
 
+    /** The timing wheel, or NULL if this is a binary heap. */
+    struct timer_wheel *wheel;
+
+};
+
+
+/**
+ * Timing wheel entry, located by the timer id of the entry.
+ */
+struct wheel_node
+{
+    /** The timer entry, or NULL if this node is in the freelist. */
+    pj_timer_entry *entry;
+
+    /** Previous node in the slot, zero if this is the first. */
+    pj_timer_id_t prev;
+
+    /** Next node in the slot or in the freelist, zero if none. */
+    pj_timer_id_t next;
+
+    /** The slot where this node is linked. */
+    unsigned slot;
+};
+
+
+/**
+ * Hierarchical timing wheel. Each slot is a doubly linked list of
+ * wheel nodes, so scheduling and cancelling are O(1). A timer is put in
+ * the lowest level where it shares the block of slots with the current
+ * tick, thus all timers in a level expire before any timer in the level
+ * above it. When the current tick enters a new block, the corresponding
+ * slot of the level above is cascaded down.
+ */
+struct timer_wheel
+{
+    /** Current tick in msec. Ticks before this have been processed. */
+    pj_uint64_t cur;
+
+    /** Number of timers in each level, including the overflow list. */
+    pj_size_t level_cnt[WHEEL_LEVELS + 1];
+
+    /** The first node of each slot, zero if the slot is empty. */
+    pj_timer_id_t slots[WHEEL_OVERFLOW + 1];
+
+    /** The nodes, indexed by timer id. */
+    struct wheel_node *nodes;
 };
 
 
@@ -301,10 +357,258 @@ static void insert_node(pj_timer_heap_t *ht, pj_timer_entry *new_node)
 }
 
 
+PJ_INLINE(pj_uint64_t) time_to_tick(const pj_time_val *t)
+{
+    return (pj_uint64_t)t->sec * 1000 + t->msec;
+}
+
+static void wheel_link(struct timer_wheel *w, pj_timer_id_t id)
+{
+    struct wheel_node *node = &w->nodes[id];
+    pj_uint64_t tick = time_to_tick(&node->entry->_timer_value);
+    pj_uint64_t diff;
+    unsigned level;
+
+    // Timers that are already due go to the current slot.
+    if (tick < w->cur)
+	tick = w->cur;
+
+    // Find the lowest level where the timer shares the block with
+    // the current tick.
+    diff = tick ^ w->cur;
+    for (level=0; level<WHEEL_LEVELS; ++level) {
+	if ((diff >> (WHEEL_BITS * (level+1))) == 0)
+	    break;
+    }
+
+    if (level == WHEEL_LEVELS) {
+	node->slot = WHEEL_OVERFLOW;
+    } else {
+	node->slot = level * WHEEL_SIZE +
+		     (unsigned)((tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    }
+
+    node->prev = 0;
+    node->next = w->slots[node->slot];
+    if (node->next)
+	w->nodes[node->next].prev = id;
+    w->slots[node->slot] = id;
+    w->level_cnt[level]++;
+}
+
+static void wheel_unlink(struct timer_wheel *w, pj_timer_id_t id)
+{
+    struct wheel_node *node = &w->nodes[id];
+
+    if (node->prev)
+	w->nodes[node->prev].next = node->next;
+    else
+	w->slots[node->slot] = node->next;
+    if (node->next)
+	w->nodes[node->next].prev = node->prev;
+
+    w->level_cnt[node->slot / WHEEL_SIZE]--;
+}
+
+static void grow_wheel(pj_timer_heap_t *ht)
+{
+    pj_size_t new_size = ht->max_size * 2;
+    struct wheel_node *new_nodes;
+    pj_size_t i;
+
+    new_nodes = (struct wheel_node*)
+		pj_pool_alloc(ht->pool, new_size * sizeof(struct wheel_node));
+    memcpy(new_nodes, ht->wheel->nodes,
+	   ht->max_size * sizeof(struct wheel_node));
+
+    // The freelist continues to the new nodes.
+    for (i = ht->max_size; i < new_size; i++) {
+	new_nodes[i].entry = NULL;
+	new_nodes[i].next = (pj_timer_id_t)(i + 1);
+    }
+
+    ht->wheel->nodes = new_nodes;
+    ht->max_size = new_size;
+}
+
+static void wheel_insert(pj_timer_heap_t *ht, pj_timer_entry *entry)
+{
+    struct timer_wheel *w = ht->wheel;
+    pj_timer_id_t id;
+
+    if (ht->cur_size + 2 >= ht->max_size)
+	grow_wheel(ht);
+
+    id = ht->timer_ids_freelist;
+    ht->timer_ids_freelist = w->nodes[id].next;
+
+    w->nodes[id].entry = entry;
+    entry->_timer_id = id;
+    wheel_link(w, id);
+    ht->cur_size++;
+}
+
+static pj_timer_entry *wheel_remove(pj_timer_heap_t *ht, pj_timer_id_t id)
+{
+    struct timer_wheel *w = ht->wheel;
+    pj_timer_entry *entry = w->nodes[id].entry;
+
+    wheel_unlink(w, id);
+
+    w->nodes[id].entry = NULL;
+    w->nodes[id].next = ht->timer_ids_freelist;
+    ht->timer_ids_freelist = id;
+    ht->cur_size--;
+
+    entry->_timer_id = -1;
+    return entry;
+}
+
+/* Move timers of the upper levels down when the current tick has just
+ * entered a new block of level 0 slots.
+ */
+static void wheel_cascade(struct timer_wheel *w)
+{
+    unsigned level;
+
+    // Find the highest level whose block boundary has been crossed.
+    for (level=1; level<WHEEL_LEVELS; ++level) {
+	if ((w->cur >> (WHEEL_BITS * level)) & WHEEL_MASK)
+	    break;
+    }
+
+    for (; level>0; --level) {
+	unsigned slot;
+	pj_timer_id_t id;
+
+	if (level == WHEEL_LEVELS) {
+	    slot = WHEEL_OVERFLOW;
+	} else {
+	    slot = level * WHEEL_SIZE +
+		   (unsigned)((w->cur >> (WHEEL_BITS * level)) & WHEEL_MASK);
+	}
+
+	// Detach the whole slot first, since some timers in the
+	// overflow list may be linked back to it.
+	id = w->slots[slot];
+	w->slots[slot] = 0;
+	while (id) {
+	    pj_timer_id_t next = w->nodes[id].next;
+
+	    w->level_cnt[level]--;
+	    wheel_link(w, id);
+	    id = next;
+	}
+    }
+}
+
+/* Remove a timer which has expired by now, advancing the current tick
+ * as needed. Timers of the same millisecond share one slot, so they are
+ * expired back to back without further wheel processing.
+ */
+static pj_timer_entry *wheel_pop_expired(pj_timer_heap_t *ht,
+					 const pj_time_val *now)
+{
+    struct timer_wheel *w = ht->wheel;
+    pj_uint64_t now_tick = time_to_tick(now);
+
+    // Another thread may have polled with a later time.
+    if (w->cur > now_tick)
+	return NULL;
+
+    if (ht->cur_size == 0) {
+	w->cur = now_tick;
+	return NULL;
+    }
+
+    for (;;) {
+	pj_timer_id_t id = w->slots[w->cur & WHEEL_MASK];
+	pj_uint64_t next;
+	unsigned level;
+
+	if (id)
+	    return wheel_remove(ht, id);
+
+	if (w->cur == now_tick)
+	    return NULL;
+
+	// Skip to the next block boundary of the lowest non-empty level,
+	// since nothing happens in between.
+	for (level=0; level<WHEEL_LEVELS && w->level_cnt[level]==0; ++level)
+	    ;
+	if (level == 0) {
+	    next = w->cur + 1;
+	} else {
+	    pj_uint64_t mask = ((pj_uint64_t)1 << (WHEEL_BITS * level)) - 1;
+	    next = (w->cur | mask) + 1;
+	}
+
+	w->cur = (next > now_tick) ? now_tick : next;
+
+	if ((w->cur & WHEEL_MASK) == 0)
+	    wheel_cascade(w);
+    }
+}
+
+/* Get the expiration time of the first timer in the wheel. Above level 0
+ * this is the start of the first non-empty slot, which may be earlier
+ * than the actual expiration, but it avoids walking a long list.
+ */
+static void wheel_earliest(pj_timer_heap_t *ht, pj_time_val *t)
+{
+    struct timer_wheel *w = ht->wheel;
+    pj_uint64_t tick;
+    unsigned level, i = 0;
+
+    for (level=0; level<WHEEL_LEVELS && w->level_cnt[level]==0; ++level)
+	;
+
+    if (level < WHEEL_LEVELS) {
+	i = (unsigned)((w->cur >> (WHEEL_BITS * level)) & WHEEL_MASK);
+	while (w->slots[level * WHEEL_SIZE + i] == 0)
+	    ++i;
+    }
+
+    if (level == 0) {
+	pj_timer_id_t id = w->slots[i];
+
+	*t = w->nodes[id].entry->_timer_value;
+	return;
+    }
+
+    if (level < WHEEL_LEVELS) {
+	// Replace the bits of this level in the current tick with the
+	// slot index and clear the bits below it.
+	tick = w->cur >> (WHEEL_BITS * (level + 1));
+	tick = ((tick << WHEEL_BITS) | i) << (WHEEL_BITS * level);
+    } else {
+	// The overflow list is cascaded at the next block of the wheel.
+	tick = ((w->cur >> (WHEEL_BITS * level)) + 1) <<
+	       (WHEEL_BITS * level);
+    }
+
+    t->sec = (long)(tick / 1000);
+    t->msec = (long)(tick % 1000);
+}
+
+static void earliest_time(pj_timer_heap_t *ht, pj_time_val *t)
+{
+    if (ht->wheel)
+	wheel_earliest(ht, t);
+    else
+	*t = ht->heap[0]->_timer_value;
+}
+
 static pj_status_t schedule_entry( pj_timer_heap_t *ht,
 				   pj_timer_entry *entry, 
 				   const pj_time_val *future_time )
 {
+    if (ht->wheel) {
+	entry->_timer_value = *future_time;
+	wheel_insert(ht, entry);
+	return 0;
+    }
+
     if (ht->cur_size < ht->max_size)
     {
 	// Obtain the next unique sequence number.
@@ -333,6 +637,31 @@ static int cancel( pj_timer_heap_t *ht,
     return 0;
   }
 
+  if (ht->wheel)
+    {
+      pj_timer_entry *node_entry;
+
+      if ((pj_size_t)entry->_timer_id == ht->max_size) {
+	entry->_timer_id = -1;
+	return 0;
+      }
+
+      node_entry = ht->wheel->nodes[entry->_timer_id].entry;
+      if (node_entry != entry) {
+	if (node_entry && (flags & F_DONT_ASSERT) == 0)
+	  pj_assert(node_entry == entry);
+	entry->_timer_id = -1;
+	return 0;
+      }
+
+      wheel_remove(ht, entry->_timer_id);
+
+      if ((flags & F_DONT_CALL) == 0)
+        // Call the close hook.
+	(*ht->callback)(ht, entry);
+      return 1;
+    }
+
   timer_node_slot = ht->timer_ids[entry->_timer_id];
 
   if (timer_node_slot < 0) { // Check to see if timer_id is still valid.
@@ -364,10 +693,28 @@ static int cancel( pj_timer_heap_t *ht,
  */
 PJ_DEF(pj_size_t) pj_timer_heap_mem_size(pj_size_t count)
 {
+    return pj_timer_heap_mem_size2(count,
+				   PJ_TIMER_USE_WHEEL ? PJ_TIMER_HEAP_WHEEL :
+							PJ_TIMER_HEAP_BINARY);
+}
+
+PJ_DEF(pj_size_t) pj_timer_heap_mem_size2(pj_size_t count,
+					  pj_timer_heap_type type)
+{
+    pj_size_t size;
+
+    if (type == PJ_TIMER_HEAP_WHEEL) {
+	size = /* the wheel, including its slots: */
+	       sizeof(struct timer_wheel) +
+	       /* size of each entry: */
+	       (count+2) * sizeof(struct wheel_node);
+    } else {
+	size = /* size of each entry: */
+	       (count+2) * (sizeof(pj_timer_entry*)+sizeof(pj_timer_id_t));
+    }
+
     return /* size of the timer heap itself: */
-           sizeof(pj_timer_heap_t) + 
-           /* size of each entry: */
-           (count+2) * (sizeof(pj_timer_entry*)+sizeof(pj_timer_id_t)) +
+           sizeof(pj_timer_heap_t) + size +
            /* lock, pool etc: */
            132;
 }
@@ -378,11 +725,27 @@ PJ_DEF(pj_size_t) pj_timer_heap_mem_size(pj_size_t count)
 PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
 					  pj_size_t size,
                                           pj_timer_heap_t **p_heap)
+{
+    return pj_timer_heap_create2(pool, size,
+				 PJ_TIMER_USE_WHEEL ? PJ_TIMER_HEAP_WHEEL :
+						      PJ_TIMER_HEAP_BINARY,
+				 p_heap);
+}
+
+/*
+ * Create a new timer heap with the specified engine.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create2( pj_pool_t *pool,
+					   pj_size_t size,
+					   pj_timer_heap_type type,
+					   pj_timer_heap_t **p_heap)
 {
     pj_timer_heap_t *ht;
     pj_size_t i;
 
     PJ_ASSERT_RETURN(pool && p_heap, PJ_EINVAL);
+    PJ_ASSERT_RETURN(type == PJ_TIMER_HEAP_BINARY ||
+		     type == PJ_TIMER_HEAP_WHEEL, PJ_EINVAL);
 
     *p_heap = NULL;
 
@@ -404,6 +767,32 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
     /* Lock. */
     ht->lock = NULL;
     ht->auto_delete_lock = 0;
+    ht->wheel = NULL;
+
+    if (type == PJ_TIMER_HEAP_WHEEL) {
+	pj_time_val now;
+
+	ht->wheel = PJ_POOL_ZALLOC_T(pool, struct timer_wheel);
+	if (!ht->wheel)
+	    return PJ_ENOMEM;
+
+	ht->wheel->nodes = (struct wheel_node*)
+			   pj_pool_alloc(pool,
+					 sizeof(struct wheel_node) * size);
+	if (!ht->wheel->nodes)
+	    return PJ_ENOMEM;
+
+	for (i=0; i<size; ++i) {
+	    ht->wheel->nodes[i].entry = NULL;
+	    ht->wheel->nodes[i].next = (pj_timer_id_t)(i + 1);
+	}
+
+	pj_gettickcount(&now);
+	ht->wheel->cur = time_to_tick(&now);
+
+	*p_heap = ht;
+	return PJ_SUCCESS;
+    }
 
     // Create the heap array.
     ht->heap = (pj_timer_entry**)
@@ -623,13 +1012,21 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
     count = 0;
     pj_gettickcount(&now);
 
-    while ( ht->cur_size && 
-	    PJ_TIME_VAL_LTE(ht->heap[0]->_timer_value, now) &&
-            count < ht->max_entries_per_poll ) 
+    while ( ht->cur_size && count < ht->max_entries_per_poll ) 
     {
-	pj_timer_entry *node = remove_node(ht, 0);
+	pj_timer_entry *node;
 	pj_grp_lock_t *grp_lock;
 
+	if (ht->wheel) {
+	    node = wheel_pop_expired(ht, &now);
+	    if (!node)
+		break;
+	} else if (PJ_TIME_VAL_LTE(ht->heap[0]->_timer_value, now)) {
+	    node = remove_node(ht, 0);
+	} else {
+	    break;
+	}
+
 	++count;
 
 	grp_lock = node->_grp_lock;
@@ -648,7 +1045,7 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
 	lock_timer_heap(ht);
     }
     if (ht->cur_size && next_delay) {
-	*next_delay = ht->heap[0]->_timer_value;
+	earliest_time(ht, next_delay);
 	PJ_TIME_VAL_SUB(*next_delay, now);
 	if (next_delay->sec < 0 || next_delay->msec < 0)
 	    next_delay->sec = next_delay->msec = 0;
@@ -675,7 +1072,7 @@ PJ_DEF(pj_status_t) pj_timer_heap_earliest_time( pj_timer_heap_t * ht,
         return PJ_ENOTFOUND;
 
     lock_timer_heap(ht);
-    *timeval = ht->heap[0]->_timer_value;
+    earliest_time(ht, timeval);
     unlock_timer_heap(ht);
 
     return PJ_SUCCESS;
@@ -700,10 +1097,20 @@ PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
 
 	pj_gettickcount(&now);
 
-	for (i=0; i<(unsigned)ht->cur_size; ++i) {
-	    pj_timer_entry *e = ht->heap[i];
+	for (i=0; i<(unsigned)ht->max_size; ++i) {
+	    pj_timer_entry *e;
 	    pj_time_val delta;
 
+	    if (ht->wheel) {
+		e = ht->wheel->nodes[i].entry;
+		if (!e)
+		    continue;
+	    } else if (i < (unsigned)ht->cur_size) {
+		e = ht->heap[i];
+	    } else {
+		break;
+	    }
+
 	    if (PJ_TIME_VAL_LTE(e->_timer_value, now))
 		delta.sec = delta.msec = 0;
 	    else {
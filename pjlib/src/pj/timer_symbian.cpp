@@ -311,6 +311,18 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
     return PJ_SUCCESS;
 }
 
+/*
+ * Timers are always implemented with active objects on Symbian.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create2( pj_pool_t *pool,
+					   pj_size_t size,
+					   pj_timer_heap_type type,
+					   pj_timer_heap_t **p_heap)
+{
+    PJ_UNUSED_ARG(type);
+    return pj_timer_heap_create(pool, size, p_heap);
+}
+
 PJ_DEF(void) pj_timer_heap_destroy( pj_timer_heap_t *ht )
 {
     /* Cancel and delete pending active objects */
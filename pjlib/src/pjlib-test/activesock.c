@@ -251,6 +251,188 @@ on_return:
 
 
 
+/*******************************************************************
+ * UDP batch test: send packets in batches with pj_ioqueue_sendmmsg()
+ * and receive them with pj_activesock_start_recvfrom_batch().
+ */
+struct udp_batch_rx
+{
+    unsigned	rx_cnt;
+    unsigned	batch_cnt;
+    unsigned	max_batch;
+    unsigned	err_cnt;
+};
+
+static pj_bool_t udp_batch_on_data_recvfrom_batch(pj_activesock_t *asock,
+						  const pj_ioqueue_mmsg pkt[],
+						  unsigned count,
+						  pj_status_t status)
+{
+    struct udp_batch_rx *rx;
+    unsigned i;
+
+    rx = (struct udp_batch_rx*) pj_activesock_get_user_data(asock);
+
+    if (status != PJ_SUCCESS) {
+	rx->err_cnt++;
+	udp_echo_err("recvfrom batch callback", status);
+	return PJ_TRUE;
+    }
+
+    for (i=0; i<count; ++i) {
+	if (pkt[i].len != sizeof(pj_uint32_t) ||
+	    *(pj_uint32_t*)pkt[i].buf != rx->rx_cnt + i)
+	{
+	    rx->err_cnt++;
+	}
+    }
+
+    rx->rx_cnt += count;
+    rx->batch_cnt++;
+    if (count > rx->max_batch)
+	rx->max_batch = count;
+
+    return PJ_TRUE;
+}
+
+static int udp_batch_test(void)
+{
+    enum { BATCH = 8, ROUNDS = 16 };
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_pool_t *pool = NULL;
+    pj_activesock_t *asock = NULL;
+    pj_ioqueue_key_t *key = NULL;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_activesock_cb cb;
+    pj_ioqueue_callback ioq_cb;
+    struct udp_batch_rx rx;
+    pj_uint32_t data[BATCH];
+    pj_ioqueue_mmsg msg[BATCH];
+    pj_sockaddr addr;
+    pj_str_t loopback;
+    unsigned i, j, seq = 0;
+    int ret;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "udpbatch", 512, 512, NULL);
+    if (!pool)
+	return -200;
+
+    status = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	ret = -210;
+	goto on_return;
+    }
+
+    pj_bzero(&rx, sizeof(rx));
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_data_recvfrom_batch = &udp_batch_on_data_recvfrom_batch;
+
+    loopback = pj_str("127.0.0.1");
+    pj_sockaddr_in_init(&addr.ipv4, &loopback, 0);
+    status = pj_activesock_create_udp(pool, &addr, NULL, ioqueue, &cb,
+				      &rx, &asock, &addr);
+    if (status != PJ_SUCCESS) {
+	ret = -220;
+	goto on_return;
+    }
+
+    status = pj_activesock_start_recvfrom_batch(asock, pool, 32, BATCH, 0);
+    if (status != PJ_SUCCESS) {
+	ret = -230;
+	goto on_return;
+    }
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock);
+    if (status != PJ_SUCCESS) {
+	ret = -240;
+	goto on_return;
+    }
+
+    pj_bzero(&ioq_cb, sizeof(ioq_cb));
+    status = pj_ioqueue_register_sock(pool, ioqueue, sock, NULL, &ioq_cb,
+				      &key);
+    if (status != PJ_SUCCESS) {
+	pj_sock_close(sock);
+	ret = -250;
+	goto on_return;
+    }
+
+    for (i=0; i<ROUNDS; ++i) {
+	unsigned count = BATCH;
+
+	for (j=0; j<BATCH; ++j) {
+	    data[j] = seq + j;
+	    msg[j].buf = &data[j];
+	    msg[j].len = sizeof(data[j]);
+	    msg[j].addr = &addr;
+	    msg[j].addrlen = pj_sockaddr_get_len(&addr);
+	}
+
+	status = pj_ioqueue_sendmmsg(key, msg, &count, 0);
+	if (status == PJ_ENOTSUP || status == PJ_EBUSY) {
+	    /* Batch send is not supported, or the socket can't take
+	     * anything right now.
+	     */
+	    count = 0;
+	    status = PJ_SUCCESS;
+	}
+	if (status == PJ_SUCCESS && count < BATCH) {
+	    /* Send the rest one by one */
+	    for (j=count; j<BATCH; ++j) {
+		pj_ssize_t sent = sizeof(data[j]);
+		status = pj_sock_sendto(sock, &data[j], &sent, 0,
+					&addr, msg[j].addrlen);
+		if (status != PJ_SUCCESS)
+		    break;
+	    }
+	    count = j;
+	}
+	if (status != PJ_SUCCESS || count != BATCH) {
+	    udp_echo_err("pj_ioqueue_sendmmsg()", status);
+	    ret = -260;
+	    goto on_return;
+	}
+	seq += BATCH;
+
+	for (j=0; j<20 && rx.rx_cnt < seq; ++j) {
+	    pj_time_val delay = {0, 10};
+#ifdef PJ_SYMBIAN
+	    PJ_UNUSED_ARG(delay);
+	    pj_symbianos_poll(-1, 100);
+#else
+	    pj_ioqueue_poll(ioqueue, &delay);
+#endif
+	}
+
+	if (rx.err_cnt) {
+	    ret = -270;
+	    goto on_return;
+	}
+	if (rx.rx_cnt != seq) {
+	    udp_echo_err("packets have been lost", PJ_ETIMEDOUT);
+	    ret = -280;
+	    goto on_return;
+	}
+    }
+
+    PJ_LOG(3,("", "...%d packets received in %d batches (max %d)",
+	      rx.rx_cnt, rx.batch_cnt, rx.max_batch));
+    ret = 0;
+
+on_return:
+    if (key)
+	pj_ioqueue_unregister(key);
+    if (asock)
+	pj_activesock_close(asock);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    if (pool)
+	pj_pool_release(pool);
+    
+    return ret;
+}
+
 #define SIGNATURE   0xdeadbeef
 struct tcp_pkt
 {
@@ -503,6 +685,11 @@ int activesock_test(void)
     if (ret != 0)
 	return ret;
 
+    PJ_LOG(3,("", "..udp batch test"));
+    ret = udp_batch_test();
+    if (ret != 0)
+	return ret;
+
     PJ_LOG(3,("", "..tcp perf test"));
     ret = tcp_perf_test();
     if (ret != 0)
@@ -34,6 +34,10 @@
  *  - pj_atomic_inc()
  *  - pj_atomic_dec()
  *  - pj_atomic_set()
+ *  - pj_atomic_get_acquire()
+ *  - pj_atomic_set_release()
+ *  - pj_atomic_inc_relaxed()
+ *  - pj_atomic_dec_and_get_release()
  *  - pj_atomic_destroy()
  *
  *
@@ -45,6 +49,53 @@
 
 #if INCLUDE_ATOMIC_TEST
 
+#define THREAD_CNT	4
+#define LOOP_CNT	100000
+
+static int atomic_thread(void *arg)
+{
+    pj_atomic_t *atomic_var = (pj_atomic_t*)arg;
+    unsigned i;
+
+    for (i=0; i<LOOP_CNT; ++i) {
+	pj_atomic_inc(atomic_var);
+	pj_atomic_inc_relaxed(atomic_var);
+	pj_atomic_dec_and_get_release(atomic_var);
+    }
+    return 0;
+}
+
+/* Check that concurrent updates are not lost. */
+static int atomic_thread_test(pj_pool_t *pool)
+{
+    pj_thread_t *thread[THREAD_CNT];
+    pj_atomic_t *atomic_var;
+    unsigned i;
+    pj_status_t rc;
+
+    rc = pj_atomic_create(pool, 0, &atomic_var);
+    if (rc != 0)
+	return -100;
+
+    for (i=0; i<THREAD_CNT; ++i) {
+	rc = pj_thread_create(pool, "atomic", &atomic_thread, atomic_var,
+			      0, 0, &thread[i]);
+	if (rc != 0)
+	    return -110;
+    }
+
+    for (i=0; i<THREAD_CNT; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+
+    if (pj_atomic_get(atomic_var) != THREAD_CNT * LOOP_CNT)
+	return -120;
+
+    pj_atomic_destroy(atomic_var);
+    return 0;
+}
+
 int atomic_test(void)
 {
     pj_pool_t *pool;
@@ -89,11 +140,25 @@ int atomic_test(void)
     if (pj_atomic_get(atomic_var) != 221)
         return -70;
 
+    /* release/acquire */
+    pj_atomic_set_release(atomic_var, 300);
+    if (pj_atomic_get_acquire(atomic_var) != 300)
+        return -72;
+
+    /* reference counting */
+    pj_atomic_inc_relaxed(atomic_var);
+    if (pj_atomic_dec_and_get_release(atomic_var) != 300)
+        return -74;
+
     /* destroy */
     rc = pj_atomic_destroy(atomic_var);
     if (rc != 0)
         return -80;
 
+    rc = atomic_thread_test(pool);
+    if (rc != 0)
+        return rc;
+
     pj_pool_release(pool);
 
     return 0;
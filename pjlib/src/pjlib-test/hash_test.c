@@ -21,20 +21,27 @@
 #include <pj/rand.h>
 #include <pj/log.h>
 #include <pj/pool.h>
+#include <pj/os.h>
+#include <pj/string.h>
 #include "test.h"
 
 #if INCLUDE_HASH_TEST
 
+#define THIS_FILE   "hash_test.c"
 #define HASH_COUNT  31
 
-static int hash_test_with_key(pj_pool_t *pool, unsigned char key)
+/* Number of keys in the benchmark */
+#define BENCH_COUNT 20000
+
+static int hash_test_with_key(pj_pool_t *pool, unsigned char key,
+			      unsigned options)
 {
     pj_hash_table_t *ht;
     unsigned value = 0x12345;
     pj_hash_iterator_t it_buf, *it;
     unsigned *entry;
 
-    ht = pj_hash_create(pool, HASH_COUNT);
+    ht = pj_hash_create2(pool, HASH_COUNT, options);
     if (!ht)
 	return -10;
 
@@ -83,7 +90,7 @@ static int hash_test_with_key(pj_pool_t *pool, unsigned char key)
 }
 
 
-static int hash_collision_test(pj_pool_t *pool)
+static int hash_collision_test(pj_pool_t *pool, unsigned options)
 {
     enum {
 	COUNT = HASH_COUNT * 4
@@ -93,7 +100,7 @@ static int hash_collision_test(pj_pool_t *pool)
     unsigned char *values;
     unsigned i;
 
-    ht = pj_hash_create(pool, HASH_COUNT);
+    ht = pj_hash_create2(pool, HASH_COUNT, options);
     if (!ht)
 	return -200;
 
@@ -130,32 +137,335 @@ static int hash_collision_test(pj_pool_t *pool)
 }
 
 
+/* Generate a key which looks like a transaction key (branch parameter
+ * and Call-ID), so that the keys share long prefixes.
+ */
+static void make_key(char *buf, unsigned size, unsigned i)
+{
+    pj_ansi_snprintf(buf, size,
+		     "z9hG4bKPj%08x-5f8e-4c2a-9b1d-%012x$"
+		     "%08x@pc33.Atlanta.Example.com",
+		     i * 2654435761U, i, i / 4);
+}
+
+/* Grow the table from a small size, remove entries while iterating it,
+ * and insert them again.
+ */
+static int hash_resize_test(pj_pool_t *pool, unsigned options)
+{
+    enum { COUNT = 2000, KEY_LEN = 80 };
+    pj_hash_table_t *ht;
+    pj_hash_iterator_t it_buf, *it;
+    char *keys;
+    unsigned i, cnt;
+
+    ht = pj_hash_create2(pool, 4, options);
+    if (!ht)
+	return -300;
+
+    keys = (char*) pj_pool_alloc(pool, COUNT * KEY_LEN);
+    for (i=0; i<COUNT; ++i) {
+	make_key(keys + i*KEY_LEN, KEY_LEN, i);
+	pj_hash_set_lower(pool, ht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING, 0,
+			  keys + i*KEY_LEN);
+	if (pj_hash_count(ht) != i+1)
+	    return -310;
+    }
+
+    for (i=0; i<COUNT; ++i) {
+	char upper[KEY_LEN];
+	pj_str_t key;
+	pj_uint32_t hval;
+
+	/* Lookup with different case and precomputed hash value */
+	pj_ansi_strcpy(upper, keys + i*KEY_LEN);
+	upper[0] = 'Z';
+	key = pj_str(upper);
+	hval = pj_hash_calc_tolower(0, NULL, &key);
+	if (pj_hash_get_lower(ht, upper, (unsigned)key.slen, &hval) !=
+	    keys + i*KEY_LEN)
+	{
+	    return -320;
+	}
+    }
+
+    /* Remove every other entry while iterating */
+    cnt = 0;
+    it = pj_hash_first(ht, &it_buf);
+    while (it) {
+	char *key = (char*) pj_hash_this(ht, it);
+	pj_hash_iterator_t *next;
+
+	if (((key - keys) / KEY_LEN) % 2)
+	    pj_hash_set_lower(NULL, ht, key, PJ_HASH_KEY_STRING, 0, NULL);
+
+	next = pj_hash_next(ht, it);
+	++cnt;
+	it = next;
+    }
+
+    if (cnt != COUNT || pj_hash_count(ht) != COUNT/2)
+	return -330;
+
+    for (i=0; i<COUNT; ++i) {
+	void *value = pj_hash_get_lower(ht, keys + i*KEY_LEN,
+					PJ_HASH_KEY_STRING, NULL);
+	if ((i % 2 && value != NULL) || (i % 2 == 0 && value == NULL))
+	    return -340;
+    }
+
+    /* Insert the removed entries again */
+    for (i=1; i<COUNT; i+=2) {
+	pj_hash_set_lower(pool, ht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING, 0,
+			  keys + i*KEY_LEN);
+    }
+
+    if (pj_hash_count(ht) != COUNT)
+	return -350;
+
+    cnt = 0;
+    for (it=pj_hash_first(ht, &it_buf); it; it=pj_hash_next(ht, it))
+	++cnt;
+
+    if (cnt != COUNT)
+	return -360;
+
+    for (i=0; i<COUNT; ++i) {
+	if (pj_hash_get_lower(ht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING,
+			      NULL) != keys + i*KEY_LEN)
+	{
+	    return -370;
+	}
+    }
+
+    return 0;
+}
+
+
+/* Insert and remove entries repeatedly with a few live entries, the way
+ * the transaction layer uses the table. The table must not keep growing.
+ */
+static int hash_churn_test(unsigned options)
+{
+    enum { LIVE = 11, KEY_LEN = 80, WARMUP = 1000, LOOP = 200000 };
+    pj_pool_t *pool;
+    pj_hash_table_t *ht;
+    char *keys;
+    pj_size_t used_size = 0;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "hashchurn", 4000, 4000, NULL);
+    ht = pj_hash_create2(pool, LIVE, options);
+    if (!ht) {
+	pj_pool_release(pool);
+	return -500;
+    }
+
+    /* Keys are reused, so entries are added without the pool */
+    keys = (char*) pj_pool_alloc(pool, (LIVE + 1) * KEY_LEN);
+    for (i=0; i<=LIVE; ++i)
+	make_key(keys + i*KEY_LEN, KEY_LEN, i);
+
+    for (i=0; i<LIVE; ++i) {
+	pj_hash_set_np_lower(ht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING, 0,
+			     NULL, keys + i*KEY_LEN);
+    }
+
+    for (i=0; i<WARMUP+LOOP; ++i) {
+	/* Use a different key each time so that the removed entries
+	 * are left in different slots.
+	 */
+	char *key = keys + LIVE*KEY_LEN;
+
+	make_key(key, KEY_LEN, LIVE + i);
+	pj_hash_set_np_lower(ht, key, PJ_HASH_KEY_STRING, 0, NULL, key);
+	pj_hash_set_np_lower(ht, key, PJ_HASH_KEY_STRING, 0, NULL, NULL);
+
+	if (i == WARMUP)
+	    used_size = pj_pool_get_used_size(pool);
+    }
+
+    if (pj_hash_count(ht) != LIVE) {
+	rc = -510;
+    } else if (pj_pool_get_used_size(pool) != used_size) {
+	PJ_LOG(3,(THIS_FILE, "....error: pool grew by %u bytes after %u "
+		  "insert/remove",
+		  (unsigned)(pj_pool_get_used_size(pool) - used_size), LOOP));
+	rc = -520;
+    }
+
+    for (i=0; rc==0 && i<LIVE; ++i) {
+	if (pj_hash_get_lower(ht, keys + i*KEY_LEN, PJ_HASH_KEY_STRING,
+			      NULL) != keys + i*KEY_LEN)
+	{
+	    rc = -530;
+	}
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+
+/* Measure the time to insert, find and remove transaction-like keys,
+ * the way the transaction layer uses the table.
+ */
+static int hash_bench(unsigned options, const char *title)
+{
+    enum { KEY_LEN = 80, LOOKUP_LOOP = 4 };
+    pj_pool_t *pool;
+    pj_hash_table_t *ht;
+    char *keys;
+    pj_str_t *key_str;
+    pj_uint32_t *hvals;
+    pj_timestamp t1, t2;
+    pj_uint32_t t_set, t_get, t_miss, t_del;
+    unsigned i, j;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "hashbench", 4000, 4000, NULL);
+    if (!pool)
+	return -400;
+
+    ht = pj_hash_create2(pool, 1023, options);
+    keys = (char*) pj_pool_alloc(pool, 2 * BENCH_COUNT * KEY_LEN);
+    key_str = (pj_str_t*) pj_pool_calloc(pool, 2 * BENCH_COUNT,
+					 sizeof(pj_str_t));
+    hvals = (pj_uint32_t*) pj_pool_calloc(pool, 2 * BENCH_COUNT,
+					  sizeof(pj_uint32_t));
+
+    for (i=0; i<2*BENCH_COUNT; ++i) {
+	make_key(keys + i*KEY_LEN, KEY_LEN, i);
+	key_str[i] = pj_str(keys + i*KEY_LEN);
+	hvals[i] = pj_hash_calc_tolower(0, NULL, &key_str[i]);
+    }
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_COUNT; ++i) {
+	pj_hash_set_lower(pool, ht, key_str[i].ptr,
+			  (unsigned)key_str[i].slen, hvals[i], &key_str[i]);
+    }
+    pj_get_timestamp(&t2);
+    t_set = pj_elapsed_msec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (j=0; j<LOOKUP_LOOP; ++j) {
+	for (i=0; i<BENCH_COUNT; ++i) {
+	    if (pj_hash_get_lower(ht, key_str[i].ptr,
+				  (unsigned)key_str[i].slen, &hvals[i]) !=
+		&key_str[i])
+	    {
+		rc = -410;
+	    }
+	}
+    }
+    pj_get_timestamp(&t2);
+    t_get = pj_elapsed_msec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (j=0; j<LOOKUP_LOOP; ++j) {
+	for (i=BENCH_COUNT; i<2*BENCH_COUNT; ++i) {
+	    if (pj_hash_get_lower(ht, key_str[i].ptr,
+				  (unsigned)key_str[i].slen, &hvals[i]))
+	    {
+		rc = -420;
+	    }
+	}
+    }
+    pj_get_timestamp(&t2);
+    t_miss = pj_elapsed_msec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_COUNT; ++i) {
+	pj_hash_set_lower(NULL, ht, key_str[i].ptr,
+			  (unsigned)key_str[i].slen, hvals[i], NULL);
+    }
+    pj_get_timestamp(&t2);
+    t_del = pj_elapsed_msec(&t1, &t2);
+
+    if (pj_hash_count(ht) != 0)
+	rc = -430;
+
+    PJ_LOG(3,(THIS_FILE, "....%-22s %6u %6u %6u %6u", title,
+	      t_set, t_get, t_miss, t_del));
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+
 /*
  * Hash table test.
  */
 int hash_test(void)
 {
+    static const struct
+    {
+	unsigned    options;
+	const char *title;
+    } types[] =
+    {
+	{ 0, "chained" },
+	{ PJ_HASH_OPEN_ADDRESSING, "open addressing" },
+	{ PJ_HASH_OPEN_ADDRESSING | PJ_HASH_INCREMENTAL_RESIZE,
+	  "open addr+incremental" }
+    };
     pj_pool_t *pool = pj_pool_create(mem, "hash", 512, 512, NULL);
     int rc;
-    unsigned i;
+    unsigned i, t;
+
+    for (t=0; t<PJ_ARRAY_SIZE(types); ++t) {
+	PJ_LOG(3,(THIS_FILE, "...%s hash table", types[t].title));
+
+	/* Test to fill in each row in the table */
+	for (i=0; i<=HASH_COUNT; ++i) {
+	    rc = hash_test_with_key(pool, (unsigned char)i,
+				    types[t].options);
+	    if (rc != 0) {
+		pj_pool_release(pool);
+		return rc;
+	    }
+	}
 
-    /* Test to fill in each row in the table */
-    for (i=0; i<=HASH_COUNT; ++i) {
-	rc = hash_test_with_key(pool, (unsigned char)i);
+	/* Collision test */
+	rc = hash_collision_test(pool, types[t].options);
 	if (rc != 0) {
 	    pj_pool_release(pool);
 	    return rc;
 	}
-    }
 
-    /* Collision test */
-    rc = hash_collision_test(pool);
-    if (rc != 0) {
-	pj_pool_release(pool);
-	return rc;
+	/* Resize test */
+	rc = hash_resize_test(pool, types[t].options);
+	if (rc != 0) {
+	    pj_pool_release(pool);
+	    return rc;
+	}
+
+	/* Insert/remove test. Chained table allocates new entry from the
+	 * pool for each insertion, unless entry buffer is given.
+	 */
+	if (types[t].options & PJ_HASH_OPEN_ADDRESSING) {
+	    rc = hash_churn_test(types[t].options);
+	    if (rc != 0) {
+		pj_pool_release(pool);
+		return rc;
+	    }
+	}
     }
 
     pj_pool_release(pool);
+
+    PJ_LOG(3,(THIS_FILE, "...benchmark with %d keys, time in msec:",
+	      BENCH_COUNT));
+    PJ_LOG(3,(THIS_FILE, "....%-22s %6s %6s %6s %6s", "table",
+	      "insert", "find", "miss", "remove"));
+    for (t=0; t<PJ_ARRAY_SIZE(types); ++t) {
+	rc = hash_bench(types[t].options, types[t].title);
+	if (rc != 0)
+	    return rc;
+    }
+
     return 0;
 }
 
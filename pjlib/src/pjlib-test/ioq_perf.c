@@ -28,6 +28,11 @@
  * consumer test. The test should examine the effect of using multiple
  * threads on the performance.
  *
+ * To compare ioqueue backends, run the test on builds configured with
+ * each backend (e.g. default select(), --enable-epoll, --enable-uring).
+ * Besides the bandwidth, the table shows the packet rate and the average
+ * number of packets handled by a single #pj_ioqueue_poll() call.
+ *
  * This file is <b>pjlib-test/ioq_perf.c</b>
  *
  * \include pjlib-test/ioq_perf.c
@@ -59,6 +64,7 @@ typedef struct test_item
     pj_ioqueue_op_key_t  recv_op,
                          send_op;
     int                  has_pending_send;
+    unsigned             send_flags;
     pj_size_t            buffer_size;
     char                *outgoing_buffer;
     char                *incoming_buffer;
@@ -133,7 +139,8 @@ static void on_read_complete(pj_ioqueue_key_t *key,
         if (!item->has_pending_send) {
             pj_ssize_t sent = item->buffer_size;
             rc = pj_ioqueue_send(item->client_key, &item->send_op,
-                                 item->outgoing_buffer, &sent, 0);
+                                 item->outgoing_buffer, &sent,
+				 item->send_flags);
             if (rc != PJ_SUCCESS && rc != PJ_EPENDING) {
                 app_perror("...error: write error", rc);
             }
@@ -170,7 +177,8 @@ static void on_write_complete(pj_ioqueue_key_t *key,
 
         bytes_sent = item->buffer_size;
         rc = pj_ioqueue_send( item->client_key, op_key,
-                              item->outgoing_buffer, &bytes_sent, 0);
+                              item->outgoing_buffer, &bytes_sent,
+			      item->send_flags);
         if (rc != PJ_SUCCESS && rc != PJ_EPENDING) {
             app_perror("...error: write error", rc);
         }
@@ -223,6 +231,8 @@ static int worker_thread(void *p)
  *    period of time.
  */
 static int perform_test(pj_bool_t allow_concur,
+			const pj_ioqueue_cfg *cfg,
+			unsigned send_flags,
 			int sock_type, const char *type_name,
                         unsigned thread_cnt, unsigned sockpair_cnt,
                         pj_size_t buffer_size, 
@@ -232,11 +242,12 @@ static int perform_test(pj_bool_t allow_concur,
     pj_pool_t *pool;
     test_item *items;
     pj_thread_t **thread;
+    struct thread_arg **args;
     pj_ioqueue_t *ioqueue;
     pj_status_t rc;
     pj_ioqueue_callback ioqueue_callback;
-    pj_uint32_t total_elapsed_usec, total_received;
-    pj_highprec_t bandwidth;
+    pj_uint32_t total_elapsed_usec, total_received, total_polls;
+    pj_highprec_t bandwidth, pkt_rate;
     pj_timestamp start, stop;
     unsigned i;
 
@@ -254,9 +265,11 @@ static int perform_test(pj_bool_t allow_concur,
     items = (test_item*) pj_pool_alloc(pool, sockpair_cnt*sizeof(test_item));
     thread = (pj_thread_t**)
     	     pj_pool_alloc(pool, thread_cnt*sizeof(pj_thread_t*));
+    args = (struct thread_arg**)
+	   pj_pool_alloc(pool, thread_cnt*sizeof(struct thread_arg*));
 
     TRACE_((THIS_FILE, "     creating ioqueue.."));
-    rc = pj_ioqueue_create(pool, sockpair_cnt*2, &ioqueue);
+    rc = pj_ioqueue_create2(pool, sockpair_cnt*2, cfg, &ioqueue);
     if (rc != PJ_SUCCESS) {
         app_perror("...error: unable to create ioqueue", rc);
         return -15;
@@ -274,9 +287,12 @@ static int perform_test(pj_bool_t allow_concur,
 
         items[i].ioqueue = ioqueue;
         items[i].buffer_size = buffer_size;
+        items[i].send_flags = send_flags;
         items[i].outgoing_buffer = (char*) pj_pool_alloc(pool, buffer_size);
         items[i].incoming_buffer = (char*) pj_pool_alloc(pool, buffer_size);
         items[i].bytes_recv = items[i].bytes_sent = 0;
+	pj_ioqueue_op_key_init(&items[i].recv_op, sizeof(items[i].recv_op));
+	pj_ioqueue_op_key_init(&items[i].send_op, sizeof(items[i].send_op));
 
         /* randomize outgoing buffer. */
         pj_create_random_string(items[i].outgoing_buffer, buffer_size);
@@ -327,7 +343,7 @@ static int perform_test(pj_bool_t allow_concur,
 	TRACE_((THIS_FILE, "      pj_ioqueue_write.."));
         bytes = items[i].buffer_size;
         rc = pj_ioqueue_send(items[i].client_key, &items[i].send_op,
-                             items[i].outgoing_buffer, &bytes, 0);
+                             items[i].outgoing_buffer, &bytes, send_flags);
         if (rc != PJ_SUCCESS && rc != PJ_EPENDING) {
             app_perror("...error: pj_ioqueue_write", rc);
             return -76;
@@ -344,6 +360,7 @@ static int perform_test(pj_bool_t allow_concur,
 	arg->id = i;
 	arg->ioqueue = ioqueue;
 	arg->counter = 0;
+	args[i] = arg;
 
         rc = pj_thread_create( pool, NULL, 
                                &worker_thread, 
@@ -424,7 +441,13 @@ static int perform_test(pj_bool_t allow_concur,
     /* Calculate total bytes received. */
     total_received = 0;
     for (i=0; i<sockpair_cnt; ++i) {
-        total_received = (pj_uint32_t)items[i].bytes_recv;
+        total_received += (pj_uint32_t)items[i].bytes_recv;
+    }
+
+    /* Number of poll calls, to see how many packets each poll handles. */
+    total_polls = 0;
+    for (i=0; i<thread_cnt; ++i) {
+	total_polls += args[i]->counter;
     }
 
     /* bandwidth = total_received*1000/total_elapsed_usec */
@@ -434,9 +457,16 @@ static int perform_test(pj_bool_t allow_concur,
     
     *p_bandwidth = (pj_uint32_t)bandwidth;
 
-    PJ_LOG(3,(THIS_FILE, "   %.4s    %2d        %2d       %8d KB/s",
+    /* pkt_rate = (total_received/buffer_size)*1000000/total_elapsed_usec */
+    pkt_rate = total_received / buffer_size;
+    pj_highprec_mul(pkt_rate, 1000000);
+    pj_highprec_div(pkt_rate, total_elapsed_usec);
+
+    PJ_LOG(3,(THIS_FILE, "   %.4s    %2d        %2d       %8d KB/s %8u %6.2f",
               type_name, thread_cnt, sockpair_cnt,
-              *p_bandwidth));
+              *p_bandwidth, (pj_uint32_t)pkt_rate,
+	      total_polls ? (float)(total_received / buffer_size) /
+			    total_polls : (float)0));
 
     /* Done. */
     pj_pool_release(pool);
@@ -445,7 +475,9 @@ static int perform_test(pj_bool_t allow_concur,
     return 0;
 }
 
-static int ioqueue_perf_test_imp(pj_bool_t allow_concur)
+static int ioqueue_perf_test_imp(pj_bool_t allow_concur,
+				 const pj_ioqueue_cfg *cfg,
+				 unsigned send_flags)
 {
     enum { BUF_SIZE = 512 };
     int i, rc;
@@ -505,16 +537,21 @@ static int ioqueue_perf_test_imp(pj_bool_t allow_concur)
     int best_index = 0;
 
     PJ_LOG(3,(THIS_FILE, "   Benchmarking %s ioqueue:", pj_ioqueue_name()));
-    PJ_LOG(3,(THIS_FILE, "   Testing with concurency=%d", allow_concur));
-    PJ_LOG(3,(THIS_FILE, "   ======================================="));
-    PJ_LOG(3,(THIS_FILE, "   Type  Threads  Skt.Pairs      Bandwidth"));
-    PJ_LOG(3,(THIS_FILE, "   ======================================="));
+    PJ_LOG(3,(THIS_FILE, "   Testing with concurency=%d, epoll_flags=%d, "
+			 "max_events=%d, send_flags=0x%x",
+	      allow_concur, cfg->epoll_flags, cfg->max_events, send_flags));
+    PJ_LOG(3,(THIS_FILE, "   ======================================================"
+			 "====="));
+    PJ_LOG(3,(THIS_FILE, "   Type  Threads  Skt.Pairs      Bandwidth    Pkt/s"
+			 " Pkt/poll"));
+    PJ_LOG(3,(THIS_FILE, "   ======================================================"
+			 "====="));
 
     best_bandwidth = 0;
     for (i=0; i<(int)(sizeof(test_param)/sizeof(test_param[0])); ++i) {
         pj_size_t bandwidth;
 
-        rc = perform_test(allow_concur,
+        rc = perform_test(allow_concur, cfg, send_flags,
 			  test_param[i].type, 
                           test_param[i].type_name,
                           test_param[i].thread_cnt, 
@@ -534,7 +571,9 @@ static int ioqueue_perf_test_imp(pj_bool_t allow_concur)
     }
 
     PJ_LOG(3,(THIS_FILE, 
-              "   Best: Type=%s Threads=%d, Skt.Pairs=%d, Bandwidth=%u KB/s",
+              "   Best (%s): Type=%s Threads=%d, Skt.Pairs=%d, "
+	      "Bandwidth=%u KB/s",
+	      pj_ioqueue_name(),
               test_param[best_index].type_name,
               test_param[best_index].thread_cnt,
               test_param[best_index].sockpair_cnt,
@@ -549,13 +588,48 @@ static int ioqueue_perf_test_imp(pj_bool_t allow_concur)
  */
 int ioqueue_perf_test(void)
 {
+    pj_ioqueue_cfg cfg;
     int rc;
 
-    rc = ioqueue_perf_test_imp(PJ_TRUE);
+    pj_ioqueue_cfg_default(&cfg);
+
+    rc = ioqueue_perf_test_imp(PJ_TRUE, &cfg, 0);
     if (rc != 0)
 	return rc;
 
-    rc = ioqueue_perf_test_imp(PJ_FALSE);
+    rc = ioqueue_perf_test_imp(PJ_FALSE, &cfg, 0);
+    if (rc != 0)
+	return rc;
+
+    /* Compare the epoll dispatching modes for multiple threads */
+    if (pj_ansi_strcmp(pj_ioqueue_name(), "epoll") == 0) {
+	cfg.epoll_flags = PJ_IOQUEUE_EPOLL_EXCLUSIVE;
+	rc = ioqueue_perf_test_imp(PJ_TRUE, &cfg, 0);
+	if (rc != 0)
+	    return rc;
+
+	cfg.epoll_flags = PJ_IOQUEUE_EPOLL_ONESHOT;
+	rc = ioqueue_perf_test_imp(PJ_TRUE, &cfg, 0);
+	if (rc != 0)
+	    return rc;
+
+	rc = ioqueue_perf_test_imp(PJ_FALSE, &cfg, 0);
+	if (rc != 0)
+	    return rc;
+
+	/* Larger batch than the default */
+	cfg.max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL * 4;
+	rc = ioqueue_perf_test_imp(PJ_TRUE, &cfg, 0);
+	if (rc != 0)
+	    return rc;
+
+	pj_ioqueue_cfg_default(&cfg);
+    }
+
+    /* Always queue the sends to the ioqueue, to compare the cost of
+     * asynchronous sends between the backends.
+     */
+    rc = ioqueue_perf_test_imp(PJ_TRUE, &cfg, PJ_IOQUEUE_ALWAYS_ASYNC);
     if (rc != 0)
 	return rc;
 
@@ -19,6 +19,9 @@
  */
 #include <pj/pool.h>
 #include <pj/pool_buf.h>
+#include <pj/slab.h>
+#include <pj/os.h>
+#include <pj/string.h>
 #include <pj/rand.h>
 #include <pj/log.h>
 #include <pj/except.h>
@@ -278,6 +281,138 @@ static int pool_buf_test(void)
 }
 
 
+/* Test the fixed-size object allocator */
+#define SLAB_OBJ_SIZE	    10
+#define SLAB_OBJ_CNT	    40
+#define SLAB_THREAD_CNT	    4
+#define SLAB_LOOP	    2000
+
+static int slab_thread_err;
+
+static int slab_thread(void *arg)
+{
+    pj_slab_t *slab = (pj_slab_t*)arg;
+    void *obj[8];
+    int i, j;
+
+    for (i=0; i<SLAB_LOOP; ++i) {
+	for (j=0; j<(int)PJ_ARRAY_SIZE(obj); ++j) {
+	    obj[j] = pj_slab_alloc(slab);
+	    if (!obj[j]) {
+		slab_thread_err = -1;
+		return -1;
+	    }
+	    pj_memset(obj[j], j, SLAB_OBJ_SIZE);
+	}
+	for (j=0; j<(int)PJ_ARRAY_SIZE(obj); ++j) {
+	    if (((char*)obj[j])[SLAB_OBJ_SIZE-1] != j) {
+		slab_thread_err = -2;
+		return -2;
+	    }
+	    pj_slab_free(slab, obj[j]);
+	}
+    }
+    return 0;
+}
+
+static int slab_test(void)
+{
+    pj_slab_t *slab;
+    void *obj[SLAB_OBJ_CNT];
+    pj_size_t capacity;
+    pj_status_t status;
+    int i, j, rc = 0;
+
+    PJ_LOG(3,("test", "...slab test"));
+
+    status = pj_slab_create(mem, "slabtest", SLAB_OBJ_SIZE, 8, &slab);
+    if (status != PJ_SUCCESS)
+	return -500;
+
+    if (pj_slab_get_obj_size(slab) < SLAB_OBJ_SIZE ||
+	pj_slab_get_obj_size(slab) % PJ_POOL_ALIGNMENT != 0)
+    {
+	rc = -510;
+	goto on_return;
+    }
+
+    for (i=0; i<SLAB_OBJ_CNT; ++i) {
+	obj[i] = pj_slab_zalloc(slab);
+	if (!obj[i] || ((pj_size_t)obj[i] & (PJ_POOL_ALIGNMENT-1))) {
+	    rc = -520;
+	    goto on_return;
+	}
+	for (j=0; j<SLAB_OBJ_SIZE; ++j) {
+	    if (((char*)obj[i])[j] != 0) {
+		rc = -530;
+		goto on_return;
+	    }
+	}
+	pj_memset(obj[i], i, SLAB_OBJ_SIZE);
+    }
+
+    /* Objects must not overlap */
+    for (i=0; i<SLAB_OBJ_CNT; ++i) {
+	for (j=0; j<SLAB_OBJ_SIZE; ++j) {
+	    if (((char*)obj[i])[j] != i) {
+		rc = -540;
+		goto on_return;
+	    }
+	}
+    }
+
+    capacity = pj_slab_get_capacity(slab);
+    if (capacity < SLAB_OBJ_CNT) {
+	rc = -550;
+	goto on_return;
+    }
+
+    /* Released objects must be reused */
+    for (i=0; i<SLAB_OBJ_CNT; ++i)
+	pj_slab_free(slab, obj[i]);
+    for (i=0; i<SLAB_OBJ_CNT; ++i)
+	obj[i] = pj_slab_alloc(slab);
+    for (i=0; i<SLAB_OBJ_CNT; ++i)
+	pj_slab_free(slab, obj[i]);
+
+    if (pj_slab_get_capacity(slab) != capacity) {
+	rc = -560;
+	goto on_return;
+    }
+
+#if PJ_HAS_THREADS
+    {
+	pj_pool_t *pool;
+	pj_thread_t *thread[SLAB_THREAD_CNT];
+
+	slab_thread_err = 0;
+	pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+	for (i=0; i<SLAB_THREAD_CNT; ++i) {
+	    status = pj_thread_create(pool, "slab", &slab_thread, slab,
+				      0, 0, &thread[i]);
+	    if (status != PJ_SUCCESS) {
+		pj_pool_release(pool);
+		rc = -570;
+		goto on_return;
+	    }
+	}
+	for (i=0; i<SLAB_THREAD_CNT; ++i) {
+	    pj_thread_join(thread[i]);
+	    pj_thread_destroy(thread[i]);
+	}
+	pj_pool_release(pool);
+
+	if (slab_thread_err != 0)
+	    rc = -580;
+    }
+#endif
+
+on_return:
+    pj_slab_destroy(slab);
+    return rc;
+}
+
+
 int pool_test(void)
 {
     enum { LOOP = 2 };
@@ -309,6 +444,10 @@ int pool_test(void)
     if (rc != 0)
 	return rc;
 
+    rc = slab_test();
+    if (rc != 0)
+	return rc;
+
 
     return 0;
 }
@@ -118,6 +118,73 @@ static int pool_test_malloc_free()
 
 #endif /* PJ_SYMBIAN */
 
+#define MT_MAX_THREADS	8
+#define MT_COUNT	100000
+
+static int pool_mt_thread(void *arg)
+{
+    pj_pool_factory *pf = (pj_pool_factory*) arg;
+    unsigned i;
+
+    for (i=0; i<MT_COUNT; ++i) {
+	pj_pool_t *pool = pj_pool_create(pf, "mtpool", 1000, 1000, NULL);
+	if (!pool)
+	    return -1;
+	pj_pool_alloc(pool, 100);
+	pj_pool_release(pool);
+    }
+    return 0;
+}
+
+/* Create and release pools from several threads at once, to see
+ * whether the caching pool serializes the threads.
+ */
+static int pool_mt_perf_test(unsigned thread_cnt, pj_bool_t use_magazine)
+{
+    pj_caching_pool cp;
+    pj_pool_t *pool;
+    pj_thread_t *thread[MT_MAX_THREADS];
+    pj_timestamp start, end;
+    unsigned i;
+    pj_status_t status;
+
+    pj_caching_pool_init(&cp, NULL, 0x100000);
+    status = pj_caching_pool_enable_magazine(&cp, use_magazine);
+    if (status != PJ_SUCCESS) {
+	PJ_LOG(3, (THIS_FILE, "..magazines are not available"));
+	pj_caching_pool_destroy(&cp);
+	return 0;
+    }
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+
+    pj_get_timestamp(&start);
+    for (i=0; i<thread_cnt; ++i) {
+	status = pj_thread_create(pool, "mtpool", &pool_mt_thread,
+				  &cp.factory, 0, 0, &thread[i]);
+	if (status != PJ_SUCCESS) {
+	    pj_pool_release(pool);
+	    pj_caching_pool_destroy(&cp);
+	    return -10;
+	}
+    }
+
+    for (i=0; i<thread_cnt; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+    pj_get_timestamp(&end);
+
+    PJ_LOG(3, (THIS_FILE, "..%u thread(s), %u pool create/release each, "
+			  "magazine=%d: %u msec",
+	       thread_cnt, MT_COUNT, use_magazine,
+	       pj_elapsed_msec(&start, &end)));
+
+    pj_pool_release(pool);
+    pj_caching_pool_destroy(&cp);
+    return 0;
+}
+
 int pool_perf_test()
 {
     unsigned i;
@@ -186,6 +253,18 @@ int pool_perf_test()
     PJ_LOG(3, (THIS_FILE, "..pool speedup over malloc best=%dx, worst=%dx", 
 			  (int)(malloc_time/best),
 			  (int)(malloc_time/worst)));
+
+    PJ_LOG(3, (THIS_FILE, "Benchmarking multithreaded pool creation.."));
+    for (i=1; i<=MT_MAX_THREADS; i*=2) {
+	int rc = pool_mt_perf_test(i, PJ_FALSE);
+	if (rc != 0)
+	    return rc;
+
+	rc = pool_mt_perf_test(i, PJ_TRUE);
+	if (rc != 0)
+	    return rc;
+    }
+
     return 0;
 }
 
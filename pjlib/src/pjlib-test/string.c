@@ -42,6 +42,7 @@
  *  - pj_strncmp()
  *  - pj_strnicmp()
  *  - pj_strchr()
+ *  - pj_strstr()
  *  - pj_strdup()
  *  - pj_strdup2()
  *  - pj_strcpy()
@@ -325,6 +326,27 @@ int string_test(void)
     if (pj_strchr(&s1, HELLO_WORLD[1]) != s1.ptr+1)
 	return -80;
 
+    /*
+     * pj_strstr()
+     */
+    s2 = pj_str("World");
+    if (pj_strstr(&s1, &s2) != s1.ptr+6)
+	return -82;
+    s2 = pj_str("Worlds");
+    if (pj_strstr(&s1, &s2) != SNULL)
+	return -84;
+    s2 = pj_str("o");
+    if (pj_strstr(&s1, &s2) != s1.ptr+4)
+	return -86;
+    s2.slen = 0;
+    if (pj_strstr(&s1, &s2) != s1.ptr)
+	return -88;
+    s2 = pj_str("World");
+    s3 = pj_str(HELLO_WORLD);
+    s3.slen -= 1;
+    if (pj_strstr(&s3, &s2) != SNULL)
+	return -90;
+
     /* 
      * pj_strdup() 
      */
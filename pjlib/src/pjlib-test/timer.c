@@ -44,6 +44,9 @@
 #define DELAY		(D < MIN_DELAY ? MIN_DELAY : D)
 #define THIS_FILE	"timer_test"
 
+/* Number of timer entries in the benchmark */
+#define BENCH_COUNT	1000000
+
 
 static void timer_callback(pj_timer_heap_t *ht, pj_timer_entry *e)
 {
@@ -51,7 +54,7 @@ static void timer_callback(pj_timer_heap_t *ht, pj_timer_entry *e)
     PJ_UNUSED_ARG(e);
 }
 
-static int test_timer_heap(void)
+static int test_timer_heap(pj_timer_heap_type type)
 {
     int i, j;
     pj_timer_entry *entry;
@@ -59,10 +62,11 @@ static int test_timer_heap(void)
     pj_timer_heap_t *timer;
     pj_time_val delay;
     pj_status_t rc;    int err=0;
-    pj_size_t size;
+    pj_size_t size, used;
     unsigned count;
 
-    size = pj_timer_heap_mem_size(MAX_COUNT)+MAX_COUNT*sizeof(pj_timer_entry);
+    size = pj_timer_heap_mem_size2(MAX_COUNT, type) +
+	   MAX_COUNT*sizeof(pj_timer_entry);
     pool = pj_pool_create( mem, NULL, size, 4000, NULL);
     if (!pool) {
 	PJ_LOG(3,("test", "...error: unable to create pool of %u bytes",
@@ -77,12 +81,21 @@ static int test_timer_heap(void)
     for (i=0; i<MAX_COUNT; ++i) {
 	entry[i].cb = &timer_callback;
     }
-    rc = pj_timer_heap_create(pool, MAX_COUNT, &timer);
+    used = pj_pool_get_used_size(pool);
+    rc = pj_timer_heap_create2(pool, MAX_COUNT, type, &timer);
     if (rc != PJ_SUCCESS) {
         app_perror("...error: unable to create timer heap", rc);
 	return -30;
     }
 
+    /* The timer heap must fit in the calculated memory size */
+    used = pj_pool_get_used_size(pool) - used;
+    if (used > pj_timer_heap_mem_size2(MAX_COUNT, type)) {
+	PJ_LOG(3,("test", "...error: timer heap uses %u bytes, more than "
+		  "the calculated size", used));
+	return -35;
+    }
+
     count = MIN_COUNT;
     for (i=0; i<LOOP; ++i) {
 	int early = 0;
@@ -182,9 +195,116 @@ static int test_timer_heap(void)
 }
 
 
+/*
+ * Benchmark scheduling, cancelling and expiring BENCH_COUNT timers.
+ */
+static int bench_timer_heap(pj_timer_heap_type type, const char *title)
+{
+    pj_pool_t *pool;
+    pj_timer_heap_t *timer;
+    pj_timer_entry *entry;
+    pj_timestamp t1, t2;
+    pj_uint32_t t_sched, t_cancel, t_poll;
+    pj_time_val delay, expire, now;
+    unsigned i, cancelled, done;
+    pj_status_t rc;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    entry = (pj_timer_entry*)
+	    pj_pool_calloc(pool, BENCH_COUNT, sizeof(*entry));
+    if (!entry) {
+	pj_pool_release(pool);
+	return -200;
+    }
+
+    rc = pj_timer_heap_create2(pool, BENCH_COUNT, type, &timer);
+    if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to create timer heap", rc);
+	pj_pool_release(pool);
+	return -210;
+    }
+    pj_timer_heap_set_max_timed_out_per_poll(timer, BENCH_COUNT);
+
+    /* Timers expire within the next second */
+    pj_srand(0);
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_COUNT; ++i) {
+	pj_timer_entry_init(&entry[i], 0, NULL, &timer_callback);
+	delay.sec = 0;
+	delay.msec = 500 + (pj_rand() % 500);
+	rc = pj_timer_heap_schedule(timer, &entry[i], &delay);
+	if (rc != PJ_SUCCESS) {
+	    pj_pool_release(pool);
+	    return -220;
+	}
+    }
+    pj_get_timestamp(&t2);
+    t_sched = pj_elapsed_msec(&t1, &t2);
+
+    /* Cancel every other timer */
+    cancelled = 0;
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_COUNT; i+=2)
+	cancelled += pj_timer_heap_cancel(timer, &entry[i]);
+    pj_get_timestamp(&t2);
+    t_cancel = pj_elapsed_msec(&t1, &t2);
+
+    /* Expire the rest, only counting the polls that did something */
+    done = 0;
+    t_poll = 0;
+    pj_gettickcount(&expire);
+    expire.sec += 3;
+    do {
+	unsigned cnt;
+
+	pj_get_timestamp(&t1);
+	cnt = pj_timer_heap_poll(timer, NULL);
+	pj_get_timestamp(&t2);
+	if (cnt) {
+	    done += cnt;
+	    t_poll += pj_elapsed_usec(&t1, &t2);
+	} else {
+	    pj_thread_sleep(1);
+	}
+	pj_gettickcount(&now);
+    } while (pj_timer_heap_count(timer) && PJ_TIME_VAL_LT(now, expire));
+
+    PJ_LOG(3,(THIS_FILE, "...%s: %u timers, sched: %u ms, cancel: %u ms, "
+			 "expire: %u ms",
+	      title, BENCH_COUNT, t_sched, t_cancel, t_poll / 1000));
+
+    if (cancelled + done != BENCH_COUNT || pj_timer_heap_count(timer)) {
+	PJ_LOG(3,(THIS_FILE, "...error: cancelled %u, expired %u, left %u",
+		  cancelled, done, (unsigned)pj_timer_heap_count(timer)));
+	pj_pool_release(pool);
+	return -230;
+    }
+
+    pj_timer_heap_destroy(timer);
+    pj_pool_release(pool);
+    return 0;
+}
+
 int timer_test()
 {
-    return test_timer_heap();
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "..binary heap"));
+    rc = test_timer_heap(PJ_TIMER_HEAP_BINARY);
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3,(THIS_FILE, "..timing wheel"));
+    rc = test_timer_heap(PJ_TIMER_HEAP_WHEEL);
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3,(THIS_FILE, "..benchmark"));
+    rc = bench_timer_heap(PJ_TIMER_HEAP_BINARY, "binary heap");
+    if (rc != 0)
+	return rc;
+
+    return bench_timer_heap(PJ_TIMER_HEAP_WHEEL, "timing wheel");
 }
 
 #else
@@ -401,6 +401,21 @@
 #endif
 
 
+/**
+ * Maximum number of incoming RTP packets that the UDP media transport
+ * receives with a single system call (see pj_ioqueue_recvmmsg()). This
+ * helps when several packets queue up on the socket between polls, for
+ * example on a busy media relay. Each transport allocates this many
+ * receive buffers of PJMEDIA_MAX_MRU size. Set to 1 to receive one packet
+ * at a time.
+ *
+ * Default: 1
+ */
+#ifndef PJMEDIA_TRANSPORT_UDP_RECV_BATCH
+#  define PJMEDIA_TRANSPORT_UDP_RECV_BATCH	1
+#endif
+
+
 /**
  * DTMF/telephone-event duration, in timestamp.
  */
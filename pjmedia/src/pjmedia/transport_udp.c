@@ -79,6 +79,8 @@ struct transport_udp
     unsigned		rtp_src_cnt;	/**< How many pkt from this addr.   */
     int			rtp_addrlen;	/**< Address length.		    */
     char		rtp_pkt[RTP_LEN];/**< Incoming RTP packet buffer    */
+    pj_ioqueue_mmsg    *rtp_mmsg;	/**< Batch receive, NULL if not used*/
+    unsigned		rtp_mmsg_cnt;	/**< Max packets in one batch.	    */
 
     pj_sock_t		rtcp_sock;	/**< RTCP socket		    */
     pj_sockaddr		rtcp_addr_name;	/**< Published RTCP address.	    */
@@ -96,6 +98,9 @@ struct transport_udp
 static void on_rx_rtp( pj_ioqueue_key_t *key, 
                        pj_ioqueue_op_key_t *op_key, 
                        pj_ssize_t bytes_read);
+static pj_status_t start_rtp_read(struct transport_udp *udp,
+				  pj_ssize_t *bytes_read,
+				  pj_uint32_t flags);
 static void on_rx_rtcp(pj_ioqueue_key_t *key, 
                        pj_ioqueue_op_key_t *op_key, 
                        pj_ssize_t bytes_read);
@@ -349,12 +354,31 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
 	pj_ioqueue_op_key_init(&tp->rtp_pending_write[i].op_key, 
 			       sizeof(tp->rtp_pending_write[i].op_key));
 
+#if PJMEDIA_TRANSPORT_UDP_RECV_BATCH > 1
+    /* Buffers for batch receive. The first packet goes to the usual
+     * rtp_pkt buffer.
+     */
+    tp->rtp_mmsg_cnt = PJMEDIA_TRANSPORT_UDP_RECV_BATCH;
+    if (tp->rtp_mmsg_cnt > PJ_IOQUEUE_MAX_MMSG)
+	tp->rtp_mmsg_cnt = PJ_IOQUEUE_MAX_MMSG;
+    tp->rtp_mmsg = (pj_ioqueue_mmsg*)
+		   pj_pool_calloc(pool, tp->rtp_mmsg_cnt,
+				  sizeof(pj_ioqueue_mmsg));
+    tp->rtp_mmsg[0].buf = tp->rtp_pkt;
+    tp->rtp_mmsg[0].addr = &tp->rtp_src_addr;
+    for (i=1; i<tp->rtp_mmsg_cnt; ++i) {
+	tp->rtp_mmsg[i].buf = pj_pool_alloc(pool, RTP_LEN);
+	tp->rtp_mmsg[i].addr = PJ_POOL_ZALLOC_T(pool, pj_sockaddr);
+    }
+#endif
+
     /* Kick of pending RTP read from the ioqueue */
-    tp->rtp_addrlen = sizeof(tp->rtp_src_addr);
-    size = sizeof(tp->rtp_pkt);
-    status = pj_ioqueue_recvfrom(tp->rtp_key, &tp->rtp_read_op,
-			         tp->rtp_pkt, &size, PJ_IOQUEUE_ALWAYS_ASYNC,
-				 &tp->rtp_src_addr, &tp->rtp_addrlen);
+    status = start_rtp_read(tp, &size, PJ_IOQUEUE_ALWAYS_ASYNC);
+    if (status == PJ_ENOTSUP && tp->rtp_mmsg) {
+	/* Batch receive is not supported by the ioqueue */
+	tp->rtp_mmsg = NULL;
+	status = start_rtp_read(tp, &size, PJ_IOQUEUE_ALWAYS_ASYNC);
+    }
     if (status != PJ_EPENDING)
 	goto on_error;
 
@@ -438,106 +462,156 @@ static pj_status_t transport_destroy(pjmedia_transport *tp)
 }
 
 
-/* Notification from ioqueue about incoming RTP packet */
-static void on_rx_rtp( pj_ioqueue_key_t *key, 
-                       pj_ioqueue_op_key_t *op_key, 
-                       pj_ssize_t bytes_read)
+/* Process one incoming RTP packet, which source address is in
+ * rtp_src_addr.
+ */
+static void rtp_pkt_rx(struct transport_udp *udp, void *pkt,
+		       pj_ssize_t bytes_read)
 {
-    struct transport_udp *udp;
-    pj_status_t status;
-
-    PJ_UNUSED_ARG(op_key);
+    void (*cb)(void*,void*,pj_ssize_t);
+    void *user_data;
+    pj_bool_t discard = PJ_FALSE;
 
-    udp = (struct transport_udp*) pj_ioqueue_get_user_data(key);
+    cb = udp->rtp_cb;
+    user_data = udp->user_data;
 
-    do {
-	void (*cb)(void*,void*,pj_ssize_t);
-	void *user_data;
-	pj_bool_t discard = PJ_FALSE;
+    /* Simulate packet lost on RX direction */
+    if (udp->rx_drop_pct) {
+	if ((pj_rand() % 100) <= (int)udp->rx_drop_pct) {
+	    PJ_LOG(5,(udp->base.name, 
+		      "RX RTP packet dropped because of pkt lost "
+		      "simulation"));
+	    discard = PJ_TRUE;
+	}
+    }
 
-	cb = udp->rtp_cb;
-	user_data = udp->user_data;
+    /* See if source address of RTP packet is different than the 
+     * configured address, and switch RTP remote address to 
+     * source packet address after several consecutive packets
+     * have been received.
+     */
+    if (bytes_read>0 && 
+	(udp->options & PJMEDIA_UDP_NO_SRC_ADDR_CHECKING)==0) 
+    {
+	if (pj_sockaddr_cmp(&udp->rem_rtp_addr, &udp->rtp_src_addr) == 0) {
+	    /* We're still receiving from rem_rtp_addr. Don't switch. */
+	    udp->rtp_src_cnt = 0;
+	} else {
+	    udp->rtp_src_cnt++;
 
-	/* Simulate packet lost on RX direction */
-	if (udp->rx_drop_pct) {
-	    if ((pj_rand() % 100) <= (int)udp->rx_drop_pct) {
-		PJ_LOG(5,(udp->base.name, 
-			  "RX RTP packet dropped because of pkt lost "
-			  "simulation"));
+	    if (udp->rtp_src_cnt < PJMEDIA_RTP_NAT_PROBATION_CNT) {
 		discard = PJ_TRUE;
-	    }
-	}
+	    } else {
 
-	/* See if source address of RTP packet is different than the 
-	 * configured address, and switch RTP remote address to 
-	 * source packet address after several consecutive packets
-	 * have been received.
-	 */
-	if (bytes_read>0 && 
-	    (udp->options & PJMEDIA_UDP_NO_SRC_ADDR_CHECKING)==0) 
-	{
-	    if (pj_sockaddr_cmp(&udp->rem_rtp_addr, &udp->rtp_src_addr) == 0) {
-		/* We're still receiving from rem_rtp_addr. Don't switch. */
+		char addr_text[80];
+
+		/* Set remote RTP address to source address */
+		pj_memcpy(&udp->rem_rtp_addr, &udp->rtp_src_addr,
+			  sizeof(pj_sockaddr));
+
+		/* Reset counter */
 		udp->rtp_src_cnt = 0;
-	    } else {
-		udp->rtp_src_cnt++;
 
-		if (udp->rtp_src_cnt < PJMEDIA_RTP_NAT_PROBATION_CNT) {
-		    discard = PJ_TRUE;
-		} else {
-		
-		    char addr_text[80];
+		PJ_LOG(4,(udp->base.name,
+			  "Remote RTP address switched to %s",
+			  pj_sockaddr_print(&udp->rtp_src_addr, addr_text,
+					    sizeof(addr_text), 3)));
 
-		    /* Set remote RTP address to source address */
-		    pj_memcpy(&udp->rem_rtp_addr, &udp->rtp_src_addr,
+		/* Also update remote RTCP address if actual RTCP source
+		 * address is not heard yet.
+		 */
+		if (!pj_sockaddr_has_addr(&udp->rtcp_src_addr)) {
+		    pj_uint16_t port;
+
+		    pj_memcpy(&udp->rem_rtcp_addr, &udp->rem_rtp_addr, 
 			      sizeof(pj_sockaddr));
+		    pj_sockaddr_copy_addr(&udp->rem_rtcp_addr,
+					  &udp->rem_rtp_addr);
+		    port = (pj_uint16_t)
+			   (pj_sockaddr_get_port(&udp->rem_rtp_addr)+1);
+		    pj_sockaddr_set_port(&udp->rem_rtcp_addr, port);
 
-		    /* Reset counter */
-		    udp->rtp_src_cnt = 0;
+		    pj_memcpy(&udp->rtcp_src_addr, &udp->rem_rtcp_addr, 
+			      sizeof(pj_sockaddr));
 
 		    PJ_LOG(4,(udp->base.name,
-			      "Remote RTP address switched to %s",
-			      pj_sockaddr_print(&udp->rtp_src_addr, addr_text,
+			      "Remote RTCP address switched to predicted"
+			      " address %s",
+			      pj_sockaddr_print(&udp->rtcp_src_addr, 
+						addr_text,
 						sizeof(addr_text), 3)));
 
-		    /* Also update remote RTCP address if actual RTCP source
-		     * address is not heard yet.
-		     */
-		    if (!pj_sockaddr_has_addr(&udp->rtcp_src_addr)) {
-			pj_uint16_t port;
-
-			pj_memcpy(&udp->rem_rtcp_addr, &udp->rem_rtp_addr, 
-				  sizeof(pj_sockaddr));
-			pj_sockaddr_copy_addr(&udp->rem_rtcp_addr,
-					      &udp->rem_rtp_addr);
-			port = (pj_uint16_t)
-			       (pj_sockaddr_get_port(&udp->rem_rtp_addr)+1);
-			pj_sockaddr_set_port(&udp->rem_rtcp_addr, port);
-
-			pj_memcpy(&udp->rtcp_src_addr, &udp->rem_rtcp_addr, 
-				  sizeof(pj_sockaddr));
-
-			PJ_LOG(4,(udp->base.name,
-				  "Remote RTCP address switched to predicted"
-				  " address %s",
-				  pj_sockaddr_print(&udp->rtcp_src_addr, 
-						    addr_text,
-						    sizeof(addr_text), 3)));
-
-		    }
 		}
 	    }
 	}
+    }
+
+    if (!discard && udp->attached && cb)
+	(*cb)(user_data, pkt, bytes_read);
+}
+
+/* Start the next RTP read. With batch receive, bytes_read will contain
+ * the number of packets received.
+ */
+static pj_status_t start_rtp_read(struct transport_udp *udp,
+				  pj_ssize_t *bytes_read,
+				  pj_uint32_t flags)
+{
+    if (udp->rtp_mmsg) {
+	unsigned i, count = udp->rtp_mmsg_cnt;
+	pj_status_t status;
+
+	for (i=0; i<count; ++i) {
+	    udp->rtp_mmsg[i].len = RTP_LEN;
+	    udp->rtp_mmsg[i].addrlen = sizeof(pj_sockaddr);
+	}
+	status = pj_ioqueue_recvmmsg(udp->rtp_key, &udp->rtp_read_op,
+				     udp->rtp_mmsg, &count, flags);
+	*bytes_read = count;
+	return status;
+    }
+
+    *bytes_read = sizeof(udp->rtp_pkt);
+    udp->rtp_addrlen = sizeof(udp->rtp_src_addr);
+    return pj_ioqueue_recvfrom(udp->rtp_key, &udp->rtp_read_op,
+			       udp->rtp_pkt, bytes_read, flags,
+			       &udp->rtp_src_addr, &udp->rtp_addrlen);
+}
 
-	if (!discard && udp->attached && cb)
-	    (*cb)(user_data, udp->rtp_pkt, bytes_read);
+/* Notification from ioqueue about incoming RTP packet */
+static void on_rx_rtp( pj_ioqueue_key_t *key, 
+                       pj_ioqueue_op_key_t *op_key, 
+                       pj_ssize_t bytes_read)
+{
+    struct transport_udp *udp;
+    pj_status_t status;
+
+    PJ_UNUSED_ARG(op_key);
+
+    udp = (struct transport_udp*) pj_ioqueue_get_user_data(key);
+
+    do {
+	if (udp->rtp_mmsg && bytes_read > 0) {
+	    pj_ssize_t i;
+
+	    /* Batch receive, bytes_read is the number of packets */
+	    for (i=0; i<bytes_read; ++i) {
+		pj_ioqueue_mmsg *msg = &udp->rtp_mmsg[i];
+
+		/* Copy the whole address, so that nothing is left from the
+		 * address of the previous packet.
+		 */
+		if (i > 0)
+		    pj_memcpy(&udp->rtp_src_addr, msg->addr,
+			      sizeof(udp->rtp_src_addr));
+		udp->rtp_addrlen = msg->addrlen;
+		rtp_pkt_rx(udp, msg->buf, msg->len);
+	    }
+	} else {
+	    rtp_pkt_rx(udp, udp->rtp_pkt, bytes_read);
+	}
 
-	bytes_read = sizeof(udp->rtp_pkt);
-	udp->rtp_addrlen = sizeof(udp->rtp_src_addr);
-	status = pj_ioqueue_recvfrom(udp->rtp_key, &udp->rtp_read_op,
-				     udp->rtp_pkt, &bytes_read, 0,
-				     &udp->rtp_src_addr, 
-				     &udp->rtp_addrlen);
+	status = start_rtp_read(udp, &bytes_read, 0);
 
 	if (status != PJ_EPENDING && status != PJ_SUCCESS)
 	    bytes_read = -status;
@@ -496,32 +496,28 @@ static void on_call_audio_state(pjsua_call_info *ci, unsigned mi,
 
 	/* Put call in conference with other calls, if desired */
 	if (app_config.auto_conf) {
-	    pjsua_call_id call_ids[PJSUA_MAX_CALLS];
-	    unsigned call_cnt=PJ_ARRAY_SIZE(call_ids);
-	    unsigned i;
+	    pjsua_call_id i;
 
-	    /* Get all calls, and establish media connection between
-	     * this call and other calls.
+	    /* Establish media connection between this call and other
+	     * active calls.
 	     */
-	    pjsua_enum_calls(call_ids, &call_cnt);
-
-	    for (i=0; i<call_cnt; ++i) {
-		if (call_ids[i] == ci->id)
+	    for (i=0; i<(pjsua_call_id)app_config.cfg.max_calls; ++i) {
+		if (i == ci->id || !pjsua_call_is_active(i))
 		    continue;
 		
-		if (!pjsua_call_has_media(call_ids[i]))
+		if (!pjsua_call_has_media(i))
 		    continue;
 
 		pjsua_conf_connect(call_conf_slot,
-				   pjsua_call_get_conf_port(call_ids[i]));
-		pjsua_conf_connect(pjsua_call_get_conf_port(call_ids[i]),
+				   pjsua_call_get_conf_port(i));
+		pjsua_conf_connect(pjsua_call_get_conf_port(i),
 		                   call_conf_slot);
 
 		/* Automatically record conversation, if desired */
 		if (app_config.auto_rec && app_config.rec_port !=
 					   PJSUA_INVALID_ID)
 		{
-		    pjsua_conf_connect(pjsua_call_get_conf_port(call_ids[i]), 
+		    pjsua_conf_connect(pjsua_call_get_conf_port(i), 
 				       app_config.rec_port);
 		}
 
@@ -1365,7 +1361,11 @@ static pj_status_t app_init()
 #endif
 
     /* Initialize calls data */
-    for (i=0; i<PJ_ARRAY_SIZE(app_config.call_data); ++i) {
+    app_config.call_data = (app_call_data*)
+			   pj_pool_calloc(app_config.pool,
+					  app_config.cfg.max_calls,
+					  sizeof(app_call_data));
+    for (i=0; i<app_config.cfg.max_calls; ++i) {
 	app_config.call_data[i].timer.id = PJSUA_INVALID_ID;
 	app_config.call_data[i].timer.cb = &call_timeout_callback;
     }
@@ -677,10 +677,12 @@ static void get_call_id(pj_cli_dyn_choice_param *param)
 	char call_id[64];
 	char desc[128];
 	unsigned i, count;
-	pjsua_call_id ids[PJSUA_MAX_CALLS];
+	pjsua_call_id *ids;
 	int call = current_call;
 
-	count = PJ_ARRAY_SIZE(ids);
+	count = app_config.cfg.max_calls;
+	ids = (pjsua_call_id*) pj_pool_calloc(param->pool, count,
+					      sizeof(pjsua_call_id));
 	pjsua_enum_calls(ids, &count);
 
 	if (count > 1) {
@@ -1767,17 +1769,13 @@ static pj_status_t cmd_transfer_replace_call(pj_cli_cmd_val *cval)
 	pjsip_generic_string_hdr refer_sub;
 	pj_str_t STR_REFER_SUB = { "Refer-Sub", 9 };
 	pj_str_t STR_FALSE = { "false", 5 };
-	pjsua_call_id ids[PJSUA_MAX_CALLS];
 	pjsua_msg_data msg_data;
 	char buf[8] = {0};
 	pj_str_t tmp = pj_str(buf);
-	unsigned count;
 	static const pj_str_t err_invalid_num =
 				    {"Invalid destination call number\n", 32 };
-	count = PJ_ARRAY_SIZE(ids);
-	pjsua_enum_calls(ids, &count);
 
-	if (count <= 1) {
+	if (pjsua_call_get_count() <= 1) {
 	    static const pj_str_t err_no_other_call =
 				    {"There are no other calls\n", 25};
 
@@ -1810,7 +1808,7 @@ static pj_status_t cmd_transfer_replace_call(pj_cli_cmd_val *cval)
 	    return PJ_SUCCESS;
 	}
 
-	if (dst_call >= PJSUA_MAX_CALLS) {
+	if (dst_call < 0 || dst_call >= (int)app_config.cfg.max_calls) {
 	    pj_cli_sess_write_msg(cval->sess, err_invalid_num.ptr,
 				  err_invalid_num.slen);
 	    return PJ_SUCCESS;
@@ -1128,16 +1128,12 @@ static void ui_call_transfer_replaces(pj_bool_t no_refersub)
 	pjsip_generic_string_hdr refer_sub;
 	pj_str_t STR_REFER_SUB = { "Refer-Sub", 9 };
 	pj_str_t STR_FALSE = { "false", 5 };
-	pjsua_call_id ids[PJSUA_MAX_CALLS];
 	pjsua_call_info ci;
 	pjsua_msg_data msg_data;
 	char buf[128];
-	unsigned i, count;
+	pjsua_call_id i;
 
-	count = PJ_ARRAY_SIZE(ids);
-	pjsua_enum_calls(ids, &count);
-
-	if (count <= 1) {
+	if (pjsua_call_get_count() <= 1) {
 	    puts("There are no other calls");
 	    return;
 	}
@@ -1147,15 +1143,15 @@ static void ui_call_transfer_replaces(pj_bool_t no_refersub)
 	       current_call,
 	       (int)ci.remote_info.slen, ci.remote_info.ptr);
 
-	for (i=0; i<count; ++i) {
+	for (i=0; i<(pjsua_call_id)app_config.cfg.max_calls; ++i) {
 	    pjsua_call_info call_info;
 
-	    if (ids[i] == call)
+	    if (i == call || !pjsua_call_is_active(i))
 		continue;
 
-	    pjsua_call_get_info(ids[i], &call_info);
+	    pjsua_call_get_info(i, &call_info);
 	    printf("%d  %.*s [%.*s]\n",
-		ids[i],
+		i,
 		(int)call_info.remote_info.slen,
 		call_info.remote_info.ptr,
 		(int)call_info.state_text.slen,
@@ -1180,7 +1176,7 @@ static void ui_call_transfer_replaces(pj_bool_t no_refersub)
 		"as the call being transferred");
 	    return;
 	}
-	if (dst_call >= PJSUA_MAX_CALLS) {
+	if (dst_call < 0 || dst_call >= (int)app_config.cfg.max_calls) {
 	    puts("Invalid destination call number");
 	    return;
 	}
@@ -75,10 +75,12 @@ static pj_bool_t on_rx_request( pjsip_rx_data *rdata )
     }
 
     /*
-     * Request looks sane, next clone the request to create transmit data.
+     * Request looks sane, next create transmit data from the request.
+     * The packet is spliced rather than cloned, since we only need to
+     * modify the routing headers.
      */
-    status = pjsip_endpt_create_request_fwd(global.endpt, rdata, NULL,
-					    NULL, 0, &tdata);
+    status = pjsip_endpt_create_request_splice(global.endpt, rdata, NULL,
+					       NULL, 0, &tdata);
     if (status != PJ_SUCCESS) {
 	pjsip_endpt_respond_stateless(global.endpt, rdata,
 				      PJSIP_SC_INTERNAL_SERVER_ERROR, NULL, 
@@ -122,7 +124,8 @@ static pj_bool_t on_rx_response( pjsip_rx_data *rdata )
     pj_status_t status;
 
     /* Create response to be forwarded upstream (Via will be stripped here) */
-    status = pjsip_endpt_create_response_fwd(global.endpt, rdata, 0, &tdata);
+    status = pjsip_endpt_create_response_splice(global.endpt, rdata, 0,
+						&tdata);
     if (status != PJ_SUCCESS) {
 	app_perror("Error creating response", status);
 	return PJ_TRUE;
@@ -51,6 +51,7 @@
 
 /* Transaction layer. */
 #include <pjsip/sip_transaction.h>
+#include <pjsip/sip_overload.h>
 
 /* UA Layer. */
 #include <pjsip/sip_ua_layer.h>
@@ -157,6 +157,36 @@ typedef struct pjsip_cfg_t
 	 */
 	pj_bool_t disable_secure_dlg_check;
 
+	/**
+	 * Parse incoming messages lazily. Only the headers that are needed
+	 * to route and match the message (the headers in pjsip_rx_data's
+	 * msg_info) are parsed when the message is received. The other
+	 * headers are parsed when they are looked up, or when the message
+	 * reaches the transaction layer (see \a lazy_hdr_parse_at_tsx).
+	 *
+	 * Default is PJSIP_LAZY_HDR_PARSING.
+	 */
+	pj_bool_t lazy_hdr_parsing;
+
+	/**
+	 * Parse all the headers left unparsed by lazy header parsing before
+	 * the message is given to the transaction layer.
+	 *
+	 * Default is PJSIP_LAZY_HDR_PARSE_AT_TSX.
+	 */
+	pj_bool_t lazy_hdr_parse_at_tsx;
+
+	/**
+	 * Pre-encode the headers that are put in every request or response
+	 * of a dialog (the Contact and the route set), and the capability
+	 * headers of the endpoint (Allow, Accept and Supported), so that
+	 * they are copied instead of printed when messages are encoded.
+	 * See #pjsip_hdr_set_encoded().
+	 *
+	 * Default is PJSIP_PRE_ENCODE_HDR.
+	 */
+	pj_bool_t pre_encode_hdr;
+
     } endpt;
 
     /** Transaction layer settings. */
@@ -258,6 +288,19 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_MAX_TSX_COUNT		(1024-1)
 #endif
 
+/**
+ * Number of shards of the transaction hash table. Transactions are
+ * distributed to the shards by the hash of the transaction key, and each
+ * shard has its own mutex, so that threads looking up, registering and
+ * unregistering different transactions do not contend on one mutex.
+ * Set to 1 to use a single table.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_TSX_TABLE_SHARD_CNT
+#   define PJSIP_TSX_TABLE_SHARD_CNT	16
+#endif
+
 /**
  * Specify maximum number of dialogs in the dialog hash table.
  * For efficiency, the value should be 2^n-1 since it will be
@@ -269,6 +312,120 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_MAX_DIALOG_COUNT	(512-1)
 #endif
 
+/**
+ * Number of shards of the dialog set hash table in the user agent layer.
+ * Dialog sets are distributed to the shards by the hash of the local tag,
+ * and each shard has its own mutex, so that in-dialog messages of
+ * different calls are matched to their dialogs without contending on one
+ * mutex. Set to 1 to use a single table.
+ *
+ * Default: 32
+ */
+#ifndef PJSIP_UA_DLG_TABLE_SHARD_CNT
+#   define PJSIP_UA_DLG_TABLE_SHARD_CNT	32
+#endif
+
+/**
+ * Default maximum number of received messages queued or being processed
+ * by the endpoint before the overload control module (see
+ * #pjsip_overload_init_module()) starts rejecting new requests. Zero
+ * disables this check.
+ *
+ * Default: 0
+ */
+#ifndef PJSIP_OVERLOAD_MAX_RX_PENDING
+#   define PJSIP_OVERLOAD_MAX_RX_PENDING	0
+#endif
+
+/**
+ * Default maximum average time to process received messages, in
+ * milliseconds, before the overload control module starts rejecting new
+ * requests. Zero disables this check.
+ *
+ * Default: 500
+ */
+#ifndef PJSIP_OVERLOAD_MAX_LATENCY
+#   define PJSIP_OVERLOAD_MAX_LATENCY	500
+#endif
+
+/**
+ * Default maximum number of transactions before the overload control
+ * module starts rejecting new requests. Zero disables this check.
+ *
+ * Default: 0
+ */
+#ifndef PJSIP_OVERLOAD_MAX_TSX_COUNT
+#   define PJSIP_OVERLOAD_MAX_TSX_COUNT	0
+#endif
+
+/**
+ * Default value of Retry-After header, in seconds, in the 503 response
+ * sent by the overload control module.
+ *
+ * Default: 5
+ */
+#ifndef PJSIP_OVERLOAD_RETRY_AFTER
+#   define PJSIP_OVERLOAD_RETRY_AFTER	5
+#endif
+
+/**
+ * Default number of worker threads of the receive queue, see
+ * #pjsip_tpmgr_start_rx_queue().
+ *
+ * Default: 4
+ */
+#ifndef PJSIP_RX_QUEUE_WORKER_CNT
+#   define PJSIP_RX_QUEUE_WORKER_CNT	4
+#endif
+
+/**
+ * Default maximum number of messages in the receive queue.
+ *
+ * Default: 1024
+ */
+#ifndef PJSIP_RX_QUEUE_MAX_LEN
+#   define PJSIP_RX_QUEUE_MAX_LEN	1024
+#endif
+
+/**
+ * Default maximum number of source addresses tracked by the rate limiter
+ * of received requests, see #pjsip_tpmgr_set_rate_limit().
+ *
+ * Default: 1024
+ */
+#ifndef PJSIP_RATE_LIMIT_MAX_SOURCES
+#   define PJSIP_RATE_LIMIT_MAX_SOURCES	1024
+#endif
+
+/**
+ * Default number of requests per second allowed from one source address
+ * by the rate limiter.
+ *
+ * Default: 50
+ */
+#ifndef PJSIP_RATE_LIMIT_RATE
+#   define PJSIP_RATE_LIMIT_RATE	50
+#endif
+
+/**
+ * Default maximum burst of requests from one source address allowed by
+ * the rate limiter.
+ *
+ * Default: 100
+ */
+#ifndef PJSIP_RATE_LIMIT_BURST
+#   define PJSIP_RATE_LIMIT_BURST	100
+#endif
+
+/**
+ * Maximum number of per-method budgets of the rate limiter.
+ *
+ * Default: 8
+ */
+#ifndef PJSIP_RATE_LIMIT_MAX_METHODS
+#   define PJSIP_RATE_LIMIT_MAX_METHODS	8
+#endif
+
 
 /**
  * Specify maximum number of transports.
@@ -396,6 +553,72 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_RESOLVE_HOSTNAME_TO_GET_INTERFACE  PJ_FALSE
 #endif
 
+/**
+ * Parse the headers of incoming messages lazily. When enabled, the parser
+ * only indexes the header lines of a received message and parses the
+ * headers that populate pjsip_rx_data's msg_info (Via, From, To, Call-ID,
+ * CSeq, Max-Forwards, Route, Record-Route, Content-Type, Content-Length,
+ * Require and Supported). The other headers are put in the message as
+ * #pjsip_lazy_hdr, which is printed verbatim, and are parsed when they are
+ * looked up with #pjsip_msg_find_hdr() and the like.
+ *
+ * This is useful for modules which handle many messages while looking at
+ * a few headers only, such as stateless proxies or overload control
+ * running before the transaction layer, since the headers that are never
+ * looked up are never parsed. See also PJSIP_LAZY_HDR_PARSE_AT_TSX.
+ *
+ * This option can also be controlled at run-time by the
+ * \a lazy_hdr_parsing setting in pjsip_cfg_t.
+ *
+ * Default is PJ_FALSE.
+ */
+#ifndef PJSIP_LAZY_HDR_PARSING
+#   define PJSIP_LAZY_HDR_PARSING	PJ_FALSE
+#endif
+
+/**
+ * When lazy header parsing is enabled (see PJSIP_LAZY_HDR_PARSING), parse
+ * all the headers that are still unparsed with #pjsip_msg_parse_lazy_hdrs()
+ * before the message is given to the transaction layer, i.e. to the first
+ * module with priority PJSIP_MOD_PRIORITY_TSX_LAYER or higher. This is
+ * needed by modules which walk the header list instead of looking the
+ * headers up, and would otherwise see the unparsed headers as generic
+ * string headers.
+ *
+ * Applications whose modules only look up the headers, such as stateless
+ * proxies running at application priority, can disable this so that the
+ * headers they don't look at are never parsed.
+ *
+ * This option can also be controlled at run-time by the
+ * \a lazy_hdr_parse_at_tsx setting in pjsip_cfg_t.
+ *
+ * Default is PJ_TRUE.
+ */
+#ifndef PJSIP_LAZY_HDR_PARSE_AT_TSX
+#   define PJSIP_LAZY_HDR_PARSE_AT_TSX	PJ_TRUE
+#endif
+
+/**
+ * Pre-encode the Contact and route set of dialogs, and the capability
+ * headers of the endpoint (Allow, Accept and Supported). These headers are
+ * put in many outgoing messages, and with this option they are printed
+ * once and then copied to each message when it is encoded (see
+ * #pjsip_hdr_set_encoded()).
+ *
+ * The headers that are cloned from the pre-encoded headers keep the
+ * encoding, so application must not modify them, e.g. the Contact header
+ * of a request sent by a dialog, without calling #pjsip_hdr_clear_encoded()
+ * first, or otherwise the modification will not be sent.
+ *
+ * This option can also be controlled at run-time by the
+ * \a pre_encode_hdr setting in pjsip_cfg_t.
+ *
+ * Default is PJ_FALSE.
+ */
+#ifndef PJSIP_PRE_ENCODE_HDR
+#   define PJSIP_PRE_ENCODE_HDR		PJ_FALSE
+#endif
+
 /**
  * Accept call replace in early state when invite is not initiated
  * by the user agent. RFC 3891 Section 3 disallows this, however,
@@ -423,6 +646,27 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Default maximum number of packets that each pending read operation of
+ * the UDP transport receives with a single system call (see
+ * pj_ioqueue_recvmmsg()). The received packets are then parsed and
+ * dispatched to the transport manager one after another before the read
+ * is restarted, which reduces the system call overhead when packets queue
+ * up on a busy socket. Each packet of the batch needs its own receive
+ * buffer (#pjsip_rx_data), so the transport allocates this many times
+ * the number of pending read operations.
+ *
+ * This can be overridden for each transport created with
+ * #pjsip_udp_transport_start2(). Set to 1 to receive one packet at a
+ * time.
+ *
+ * Default: 1
+ */
+#ifndef PJSIP_UDP_RECV_BATCH
+#   define PJSIP_UDP_RECV_BATCH		1
+#endif
+
+
 /**
  * Encode SIP headers in their short forms to reduce size. By default,
  * SIP headers in outgoing messages will be encoded in their full names. 
@@ -573,6 +817,17 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum number of event loops of the endpoint, including the main loop.
+ * See #pjsip_endpt_create_loops().
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_MAX_LOOP_CNT
+#   define PJSIP_MAX_LOOP_CNT		16
+#endif
+
+
 /**
  * Idle timeout interval to be applied to outgoing transports (i.e. client
  * side) with no usage before the transport is destroyed. Value is in
@@ -616,14 +871,35 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 
 
 /**
- * The TCP incoming connection backlog number to be set in accept().
+ * The TCP incoming connection backlog number to be set in listen(). A
+ * small backlog causes connections to be refused when a burst of them
+ * arrives faster than they can be accepted. When the listener uses several
+ * sockets (see \a sock_cnt in #pjsip_tcp_transport_cfg), each socket has
+ * its own backlog of this size.
  *
- * Default: 5
+ * Default: 128
  *
  * @see PJSIP_TLS_TRANSPORT_BACKLOG
  */
 #ifndef PJSIP_TCP_TRANSPORT_BACKLOG
-#   define PJSIP_TCP_TRANSPORT_BACKLOG	5
+#   define PJSIP_TCP_TRANSPORT_BACKLOG	128
+#endif
+
+
+/**
+ * Maximum size of a coalesced write of the TCP transport. While a write
+ * is in progress, for example because the socket send buffer is full,
+ * messages sent to the same connection are queued. When the write
+ * completes, the queued messages are copied to a buffer of this size and
+ * written to the socket with one send() call. Set to zero to send every
+ * message with its own write.
+ *
+ * Default: 16384
+ *
+ * @see PJSIP_TLS_TX_COALESCE_SIZE
+ */
+#ifndef PJSIP_TCP_TX_COALESCE_SIZE
+#   define PJSIP_TCP_TX_COALESCE_SIZE	16384
 #endif
 
 
@@ -753,6 +1029,21 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum size of a coalesced write of the TLS transport. Messages which
+ * are queued while a write is in progress are written together as one
+ * TLS record, so this should not be larger than the maximum TLS record
+ * size (16384). Set to zero to send every message with its own write.
+ *
+ * Default: 16384
+ *
+ * @see PJSIP_TCP_TX_COALESCE_SIZE
+ */
+#ifndef PJSIP_TLS_TX_COALESCE_SIZE
+#   define PJSIP_TLS_TX_COALESCE_SIZE	    16384
+#endif
+
+
 /**
  * Specify whether TLS listener should use SO_REUSEADDR option.
  *
@@ -1208,6 +1499,72 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_HAS_TX_DATA_LIST		0
 #endif
 
+
+/**
+ * Specify whether transmit data and transaction instances should be
+ * allocated from fixed-size object allocators (see @ref PJ_SLAB) which
+ * are recycled when the instances are destroyed, rather than from their
+ * pools. With this feature the print buffer of the transmit data is also
+ * allocated from the recycled objects (see #PJSIP_TX_BUF_MIN_SIZE), so
+ * the transmit data pool does not need to grow to hold the printed
+ * message.
+ *
+ * Default: 1 (yes)
+ */
+#ifndef PJSIP_HAS_SLAB_ALLOC
+#   define PJSIP_HAS_SLAB_ALLOC			1
+#endif
+
+
+/**
+ * The size of the smallest print buffer of transmit data, when
+ * #PJSIP_HAS_SLAB_ALLOC is enabled. The transport manager keeps print
+ * buffers in several sizes, starting from this value and doubling up to
+ * #PJSIP_MAX_PKT_LEN, and the message is moved to the smallest buffer
+ * that fits after it is printed. This reduces the memory held by the
+ * transactions for retransmission, since most messages are much smaller
+ * than #PJSIP_MAX_PKT_LEN.
+ *
+ * Set this to zero to always use #PJSIP_MAX_PKT_LEN buffers.
+ *
+ * Default: 512
+ */
+#ifndef PJSIP_TX_BUF_MIN_SIZE
+#   define PJSIP_TX_BUF_MIN_SIZE		512
+#endif
+
+
+/**
+ * Maximum number of destroyed transmit data to be kept by the transport
+ * manager for reuse, when #PJSIP_HAS_SLAB_ALLOC is enabled. The transmit
+ * data keeps its pool (which is reset) while in the cache, so creating
+ * a transmit data from the cache does not need to create a new pool.
+ *
+ * Set this to zero to disable the cache.
+ *
+ * Default: 32
+ */
+#ifndef PJSIP_TX_DATA_CACHE_SIZE
+#   define PJSIP_TX_DATA_CACHE_SIZE		32
+#endif
+
+
+/**
+ * Maximum number of destroyed transactions to be kept by the transaction
+ * layer for reuse, when #PJSIP_HAS_SLAB_ALLOC is enabled. The transaction
+ * keeps its pool (which is reset) while in the cache, so
+ * creating a transaction from the cache does not need to create a new
+ * pool. The branch and key of the transaction are stored in the
+ * transaction object, rather than allocated from the pool.
+ *
+ * Set this to zero to disable the cache.
+ *
+ * Default: 32
+ */
+#ifndef PJSIP_TSX_CACHE_SIZE
+#   define PJSIP_TSX_CACHE_SIZE			32
+#endif
+
 /** 
  * Specify whether to accept INVITE/re-INVITE with unknown content type,
  * by default the stack will reject this type of message as specified in 
@@ -138,6 +138,88 @@ PJ_DECL(pj_status_t) pjsip_endpt_handle_events( pjsip_endpoint *endpt,
 PJ_DECL(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
 					        const pj_time_val *max_timeout,
 					        unsigned *count);
+
+/**
+ * Create additional event loops, so that network events can be handled
+ * by several threads without sharing one ioqueue. Each loop has its own
+ * ioqueue and timer heap, and is polled by #pjsip_endpt_handle_loop_events().
+ * Loop zero is the main loop, which is the ioqueue and timer heap polled
+ * by #pjsip_endpt_handle_events().
+ *
+ * Transports created afterwards spread their sockets among the loops: the
+ * SO_REUSEPORT sockets of UDP transports and TCP listeners are assigned to
+ * the loops in turn, and connections accepted by a TCP listener socket are
+ * handled by the same loop as the socket. Other transports, and the timers
+ * of transactions and dialogs, stay in the main loop. To process the
+ * messages of a call by the same thread regardless of the loop which has
+ * received them, see \a pin_call_id in #pjsip_rx_queue_cfg.
+ *
+ * This function can only be called once. Transports which have been
+ * created before stay in the main loop.
+ *
+ * @param endpt		The endpoint.
+ * @param loop_cnt	Total number of loops including the main loop, up
+ *			to PJSIP_MAX_LOOP_CNT.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_create_loops(pjsip_endpoint *endpt,
+					      unsigned loop_cnt);
+
+/**
+ * Get the number of event loops, including the main loop.
+ *
+ * @param endpt		The endpoint.
+ *
+ * @return		Number of loops.
+ */
+PJ_DECL(unsigned) pjsip_endpt_get_loop_count(pjsip_endpoint *endpt);
+
+/**
+ * Get the ioqueue of an event loop.
+ *
+ * @param endpt		The endpoint.
+ * @param loop_idx	Loop index. Index greater than the number of loops
+ *			wraps around.
+ *
+ * @return		The ioqueue.
+ */
+PJ_DECL(pj_ioqueue_t*) pjsip_endpt_get_loop_ioqueue(pjsip_endpoint *endpt,
+						    unsigned loop_idx);
+
+/**
+ * Get the timer heap of an event loop. Timers scheduled to the heap are
+ * run by the thread polling the loop.
+ *
+ * @param endpt		The endpoint.
+ * @param loop_idx	Loop index. Index greater than the number of loops
+ *			wraps around.
+ *
+ * @return		The timer heap.
+ */
+PJ_DECL(pj_timer_heap_t*) pjsip_endpt_get_loop_timer_heap(
+						    pjsip_endpoint *endpt,
+						    unsigned loop_idx);
+
+/**
+ * Poll for events of an event loop. Application should dedicate a thread
+ * to each additional loop. Polling loop zero is the same as calling
+ * #pjsip_endpt_handle_events2().
+ *
+ * @param endpt		The endpoint.
+ * @param loop_idx	Loop index.
+ * @param max_timeout	Maximum time to wait for events, or NULL to wait
+ *			forever until event is received.
+ * @param count		Optional argument to receive the number of events
+ *			that have been handled by the function.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_handle_loop_events(pjsip_endpoint *endpt,
+						    unsigned loop_idx,
+						    const pj_time_val *max_timeout,
+						    unsigned *count);
+
 /**
  * Schedule timer to endpoint's timer heap. Application must poll the endpoint
  * periodically (by calling #pjsip_endpt_handle_events) to ensure that the
@@ -285,6 +367,37 @@ PJ_DECL(pj_status_t) pjsip_endpt_process_rx_data(pjsip_endpoint *endpt,
                                                  pjsip_process_rdata_param *p,
                                                  pj_bool_t *p_handled);
 
+/**
+ * This structure describes the load of received message processing in
+ * the endpoint, as returned by #pjsip_endpt_get_rx_load().
+ */
+typedef struct pjsip_endpt_rx_load
+{
+    /**
+     * Number of received messages which are waiting in the receive queue
+     * (see #pjsip_tpmgr_start_rx_queue()) or are being processed by the
+     * modules.
+     */
+    unsigned pending;
+
+    /**
+     * Average time from the reception of a message by the transport until
+     * the modules have finished processing it, in milliseconds.
+     */
+    unsigned latency;
+
+} pjsip_endpt_rx_load;
+
+/**
+ * Get the load of received message processing in the endpoint. This can
+ * be used to detect overload, see #pjsip_overload_init_module().
+ *
+ * @param endpt		The endpoint instance.
+ * @param load		Structure to receive the load information.
+ */
+PJ_DECL(void) pjsip_endpt_get_rx_load(pjsip_endpoint *endpt,
+				      pjsip_endpt_rx_load *load);
+
 /**
  * Create pool from the endpoint. All SIP components should allocate their
  * memory pool by calling this function, to make sure that the pools are
@@ -837,6 +837,9 @@ PJ_DECL(pjsip_msg*) pjsip_msg_clone( pj_pool_t *pool, const pjsip_msg *msg);
  *		    first header, otherwise the search will begin at the
  *		    specified header.
  *
+ * A lazy header (see #pjsip_lazy_hdr) of the specified type is parsed
+ * and replaced by the parsed header in the message before it is returned.
+ *
  * @return	    The header field, or NULL if no header with the specified 
  *		    type is found.
  */
@@ -853,6 +856,9 @@ PJ_DECL(void*)  pjsip_msg_find_hdr( const pjsip_msg *msg,
  *		    first header, otherwise the search will begin at the
  *		    specified header.
  *
+ * A lazy header with the specified name is parsed as in
+ * #pjsip_msg_find_hdr().
+ *
  * @return	    The header field, or NULL if no header with the specified 
  *		    type is found.
  */
@@ -871,6 +877,9 @@ PJ_DECL(void*)  pjsip_msg_find_hdr_by_name( const pjsip_msg *msg,
  *		    first header, otherwise the search will begin at the
  *		    specified header.
  *
+ * A lazy header with the specified name is parsed as in
+ * #pjsip_msg_find_hdr().
+ *
  * @return	    The header field, or NULL if no header with the specified 
  *		    type is found.
  */
@@ -892,6 +901,20 @@ PJ_DECL(void*)  pjsip_msg_find_hdr_by_names(const pjsip_msg *msg,
 PJ_DECL(void*)  pjsip_msg_find_remove_hdr( pjsip_msg *msg, 
 					   pjsip_hdr_e hdr, void *start);
 
+/**
+ * Parse all lazy headers (see #pjsip_lazy_hdr) in the message, replacing
+ * them with the parsed headers in the header list. The endpoint does this
+ * before the message reaches the transaction layer (see
+ * #PJSIP_LAZY_HDR_PARSE_AT_TSX); modules which walk the header list
+ * instead of looking the headers up can call this function first.
+ *
+ * This modifies the header list, so it must not be called while other
+ * threads may be reading the message.
+ *
+ * @param msg	    The message.
+ */
+PJ_DECL(void) pjsip_msg_parse_lazy_hdrs( pjsip_msg *msg );
+
 /** 
  * Add a header to the message, putting it last in the header list.
  *
@@ -1058,6 +1081,125 @@ PJ_DECL(void) pjsip_generic_string_hdr_init2(pjsip_generic_string_hdr *h,
 					     pj_str_t *hvalue);
 
 
+/* **************************************************************************/
+
+/**
+ * Header which value has not been parsed. The parser puts this header in
+ * incoming messages when lazy header parsing is enabled (see
+ * #PJSIP_LAZY_HDR_PARSING), and it is replaced by the real header when
+ * it is looked up with #pjsip_msg_find_hdr() and the like, or by
+ * #pjsip_msg_parse_lazy_hdrs() or #pjsip_lazy_hdr_parse(). Looking up
+ * PJSIP_H_OTHER by type returns the lazy headers as they are.
+ *
+ * The type of this header is PJSIP_H_OTHER, and its layout starts with
+ * the layout of #pjsip_generic_string_hdr, so it can be treated as a
+ * generic string header. It is printed verbatim.
+ */
+typedef struct pjsip_lazy_hdr
+{
+    /** Standard header field. */
+    PJSIP_DECL_HDR_MEMBER(struct pjsip_lazy_hdr);
+    /** The unparsed header value. */
+    pj_str_t	 hvalue;
+    /** The type of the header once parsed, or PJSIP_H_OTHER if the header
+     *  is not one of the standard headers. */
+    pjsip_hdr_e	 hdr_type;
+    /** Pool to allocate the parsed header. */
+    pj_pool_t	*pool;
+} pjsip_lazy_hdr;
+
+
+/**
+ * Create a lazy header.
+ *
+ * @param pool	    The pool, which will also be used to allocate the
+ *		    parsed header.
+ * @param hname	    The header name. The string is not copied.
+ * @param hvalue    The unparsed header value. The string is not copied,
+ *		    and the character after the value must be writable
+ *		    since the parser temporarily NULL terminates it.
+ * @param hdr_type  The type of the header once parsed.
+ *
+ * @return	    The header.
+ */
+PJ_DECL(pjsip_lazy_hdr*) pjsip_lazy_hdr_create(pj_pool_t *pool,
+					       const pj_str_t *hname,
+					       const pj_str_t *hvalue,
+					       pjsip_hdr_e hdr_type);
+
+/**
+ * Check whether the header is a lazy header.
+ *
+ * @param hdr	    The header.
+ *
+ * @return	    PJ_TRUE if the header is a #pjsip_lazy_hdr.
+ */
+PJ_DECL(pj_bool_t) pjsip_hdr_is_lazy(const pjsip_hdr *hdr);
+
+/**
+ * Parse the lazy header, and replace it with the parsed header(s) in the
+ * list where it is. A single header line may produce more than one header,
+ * e.g. a Contact header with several contacts.
+ *
+ * If the value can not be parsed, the header is left in the list as
+ * a generic string header.
+ *
+ * @param hdr	    The lazy header.
+ *
+ * @return	    The first parsed header, or NULL if the value can not be
+ *		    parsed.
+ */
+PJ_DECL(pjsip_hdr*) pjsip_lazy_hdr_parse(pjsip_lazy_hdr *hdr);
+
+
+/* **************************************************************************/
+
+/**
+ * Attach pre-encoded form to the header. The header is printed once to
+ * memory allocated from the pool, and printing the header afterwards, e.g.
+ * when the message is encoded by #pjsip_tx_data_encode(), copies the
+ * encoding instead of printing the header field by field.
+ *
+ * The header keeps its type and structure, so it can be looked up and
+ * inspected as usual. The encoding is kept when the header is cloned with
+ * #pjsip_hdr_clone() or #pjsip_hdr_shallow_clone(), hence this is meant
+ * for headers that don't change once created, such as the Contact and
+ * route set of a dialog. The header must not be modified while it has
+ * pre-encoded form, call #pjsip_hdr_clear_encoded() before modifying it.
+ *
+ * The clones share the encoding, which is allocated from the pool, so the
+ * pool must not be released while the clones are in use. Call
+ * #pjsip_hdr_clear_encoded() on a clone that may outlive the pool.
+ *
+ * The encoding is not used if #pjsip_use_compact_form is changed after
+ * the header has been encoded.
+ *
+ * @param pool	    The pool to allocate the encoding.
+ * @param hdr	    The header. Lazy header (see #pjsip_lazy_hdr) can not
+ *		    be encoded.
+ *
+ * @return	    PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_hdr_set_encoded(pj_pool_t *pool, pjsip_hdr *hdr);
+
+/**
+ * Check whether the header has pre-encoded form.
+ *
+ * @param hdr	    The header.
+ *
+ * @return	    PJ_TRUE if the header has pre-encoded form.
+ */
+PJ_DECL(pj_bool_t) pjsip_hdr_is_encoded(const pjsip_hdr *hdr);
+
+/**
+ * Remove the pre-encoded form of the header, so that the header can be
+ * modified.
+ *
+ * @param hdr	    The header.
+ */
+PJ_DECL(void) pjsip_hdr_clear_encoded(pjsip_hdr *hdr);
+
+
 /* **************************************************************************/
 
 /**
@@ -0,0 +1,193 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJSIP_SIP_OVERLOAD_H__
+#define __PJSIP_SIP_OVERLOAD_H__
+
+/**
+ * @file sip_overload.h
+ * @brief Overload control module.
+ */
+
+#include <pjsip/sip_endpoint.h>
+#include <pjsip/sip_module.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJSIP_OVERLOAD Overload Control
+ * @ingroup PJSIP_CORE_CORE
+ * @brief Reject new requests when the endpoint is overloaded.
+ * @{
+ *
+ * The overload control module watches the number of received messages
+ * queued or being processed, the average time to process received
+ * messages (see #pjsip_endpt_get_rx_load()) and the number of
+ * transactions. When any of them reaches its configured limit, the
+ * endpoint is considered overloaded and new out-of-dialog INVITE,
+ * SUBSCRIBE and REFER requests (or all new out-of-dialog requests, see
+ * \a reject_all) are answered statelessly with 503 (Service Unavailable)
+ * and a Retry-After header, before a transaction is created for them.
+ * ACK, CANCEL, BYE, in-dialog requests, responses, and retransmissions of
+ * requests which already have a transaction are processed as usual, so
+ * that existing calls can complete.
+ *
+ * The endpoint leaves the overload state when all of the values drop
+ * below three quarters of their limits.
+ *
+ * The module has priority just before the transaction layer. Application
+ * registers it by calling #pjsip_overload_init_module().
+ */
+
+/**
+ * Overload control settings.
+ */
+typedef struct pjsip_overload_cfg
+{
+    /**
+     * Maximum number of received messages queued or being processed by
+     * the endpoint. Zero disables this check.
+     *
+     * Default: PJSIP_OVERLOAD_MAX_RX_PENDING
+     */
+    unsigned	max_rx_pending;
+
+    /**
+     * Maximum average time to process received messages, in milliseconds.
+     * Zero disables this check.
+     *
+     * Default: PJSIP_OVERLOAD_MAX_LATENCY
+     */
+    unsigned	max_latency;
+
+    /**
+     * Maximum number of transactions. Zero disables this check.
+     *
+     * Default: PJSIP_OVERLOAD_MAX_TSX_COUNT
+     */
+    unsigned	max_tsx_cnt;
+
+    /**
+     * Value of Retry-After header in the 503 response, in seconds.
+     *
+     * Default: PJSIP_OVERLOAD_RETRY_AFTER
+     */
+    unsigned	retry_after;
+
+    /**
+     * Reject every new out-of-dialog request when the endpoint is
+     * overloaded. If PJ_FALSE, only requests which create a dialog
+     * (INVITE, SUBSCRIBE and REFER) are rejected, and other requests such
+     * as REGISTER, OPTIONS and MESSAGE are processed as usual.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t	reject_all;
+
+} pjsip_overload_cfg;
+
+
+/**
+ * Overload control statistics.
+ */
+typedef struct pjsip_overload_stat
+{
+    /**
+     * Whether the endpoint is currently overloaded.
+     */
+    pj_bool_t		overloaded;
+
+    /**
+     * Number of requests rejected with 503 since the module was
+     * registered.
+     */
+    unsigned		rejected_cnt;
+
+    /**
+     * Number of times the endpoint has entered overload state.
+     */
+    unsigned		overload_cnt;
+
+    /**
+     * Current load of received message processing.
+     */
+    pjsip_endpt_rx_load	rx_load;
+
+    /**
+     * Current number of transactions.
+     */
+    unsigned		tsx_cnt;
+
+} pjsip_overload_stat;
+
+
+/**
+ * Initialize overload control settings with default values.
+ *
+ * @param cfg		The settings.
+ */
+PJ_DECL(void) pjsip_overload_cfg_default(pjsip_overload_cfg *cfg);
+
+/**
+ * Initialize and register the overload control module to the endpoint.
+ * The transaction layer must have been initialized.
+ *
+ * @param endpt		The endpoint instance.
+ * @param cfg		Optional settings. If NULL, the default settings
+ *			are used.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_overload_init_module(pjsip_endpoint *endpt,
+						const pjsip_overload_cfg *cfg);
+
+/**
+ * Get the overload control module instance.
+ *
+ * @return		The module instance.
+ */
+PJ_DECL(pjsip_module*) pjsip_overload_instance(void);
+
+/**
+ * Change the overload control settings. The new settings take effect
+ * on the next received request.
+ *
+ * @param cfg		The new settings.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_overload_set_cfg(const pjsip_overload_cfg *cfg);
+
+/**
+ * Get the overload control statistics.
+ *
+ * @param stat		Structure to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_overload_get_stat(pjsip_overload_stat *stat);
+
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJSIP_SIP_OVERLOAD_H__ */
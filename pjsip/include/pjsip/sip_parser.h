@@ -104,6 +104,10 @@ typedef struct pjsip_parse_ctx
  *	- ampersand, such as when the header is part of an URI.
  *	- for the last header, these separator is optional since parsing
  *        can be terminated when seeing EOF.
+ *   - It is always called with an exception handler installed, although
+ *     the messages are parsed without exception otherwise. The built-in
+ *     parsers report syntax errors with pj_scan_syntax_err() instead, to
+ *     avoid the cost of setting up the exception handler.
  */
 typedef pjsip_hdr* (pjsip_parse_hdr_func)(pjsip_parse_ctx *context);
 
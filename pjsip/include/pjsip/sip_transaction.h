@@ -139,6 +139,11 @@ struct pjsip_transaction
     pj_timer_entry		retransmit_timer;/**< Retransmit timer.     */
     pj_timer_entry		timeout_timer;  /**< Timeout timer.         */
 
+#if PJSIP_HAS_SLAB_ALLOC
+    struct pjsip_tsx_slab      *slab;		/**< Allocator of the
+						     transaction, if any.   */
+#endif
+
     /** Module specific data. */
     void		       *mod_data[PJSIP_MAX_MODULE];
 };
@@ -628,6 +628,13 @@ struct pjsip_tx_data
      */
     pjsip_host_port          via_addr;      /**< Via address.	        */
     const void              *via_tp;        /**< Via transport.	        */
+
+    /**
+     * The print buffer allocated by the transport manager, and the slab
+     * allocator where it is allocated from. This is for internal use only.
+     */
+    struct pj_slab_t	    *buf_slab;	    /**< Slab of the buffer.	*/
+    char		    *slab_buf;	    /**< The buffer.		*/
 };
 
 
@@ -871,6 +878,23 @@ struct pjsip_transport
 };
 
 
+/**
+ * Write coalescing statistics of a connection oriented transport (TCP
+ * and TLS). Messages which are sent while a write is in progress are
+ * queued, and written together with one write when the write completes.
+ * The average number of messages per write is \a msg_cnt divided by
+ * \a write_cnt.
+ *
+ * @see pjsip_tcp_transport_get_tx_stat(), pjsip_tls_transport_get_tx_stat()
+ */
+typedef struct pjsip_tp_tx_stat
+{
+    pj_uint32_t	msg_cnt;	/**< Number of messages written.	    */
+    pj_uint32_t	write_cnt;	/**< Number of writes to the socket.	    */
+    pj_uint32_t	max_msg_cnt;	/**< Largest number of messages in a write. */
+} pjsip_tp_tx_stat;
+
+
 /**
  * Register a transport instance to the transport manager. This function
  * is normally called by the transport instance when it is created
@@ -1234,6 +1258,287 @@ PJ_DECL(pj_status_t) pjsip_tpmgr_destroy(pjsip_tpmgr *mgr);
 PJ_DECL(void) pjsip_tpmgr_dump_transports(pjsip_tpmgr *mgr);
 
 
+/**
+ * Priority classes of the receive queue, see #pjsip_tpmgr_start_rx_queue().
+ * Lower value is processed first.
+ */
+typedef enum pjsip_rx_queue_prio
+{
+    /**
+     * Responses, and ACK, BYE and CANCEL requests.
+     */
+    PJSIP_RX_QUEUE_PRIO_HIGH,
+
+    /**
+     * Other requests inside a dialog, i.e. requests with To tag.
+     */
+    PJSIP_RX_QUEUE_PRIO_DIALOG,
+
+    /**
+     * New requests, such as initial INVITE, REGISTER and SUBSCRIBE.
+     */
+    PJSIP_RX_QUEUE_PRIO_NEW,
+
+    /**
+     * Number of priority classes.
+     */
+    PJSIP_RX_QUEUE_PRIO_CNT
+
+} pjsip_rx_queue_prio;
+
+
+/**
+ * Receive queue settings.
+ */
+typedef struct pjsip_rx_queue_cfg
+{
+    /**
+     * Number of worker threads which parse and dispatch the queued
+     * messages.
+     *
+     * Default: PJSIP_RX_QUEUE_WORKER_CNT
+     */
+    unsigned	worker_cnt;
+
+    /**
+     * Maximum number of messages in the queue. When the queue is full,
+     * the newest message of lower priority is dropped to make room for
+     * the received message, or the received message is dropped if there
+     * is none.
+     *
+     * Default: PJSIP_RX_QUEUE_MAX_LEN
+     */
+    unsigned	max_len;
+
+    /**
+     * Give each worker thread its own queue, and put the messages of a
+     * call, i.e. messages with the same Call-ID, to the queue of the same
+     * worker. The messages of a call are then processed one at a time by
+     * one thread, so the workers don't contend for the same dialogs and
+     * transactions. The limit \a max_len still applies to all queues
+     * together.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t	pin_call_id;
+
+} pjsip_rx_queue_cfg;
+
+
+/**
+ * Receive queue statistics.
+ */
+typedef struct pjsip_rx_queue_stat
+{
+    /**
+     * Number of messages currently in the queue.
+     */
+    unsigned	len;
+
+    /**
+     * Maximum number of messages in the queue so far.
+     */
+    unsigned	max_len;
+
+    /**
+     * Number of messages queued so far, per priority class.
+     */
+    unsigned	queued_cnt[PJSIP_RX_QUEUE_PRIO_CNT];
+
+    /**
+     * Number of messages dropped because the queue was full, per priority
+     * class.
+     */
+    unsigned	dropped_cnt[PJSIP_RX_QUEUE_PRIO_CNT];
+
+} pjsip_rx_queue_stat;
+
+
+/**
+ * Initialize receive queue settings with default values.
+ *
+ * @param cfg	    The settings.
+ */
+PJ_DECL(void) pjsip_rx_queue_cfg_default(pjsip_rx_queue_cfg *cfg);
+
+/**
+ * Start the receive queue of the transport manager. By default, received
+ * messages are parsed and distributed to the modules by the thread that
+ * polls the transport, so a slow module delays reading the socket. With
+ * the receive queue, the polling thread only frames and classifies the
+ * message (see #pjsip_rx_queue_prio), copies it and puts it to the queue.
+ * The messages are then parsed and distributed by a pool of worker
+ * threads, highest priority first, so that existing calls and
+ * transactions are served before new ones.
+ *
+ * Note that messages of different priority may be processed in different
+ * order than they were received, e.g. CANCEL before the INVITE it cancels,
+ * when the queue is not empty.
+ *
+ * @param mgr	    The transport manager.
+ * @param cfg	    Optional settings, if NULL the default settings are used.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_tpmgr_start_rx_queue(pjsip_tpmgr *mgr,
+						const pjsip_rx_queue_cfg *cfg);
+
+/**
+ * Stop the receive queue and its worker threads. Messages still in the
+ * queue are discarded, and received messages are processed by the polling
+ * thread again. This is called automatically when the endpoint is
+ * destroyed.
+ *
+ * @param mgr	    The transport manager.
+ */
+PJ_DECL(void) pjsip_tpmgr_stop_rx_queue(pjsip_tpmgr *mgr);
+
+/**
+ * Get the receive queue statistics.
+ *
+ * @param mgr	    The transport manager.
+ * @param stat	    Structure to receive the statistics.
+ *
+ * @return	    PJ_SUCCESS on success, or PJ_ENOTFOUND if the receive
+ *		    queue has never been started.
+ */
+PJ_DECL(pj_status_t) pjsip_tpmgr_get_rx_queue_stat(pjsip_tpmgr *mgr,
+						   pjsip_rx_queue_stat *stat);
+
+
+/**
+ * Token bucket budget of the rate limiter, see #pjsip_tpmgr_set_rate_limit().
+ */
+typedef struct pjsip_rate_limit_budget
+{
+    /**
+     * Method name of the requests the budget applies to, e.g. "REGISTER".
+     * This is not used for the budget of all requests.
+     */
+    pj_str_t	method;
+
+    /**
+     * Number of requests per second. Zero means no limit.
+     */
+    unsigned	rate;
+
+    /**
+     * Maximum number of requests that may arrive at once, i.e. the size
+     * of the token bucket. Zero means the same as \a rate.
+     */
+    unsigned	burst;
+
+} pjsip_rate_limit_budget;
+
+
+/**
+ * Rate limiter settings.
+ */
+typedef struct pjsip_rate_limit_cfg
+{
+    /**
+     * Maximum number of source addresses being tracked. When a request
+     * arrives from a new source and the table is full, the least recently
+     * seen source is forgotten.
+     *
+     * Default: PJSIP_RATE_LIMIT_MAX_SOURCES
+     */
+    unsigned			max_sources;
+
+    /**
+     * Budget for all requests from a source.
+     *
+     * Default: PJSIP_RATE_LIMIT_RATE requests per second, with burst
+     * of PJSIP_RATE_LIMIT_BURST.
+     */
+    pjsip_rate_limit_budget	all;
+
+    /**
+     * Number of per-method budgets.
+     *
+     * Default: 0
+     */
+    unsigned			method_cnt;
+
+    /**
+     * Per-method budgets. A request must fit in both the budget of its
+     * method and the budget of all requests.
+     */
+    pjsip_rate_limit_budget	method[PJSIP_RATE_LIMIT_MAX_METHODS];
+
+} pjsip_rate_limit_cfg;
+
+
+/**
+ * Rate limiter statistics.
+ */
+typedef struct pjsip_rate_limit_stat
+{
+    /**
+     * Number of source addresses currently tracked.
+     */
+    unsigned	source_cnt;
+
+    /**
+     * Number of sources forgotten to make room for new ones.
+     */
+    unsigned	evicted_cnt;
+
+    /**
+     * Number of requests which were within the budgets.
+     */
+    unsigned	passed_cnt;
+
+    /**
+     * Number of requests dropped.
+     */
+    unsigned	dropped_cnt;
+
+    /**
+     * Number of requests dropped because of each per-method budget.
+     */
+    unsigned	method_dropped_cnt[PJSIP_RATE_LIMIT_MAX_METHODS];
+
+} pjsip_rate_limit_stat;
+
+
+/**
+ * Initialize rate limiter settings with default values.
+ *
+ * @param cfg	    The settings.
+ */
+PJ_DECL(void) pjsip_rate_limit_cfg_default(pjsip_rate_limit_cfg *cfg);
+
+/**
+ * Enable, reconfigure or disable per-source rate limiting of received
+ * requests. Each source IP address has a token bucket for all requests,
+ * and one for each configured method. Requests which exceed the budget
+ * of their source are dropped silently as soon as they are framed, before
+ * they are parsed. Responses are not limited.
+ *
+ * Changing the settings resets the state of all sources.
+ *
+ * @param mgr	    The transport manager.
+ * @param cfg	    The settings, or NULL to disable rate limiting.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_tpmgr_set_rate_limit(pjsip_tpmgr *mgr,
+					const pjsip_rate_limit_cfg *cfg);
+
+/**
+ * Get the rate limiter statistics.
+ *
+ * @param mgr	    The transport manager.
+ * @param stat	    Structure to receive the statistics.
+ *
+ * @return	    PJ_SUCCESS on success, or PJ_ENOTFOUND if rate limiting
+ *		    has never been enabled.
+ */
+PJ_DECL(pj_status_t) pjsip_tpmgr_get_rate_limit_stat(pjsip_tpmgr *mgr,
+						pjsip_rate_limit_stat *stat);
+
+
 /*****************************************************************************
  *
  * PUBLIC API
@@ -86,6 +86,19 @@ typedef struct pjsip_tcp_transport_cfg
      */
     unsigned	       async_cnt;
 
+    /**
+     * Number of listening sockets to be bound to the same address with
+     * SO_REUSEPORT. The kernel distributes incoming connections among
+     * the sockets, and each socket has its own accept backlog and pending
+     * accept() operations (\a async_cnt), so that accepting connections
+     * can be spread among the SIP worker threads. All sockets belong to
+     * the same listener. If the platform does not support SO_REUSEPORT,
+     * only one socket will be used.
+     *
+     * Default: 1
+     */
+    unsigned	       sock_cnt;
+
     /**
      * QoS traffic type to be set on this transport. When application wants
      * to apply QoS tagging to the transport, it's preferable to set this
@@ -225,6 +238,18 @@ PJ_DECL(pj_status_t) pjsip_tcp_transport_start3(
  */
 PJ_DECL(pj_sock_t) pjsip_tcp_transport_get_socket(pjsip_transport *transport);
 
+/**
+ * Get the write coalescing statistics of the TCP transport.
+ *
+ * @param transport	The TCP transport.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_tcp_transport_get_tx_stat(
+					pjsip_transport *transport,
+					pjsip_tp_tx_stat *stat);
+
 PJ_END_DECL
 
 /**
@@ -379,6 +379,18 @@ PJ_DECL(pj_status_t) pjsip_tls_transport_start2(pjsip_endpoint *endpt,
 					        unsigned async_cnt,
 					        pjsip_tpfactory **p_factory);
 
+/**
+ * Get the write coalescing statistics of the TLS transport.
+ *
+ * @param transport	The TLS transport.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_tls_transport_get_tx_stat(
+					pjsip_transport *transport,
+					pjsip_tp_tx_stat *stat);
+
 PJ_END_DECL
 
 /**
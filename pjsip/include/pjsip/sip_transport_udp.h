@@ -59,6 +59,98 @@ enum
 };
 
 
+/**
+ * Settings to be specified when creating the UDP transport with
+ * #pjsip_udp_transport_start2(). Application should initialize this
+ * structure with its default values by calling
+ * #pjsip_udp_transport_cfg_default().
+ */
+typedef struct pjsip_udp_transport_cfg
+{
+    /**
+     * Address family to use. Valid values are pj_AF_INET() and
+     * pj_AF_INET6().
+     */
+    int			af;
+
+    /**
+     * Address to bind the socket to. If the address family is zero, the
+     * socket will be bound to any address and an arbitrary port.
+     *
+     * Default: zero
+     */
+    pj_sockaddr		bind_addr;
+
+    /**
+     * Published address (only the host and port portion is used). If the
+     * host is empty, the bound address will be used as the published
+     * address.
+     *
+     * Default: empty
+     */
+    pjsip_host_port	addr_name;
+
+    /**
+     * Number of simultaneous asynchronous read operations. Having more
+     * than one allows several worker threads to receive packets from the
+     * transport at the same time.
+     *
+     * Default: 1
+     */
+    unsigned		async_cnt;
+
+    /**
+     * Maximum number of packets received by each read operation with a
+     * single system call. The value is capped at PJ_IOQUEUE_MAX_MMSG, and
+     * it will be ignored if the ioqueue does not support batch receive.
+     *
+     * Default: PJSIP_UDP_RECV_BATCH
+     */
+    unsigned		recv_batch;
+
+    /**
+     * Number of sockets to be bound to the same address with SO_REUSEPORT.
+     * The kernel distributes incoming packets among the sockets by the
+     * source address, and each socket has its own read operations
+     * (\a async_cnt), so that receiving can be spread among the SIP
+     * worker threads. All sockets belong to the same transport, and
+     * outgoing packets are sent with the first socket. If the platform
+     * does not support SO_REUSEPORT, only one socket will be used.
+     *
+     * Default: 1
+     */
+    unsigned		sock_cnt;
+
+} pjsip_udp_transport_cfg;
+
+
+/**
+ * Initialize pjsip_udp_transport_cfg structure with default values.
+ *
+ * @param cfg		The UDP transport config.
+ * @param af		Address family, pj_AF_INET() or pj_AF_INET6().
+ */
+PJ_DECL(void) pjsip_udp_transport_cfg_default(pjsip_udp_transport_cfg *cfg,
+					      int af);
+
+
+/**
+ * Start UDP transport with the specified settings.
+ *
+ * @param endpt		The SIP endpoint.
+ * @param cfg		The UDP transport settings.
+ * @param p_transport	Pointer to receive the transport.
+ *
+ * @return		PJ_SUCCESS when the transport has been successfully
+ *			started and registered to transport manager, or
+ *			the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_udp_transport_start2(
+					pjsip_endpoint *endpt,
+					const pjsip_udp_transport_cfg *cfg,
+					pjsip_transport **p_transport);
+
+
 /**
  * Start UDP transport.
  *
@@ -136,6 +228,34 @@ PJ_DECL(pj_status_t) pjsip_udp_transport_attach2(pjsip_endpoint *endpt,
 						 unsigned async_cnt,
 						 pjsip_transport **p_transport);
 
+/**
+ * Attach several IPv4 or IPv6 UDP sockets, which are bound to the same
+ * address with SO_REUSEPORT, as one transport and start the transport.
+ * Packets received by any of the sockets are reported by the transport,
+ * and outgoing packets are sent with the first socket.
+ *
+ * @param endpt		The SIP endpoint.
+ * @param type		Transport type, which is PJSIP_TRANSPORT_UDP for IPv4
+ *			or PJSIP_TRANSPORT_UDP6 for IPv6 socket.
+ * @param sock_cnt	Number of sockets.
+ * @param sock		The UDP sockets to use.
+ * @param a_name	Published address (only the host and port portion is 
+ *			used).
+ * @param async_cnt	Number of simultaneous async operations per socket.
+ * @param p_transport	Pointer to receive the transport.
+ *
+ * @return		PJ_SUCCESS when the transport has been successfully
+ *			started and registered to transport manager, or
+ *			the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_udp_transport_attach3(pjsip_endpoint *endpt,
+						 pjsip_transport_type_e type,
+						 unsigned sock_cnt,
+						 const pj_sock_t sock[],
+						 const pjsip_host_port *a_name,
+						 unsigned async_cnt,
+						 pjsip_transport **p_transport);
+
 /**
  * Retrieve the internal socket handle used by the UDP transport. Note
  * that this socket normally is registered to ioqueue, so if application
@@ -172,6 +292,11 @@ PJ_DECL(pj_sock_t) pjsip_udp_transport_get_socket(pjsip_transport *transport);
  *    flag when calling this function, and specify a new socket when
  *    calling #pjsip_udp_transport_restart().
  *
+ * If the transport has several sockets (see #pjsip_udp_transport_attach3()),
+ * the other sockets are closed together with the socket returned by
+ * #pjsip_udp_transport_get_socket() when the socket is destroyed, and the
+ * restarted transport will only use the new socket.
+ *
  * @param transport	The UDP transport.
  * @param option	Pause option.
  *
@@ -856,6 +856,64 @@ PJ_DECL(pj_status_t) pjsip_endpt_create_response_fwd( pjsip_endpoint *endpt,
 
 
 
+/**
+ * Create new request message to be forwarded upstream, like
+ * #pjsip_endpt_create_request_fwd(), but without cloning the whole
+ * message. Only the headers which the proxy and the transport layer need
+ * to inspect or modify are added to the message as parsed headers: the
+ * new Via, the top Via of the request (which has the received and rport
+ * params added when the request was received), Max-Forwards (decremented,
+ * or added with value 70), the Route headers and CSeq. The rest of the header block and the body are copied
+ * verbatim from the packet in rdata, hence they are printed without
+ * having to be cloned and printed header by header.
+ *
+ * This is suitable for high rate stateless proxy. Application may add,
+ * remove, or modify the parsed headers in the message, for example to
+ * remove its own Route header or to add Record-Route, but the headers in
+ * the copied block can not be modified.
+ *
+ * @param endpt	    The endpoint instance.
+ * @param rdata	    The incoming request message.
+ * @param uri	    The URI where the request will be forwarded to. If
+ *		    NULL, the Request-URI of the incoming request is used.
+ * @param branch    Optional branch parameter, see
+ *		    #pjsip_endpt_create_request_fwd().
+ * @param options   Currently not used, must be zero.
+ * @param tdata	    The result.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_create_request_splice(pjsip_endpoint *endpt,
+						       pjsip_rx_data *rdata, 
+						       const pjsip_uri *uri,
+						       const pj_str_t *branch,
+						       unsigned options,
+						       pjsip_tx_data **tdata);
+
+
+/**
+ * Create new response message to be forwarded downstream, from the
+ * response message found in rdata, without cloning the whole message.
+ * Like #pjsip_endpt_create_response_fwd(), the top most Via header is
+ * removed from the response. The next Via header, which determines where
+ * to forward the response, and CSeq are added to the message as parsed
+ * headers, while the rest of the header block and the body are copied
+ * verbatim from the packet in rdata.
+ *
+ * @param endpt	    The endpoint instance.
+ * @param rdata	    The incoming response message.
+ * @param options   Currently not used, must be zero.
+ * @param tdata	    The result.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_create_response_splice(pjsip_endpoint *endpt,
+							pjsip_rx_data *rdata, 
+							unsigned options,
+							pjsip_tx_data **tdata);
+
+
+
 /**
  * Create a globally unique branch parameter based on the information in 
  * the incoming request message, for the purpose of creating a new request
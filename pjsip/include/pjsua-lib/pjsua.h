@@ -1424,14 +1424,21 @@ typedef struct pjsua_config
 {
 
     /** 
-     * Maximum calls to support (default: 4). The value specified here
-     * must be smaller than the compile time maximum settings 
-     * PJSUA_MAX_CALLS, which by default is 32. To increase this 
-     * limit, the library must be recompiled with new PJSUA_MAX_CALLS
-     * value.
+     * Maximum calls to support (default: 4). The call table grows on
+     * demand, PJSUA_CALL_CHUNK_SIZE calls at a time, up to this limit,
+     * so memory for the calls is only allocated when they are needed.
+     * The value may be larger than PJSUA_MAX_CALLS.
      */
     unsigned	    max_calls;
 
+    /** 
+     * Maximum accounts to support (default: PJSUA_MAX_ACC). Like the call
+     * table, the account table grows on demand, PJSUA_ACC_CHUNK_SIZE
+     * accounts at a time, up to this limit. The value may be larger than
+     * PJSUA_MAX_ACC.
+     */
+    unsigned	    max_acc;
+
     /** 
      * Number of worker threads. Normally application will want to have at
      * least one worker thread, unless when it wants to poll the library
@@ -2309,6 +2316,19 @@ typedef struct pjsua_transport_config
      */
     pj_sockopt_params	sockopt_params;
 
+    /**
+     * Number of sockets to be bound to the same address with SO_REUSEPORT,
+     * for UDP and TCP transports. The kernel distributes incoming packets
+     * (UDP) or connections (TCP) among the sockets, so that they can be
+     * processed by several worker threads in parallel. The sockets belong
+     * to the same transport. The value is capped at 16 for UDP, and only
+     * one socket will be used if the platform does not support
+     * SO_REUSEPORT.
+     *
+     * Default: 1
+     */
+    unsigned		sock_cnt;
+
 } pjsua_transport_config;
 
 
@@ -2498,8 +2518,10 @@ PJ_DECL(pj_status_t) pjsua_transport_close( pjsua_transport_id id,
  * header in outgoing requests.
  *
  * PJSUA-API supports creating and managing multiple accounts. The maximum
- * number of accounts is limited by a compile time constant
- * <tt>PJSUA_MAX_ACC</tt>.
+ * number of accounts is configured in pjsua_config.max_acc, which defaults
+ * to the compile time constant <tt>PJSUA_MAX_ACC</tt>. Incoming requests
+ * are matched to accounts using hash indexes, so the cost of finding the
+ * account does not depend on the number of accounts.
  *
  * Account may or may not have client registration associated with it.
  * An account is also associated with <b>route set</b> and some <b>authentication
@@ -2527,12 +2549,25 @@ PJ_DECL(pj_status_t) pjsua_transport_close( pjsua_transport_id id,
  */
 
 /**
- * Maximum accounts.
+ * Default maximum accounts. This is also the upper limit of account ids
+ * used by applications which keep per-account data in fixed arrays. The
+ * library itself supports as many accounts as configured in
+ * pjsua_config.max_acc.
  */
 #ifndef PJSUA_MAX_ACC
 #   define PJSUA_MAX_ACC	    8
 #endif
 
+/**
+ * Number of accounts to be allocated each time the account table needs
+ * to grow.
+ *
+ * Default: 32
+ */
+#ifndef PJSUA_ACC_CHUNK_SIZE
+#   define PJSUA_ACC_CHUNK_SIZE	    32
+#endif
+
 
 /**
  * Default registration interval.
@@ -3906,12 +3941,23 @@ PJ_DECL(pj_status_t) pjsua_acc_set_transport(pjsua_acc_id acc_id,
  */
 
 /**
- * Maximum simultaneous calls.
+ * Maximum simultaneous calls. This is the upper limit of call ids used by
+ * applications which keep per-call data in fixed arrays. The library
+ * itself supports as many calls as configured in pjsua_config.max_calls.
  */
 #ifndef PJSUA_MAX_CALLS
 #   define PJSUA_MAX_CALLS	    32
 #endif
 
+/**
+ * Number of calls to be allocated each time the call table needs to grow.
+ *
+ * Default: 32
+ */
+#ifndef PJSUA_CALL_CHUNK_SIZE
+#   define PJSUA_CALL_CHUNK_SIZE    32
+#endif
+
 /**
  * Maximum active video windows
  */
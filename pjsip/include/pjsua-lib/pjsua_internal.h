@@ -189,6 +189,9 @@ struct pjsua_call
     pj_timer_entry	 reinv_timer;  /**< Reinvite retry timer.	    */
     pj_bool_t	 	 reinv_pending;/**< Pending until CONFIRMED state.  */
     pj_bool_t	 	 reinv_ice_sent;/**< Has reinvite for ICE upd sent? */
+
+    pj_bool_t		 in_use;       /**< Call id has been allocated.	    */
+    pjsua_call_id	 next_free;    /**< Next free call id.		    */
 };
 
 
@@ -205,6 +208,32 @@ struct pjsua_srv_pres
     int		     expires;	    /**< "expires" value in the request.    */
 };
 
+/**
+ * Account lookup indexes, see pjsua_acc_find_for_incoming() and
+ * pjsua_acc_find_for_outgoing().
+ */
+enum pjsua_acc_index_type
+{
+    PJSUA_ACC_INDEX_USER_DOMAIN,    /**< "user@domain" of local URI.	*/
+    PJSUA_ACC_INDEX_DOMAIN,	    /**< Domain of local URI.		*/
+    PJSUA_ACC_INDEX_DOMAIN_PORT,    /**< Domain and port of local URI.	*/
+    PJSUA_ACC_INDEX_USER_TP,	    /**< User part and transport type.	*/
+    PJSUA_ACC_INDEX_CNT
+};
+
+/**
+ * Entry of an account in a lookup index. Accounts with the same key are
+ * chained, ordered the same way as the account priority list.
+ */
+typedef struct pjsua_acc_index_entry
+{
+    pj_str_t		 key;	    /**< Key of the account.		*/
+    pj_size_t		 key_size;  /**< Size of the key buffer, which is
+					 reused when the account is
+					 indexed again.			*/
+    struct pjsua_acc	*next;	    /**< Next account with the same key */
+} pjsua_acc_index_entry;
+
 /**
  * Account
  */
@@ -275,6 +304,10 @@ typedef struct pjsua_acc
     pjsip_dialog    *mwi_dlg;	    /**< Dialog for MWI sub.		*/
 
     pj_uint16_t      next_rtp_port; /**< Next RTP port to be used.      */
+
+    unsigned	     prio_seq;	    /**< Insertion order in acc_ids.	*/
+    pj_bool_t	     indexed;	    /**< Is in the lookup indexes?	*/
+    pjsua_acc_index_entry idx[PJSUA_ACC_INDEX_CNT]; /**< Index entries.	*/
 } pjsua_acc;
 
 
@@ -441,14 +474,19 @@ struct pjsua_data
     /* Account: */
     unsigned		 acc_cnt;	     /**< Number of accounts.	*/
     pjsua_acc_id	 default_acc;	     /**< Default account ID	*/
-    pjsua_acc		 acc[PJSUA_MAX_ACC]; /**< Account array.	*/
-    pjsua_acc_id	 acc_ids[PJSUA_MAX_ACC]; /**< Acc sorted by prio*/
+    pjsua_acc		**acc;		     /**< Account table chunks.	*/
+    unsigned		 acc_table_size;     /**< Allocated accounts.	*/
+    pjsua_acc_id	*acc_ids;	     /**< Acc sorted by prio	*/
+    unsigned		 acc_prio_seq;	     /**< Last acc prio_seq.	*/
+    pj_hash_table_t	*acc_index[PJSUA_ACC_INDEX_CNT]; /**< Acc indexes*/
 
     /* Calls: */
     pjsua_config	 ua_cfg;		/**< UA config.		*/
     unsigned		 call_cnt;		/**< Call counter.	*/
-    pjsua_call		 calls[PJSUA_MAX_CALLS];/**< Calls array.	*/
-    pjsua_call_id	 next_call_id;		/**< Next call id to use*/
+    pjsua_call		**calls;		/**< Call table chunks.	*/
+    unsigned		 call_table_size;	/**< Allocated calls.	*/
+    pjsua_call_id	 call_free_head;	/**< First free call.	*/
+    pjsua_call_id	 call_free_tail;	/**< Last free call.	*/
 
     /* Buddy; */
     unsigned		 buddy_cnt;		    /**< Buddy count.	*/
@@ -509,6 +547,35 @@ extern struct pjsua_data pjsua_var;
  */
 PJ_DECL(struct pjsua_data*) pjsua_get_var(void);
 
+/**
+ * Get the account descriptor of the specified account id. The account id
+ * must be inside the account table (see #PJSUA_ACC_ID_IS_VALID()).
+ */
+#define PJSUA_ACC(acc_id) \
+	    (&pjsua_var.acc[(acc_id) / PJSUA_ACC_CHUNK_SIZE] \
+			   [(acc_id) % PJSUA_ACC_CHUNK_SIZE])
+
+/**
+ * Check if the account id is inside the account table.
+ */
+#define PJSUA_ACC_ID_IS_VALID(acc_id) \
+	    ((acc_id) >= 0 && (acc_id) < (int)pjsua_var.acc_table_size)
+
+/**
+ * Get the call descriptor of the specified call id. The call id must be
+ * inside the call table (see #PJSUA_CALL_ID_IS_VALID()).
+ */
+#define PJSUA_CALL(call_id) \
+	    (&pjsua_var.calls[(call_id) / PJSUA_CALL_CHUNK_SIZE] \
+			     [(call_id) % PJSUA_CALL_CHUNK_SIZE])
+
+/**
+ * Check if the call id is inside the call table. Call ids which have
+ * never been allocated are outside the table.
+ */
+#define PJSUA_CALL_ID_IS_VALID(call_id) \
+	    ((call_id) >= 0 && (call_id) < (int)pjsua_var.call_table_size)
+
 
 
 /**
@@ -716,6 +783,11 @@ pj_status_t pjsua_im_init(void);
  */
 pj_status_t pjsua_start_mwi(pjsua_acc_id acc_id, pj_bool_t force_renew);
 
+/**
+ * Init account subsystem.
+ */
+pj_status_t pjsua_acc_subsys_init(const pjsua_config *cfg);
+
 /**
  * Init call subsystem.
  */
@@ -726,6 +798,11 @@ pj_status_t pjsua_call_subsys_init(const pjsua_config *cfg);
  */
 pj_status_t pjsua_call_subsys_start(void);
 
+/**
+ * Grow the call table to hold at least the specified number of calls.
+ */
+pj_status_t pjsua_call_grow_table(unsigned count);
+
 /**
  * Init media subsystems.
  */
@@ -170,11 +170,10 @@ struct OnSelectAccountParam
 struct UaConfig : public PersistentObject
 {
     /**
-     * Maximum calls to support (default: 4). The value specified here
-     * must be smaller than the compile time maximum settings
-     * PJSUA_MAX_CALLS, which by default is 32. To increase this
-     * limit, the library must be recompiled with new PJSUA_MAX_CALLS
-     * value.
+     * Maximum calls to support (default: 4). The call table grows on
+     * demand, PJSUA_CALL_CHUNK_SIZE calls at a time, up to this limit,
+     * so memory for the calls is only allocated when they are needed.
+     * The value may be larger than PJSUA_MAX_CALLS.
      */
     unsigned		maxCalls;
 
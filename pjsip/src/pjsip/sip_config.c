@@ -34,7 +34,10 @@ pjsip_cfg_t pjsip_sip_cfg_var =
        PJSIP_FOLLOW_EARLY_MEDIA_FORK,
        PJSIP_REQ_HAS_VIA_ALIAS,
        PJSIP_RESOLVE_HOSTNAME_TO_GET_INTERFACE,
-       0
+       0,
+       PJSIP_LAZY_HDR_PARSING,
+       PJSIP_LAZY_HDR_PARSE_AT_TSX,
+       PJSIP_PRE_ENCODE_HDR
     },
 
     /* Transaction settings */
@@ -659,9 +659,12 @@ PJ_DEF(pj_status_t) pjsip_dlg_fork( const pjsip_dialog *first_dlg,
     dlg->local.first_cseq = first_dlg->local.first_cseq;
     dlg->local.cseq = first_dlg->local.cseq;
 
-    /* Clone local Contact. */
+    /* Clone local Contact. The clone must not share the encoding which
+     * is in the pool of the first dialog, it is encoded again later.
+     */
     dlg->local.contact = (pjsip_contact_hdr*)
     			 pjsip_hdr_clone(dlg->pool, first_dlg->local.contact);
+    pjsip_hdr_clear_encoded((pjsip_hdr*)dlg->local.contact);
 
     /* Clone remote info. */
     dlg->remote.info = (pjsip_fromto_hdr*)
@@ -1046,6 +1049,25 @@ PJ_DEF(void*) pjsip_dlg_get_mod_data( pjsip_dialog *dlg,
  * established). The construction of such requests follows the rule in
  * RFC3261 section 12.2.1.
  */
+/*
+ * Pre-encode the Contact and the route set of the dialog, which are put in
+ * the requests and responses sent by the dialog (see PJSIP_PRE_ENCODE_HDR).
+ * Headers that are already encoded are skipped.
+ */
+static void dlg_pre_encode_hdr(pjsip_dialog *dlg)
+{
+    pjsip_route_hdr *route;
+
+    if (!pjsip_cfg()->endpt.pre_encode_hdr)
+	return;
+
+    pjsip_hdr_set_encoded(dlg->pool, (pjsip_hdr*)dlg->local.contact);
+
+    route = dlg->route_set.next;
+    for (; route != &dlg->route_set; route = route->next)
+	pjsip_hdr_set_encoded(dlg->pool, (pjsip_hdr*)route);
+}
+
 static pj_status_t dlg_create_request_throw( pjsip_dialog *dlg,
 					     const pjsip_method *method,
 					     int cseq,
@@ -1056,6 +1078,8 @@ static pj_status_t dlg_create_request_throw( pjsip_dialog *dlg,
     pjsip_route_hdr *route, *end_list;
     pj_status_t status;
 
+    dlg_pre_encode_hdr(dlg);
+
     /* Contact Header field.
      * Contact can only be present in requests that establish dialog (in the
      * core SIP spec, only INVITE).
@@ -1292,6 +1316,7 @@ static void dlg_beautify_response(pjsip_dialog *dlg,
 	    if (pjsip_msg_find_hdr(tdata->msg, PJSIP_H_CONTACT, NULL) == 0 &&
 		pjsip_msg_find_hdr_by_name(tdata->msg, &HCONTACT, NULL) == 0)
 	    {
+		dlg_pre_encode_hdr(dlg);
 		hdr = (pjsip_hdr*) pjsip_hdr_clone(tdata->pool,
 						   dlg->local.contact);
 		pjsip_msg_add_hdr(tdata->msg, hdr);
@@ -49,6 +49,16 @@ typedef struct exit_cb
 } exit_cb;
 
 
+/**
+ * Event loop of the endpoint.
+ */
+typedef struct endpt_loop
+{
+    pj_ioqueue_t	*ioqueue;
+    pj_timer_heap_t	*timer_heap;
+} endpt_loop;
+
+
 /**
  * The SIP endpoint.
  */
@@ -98,6 +108,18 @@ struct pjsip_endpoint
 
     /** List of exit callback. */
     exit_cb		 exit_cb_list;
+
+    /** Number of received messages being processed. */
+    pj_atomic_t		*rx_pending;
+
+    /** Average time to process received messages, in 1/16 msec. */
+    unsigned		 rx_latency;
+
+    /** Number of event loops. */
+    unsigned		 loop_cnt;
+
+    /** Event loops, the first one is the main loop. */
+    endpt_loop		 loops[PJSIP_MAX_LOOP_CNT];
 };
 
 
@@ -402,11 +424,16 @@ PJ_DEF(pj_status_t) pjsip_endpt_add_capability( pjsip_endpoint *endpt,
     }
 
     /* Add the tags to the header. */
+    pjsip_hdr_clear_encoded((pjsip_hdr*)hdr);
     for (i=0; i<count; ++i) {
 	pj_strdup(endpt->pool, &hdr->values[hdr->count], &tags[i]);
 	++hdr->count;
     }
 
+    /* The header is cloned to many messages, encode it once here */
+    if (pjsip_cfg()->endpt.pre_encode_hdr)
+	pjsip_hdr_set_encoded(endpt->pool, (pjsip_hdr*)hdr);
+
     /* Done. */
     return PJ_SUCCESS;
 }
@@ -485,6 +512,12 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
 	goto on_error;
     }
 
+    /* Create counter of received messages being processed. */
+    status = pj_atomic_create(endpt->pool, 0, &endpt->rx_pending);
+    if (status != PJ_SUCCESS) {
+	goto on_error;
+    }
+
     /* Create timer heap to manage all timers within this endpoint. */
     status = pj_timer_heap_create( endpt->pool, PJSIP_MAX_TIMER_COUNT, 
                                    &endpt->timer_heap);
@@ -509,6 +542,11 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
 	goto on_error;
     }
 
+    /* The main loop. */
+    endpt->loops[0].ioqueue = endpt->ioqueue;
+    endpt->loops[0].timer_heap = endpt->timer_heap;
+    endpt->loop_cnt = 1;
+
     /* Create transport manager. */
     status = pjsip_tpmgr_create( endpt->pool, endpt,
 			         &endpt_on_rx_msg,
@@ -554,6 +592,10 @@ on_error:
 	pj_timer_heap_destroy(endpt->timer_heap);
 	endpt->timer_heap = NULL;
     }
+    if (endpt->rx_pending) {
+	pj_atomic_destroy(endpt->rx_pending);
+	endpt->rx_pending = NULL;
+    }
     if (endpt->mutex) {
 	pj_mutex_destroy(endpt->mutex);
 	endpt->mutex = NULL;
@@ -579,6 +621,9 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
 
     PJ_LOG(5, (THIS_FILE, "Destroying endpoing instance.."));
 
+    /* Stop the receive queue workers before the modules are stopped */
+    pjsip_tpmgr_stop_rx_queue(endpt->transport_mgr);
+
     /* Phase 1: stop all modules */
     mod = endpt->module_list.prev;
     while (mod != &endpt->module_list) {
@@ -603,6 +648,13 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
     /* Shutdown and destroy all transports. */
     pjsip_tpmgr_destroy(endpt->transport_mgr);
 
+    /* Destroy additional event loops */
+    while (endpt->loop_cnt > 1) {
+	endpt_loop *loop = &endpt->loops[--endpt->loop_cnt];
+	pj_ioqueue_destroy(loop->ioqueue);
+	pj_timer_heap_destroy(loop->timer_heap);
+    }
+
     /* Destroy ioqueue */
     pj_ioqueue_destroy(endpt->ioqueue);
 
@@ -622,6 +674,9 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
     /* Delete endpoint mutex. */
     pj_mutex_destroy(endpt->mutex);
 
+    /* Delete receive counter */
+    pj_atomic_destroy(endpt->rx_pending);
+
     /* Deinit parser */
     deinit_sip_parser();
 
@@ -694,22 +749,21 @@ PJ_DEF(void) pjsip_endpt_release_pool( pjsip_endpoint *endpt, pj_pool_t *pool )
 }
 
 
-PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
-					       const pj_time_val *max_timeout,
-					       unsigned *p_count)
+/* Poll the timer heap and ioqueue of an event loop. */
+static pj_status_t poll_loop(endpt_loop *loop,
+			     const pj_time_val *max_timeout,
+			     unsigned *p_count)
 {
     /* timeout is 'out' var. This just to make compiler happy. */
     pj_time_val timeout = { 0, 0};
     unsigned count = 0, net_event_count = 0;
     int c;
 
-    PJ_LOG(6, (THIS_FILE, "pjsip_endpt_handle_events()"));
-
     /* Poll the timer. The timer heap has its own mutex for better 
      * granularity, so we don't need to lock end endpoint. 
      */
     timeout.sec = timeout.msec = 0;
-    c = pj_timer_heap_poll( endpt->timer_heap, &timeout );
+    c = pj_timer_heap_poll( loop->timer_heap, &timeout );
     if (c > 0)
 	count += c;
 
@@ -738,7 +792,7 @@ PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
      *   reported in timely manner.
      */
     do {
-	c = pj_ioqueue_poll( endpt->ioqueue, &timeout);
+	c = pj_ioqueue_poll( loop->ioqueue, &timeout);
 	if (c < 0) {
 	    pj_status_t err = pj_get_netos_error();
 	    pj_thread_sleep(PJ_TIME_VAL_MSEC(timeout));
@@ -760,6 +814,15 @@ PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
     return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
+					       const pj_time_val *max_timeout,
+					       unsigned *p_count)
+{
+    PJ_LOG(6, (THIS_FILE, "pjsip_endpt_handle_events()"));
+
+    return poll_loop(&endpt->loops[0], max_timeout, p_count);
+}
+
 /*
  * Handle events.
  */
@@ -769,6 +832,102 @@ PJ_DEF(pj_status_t) pjsip_endpt_handle_events(pjsip_endpoint *endpt,
     return pjsip_endpt_handle_events2(endpt, max_timeout, NULL);
 }
 
+/*
+ * Create additional event loops.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_create_loops(pjsip_endpoint *endpt,
+					     unsigned loop_cnt)
+{
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(endpt && loop_cnt > 0 && loop_cnt <= PJSIP_MAX_LOOP_CNT,
+		     PJ_EINVAL);
+
+    pj_mutex_lock(endpt->mutex);
+
+    if (endpt->loop_cnt != 1) {
+	pj_mutex_unlock(endpt->mutex);
+	return PJ_EINVALIDOP;
+    }
+
+    while (endpt->loop_cnt < loop_cnt) {
+	endpt_loop *loop = &endpt->loops[endpt->loop_cnt];
+
+	/* The timer heap grows when needed */
+	status = pj_timer_heap_create(endpt->pool, 64, &loop->timer_heap);
+	if (status != PJ_SUCCESS)
+	    break;
+
+	pj_timer_heap_set_max_timed_out_per_poll(loop->timer_heap,
+						 PJSIP_MAX_TIMED_OUT_ENTRIES);
+
+	status = pj_ioqueue_create(endpt->pool, PJSIP_MAX_TRANSPORTS,
+				   &loop->ioqueue);
+	if (status != PJ_SUCCESS) {
+	    pj_timer_heap_destroy(loop->timer_heap);
+	    break;
+	}
+
+	++endpt->loop_cnt;
+    }
+
+    if (status != PJ_SUCCESS) {
+	while (endpt->loop_cnt > 1) {
+	    endpt_loop *loop = &endpt->loops[--endpt->loop_cnt];
+	    pj_ioqueue_destroy(loop->ioqueue);
+	    pj_timer_heap_destroy(loop->timer_heap);
+	}
+    }
+
+    pj_mutex_unlock(endpt->mutex);
+
+    if (status == PJ_SUCCESS) {
+	PJ_LOG(4, (THIS_FILE, "Endpoint has %d event loops", loop_cnt));
+    }
+
+    return status;
+}
+
+/*
+ * Get the number of event loops.
+ */
+PJ_DEF(unsigned) pjsip_endpt_get_loop_count(pjsip_endpoint *endpt)
+{
+    return endpt->loop_cnt;
+}
+
+/*
+ * Get the ioqueue of an event loop.
+ */
+PJ_DEF(pj_ioqueue_t*) pjsip_endpt_get_loop_ioqueue(pjsip_endpoint *endpt,
+						   unsigned loop_idx)
+{
+    return endpt->loops[loop_idx % endpt->loop_cnt].ioqueue;
+}
+
+/*
+ * Get the timer heap of an event loop.
+ */
+PJ_DEF(pj_timer_heap_t*) pjsip_endpt_get_loop_timer_heap(
+						    pjsip_endpoint *endpt,
+						    unsigned loop_idx)
+{
+    return endpt->loops[loop_idx % endpt->loop_cnt].timer_heap;
+}
+
+/*
+ * Handle events of an event loop.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_handle_loop_events(pjsip_endpoint *endpt,
+						   unsigned loop_idx,
+						   const pj_time_val *max_timeout,
+						   unsigned *p_count)
+{
+    PJ_ASSERT_RETURN(endpt && loop_idx < endpt->loop_cnt, PJ_EINVAL);
+
+    return poll_loop(&endpt->loops[loop_idx], max_timeout, p_count);
+}
+
 /*
  * Schedule timer.
  */
@@ -829,6 +988,7 @@ PJ_DEF(pj_status_t) pjsip_endpt_process_rx_data( pjsip_endpoint *endpt,
     pjsip_process_rdata_param def_prm;
     pjsip_module *mod;
     pj_bool_t handled = PJ_FALSE;
+    pj_bool_t lazy_parsed = PJ_FALSE;
     unsigned i;
     pj_status_t status;
 
@@ -879,9 +1039,19 @@ PJ_DEF(pj_status_t) pjsip_endpt_process_rx_data( pjsip_endpoint *endpt,
 	goto on_return;
     }
 
-    /* Distribute */
+    /* Distribute. Headers which were left unparsed (see
+     * PJSIP_LAZY_HDR_PARSING) are parsed before the message reaches the
+     * transaction layer, unless disabled (PJSIP_LAZY_HDR_PARSE_AT_TSX).
+     */
+    if (!pjsip_cfg()->endpt.lazy_hdr_parse_at_tsx)
+	lazy_parsed = PJ_TRUE;
+
     if (msg->type == PJSIP_REQUEST_MSG) {
 	do {
+	    if (!lazy_parsed && mod->priority >= PJSIP_MOD_PRIORITY_TSX_LAYER) {
+		pjsip_msg_parse_lazy_hdrs(msg);
+		lazy_parsed = PJ_TRUE;
+	    }
 	    if (mod->on_rx_request)
 		handled = (*mod->on_rx_request)(rdata);
 	    if (handled)
@@ -890,6 +1060,10 @@ PJ_DEF(pj_status_t) pjsip_endpt_process_rx_data( pjsip_endpoint *endpt,
 	} while (mod != &endpt->module_list);
     } else {
 	do {
+	    if (!lazy_parsed && mod->priority >= PJSIP_MOD_PRIORITY_TSX_LAYER) {
+		pjsip_msg_parse_lazy_hdrs(msg);
+		lazy_parsed = PJ_TRUE;
+	    }
 	    if (mod->on_rx_response)
 		handled = (*mod->on_rx_response)(rdata);
 	    if (handled)
@@ -911,6 +1085,54 @@ on_return:
     return status;
 }
 
+/*
+ * Update the average time to process received messages, measured from
+ * the time the packet was received by the transport.
+ */
+static void update_rx_latency(pjsip_endpoint *endpt,
+			      const pjsip_rx_data *rdata)
+{
+    pj_time_val now;
+    long sample, avg;
+
+    if (rdata->pkt_info.timestamp.sec == 0)
+	return;
+
+    pj_gettimeofday(&now);
+    PJ_TIME_VAL_SUB(now, rdata->pkt_info.timestamp);
+    sample = PJ_TIME_VAL_MSEC(now);
+    if (sample < 0)
+	sample = 0;
+
+    /* Exponential average with 1/8 weight. The average is updated without
+     * lock, losing an update to another thread only makes it slightly off.
+     */
+    avg = (long)endpt->rx_latency;
+    avg += (sample * 16 - avg) / 8;
+    endpt->rx_latency = (unsigned)avg;
+}
+
+/*
+ * Get the load of received message processing.
+ */
+PJ_DEF(void) pjsip_endpt_get_rx_load( pjsip_endpoint *endpt,
+				      pjsip_endpt_rx_load *load)
+{
+    pjsip_rx_queue_stat rxq_stat;
+
+    PJ_ASSERT_ON_FAIL(endpt && load, return);
+
+    load->pending = (unsigned)pj_atomic_get(endpt->rx_pending);
+    load->latency = endpt->rx_latency / 16;
+
+    /* Include messages waiting in the receive queue */
+    if (pjsip_tpmgr_get_rx_queue_stat(endpt->transport_mgr,
+				      &rxq_stat) == PJ_SUCCESS)
+    {
+	load->pending += rxq_stat.len;
+    }
+}
+
 /*
  * This is the callback that is called by the transport manager when it 
  * receives a message from the network.
@@ -1033,7 +1255,11 @@ static void endpt_on_rx_msg( pjsip_endpoint *endpt,
     pjsip_process_rdata_param_default(&proc_prm);
     proc_prm.silent = PJ_TRUE;
 
+    pj_atomic_inc(endpt->rx_pending);
     pjsip_endpt_process_rx_data(endpt, rdata, &proc_prm, &handled);
+    pj_atomic_dec(endpt->rx_pending);
+
+    update_rx_latency(endpt, rdata);
 
     /* No module is able to handle the message */
     if (!handled) {
@@ -149,6 +149,10 @@ pj_bool_t pjsip_use_compact_form = PJSIP_ENCODE_SHORT_HNAME;
 static pj_str_t status_phrase[710];
 static int print_media_type(char *buf, unsigned len,
 			    const pjsip_media_type *media);
+static pjsip_hdr *parse_lazy_hdr(pjsip_hdr *hdr);
+static pjsip_hdr_vptr lazy_hdr_vptr;
+
+#define IS_LAZY_HDR(hdr)    ((hdr)->vptr == &lazy_hdr_vptr)
 
 static int init_status_phrase()
 {
@@ -335,6 +339,15 @@ PJ_DEF(pjsip_msg*) pjsip_msg_clone( pj_pool_t *pool, const pjsip_msg *src)
     return dst;
 }
 
+/* Parse the lazy header found by a lookup. The message is logically
+ * unchanged, only the representation of the header is, so this is done
+ * for the const message of the lookup functions too.
+ */
+static const pjsip_hdr *decode_lazy_hdr(const pjsip_hdr *hdr)
+{
+    return parse_lazy_hdr((pjsip_hdr*)hdr);
+}
+
 PJ_DEF(void*)  pjsip_msg_find_hdr( const pjsip_msg *msg, 
 				   pjsip_hdr_e hdr_type, const void *start)
 {
@@ -344,6 +357,11 @@ PJ_DEF(void*)  pjsip_msg_find_hdr( const pjsip_msg *msg,
 	hdr = msg->hdr.next;
     }
     for (; hdr!=end; hdr = hdr->next) {
+	if (IS_LAZY_HDR(hdr) && hdr_type != PJSIP_H_OTHER &&
+	    ((const pjsip_lazy_hdr*)hdr)->hdr_type == hdr_type)
+	{
+	    hdr = decode_lazy_hdr(hdr);
+	}
 	if (hdr->type == hdr_type)
 	    return (void*)hdr;
     }
@@ -360,8 +378,12 @@ PJ_DEF(void*)  pjsip_msg_find_hdr_by_name( const pjsip_msg *msg,
 	hdr = msg->hdr.next;
     }
     for (; hdr!=end; hdr = hdr->next) {
-	if (pj_stricmp(&hdr->name, name) == 0)
+	/* Lazy header has the name of the header it will be parsed into */
+	if (pj_stricmp(&hdr->name, name) == 0) {
+	    if (IS_LAZY_HDR(hdr))
+		hdr = decode_lazy_hdr(hdr);
 	    return (void*)hdr;
+	}
     }
     return NULL;
 }
@@ -377,10 +399,13 @@ PJ_DEF(void*)  pjsip_msg_find_hdr_by_names( const pjsip_msg *msg,
 	hdr = msg->hdr.next;
     }
     for (; hdr!=end; hdr = hdr->next) {
-	if (pj_stricmp(&hdr->name, name) == 0)
-	    return (void*)hdr;
-	if (pj_stricmp(&hdr->name, sname) == 0)
+	if (pj_stricmp(&hdr->name, name) == 0 ||
+	    pj_stricmp(&hdr->name, sname) == 0)
+	{
+	    if (IS_LAZY_HDR(hdr))
+		hdr = decode_lazy_hdr(hdr);
 	    return (void*)hdr;
+	}
     }
     return NULL;
 }
@@ -395,6 +420,16 @@ PJ_DEF(void*) pjsip_msg_find_remove_hdr( pjsip_msg *msg,
     return hdr;
 }
 
+PJ_DEF(void) pjsip_msg_parse_lazy_hdrs( pjsip_msg *msg )
+{
+    pjsip_hdr *hdr = msg->hdr.next, *end = &msg->hdr;
+
+    for (; hdr!=end; hdr = hdr->next) {
+	if (IS_LAZY_HDR(hdr))
+	    hdr = parse_lazy_hdr(hdr);
+    }
+}
+
 PJ_DEF(pj_ssize_t) pjsip_msg_print( const pjsip_msg *msg, 
 				    char *buf, pj_size_t size)
 {
@@ -581,6 +616,117 @@ PJ_DEF(int) pjsip_hdr_print_on( void *hdr_ptr, char *buf, pj_size_t len)
     return (*hdr->vptr->print_on)(hdr_ptr, buf, len);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Pre-encoded header.
+ *
+ * The header keeps its structure, only the vptr is replaced with one that
+ * is allocated for the header, since it also holds the encoding and the
+ * original vptr of the header. The vptr is never modified once created,
+ * so it is shared by the clones of the header.
+ */
+typedef struct encoded_hdr_vptr
+{
+    pjsip_hdr_vptr   base;	    /* Must be the first member.	*/
+    pjsip_hdr_vptr  *orig_vptr;	    /* Vptr of the header type.		*/
+    pj_bool_t	     compact_form;  /* pjsip_use_compact_form setting.	*/
+    pj_str_t	     enc;	    /* The encoded header.		*/
+} encoded_hdr_vptr;
+
+static void *encoded_hdr_clone(pj_pool_t *pool, const void *hdr);
+static void *encoded_hdr_shallow_clone(pj_pool_t *pool, const void *hdr);
+static int encoded_hdr_print(void *hdr, char *buf, pj_size_t size);
+
+#define IS_ENCODED_HDR(hdr) ((hdr)->vptr->print_on == &encoded_hdr_print)
+#define ENCODED_VPTR(hdr)   ((encoded_hdr_vptr*)((pjsip_hdr*)(hdr))->vptr)
+
+PJ_DEF(pj_status_t) pjsip_hdr_set_encoded(pj_pool_t *pool, pjsip_hdr *hdr)
+{
+    char buf[PJSIP_MAX_URL_SIZE * 2];
+    encoded_hdr_vptr *ev;
+    pj_str_t enc;
+    int len;
+
+    PJ_ASSERT_RETURN(pool && hdr, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!IS_LAZY_HDR(hdr), PJ_EINVALIDOP);
+
+    if (IS_ENCODED_HDR(hdr))
+	return PJ_SUCCESS;
+
+    len = (*hdr->vptr->print_on)(hdr, buf, sizeof(buf));
+    if (len < 0)
+	return PJSIP_EMSGTOOLONG;
+
+    ev = PJ_POOL_ALLOC_T(pool, encoded_hdr_vptr);
+    ev->base.clone = &encoded_hdr_clone;
+    ev->base.shallow_clone = &encoded_hdr_shallow_clone;
+    ev->base.print_on = &encoded_hdr_print;
+    ev->orig_vptr = hdr->vptr;
+    ev->compact_form = pjsip_use_compact_form;
+    pj_strset(&enc, buf, len);
+    pj_strdup(pool, &ev->enc, &enc);
+
+    hdr->vptr = &ev->base;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_bool_t) pjsip_hdr_is_encoded(const pjsip_hdr *hdr)
+{
+    PJ_ASSERT_RETURN(hdr, PJ_FALSE);
+    return IS_ENCODED_HDR(hdr);
+}
+
+PJ_DEF(void) pjsip_hdr_clear_encoded(pjsip_hdr *hdr)
+{
+    PJ_ASSERT_ON_FAIL(hdr, return);
+
+    if (IS_ENCODED_HDR(hdr))
+	hdr->vptr = ENCODED_VPTR(hdr)->orig_vptr;
+}
+
+/* The clone has the same value as the original header, so it shares the
+ * encoding, which lives in the pool of the original header.
+ */
+static void *encoded_hdr_clone(pj_pool_t *pool, const void *rhs)
+{
+    encoded_hdr_vptr *ev = ENCODED_VPTR(rhs);
+    pjsip_hdr *hdr;
+
+    hdr = (pjsip_hdr*) (*ev->orig_vptr->clone)(pool, rhs);
+    hdr->vptr = &ev->base;
+
+    return hdr;
+}
+
+static void *encoded_hdr_shallow_clone(pj_pool_t *pool, const void *rhs)
+{
+    encoded_hdr_vptr *ev = ENCODED_VPTR(rhs);
+    pjsip_hdr *hdr;
+
+    hdr = (pjsip_hdr*) (*ev->orig_vptr->shallow_clone)(pool, rhs);
+    hdr->vptr = &ev->base;
+
+    return hdr;
+}
+
+static int encoded_hdr_print(void *hdr, char *buf, pj_size_t size)
+{
+    const encoded_hdr_vptr *ev = ENCODED_VPTR(hdr);
+
+    /* The header name in the encoding depends on this setting */
+    if (ev->compact_form != pjsip_use_compact_form)
+	return (*ev->orig_vptr->print_on)(hdr, buf, size);
+
+    if ((pj_ssize_t)size <= ev->enc.slen)
+	return -1;
+
+    pj_memcpy(buf, ev->enc.ptr, ev->enc.slen);
+    buf[ev->enc.slen] = '\0';
+
+    return (int)ev->enc.slen;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /*
  * Status/Reason Phrase
@@ -785,6 +931,141 @@ static pjsip_generic_string_hdr* pjsip_generic_string_hdr_shallow_clone( pj_pool
     return hdr;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Lazy header.
+ */
+
+static int pjsip_lazy_hdr_print( pjsip_lazy_hdr *hdr, 
+				 char *buf, pj_size_t size);
+static pjsip_lazy_hdr* pjsip_lazy_hdr_clone( pj_pool_t *pool, 
+					     const pjsip_lazy_hdr *hdr);
+static pjsip_lazy_hdr* pjsip_lazy_hdr_shallow_clone( pj_pool_t *pool,
+						     const pjsip_lazy_hdr *hdr);
+
+static pjsip_hdr_vptr lazy_hdr_vptr = 
+{
+    (pjsip_hdr_clone_fptr) &pjsip_lazy_hdr_clone,
+    (pjsip_hdr_clone_fptr) &pjsip_lazy_hdr_shallow_clone,
+    (pjsip_hdr_print_fptr) &pjsip_lazy_hdr_print,
+};
+
+/*
+ * The name of lazy header is the name that the header will have once
+ * parsed, so that it's found by name like the parsed header, while sname
+ * is the name as it appears in the message, to print the header verbatim.
+ */
+PJ_DEF(pjsip_lazy_hdr*) pjsip_lazy_hdr_create(pj_pool_t *pool,
+					      const pj_str_t *hname,
+					      const pj_str_t *hvalue,
+					      pjsip_hdr_e hdr_type)
+{
+    pjsip_lazy_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_lazy_hdr);
+
+    init_hdr(hdr, PJSIP_H_OTHER, &lazy_hdr_vptr);
+    hdr->name = hdr->sname = *hname;
+    if (hdr_type != PJSIP_H_OTHER) {
+	hdr->name.ptr = pjsip_hdr_names[hdr_type].name;
+	hdr->name.slen = pjsip_hdr_names[hdr_type].name_len;
+    }
+    hdr->hvalue = *hvalue;
+    hdr->hdr_type = hdr_type;
+    hdr->pool = pool;
+
+    return hdr;
+}
+
+PJ_DEF(pj_bool_t) pjsip_hdr_is_lazy(const pjsip_hdr *hdr)
+{
+    return IS_LAZY_HDR(hdr);
+}
+
+PJ_DEF(pjsip_hdr*) pjsip_lazy_hdr_parse(pjsip_lazy_hdr *lhdr)
+{
+    pjsip_hdr *hdr;
+
+    PJ_ASSERT_RETURN(lhdr && IS_LAZY_HDR(lhdr), NULL);
+
+    hdr = parse_lazy_hdr((pjsip_hdr*)lhdr);
+    return hdr == (pjsip_hdr*)lhdr ? NULL : hdr;
+}
+
+/* Parse lazy header and replace it with the parsed header(s) in the list.
+ * Returns the first parsed header, or the header itself (which is turned
+ * into generic string header) if the value can not be parsed.
+ *
+ * The lazy header keeps its next pointer, so that a loop over the header
+ * list which is at the lazy header when it is parsed (e.g. by a lookup in
+ * the loop) continues with the header after it.
+ */
+static pjsip_hdr *parse_lazy_hdr(pjsip_hdr *hdr)
+{
+    pjsip_lazy_hdr *lhdr = (pjsip_lazy_hdr*)hdr;
+    pjsip_hdr *parsed;
+
+    parsed = (pjsip_hdr*) pjsip_parse_hdr(lhdr->pool, &lhdr->name,
+					  lhdr->hvalue.ptr,
+					  lhdr->hvalue.slen, NULL);
+    if (parsed == NULL) {
+	hdr->name = hdr->sname;
+	hdr->vptr = &generic_hdr_vptr;
+	return hdr;
+    }
+
+    pj_list_insert_nodes_before(hdr, parsed);
+    hdr->prev->next = hdr->next;
+    hdr->next->prev = hdr->prev;
+
+    return parsed;
+}
+
+static int pjsip_lazy_hdr_print( pjsip_lazy_hdr *hdr, 
+				 char *buf, pj_size_t size)
+{
+    char *p = buf;
+
+    if ((pj_ssize_t)size < hdr->sname.slen + hdr->hvalue.slen + 5)
+	return -1;
+
+    pj_memcpy(p, hdr->sname.ptr, hdr->sname.slen);
+    p += hdr->sname.slen;
+    *p++ = ':';
+    *p++ = ' ';
+    pj_memcpy(p, hdr->hvalue.ptr, hdr->hvalue.slen);
+    p += hdr->hvalue.slen;
+    *p = '\0';
+
+    return (int)(p - buf);
+}
+
+static pjsip_lazy_hdr* pjsip_lazy_hdr_clone( pj_pool_t *pool, 
+					     const pjsip_lazy_hdr *rhs)
+{
+    pjsip_lazy_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_lazy_hdr);
+
+    pj_memcpy(hdr, rhs, sizeof(*hdr));
+    pj_list_init(hdr);
+    if (rhs->hdr_type == PJSIP_H_OTHER)
+	pj_strdup(pool, &hdr->name, &rhs->name);
+    pj_strdup(pool, &hdr->sname, &rhs->sname);
+    /* The parser needs the character after the value to be writable */
+    pj_strdup_with_null(pool, &hdr->hvalue, &rhs->hvalue);
+    hdr->pool = pool;
+
+    return hdr;
+}
+
+static pjsip_lazy_hdr* pjsip_lazy_hdr_shallow_clone( pj_pool_t *pool,
+						     const pjsip_lazy_hdr *rhs)
+{
+    pjsip_lazy_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_lazy_hdr);
+
+    pj_memcpy(hdr, rhs, sizeof(*hdr));
+    hdr->pool = pool;
+
+    return hdr;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /*
  * Generic pjsip_hdr_names/integer value header.
@@ -0,0 +1,461 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjsip/sip_overload.h>
+#include <pjsip/sip_transaction.h>
+#include <pjsip/sip_util.h>
+#include <pjsip/sip_errno.h>
+#include <pj/assert.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/sock.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"sip_overload.c"
+
+/* The endpoint leaves overload state when all values are below this
+ * fraction (in percent) of their limits.
+ */
+#define LEAVE_PERCENT	75
+
+/* The parts of the 503 response which don't depend on the request. */
+#define STATUS_LINE	"SIP/2.0 503 Service Unavailable\r\n"
+#define TAIL_MAX_LEN	64
+
+
+static pj_status_t mod_ovl_unload(void);
+static pj_bool_t mod_ovl_on_rx_request(pjsip_rx_data *rdata);
+
+static struct mod_overload
+{
+    pjsip_module	     mod;
+    pjsip_endpoint	    *endpt;
+    pj_pool_t		    *pool;
+    pj_mutex_t		    *mutex;
+    pjsip_overload_cfg	     cfg;
+    pj_bool_t		     overloaded;
+    unsigned		     rejected_cnt;
+    unsigned		     overload_cnt;
+    char		     tail[TAIL_MAX_LEN];
+    unsigned		     tail_len;
+} mod_overload =
+{
+    {
+	NULL, NULL,			    /* prev, next.		*/
+	{ "mod-overload", 12 },		    /* Name.			*/
+	-1,				    /* Id			*/
+	PJSIP_MOD_PRIORITY_TSX_LAYER-1,	    /* Priority			*/
+	NULL,				    /* load()			*/
+	NULL,				    /* start()			*/
+	NULL,				    /* stop()			*/
+	&mod_ovl_unload,		    /* unload()			*/
+	&mod_ovl_on_rx_request,		    /* on_rx_request()		*/
+	NULL,				    /* on_rx_response()		*/
+	NULL,				    /* on_tx_request.		*/
+	NULL,				    /* on_tx_response()		*/
+	NULL,				    /* on_tsx_state()		*/
+    }
+};
+
+
+/* Check whether a value has reached its limit, or, if we're already
+ * overloaded, whether it has not dropped enough to leave overload state.
+ */
+static pj_bool_t over_limit(unsigned value, unsigned limit,
+			    pj_bool_t overloaded)
+{
+    if (limit == 0)
+	return PJ_FALSE;
+    if (overloaded)
+	return value * 100 >= limit * LEAVE_PERCENT;
+    return value >= limit;
+}
+
+/* Evaluate the current load against the settings and update the overload
+ * state. The settings and the current state are snapshots taken by the
+ * caller.
+ */
+static pj_bool_t check_overload(const pjsip_overload_cfg *cfg,
+				pj_bool_t overloaded)
+{
+    pjsip_endpt_rx_load load;
+    pj_bool_t result;
+
+    pjsip_endpt_get_rx_load(mod_overload.endpt, &load);
+
+    result = over_limit(load.pending, cfg->max_rx_pending, overloaded) ||
+	     over_limit(load.latency, cfg->max_latency, overloaded);
+
+    /* Counting transactions needs to lock the transaction table, so only
+     * do it when needed.
+     */
+    if (!result && cfg->max_tsx_cnt) {
+	result = over_limit(pjsip_tsx_layer_get_tsx_count(),
+			    cfg->max_tsx_cnt, overloaded);
+    }
+
+    if (result != overloaded) {
+	pj_mutex_lock(mod_overload.mutex);
+	if (mod_overload.overloaded != result) {
+	    mod_overload.overloaded = result;
+	    if (result) {
+		++mod_overload.overload_cnt;
+		PJ_LOG(2,(THIS_FILE, "Endpoint is overloaded (%u pending, "
+			  "%u ms latency), rejecting new requests",
+			  load.pending, load.latency));
+	    } else {
+		PJ_LOG(3,(THIS_FILE, "Endpoint is no longer overloaded"));
+	    }
+	}
+	pj_mutex_unlock(mod_overload.mutex);
+    }
+
+    return result;
+}
+
+/* Pre-encode the Retry-After header and the end of the 503 response for
+ * the current settings. Must be called with the mutex held.
+ */
+static void update_tail(void)
+{
+    int len;
+
+    len = pj_ansi_snprintf(mod_overload.tail, sizeof(mod_overload.tail),
+			   "Retry-After: %u\r\nContent-Length: 0\r\n\r\n",
+			   mod_overload.cfg.retry_after);
+    pj_assert(len > 0 && len < (int)sizeof(mod_overload.tail));
+    mod_overload.tail_len = (unsigned)len;
+}
+
+/* Append the string to the buffer. */
+static char *append_str(char *p, const char *end, const char *str,
+			pj_size_t len)
+{
+    if (!p || end - p < (pj_ssize_t)len)
+	return NULL;
+    pj_memcpy(p, str, len);
+    return p + len;
+}
+
+/* Print the header and CRLF to the buffer. If tag is specified, it is
+ * appended as the tag parameter before the CRLF.
+ */
+static char *append_hdr(char *p, const char *end, const void *hdr,
+			const pj_str_t *tag)
+{
+    int len;
+
+    if (!p || !hdr)
+	return NULL;
+
+    len = pjsip_hdr_print_on((void*)hdr, p, end - p);
+    if (len < 0)
+	return NULL;
+    p += len;
+
+    if (tag) {
+	p = append_str(p, end, ";tag=", 5);
+	p = append_str(p, end, tag->ptr, tag->slen);
+    }
+    return append_str(p, end, "\r\n", 2);
+}
+
+/* Encode the 503 response for the request, by copying the Via, From, To,
+ * Call-ID and CSeq headers of the request between the pre-encoded status
+ * line and tail. The To tag is derived from the Via branch, as
+ * pjsip_endpt_create_response() does. Returns -1 if it doesn't fit.
+ */
+static int encode_response(pjsip_rx_data *rdata, const char *tail,
+			   unsigned tail_len, char *buf, pj_size_t size)
+{
+    pjsip_msg *msg = rdata->msg_info.msg;
+    const char *end = buf + size;
+    const pjsip_hdr *via;
+    char *p;
+
+    p = append_str(buf, end, STATUS_LINE, sizeof(STATUS_LINE)-1);
+
+    via = (const pjsip_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_VIA, NULL);
+    while (via) {
+	p = append_hdr(p, end, via, NULL);
+	via = (const pjsip_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_VIA,
+						    via->next);
+    }
+
+    p = append_hdr(p, end, rdata->msg_info.from, NULL);
+    p = append_hdr(p, end, rdata->msg_info.to,
+		   &rdata->msg_info.via->branch_param);
+    p = append_hdr(p, end, rdata->msg_info.cid, NULL);
+    p = append_hdr(p, end, rdata->msg_info.cseq, NULL);
+    p = append_str(p, end, tail, tail_len);
+
+    return p ? (int)(p - buf) : -1;
+}
+
+/* Send the pre-encoded response from the transport where the request was
+ * received. Returns PJ_ENOTSUP if the destination needs to be resolved
+ * (i.e. the Via has maddr parameter).
+ */
+static pj_status_t send_encoded(pjsip_rx_data *rdata, const char *buf,
+				int len)
+{
+    pjsip_transport *tp = rdata->tp_info.transport;
+    pjsip_response_addr res_addr;
+    pjsip_tpselector sel;
+    pj_sockaddr addr;
+    int addr_len;
+    pj_status_t status;
+
+    status = pjsip_get_response_addr(rdata->tp_info.pool, rdata, &res_addr);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    if (res_addr.transport) {
+	pj_memcpy(&addr, &res_addr.addr, res_addr.addr_len);
+	addr_len = res_addr.addr_len;
+    } else if (rdata->msg_info.via->maddr_param.slen == 0) {
+	/* The host is the received parameter, which is an IP address */
+	status = pj_sockaddr_init(pjsip_transport_type_get_af(
+				      (pjsip_transport_type_e)tp->key.type),
+				  &addr, &res_addr.dst_host.addr.host,
+				  (pj_uint16_t)res_addr.dst_host.addr.port);
+	if (status != PJ_SUCCESS)
+	    return status;
+	addr_len = pj_sockaddr_get_len(&addr);
+    } else {
+	return PJ_ENOTSUP;
+    }
+
+    pj_bzero(&sel, sizeof(sel));
+    sel.type = PJSIP_TPSELECTOR_TRANSPORT;
+    sel.u.transport = tp;
+
+    status = pjsip_endpt_send_raw(mod_overload.endpt,
+				  (pjsip_transport_type_e)tp->key.type, &sel,
+				  buf, len, &addr, addr_len, NULL, NULL);
+    return status == PJ_EPENDING ? PJ_SUCCESS : status;
+}
+
+/* Respond the request with 503 statelessly. The response is normally
+ * encoded directly from the request and the pre-encoded tail and sent as
+ * raw data. Otherwise it is created and sent as a regular response.
+ */
+static void reject_request(pjsip_rx_data *rdata, const char *tail,
+			   unsigned tail_len, unsigned retry_after)
+{
+    char buf[PJSIP_MAX_PKT_LEN];
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+    int len;
+
+    len = encode_response(rdata, tail, tail_len, buf, sizeof(buf));
+    if (len < 0 || send_encoded(rdata, buf, len) != PJ_SUCCESS) {
+	status = pjsip_endpt_create_response(mod_overload.endpt, rdata, 503,
+					     NULL, &tdata);
+	if (status != PJ_SUCCESS)
+	    return;
+
+	pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)
+			  pjsip_retry_after_hdr_create(tdata->pool,
+						       retry_after));
+
+	status = pjsip_endpt_send_response2(mod_overload.endpt, rdata, tdata,
+					    NULL, NULL);
+	if (status != PJ_SUCCESS)
+	    pjsip_tx_data_dec_ref(tdata);
+    }
+
+    pj_mutex_lock(mod_overload.mutex);
+    ++mod_overload.rejected_cnt;
+    pj_mutex_unlock(mod_overload.mutex);
+}
+
+/* Check whether the request creates a dialog. */
+static pj_bool_t is_dialog_creating(const pjsip_method *method)
+{
+    static const pj_str_t STR_SUBSCRIBE = { "SUBSCRIBE", 9 };
+    static const pj_str_t STR_REFER = { "REFER", 5 };
+
+    if (method->id == PJSIP_INVITE_METHOD)
+	return PJ_TRUE;
+    if (method->id != PJSIP_OTHER_METHOD)
+	return PJ_FALSE;
+
+    return pj_strcmp(&method->name, &STR_SUBSCRIBE) == 0 ||
+	   pj_strcmp(&method->name, &STR_REFER) == 0;
+}
+
+/* Callback to be called to handle incoming requests. */
+static pj_bool_t mod_ovl_on_rx_request(pjsip_rx_data *rdata)
+{
+    pjsip_method *method = &rdata->msg_info.msg->line.req.method;
+    pjsip_overload_cfg cfg;
+    pj_bool_t overloaded;
+    char tail[TAIL_MAX_LEN];
+    unsigned tail_len;
+    pj_str_t key;
+
+    /* Let requests which end calls or transactions pass through. */
+    if (method->id == PJSIP_ACK_METHOD ||
+	method->id == PJSIP_CANCEL_METHOD ||
+	method->id == PJSIP_BYE_METHOD)
+    {
+	return PJ_FALSE;
+    }
+
+    /* In-dialog request */
+    if (rdata->msg_info.to->tag.slen != 0)
+	return PJ_FALSE;
+
+    /* The settings may be changed by other thread */
+    pj_mutex_lock(mod_overload.mutex);
+    pj_memcpy(&cfg, &mod_overload.cfg, sizeof(cfg));
+    overloaded = mod_overload.overloaded;
+    tail_len = mod_overload.tail_len;
+    pj_memcpy(tail, mod_overload.tail, tail_len);
+    pj_mutex_unlock(mod_overload.mutex);
+
+    if (!cfg.reject_all && !is_dialog_creating(method))
+	return PJ_FALSE;
+
+    if (!check_overload(&cfg, overloaded))
+	return PJ_FALSE;
+
+    /* Retransmission of a request which already has a transaction */
+    pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAS,
+			 method, rdata);
+    if (pjsip_tsx_layer_find_tsx(&key, PJ_FALSE) != NULL)
+	return PJ_FALSE;
+
+    PJ_LOG(5,(THIS_FILE, "Rejecting %s from %s:%d, endpoint is overloaded",
+	      pjsip_rx_data_get_info(rdata), rdata->pkt_info.src_name,
+	      rdata->pkt_info.src_port));
+
+    reject_request(rdata, tail, tail_len, cfg.retry_after);
+    return PJ_TRUE;
+}
+
+/* Module unloaded by the endpoint. */
+static pj_status_t mod_ovl_unload(void)
+{
+    if (mod_overload.mutex) {
+	pj_mutex_destroy(mod_overload.mutex);
+	mod_overload.mutex = NULL;
+    }
+    if (mod_overload.pool) {
+	pjsip_endpt_release_pool(mod_overload.endpt, mod_overload.pool);
+	mod_overload.pool = NULL;
+    }
+    mod_overload.endpt = NULL;
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(void) pjsip_overload_cfg_default(pjsip_overload_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->max_rx_pending = PJSIP_OVERLOAD_MAX_RX_PENDING;
+    cfg->max_latency = PJSIP_OVERLOAD_MAX_LATENCY;
+    cfg->max_tsx_cnt = PJSIP_OVERLOAD_MAX_TSX_COUNT;
+    cfg->retry_after = PJSIP_OVERLOAD_RETRY_AFTER;
+}
+
+
+PJ_DEF(pj_status_t) pjsip_overload_init_module(pjsip_endpoint *endpt,
+					       const pjsip_overload_cfg *cfg)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt, PJ_EINVAL);
+    PJ_ASSERT_RETURN(mod_overload.endpt == NULL, PJ_EINVALIDOP);
+
+    mod_overload.pool = pjsip_endpt_create_pool(endpt, "overload%p",
+						512, 512);
+    if (!mod_overload.pool)
+	return PJ_ENOMEM;
+
+    mod_overload.endpt = endpt;
+
+    status = pj_mutex_create_simple(mod_overload.pool, "overload%p",
+				    &mod_overload.mutex);
+    if (status != PJ_SUCCESS) {
+	mod_ovl_unload();
+	return status;
+    }
+
+    if (cfg)
+	pj_memcpy(&mod_overload.cfg, cfg, sizeof(*cfg));
+    else
+	pjsip_overload_cfg_default(&mod_overload.cfg);
+
+    mod_overload.overloaded = PJ_FALSE;
+    mod_overload.rejected_cnt = 0;
+    mod_overload.overload_cnt = 0;
+    update_tail();
+
+    status = pjsip_endpt_register_module(endpt, &mod_overload.mod);
+    if (status != PJ_SUCCESS) {
+	mod_ovl_unload();
+	return status;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pjsip_module*) pjsip_overload_instance(void)
+{
+    return &mod_overload.mod;
+}
+
+
+PJ_DEF(pj_status_t) pjsip_overload_set_cfg(const pjsip_overload_cfg *cfg)
+{
+    PJ_ASSERT_RETURN(cfg, PJ_EINVAL);
+    PJ_ASSERT_RETURN(mod_overload.endpt, PJ_EINVALIDOP);
+
+    pj_mutex_lock(mod_overload.mutex);
+    pj_memcpy(&mod_overload.cfg, cfg, sizeof(*cfg));
+    update_tail();
+    pj_mutex_unlock(mod_overload.mutex);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pjsip_overload_get_stat(pjsip_overload_stat *stat)
+{
+    PJ_ASSERT_RETURN(stat, PJ_EINVAL);
+    PJ_ASSERT_RETURN(mod_overload.endpt, PJ_EINVALIDOP);
+
+    pj_bzero(stat, sizeof(*stat));
+
+    pj_mutex_lock(mod_overload.mutex);
+    stat->overloaded = mod_overload.overloaded;
+    stat->rejected_cnt = mod_overload.rejected_cnt;
+    stat->overload_cnt = mod_overload.overload_cnt;
+    pj_mutex_unlock(mod_overload.mutex);
+
+    pjsip_endpt_get_rx_load(mod_overload.endpt, &stat->rx_load);
+    stat->tsx_cnt = pjsip_tsx_layer_get_tsx_count();
+
+    return PJ_SUCCESS;
+}
@@ -24,6 +24,7 @@
 #include <pjsip/sip_auth_parser.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_transport.h>        /* rdata structure */
+#include <pjsip/print_util.h>
 #include <pjlib-util/scanner.h>
 #include <pjlib-util/string.h>
 #include <pj/except.h>
@@ -57,8 +58,6 @@
  */
 #define GENERIC_URI_CHARS   "#?;:@&=+-_.!~*'()%$,/" "%"
 
-#define UNREACHED(expr)
-
 #define IS_NEWLINE(c)	((c)=='\r' || (c)=='\n')
 #define IS_SPACE(c)	((c)==' ' || (c)=='\t')
 
@@ -71,6 +70,22 @@ typedef struct handler_rec
     pj_size_t		  hname_len;
     pj_uint32_t		  hname_hash;
     pjsip_parse_hdr_func *handler;
+
+    /* The name given when the parser was registered, and the type of
+     * the header (PJSIP_H_OTHER for extension headers), used to create
+     * lazy headers.
+     */
+    char		  cname[PJSIP_MAX_HNAME_LEN+1];
+    pj_size_t		  cname_len;
+    pjsip_hdr_e		  hdr_type;
+
+    /* Whether the header may be parsed lazily. */
+    pj_bool_t		  lazy;
+
+    /* Whether the handler reports syntax error to the scanner instead of
+     * throwing exception, as the handlers in this file do.
+     */
+    pj_bool_t		  no_except;
 } handler_rec;
 
 static handler_rec handler[PJSIP_MAX_HEADER_TYPES];
@@ -84,6 +99,7 @@ typedef struct uri_parser_rec
 {
     pj_str_t		     scheme;
     pjsip_parse_uri_func    *parse;
+    pj_bool_t		     no_except;
 } uri_parser_rec;
 
 static uri_parser_rec uri_handler[PJSIP_MAX_URI_TYPES];
@@ -184,6 +200,16 @@ static pjsip_hdr*   parse_hdr_to( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_unsupported( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_via( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_generic_string( pjsip_parse_ctx *ctx);
+static pj_status_t  register_hdr_parser( const char *hname,
+					 const char *hshortname,
+					 pjsip_parse_hdr_func *fptr,
+					 pj_bool_t no_except);
+static pj_status_t  register_uri_parser( char *scheme,
+					 pjsip_parse_uri_func *func,
+					 pj_bool_t no_except);
+static pjsip_hdr*   parse_hdr_lazy( pjsip_parse_ctx *ctx,
+				    const handler_rec *rec,
+				    const pj_str_t *hname );
 
 /* Convert non NULL terminated string to integer. */
 static unsigned long pj_strtoul_mindigit(const pj_str_t *str, 
@@ -395,78 +421,81 @@ static pj_status_t init_parser()
      * Register URI parsers.
      */
 
-    status = pjsip_register_uri_parser("sip", &int_parse_sip_url);
+    status = register_uri_parser("sip", &int_parse_sip_url, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_uri_parser("sips", &int_parse_sip_url);
+    status = register_uri_parser("sips", &int_parse_sip_url, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
     /*
      * Register header parsers.
      */
 
-    status = pjsip_register_hdr_parser( "Accept", NULL, &parse_hdr_accept);
+    status = register_hdr_parser( "Accept", NULL, &parse_hdr_accept, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Allow", NULL, &parse_hdr_allow);
+    status = register_hdr_parser( "Allow", NULL, &parse_hdr_allow, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Call-ID", "i", &parse_hdr_call_id);
+    status = register_hdr_parser( "Call-ID", "i", &parse_hdr_call_id, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Contact", "m", &parse_hdr_contact);
+    status = register_hdr_parser( "Contact", "m", &parse_hdr_contact, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Content-Length", "l", 
-                                        &parse_hdr_content_len);
+    status = register_hdr_parser( "Content-Length", "l", 
+                                  &parse_hdr_content_len, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Content-Type", "c", 
-                                        &parse_hdr_content_type);
+    status = register_hdr_parser( "Content-Type", "c", 
+                                  &parse_hdr_content_type, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "CSeq", NULL, &parse_hdr_cseq);
+    status = register_hdr_parser( "CSeq", NULL, &parse_hdr_cseq, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Expires", NULL, &parse_hdr_expires);
+    status = register_hdr_parser( "Expires", NULL, 
+                                  &parse_hdr_expires, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "From", "f", &parse_hdr_from);
+    status = register_hdr_parser( "From", "f", &parse_hdr_from, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Max-Forwards", NULL, 
-                                        &parse_hdr_max_forwards);
+    status = register_hdr_parser( "Max-Forwards", NULL, 
+                                  &parse_hdr_max_forwards, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Min-Expires", NULL, 
-                                        &parse_hdr_min_expires);
+    status = register_hdr_parser( "Min-Expires", NULL, 
+                                  &parse_hdr_min_expires, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Record-Route", NULL, &parse_hdr_rr);
+    status = register_hdr_parser( "Record-Route", NULL, 
+                                  &parse_hdr_rr, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Route", NULL, &parse_hdr_route);
+    status = register_hdr_parser( "Route", NULL, &parse_hdr_route, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Require", NULL, &parse_hdr_require);
+    status = register_hdr_parser( "Require", NULL, 
+                                  &parse_hdr_require, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Retry-After", NULL, 
-                                        &parse_hdr_retry_after);
+    status = register_hdr_parser( "Retry-After", NULL, 
+                                  &parse_hdr_retry_after, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Supported", "k", 
-                                        &parse_hdr_supported);
+    status = register_hdr_parser( "Supported", "k", 
+                                  &parse_hdr_supported, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "To", "t", &parse_hdr_to);
+    status = register_hdr_parser( "To", "t", &parse_hdr_to, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Unsupported", NULL, 
-                                        &parse_hdr_unsupported);
+    status = register_hdr_parser( "Unsupported", NULL, 
+                                  &parse_hdr_unsupported, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Via", "v", &parse_hdr_via);
+    status = register_hdr_parser( "Via", "v", &parse_hdr_via, PJ_TRUE);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
     /* 
@@ -536,9 +565,49 @@ PJ_INLINE(int) compare_handler( const handler_rec *r1,
     return pj_memcmp(r1->hname, name, name_len);
 }
 
+/* Get the type of header with the specified name, or PJSIP_H_OTHER if it's
+ * not one of the standard headers.
+ */
+static pjsip_hdr_e get_hdr_type(const char *hname)
+{
+    unsigned i;
+
+    for (i=0; i<PJSIP_H_OTHER; ++i) {
+	if (pj_ansi_stricmp(hname, pjsip_hdr_names[i].name) == 0)
+	    return (pjsip_hdr_e)i;
+    }
+    return PJSIP_H_OTHER;
+}
+
+/* Check if header of the specified type may be parsed lazily. The headers
+ * that are put in rdata's msg_info are always parsed.
+ */
+static pj_bool_t is_lazy_type(pjsip_hdr_e hdr_type)
+{
+    switch (hdr_type) {
+    case PJSIP_H_CALL_ID:
+    case PJSIP_H_CONTENT_LENGTH:
+    case PJSIP_H_CONTENT_TYPE:
+    case PJSIP_H_CSEQ:
+    case PJSIP_H_FROM:
+    case PJSIP_H_MAX_FORWARDS:
+    case PJSIP_H_RECORD_ROUTE:
+    case PJSIP_H_REQUIRE:
+    case PJSIP_H_ROUTE:
+    case PJSIP_H_SUPPORTED:
+    case PJSIP_H_TO:
+    case PJSIP_H_VIA:
+	return PJ_FALSE;
+    default:
+	return PJ_TRUE;
+    }
+}
+
 /* Register one handler for one header name. */
 static pj_status_t int_register_parser( const char *name, 
-                                        pjsip_parse_hdr_func *fptr )
+                                        const char *cname,
+                                        pjsip_parse_hdr_func *fptr,
+                                        pj_bool_t no_except )
 {
     unsigned	pos;
     handler_rec rec;
@@ -550,6 +619,12 @@ static pj_status_t int_register_parser( const char *name,
 
     /* Initialize temporary handler. */
     rec.handler = fptr;
+    rec.cname_len = strlen(cname);
+    pj_memcpy(rec.cname, cname, rec.cname_len);
+    rec.cname[rec.cname_len] = '\0';
+    rec.hdr_type = get_hdr_type(cname);
+    rec.lazy = is_lazy_type(rec.hdr_type);
+    rec.no_except = no_except;
     rec.hname_len = strlen(name);
     if (rec.hname_len >= sizeof(rec.hname)) {
 	pj_assert(!"Header name is too long!");
@@ -591,9 +666,10 @@ static pj_status_t int_register_parser( const char *name,
 /* Register parser handler. If both header name and short name are valid,
  * then two instances of handler will be registered.
  */
-PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
-					       const char *hshortname,
-					       pjsip_parse_hdr_func *fptr)
+static pj_status_t register_hdr_parser( const char *hname,
+					const char *hshortname,
+					pjsip_parse_hdr_func *fptr,
+					pj_bool_t no_except)
 {
     unsigned i;
     pj_size_t len;
@@ -608,7 +684,7 @@ PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
     }
 
     /* Register the normal Mixed-Case name */
-    status = int_register_parser(hname, fptr);
+    status = int_register_parser(hname, hname, fptr, no_except);
     if (status != PJ_SUCCESS) {
 	return status;
     }
@@ -620,7 +696,7 @@ PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
     hname_lcase[len] = '\0';
 
     /* Register the lower-case version of the name */
-    status = int_register_parser(hname_lcase, fptr);
+    status = int_register_parser(hname_lcase, hname, fptr, no_except);
     if (status != PJ_SUCCESS) {
 	return status;
     }
@@ -628,17 +704,25 @@ PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
 
     /* Register the shortname version of the name */
     if (hshortname) {
-        status = int_register_parser(hshortname, fptr);
+        status = int_register_parser(hshortname, hname, fptr, no_except);
         if (status != PJ_SUCCESS) 
 	    return status;
     }
     return PJ_SUCCESS;
 }
 
+/* Register parser handler from other modules. */
+PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
+					       const char *hshortname,
+					       pjsip_parse_hdr_func *fptr)
+{
+    return register_hdr_parser(hname, hshortname, fptr, PJ_FALSE);
+}
+
 
 /* Find handler to parse the header name. */
-static pjsip_parse_hdr_func * find_handler_imp(pj_uint32_t  hash, 
-					       const pj_str_t *hname)
+static const handler_rec * find_handler_imp(pj_uint32_t  hash, 
+					    const pj_str_t *hname)
 {
     handler_rec *first;
     int		 comp;
@@ -664,17 +748,17 @@ static pjsip_parse_hdr_func * find_handler_imp(pj_uint32_t  hash,
 	}
     }
 
-    return comp==0 ? first->handler : NULL;
+    return comp==0 ? first : NULL;
 }
 
 
 /* Find handler to parse the header name. */
-static pjsip_parse_hdr_func* find_handler(const pj_str_t *hname)
+static const handler_rec* find_handler(const pj_str_t *hname)
 {
     pj_uint32_t hash;
     char hname_copy[PJSIP_MAX_HNAME_LEN];
     pj_str_t tmp;
-    pjsip_parse_hdr_func *handler;
+    const handler_rec *handler;
 
     if (hname->slen >= PJSIP_MAX_HNAME_LEN) {
 	/* Guaranteed not to be able to find handler. */
@@ -699,30 +783,115 @@ static pjsip_parse_hdr_func* find_handler(const pj_str_t *hname)
 
 
 /* Find URI handler. */
-static pjsip_parse_uri_func* find_uri_handler(const pj_str_t *scheme)
+static const uri_parser_rec* find_uri_handler(const pj_str_t *scheme)
 {
+    static const uri_parser_rec other_uri_handler = 
+    {
+	{ "", 0 }, &int_parse_other_uri, PJ_TRUE
+    };
     unsigned i;
+
     for (i=0; i<uri_handler_count; ++i) {
 	if (parser_stricmp(uri_handler[i].scheme, (*scheme))==0)
-	    return uri_handler[i].parse;
+	    return &uri_handler[i];
     }
-    return &int_parse_other_uri;
+    return &other_uri_handler;
 }
 
 /* Register URI parser. */
-PJ_DEF(pj_status_t) pjsip_register_uri_parser( char *scheme,
-					       pjsip_parse_uri_func *func)
+static pj_status_t register_uri_parser( char *scheme,
+					pjsip_parse_uri_func *func,
+					pj_bool_t no_except)
 {
     if (uri_handler_count >= PJ_ARRAY_SIZE(uri_handler))
 	return PJ_ETOOMANY;
 
     uri_handler[uri_handler_count].scheme = pj_str((char*)scheme);
     uri_handler[uri_handler_count].parse = func;
+    uri_handler[uri_handler_count].no_except = no_except;
     ++uri_handler_count;
 
     return PJ_SUCCESS;
 }
 
+/* Register URI parser from other modules. */
+PJ_DEF(pj_status_t) pjsip_register_uri_parser( char *scheme,
+					       pjsip_parse_uri_func *func)
+{
+    return register_uri_parser(scheme, func, PJ_FALSE);
+}
+
+/* Call header parser. Handlers from other modules report syntax error by
+ * throwing exception, so they are called with exception handler installed
+ * and the exception is converted to scanner error.
+ */
+static pjsip_hdr* call_hdr_parser( const handler_rec *rec,
+				   pjsip_parse_ctx *ctx )
+{
+    pj_scanner *scanner = ctx->scanner;
+    pjsip_hdr *hdr = NULL;
+    int except_id = 0;
+    PJ_USE_EXCEPTION;
+
+    if (rec->no_except || scanner->callback)
+	return (*rec->handler)(ctx);
+
+    scanner->callback = &on_syntax_error;
+    PJ_TRY {
+	hdr = (*rec->handler)(ctx);
+    }
+    PJ_CATCH_ANY {
+	except_id = PJ_GET_EXCEPTION();
+    }
+    PJ_END;
+    scanner->callback = NULL;
+
+    /* Only syntax error is converted, others (e.g. out of memory) are
+     * propagated to the caller.
+     */
+    if (except_id == PJSIP_SYN_ERR_EXCEPTION) {
+	pj_scan_syntax_err(scanner);
+	return NULL;
+    } else if (except_id != 0) {
+	PJ_THROW(except_id);
+    }
+    return hdr;
+}
+
+/* Call URI parser, see call_hdr_parser(). */
+static pjsip_uri* call_uri_parser( const uri_parser_rec *rec,
+				   pj_scanner *scanner, pj_pool_t *pool,
+				   pj_bool_t parse_params )
+{
+    pjsip_uri *uri = NULL;
+    int except_id = 0;
+    PJ_USE_EXCEPTION;
+
+    if (rec->no_except || scanner->callback)
+	return (pjsip_uri*)(*rec->parse)(scanner, pool, parse_params);
+
+    scanner->callback = &on_syntax_error;
+    PJ_TRY {
+	uri = (pjsip_uri*)(*rec->parse)(scanner, pool, parse_params);
+    }
+    PJ_CATCH_ANY {
+	except_id = PJ_GET_EXCEPTION();
+    }
+    PJ_END;
+    scanner->callback = NULL;
+
+    /* Only syntax error is converted, others (e.g. out of memory) are
+     * propagated to the caller.
+     */
+    if (except_id == PJSIP_SYN_ERR_EXCEPTION) {
+	pj_scan_syntax_err(scanner);
+	return NULL;
+    } else if (except_id != 0) {
+	PJ_THROW(except_id);
+    }
+    return uri;
+}
+
 /* Public function to parse SIP message. */
 PJ_DEF(pjsip_msg*) pjsip_parse_msg( pj_pool_t *pool, 
                                     char *buf, pj_size_t size,
@@ -732,8 +901,7 @@ PJ_DEF(pjsip_msg*) pjsip_parse_msg( pj_pool_t *pool,
     pj_scanner scanner;
     pjsip_parse_ctx context;
 
-    pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, 
-                 &on_syntax_error);
+    pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, NULL);
 
     context.scanner = &scanner;
     context.pool = pool;
@@ -752,8 +920,7 @@ PJ_DEF(pjsip_msg *) pjsip_parse_rdata( char *buf, pj_size_t size,
     pj_scanner scanner;
     pjsip_parse_ctx context;
 
-    pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, 
-                 &on_syntax_error);
+    pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, NULL);
 
     context.scanner = &scanner;
     context.pool = rdata->tp_info.pool;
@@ -810,38 +977,31 @@ PJ_DEF(pj_bool_t) pjsip_find_msg( const char *buf, pj_size_t size,
 	{
 	    /* Try to parse the header. */
 	    pj_scanner scanner;
-	    PJ_USE_EXCEPTION;
+	    pj_str_t str_clen;
 
 	    pj_scan_init(&scanner, (char*)line, hdr_end-line, 
-			 PJ_SCAN_AUTOSKIP_WS_HEADER, &on_syntax_error);
-
-	    PJ_TRY {
-		pj_str_t str_clen;
+			 PJ_SCAN_AUTOSKIP_WS_HEADER, NULL);
 
-		/* Get "Content-Length" or "L" name */
-		if (*line=='C' || *line=='c')
-		    pj_scan_advance_n(&scanner, 14, PJ_TRUE);
-		else if (*line=='l' || *line=='L')
-		    pj_scan_advance_n(&scanner, 1, PJ_TRUE);
+	    /* Get "Content-Length" or "L" name */
+	    if (*line=='C' || *line=='c')
+		pj_scan_advance_n(&scanner, 14, PJ_TRUE);
+	    else if (*line=='l' || *line=='L')
+		pj_scan_advance_n(&scanner, 1, PJ_TRUE);
 
-		/* Get colon */
-		if (pj_scan_get_char(&scanner) != ':') {
-		    PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-		}
+	    /* Get colon */
+	    if (pj_scan_get_char(&scanner) != ':') {
+		pj_scan_syntax_err(&scanner);
+	    }
 
-		/* Get number */
-		pj_scan_get(&scanner, &pconst.pjsip_DIGIT_SPEC, &str_clen);
+	    /* Get number */
+	    pj_scan_get(&scanner, &pconst.pjsip_DIGIT_SPEC, &str_clen);
 
-		/* Get newline. */
-		pj_scan_get_newline(&scanner);
+	    /* Get newline. */
+	    pj_scan_get_newline(&scanner);
 
-		/* Found a valid Content-Length header. */
+	    /* Found a valid Content-Length header? */
+	    if (!pj_scan_has_err(&scanner))
 		content_length = pj_strtoul(&str_clen);
-	    }
-	    PJ_CATCH_ANY {
-		content_length = -1;
-	    }
-	    PJ_END
 
 	    pj_scan_fini(&scanner);
 	}
@@ -879,18 +1039,12 @@ PJ_DEF(pjsip_uri*) pjsip_parse_uri( pj_pool_t *pool,
 {
     pj_scanner scanner;
     pjsip_uri *uri = NULL;
-    PJ_USE_EXCEPTION;
 
-    pj_scan_init(&scanner, buf, size, 0, &on_syntax_error);
+    pj_scan_init(&scanner, buf, size, 0, NULL);
 
-    
-    PJ_TRY {
-	uri = int_parse_uri_or_name_addr(&scanner, pool, option);
-    }
-    PJ_CATCH_ANY {
+    uri = int_parse_uri_or_name_addr(&scanner, pool, option);
+    if (pj_scan_has_err(&scanner))
 	uri = NULL;
-    }
-    PJ_END;
 
     /* Must have exhausted all inputs. */
     if (pj_scan_is_eof(&scanner) || IS_NEWLINE(*scanner.curptr)) {
@@ -913,10 +1067,10 @@ static void parse_sip_version(pj_scanner *scanner)
 
     pj_scan_get( scanner, &pconst.pjsip_ALPHA_SPEC, &sip);
     if (pj_scan_get_char(scanner) != '/')
-	on_syntax_error(scanner);
+	pj_scan_syntax_err(scanner);
     pj_scan_get_n( scanner, 3, &version);
     if (pj_stricmp(&sip, &SIP) || pj_stricmp(&version, &V2))
-	on_syntax_error(scanner);
+	pj_scan_syntax_err(scanner);
 }
 
 static pj_bool_t is_next_sip_version(pj_scanner *scanner)
@@ -934,192 +1088,199 @@ static pj_bool_t is_next_sip_version(pj_scanner *scanner)
     return c && (c=='/' || c==' ' || c=='\t') && pj_stricmp(&sip, &SIP)==0;
 }
 
-/* Internal function to parse SIP message */
+/* Add syntax error that was recorded by the scanner to the error list. */
+static void report_syntax_err( pj_scanner *scanner, pj_pool_t *pool,
+			       pjsip_parser_err_report *err_list,
+			       const pj_str_t *hname )
+{
+    pjsip_parser_err_report *err_info;
+
+    if (!err_list)
+	return;
+
+    err_info = PJ_POOL_ALLOC_T(pool, pjsip_parser_err_report);
+    err_info->except_code = PJSIP_SYN_ERR_EXCEPTION;
+    err_info->line = scanner->line;
+    /* Scanner's column is zero based, so add 1 */
+    err_info->col = pj_scan_get_col(scanner) + 1;
+    err_info->hname = *hname;
+
+    pj_list_insert_before(err_list, err_info);
+}
+
+/* Skip the rest of the header after syntax error was recorded by the
+ * scanner. Returns PJ_TRUE if there are more headers to be parsed.
+ */
+static pj_bool_t skip_invalid_hdr( pj_scanner *scanner )
+{
+    if (!pj_scan_is_eof(scanner)) {
+	/* Skip until next line.
+	 * Watch for header continuation.
+	 */
+	do {
+	    pj_scan_skip_line(scanner);
+	} while (IS_SPACE(*scanner->curptr));
+    }
+
+    /* Restore flag. Flag may be set in int_parse_sip_url() */
+    scanner->skip_ws = PJ_SCAN_AUTOSKIP_WS_HEADER;
+
+    return !pj_scan_is_eof(scanner) && !IS_NEWLINE(*scanner->curptr);
+}
+
+/* Internal function to parse SIP message. The scanner must have been
+ * initialized without syntax error callback, so that syntax errors are
+ * recorded in the scanner instead of being thrown as exception.
+ */
 static pjsip_msg *int_parse_msg( pjsip_parse_ctx *ctx,
 				 pjsip_parser_err_report *err_list)
 {
-    pj_bool_t parsing_headers;
     pjsip_msg *msg = NULL;
     pj_str_t hname;
     pjsip_ctype_hdr *ctype_hdr = NULL;
     pj_scanner *scanner = ctx->scanner;
     pj_pool_t *pool = ctx->pool;
-    PJ_USE_EXCEPTION;
+    pj_bool_t lazy;
 
-    parsing_headers = PJ_FALSE;
+    /* Only received messages are parsed lazily */
+    lazy = (ctx->rdata && pjsip_cfg()->endpt.lazy_hdr_parsing);
 
-retry_parse:
-    PJ_TRY 
-    {
-	if (parsing_headers)
-	    goto parse_headers;
+    /* Skip leading newlines. */
+    while (IS_NEWLINE(*scanner->curptr)) {
+	pj_scan_get_newline(scanner);
+    }
 
-	/* Skip leading newlines. */
-	while (IS_NEWLINE(*scanner->curptr)) {
-	    pj_scan_get_newline(scanner);
-	}
+    /* Check if we still have valid packet.
+     * Sometimes endpoints just send blank (CRLF) packets just to keep
+     * NAT bindings open.
+     */
+    if (pj_scan_is_eof(scanner))
+	return NULL;
 
-	/* Check if we still have valid packet.
-	 * Sometimes endpoints just send blank (CRLF) packets just to keep
-	 * NAT bindings open.
-	 */
-	if (pj_scan_is_eof(scanner))
-	    return NULL;
+    /* Parse request or status line */
+    if (is_next_sip_version(scanner)) {
+	msg = pjsip_msg_create(pool, PJSIP_RESPONSE_MSG);
+	int_parse_status_line( scanner, &msg->line.status );
+    } else {
+	msg = pjsip_msg_create(pool, PJSIP_REQUEST_MSG);
+	int_parse_req_line(scanner, pool, &msg->line.req );
+    }
 
-	/* Parse request or status line */
-	if (is_next_sip_version(scanner)) {
-	    msg = pjsip_msg_create(pool, PJSIP_RESPONSE_MSG);
-	    int_parse_status_line( scanner, &msg->line.status );
-	} else {
-	    msg = pjsip_msg_create(pool, PJSIP_REQUEST_MSG);
-	    int_parse_req_line(scanner, pool, &msg->line.req );
-	}
+    if (pj_scan_has_err(scanner)) {
+	pj_str_t line_name;
 
-	parsing_headers = PJ_TRUE;
+	if (msg->type == PJSIP_REQUEST_MSG)
+	    line_name = pj_str("Request Line");
+	else
+	    line_name = pj_str("Status Line");
 
-parse_headers:
-	/* Parse headers. */
-	do {
-	    pjsip_parse_hdr_func * handler;
-	    pjsip_hdr *hdr = NULL;
+	pj_scan_clear_err(scanner);
+	report_syntax_err(scanner, pool, err_list, &line_name);
+	return NULL;
+    }
 
-	    /* Init hname just in case parsing fails.
-	     * Ref: PROTOS #2412
-	     */
-	    hname.slen = 0;
-	    
-	    /* Get hname. */
-	    pj_scan_get( scanner, &pconst.pjsip_TOKEN_SPEC, &hname);
-	    if (pj_scan_get_char( scanner ) != ':') {
-		PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-	    }
-	    
+    /* Parse headers. */
+    do {
+	const handler_rec * handler;
+	pjsip_hdr *hdr = NULL;
+
+	/* Get hname. */
+	pj_scan_get( scanner, &pconst.pjsip_TOKEN_SPEC, &hname);
+	if (pj_scan_get_char( scanner ) != ':') {
+	    pj_scan_syntax_err(scanner);
+	}
+
+	if (!pj_scan_has_err(scanner)) {
 	    /* Find handler. */
 	    handler = find_handler(&hname);
-	    
-	    /* Call the handler if found.
+
+	    /* Call the handler if found, or only get the header value
+	     * when the header is to be parsed lazily.
 	     * If no handler is found, then treat the header as generic
 	     * hname/hvalue pair.
 	     */
-	    if (handler) {
-		hdr = (*handler)(ctx);
-
-		/* Note:
-		 *  hdr MAY BE NULL, if parsing does not yield a new header
-		 *  instance, e.g. the values have been added to existing
-		 *  header. See http://trac.pjsip.org/repos/ticket/940
-		 */
-
-		/* Check if we've just parsed a Content-Type header. 
-		 * We will check for a message body if we've got Content-Type 
-		 * header.
-		 */
-		if (hdr && hdr->type == PJSIP_H_CONTENT_TYPE) {
-		    ctype_hdr = (pjsip_ctype_hdr*)hdr;
-		}
-
+	    if (handler && lazy && handler->lazy) {
+		hdr = parse_hdr_lazy(ctx, handler, &hname);
+	    } else if (handler) {
+		hdr = call_hdr_parser(handler, ctx);
 	    } else {
 		hdr = parse_hdr_generic_string(ctx);
 		hdr->name = hdr->sname = hname;
 	    }
-	    
-	
-	    /* Single parse of header line can produce multiple headers.
-	     * For example, if one Contact: header contains Contact list
-	     * separated by comma, then these Contacts will be split into
-	     * different Contact headers.
-	     * So here we must insert list instead of just insert one header.
-	     */
-	    if (hdr)
-		pj_list_insert_nodes_before(&msg->hdr, hdr);
-	    
-	    /* Parse until EOF or an empty line is found. */
-	} while (!pj_scan_is_eof(scanner) && !IS_NEWLINE(*scanner->curptr));
-	
-	parsing_headers = PJ_FALSE;
-
-	/* If empty line is found, eat it. */
-	if (!pj_scan_is_eof(scanner)) {
-	    if (IS_NEWLINE(*scanner->curptr)) {
-		pj_scan_get_newline(scanner);
-	    }
 	}
 
-	/* If we have Content-Type header, treat the rest of the message 
-	 * as body.
-	 */
-	if (ctype_hdr && scanner->curptr!=scanner->end) {
-	    /* New: if Content-Type indicates that this is a multipart
-	     * message body, parse it.
-	     */
-	    const pj_str_t STR_MULTIPART = { "multipart", 9 };
-	    pjsip_msg_body *body;
+	if (pj_scan_has_err(scanner)) {
+	    /* Skip the header, and parse next header if any. */
+	    pj_scan_clear_err(scanner);
+	    report_syntax_err(scanner, pool, err_list, &hname);
 
-	    if (pj_stricmp(&ctype_hdr->media.type, &STR_MULTIPART)==0) {
-		body = pjsip_multipart_parse(pool, scanner->curptr,
-					     scanner->end - scanner->curptr,
-					     &ctype_hdr->media, 0);
-	    } else {
-		body = PJ_POOL_ALLOC_T(pool, pjsip_msg_body);
-		pjsip_media_type_cp(pool, &body->content_type,
-		                    &ctype_hdr->media);
-
-		body->data = scanner->curptr;
-		body->len = (unsigned)(scanner->end - scanner->curptr);
-		body->print_body = &pjsip_print_text_body;
-		body->clone_data = &pjsip_clone_text_data;
-	    }
+	    if (skip_invalid_hdr(scanner))
+		continue;
 
-	    msg->body = body;
+	    return NULL;
 	}
-    }
-    PJ_CATCH_ANY 
-    {
-	/* Exception was thrown during parsing. 
-	 * Skip until newline, and parse next header. 
+
+	/* Note:
+	 *  hdr MAY BE NULL, if parsing does not yield a new header
+	 *  instance, e.g. the values have been added to existing
+	 *  header. See http://trac.pjsip.org/repos/ticket/940
 	 */
-	if (err_list) {
-	    pjsip_parser_err_report *err_info;
-	    
-	    err_info = PJ_POOL_ALLOC_T(pool, pjsip_parser_err_report);
-	    err_info->except_code = PJ_GET_EXCEPTION();
-	    err_info->line = scanner->line;
-	    /* Scanner's column is zero based, so add 1 */
-	    err_info->col = pj_scan_get_col(scanner) + 1;
-	    if (parsing_headers)
-		err_info->hname = hname;
-	    else if (msg && msg->type == PJSIP_REQUEST_MSG)
-		err_info->hname = pj_str("Request Line");
-	    else if (msg && msg->type == PJSIP_RESPONSE_MSG)
-		err_info->hname = pj_str("Status Line");
-	    else
-		err_info->hname.slen = 0;
-	    
-	    pj_list_insert_before(err_list, err_info);
+	if (!hdr)
+	    continue;
+
+	/* Check if we've just parsed a Content-Type header. 
+	 * We will check for a message body if we've got Content-Type 
+	 * header.
+	 */
+	if (hdr->type == PJSIP_H_CONTENT_TYPE) {
+	    ctype_hdr = (pjsip_ctype_hdr*)hdr;
 	}
+
+	/* Single parse of header line can produce multiple headers.
+	 * For example, if one Contact: header contains Contact list
+	 * separated by comma, then these Contacts will be split into
+	 * different Contact headers.
+	 * So here we must insert list instead of just insert one header.
+	 */
+	pj_list_insert_nodes_before(&msg->hdr, hdr);
 	
-	if (parsing_headers) {
-	    if (!pj_scan_is_eof(scanner)) {
-		/* Skip until next line.
-		 * Watch for header continuation.
-		 */
-		do {
-		    pj_scan_skip_line(scanner);
-		} while (IS_SPACE(*scanner->curptr));
-	    }
+	/* Parse until EOF or an empty line is found. */
+    } while (!pj_scan_is_eof(scanner) && !IS_NEWLINE(*scanner->curptr));
+	
+    /* If empty line is found, eat it. */
+    if (!pj_scan_is_eof(scanner)) {
+	if (IS_NEWLINE(*scanner->curptr)) {
+	    pj_scan_get_newline(scanner);
+	}
+    }
 
-	    /* Restore flag. Flag may be set in int_parse_sip_url() */
-	    scanner->skip_ws = PJ_SCAN_AUTOSKIP_WS_HEADER;
+    /* If we have Content-Type header, treat the rest of the message 
+     * as body.
+     */
+    if (ctype_hdr && scanner->curptr!=scanner->end) {
+	/* New: if Content-Type indicates that this is a multipart
+	 * message body, parse it.
+	 */
+	const pj_str_t STR_MULTIPART = { "multipart", 9 };
+	pjsip_msg_body *body;
 
-	    /* Continue parse next header, if any. */
-	    if (!pj_scan_is_eof(scanner) && !IS_NEWLINE(*scanner->curptr)) {
-		goto retry_parse;
-	    }
+	if (pj_stricmp(&ctype_hdr->media.type, &STR_MULTIPART)==0) {
+	    body = pjsip_multipart_parse(pool, scanner->curptr,
+					 scanner->end - scanner->curptr,
+					 &ctype_hdr->media, 0);
+	} else {
+	    body = PJ_POOL_ALLOC_T(pool, pjsip_msg_body);
+	    pjsip_media_type_cp(pool, &body->content_type,
+				&ctype_hdr->media);
+
+	    body->data = scanner->curptr;
+	    body->len = (unsigned)(scanner->end - scanner->curptr);
+	    body->print_body = &pjsip_print_text_body;
+	    body->clone_data = &pjsip_clone_text_data;
 	}
 
-	msg = NULL;
+	msg->body = body;
     }
-    PJ_END;
 
     return msg;
 }
@@ -1145,7 +1306,9 @@ static void parse_param_imp( pj_scanner *scanner, pj_pool_t *pool,
 	    /* pvalue can be a quoted string. */
 	    if (*scanner->curptr == '"') {
 		pj_scan_get_quote( scanner, '"', '"', pvalue);
-		if (option & PJSIP_PARSE_REMOVE_QUOTE) {
+		if ((option & PJSIP_PARSE_REMOVE_QUOTE) &&
+		    !pj_scan_has_err(scanner))
+		{
 		    pvalue->ptr++;
 		    pvalue->slen -= 2;
 		}
@@ -1326,16 +1489,10 @@ static pjsip_uri *int_parse_uri_or_name_addr( pj_scanner *scanner, pj_pool_t *po
 	next_ch = pj_scan_peek( scanner, &pconst.pjsip_DISPLAY_SPEC, &scheme);
 
 	if (next_ch==':') {
-	    pjsip_parse_uri_func *func = find_uri_handler(&scheme);
-
-	    if (func == NULL) {
-		/* Unsupported URI scheme */
-		PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-	    }
+	    const uri_parser_rec *rec = find_uri_handler(&scheme);
 
-	    uri = (pjsip_uri*)
-	    	  (*func)(scanner, pool, 
-			  (opt & PJSIP_PARSE_URI_IN_FROM_TO_HDR)==0);
+	    uri = call_uri_parser(rec, scanner, pool, 
+				  (opt & PJSIP_PARSE_URI_IN_FROM_TO_HDR)==0);
 
 
 	} else {
@@ -1373,23 +1530,16 @@ static pjsip_uri *int_parse_uri(pj_scanner *scanner, pj_pool_t *pool,
     */
 	pj_str_t scheme;
 	int colon;
-	pjsip_parse_uri_func *func;
 
 	/* Get scheme. */
 	colon = pj_scan_peek(scanner, &pconst.pjsip_TOKEN_SPEC, &scheme);
 	if (colon != ':') {
-	    PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+	    pj_scan_syntax_err(scanner);
+	    return NULL;
 	}
 
-	func = find_uri_handler(&scheme);
-	if (func)  {
-	    return (pjsip_uri*)(*func)(scanner, pool, parse_params);
-
-	} else {
-	    /* Unsupported URI scheme */
-	    PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-	    UNREACHED({ return NULL; /* Not reached. */ })
-	}
+	return call_uri_parser(find_uri_handler(&scheme), scanner, pool,
+			       parse_params);
 
     /*
     }
@@ -1412,7 +1562,9 @@ static void* int_parse_sip_url( pj_scanner *scanner,
     pj_scan_get(scanner, &pconst.pjsip_TOKEN_SPEC, &scheme);
     colon = pj_scan_get_char(scanner);
     if (colon != ':') {
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+	pj_scan_syntax_err(scanner);
+	scanner->skip_ws = skip_ws;
+	return NULL;
     }
 
     if (parser_stricmp(scheme, pconst.pjsip_SIP_STR)==0) {
@@ -1422,12 +1574,9 @@ static void* int_parse_sip_url( pj_scanner *scanner,
 	url = pjsip_sip_uri_create(pool, 1);
 
     } else {
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-	/* should not reach here */
-	UNREACHED({
-	    pj_assert(0);
-	    return 0;
-	})
+	pj_scan_syntax_err(scanner);
+	scanner->skip_ws = skip_ws;
+	return NULL;
     }
 
     if (int_is_next_user(scanner)) {
@@ -1497,6 +1646,9 @@ static pjsip_name_addr *int_parse_name_addr( pj_scanner *scanner,
 
     if (*scanner->curptr == '"') {
 	pj_scan_get_quote( scanner, '"', '"', &name_addr->display);
+	if (pj_scan_has_err(scanner))
+	    return name_addr;
+
 	/* Trim the leading and ending quote */
 	name_addr->display.ptr++;
 	name_addr->display.slen -= 2;
@@ -1530,12 +1682,13 @@ static pjsip_name_addr *int_parse_name_addr( pj_scanner *scanner,
 	 * Allowing (invalid) name-addr to pass URI verification will
 	 * cause us to send invalid URI to the wire.
 	 */
-	PJ_THROW( PJSIP_SYN_ERR_EXCEPTION);
+	pj_scan_syntax_err(scanner);
+	return name_addr;
     }
     name_addr->uri = int_parse_uri( scanner, pool, PJ_TRUE );
     if (has_bracket) {
 	if (pj_scan_get_char(scanner) != '>')
-	    PJ_THROW( PJSIP_SYN_ERR_EXCEPTION);
+	    pj_scan_syntax_err(scanner);
     }
 
     return name_addr;
@@ -1559,7 +1712,7 @@ static void* int_parse_other_uri(pj_scanner *scanner,
     
     pj_scan_get(scanner, &pc->pjsip_TOKEN_SPEC, &uri->scheme);
     if (pj_scan_get_char(scanner) != ':') {
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+	pj_scan_syntax_err(scanner);
     }
     
     pj_scan_get(scanner, &pc->pjsip_OTHER_URI_CONTENT, &uri->content);
@@ -1607,23 +1760,18 @@ PJ_DEF(pj_status_t) pjsip_parse_status_line( char *buf, pj_size_t size,
 					     pjsip_status_line *status_line)
 {
     pj_scanner scanner;
-    PJ_USE_EXCEPTION;
 
     pj_bzero(status_line, sizeof(*status_line));
-    pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, 
-		 &on_syntax_error);
+    pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, NULL);
 
-    PJ_TRY {
-	int_parse_status_line(&scanner, status_line);
-    } 
-    PJ_CATCH_ANY {
+    int_parse_status_line(&scanner, status_line);
+    if (pj_scan_has_err(&scanner)) {
 	/* Tolerate the error if it is caused only by missing newline */
 	if (status_line->code == 0 && status_line->reason.slen == 0) {
 	    pj_scan_fini(&scanner);
 	    return PJSIP_EINVALIDMSG;
 	}
     }
-    PJ_END;
 
     pj_scan_fini(&scanner);
     return PJ_SUCCESS;
@@ -1663,7 +1811,7 @@ static void parse_generic_array_hdr( pjsip_generic_array_hdr *hdr,
 
     if (hdr->count >= PJ_ARRAY_SIZE(hdr->values)) {
 	/* Too many elements */
-	on_syntax_error(scanner);
+	pj_scan_syntax_err(scanner);
 	return;
     }
 
@@ -1759,7 +1907,7 @@ static pjsip_hdr* parse_hdr_call_id(pjsip_parse_ctx *ctx)
     pj_scan_get( ctx->scanner, &pconst.pjsip_NOT_NEWLINE, &hdr->id);
     parse_hdr_end(ctx->scanner);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !pj_scan_has_err(ctx->scanner))
         ctx->rdata->msg_info.cid = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1849,7 +1997,7 @@ static pjsip_hdr* parse_hdr_content_len( pjsip_parse_ctx *ctx )
     hdr->len = pj_strtoul(&digit);
     parse_hdr_end(ctx->scanner);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !pj_scan_has_err(ctx->scanner))
         ctx->rdata->msg_info.clen = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1877,7 +2025,7 @@ static pjsip_hdr* parse_hdr_content_type( pjsip_parse_ctx *ctx )
 
     parse_hdr_end(ctx->scanner);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !pj_scan_has_err(ctx->scanner))
         ctx->rdata->msg_info.ctype = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1898,7 +2046,7 @@ static pjsip_hdr* parse_hdr_cseq( pjsip_parse_ctx *ctx )
 
     parse_hdr_end( ctx->scanner );
 
-    if (ctx->rdata)
+    if (ctx->rdata && !pj_scan_has_err(ctx->scanner))
         ctx->rdata->msg_info.cseq = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1945,7 +2093,7 @@ static pjsip_hdr* parse_hdr_from( pjsip_parse_ctx *ctx )
 {
     pjsip_from_hdr *hdr = pjsip_from_hdr_create(ctx->pool);
     parse_hdr_fromto(ctx->scanner, ctx->pool, hdr);
-    if (ctx->rdata)
+    if (ctx->rdata && !pj_scan_has_err(ctx->scanner))
         ctx->rdata->msg_info.from = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1988,6 +2136,9 @@ static pjsip_hdr* parse_hdr_retry_after(pjsip_parse_ctx *ctx)
     {
 	if (*scanner->curptr=='(') {
 	    pj_scan_get_quote(scanner, '(', ')', &hdr->comment);
+	    if (pj_scan_has_err(scanner))
+		break;
+
 	    /* Trim the leading and ending parens */
 	    hdr->comment.ptr++;
 	    hdr->comment.slen -= 2;
@@ -1995,6 +2146,9 @@ static pjsip_hdr* parse_hdr_retry_after(pjsip_parse_ctx *ctx)
 	    pjsip_param *prm = PJ_POOL_ALLOC_T(ctx->pool, pjsip_param);
 	    int_parse_param(scanner, ctx->pool, &prm->name, &prm->value, 0);
 	    pj_list_push_back(&hdr->param, prm);
+	} else {
+	    /* Would otherwise loop forever */
+	    pj_scan_syntax_err(scanner);
 	}
     }
 
@@ -2027,7 +2181,7 @@ static pjsip_hdr* parse_hdr_to( pjsip_parse_ctx *ctx )
     pjsip_to_hdr *hdr = pjsip_to_hdr_create(ctx->pool);
     parse_hdr_fromto(ctx->scanner, ctx->pool, hdr);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !pj_scan_has_err(ctx->scanner))
         ctx->rdata->msg_info.to = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -2097,7 +2251,7 @@ static pjsip_hdr* parse_hdr_max_forwards( pjsip_parse_ctx *ctx )
     hdr = pjsip_max_fwd_hdr_create(ctx->pool, 0);
     parse_generic_int_hdr(hdr, ctx->scanner);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !pj_scan_has_err(ctx->scanner))
         ctx->rdata->msg_info.max_fwd = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -2150,7 +2304,8 @@ static pjsip_hdr* parse_hdr_rr( pjsip_parse_ctx *ctx)
     } while (1);
     parse_hdr_end(scanner);
 
-    if (ctx->rdata && ctx->rdata->msg_info.record_route==NULL)
+    if (ctx->rdata && ctx->rdata->msg_info.record_route==NULL &&
+	!pj_scan_has_err(scanner))
         ctx->rdata->msg_info.record_route = first;
 
     return (pjsip_hdr*)first;
@@ -2178,7 +2333,8 @@ static pjsip_hdr* parse_hdr_route( pjsip_parse_ctx *ctx )
     } while (1);
     parse_hdr_end(scanner);
 
-    if (ctx->rdata && ctx->rdata->msg_info.route==NULL)
+    if (ctx->rdata && ctx->rdata->msg_info.route==NULL &&
+	!pj_scan_has_err(scanner))
         ctx->rdata->msg_info.route = first;
 
     return (pjsip_hdr*)first;
@@ -2199,7 +2355,7 @@ static pjsip_hdr* parse_hdr_via( pjsip_parse_ctx *ctx )
 
 	parse_sip_version(scanner);
 	if (pj_scan_get_char(scanner) != '/')
-	    on_syntax_error(scanner);
+	    pj_scan_syntax_err(scanner);
 
 	pj_scan_get( scanner, &pconst.pjsip_TOKEN_SPEC, &hdr->transport);
 	int_parse_host(scanner, &hdr->sent_by.host);
@@ -2228,7 +2384,8 @@ static pjsip_hdr* parse_hdr_via( pjsip_parse_ctx *ctx )
 
     parse_hdr_end(scanner);
 
-    if (ctx->rdata && ctx->rdata->msg_info.via == NULL)
+    if (ctx->rdata && ctx->rdata->msg_info.via == NULL &&
+	!pj_scan_has_err(scanner))
         ctx->rdata->msg_info.via = first;
 
     return (pjsip_hdr*)first;
@@ -2245,6 +2402,33 @@ static pjsip_hdr* parse_hdr_generic_string( pjsip_parse_ctx *ctx )
 
 }
 
+/* Get the value of header to be parsed lazily. */
+static pjsip_hdr* parse_hdr_lazy( pjsip_parse_ctx *ctx,
+				  const handler_rec *rec,
+				  const pj_str_t *hname )
+{
+    pjsip_lazy_hdr *hdr;
+    pj_str_t empty;
+
+    /* Point empty value to the buffer, since it may be parsed later */
+    empty.ptr = ctx->scanner->curptr;
+    empty.slen = 0;
+
+    hdr = pjsip_lazy_hdr_create(ctx->pool, hname, &empty, rec->hdr_type);
+
+    /* The value is scanned the same way as generic string header */
+    parse_generic_string_hdr((pjsip_generic_string_hdr*)hdr, ctx);
+
+    /* Extension header is found by the name that it was registered with */
+    if (rec->hdr_type == PJSIP_H_OTHER && 
+	pj_strcmp2(hname, rec->cname) != 0)
+    {
+	pj_strdup2(ctx->pool, &hdr->name, rec->cname);
+    }
+
+    return (pjsip_hdr*)hdr;
+}
+
 /* Public function to parse a header value. */
 PJ_DEF(void*) pjsip_parse_hdr( pj_pool_t *pool, const pj_str_t *hname,
 			       char *buf, pj_size_t size, int *parsed_len )
@@ -2252,31 +2436,28 @@ PJ_DEF(void*) pjsip_parse_hdr( pj_pool_t *pool, const pj_str_t *hname,
     pj_scanner scanner;
     pjsip_hdr *hdr = NULL;
     pjsip_parse_ctx context;
-    PJ_USE_EXCEPTION;
+    const handler_rec *handler;
 
-    pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, 
-                 &on_syntax_error);
+    pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, NULL);
 
     context.scanner = &scanner;
     context.pool = pool;
     context.rdata = NULL;
 
-    PJ_TRY {
-	pjsip_parse_hdr_func *handler = find_handler(hname);
-	if (handler) {
-	    hdr = (*handler)(&context);
-	} else {
-	    hdr = parse_hdr_generic_string(&context);
-	    hdr->type = PJSIP_H_OTHER;
-	    pj_strdup(pool, &hdr->name, hname);
-	    hdr->sname = hdr->name;
-	}
+    handler = find_handler(hname);
+    if (handler) {
+	hdr = call_hdr_parser(handler, &context);
+    } else {
+	hdr = parse_hdr_generic_string(&context);
+	hdr->type = PJSIP_H_OTHER;
+	pj_strdup(pool, &hdr->name, hname);
+	hdr->sname = hdr->name;
+    }
 
-    } 
-    PJ_CATCH_ANY {
+    if (pj_scan_has_err(&scanner)) {
+	pj_scan_clear_err(&scanner);
 	hdr = NULL;
     }
-    PJ_END
 
     if (parsed_len) {
 	*parsed_len = (unsigned)(scanner.curptr - scanner.begin);
@@ -2296,34 +2477,25 @@ PJ_DEF(pj_status_t) pjsip_parse_headers( pj_pool_t *pool, char *input,
     pj_scanner scanner;
     pjsip_parse_ctx ctx;
     pj_str_t hname;
-    PJ_USE_EXCEPTION;
 
-    pj_scan_init(&scanner, input, size, PJ_SCAN_AUTOSKIP_WS_HEADER,
-                 &on_syntax_error);
+    pj_scan_init(&scanner, input, size, PJ_SCAN_AUTOSKIP_WS_HEADER, NULL);
 
     pj_bzero(&ctx, sizeof(ctx));
     ctx.scanner = &scanner;
     ctx.pool = pool;
 
-retry_parse:
-    PJ_TRY
-    {
-	/* Parse headers. */
-	do {
-	    pjsip_parse_hdr_func * handler;
-	    pjsip_hdr *hdr = NULL;
-
-	    /* Init hname just in case parsing fails.
-	     * Ref: PROTOS #2412
-	     */
-	    hname.slen = 0;
+    /* Parse headers. */
+    do {
+	const handler_rec * handler;
+	pjsip_hdr *hdr = NULL;
 
-	    /* Get hname. */
-	    pj_scan_get( &scanner, &pconst.pjsip_TOKEN_SPEC, &hname);
-	    if (pj_scan_get_char( &scanner ) != ':') {
-		PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-	    }
+	/* Get hname. */
+	pj_scan_get( &scanner, &pconst.pjsip_TOKEN_SPEC, &hname);
+	if (pj_scan_get_char( &scanner ) != ':') {
+	    pj_scan_syntax_err(&scanner);
+	}
 
+	if (!pj_scan_has_err(&scanner)) {
 	    /* Find handler. */
 	    handler = find_handler(&hname);
 
@@ -2332,63 +2504,49 @@ retry_parse:
 	     * hname/hvalue pair.
 	     */
 	    if (handler) {
-		hdr = (*handler)(&ctx);
+		hdr = call_hdr_parser(handler, &ctx);
 	    } else {
 		hdr = parse_hdr_generic_string(&ctx);
 		hdr->name = hdr->sname = hname;
 	    }
+	}
 
-	    /* Single parse of header line can produce multiple headers.
-	     * For example, if one Contact: header contains Contact list
-	     * separated by comma, then these Contacts will be split into
-	     * different Contact headers.
-	     * So here we must insert list instead of just insert one header.
-	     */
-	    if (hdr)
-		pj_list_insert_nodes_before(hlist, hdr);
-
-	    /* Parse until EOF or an empty line is found. */
-	} while (!pj_scan_is_eof(&scanner) && !IS_NEWLINE(*scanner.curptr));
+	if (pj_scan_has_err(&scanner)) {
+	    pj_scan_clear_err(&scanner);
+	    PJ_LOG(4,(THIS_FILE, "Error parsing header: '%.*s' line %d col %d",
+		      (int)hname.slen, hname.ptr, scanner.line,
+		      pj_scan_get_col(&scanner)));
 
-	/* If empty line is found, eat it. */
-	if (!pj_scan_is_eof(&scanner)) {
-	    if (IS_NEWLINE(*scanner.curptr)) {
-		pj_scan_get_newline(&scanner);
+	    if ((options & STOP_ON_ERROR) == STOP_ON_ERROR) {
+		pj_scan_fini(&scanner);
+		return PJSIP_EINVALIDHDR;
 	    }
-	}
-    }
-    PJ_CATCH_ANY
-    {
-	PJ_LOG(4,(THIS_FILE, "Error parsing header: '%.*s' line %d col %d",
-		  (int)hname.slen, hname.ptr, scanner.line,
-		  pj_scan_get_col(&scanner)));
 
-	/* Exception was thrown during parsing. */
-	if ((options & STOP_ON_ERROR) == STOP_ON_ERROR) {
-	    pj_scan_fini(&scanner);
-	    return PJSIP_EINVALIDHDR;
-	}
+	    /* Skip the header, and parse next header if any. */
+	    if (skip_invalid_hdr(&scanner))
+		continue;
 
-	/* Skip until newline, and parse next header. */
-	if (!pj_scan_is_eof(&scanner)) {
-	    /* Skip until next line.
-	     * Watch for header continuation.
-	     */
-	    do {
-		pj_scan_skip_line(&scanner);
-	    } while (IS_SPACE(*scanner.curptr));
+	    return PJ_SUCCESS;
 	}
 
-	/* Restore flag. Flag may be set in int_parse_sip_url() */
-	scanner.skip_ws = PJ_SCAN_AUTOSKIP_WS_HEADER;
+	/* Single parse of header line can produce multiple headers.
+	 * For example, if one Contact: header contains Contact list
+	 * separated by comma, then these Contacts will be split into
+	 * different Contact headers.
+	 * So here we must insert list instead of just insert one header.
+	 */
+	if (hdr)
+	    pj_list_insert_nodes_before(hlist, hdr);
+
+	/* Parse until EOF or an empty line is found. */
+    } while (!pj_scan_is_eof(&scanner) && !IS_NEWLINE(*scanner.curptr));
 
-	/* Continue parse next header, if any. */
-	if (!pj_scan_is_eof(&scanner) && !IS_NEWLINE(*scanner.curptr)) {
-	    goto retry_parse;
+    /* If empty line is found, eat it. */
+    if (!pj_scan_is_eof(&scanner)) {
+	if (IS_NEWLINE(*scanner.curptr)) {
+	    pj_scan_get_newline(&scanner);
 	}
-
     }
-    PJ_END;
 
     return PJ_SUCCESS;
 }
@@ -26,6 +26,7 @@
 #include <pjlib-util/errno.h>
 #include <pj/hash.h>
 #include <pj/pool.h>
+#include <pj/slab.h>
 #include <pj/os.h>
 #include <pj/rand.h>
 #include <pj/string.h>
@@ -41,13 +42,6 @@
 #define TSX_TRACE_(expr)
 #endif
 
-/* When this macro is set, transaction will keep the hashed value
- * so that future lookup (to unregister transaction) does not need
- * to recalculate the hash again. It should gains a little bit of
- * performance, so generally we'd want this.
- */
-#define PRECALC_HASH
-
 
 /* Defined in sip_util_statefull.c */
 extern pjsip_module mod_stateful_util;
@@ -67,14 +61,56 @@ static pj_status_t mod_tsx_layer_unload(void);
 static pj_bool_t   mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata);
 static pj_bool_t   mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata);
 
+/* Shard of the transaction table. */
+struct tsx_shard
+{
+    pj_mutex_t		*mutex;
+    pj_hash_table_t	*htable;
+};
+
+#if PJSIP_HAS_SLAB_ALLOC
+/* Transaction allocator. Transactions may outlive the transaction layer
+ * (they are destroyed when the last reference to their group lock is
+ * released), so the allocator is reference counted by the layer and by
+ * each transaction allocated from it.
+ */
+struct pjsip_tsx_slab
+{
+    pj_pool_t		*pool;
+    pj_slab_t		*slab;
+    pj_atomic_t		*ref_cnt;
+    pj_lock_t		*cache_lock;
+    pjsip_transaction  **cache;
+    unsigned		 cache_cnt;
+};
+
+/* Size of the buffers in the transaction object for the branch and the
+ * transaction key. Longer strings are allocated from the pool.
+ */
+#define TSX_BRANCH_BUF_LEN	64
+#define TSX_KEY_BUF_LEN		96
+
+/* Transaction object allocated from the slab, with the buffers for the
+ * strings owned by the transaction.
+ */
+struct tsx_slab_obj
+{
+    pjsip_transaction	 tsx;
+    char		 branch_buf[TSX_BRANCH_BUF_LEN];
+    char		 key_buf[TSX_KEY_BUF_LEN];
+};
+#endif
+
 /* Transaction layer module definition. */
 static struct mod_tsx_layer
 {
     struct pjsip_module  mod;
     pj_pool_t		*pool;
     pjsip_endpoint	*endpt;
-    pj_mutex_t		*mutex;
-    pj_hash_table_t	*htable;
+    struct tsx_shard	 shard[PJSIP_TSX_TABLE_SHARD_CNT];
+#if PJSIP_HAS_SLAB_ALLOC
+    struct pjsip_tsx_slab *tsx_slab;
+#endif
 } mod_tsx_layer = 
 {   {
 	NULL, NULL,			/* List's prev and next.    */
@@ -425,9 +461,214 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_key( pj_pool_t *pool, pj_str_t *key,
 /*
  * Create transaction layer module and registers it to the endpoint.
  */
+/* Get the shard of the transaction table for the hashed key. The upper
+ * bits of the multiplication spread the keys evenly over the shards.
+ */
+PJ_INLINE(struct tsx_shard*) get_shard(pj_uint32_t hval)
+{
+    return &mod_tsx_layer.shard[((hval * 2654435761U) >> 16) %
+				PJSIP_TSX_TABLE_SHARD_CNT];
+}
+
+/* Destroy the mutexes of the transaction table. */
+static void destroy_shards(void)
+{
+    unsigned i;
+
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+	if (mod_tsx_layer.shard[i].mutex) {
+	    pj_mutex_destroy(mod_tsx_layer.shard[i].mutex);
+	    mod_tsx_layer.shard[i].mutex = NULL;
+	}
+	mod_tsx_layer.shard[i].htable = NULL;
+    }
+}
+
+#if PJSIP_HAS_SLAB_ALLOC
+/* Create transaction allocator, with one reference held by the layer. */
+static pj_status_t tsx_slab_create(pj_pool_factory *pf,
+				   struct pjsip_tsx_slab **p_ts)
+{
+    pj_pool_t *pool;
+    struct pjsip_tsx_slab *ts;
+    pj_status_t status;
+
+    pool = pj_pool_create(pf, "tsxslab", 256, 256, NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    ts = PJ_POOL_ZALLOC_T(pool, struct pjsip_tsx_slab);
+    ts->pool = pool;
+
+    status = pj_atomic_create(pool, 1, &ts->ref_cnt);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    status = pj_slab_create(pf, "tsxslab", sizeof(struct tsx_slab_obj), 0,
+			    &ts->slab);
+    if (status != PJ_SUCCESS) {
+	pj_atomic_destroy(ts->ref_cnt);
+	pj_pool_release(pool);
+	return status;
+    }
+
+    /* The cache keeps destroyed transactions with their pools and mutexes
+     * for reuse. Transactions are not cached if this fails.
+     */
+    if (PJSIP_TSX_CACHE_SIZE > 0) {
+	status = pj_lock_create_simple_mutex(pool, "tsxcache",
+					     &ts->cache_lock);
+	if (status != PJ_SUCCESS)
+	    ts->cache_lock = NULL;
+	ts->cache = (pjsip_transaction**)
+		    pj_pool_calloc(pool, PJSIP_TSX_CACHE_SIZE,
+				   sizeof(pjsip_transaction*));
+    }
+
+    *p_ts = ts;
+    return PJ_SUCCESS;
+}
+
+/* Release a reference to the transaction allocator, destroying it when
+ * the last reference is released.
+ */
+static void tsx_slab_dec_ref(struct pjsip_tsx_slab *ts)
+{
+    if (pj_atomic_dec_and_get(ts->ref_cnt) == 0) {
+	/* Release the pools of cached transactions. */
+	while (ts->cache_cnt) {
+	    pjsip_transaction *tsx = ts->cache[--ts->cache_cnt];
+	    pj_pool_release(tsx->pool);
+	}
+	if (ts->cache_lock)
+	    pj_lock_destroy(ts->cache_lock);
+
+	pj_slab_destroy(ts->slab);
+	pj_atomic_destroy(ts->ref_cnt);
+	pj_pool_release(ts->pool);
+    }
+}
+
+/* Allocate transaction with its pool, from the cache or from the
+ * allocator.
+ */
+static pjsip_transaction *tsx_slab_alloc(struct pjsip_tsx_slab *ts)
+{
+    pjsip_transaction *tsx = NULL;
+    pj_pool_t *pool;
+
+    if (ts->cache_lock) {
+	pj_lock_acquire(ts->cache_lock);
+	if (ts->cache_cnt)
+	    tsx = ts->cache[--ts->cache_cnt];
+	pj_lock_release(ts->cache_lock);
+    }
+
+    if (tsx) {
+	/* The pool has been reset when the transaction was cached */
+	pool = tsx->pool;
+	pj_bzero(tsx, sizeof(pjsip_transaction));
+    } else {
+	pool = pjsip_endpt_create_pool( mod_tsx_layer.endpt, "tsx",
+					PJSIP_POOL_TSX_LEN,
+					PJSIP_POOL_TSX_INC );
+	if (!pool)
+	    return NULL;
+
+	tsx = (pjsip_transaction*) pj_slab_zalloc(ts->slab);
+	if (!tsx) {
+	    pjsip_endpt_release_pool(mod_tsx_layer.endpt, pool);
+	    return NULL;
+	}
+    }
+
+    pj_atomic_inc(ts->ref_cnt);
+    tsx->pool = pool;
+    tsx->slab = ts;
+    return tsx;
+}
+
+/* Return transaction to the allocator it was allocated from, keeping
+ * it with its pool in the cache if the cache is not full.
+ */
+static void tsx_slab_free(pjsip_transaction *tsx)
+{
+    struct pjsip_tsx_slab *ts = tsx->slab;
+    pj_bool_t cached = PJ_FALSE;
+
+    /* The mutex is allocated from the pool */
+    if (tsx->mutex_b) {
+	pj_mutex_destroy(tsx->mutex_b);
+	tsx->mutex_b = NULL;
+    }
+
+    if (ts->cache_lock) {
+	/* Nothing that outlives the transaction is allocated from its
+	 * pool, so the pool can be reset.
+	 */
+	pj_pool_reset(tsx->pool);
+
+	pj_lock_acquire(ts->cache_lock);
+	if (ts->cache_cnt < PJSIP_TSX_CACHE_SIZE) {
+	    ts->cache[ts->cache_cnt++] = tsx;
+	    cached = PJ_TRUE;
+	}
+	pj_lock_release(ts->cache_lock);
+    }
+
+    if (!cached) {
+	pj_pool_release(tsx->pool);
+	pj_slab_free(ts->slab, tsx);
+    }
+
+    tsx_slab_dec_ref(ts);
+}
+
+/* Copy string owned by the transaction to the buffer in the transaction
+ * object, or to the pool if it doesn't fit.
+ */
+static void tsx_strdup(pjsip_transaction *tsx, char *buf, pj_size_t buf_len,
+		       pj_str_t *dst, const pj_str_t *src)
+{
+    if (tsx->slab && (pj_size_t)src->slen <= buf_len) {
+	pj_memcpy(buf, src->ptr, src->slen);
+	dst->ptr = buf;
+	dst->slen = src->slen;
+    } else {
+	pj_strdup(tsx->pool, dst, src);
+    }
+}
+#endif
+
+/* Save the branch parameter of the transaction. */
+static void tsx_set_branch(pjsip_transaction *tsx, const pj_str_t *branch)
+{
+#if PJSIP_HAS_SLAB_ALLOC
+    tsx_strdup(tsx, ((struct tsx_slab_obj*)tsx)->branch_buf,
+	       TSX_BRANCH_BUF_LEN, &tsx->branch, branch);
+#else
+    pj_strdup(tsx->pool, &tsx->branch, branch);
+#endif
+}
+
+/* Save the transaction key and calculate its hashed value. */
+static void tsx_set_key(pjsip_transaction *tsx, const pj_str_t *key)
+{
+#if PJSIP_HAS_SLAB_ALLOC
+    tsx_strdup(tsx, ((struct tsx_slab_obj*)tsx)->key_buf,
+	       TSX_KEY_BUF_LEN, &tsx->transaction_key, key);
+#else
+    pj_strdup(tsx->pool, &tsx->transaction_key, key);
+#endif
+    tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
+}
+
 PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
 {
     pj_pool_t *pool;
+    unsigned i, shard_size;
     pj_status_t status;
 
 
@@ -466,26 +707,51 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
     mod_tsx_layer.endpt = endpt;
 
 
-    /* Create hash table. */
-    mod_tsx_layer.htable = pj_hash_create( pool, pjsip_cfg()->tsx.max_count );
-    if (!mod_tsx_layer.htable) {
-	pjsip_endpt_release_pool(endpt, pool);
-	return PJ_ENOMEM;
+    /* Create the shards of the transaction table. */
+    shard_size = pjsip_cfg()->tsx.max_count / PJSIP_TSX_TABLE_SHARD_CNT + 1;
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+	struct tsx_shard *shard = &mod_tsx_layer.shard[i];
+
+	shard->htable = pj_hash_create2( pool, shard_size,
+					 PJ_HASH_OPEN_ADDRESSING |
+					 PJ_HASH_INCREMENTAL_RESIZE );
+	if (!shard->htable) {
+	    destroy_shards();
+	    pjsip_endpt_release_pool(endpt, pool);
+	    return PJ_ENOMEM;
+	}
+
+	status = pj_mutex_create_recursive(pool, "tsxlayer%p", &shard->mutex);
+	if (status != PJ_SUCCESS) {
+	    destroy_shards();
+	    pjsip_endpt_release_pool(endpt, pool);
+	    return status;
+	}
     }
 
-    /* Create group lock. */
-    status = pj_mutex_create_recursive(pool, "tsxlayer", &mod_tsx_layer.mutex);
+#if PJSIP_HAS_SLAB_ALLOC
+    /* Create transaction allocator. Transactions will be allocated from
+     * their pools if this fails.
+     */
+    status = tsx_slab_create(pool->factory, &mod_tsx_layer.tsx_slab);
     if (status != PJ_SUCCESS) {
-	pjsip_endpt_release_pool(endpt, pool);
-	return status;
+	PJ_PERROR(3,(THIS_FILE, status, "Error creating transaction slab"));
+	mod_tsx_layer.tsx_slab = NULL;
     }
+#endif
 
     /*
      * Register transaction layer module to endpoint.
      */
     status = pjsip_endpt_register_module( endpt, &mod_tsx_layer.mod );
     if (status != PJ_SUCCESS) {
-	pj_mutex_destroy(mod_tsx_layer.mutex);
+#if PJSIP_HAS_SLAB_ALLOC
+	if (mod_tsx_layer.tsx_slab) {
+	    tsx_slab_dec_ref(mod_tsx_layer.tsx_slab);
+	    mod_tsx_layer.tsx_slab = NULL;
+	}
+#endif
+	destroy_shards();
 	pjsip_endpt_release_pool(endpt, pool);
 	return status;
     }
@@ -530,21 +796,25 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_destroy(void)
  */
 static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
 {
+    struct tsx_shard *shard;
+
     pj_assert(tsx->transaction_key.slen != 0);
 
+    shard = get_shard(tsx->hashed_key);
+
     /* Lock hash table mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    pj_mutex_lock(shard->mutex);
 
     /* Check if no transaction with the same key exists. 
      * Do not use PJ_ASSERT_RETURN since it evaluates the expression
      * twice!
      */
-    if(pj_hash_get_lower(mod_tsx_layer.htable, 
+    if(pj_hash_get_lower(shard->htable, 
 		         tsx->transaction_key.ptr,
 		         (unsigned)tsx->transaction_key.slen, 
-		         NULL))
+		         &tsx->hashed_key))
     {
-	pj_mutex_unlock(mod_tsx_layer.mutex);
+	pj_mutex_unlock(shard->mutex);
 	PJ_LOG(2,(THIS_FILE, 
 		  "Unable to register %.*s transaction (key exists)",
 		  (int)tsx->method.name.slen,
@@ -558,19 +828,13 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
 		tsx->transaction_key.ptr));
 
     /* Register the transaction to the hash table. */
-#ifdef PRECALC_HASH
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
+    pj_hash_set_lower( tsx->pool, shard->htable,
                        tsx->transaction_key.ptr,
     		       (unsigned)tsx->transaction_key.slen, 
 		       tsx->hashed_key, tsx);
-#else
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
-                       tsx->transaction_key.ptr,
-    		       tsx->transaction_key.slen, 0, tsx);
-#endif
 
     /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     return PJ_SUCCESS;
 }
@@ -581,6 +845,8 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
  */
 static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
 {
+    struct tsx_shard *shard;
+
     if (mod_tsx_layer.mod.id == -1) {
 	/* The transaction layer has been unregistered. This could happen
 	 * if the transaction was pending on transport and the application
@@ -593,18 +859,15 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
     pj_assert(tsx->transaction_key.slen != 0);
     //pj_assert(tsx->state != PJSIP_TSX_STATE_NULL);
 
+    shard = get_shard(tsx->hashed_key);
+
     /* Lock hash table mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    pj_mutex_lock(shard->mutex);
 
     /* Register the transaction to the hash table. */
-#ifdef PRECALC_HASH
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
+    pj_hash_set_lower( NULL, shard->htable, tsx->transaction_key.ptr,
     		       (unsigned)tsx->transaction_key.slen, tsx->hashed_key, 
 		       NULL);
-#else
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
-    		       tsx->transaction_key.slen, 0, NULL);
-#endif
 
     TSX_TRACE_((THIS_FILE, 
 		"Transaction %p unregistered, hkey=0x%p and key=%.*s",
@@ -612,7 +875,7 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
 		tsx->transaction_key.ptr));
 
     /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    pj_mutex_unlock(shard->mutex);
 }
 
 
@@ -622,14 +885,18 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
  */
 PJ_DEF(unsigned) pjsip_tsx_layer_get_tsx_count(void)
 {
-    unsigned count;
+    unsigned i, count = 0;
 
     /* Are we registered? */
     PJ_ASSERT_RETURN(mod_tsx_layer.endpt!=NULL, 0);
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
-    count = pj_hash_count(mod_tsx_layer.htable);
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+	struct tsx_shard *shard = &mod_tsx_layer.shard[i];
+
+	pj_mutex_lock(shard->mutex);
+	count += pj_hash_count(shard->htable);
+	pj_mutex_unlock(shard->mutex);
+    }
 
     return count;
 }
@@ -642,11 +909,15 @@ PJ_DEF(pjsip_transaction*) pjsip_tsx_layer_find_tsx( const pj_str_t *key,
 						     pj_bool_t lock )
 {
     pjsip_transaction *tsx;
-    pj_uint32_t hval = 0;
+    struct tsx_shard *shard;
+    pj_uint32_t hval;
+
+    hval = pj_hash_calc_tolower(0, NULL, key);
+    shard = get_shard(hval);
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    pj_mutex_lock(shard->mutex);
     tsx = (pjsip_transaction*)
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key->ptr, 
+    	  pj_hash_get_lower( shard->htable, key->ptr, 
 			     (unsigned)key->slen, &hval );
     
     /* Prevent the transaction to get deleted before we have chance to lock it.
@@ -654,7 +925,7 @@ PJ_DEF(pjsip_transaction*) pjsip_tsx_layer_find_tsx( const pj_str_t *key,
     if (tsx && lock)
         pj_grp_lock_add_ref(tsx->grp_lock);
     
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     TSX_TRACE_((THIS_FILE, 
 		"Finding tsx with hkey=0x%p and key=%.*s: found %p",
@@ -697,26 +968,31 @@ static pj_status_t mod_tsx_layer_start(void)
 static pj_status_t mod_tsx_layer_stop(void)
 {
     pj_hash_iterator_t it_buf, *it;
+    unsigned i;
 
     PJ_LOG(4,(THIS_FILE, "Stopping transaction layer module"));
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
-
     /* Destroy all transactions. */
-    it = pj_hash_first(mod_tsx_layer.htable, &it_buf);
-    while (it) {
-	pjsip_transaction *tsx = (pjsip_transaction*) 
-				 pj_hash_this(mod_tsx_layer.htable, it);
-	pj_hash_iterator_t *next = pj_hash_next(mod_tsx_layer.htable, it);
-	if (tsx) {
-	    pjsip_tsx_terminate(tsx, PJSIP_SC_SERVICE_UNAVAILABLE);
-	    mod_tsx_layer_unregister_tsx(tsx);
-	    tsx_shutdown(tsx);
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+	struct tsx_shard *shard = &mod_tsx_layer.shard[i];
+
+	pj_mutex_lock(shard->mutex);
+
+	it = pj_hash_first(shard->htable, &it_buf);
+	while (it) {
+	    pjsip_transaction *tsx = (pjsip_transaction*) 
+				     pj_hash_this(shard->htable, it);
+	    pj_hash_iterator_t *next = pj_hash_next(shard->htable, it);
+	    if (tsx) {
+		pjsip_tsx_terminate(tsx, PJSIP_SC_SERVICE_UNAVAILABLE);
+		mod_tsx_layer_unregister_tsx(tsx);
+		tsx_shutdown(tsx);
+	    }
+	    it = next;
 	}
-	it = next;
-    }
 
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+	pj_mutex_unlock(shard->mutex);
+    }
 
     PJ_LOG(4,(THIS_FILE, "Stopped transaction layer module"));
 
@@ -729,8 +1005,18 @@ static void tsx_layer_destroy(pjsip_endpoint *endpt)
 {
     PJ_UNUSED_ARG(endpt);
 
-    /* Destroy mutex. */
-    pj_mutex_destroy(mod_tsx_layer.mutex);
+    /* Destroy mutexes. */
+    destroy_shards();
+
+#if PJSIP_HAS_SLAB_ALLOC
+    /* Release the layer's reference to the transaction allocator. It will
+     * be destroyed when the remaining transactions are destroyed.
+     */
+    if (mod_tsx_layer.tsx_slab) {
+	tsx_slab_dec_ref(mod_tsx_layer.tsx_slab);
+	mod_tsx_layer.tsx_slab = NULL;
+    }
+#endif
 
     /* Release pool. */
     pjsip_endpt_release_pool(mod_tsx_layer.endpt, mod_tsx_layer.pool);
@@ -753,7 +1039,7 @@ static pj_status_t mod_tsx_layer_unload(void)
      * crash when the pending transaction finally got error response
      * from transport and when it tries to unregister itself.
      */
-    if (pj_hash_count(mod_tsx_layer.htable) != 0) {
+    if (pjsip_tsx_layer_get_tsx_count() != 0) {
 	if (pjsip_endpt_atexit(mod_tsx_layer.endpt, &tsx_layer_destroy) !=
 	    PJ_SUCCESS)
 	{
@@ -775,17 +1061,20 @@ static pj_status_t mod_tsx_layer_unload(void)
 static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 {
     pj_str_t key;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
+    struct tsx_shard *shard;
     pjsip_transaction *tsx;
 
     pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAS,
 			 &rdata->msg_info.cseq->method, rdata);
 
     /* Find transaction. */
-    pj_mutex_lock( mod_tsx_layer.mutex );
+    hval = pj_hash_calc_tolower(0, NULL, &key);
+    shard = get_shard(hval);
+    pj_mutex_lock( shard->mutex );
 
     tsx = (pjsip_transaction*) 
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+    	  pj_hash_get_lower( shard->htable, key.ptr, (unsigned)key.slen, 
 			     &hval );
 
 
@@ -799,7 +1088,7 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 	 * Reject the request so that endpoint passes the request to
 	 * upper layer modules.
 	 */
-	pj_mutex_unlock( mod_tsx_layer.mutex);
+	pj_mutex_unlock( shard->mutex);
 	return PJ_FALSE;
     }
 
@@ -809,7 +1098,7 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
     pj_grp_lock_add_ref(tsx->grp_lock);
     
     /* Unlock hash table. */
-    pj_mutex_unlock( mod_tsx_layer.mutex );
+    pj_mutex_unlock( shard->mutex );
 
     /* Simulate race condition! */
     PJ_RACE_ME(5);
@@ -829,17 +1118,20 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
 {
     pj_str_t key;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
+    struct tsx_shard *shard;
     pjsip_transaction *tsx;
 
     pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAC,
 			 &rdata->msg_info.cseq->method, rdata);
 
     /* Find transaction. */
-    pj_mutex_lock( mod_tsx_layer.mutex );
+    hval = pj_hash_calc_tolower(0, NULL, &key);
+    shard = get_shard(hval);
+    pj_mutex_lock( shard->mutex );
 
     tsx = (pjsip_transaction*) 
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+    	  pj_hash_get_lower( shard->htable, key.ptr, (unsigned)key.slen, 
 			     &hval );
 
 
@@ -853,7 +1145,7 @@ static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
 	 * Reject the request so that endpoint passes the request to
 	 * upper layer modules.
 	 */
-	pj_mutex_unlock( mod_tsx_layer.mutex);
+	pj_mutex_unlock( shard->mutex);
 	return PJ_FALSE;
     }
 
@@ -863,7 +1155,7 @@ static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
     pj_grp_lock_add_ref(tsx->grp_lock);
 
     /* Unlock hash table. */
-    pj_mutex_unlock( mod_tsx_layer.mutex );
+    pj_mutex_unlock( shard->mutex );
 
     /* Simulate race condition! */
     PJ_RACE_ME(5);
@@ -894,22 +1186,50 @@ PJ_DEF(void) pjsip_tsx_layer_dump(pj_bool_t detail)
 {
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_hash_iterator_t itbuf, *it;
+    unsigned count[PJSIP_TSX_TABLE_SHARD_CNT];
+    unsigned i, j, total = 0;
+
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+	struct tsx_shard *shard = &mod_tsx_layer.shard[i];
 
-    /* Lock mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
+	pj_mutex_lock(shard->mutex);
+	count[i] = pj_hash_count(shard->htable);
+	pj_mutex_unlock(shard->mutex);
+
+	total += count[i];
+    }
 
     PJ_LOG(3, (THIS_FILE, "Dumping transaction table:"));
-    PJ_LOG(3, (THIS_FILE, " Total %d transactions", 
-			  pj_hash_count(mod_tsx_layer.htable)));
+    PJ_LOG(3, (THIS_FILE, " Total %d transactions in %d shards", 
+			  total, PJSIP_TSX_TABLE_SHARD_CNT));
+
+    /* Print the number of transactions in each shard, eight per line */
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; i=j) {
+	char line[80];
+	int len = 0;
+
+	for (j=i; j<i+8 && j<PJSIP_TSX_TABLE_SHARD_CNT; ++j) {
+	    len += pj_ansi_snprintf(line+len, sizeof(line)-len, " %5u",
+				    count[j]);
+	}
+	PJ_LOG(3, (THIS_FILE, "  shard %2u-%-2u:%s", i, j-1, line));
+    }
 
     if (detail) {
-	it = pj_hash_first(mod_tsx_layer.htable, &itbuf);
-	if (it == NULL) {
+	if (total == 0) {
 	    PJ_LOG(3, (THIS_FILE, " - none - "));
-	} else {
+	}
+
+	for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+	    struct tsx_shard *shard = &mod_tsx_layer.shard[i];
+
+	    /* Lock mutex. */
+	    pj_mutex_lock(shard->mutex);
+
+	    it = pj_hash_first(shard->htable, &itbuf);
 	    while (it != NULL) {
 		pjsip_transaction *tsx = (pjsip_transaction*) 
-					 pj_hash_this(mod_tsx_layer.htable,it);
+					 pj_hash_this(shard->htable, it);
 
 		PJ_LOG(3, (THIS_FILE, " %s %s|%d|%s",
 			   tsx->obj_name,
@@ -919,13 +1239,13 @@ PJ_DEF(void) pjsip_tsx_layer_dump(pj_bool_t detail)
 			   tsx->status_code,
 			   pjsip_tsx_state_str(tsx->state)));
 
-		it = pj_hash_next(mod_tsx_layer.htable, it);
+		it = pj_hash_next(shard->htable, it);
 	    }
+
+	    /* Unlock mutex. */
+	    pj_mutex_unlock(shard->mutex);
 	}
     }
-
-    /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
 #endif
 }
 
@@ -983,13 +1303,24 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
     pjsip_transaction *tsx;
     pj_status_t status;
 
-    pool = pjsip_endpt_create_pool( mod_tsx_layer.endpt, "tsx", 
-				    PJSIP_POOL_TSX_LEN, PJSIP_POOL_TSX_INC );
-    if (!pool)
-	return PJ_ENOMEM;
+#if PJSIP_HAS_SLAB_ALLOC
+    if (mod_tsx_layer.tsx_slab) {
+	tsx = tsx_slab_alloc(mod_tsx_layer.tsx_slab);
+	if (!tsx)
+	    return PJ_ENOMEM;
+	pool = tsx->pool;
+    } else
+#endif
+    {
+	pool = pjsip_endpt_create_pool( mod_tsx_layer.endpt, "tsx", 
+					PJSIP_POOL_TSX_LEN,
+					PJSIP_POOL_TSX_INC );
+	if (!pool)
+	    return PJ_ENOMEM;
 
-    tsx = PJ_POOL_ZALLOC_T(pool, pjsip_transaction);
-    tsx->pool = pool;
+	tsx = PJ_POOL_ZALLOC_T(pool, pjsip_transaction);
+	tsx->pool = pool;
+    }
     tsx->tsx_user = tsx_user;
     tsx->endpt = mod_tsx_layer.endpt;
 
@@ -1014,6 +1345,12 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
 	status = pj_grp_lock_create_w_handler(pool, NULL, tsx, &tsx_on_destroy,
 					      &tsx->grp_lock);
 	if (status != PJ_SUCCESS) {
+#if PJSIP_HAS_SLAB_ALLOC
+	    if (tsx->slab) {
+		tsx_slab_free(tsx);
+		return status;
+	    }
+#endif
 	    pjsip_endpt_release_pool(mod_tsx_layer.endpt, pool);
 	    return status;
 	}
@@ -1038,7 +1375,15 @@ static void tsx_on_destroy( void *arg )
 
     PJ_LOG(5,(tsx->obj_name, "Transaction destroyed!"));
 
-    pj_mutex_destroy(tsx->mutex_b);
+#if PJSIP_HAS_SLAB_ALLOC
+    if (tsx->slab) {
+	tsx_slab_free(tsx);
+	return;
+    }
+#endif
+
+    if (tsx->mutex_b)
+	pj_mutex_destroy(tsx->mutex_b);
     pjsip_endpt_release_pool(tsx->endpt, tsx->pool);
 }
 
@@ -1283,6 +1628,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
     pjsip_cseq_hdr *cseq;
     pjsip_via_hdr *via;
     pjsip_host_info dst_info;
+    pj_str_t key;
     pj_status_t status;
 
     /* Validate arguments. */
@@ -1338,31 +1684,22 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
     if (via->branch_param.slen == 0) {
 	pj_str_t tmp;
 	via->branch_param.ptr = (char*)
-				pj_pool_alloc(tsx->pool, PJSIP_MAX_BRANCH_LEN);
+				pj_pool_alloc(tdata->pool, PJSIP_MAX_BRANCH_LEN);
 	via->branch_param.slen = PJSIP_MAX_BRANCH_LEN;
 	pj_memcpy(via->branch_param.ptr, PJSIP_RFC3261_BRANCH_ID, 
 		  PJSIP_RFC3261_BRANCH_LEN);
 	tmp.ptr = via->branch_param.ptr + PJSIP_RFC3261_BRANCH_LEN + 2;
 	*(tmp.ptr-2) = 80; *(tmp.ptr-1) = 106;
 	pj_generate_unique_string( &tmp );
-
-        /* Save branch parameter. */
-        tsx->branch = via->branch_param;
-
-    } else {
-        /* Copy branch parameter. */
-        pj_strdup(tsx->pool, &tsx->branch, &via->branch_param);
     }
 
+    /* Copy branch parameter. */
+    tsx_set_branch(tsx, &via->branch_param);
+
    /* Generate transaction key. */
-    create_tsx_key_3261( tsx->pool, &tsx->transaction_key,
-			 PJSIP_ROLE_UAC, &tsx->method, 
+    create_tsx_key_3261( tdata->pool, &key, PJSIP_ROLE_UAC, &tsx->method, 
 			 &via->branch_param);
-
-    /* Calculate hashed key value. */
-#ifdef PRECALC_HASH
-    tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
-#endif
+    tsx_set_key(tsx, &key);
 
     PJ_LOG(6, (tsx->obj_name, "tsx_key=%.*s", tsx->transaction_key.slen,
 	       tsx->transaction_key.ptr));
@@ -1434,6 +1771,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uas2(pjsip_module *tsx_user,
     pjsip_transaction *tsx;
     pjsip_msg *msg;
     pj_str_t *branch;
+    pj_str_t key;
     pjsip_cseq_hdr *cseq;
     pj_status_t status;
 
@@ -1493,22 +1831,18 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uas2(pjsip_module *tsx_user,
     /* Get transaction key either from branch for RFC3261 message, or
      * create transaction key.
      */
-    status = pjsip_tsx_create_key(tsx->pool, &tsx->transaction_key, 
+    status = pjsip_tsx_create_key(rdata->tp_info.pool, &key, 
                                   PJSIP_ROLE_UAS, &tsx->method, rdata);
     if (status != PJ_SUCCESS) {
 	pj_grp_lock_release(tsx->grp_lock);
 	tsx_shutdown(tsx);
         return status;
     }
-
-    /* Calculate hashed key value. */
-#ifdef PRECALC_HASH
-    tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
-#endif
+    tsx_set_key(tsx, &key);
 
     /* Duplicate branch parameter for transaction. */
     branch = &rdata->msg_info.via->branch_param;
-    pj_strdup(tsx->pool, &tsx->branch, branch);
+    tsx_set_branch(tsx, branch);
 
     PJ_LOG(6, (tsx->obj_name, "tsx_key=%.*s", tsx->transaction_key.slen,
 	       tsx->transaction_key.ptr));
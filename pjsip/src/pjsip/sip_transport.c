@@ -32,6 +32,7 @@
 #include <pj/hash.h>
 #include <pj/string.h>
 #include <pj/pool.h>
+#include <pj/slab.h>
 #include <pj/assert.h>
 #include <pj/lock.h>
 #include <pj/list.h>
@@ -77,6 +78,9 @@ static pjsip_module mod_msg_print =
     NULL,				/* on_tsx_state()		    */
 };
 
+/* Maximum number of print buffer sizes */
+#define TX_BUF_CLASS_MAX    8
+
 /* Transport list item */
 typedef struct transport
 {
@@ -84,6 +88,84 @@ typedef struct transport
     pjsip_transport *tp;
 } transport;
 
+/* Message in the receive queue */
+typedef struct rx_queue_item
+{
+    PJ_DECL_LIST_MEMBER(struct rx_queue_item);
+    pj_pool_t		*pool;
+    pjsip_rx_data	*rdata;
+} rx_queue_item;
+
+/* Messages waiting for one worker thread, or for all of them when the
+ * messages are not pinned to a worker.
+ */
+typedef struct rx_queue_shard
+{
+    struct pjsip_tpmgr	*mgr;
+    pj_sem_t		*sem;
+    rx_queue_item	 queue[PJSIP_RX_QUEUE_PRIO_CNT];
+} rx_queue_shard;
+
+/* Receive queue, see pjsip_tpmgr_start_rx_queue(). Once created, it is
+ * kept until the transport manager is destroyed, since transports may
+ * still be looking at it when it is stopped.
+ */
+typedef struct rx_queue
+{
+    pj_pool_t		*pool;
+    pj_lock_t		*lock;
+    pj_bool_t		 enabled;
+    pj_bool_t		 quit;
+    unsigned		 max_len;
+    unsigned		 thread_cnt;
+    unsigned		 thread_cap;
+    pj_thread_t	       **threads;
+    unsigned		 shard_cnt;
+    rx_queue_shard	*shards;
+    rx_queue_item	 free_list;
+    pjsip_rx_queue_stat	 stat;
+} rx_queue;
+
+/* Token bucket of the rate limiter, in 1/1000 of a token. */
+typedef struct rate_limit_bucket
+{
+    pj_uint32_t		 tokens;
+    pj_uint32_t		 max_tokens;
+    unsigned		 rate;
+} rate_limit_bucket;
+
+/* Source address tracked by the rate limiter. */
+typedef struct rate_limit_source
+{
+    PJ_DECL_LIST_MEMBER(struct rate_limit_source);
+    pj_hash_entry_buf	 hentry;
+    pj_uint8_t		 key[sizeof(pj_in6_addr)];
+    unsigned		 keylen;
+    char		 name[PJ_INET6_ADDRSTRLEN];
+    pj_uint32_t		 last_refill;
+    unsigned		 dropped_cnt;
+    rate_limit_bucket	 all;
+    rate_limit_bucket	 method[PJSIP_RATE_LIMIT_MAX_METHODS];
+} rate_limit_source;
+
+/* Per-source rate limiter, see pjsip_tpmgr_set_rate_limit(). Like the
+ * receive queue, it is kept until the transport manager is destroyed.
+ * Sources are kept in LRU order, most recently seen first.
+ */
+typedef struct rate_limiter
+{
+    pj_pool_t		*pool;
+    pj_lock_t		*lock;
+    pj_bool_t		 enabled;
+    pjsip_rate_limit_cfg cfg;
+    pj_hash_table_t	*table;
+    rate_limit_source	*sources;
+    unsigned		 source_cap;
+    rate_limit_source	 lru;
+    rate_limit_source	 free_list;
+    pjsip_rate_limit_stat stat;
+} rate_limiter;
+
 /*
  * Transport manager.
  */
@@ -104,14 +186,43 @@ struct pjsip_tpmgr
      * is destroyed.
      */
     pjsip_tx_data    tdata_list;
+
+#if PJSIP_HAS_SLAB_ALLOC
+    /* Allocator for transmit data. */
+    pj_slab_t	    *tdata_slab;
+
+    /* Allocators for the print buffer, in increasing buffer size. */
+    unsigned	     buf_class_cnt;
+    pj_size_t	     buf_size[TX_BUF_CLASS_MAX];
+    pj_slab_t	    *buf_slab[TX_BUF_CLASS_MAX];
+
+    /* Print buffer class to try first, based on the size of the previous
+     * message. This is only a hint, so it's not protected by any lock.
+     */
+    unsigned	     buf_class_hint;
+
+    /* Destroyed transmit data kept for reuse, along with their pools. */
+    pj_lock_t	    *tdata_cache_lock;
+    pjsip_tx_data    tdata_cache;
+    unsigned	     tdata_cache_cnt;
+#endif
     
     /* List of transports which are NOT stored in the hash table, so
      * that it can be properly cleaned up when transport manager
      * is destroyed.
      */
     transport        tp_list;
+
+    /* Receive queue, NULL if it has never been started. */
+    rx_queue	    *rxq;
+
+    /* Rate limiter, NULL if it has never been enabled. */
+    rate_limiter    *rlim;
 };
 
+static void rx_queue_destroy(pjsip_tpmgr *mgr);
+static void rate_limiter_destroy(pjsip_tpmgr *mgr);
+
 
 /* Transport state listener list type */
 typedef struct tp_state_listener
@@ -400,6 +511,124 @@ PJ_DEF(void) pjsip_tpselector_dec_ref(pjsip_tpselector *sel)
  *
  *****************************************************************************/
 
+/* Release the print buffer allocated by the transport manager. */
+static void release_tx_buf(pjsip_tx_data *tdata)
+{
+    if (tdata->buf_slab) {
+	pj_slab_free(tdata->buf_slab, tdata->slab_buf);
+	tdata->buf_slab = NULL;
+	tdata->slab_buf = NULL;
+    }
+}
+
+#if PJSIP_HAS_SLAB_ALLOC
+/* Get transmit data from the cache, or NULL if the cache is empty. */
+static pjsip_tx_data *get_cached_tx_data(pjsip_tpmgr *mgr)
+{
+    pjsip_tx_data *tdata = NULL;
+
+    if (!mgr->tdata_cache_lock)
+	return NULL;
+
+    pj_lock_acquire(mgr->tdata_cache_lock);
+    if (!pj_list_empty(&mgr->tdata_cache)) {
+	tdata = mgr->tdata_cache.next;
+	pj_list_erase(tdata);
+	--mgr->tdata_cache_cnt;
+    }
+    pj_lock_release(mgr->tdata_cache_lock);
+
+    return tdata;
+}
+
+/* Put transmit data to the cache, return PJ_FALSE if the cache is full. */
+static pj_bool_t put_cached_tx_data(pjsip_tpmgr *mgr, pjsip_tx_data *tdata)
+{
+    pj_bool_t cached = PJ_FALSE;
+
+    if (!mgr->tdata_cache_lock)
+	return PJ_FALSE;
+
+    pj_lock_acquire(mgr->tdata_cache_lock);
+    if (mgr->tdata_cache_cnt < PJSIP_TX_DATA_CACHE_SIZE) {
+	pj_list_push_front(&mgr->tdata_cache, tdata);
+	++mgr->tdata_cache_cnt;
+	cached = PJ_TRUE;
+    }
+    pj_lock_release(mgr->tdata_cache_lock);
+
+    return cached;
+}
+#endif
+
+/* Release the pool and the memory of transmit buffer. */
+static void free_tx_data(pjsip_tx_data *tdata)
+{
+    pjsip_tpmgr *mgr = tdata->mgr;
+
+    release_tx_buf(tdata);
+
+#if PJSIP_HAS_SLAB_ALLOC
+    if (mgr->tdata_slab) {
+	/* Keep the transmit data with its pool for reuse. The transmit
+	 * data is not allocated from the pool, so the pool can be reset.
+	 */
+	pj_pool_reset(tdata->pool);
+	if (put_cached_tx_data(mgr, tdata))
+	    return;
+
+	pjsip_endpt_release_pool( mgr->endpt, tdata->pool );
+	pj_slab_free(mgr->tdata_slab, tdata);
+	return;
+    }
+#endif
+
+    pjsip_endpt_release_pool( mgr->endpt, tdata->pool );
+}
+
+#if PJSIP_HAS_SLAB_ALLOC
+/* Destroy the print buffer allocators. */
+static void destroy_tx_buf_slabs(pjsip_tpmgr *mgr)
+{
+    unsigned i;
+
+    for (i=0; i<mgr->buf_class_cnt; ++i) {
+	pj_slab_destroy(mgr->buf_slab[i]);
+	mgr->buf_slab[i] = NULL;
+    }
+    mgr->buf_class_cnt = 0;
+}
+
+/* Create the print buffer allocators, with buffer size starting from
+ * PJSIP_TX_BUF_MIN_SIZE and doubling up to PJSIP_MAX_PKT_LEN. Each
+ * buffer has one extra byte for the NULL terminator.
+ */
+static void create_tx_buf_slabs(pjsip_tpmgr *mgr, pj_pool_factory *pf)
+{
+    pj_size_t size = PJSIP_TX_BUF_MIN_SIZE;
+    unsigned i, cnt = 0;
+
+    while (size && size < PJSIP_MAX_PKT_LEN && cnt < TX_BUF_CLASS_MAX-1) {
+	mgr->buf_size[cnt++] = size;
+	size <<= 1;
+    }
+    mgr->buf_size[cnt++] = PJSIP_MAX_PKT_LEN + 1;
+
+    for (i=0; i<cnt; ++i) {
+	pj_status_t status;
+
+	status = pj_slab_create(pf, "txbuf%p", mgr->buf_size[i], 0,
+				&mgr->buf_slab[i]);
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(3,(THIS_FILE, status, "Error creating print buffer slab"));
+	    destroy_tx_buf_slabs(mgr);
+	    return;
+	}
+	mgr->buf_class_cnt = i + 1;
+    }
+}
+#endif
+
 /*
  * Create new transmit buffer.
  */
@@ -412,27 +641,49 @@ PJ_DEF(pj_status_t) pjsip_tx_data_create( pjsip_tpmgr *mgr,
 
     PJ_ASSERT_RETURN(mgr && p_tdata, PJ_EINVAL);
 
-    pool = pjsip_endpt_create_pool( mgr->endpt, "tdta%p",
-				    PJSIP_POOL_LEN_TDATA,
-				    PJSIP_POOL_INC_TDATA );
-    if (!pool)
-	return PJ_ENOMEM;
+#if PJSIP_HAS_SLAB_ALLOC
+    tdata = get_cached_tx_data(mgr);
+    if (tdata) {
+	/* The pool has been reset when the transmit data was cached */
+	pool = tdata->pool;
+	pj_bzero(tdata, sizeof(pjsip_tx_data));
+    } else
+#endif
+    {
+	pool = pjsip_endpt_create_pool( mgr->endpt, "tdta%p",
+					PJSIP_POOL_LEN_TDATA,
+					PJSIP_POOL_INC_TDATA );
+	if (!pool)
+	    return PJ_ENOMEM;
 
-    tdata = PJ_POOL_ZALLOC_T(pool, pjsip_tx_data);
+#if PJSIP_HAS_SLAB_ALLOC
+	if (mgr->tdata_slab) {
+	    tdata = (pjsip_tx_data*) pj_slab_zalloc(mgr->tdata_slab);
+	    if (!tdata) {
+		pjsip_endpt_release_pool( mgr->endpt, pool );
+		return PJ_ENOMEM;
+	    }
+	} else
+#endif
+	{
+	    tdata = PJ_POOL_ZALLOC_T(pool, pjsip_tx_data);
+	}
+    }
     tdata->pool = pool;
     tdata->mgr = mgr;
     pj_memcpy(tdata->obj_name, pool->obj_name, PJ_MAX_OBJ_NAME);
 
     status = pj_atomic_create(tdata->pool, 0, &tdata->ref_cnt);
     if (status != PJ_SUCCESS) {
-	pjsip_endpt_release_pool( mgr->endpt, tdata->pool );
+	free_tx_data(tdata);
 	return status;
     }
     
     //status = pj_lock_create_simple_mutex(pool, "tdta%p", &tdata->lock);
     status = pj_lock_create_null_mutex(pool, "tdta%p", &tdata->lock);
     if (status != PJ_SUCCESS) {
-	pjsip_endpt_release_pool( mgr->endpt, tdata->pool );
+	pj_atomic_destroy( tdata->ref_cnt );
+	free_tx_data(tdata);
 	return status;
     }
 
@@ -481,7 +732,7 @@ static void tx_data_destroy(pjsip_tx_data *tdata)
 
     pj_atomic_destroy( tdata->ref_cnt );
     pj_lock_destroy( tdata->lock );
-    pjsip_endpt_release_pool( tdata->mgr->endpt, tdata->pool );
+    free_tx_data(tdata);
 }
 
 /*
@@ -509,11 +760,109 @@ PJ_DEF(void) pjsip_tx_data_invalidate_msg( pjsip_tx_data *tdata )
     tdata->info = NULL;
 }
 
+#if PJSIP_HAS_SLAB_ALLOC
+/* Get the smallest print buffer class which can hold a message of the
+ * specified size, with some room for it to grow.
+ */
+static unsigned get_buf_class(pjsip_tpmgr *mgr, pj_ssize_t size)
+{
+    unsigned i, last = mgr->buf_class_cnt - 1;
+
+    size += size / 4;
+    for (i=0; i<last && (pj_ssize_t)mgr->buf_size[i] <= size; ++i)
+	;
+    return i;
+}
+
+/*
+ * Print the SIP message to the print buffer allocated by the transport
+ * manager. The buffer class is guessed from the size of the previous
+ * message, and only when the message doesn't fit it is printed again to
+ * the largest buffer, which is then kept as is.
+ */
+static pj_status_t encode_to_slab_buf(pjsip_tx_data *tdata)
+{
+    pjsip_tpmgr *mgr = tdata->mgr;
+    unsigned i, last = mgr->buf_class_cnt - 1;
+    pj_ssize_t size = -1;
+
+    /* Reprint to the current buffer first, the message most likely
+     * still fits.
+     */
+    i = mgr->buf_class_hint;
+    if (tdata->buf_slab) {
+	size = pjsip_msg_print(tdata->msg, tdata->buf.start,
+			       tdata->buf.end - tdata->buf.start);
+	if (size < 0) {
+	    unsigned cur;
+
+	    if (tdata->buf_slab == mgr->buf_slab[last])
+		return PJSIP_EMSGTOOLONG;
+
+	    for (cur=0; mgr->buf_slab[cur] != tdata->buf_slab; ++cur)
+		;
+	    if (i <= cur)
+		i = cur + 1;
+	}
+    }
+
+    while (size < 0) {
+	char *buf;
+
+	if (i > last)
+	    i = last;
+
+	buf = (char*) pj_slab_alloc(mgr->buf_slab[i]);
+	if (!buf)
+	    return PJ_ENOMEM;
+
+	/* Reserve one byte for the NULL terminator */
+	size = pjsip_msg_print(tdata->msg, buf, mgr->buf_size[i] - 1);
+	if (size < 0) {
+	    pj_slab_free(mgr->buf_slab[i], buf);
+	    if (i == last)
+		return PJSIP_EMSGTOOLONG;
+	    i = last;
+	    continue;
+	}
+
+	release_tx_buf(tdata);
+	tdata->buf_slab = mgr->buf_slab[i];
+	tdata->slab_buf = buf;
+	tdata->buf.start = buf;
+	tdata->buf.end = buf + mgr->buf_size[i] - 1;
+
+	mgr->buf_class_hint = get_buf_class(mgr, size);
+    }
+
+    pj_assert(size != 0);
+    tdata->buf.cur = tdata->buf.start + size;
+    *tdata->buf.cur = '\0';
+
+    return PJ_SUCCESS;
+}
+#endif
+
 /*
  * Print the SIP message to transmit data buffer's internal buffer.
  */
 PJ_DEF(pj_status_t) pjsip_tx_data_encode(pjsip_tx_data *tdata)
 {
+#if PJSIP_HAS_SLAB_ALLOC
+    /* Use the print buffer of the transport manager, unless the buffer
+     * has been set by other means (e.g. raw data).
+     */
+    if (tdata->mgr->buf_class_cnt &&
+	(tdata->buf.start == NULL ||
+	 (tdata->buf_slab && tdata->buf.start == tdata->slab_buf)))
+    {
+	if (pjsip_tx_data_is_valid(tdata))
+	    return PJ_SUCCESS;
+
+	return encode_to_slab_buf(tdata);
+    }
+#endif
+
     /* Allocate buffer if necessary. */
     if (tdata->buf.start == NULL) {
 	PJ_USE_EXCEPTION;
@@ -1312,6 +1661,30 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
     }
 #endif
 
+#if PJSIP_HAS_SLAB_ALLOC
+    /* Transmit data will be allocated from the pool if this fails */
+    status = pj_slab_create(pool->factory, "tdslab%p",
+			    sizeof(pjsip_tx_data), 0, &mgr->tdata_slab);
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(3,(THIS_FILE, status, "Error creating transmit data slab"));
+	mgr->tdata_slab = NULL;
+    }
+
+    /* The cache keeps the pool of the transmit data, so it requires the
+     * transmit data to be allocated from the slab.
+     */
+    pj_list_init(&mgr->tdata_cache);
+    if (mgr->tdata_slab && PJSIP_TX_DATA_CACHE_SIZE > 0) {
+	status = pj_lock_create_simple_mutex(pool, "tdcache%p",
+					     &mgr->tdata_cache_lock);
+	if (status != PJ_SUCCESS)
+	    mgr->tdata_cache_lock = NULL;
+    }
+
+    /* Print buffer will be allocated from the pool if this fails */
+    create_tx_buf_slabs(mgr, pool->factory);
+#endif
+
     /* Set transport state callback */
     pjsip_tpmgr_set_state_cb(mgr, &tp_state_callback);
 
@@ -1560,6 +1933,9 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
     
     PJ_LOG(5, (THIS_FILE, "Destroying transport manager"));
 
+    /* Stop the worker threads before the transports are gone. */
+    pjsip_tpmgr_stop_rx_queue(mgr);
+
     pj_lock_acquire(mgr->lock);
 
     /*
@@ -1634,6 +2010,34 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
     pj_atomic_destroy(mgr->tdata_counter);
 #endif
 
+#if PJSIP_HAS_SLAB_ALLOC
+    /* Release the pools of cached transmit data. */
+    while (!pj_list_empty(&mgr->tdata_cache)) {
+	pjsip_tx_data *tdata = mgr->tdata_cache.next;
+	pj_list_erase(tdata);
+	pjsip_endpt_release_pool(mgr->endpt, tdata->pool);
+    }
+    mgr->tdata_cache_cnt = 0;
+
+    if (mgr->tdata_cache_lock) {
+	pj_lock_destroy(mgr->tdata_cache_lock);
+	mgr->tdata_cache_lock = NULL;
+    }
+
+    destroy_tx_buf_slabs(mgr);
+
+    if (mgr->tdata_slab) {
+	pj_slab_destroy(mgr->tdata_slab);
+	mgr->tdata_slab = NULL;
+    }
+#endif
+
+    if (mgr->rxq)
+	rx_queue_destroy(mgr);
+
+    if (mgr->rlim)
+	rate_limiter_destroy(mgr);
+
     pj_lock_destroy(mgr->lock);
 
     /* Unregister mod_msg_print. */
@@ -1645,6 +2049,1011 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
 }
 
 
+/*
+ * Parse a message which has been framed by pjsip_tpmgr_receive_packet()
+ * and give it to the endpoint.
+ */
+static void process_rx_msg( pjsip_tpmgr *mgr, pjsip_rx_data *rdata,
+			    char *pkt, pj_size_t msg_size)
+{
+    pjsip_msg *msg;
+    char saved;
+
+    /* Clear and init msg_info in rdata. */
+    pj_bzero(&rdata->msg_info, sizeof(rdata->msg_info));
+    pj_list_init(&rdata->msg_info.parse_err);
+    rdata->msg_info.msg_buf = pkt;
+    rdata->msg_info.len = (int)msg_size;
+
+    /* Null terminate packet */
+    saved = pkt[msg_size];
+    pkt[msg_size] = '\0';
+
+    /* Parse the message. */
+    rdata->msg_info.msg = msg = pjsip_parse_rdata(pkt, msg_size, rdata);
+
+    /* Restore null termination */
+    pkt[msg_size] = saved;
+
+    /* Check for parsing syntax error */
+    if (msg==NULL || !pj_list_empty(&rdata->msg_info.parse_err)) {
+	pjsip_parser_err_report *err;
+	char buf[128];
+	pj_str_t tmp;
+
+	/* Gather syntax error information */
+	tmp.ptr = buf; tmp.slen = 0;
+	err = rdata->msg_info.parse_err.next;
+	while (err != &rdata->msg_info.parse_err) {
+	    int len;
+	    len = pj_ansi_snprintf(tmp.ptr+tmp.slen, sizeof(buf)-tmp.slen,
+				   ": %s exception when parsing '%.*s' "
+				   "header on line %d col %d",
+				   pj_exception_id_name(err->except_code),
+				   (int)err->hname.slen, err->hname.ptr,
+				   err->line, err->col);
+	    if (len > 0 && len < (int) (sizeof(buf)-tmp.slen)) {
+		tmp.slen += len;
+	    }
+	    err = err->next;
+	}
+
+	/* Only print error message if there's error.
+	 * Sometimes we receive blank packets (packets with only CRLF)
+	 * which were sent to keep NAT bindings.
+	 */
+	if (tmp.slen) {
+	    PJ_LOG(1, (THIS_FILE, 
+		  "Error processing %d bytes packet from %s %s:%d %.*s:\n"
+		  "%.*s\n"
+		  "-- end of packet.",
+		  msg_size,
+		  rdata->tp_info.transport->type_name,
+		  rdata->pkt_info.src_name, 
+		  rdata->pkt_info.src_port,
+		  (int)tmp.slen, tmp.ptr,
+		  (int)msg_size,
+		  rdata->msg_info.msg_buf));
+	}
+
+	return;
+    }
+
+    /* Perform basic header checking. */
+    if (rdata->msg_info.cid == NULL ||
+	rdata->msg_info.cid->id.slen == 0 || 
+	rdata->msg_info.from == NULL || 
+	rdata->msg_info.to == NULL || 
+	rdata->msg_info.via == NULL || 
+	rdata->msg_info.cseq == NULL) 
+    {
+	mgr->on_rx_msg(mgr->endpt, PJSIP_EMISSINGHDR, rdata);
+	return;
+    }
+
+    /* For request: */
+    if (rdata->msg_info.msg->type == PJSIP_REQUEST_MSG) {
+	/* always add received parameter to the via. */
+	pj_strdup2(rdata->tp_info.pool, 
+		   &rdata->msg_info.via->recvd_param, 
+		   rdata->pkt_info.src_name);
+
+	/* RFC 3581:
+	 * If message contains "rport" param, put the received port there.
+	 */
+	if (rdata->msg_info.via->rport_param == 0) {
+	    rdata->msg_info.via->rport_param = rdata->pkt_info.src_port;
+	}
+    } else {
+	/* Drop malformed responses */
+	if (rdata->msg_info.msg->line.status.code < 100 ||
+	    rdata->msg_info.msg->line.status.code >= 700)
+	{
+	    mgr->on_rx_msg(mgr->endpt, PJSIP_EINVALIDSTATUS, rdata);
+	    return;
+	}
+    }
+
+    /* Drop response message if it has more than one Via.
+    */
+    /* This is wrong. Proxy DOES receive responses with multiple
+     * Via headers! Thanks Aldo <acampi at deis.unibo.it> for pointing
+     * this out.
+
+    if (msg->type == PJSIP_RESPONSE_MSG) {
+	pjsip_hdr *hdr;
+	hdr = (pjsip_hdr*)rdata->msg_info.via->next;
+	if (hdr != &msg->hdr) {
+	    hdr = pjsip_msg_find_hdr(msg, PJSIP_H_VIA, hdr);
+	    if (hdr) {
+		mgr->on_rx_msg(mgr->endpt, PJSIP_EMULTIPLEVIA, rdata);
+		return;
+	    }
+	}
+    }
+    */
+
+    /* Call the transport manager's upstream message callback.
+     */
+    mgr->on_rx_msg(mgr->endpt, PJ_SUCCESS, rdata);
+}
+
+/*****************************************************************************
+ *
+ * Receive queue.
+ *
+ *****************************************************************************/
+
+/* Check whether the line starts To header. */
+static pj_bool_t is_to_hdr(const char *p, const char *end)
+{
+    if (p == end || (*p != 'T' && *p != 't'))
+	return PJ_FALSE;
+    ++p;
+    if (p != end && (*p == 'o' || *p == 'O'))
+	++p;
+    while (p != end && (*p == ' ' || *p == '\t'))
+	++p;
+    return p != end && *p == ':';
+}
+
+/* Check whether the header value starting at p has tag parameter. The
+ * value ends at the end of line, unless the next line is a continuation.
+ */
+static pj_bool_t has_tag_param(const char *p, const char *end)
+{
+    pj_bool_t in_quote = PJ_FALSE, in_angle = PJ_FALSE;
+
+    for (; p != end; ++p) {
+	if (*p == '\n') {
+	    if (p+1 == end || (p[1] != ' ' && p[1] != '\t'))
+		break;
+	} else if (in_quote) {
+	    if (*p == '\\' && p+1 != end)
+		++p;
+	    else if (*p == '"')
+		in_quote = PJ_FALSE;
+	} else if (*p == '"') {
+	    in_quote = PJ_TRUE;
+	} else if (*p == '<') {
+	    in_angle = PJ_TRUE;
+	} else if (*p == '>') {
+	    in_angle = PJ_FALSE;
+	} else if (*p == ';' && !in_angle && end-p > 5 &&
+		   pj_ansi_strnicmp(p+1, "tag=", 4) == 0)
+	{
+	    return PJ_TRUE;
+	}
+    }
+    return PJ_FALSE;
+}
+
+/* Check whether the line starts Call-ID header, and return the start of
+ * the header value.
+ */
+static const char *get_call_id_value(const char *p, const char *end)
+{
+    if (end-p > 7 && pj_ansi_strnicmp(p, "Call-ID", 7) == 0)
+	p += 7;
+    else if (p != end && (*p == 'i' || *p == 'I'))
+	++p;
+    else
+	return NULL;
+    while (p != end && (*p == ' ' || *p == '\t'))
+	++p;
+    return (p != end && *p == ':') ? p+1 : NULL;
+}
+
+/* Calculate the hash value of Call-ID header value. */
+static pj_uint32_t calc_call_id_hash(const char *p, const char *end)
+{
+    const char *start;
+
+    while (p != end && (*p == ' ' || *p == '\t'))
+	++p;
+    for (start=p; p != end && *p != '\r' && *p != '\n' && *p != ' ' &&
+		  *p != '\t'; ++p)
+	;
+    return pj_hash_calc(0, start, (unsigned)(p - start));
+}
+
+/* Find the priority class of a message without parsing it, and the hash
+ * value of its Call-ID if cid_hash is not NULL.
+ */
+static pjsip_rx_queue_prio rx_queue_classify(const char *pkt,
+					     pj_size_t size,
+					     pj_uint32_t *cid_hash)
+{
+    const char *p = pkt, *end = pkt + size;
+    pjsip_rx_queue_prio prio = PJSIP_RX_QUEUE_PRIO_CNT;
+    pj_bool_t need_cid = (cid_hash != NULL);
+
+    if (cid_hash)
+	*cid_hash = 0;
+
+    /* Response, ACK, BYE and CANCEL */
+    if ((size > 4 && (pj_memcmp(pkt, "SIP/", 4) == 0 ||
+		      pj_memcmp(pkt, "ACK ", 4) == 0 ||
+		      pj_memcmp(pkt, "BYE ", 4) == 0)) ||
+	(size > 7 && pj_memcmp(pkt, "CANCEL ", 7) == 0))
+    {
+	prio = PJSIP_RX_QUEUE_PRIO_HIGH;
+    }
+
+    /* Find To header to check for the tag, and Call-ID header */
+    while (prio == PJSIP_RX_QUEUE_PRIO_CNT || need_cid) {
+	const char *value;
+
+	while (p != end && *p != '\n')
+	    ++p;
+	if (p == end)
+	    break;
+	++p;
+
+	/* End of headers */
+	if (p == end || *p == '\r' || *p == '\n')
+	    break;
+
+	if (prio == PJSIP_RX_QUEUE_PRIO_CNT && is_to_hdr(p, end)) {
+	    prio = has_tag_param(p, end) ? PJSIP_RX_QUEUE_PRIO_DIALOG :
+					   PJSIP_RX_QUEUE_PRIO_NEW;
+	} else if (need_cid && (value=get_call_id_value(p, end)) != NULL) {
+	    *cid_hash = calc_call_id_hash(value, end);
+	    need_cid = PJ_FALSE;
+	}
+    }
+
+    if (prio == PJSIP_RX_QUEUE_PRIO_CNT)
+	prio = PJSIP_RX_QUEUE_PRIO_NEW;
+
+    return prio;
+}
+
+/* Release the message of the queue item, and reset its pool. */
+static void rx_queue_item_reset(rx_queue_item *item)
+{
+    if (item->rdata) {
+	pjsip_transport_dec_ref(item->rdata->tp_info.transport);
+	item->rdata = NULL;
+	pj_pool_reset(item->pool);
+    }
+}
+
+/* Put a message to the receive queue. Returns PJ_FALSE if the message was
+ * not queued and must be processed by the caller.
+ */
+static pj_bool_t rx_queue_push(pjsip_tpmgr *mgr, pjsip_rx_data *rdata,
+			       char *pkt, pj_size_t size)
+{
+    rx_queue *rxq = mgr->rxq;
+    rx_queue_item *item = NULL;
+    rx_queue_shard *shard;
+    pjsip_rx_queue_prio prio;
+    pj_uint32_t cid_hash = 0;
+    pjsip_rx_data *r;
+    unsigned j;
+    int i;
+
+    /* The Call-ID is only needed when messages are pinned to workers */
+    prio = rx_queue_classify(pkt, size,
+			     (rxq->shard_cnt > 1 ? &cid_hash : NULL));
+
+    pj_lock_acquire(rxq->lock);
+
+    if (!rxq->enabled) {
+	pj_lock_release(rxq->lock);
+	return PJ_FALSE;
+    }
+
+    if (rxq->stat.len >= rxq->max_len) {
+	/* Queue is full, take over the newest message of the lowest
+	 * priority, from any worker's queue.
+	 */
+	for (i=PJSIP_RX_QUEUE_PRIO_CNT-1; i>(int)prio && !item; --i) {
+	    for (j=0; j<rxq->shard_cnt; ++j) {
+		shard = &rxq->shards[j];
+		if (!pj_list_empty(&shard->queue[i])) {
+		    item = shard->queue[i].prev;
+		    pj_list_erase(item);
+		    --rxq->stat.len;
+		    ++rxq->stat.dropped_cnt[i];
+		    break;
+		}
+	    }
+	}
+
+	if (!item) {
+	    ++rxq->stat.dropped_cnt[prio];
+	    pj_lock_release(rxq->lock);
+
+	    PJ_LOG(4,(THIS_FILE, "Receive queue is full, dropping %d bytes "
+		      "packet from %s:%d", (int)size, rdata->pkt_info.src_name,
+		      rdata->pkt_info.src_port));
+	    return PJ_TRUE;
+	}
+    } else if (!pj_list_empty(&rxq->free_list)) {
+	item = rxq->free_list.next;
+	pj_list_erase(item);
+    } else {
+	item = PJ_POOL_ZALLOC_T(rxq->pool, rx_queue_item);
+    }
+
+    pj_lock_release(rxq->lock);
+
+    if (item->pool == NULL) {
+	item->pool = pjsip_endpt_create_pool(mgr->endpt, "rxq%p",
+					     sizeof(pjsip_rx_data) +
+						PJSIP_POOL_RDATA_LEN,
+					     PJSIP_POOL_RDATA_INC);
+	if (!item->pool) {
+	    pj_lock_acquire(rxq->lock);
+	    pj_list_push_back(&rxq->free_list, item);
+	    pj_lock_release(rxq->lock);
+	    return PJ_FALSE;
+	}
+    }
+
+    rx_queue_item_reset(item);
+
+    /* Copy the message, since the transport reuses its buffer */
+    r = PJ_POOL_ZALLOC_T(item->pool, pjsip_rx_data);
+    r->tp_info.pool = item->pool;
+    r->tp_info.transport = rdata->tp_info.transport;
+    r->tp_info.tp_data = rdata->tp_info.tp_data;
+    r->tp_info.op_key.rdata = r;
+    r->pkt_info.timestamp = rdata->pkt_info.timestamp;
+    pj_memcpy(r->pkt_info.packet, pkt, size);
+    r->pkt_info.packet[size] = '\0';
+    r->pkt_info.len = size;
+    pj_memcpy(&r->pkt_info.src_addr, &rdata->pkt_info.src_addr,
+	      rdata->pkt_info.src_addr_len);
+    r->pkt_info.src_addr_len = rdata->pkt_info.src_addr_len;
+    pj_ansi_strcpy(r->pkt_info.src_name, rdata->pkt_info.src_name);
+    r->pkt_info.src_port = rdata->pkt_info.src_port;
+
+    pjsip_transport_add_ref(r->tp_info.transport);
+    item->rdata = r;
+
+    pj_lock_acquire(rxq->lock);
+
+    /* The queue may have been stopped (and restarted with different
+     * workers) while the message was being copied.
+     */
+    if (!rxq->enabled) {
+	pj_lock_release(rxq->lock);
+
+	rx_queue_item_reset(item);
+
+	pj_lock_acquire(rxq->lock);
+	pj_list_push_back(&rxq->free_list, item);
+	pj_lock_release(rxq->lock);
+	return PJ_FALSE;
+    }
+
+    /* Select the worker now, the number of workers may have changed while
+     * the message was being copied.
+     */
+    shard = &rxq->shards[rxq->shard_cnt > 1 ? cid_hash % rxq->shard_cnt : 0];
+    pj_list_push_back(&shard->queue[prio], item);
+    if (++rxq->stat.len > rxq->stat.max_len)
+	rxq->stat.max_len = rxq->stat.len;
+    ++rxq->stat.queued_cnt[prio];
+    pj_lock_release(rxq->lock);
+
+    pj_sem_post(shard->sem);
+
+    return PJ_TRUE;
+}
+
+/* Worker thread of the receive queue. */
+static int PJ_THREAD_FUNC rx_queue_worker(void *arg)
+{
+    rx_queue_shard *shard = (rx_queue_shard*) arg;
+    pjsip_tpmgr *mgr = shard->mgr;
+    rx_queue *rxq = mgr->rxq;
+
+    for (;;) {
+	rx_queue_item *item = NULL;
+	pjsip_rx_data *rdata;
+	unsigned i;
+
+	pj_sem_wait(shard->sem);
+
+	pj_lock_acquire(rxq->lock);
+	if (rxq->quit) {
+	    pj_lock_release(rxq->lock);
+	    break;
+	}
+	for (i=0; i<PJSIP_RX_QUEUE_PRIO_CNT; ++i) {
+	    if (!pj_list_empty(&shard->queue[i])) {
+		item = shard->queue[i].next;
+		pj_list_erase(item);
+		--rxq->stat.len;
+		break;
+	    }
+	}
+	pj_lock_release(rxq->lock);
+
+	/* The message may have been dropped to make room for another */
+	if (!item)
+	    continue;
+
+	rdata = item->rdata;
+	process_rx_msg(mgr, rdata, rdata->pkt_info.packet,
+		       rdata->pkt_info.len);
+
+	rx_queue_item_reset(item);
+
+	pj_lock_acquire(rxq->lock);
+	pj_list_push_back(&rxq->free_list, item);
+	pj_lock_release(rxq->lock);
+    }
+
+    return 0;
+}
+
+/* Create the receive queue. */
+static pj_status_t rx_queue_create(pjsip_tpmgr *mgr)
+{
+    rx_queue *rxq;
+    pj_pool_t *pool;
+    pj_status_t status;
+
+    pool = pjsip_endpt_create_pool(mgr->endpt, "rxq%p", 512, 512);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    rxq = PJ_POOL_ZALLOC_T(pool, rx_queue);
+    rxq->pool = pool;
+    pj_list_init(&rxq->free_list);
+
+    status = pj_lock_create_simple_mutex(pool, "rxq%p", &rxq->lock);
+    if (status != PJ_SUCCESS) {
+	pjsip_endpt_release_pool(mgr->endpt, pool);
+	return status;
+    }
+
+    mgr->rxq = rxq;
+    return PJ_SUCCESS;
+}
+
+/* Make room for the worker threads and their queues. The receive queue
+ * must have been stopped.
+ */
+static pj_status_t rx_queue_grow(pjsip_tpmgr *mgr, unsigned cnt)
+{
+    rx_queue *rxq = mgr->rxq;
+    rx_queue_shard *shards;
+    unsigned i, j;
+    pj_status_t status;
+
+    if (cnt <= rxq->thread_cap)
+	return PJ_SUCCESS;
+
+    shards = (rx_queue_shard*)
+	     pj_pool_calloc(rxq->pool, cnt, sizeof(rx_queue_shard));
+    for (i=0; i<cnt; ++i) {
+	shards[i].mgr = mgr;
+	for (j=0; j<PJSIP_RX_QUEUE_PRIO_CNT; ++j)
+	    pj_list_init(&shards[i].queue[j]);
+
+	/* Keep the semaphores of the existing queues */
+	if (i < rxq->thread_cap) {
+	    shards[i].sem = rxq->shards[i].sem;
+	    continue;
+	}
+
+	status = pj_sem_create(rxq->pool, "rxq%p", 0, PJ_MAXINT32,
+			       &shards[i].sem);
+	if (status != PJ_SUCCESS) {
+	    while (i-- > rxq->thread_cap)
+		pj_sem_destroy(shards[i].sem);
+	    return status;
+	}
+    }
+
+    rxq->threads = (pj_thread_t**)
+		   pj_pool_calloc(rxq->pool, cnt, sizeof(pj_thread_t*));
+    rxq->shards = shards;
+    rxq->thread_cap = cnt;
+
+    return PJ_SUCCESS;
+}
+
+/* Destroy the receive queue. It must have been stopped. */
+static void rx_queue_destroy(pjsip_tpmgr *mgr)
+{
+    rx_queue *rxq = mgr->rxq;
+    unsigned i, j;
+
+    /* Stopping the queue has discarded the queued messages, and no message
+     * is queued once the queue is stopped. Just in case, release whatever
+     * is left, without the transports which have been destroyed by now.
+     */
+    for (i=0; i<rxq->thread_cap; ++i) {
+	for (j=0; j<PJSIP_RX_QUEUE_PRIO_CNT; ++j) {
+	    rx_queue_item *q = &rxq->shards[i].queue[j];
+
+	    pj_assert(pj_list_empty(q));
+	    while (!pj_list_empty(q)) {
+		rx_queue_item *item = q->next;
+		pj_list_erase(item);
+		item->rdata = NULL;
+		pj_list_push_back(&rxq->free_list, item);
+	    }
+	}
+    }
+
+    while (!pj_list_empty(&rxq->free_list)) {
+	rx_queue_item *item = rxq->free_list.next;
+	pj_list_erase(item);
+	if (item->pool)
+	    pjsip_endpt_release_pool(mgr->endpt, item->pool);
+    }
+
+    for (i=0; i<rxq->thread_cap; ++i)
+	pj_sem_destroy(rxq->shards[i].sem);
+    pj_lock_destroy(rxq->lock);
+    mgr->rxq = NULL;
+    pjsip_endpt_release_pool(mgr->endpt, rxq->pool);
+}
+
+/*
+ * pjsip_rx_queue_cfg_default()
+ */
+PJ_DEF(void) pjsip_rx_queue_cfg_default(pjsip_rx_queue_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->worker_cnt = PJSIP_RX_QUEUE_WORKER_CNT;
+    cfg->max_len = PJSIP_RX_QUEUE_MAX_LEN;
+}
+
+/*
+ * pjsip_tpmgr_start_rx_queue()
+ */
+PJ_DEF(pj_status_t) pjsip_tpmgr_start_rx_queue(pjsip_tpmgr *mgr,
+					       const pjsip_rx_queue_cfg *cfg)
+{
+    pjsip_rx_queue_cfg default_cfg;
+    rx_queue *rxq;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(mgr, PJ_EINVAL);
+
+    if (!cfg) {
+	pjsip_rx_queue_cfg_default(&default_cfg);
+	cfg = &default_cfg;
+    }
+    PJ_ASSERT_RETURN(cfg->worker_cnt > 0 && cfg->max_len > 0, PJ_EINVAL);
+
+    if (!mgr->rxq) {
+	status = rx_queue_create(mgr);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+    rxq = mgr->rxq;
+
+    PJ_ASSERT_RETURN(rxq->thread_cnt == 0, PJ_EEXISTS);
+
+    status = rx_queue_grow(mgr, cfg->worker_cnt);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    rxq->max_len = cfg->max_len;
+    rxq->shard_cnt = cfg->pin_call_id ? cfg->worker_cnt : 1;
+    rxq->quit = PJ_FALSE;
+
+    for (i=0; i<cfg->worker_cnt; ++i) {
+	status = pj_thread_create(rxq->pool, "sipworker%p", &rx_queue_worker,
+				  &rxq->shards[i % rxq->shard_cnt], 0, 0,
+				  &rxq->threads[i]);
+	if (status != PJ_SUCCESS) {
+	    pjsip_tpmgr_stop_rx_queue(mgr);
+	    return status;
+	}
+	++rxq->thread_cnt;
+    }
+
+    pj_lock_acquire(rxq->lock);
+    rxq->enabled = PJ_TRUE;
+    pj_lock_release(rxq->lock);
+
+    PJ_LOG(4,(THIS_FILE, "Receive queue started with %d worker threads%s",
+	      rxq->thread_cnt,
+	      (rxq->shard_cnt > 1 ? ", pinned by Call-ID" : "")));
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pjsip_tpmgr_stop_rx_queue()
+ */
+PJ_DEF(void) pjsip_tpmgr_stop_rx_queue(pjsip_tpmgr *mgr)
+{
+    rx_queue *rxq;
+    rx_queue_item discarded;
+    unsigned i, j;
+
+    PJ_ASSERT_ON_FAIL(mgr, return);
+
+    rxq = mgr->rxq;
+    if (!rxq || rxq->thread_cnt == 0)
+	return;
+
+    pj_lock_acquire(rxq->lock);
+    rxq->enabled = PJ_FALSE;
+    rxq->quit = PJ_TRUE;
+    pj_lock_release(rxq->lock);
+
+    for (i=0; i<rxq->thread_cnt; ++i)
+	pj_sem_post(rxq->shards[i % rxq->shard_cnt].sem);
+
+    for (i=0; i<rxq->thread_cnt; ++i) {
+	pj_thread_join(rxq->threads[i]);
+	pj_thread_destroy(rxq->threads[i]);
+	rxq->threads[i] = NULL;
+    }
+    rxq->thread_cnt = 0;
+
+    /* Discard the messages which have not been processed */
+    pj_list_init(&discarded);
+    pj_lock_acquire(rxq->lock);
+    for (i=0; i<rxq->shard_cnt; ++i) {
+	for (j=0; j<PJSIP_RX_QUEUE_PRIO_CNT; ++j)
+	    pj_list_merge_last(&discarded, &rxq->shards[i].queue[j]);
+    }
+    rxq->stat.len = 0;
+    pj_lock_release(rxq->lock);
+
+    if (!pj_list_empty(&discarded)) {
+	PJ_LOG(4,(THIS_FILE, "Receive queue stopped, discarding %d messages",
+		  (int)pj_list_size(&discarded)));
+    }
+
+    while (!pj_list_empty(&discarded)) {
+	rx_queue_item *item = discarded.next;
+	pj_list_erase(item);
+	rx_queue_item_reset(item);
+
+	pj_lock_acquire(rxq->lock);
+	pj_list_push_back(&rxq->free_list, item);
+	pj_lock_release(rxq->lock);
+    }
+
+    /* Drain the semaphores, so that the next workers start from zero */
+    for (i=0; i<rxq->shard_cnt; ++i) {
+	while (pj_sem_trywait(rxq->shards[i].sem) == PJ_SUCCESS)
+	    ;
+    }
+}
+
+/*
+ * pjsip_tpmgr_get_rx_queue_stat()
+ */
+PJ_DEF(pj_status_t) pjsip_tpmgr_get_rx_queue_stat(pjsip_tpmgr *mgr,
+						  pjsip_rx_queue_stat *stat)
+{
+    PJ_ASSERT_RETURN(mgr && stat, PJ_EINVAL);
+
+    if (!mgr->rxq)
+	return PJ_ENOTFOUND;
+
+    pj_lock_acquire(mgr->rxq->lock);
+    pj_memcpy(stat, &mgr->rxq->stat, sizeof(*stat));
+    pj_lock_release(mgr->rxq->lock);
+
+    return PJ_SUCCESS;
+}
+
+/* Set the bucket size and rate of a budget, and fill the bucket. */
+static void rate_limit_bucket_init(rate_limit_bucket *b,
+				   const pjsip_rate_limit_budget *budget)
+{
+    b->rate = budget->rate;
+    b->max_tokens = (budget->burst ? budget->burst : budget->rate) * 1000;
+    b->tokens = b->max_tokens;
+}
+
+/* Add the tokens earned in the elapsed time to a bucket. */
+static void rate_limit_bucket_refill(rate_limit_bucket *b,
+				     pj_uint32_t elapsed)
+{
+    pj_uint64_t tokens;
+
+    tokens = (pj_uint64_t)b->tokens + (pj_uint64_t)elapsed * b->rate;
+    b->tokens = (tokens > b->max_tokens) ? b->max_tokens : (pj_uint32_t)tokens;
+}
+
+/* Get the index of the per-method budget of a request, or -1 if there
+ * is none.
+ */
+static int rate_limit_find_method(const rate_limiter *rlim,
+				  const char *pkt, pj_size_t size)
+{
+    pj_str_t name;
+    unsigned i;
+
+    name.ptr = (char*)pkt;
+    for (name.slen=0; name.slen < (pj_ssize_t)size &&
+		      pkt[name.slen] != ' '; ++name.slen)
+	;
+
+    for (i=0; i<rlim->cfg.method_cnt; ++i) {
+	if (pj_strcmp(&rlim->cfg.method[i].method, &name) == 0)
+	    return i;
+    }
+    return -1;
+}
+
+/* Find the entry of a source address, or create it, forgetting the least
+ * recently seen source when the table is full. The rate limiter must be
+ * locked.
+ */
+static rate_limit_source *rate_limit_get_source(rate_limiter *rlim,
+						const pjsip_rx_data *rdata,
+						pj_uint32_t now)
+{
+    const pj_sockaddr *addr = &rdata->pkt_info.src_addr;
+    rate_limit_source *src;
+    const void *key;
+    unsigned keylen, i;
+    pj_uint32_t hval = 0;
+
+    key = pj_sockaddr_get_addr(addr);
+    keylen = pj_sockaddr_get_addr_len(addr);
+
+    src = (rate_limit_source*) pj_hash_get(rlim->table, key, keylen, &hval);
+    if (src) {
+	pj_list_erase(src);
+	pj_list_push_front(&rlim->lru, src);
+	return src;
+    }
+
+    if (!pj_list_empty(&rlim->free_list)) {
+	src = rlim->free_list.next;
+	pj_list_erase(src);
+	++rlim->stat.source_cnt;
+    } else {
+	src = rlim->lru.prev;
+	pj_list_erase(src);
+	pj_hash_set_np(rlim->table, src->key, src->keylen, 0, src->hentry,
+		       NULL);
+	++rlim->stat.evicted_cnt;
+    }
+
+    pj_memcpy(src->key, key, keylen);
+    src->keylen = keylen;
+    pj_ansi_strncpy(src->name, rdata->pkt_info.src_name, sizeof(src->name));
+    src->name[sizeof(src->name)-1] = '\0';
+    src->last_refill = now;
+    src->dropped_cnt = 0;
+    rate_limit_bucket_init(&src->all, &rlim->cfg.all);
+    for (i=0; i<rlim->cfg.method_cnt; ++i)
+	rate_limit_bucket_init(&src->method[i], &rlim->cfg.method[i]);
+
+    pj_hash_set_np(rlim->table, src->key, keylen, hval, src->hentry, src);
+    pj_list_push_front(&rlim->lru, src);
+
+    return src;
+}
+
+/* Check whether a framed message may be processed, i.e. it is a response
+ * or a request within the budgets of its source, and take its tokens.
+ */
+static pj_bool_t rate_limit_check(pjsip_tpmgr *mgr, pjsip_rx_data *rdata,
+				  const char *pkt, pj_size_t size)
+{
+    rate_limiter *rlim = mgr->rlim;
+    rate_limit_source *src;
+    const pj_time_val *ts = &rdata->pkt_info.timestamp;
+    pj_time_val now_tv;
+    pj_uint32_t now, elapsed;
+    int method_idx;
+    pj_bool_t pass;
+    unsigned i;
+
+    /* Responses are not limited */
+    if (size >= 4 && pj_ansi_strnicmp(pkt, "SIP/", 4) == 0)
+	return PJ_TRUE;
+
+    if (ts->sec == 0 && ts->msec == 0) {
+	pj_gettimeofday(&now_tv);
+	ts = &now_tv;
+    }
+    now = (pj_uint32_t)(ts->sec * 1000 + ts->msec);
+
+    pj_lock_acquire(rlim->lock);
+
+    if (!rlim->enabled) {
+	pj_lock_release(rlim->lock);
+	return PJ_TRUE;
+    }
+
+    method_idx = rate_limit_find_method(rlim, pkt, size);
+    src = rate_limit_get_source(rlim, rdata, now);
+
+    /* Ignore the time going backwards */
+    elapsed = now - src->last_refill;
+    if ((pj_int32_t)elapsed > 0) {
+	rate_limit_bucket_refill(&src->all, elapsed);
+	for (i=0; i<rlim->cfg.method_cnt; ++i)
+	    rate_limit_bucket_refill(&src->method[i], elapsed);
+    }
+    src->last_refill = now;
+
+    pass = PJ_TRUE;
+    if (src->all.rate && src->all.tokens < 1000)
+	pass = PJ_FALSE;
+    if (method_idx >= 0 && src->method[method_idx].rate &&
+	src->method[method_idx].tokens < 1000)
+    {
+	++rlim->stat.method_dropped_cnt[method_idx];
+	pass = PJ_FALSE;
+    }
+
+    if (pass) {
+	if (src->all.rate)
+	    src->all.tokens -= 1000;
+	if (method_idx >= 0 && src->method[method_idx].rate)
+	    src->method[method_idx].tokens -= 1000;
+	++rlim->stat.passed_cnt;
+    } else {
+	++src->dropped_cnt;
+	++rlim->stat.dropped_cnt;
+    }
+
+    pj_lock_release(rlim->lock);
+
+    if (!pass) {
+	PJ_LOG(5,(THIS_FILE, "Dropping request from %s:%d, rate limit "
+		  "exceeded", rdata->pkt_info.src_name,
+		  rdata->pkt_info.src_port));
+    }
+
+    return pass;
+}
+
+/* Create the rate limiter. */
+static pj_status_t rate_limiter_create(pjsip_tpmgr *mgr)
+{
+    rate_limiter *rlim;
+    pj_pool_t *pool;
+    pj_status_t status;
+
+    pool = pjsip_endpt_create_pool(mgr->endpt, "rlim%p", 512, 512);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    rlim = PJ_POOL_ZALLOC_T(pool, rate_limiter);
+    rlim->pool = pool;
+    pj_list_init(&rlim->lru);
+    pj_list_init(&rlim->free_list);
+
+    status = pj_lock_create_simple_mutex(pool, "rlim%p", &rlim->lock);
+    if (status != PJ_SUCCESS) {
+	pjsip_endpt_release_pool(mgr->endpt, pool);
+	return status;
+    }
+
+    mgr->rlim = rlim;
+    return PJ_SUCCESS;
+}
+
+/* Destroy the rate limiter. */
+static void rate_limiter_destroy(pjsip_tpmgr *mgr)
+{
+    rate_limiter *rlim = mgr->rlim;
+
+    pj_lock_destroy(rlim->lock);
+    mgr->rlim = NULL;
+    pjsip_endpt_release_pool(mgr->endpt, rlim->pool);
+}
+
+/*
+ * pjsip_rate_limit_cfg_default()
+ */
+PJ_DEF(void) pjsip_rate_limit_cfg_default(pjsip_rate_limit_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->max_sources = PJSIP_RATE_LIMIT_MAX_SOURCES;
+    cfg->all.rate = PJSIP_RATE_LIMIT_RATE;
+    cfg->all.burst = PJSIP_RATE_LIMIT_BURST;
+}
+
+/*
+ * pjsip_tpmgr_set_rate_limit()
+ */
+PJ_DEF(pj_status_t) pjsip_tpmgr_set_rate_limit(pjsip_tpmgr *mgr,
+					const pjsip_rate_limit_cfg *cfg)
+{
+    rate_limiter *rlim;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(mgr, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!cfg || (cfg->max_sources > 0 &&
+			      cfg->method_cnt <= PJSIP_RATE_LIMIT_MAX_METHODS),
+		     PJ_EINVAL);
+
+    if (!cfg) {
+	if (mgr->rlim) {
+	    pj_lock_acquire(mgr->rlim->lock);
+	    mgr->rlim->enabled = PJ_FALSE;
+	    pj_lock_release(mgr->rlim->lock);
+	}
+	return PJ_SUCCESS;
+    }
+
+    if (!mgr->rlim) {
+	status = rate_limiter_create(mgr);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+    rlim = mgr->rlim;
+
+    pj_lock_acquire(rlim->lock);
+
+    /* Memory of a smaller table is reused, the pool only grows when a
+     * bigger one is needed.
+     */
+    if (cfg->max_sources > rlim->source_cap) {
+	rlim->sources = (rate_limit_source*)
+			pj_pool_calloc(rlim->pool, cfg->max_sources,
+				       sizeof(rate_limit_source));
+	rlim->table = pj_hash_create(rlim->pool, cfg->max_sources);
+	rlim->source_cap = cfg->max_sources;
+    } else {
+	pj_hash_iterator_t itr_val;
+	pj_hash_iterator_t *itr;
+
+	while ((itr = pj_hash_first(rlim->table, &itr_val)) != NULL) {
+	    rate_limit_source *src;
+	    src = (rate_limit_source*) pj_hash_this(rlim->table, itr);
+	    pj_hash_set_np(rlim->table, src->key, src->keylen, 0,
+			   src->hentry, NULL);
+	}
+    }
+
+    pj_list_init(&rlim->lru);
+    pj_list_init(&rlim->free_list);
+    for (i=0; i<cfg->max_sources; ++i)
+	pj_list_push_back(&rlim->free_list, &rlim->sources[i]);
+
+    pj_memcpy(&rlim->cfg, cfg, sizeof(*cfg));
+    for (i=0; i<cfg->method_cnt; ++i)
+	pj_strdup(rlim->pool, &rlim->cfg.method[i].method,
+		  &cfg->method[i].method);
+
+    rlim->stat.source_cnt = 0;
+    rlim->enabled = PJ_TRUE;
+
+    pj_lock_release(rlim->lock);
+
+    PJ_LOG(4,(THIS_FILE, "Rate limiting enabled, %u requests/s per source",
+	      cfg->all.rate));
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pjsip_tpmgr_get_rate_limit_stat()
+ */
+PJ_DEF(pj_status_t) pjsip_tpmgr_get_rate_limit_stat(pjsip_tpmgr *mgr,
+						pjsip_rate_limit_stat *stat)
+{
+    PJ_ASSERT_RETURN(mgr && stat, PJ_EINVAL);
+
+    if (!mgr->rlim)
+	return PJ_ENOTFOUND;
+
+    pj_lock_acquire(mgr->rlim->lock);
+    pj_memcpy(stat, &mgr->rlim->stat, sizeof(*stat));
+    pj_lock_release(mgr->rlim->lock);
+
+    return PJ_SUCCESS;
+}
+
 /*
  * pjsip_tpmgr_receive_packet()
  *
@@ -1678,9 +3087,7 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
     /* Process all message fragments. */
     while (remaining_len > 0) {
 
-	pjsip_msg *msg;
 	char *p, *end;
-	char saved;
 	pj_size_t msg_fragment_size;
 
 	/* Skip leading newlines as pjsip_find_msg() currently can't
@@ -1728,124 +3135,25 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
 	    }
 	}
 
-	/* Update msg_info. */
-	rdata->msg_info.len = (int)msg_fragment_size;
-
-	/* Null terminate packet */
-	saved = current_pkt[msg_fragment_size];
-	current_pkt[msg_fragment_size] = '\0';
-
-	/* Parse the message. */
-	rdata->msg_info.msg = msg = 
-	    pjsip_parse_rdata( current_pkt, msg_fragment_size, rdata);
-
-	/* Restore null termination */
-	current_pkt[msg_fragment_size] = saved;
-
-	/* Check for parsing syntax error */
-	if (msg==NULL || !pj_list_empty(&rdata->msg_info.parse_err)) {
-	    pjsip_parser_err_report *err;
-	    char buf[128];
-	    pj_str_t tmp;
-
-	    /* Gather syntax error information */
-	    tmp.ptr = buf; tmp.slen = 0;
-	    err = rdata->msg_info.parse_err.next;
-	    while (err != &rdata->msg_info.parse_err) {
-		int len;
-		len = pj_ansi_snprintf(tmp.ptr+tmp.slen, sizeof(buf)-tmp.slen,
-				       ": %s exception when parsing '%.*s' "
-				       "header on line %d col %d",
-				       pj_exception_id_name(err->except_code),
-				       (int)err->hname.slen, err->hname.ptr,
-				       err->line, err->col);
-		if (len > 0 && len < (int) (sizeof(buf)-tmp.slen)) {
-		    tmp.slen += len;
-		}
-		err = err->next;
-	    }
-
-	    /* Only print error message if there's error.
-	     * Sometimes we receive blank packets (packets with only CRLF)
-	     * which were sent to keep NAT bindings.
-	     */
-	    if (tmp.slen) {
-		PJ_LOG(1, (THIS_FILE, 
-		      "Error processing %d bytes packet from %s %s:%d %.*s:\n"
-		      "%.*s\n"
-		      "-- end of packet.",
-		      msg_fragment_size,
-		      rdata->tp_info.transport->type_name,
-		      rdata->pkt_info.src_name, 
-		      rdata->pkt_info.src_port,
-		      (int)tmp.slen, tmp.ptr,
-		      (int)msg_fragment_size,
-		      rdata->msg_info.msg_buf));
-	    }
-
-	    goto finish_process_fragment;
-	}
-
-	/* Perform basic header checking. */
-	if (rdata->msg_info.cid == NULL ||
-	    rdata->msg_info.cid->id.slen == 0 || 
-	    rdata->msg_info.from == NULL || 
-	    rdata->msg_info.to == NULL || 
-	    rdata->msg_info.via == NULL || 
-	    rdata->msg_info.cseq == NULL) 
+	/* Drop requests from sources which have exceeded their budget */
+	if (mgr->rlim &&
+	    !rate_limit_check(mgr, rdata, current_pkt, msg_fragment_size))
 	{
-	    mgr->on_rx_msg(mgr->endpt, PJSIP_EMISSINGHDR, rdata);
-	    goto finish_process_fragment;
+	    total_processed += msg_fragment_size;
+	    current_pkt += msg_fragment_size;
+	    remaining_len -= msg_fragment_size;
+	    continue;
 	}
 
-	/* For request: */
-	if (rdata->msg_info.msg->type == PJSIP_REQUEST_MSG) {
-	    /* always add received parameter to the via. */
-	    pj_strdup2(rdata->tp_info.pool, 
-		       &rdata->msg_info.via->recvd_param, 
-		       rdata->pkt_info.src_name);
-
-	    /* RFC 3581:
-	     * If message contains "rport" param, put the received port there.
-	     */
-	    if (rdata->msg_info.via->rport_param == 0) {
-		rdata->msg_info.via->rport_param = rdata->pkt_info.src_port;
-	    }
-	} else {
-	    /* Drop malformed responses */
-	    if (rdata->msg_info.msg->line.status.code < 100 ||
-		rdata->msg_info.msg->line.status.code >= 700)
-	    {
-		mgr->on_rx_msg(mgr->endpt, PJSIP_EINVALIDSTATUS, rdata);
-		goto finish_process_fragment;
-	    }
-	}
-
-	/* Drop response message if it has more than one Via.
-	*/
-	/* This is wrong. Proxy DOES receive responses with multiple
-	 * Via headers! Thanks Aldo <acampi at deis.unibo.it> for pointing
-	 * this out.
-
-	if (msg->type == PJSIP_RESPONSE_MSG) {
-	    pjsip_hdr *hdr;
-	    hdr = (pjsip_hdr*)rdata->msg_info.via->next;
-	    if (hdr != &msg->hdr) {
-		hdr = pjsip_msg_find_hdr(msg, PJSIP_H_VIA, hdr);
-		if (hdr) {
-		    mgr->on_rx_msg(mgr->endpt, PJSIP_EMULTIPLEVIA, rdata);
-		    goto finish_process_fragment;
-		}
-	    }
-	}
-	*/
-
-	/* Call the transport manager's upstream message callback.
+	/* Queue the message to be processed by the worker threads, or
+	 * process it now.
 	 */
-	mgr->on_rx_msg(mgr->endpt, PJ_SUCCESS, rdata);
-
+	if (mgr->rxq == NULL ||
+	    !rx_queue_push(mgr, rdata, current_pkt, msg_fragment_size))
+	{
+	    process_rx_msg(mgr, rdata, current_pkt, msg_fragment_size);
+	}
 
-finish_process_fragment:
 	total_processed += msg_fragment_size;
 	current_pkt += msg_fragment_size;
 	remaining_len -= msg_fragment_size;
@@ -2097,6 +3405,48 @@ PJ_DEF(void) pjsip_tpmgr_dump_transports(pjsip_tpmgr *mgr)
 	} while (itr);
     }
 
+    if (mgr->rxq) {
+	pjsip_rx_queue_stat st;
+
+	pjsip_tpmgr_get_rx_queue_stat(mgr, &st);
+	PJ_LOG(3, (THIS_FILE, " Receive queue: %u messages (max %u), "
+		   "queued/dropped: high=%u/%u dialog=%u/%u new=%u/%u",
+		   st.len, st.max_len,
+		   st.queued_cnt[PJSIP_RX_QUEUE_PRIO_HIGH],
+		   st.dropped_cnt[PJSIP_RX_QUEUE_PRIO_HIGH],
+		   st.queued_cnt[PJSIP_RX_QUEUE_PRIO_DIALOG],
+		   st.dropped_cnt[PJSIP_RX_QUEUE_PRIO_DIALOG],
+		   st.queued_cnt[PJSIP_RX_QUEUE_PRIO_NEW],
+		   st.dropped_cnt[PJSIP_RX_QUEUE_PRIO_NEW]));
+    }
+
+    if (mgr->rlim) {
+	rate_limiter *rlim = mgr->rlim;
+	rate_limit_source *src;
+	unsigned i;
+
+	pj_lock_acquire(rlim->lock);
+	PJ_LOG(3, (THIS_FILE, " Rate limit%s: %u sources (%u evicted), "
+		   "passed=%u dropped=%u",
+		   (rlim->enabled ? "" : " [disabled]"),
+		   rlim->stat.source_cnt, rlim->stat.evicted_cnt,
+		   rlim->stat.passed_cnt, rlim->stat.dropped_cnt));
+	for (i=0; i<rlim->cfg.method_cnt; ++i) {
+	    PJ_LOG(3, (THIS_FILE, "  %.*s: %u/s, dropped=%u",
+		       (int)rlim->cfg.method[i].method.slen,
+		       rlim->cfg.method[i].method.ptr,
+		       rlim->cfg.method[i].rate,
+		       rlim->stat.method_dropped_cnt[i]));
+	}
+	for (src=rlim->lru.next; src!=&rlim->lru; src=src->next) {
+	    if (src->dropped_cnt) {
+		PJ_LOG(3, (THIS_FILE, "  %s: dropped=%u",
+			   src->name, src->dropped_cnt));
+	    }
+	}
+	pj_lock_release(rlim->lock);
+    }
+
     pj_lock_release(mgr->lock);
 #else
     PJ_UNUSED_ARG(mgr);
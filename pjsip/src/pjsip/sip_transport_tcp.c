@@ -56,7 +56,8 @@ struct tcp_listener
     pj_bool_t		     is_registered;
     pjsip_endpoint	    *endpt;
     pjsip_tpmgr		    *tpmgr;
-    pj_activesock_t	    *asock;
+    unsigned		     asock_cnt;
+    pj_activesock_t	   **asock;
     pj_sockaddr		     bound_addr;
     pj_qos_type		     qos_type;
     pj_qos_params	     qos_params;
@@ -119,6 +120,17 @@ struct tcp_transport
     /* Pending transmission list. */
     struct delayed_tdata     delayed_list;
 
+    /* Transmit queue. Messages sent while a write is in progress are
+     * queued, and then coalesced into one write once the write completes.
+     */
+    pj_bool_t		     tx_busy;
+    pj_ioqueue_op_key_t	    *tx_cur;
+    struct delayed_tdata     tx_queue;
+    struct delayed_tdata     tx_batch;
+    pjsip_tx_data_op_key     tx_op_key;
+    char		    *tx_buf;
+    pjsip_tp_tx_stat	     tx_stat;
+
     /* Group lock to be used by TCP transport and ioqueue key */
     pj_grp_lock_t	    *grp_lock;
 };
@@ -150,7 +162,7 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
 
 /* Common function to create and initialize transport */
 static pj_status_t tcp_create(struct tcp_listener *listener,
-			      pj_pool_t *pool,
+			      pj_pool_t *pool, pj_ioqueue_t *ioqueue,
 			      pj_sock_t sock, pj_bool_t is_server,
 			      const pj_sockaddr *local,
 			      const pj_sockaddr *remote,
@@ -233,10 +245,86 @@ PJ_DEF(void) pjsip_tcp_transport_cfg_default(pjsip_tcp_transport_cfg *cfg,
     cfg->af = af;
     pj_sockaddr_init(cfg->af, &cfg->bind_addr, NULL, 0);
     cfg->async_cnt = 1;
+    cfg->sock_cnt = 1;
     cfg->reuse_addr = PJSIP_TCP_TRANSPORT_REUSEADDR;
 }
 
 
+/*
+ * Create a listener socket, bind it to the address, and start listening.
+ * On return, addr contains the bound address.
+ */
+static pj_status_t create_listener_sock(struct tcp_listener *listener,
+					const pjsip_tcp_transport_cfg *cfg,
+					pj_bool_t reuse_port,
+					pj_sockaddr *addr,
+					pj_sock_t *p_sock)
+{
+    pj_sock_t sock;
+    int addr_len;
+    pj_status_t status;
+
+    /* Create socket */
+    status = pj_sock_socket(cfg->af, pj_SOCK_STREAM(), 0, &sock);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Apply QoS, if specified */
+    status = pj_sock_apply_qos2(sock, cfg->qos_type, &cfg->qos_params, 
+				2, listener->factory.obj_name, 
+				"SIP TCP listener socket");
+
+    /* Apply SO_REUSEADDR */
+    if (cfg->reuse_addr) {
+	int enabled = 1;
+	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEADDR(),
+				    &enabled, sizeof(enabled));
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(4,(listener->factory.obj_name, status,
+		         "Warning: error applying SO_REUSEADDR"));
+	}
+    }
+
+    /* Apply SO_REUSEPORT, which is mandatory since the other listener
+     * sockets could not be bound without it.
+     */
+    if (reuse_port) {
+	int enabled = 1;
+	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEPORT(),
+				    &enabled, sizeof(enabled));
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
+    /* Apply socket options, if specified */
+    if (cfg->sockopt_params.cnt)
+	status = pj_sock_setsockopt_params(sock, &cfg->sockopt_params);
+
+    /* Bind socket */
+    status = pj_sock_bind(sock, addr, pj_sockaddr_get_len(addr));
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Retrieve the bound address */
+    addr_len = pj_sockaddr_get_len(addr);
+    status = pj_sock_getsockname(sock, addr, &addr_len);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Start listening to the address */
+    status = pj_sock_listen(sock, PJSIP_TCP_TRANSPORT_BACKLOG);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    *p_sock = sock;
+    return PJ_SUCCESS;
+
+on_error:
+    pj_sock_close(sock);
+    return status;
+}
+
+
 /****************************************************************************
  * The TCP listener/transport factory.
  */
@@ -252,12 +340,13 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
 					)
 {
     pj_pool_t *pool;
-    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_sock_t *sock;
+    unsigned sock_cnt, i;
     struct tcp_listener *listener;
     pj_activesock_cfg asock_cfg;
     pj_activesock_cb listener_cb;
     pj_sockaddr *listener_addr;
-    int addr_len;
+    pj_sockaddr sock_addr;
     pj_status_t status;
 
     /* Sanity check */
@@ -301,56 +390,48 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
     if (listener->factory.type==PJSIP_TRANSPORT_TCP6)
 	pj_ansi_strcat(listener->factory.obj_name, "6");
 
-    status = pj_lock_create_recursive_mutex(pool, listener->factory.obj_name,
-					    &listener->factory.lock);
-    if (status != PJ_SUCCESS)
-	goto on_error;
+    /* Several listener sockets can only share the address with
+     * SO_REUSEPORT.
+     */
+    sock_cnt = cfg->sock_cnt ? cfg->sock_cnt : 1;
+    if (sock_cnt > 1 && pj_SO_REUSEPORT() == 0xFFFF) {
+	PJ_LOG(3,(listener->factory.obj_name, "SO_REUSEPORT is not "
+		  "supported, using one listener socket instead of %d",
+		  sock_cnt));
+	sock_cnt = 1;
+    }
 
+    listener->asock = (pj_activesock_t**)
+		      pj_pool_calloc(pool, sock_cnt, sizeof(pj_activesock_t*));
+    sock = (pj_sock_t*) pj_pool_alloc(pool, sock_cnt * sizeof(pj_sock_t));
+    for (i=0; i<sock_cnt; ++i)
+	sock[i] = PJ_INVALID_SOCKET;
 
-    /* Create socket */
-    status = pj_sock_socket(cfg->af, pj_SOCK_STREAM(), 0, &sock);
+    status = pj_lock_create_recursive_mutex(pool, listener->factory.obj_name,
+					    &listener->factory.lock);
     if (status != PJ_SUCCESS)
 	goto on_error;
 
-    /* Apply QoS, if specified */
-    status = pj_sock_apply_qos2(sock, cfg->qos_type, &cfg->qos_params, 
-				2, listener->factory.obj_name, 
-				"SIP TCP listener socket");
-
-    /* Apply SO_REUSEADDR */
-    if (cfg->reuse_addr) {
-	int enabled = 1;
-	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEADDR(),
-				    &enabled, sizeof(enabled));
-	if (status != PJ_SUCCESS) {
-	    PJ_PERROR(4,(listener->factory.obj_name, status,
-		         "Warning: error applying SO_REUSEADDR"));
-	}
-    }
-
-    /* Apply socket options, if specified */
-    if (cfg->sockopt_params.cnt)
-	status = pj_sock_setsockopt_params(sock, &cfg->sockopt_params);
 
     /* Bind address may be different than factory.local_addr because
      * factory.local_addr will be resolved below.
      */
     pj_sockaddr_cp(&listener->bound_addr, &cfg->bind_addr);
 
-    /* Bind socket */
-    listener_addr = &listener->factory.local_addr;
-    pj_sockaddr_cp(listener_addr, &cfg->bind_addr);
-
-    status = pj_sock_bind(sock, listener_addr, 
-			  pj_sockaddr_get_len(listener_addr));
-    if (status != PJ_SUCCESS)
-	goto on_error;
+    /* Create and bind the listener sockets. The first socket resolves
+     * the port if it is zero, and the other sockets are bound to the
+     * same address and port.
+     */
+    pj_sockaddr_cp(&sock_addr, &cfg->bind_addr);
+    for (i=0; i<sock_cnt; ++i) {
+	status = create_listener_sock(listener, cfg, (sock_cnt > 1),
+				      &sock_addr, &sock[i]);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
 
-    /* Retrieve the bound address */
-    addr_len = pj_sockaddr_get_len(listener_addr);
-    status = pj_sock_getsockname(sock, listener_addr, &addr_len);
-    if (status != PJ_SUCCESS)
-	goto on_error;
+    listener_addr = &listener->factory.local_addr;
+    pj_sockaddr_cp(listener_addr, &sock_addr);
 
     /* If published host/IP is specified, then use that address as the
      * listener advertised address.
@@ -395,12 +476,6 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
 		     "tcplis:%d",  listener->factory.addr_name.port);
 
 
-    /* Start listening to the address */
-    status = pj_sock_listen(sock, PJSIP_TCP_TRANSPORT_BACKLOG);
-    if (status != PJ_SUCCESS)
-	goto on_error;
-
-
     /* Create active socket */
     pj_activesock_cfg_default(&asock_cfg);
     if (cfg->async_cnt > MAX_ASYNC_CNT) 
@@ -421,10 +496,17 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
 
     pj_bzero(&listener_cb, sizeof(listener_cb));
     listener_cb.on_accept_complete = &on_accept_complete;
-    status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(), &asock_cfg,
-				  pjsip_endpt_get_ioqueue(endpt), 
-				  &listener_cb, listener,
-				  &listener->asock);
+    /* The sockets are spread among the event loops of the endpoint */
+    for (i=0; i<sock_cnt; ++i) {
+	status = pj_activesock_create(pool, sock[i], pj_SOCK_STREAM(),
+				      &asock_cfg,
+				      pjsip_endpt_get_loop_ioqueue(endpt, i),
+				      &listener_cb, listener,
+				      &listener->asock[i]);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+	++listener->asock_cnt;
+    }
 
     /* Register to transport manager */
     listener->endpt = endpt;
@@ -440,15 +522,18 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
     }
 
     /* Start pending accept() operations */
-    status = pj_activesock_start_accept(listener->asock, pool);
-    if (status != PJ_SUCCESS)
-	goto on_error;
+    for (i=0; i<sock_cnt; ++i) {
+	status = pj_activesock_start_accept(listener->asock[i], pool);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
 
     PJ_LOG(4,(listener->factory.obj_name, 
-	     "SIP TCP listener ready for incoming connections at %.*s:%d",
+	     "SIP TCP listener ready for incoming connections at %.*s:%d "
+	     "(%d socket(s))",
 	     (int)listener->factory.addr_name.host.slen,
 	     listener->factory.addr_name.host.ptr,
-	     listener->factory.addr_name.port));
+	     listener->factory.addr_name.port, sock_cnt));
 
     /* Return the pointer to user */
     if (p_factory) *p_factory = &listener->factory;
@@ -456,8 +541,10 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
     return PJ_SUCCESS;
 
 on_error:
-    if (listener->asock==NULL && sock!=PJ_INVALID_SOCKET)
-	pj_sock_close(sock);
+    for (i=listener->asock_cnt; i<sock_cnt; ++i) {
+	if (sock[i] != PJ_INVALID_SOCKET)
+	    pj_sock_close(sock[i]);
+    }
     lis_destroy(&listener->factory);
     return status;
 }
@@ -536,9 +623,10 @@ static pj_status_t lis_destroy(pjsip_tpfactory *factory)
 	listener->is_registered = PJ_FALSE;
     }
 
-    if (listener->asock) {
-	pj_activesock_close(listener->asock);
-	listener->asock = NULL;
+    while (listener->asock_cnt) {
+	--listener->asock_cnt;
+	pj_activesock_close(listener->asock[listener->asock_cnt]);
+	listener->asock[listener->asock_cnt] = NULL;
     }
 
     if (listener->grp_lock) {
@@ -596,6 +684,9 @@ static pj_bool_t on_data_sent(pj_activesock_t *asock,
 static pj_bool_t on_connect_complete(pj_activesock_t *asock,
 				     pj_status_t status);
 
+/* Write messages in the transmit queue */
+static void tcp_tx_flush(struct tcp_transport *tcp);
+
 /* TCP keep-alive timer callback */
 static void tcp_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e);
 
@@ -607,14 +698,13 @@ static void tcp_on_destroy(void *arg);
  * pending connect() complete.
  */
 static pj_status_t tcp_create( struct tcp_listener *listener,
-			       pj_pool_t *pool,
+			       pj_pool_t *pool, pj_ioqueue_t *ioqueue,
 			       pj_sock_t sock, pj_bool_t is_server,
 			       const pj_sockaddr *local,
 			       const pj_sockaddr *remote,
 			       struct tcp_transport **p_tcp)
 {
     struct tcp_transport *tcp;
-    pj_ioqueue_t *ioqueue;
     pj_activesock_cfg asock_cfg;
     pj_activesock_cb tcp_callback;
     const pj_str_t ka_pkt = PJSIP_TCP_KEEP_ALIVE_DATA;
@@ -639,6 +729,9 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     tcp->sock = sock;
     /*tcp->listener = listener;*/
     pj_list_init(&tcp->delayed_list);
+    pj_list_init(&tcp->tx_queue);
+    pj_list_init(&tcp->tx_batch);
+    pj_ioqueue_op_key_init(&tcp->tx_op_key.key, sizeof(pj_ioqueue_op_key_t));
     tcp->base.pool = pool;
 
     pj_ansi_snprintf(tcp->base.obj_name, PJ_MAX_OBJ_NAME, 
@@ -697,7 +790,6 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     tcp_callback.on_data_sent = &on_data_sent;
     tcp_callback.on_connect_complete = &on_connect_complete;
 
-    ioqueue = pjsip_endpt_get_ioqueue(listener->endpt);
     status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(), &asock_cfg,
 				  ioqueue, &tcp_callback, tcp, &tcp->asock);
     if (status != PJ_SUCCESS) {
@@ -828,6 +920,23 @@ static pj_status_t tcp_destroy(pjsip_transport *transport,
 	on_data_sent(tcp->asock, op_key, -reason);
     }
 
+    /* Cancel all queued transmits */
+    pj_lock_acquire(tcp->base.lock);
+    while (!pj_list_empty(&tcp->tx_queue)) {
+	struct delayed_tdata *pending_tx;
+	pj_ioqueue_op_key_t *op_key;
+
+	pending_tx = tcp->tx_queue.next;
+	pj_list_erase(pending_tx);
+
+	op_key = (pj_ioqueue_op_key_t*)pending_tx->tdata_op_key;
+
+	pj_lock_release(tcp->base.lock);
+	on_data_sent(tcp->asock, op_key, -reason);
+	pj_lock_acquire(tcp->base.lock);
+    }
+    pj_lock_release(tcp->base.lock);
+
     if (tcp->asock) {
 	pj_activesock_close(tcp->asock);
 	tcp->asock = NULL;
@@ -1018,7 +1127,8 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
     }
 
     /* Create the transport descriptor */
-    status = tcp_create(listener, NULL, sock, PJ_FALSE, &local_addr, 
+    status = tcp_create(listener, NULL, pjsip_endpt_get_ioqueue(endpt),
+			sock, PJ_FALSE, &local_addr, 
 			rem_addr, &tcp);
     if (status != PJ_SUCCESS)
 	return status;
@@ -1087,6 +1197,7 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
     char addr[PJ_INET6_ADDRSTRLEN+10];
     pjsip_tp_state_callback state_cb;
     pj_sockaddr tmp_src_addr;
+    unsigned i;
     pj_status_t status;
 
     PJ_UNUSED_ARG(src_addr_len);
@@ -1123,11 +1234,19 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
     pj_bzero(&tmp_src_addr, sizeof(tmp_src_addr));
     pj_sockaddr_cp(&tmp_src_addr, src_addr);
 
+    /* The connection is handled by the event loop of the listener
+     * socket which has accepted it.
+     */
+    for (i=0; i<listener->asock_cnt && listener->asock[i]!=asock; ++i)
+	;
+
     /* 
      * Incoming connection!
      * Create TCP transport for the new socket.
      */
-    status = tcp_create( listener, NULL, sock, PJ_TRUE,
+    status = tcp_create( listener, NULL,
+			 pjsip_endpt_get_loop_ioqueue(listener->endpt, i),
+			 sock, PJ_TRUE,
 			 &listener->factory.local_addr,
 			 &tmp_src_addr, &tcp);
     if (status == PJ_SUCCESS) {
@@ -1164,16 +1283,12 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
 
 
 /* 
- * Callback from ioqueue when packet is sent.
+ * Notify the sender that a message has been sent.
  */
-static pj_bool_t on_data_sent(pj_activesock_t *asock,
-			      pj_ioqueue_op_key_t *op_key,
-			      pj_ssize_t bytes_sent)
+static pj_bool_t tcp_on_tx_done(struct tcp_transport *tcp,
+				pjsip_tx_data_op_key *tdata_op_key,
+				pj_ssize_t bytes_sent)
 {
-    struct tcp_transport *tcp = (struct tcp_transport*) 
-    				pj_activesock_get_user_data(asock);
-    pjsip_tx_data_op_key *tdata_op_key = (pjsip_tx_data_op_key*)op_key;
-
     /* Note that op_key may be the op_key from keep-alive, thus
      * it will not have tdata etc.
      */
@@ -1213,6 +1328,158 @@ static pj_bool_t on_data_sent(pj_activesock_t *asock,
 }
 
 
+/*
+ * Complete the messages of a write from the transmit queue, which is
+ * either a single message or the coalesced messages in the batch.
+ */
+static pj_bool_t tcp_tx_complete(struct tcp_transport *tcp,
+				 pj_ioqueue_op_key_t *op_key,
+				 pj_ssize_t bytes_sent)
+{
+    pj_bool_t ret = PJ_TRUE;
+
+    if (op_key != &tcp->tx_op_key.key)
+	return tcp_on_tx_done(tcp, (pjsip_tx_data_op_key*)op_key, bytes_sent);
+
+    while (!pj_list_empty(&tcp->tx_batch)) {
+	struct delayed_tdata *pending_tx = tcp->tx_batch.next;
+	pjsip_tx_data *tdata = pending_tx->tdata_op_key->tdata;
+	pj_ssize_t size = tdata->buf.cur - tdata->buf.start;
+
+	/* The entry is allocated from tdata's pool */
+	pj_list_erase(pending_tx);
+
+	if (!tcp_on_tx_done(tcp, pending_tx->tdata_op_key,
+			    (bytes_sent > 0 ? size : bytes_sent)))
+	{
+	    ret = PJ_FALSE;
+	}
+    }
+
+    return ret;
+}
+
+
+/*
+ * Write the messages which have been queued while the previous write was
+ * in progress, coalescing them into one write of up to
+ * PJSIP_TCP_TX_COALESCE_SIZE bytes. Only called by the owner of the write
+ * in progress (tx_busy), after the write has completed.
+ */
+static void tcp_tx_flush(struct tcp_transport *tcp)
+{
+    for (;;) {
+	struct delayed_tdata *pending_tx;
+	pj_ioqueue_op_key_t *op_key;
+	char *buf;
+	pj_ssize_t size;
+	unsigned cnt;
+	pj_status_t status;
+
+	pj_lock_acquire(tcp->base.lock);
+
+	tcp->tx_cur = NULL;
+	if (pj_list_empty(&tcp->tx_queue) || tcp->is_closing) {
+	    tcp->tx_busy = PJ_FALSE;
+	    pj_lock_release(tcp->base.lock);
+	    return;
+	}
+
+	/* Move the messages that fit in the buffer to the batch */
+	size = 0;
+	cnt = 0;
+	pending_tx = tcp->tx_queue.next;
+	while (pending_tx != &tcp->tx_queue) {
+	    struct delayed_tdata *next = pending_tx->next;
+	    pjsip_tx_data *tdata = pending_tx->tdata_op_key->tdata;
+	    pj_ssize_t len = tdata->buf.cur - tdata->buf.start;
+
+	    if (cnt && size + len > PJSIP_TCP_TX_COALESCE_SIZE)
+		break;
+
+	    pj_list_erase(pending_tx);
+	    pj_list_push_back(&tcp->tx_batch, pending_tx);
+	    size += len;
+	    ++cnt;
+	    pending_tx = next;
+	}
+
+	if (cnt == 1) {
+	    /* Only one message, send it from its own buffer */
+	    pending_tx = tcp->tx_batch.next;
+	    pj_list_erase(pending_tx);
+
+	    op_key = (pj_ioqueue_op_key_t*)pending_tx->tdata_op_key;
+	    buf = pending_tx->tdata_op_key->tdata->buf.start;
+	} else {
+	    char *p;
+
+	    if (tcp->tx_buf == NULL) {
+		tcp->tx_buf = (char*) pj_pool_alloc(tcp->base.pool,
+						    PJSIP_TCP_TX_COALESCE_SIZE);
+	    }
+
+	    p = tcp->tx_buf;
+	    pending_tx = tcp->tx_batch.next;
+	    while (pending_tx != &tcp->tx_batch) {
+		pjsip_tx_data *tdata = pending_tx->tdata_op_key->tdata;
+		pj_size_t len = tdata->buf.cur - tdata->buf.start;
+
+		pj_memcpy(p, tdata->buf.start, len);
+		p += len;
+		pending_tx = pending_tx->next;
+	    }
+
+	    op_key = &tcp->tx_op_key.key;
+	    buf = tcp->tx_buf;
+	}
+
+	tcp->tx_cur = op_key;
+	tcp->tx_stat.msg_cnt += cnt;
+	++tcp->tx_stat.write_cnt;
+	if (cnt > tcp->tx_stat.max_msg_cnt)
+	    tcp->tx_stat.max_msg_cnt = cnt;
+
+	pj_lock_release(tcp->base.lock);
+
+	status = pj_activesock_send(tcp->asock, op_key, buf, &size, 0);
+	if (status == PJ_EPENDING) {
+	    /* on_data_sent() will continue with the queue */
+	    return;
+	}
+
+	/* Completed immediately */
+	if (status != PJ_SUCCESS && size > 0)
+	    size = -status;
+	tcp_tx_complete(tcp, op_key, size);
+    }
+}
+
+
+/* 
+ * Callback from ioqueue when packet is sent.
+ */
+static pj_bool_t on_data_sent(pj_activesock_t *asock,
+			      pj_ioqueue_op_key_t *op_key,
+			      pj_ssize_t bytes_sent)
+{
+    struct tcp_transport *tcp = (struct tcp_transport*) 
+    				pj_activesock_get_user_data(asock);
+    pj_bool_t ret;
+
+    if (op_key != tcp->tx_cur)
+	return tcp_on_tx_done(tcp, (pjsip_tx_data_op_key*)op_key, bytes_sent);
+
+    /* The write of the transmit queue has completed, continue with the
+     * messages queued in the meantime.
+     */
+    ret = tcp_tx_complete(tcp, op_key, bytes_sent);
+    tcp_tx_flush(tcp);
+
+    return ret;
+}
+
+
 /* 
  * This callback is called by transport manager to send SIP message 
  */
@@ -1285,6 +1552,35 @@ static pj_status_t tcp_send_msg(pjsip_transport *transport,
 
 	pj_lock_release(tcp->base.lock);
     } 
+
+    /* If another write is in progress, queue the packet to be coalesced
+     * with other queued packets once the write completes.
+     */
+    if (!delayed && PJSIP_TCP_TX_COALESCE_SIZE > 0) {
+	pj_lock_acquire(tcp->base.lock);
+
+	if (tcp->tx_busy) {
+	    struct delayed_tdata *queued_tdata;
+
+	    queued_tdata = PJ_POOL_ZALLOC_T(tdata->pool,
+					    struct delayed_tdata);
+	    queued_tdata->tdata_op_key = &tdata->op_key;
+	    pj_list_push_back(&tcp->tx_queue, queued_tdata);
+	    status = PJ_EPENDING;
+
+	    /* Prevent pj_ioqueue_send() to be called below */
+	    delayed = PJ_TRUE;
+	} else {
+	    tcp->tx_busy = PJ_TRUE;
+	    tcp->tx_cur = (pj_ioqueue_op_key_t*)&tdata->op_key;
+	    ++tcp->tx_stat.msg_cnt;
+	    ++tcp->tx_stat.write_cnt;
+	    if (tcp->tx_stat.max_msg_cnt == 0)
+		tcp->tx_stat.max_msg_cnt = 1;
+	}
+
+	pj_lock_release(tcp->base.lock);
+    }
     
     if (!delayed) {
 	/*
@@ -1311,6 +1607,10 @@ static pj_status_t tcp_send_msg(pjsip_transport *transport,
 
 		tcp_init_shutdown(tcp, status);
 	    }
+
+	    /* Send packets queued in the meantime */
+	    if (PJSIP_TCP_TX_COALESCE_SIZE > 0)
+		tcp_tx_flush(tcp);
 	}
     }
 
@@ -1573,5 +1873,22 @@ PJ_DEF(pj_sock_t) pjsip_tcp_transport_get_socket(pjsip_transport *transport)
 }
 
 
-#endif	/* PJ_HAS_TCP */
+/*
+ * Get the transmit statistics of TCP transport.
+ */
+PJ_DEF(pj_status_t) pjsip_tcp_transport_get_tx_stat(pjsip_transport *transport,
+						    pjsip_tp_tx_stat *stat)
+{
+    struct tcp_transport *tcp = (struct tcp_transport*)transport;
+
+    PJ_ASSERT_RETURN(transport && stat, PJ_EINVAL);
+
+    pj_lock_acquire(tcp->base.lock);
+    pj_memcpy(stat, &tcp->tx_stat, sizeof(*stat));
+    pj_lock_release(tcp->base.lock);
 
+    return PJ_SUCCESS;
+}
+
+
+#endif	/* PJ_HAS_TCP */
@@ -110,6 +110,17 @@ struct tls_transport
     /* Pending transmission list. */
     struct delayed_tdata     delayed_list;
 
+    /* Transmit queue. Messages sent while a write is in progress are
+     * queued, and then coalesced into one write once the write completes.
+     */
+    pj_bool_t		     tx_busy;
+    pj_ioqueue_op_key_t	    *tx_cur;
+    struct delayed_tdata     tx_queue;
+    struct delayed_tdata     tx_batch;
+    pjsip_tx_data_op_key     tx_op_key;
+    char		    *tx_buf;
+    pjsip_tp_tx_stat	     tx_stat;
+
     /* Group lock to be used by TLS transport and ioqueue key */
     pj_grp_lock_t	    *grp_lock;
 };
@@ -635,6 +646,9 @@ static pj_status_t tls_destroy(pjsip_transport *transport,
 static pj_bool_t on_connect_complete(pj_ssl_sock_t *ssock,
 				     pj_status_t status);
 
+/* Write messages in the transmit queue */
+static void tls_tx_flush(struct tls_transport *tls);
+
 /* TLS keep-alive timer callback */
 static void tls_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e);
 
@@ -673,6 +687,9 @@ static pj_status_t tls_create( struct tls_listener *listener,
     tls->is_server = is_server;
     tls->verify_server = listener->tls_setting.verify_server;
     pj_list_init(&tls->delayed_list);
+    pj_list_init(&tls->tx_queue);
+    pj_list_init(&tls->tx_batch);
+    pj_ioqueue_op_key_init(&tls->tx_op_key.key, sizeof(pj_ioqueue_op_key_t));
     tls->base.pool = pool;
 
     pj_ansi_snprintf(tls->base.obj_name, PJ_MAX_OBJ_NAME, 
@@ -900,6 +917,23 @@ static pj_status_t tls_destroy(pjsip_transport *transport,
 	on_data_sent(tls->ssock, op_key, -reason);
     }
 
+    /* Cancel all queued transmits */
+    pj_lock_acquire(tls->base.lock);
+    while (!pj_list_empty(&tls->tx_queue)) {
+	struct delayed_tdata *pending_tx;
+	pj_ioqueue_op_key_t *op_key;
+
+	pending_tx = tls->tx_queue.next;
+	pj_list_erase(pending_tx);
+
+	op_key = (pj_ioqueue_op_key_t*)pending_tx->tdata_op_key;
+
+	pj_lock_release(tls->base.lock);
+	on_data_sent(tls->ssock, op_key, -reason);
+	pj_lock_acquire(tls->base.lock);
+    }
+    pj_lock_release(tls->base.lock);
+
     if (tls->ssock) {
 	pj_ssl_sock_close(tls->ssock);
 	tls->ssock = NULL;
@@ -1296,16 +1330,12 @@ static pj_bool_t on_accept_complete(pj_ssl_sock_t *ssock,
 
 
 /* 
- * Callback from ioqueue when packet is sent.
+ * Notify the sender that a message has been sent.
  */
-static pj_bool_t on_data_sent(pj_ssl_sock_t *ssock,
-			      pj_ioqueue_op_key_t *op_key,
-			      pj_ssize_t bytes_sent)
+static pj_bool_t tls_on_tx_done(struct tls_transport *tls,
+				pjsip_tx_data_op_key *tdata_op_key,
+				pj_ssize_t bytes_sent)
 {
-    struct tls_transport *tls = (struct tls_transport*) 
-    				pj_ssl_sock_get_user_data(ssock);
-    pjsip_tx_data_op_key *tdata_op_key = (pjsip_tx_data_op_key*)op_key;
-
     /* Note that op_key may be the op_key from keep-alive, thus
      * it will not have tdata etc.
      */
@@ -1345,6 +1375,158 @@ static pj_bool_t on_data_sent(pj_ssl_sock_t *ssock,
 }
 
 
+/*
+ * Complete the messages of a write from the transmit queue, which is
+ * either a single message or the coalesced messages in the batch.
+ */
+static pj_bool_t tls_tx_complete(struct tls_transport *tls,
+				 pj_ioqueue_op_key_t *op_key,
+				 pj_ssize_t bytes_sent)
+{
+    pj_bool_t ret = PJ_TRUE;
+
+    if (op_key != &tls->tx_op_key.key)
+	return tls_on_tx_done(tls, (pjsip_tx_data_op_key*)op_key, bytes_sent);
+
+    while (!pj_list_empty(&tls->tx_batch)) {
+	struct delayed_tdata *pending_tx = tls->tx_batch.next;
+	pjsip_tx_data *tdata = pending_tx->tdata_op_key->tdata;
+	pj_ssize_t size = tdata->buf.cur - tdata->buf.start;
+
+	/* The entry is allocated from tdata's pool */
+	pj_list_erase(pending_tx);
+
+	if (!tls_on_tx_done(tls, pending_tx->tdata_op_key,
+			    (bytes_sent > 0 ? size : bytes_sent)))
+	{
+	    ret = PJ_FALSE;
+	}
+    }
+
+    return ret;
+}
+
+
+/*
+ * Write the messages which have been queued while the previous write was
+ * in progress, coalescing them into one write of up to
+ * PJSIP_TLS_TX_COALESCE_SIZE bytes. Only called by the owner of the write
+ * in progress (tx_busy), after the write has completed.
+ */
+static void tls_tx_flush(struct tls_transport *tls)
+{
+    for (;;) {
+	struct delayed_tdata *pending_tx;
+	pj_ioqueue_op_key_t *op_key;
+	char *buf;
+	pj_ssize_t size;
+	unsigned cnt;
+	pj_status_t status;
+
+	pj_lock_acquire(tls->base.lock);
+
+	tls->tx_cur = NULL;
+	if (pj_list_empty(&tls->tx_queue) || tls->is_closing) {
+	    tls->tx_busy = PJ_FALSE;
+	    pj_lock_release(tls->base.lock);
+	    return;
+	}
+
+	/* Move the messages that fit in the buffer to the batch */
+	size = 0;
+	cnt = 0;
+	pending_tx = tls->tx_queue.next;
+	while (pending_tx != &tls->tx_queue) {
+	    struct delayed_tdata *next = pending_tx->next;
+	    pjsip_tx_data *tdata = pending_tx->tdata_op_key->tdata;
+	    pj_ssize_t len = tdata->buf.cur - tdata->buf.start;
+
+	    if (cnt && size + len > PJSIP_TLS_TX_COALESCE_SIZE)
+		break;
+
+	    pj_list_erase(pending_tx);
+	    pj_list_push_back(&tls->tx_batch, pending_tx);
+	    size += len;
+	    ++cnt;
+	    pending_tx = next;
+	}
+
+	if (cnt == 1) {
+	    /* Only one message, send it from its own buffer */
+	    pending_tx = tls->tx_batch.next;
+	    pj_list_erase(pending_tx);
+
+	    op_key = (pj_ioqueue_op_key_t*)pending_tx->tdata_op_key;
+	    buf = pending_tx->tdata_op_key->tdata->buf.start;
+	} else {
+	    char *p;
+
+	    if (tls->tx_buf == NULL) {
+		tls->tx_buf = (char*) pj_pool_alloc(tls->base.pool,
+						    PJSIP_TLS_TX_COALESCE_SIZE);
+	    }
+
+	    p = tls->tx_buf;
+	    pending_tx = tls->tx_batch.next;
+	    while (pending_tx != &tls->tx_batch) {
+		pjsip_tx_data *tdata = pending_tx->tdata_op_key->tdata;
+		pj_size_t len = tdata->buf.cur - tdata->buf.start;
+
+		pj_memcpy(p, tdata->buf.start, len);
+		p += len;
+		pending_tx = pending_tx->next;
+	    }
+
+	    op_key = &tls->tx_op_key.key;
+	    buf = tls->tx_buf;
+	}
+
+	tls->tx_cur = op_key;
+	tls->tx_stat.msg_cnt += cnt;
+	++tls->tx_stat.write_cnt;
+	if (cnt > tls->tx_stat.max_msg_cnt)
+	    tls->tx_stat.max_msg_cnt = cnt;
+
+	pj_lock_release(tls->base.lock);
+
+	status = pj_ssl_sock_send(tls->ssock, op_key, buf, &size, 0);
+	if (status == PJ_EPENDING) {
+	    /* on_data_sent() will continue with the queue */
+	    return;
+	}
+
+	/* Completed immediately */
+	if (status != PJ_SUCCESS && size > 0)
+	    size = -status;
+	tls_tx_complete(tls, op_key, size);
+    }
+}
+
+
+/* 
+ * Callback from ioqueue when packet is sent.
+ */
+static pj_bool_t on_data_sent(pj_ssl_sock_t *ssock,
+			      pj_ioqueue_op_key_t *op_key,
+			      pj_ssize_t bytes_sent)
+{
+    struct tls_transport *tls = (struct tls_transport*) 
+    				pj_ssl_sock_get_user_data(ssock);
+    pj_bool_t ret;
+
+    if (op_key != tls->tx_cur)
+	return tls_on_tx_done(tls, (pjsip_tx_data_op_key*)op_key, bytes_sent);
+
+    /* The write of the transmit queue has completed, continue with the
+     * messages queued in the meantime.
+     */
+    ret = tls_tx_complete(tls, op_key, bytes_sent);
+    tls_tx_flush(tls);
+
+    return ret;
+}
+
+
 /* 
  * This callback is called by transport manager to send SIP message 
  */
@@ -1417,6 +1599,35 @@ static pj_status_t tls_send_msg(pjsip_transport *transport,
 
 	pj_lock_release(tls->base.lock);
     } 
+
+    /* If another write is in progress, queue the packet to be coalesced
+     * with other queued packets once the write completes.
+     */
+    if (!delayed && PJSIP_TLS_TX_COALESCE_SIZE > 0) {
+	pj_lock_acquire(tls->base.lock);
+
+	if (tls->tx_busy) {
+	    struct delayed_tdata *queued_tdata;
+
+	    queued_tdata = PJ_POOL_ZALLOC_T(tdata->pool,
+					    struct delayed_tdata);
+	    queued_tdata->tdata_op_key = &tdata->op_key;
+	    pj_list_push_back(&tls->tx_queue, queued_tdata);
+	    status = PJ_EPENDING;
+
+	    /* Prevent pj_ioqueue_send() to be called below */
+	    delayed = PJ_TRUE;
+	} else {
+	    tls->tx_busy = PJ_TRUE;
+	    tls->tx_cur = (pj_ioqueue_op_key_t*)&tdata->op_key;
+	    ++tls->tx_stat.msg_cnt;
+	    ++tls->tx_stat.write_cnt;
+	    if (tls->tx_stat.max_msg_cnt == 0)
+		tls->tx_stat.max_msg_cnt = 1;
+	}
+
+	pj_lock_release(tls->base.lock);
+    }
     
     if (!delayed) {
 	/*
@@ -1443,6 +1654,10 @@ static pj_status_t tls_send_msg(pjsip_transport *transport,
 
 		tls_init_shutdown(tls, status);
 	    }
+
+	    /* Send packets queued in the meantime */
+	    if (PJSIP_TLS_TX_COALESCE_SIZE > 0)
+		tls_tx_flush(tls);
 	}
     }
 
@@ -1818,4 +2033,22 @@ static void tls_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e)
     tls->ka_timer.id = PJ_TRUE;
 }
 
+
+/*
+ * Get the transmit statistics of TLS transport.
+ */
+PJ_DEF(pj_status_t) pjsip_tls_transport_get_tx_stat(pjsip_transport *transport,
+						    pjsip_tp_tx_stat *stat)
+{
+    struct tls_transport *tls = (struct tls_transport*)transport;
+
+    PJ_ASSERT_RETURN(transport && stat, PJ_EINVAL);
+
+    pj_lock_acquire(tls->base.lock);
+    pj_memcpy(stat, &tls->tx_stat, sizeof(*stat));
+    pj_lock_release(tls->base.lock);
+
+    return PJ_SUCCESS;
+}
+
 #endif /* PJSIP_HAS_TLS_TRANSPORT */
@@ -33,6 +33,9 @@
 
 #define THIS_FILE   "sip_transport_udp.c"
 
+/* Maximum number of SO_REUSEPORT sockets created by start2() */
+#define MAX_SOCK_CNT	16
+
 /**
  * These are the target values for socket send and receive buffer sizes,
  * respectively. They will be applied to UDP socket with setsockopt().
@@ -72,8 +75,14 @@ struct udp_transport
     pjsip_transport	base;
     pj_sock_t		sock;
     pj_ioqueue_key_t   *key;
+    unsigned		rp_cnt;		/* Number of other sockets.	*/
+    pj_sock_t	       *rp_sock;	/* Other SO_REUSEPORT sockets.	*/
+    pj_ioqueue_key_t  **rp_key;		/* Keys of the other sockets.	*/
+    unsigned		sock_rdata_cnt;	/* Number of rdata per socket.	*/
     int			rdata_cnt;
     pjsip_rx_data     **rdata;
+    unsigned		recv_batch;	/* Number of rdata per read op.	*/
+    pj_ioqueue_mmsg    *mmsg;		/* Batch receive, or NULL.	*/
     int			is_closing;
     pj_bool_t		is_paused;
 
@@ -111,11 +120,149 @@ static void init_rdata(struct udp_transport *tp, unsigned rdata_index,
 }
 
 
+/*
+ * Report a received packet to the transport manager, then reset the rdata
+ * for the next packet. Returns the reinitialized rdata.
+ */
+static pjsip_rx_data *udp_on_rx_packet(pjsip_rx_data *rdata,
+				       pj_ssize_t bytes_read)
+{
+    enum { MIN_SIZE = 32 };
+
+    /* Report the packet to transport manager. Only do so if packet size
+     * is relatively big enough for a SIP packet.
+     */
+    if (bytes_read > MIN_SIZE) {
+	pj_ssize_t size_eaten;
+	const pj_sockaddr *src_addr = &rdata->pkt_info.src_addr;
+
+	/* Init pkt_info part. */
+	rdata->pkt_info.len = bytes_read;
+	rdata->pkt_info.zero = 0;
+	pj_gettimeofday(&rdata->pkt_info.timestamp);
+	if (src_addr->addr.sa_family == pj_AF_INET()) {
+	    pj_ansi_strcpy(rdata->pkt_info.src_name,
+			   pj_inet_ntoa(src_addr->ipv4.sin_addr));
+	    rdata->pkt_info.src_port = pj_ntohs(src_addr->ipv4.sin_port);
+	} else {
+	    pj_inet_ntop(pj_AF_INET6(), 
+			 pj_sockaddr_get_addr(&rdata->pkt_info.src_addr),
+			 rdata->pkt_info.src_name,
+			 sizeof(rdata->pkt_info.src_name));
+	    rdata->pkt_info.src_port = pj_ntohs(src_addr->ipv6.sin6_port);
+	}
+
+	size_eaten = 
+	    pjsip_tpmgr_receive_packet(rdata->tp_info.transport->tpmgr, 
+				       rdata);
+
+	if (size_eaten < 0) {
+	    pj_assert(!"It shouldn't happen!");
+	    size_eaten = rdata->pkt_info.len;
+	}
+
+	/* Since this is UDP, the whole buffer is the message. */
+	rdata->pkt_info.len = 0;
+
+    } else if (bytes_read <= MIN_SIZE) {
+
+	/* TODO: */
+
+    } else if (-bytes_read != PJ_STATUS_FROM_OS(OSERR_EWOULDBLOCK) &&
+	       -bytes_read != PJ_STATUS_FROM_OS(OSERR_EINPROGRESS) && 
+	       -bytes_read != PJ_STATUS_FROM_OS(OSERR_ECONNRESET)) 
+    {
+
+	/* Report error to endpoint. */
+	PJSIP_ENDPT_LOG_ERROR((rdata->tp_info.transport->endpt,
+			       rdata->tp_info.transport->obj_name,
+			       (pj_status_t)-bytes_read, 
+			       "Warning: pj_ioqueue_recvfrom()"
+			       " callback error"));
+    }
+
+    /* Reset pool. 
+     * Need to copy rdata fields to temp variable because they will
+     * be invalid after pj_pool_reset().
+     */
+    {
+	pj_pool_t *rdata_pool = rdata->tp_info.pool;
+	struct udp_transport *rdata_tp ;
+	unsigned rdata_index;
+
+	rdata_tp = (struct udp_transport*)rdata->tp_info.transport;
+	rdata_index = (unsigned)(unsigned long)(pj_ssize_t)
+		      rdata->tp_info.tp_data;
+
+	pj_pool_reset(rdata_pool);
+	init_rdata(rdata_tp, rdata_index, rdata_pool, &rdata);
+    }
+
+    return rdata;
+}
+
+
+/*
+ * Get the ioqueue key of the socket which the rdata receives from. The
+ * rdata of the first socket come first, followed by the rdata of each
+ * SO_REUSEPORT socket.
+ */
+static pj_ioqueue_key_t *get_rdata_key(struct udp_transport *tp,
+				       unsigned rdata_index)
+{
+    unsigned sock_index = rdata_index / tp->sock_rdata_cnt;
+
+    return sock_index ? tp->rp_key[sock_index-1] : tp->key;
+}
+
+
+/*
+ * Start the next read operation for the rdata batch which starts at
+ * the specified index. With batch receive, bytes_read will contain the
+ * number of packets received.
+ */
+static pj_status_t start_read(struct udp_transport *tp, unsigned first,
+			      pj_ssize_t *bytes_read, pj_uint32_t flags)
+{
+    pjsip_rx_data *rdata = tp->rdata[first];
+
+    if (tp->mmsg) {
+	pj_ioqueue_mmsg *msg = &tp->mmsg[first];
+	unsigned i, count = tp->recv_batch;
+	pj_status_t status;
+
+	/* The rdata may have been reinitialized, so update the buffers */
+	for (i=0; i<count; ++i) {
+	    pjsip_rx_data *rd = tp->rdata[first+i];
+
+	    msg[i].buf = rd->pkt_info.packet;
+	    msg[i].len = sizeof(rd->pkt_info.packet);
+	    msg[i].addr = &rd->pkt_info.src_addr;
+	    msg[i].addrlen = sizeof(rd->pkt_info.src_addr);
+	}
+	status = pj_ioqueue_recvmmsg(get_rdata_key(tp, first),
+				     &rdata->tp_info.op_key.op_key,
+				     msg, &count, flags);
+	*bytes_read = count;
+	return status;
+    }
+
+    *bytes_read = sizeof(rdata->pkt_info.packet);
+    rdata->pkt_info.src_addr_len = sizeof(rdata->pkt_info.src_addr);
+    return pj_ioqueue_recvfrom(get_rdata_key(tp, first),
+			       &rdata->tp_info.op_key.op_key, 
+			       rdata->pkt_info.packet,
+			       bytes_read, flags,
+			       &rdata->pkt_info.src_addr, 
+			       &rdata->pkt_info.src_addr_len);
+}
+
+
 /*
  * udp_on_read_complete()
  *
  * This is callback notification from ioqueue that a pending recvfrom()
- * operation has completed.
+ * or recvmmsg() operation has completed.
  */
 static void udp_on_read_complete( pj_ioqueue_key_t *key, 
 				  pj_ioqueue_op_key_t *op_key, 
@@ -126,9 +273,12 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
     pjsip_rx_data_op_key *rdata_op_key = (pjsip_rx_data_op_key*) op_key;
     pjsip_rx_data *rdata = rdata_op_key->rdata;
     struct udp_transport *tp = (struct udp_transport*)rdata->tp_info.transport;
+    unsigned first;
     int i;
     pj_status_t status;
 
+    PJ_UNUSED_ARG(key);
+
     /* Don't do anything if transport is closing. */
     if (tp->is_closing) {
 	tp->is_closing++;
@@ -139,66 +289,35 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
     if (tp->is_paused)
 	return;
 
+    /* Index of the first rdata of the batch, which owns the operation */
+    first = (unsigned)(pj_ssize_t)rdata->tp_info.tp_data;
+
     /*
      * The idea of the loop is to process immediate data received by
      * pj_ioqueue_recvfrom(), as long as i < MAX_IMMEDIATE_PACKET. When
      * i is >= MAX_IMMEDIATE_PACKET, we force the recvfrom() operation to
      * complete asynchronously, to allow other sockets to get their data.
+     * With batch receive, i counts the packets rather than the reads.
      */
-    for (i=0;; ++i) {
-    	enum { MIN_SIZE = 32 };
+    for (i=0;;) {
 	pj_uint32_t flags;
 
-	/* Report the packet to transport manager. Only do so if packet size
-	 * is relatively big enough for a SIP packet.
-	 */
-	if (bytes_read > MIN_SIZE) {
-	    pj_ssize_t size_eaten;
-	    const pj_sockaddr *src_addr = &rdata->pkt_info.src_addr;
-
-	    /* Init pkt_info part. */
-	    rdata->pkt_info.len = bytes_read;
-	    rdata->pkt_info.zero = 0;
-	    pj_gettimeofday(&rdata->pkt_info.timestamp);
-	    if (src_addr->addr.sa_family == pj_AF_INET()) {
-		pj_ansi_strcpy(rdata->pkt_info.src_name,
-			       pj_inet_ntoa(src_addr->ipv4.sin_addr));
-		rdata->pkt_info.src_port = pj_ntohs(src_addr->ipv4.sin_port);
-	    } else {
-		pj_inet_ntop(pj_AF_INET6(), 
-			     pj_sockaddr_get_addr(&rdata->pkt_info.src_addr),
-			     rdata->pkt_info.src_name,
-			     sizeof(rdata->pkt_info.src_name));
-		rdata->pkt_info.src_port = pj_ntohs(src_addr->ipv6.sin6_port);
-	    }
+	if (tp->mmsg && bytes_read > 0) {
+	    pj_ssize_t j;
 
-	    size_eaten = 
-		pjsip_tpmgr_receive_packet(rdata->tp_info.transport->tpmgr, 
-					   rdata);
+	    /* Batch receive, bytes_read is the number of packets. Parse
+	     * and dispatch them in the order they were received.
+	     */
+	    for (j=0; j<bytes_read; ++j) {
+		pjsip_rx_data *rd = tp->rdata[first+j];
 
-	    if (size_eaten < 0) {
-		pj_assert(!"It shouldn't happen!");
-		size_eaten = rdata->pkt_info.len;
+		rd->pkt_info.src_addr_len = tp->mmsg[first+j].addrlen;
+		udp_on_rx_packet(rd, tp->mmsg[first+j].len);
 	    }
-
-	    /* Since this is UDP, the whole buffer is the message. */
-	    rdata->pkt_info.len = 0;
-
-	} else if (bytes_read <= MIN_SIZE) {
-
-	    /* TODO: */
-
-	} else if (-bytes_read != PJ_STATUS_FROM_OS(OSERR_EWOULDBLOCK) &&
-		   -bytes_read != PJ_STATUS_FROM_OS(OSERR_EINPROGRESS) && 
-		   -bytes_read != PJ_STATUS_FROM_OS(OSERR_ECONNRESET)) 
-	{
-
-	    /* Report error to endpoint. */
-	    PJSIP_ENDPT_LOG_ERROR((rdata->tp_info.transport->endpt,
-				   rdata->tp_info.transport->obj_name,
-				   (pj_status_t)-bytes_read, 
-				   "Warning: pj_ioqueue_recvfrom()"
-				   " callback error"));
+	    i += (int)bytes_read;
+	} else {
+	    udp_on_rx_packet(tp->rdata[first], bytes_read);
+	    ++i;
 	}
 
 	if (i >= MAX_IMMEDIATE_PACKET) {
@@ -208,28 +327,6 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
 	    flags = 0;
 	}
 
-	/* Reset pool. 
-	 * Need to copy rdata fields to temp variable because they will
-	 * be invalid after pj_pool_reset().
-	 */
-	{
-	    pj_pool_t *rdata_pool = rdata->tp_info.pool;
-	    struct udp_transport *rdata_tp ;
-	    unsigned rdata_index;
-
-	    rdata_tp = (struct udp_transport*)rdata->tp_info.transport;
-	    rdata_index = (unsigned)(unsigned long)(pj_ssize_t)
-			  rdata->tp_info.tp_data;
-
-	    pj_pool_reset(rdata_pool);
-	    init_rdata(rdata_tp, rdata_index, rdata_pool, &rdata);
-
-	    /* Change some vars to point to new location after
-	     * pool reset.
-	     */
-	    op_key = &rdata->tp_info.op_key.op_key;
-	}
-
 	/* Only read next packet if transport is not being paused. This
 	 * check handles the case where transport is paused while endpoint
 	 * is still processing a SIP message.
@@ -238,13 +335,8 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
 	    return;
 
 	/* Read next packet. */
-	bytes_read = sizeof(rdata->pkt_info.packet);
-	rdata->pkt_info.src_addr_len = sizeof(rdata->pkt_info.src_addr);
-	status = pj_ioqueue_recvfrom(key, op_key, 
-				     rdata->pkt_info.packet,
-				     &bytes_read, flags,
-				     &rdata->pkt_info.src_addr, 
-				     &rdata->pkt_info.src_addr_len);
+	rdata = tp->rdata[first];
+	status = start_read(tp, first, &bytes_read, flags);
 
 	if (status == PJ_SUCCESS) {
 	    /* Continue loop. */
@@ -349,6 +441,24 @@ static pj_status_t udp_send_msg( pjsip_transport *transport,
 }
 
 
+/* Close the SO_REUSEPORT sockets */
+static void close_rp_sockets(struct udp_transport *tp)
+{
+    unsigned i;
+
+    for (i=0; i<tp->rp_cnt; ++i) {
+	if (tp->rp_key[i]) {
+	    /* This implicitly closes the socket */
+	    pj_ioqueue_unregister(tp->rp_key[i]);
+	    tp->rp_key[i] = NULL;
+	} else if (tp->rp_sock[i] != PJ_INVALID_SOCKET) {
+	    pj_sock_close(tp->rp_sock[i]);
+	}
+	tp->rp_sock[i] = PJ_INVALID_SOCKET;
+    }
+}
+
+
 /* Clean up UDP resources */
 static void udp_on_destroy(void *arg)
 {
@@ -412,12 +522,15 @@ static pj_status_t udp_destroy( pjsip_transport *transport )
 	    tp->sock = PJ_INVALID_SOCKET;
 	}
     }
+    close_rp_sockets(tp);
 
     /* Must poll ioqueue because IOCP calls the callback when socket
      * is closed. We poll the ioqueue until all pending callbacks 
      * have been called.
      */
-    for (i=0; i<50 && tp->is_closing < 1+tp->rdata_cnt; ++i) {
+    for (i=0; i<50 && tp->is_closing < 1+tp->rdata_cnt/(int)tp->recv_batch;
+	 ++i)
+    {
 	int cnt;
 	pj_time_val timeout = {0, 1};
 
@@ -453,7 +566,8 @@ static pj_status_t udp_shutdown(pjsip_transport *transport)
 
 /* Create socket */
 static pj_status_t create_socket(int af, const pj_sockaddr_t *local_a,
-				 int addr_len, pj_sock_t *p_sock)
+				 int addr_len, pj_bool_t reuse_port,
+				 pj_sock_t *p_sock)
 {
     pj_sock_t sock;
     pj_sockaddr_in tmp_addr;
@@ -464,6 +578,16 @@ static pj_status_t create_socket(int af, const pj_sockaddr_t *local_a,
     if (status != PJ_SUCCESS)
 	return status;
 
+    if (reuse_port) {
+	int enabled = 1;
+	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEPORT(),
+				    &enabled, sizeof(enabled));
+	if (status != PJ_SUCCESS) {
+	    pj_sock_close(sock);
+	    return status;
+	}
+    }
+
     if (local_a == NULL) {
 	if (af == pj_AF_INET6()) {
 	    pj_bzero(&tmp_addr6, sizeof(tmp_addr6));
@@ -625,6 +749,7 @@ static pj_status_t register_to_ioqueue(struct udp_transport *tp)
 {
     pj_ioqueue_t *ioqueue;
     pj_ioqueue_callback ioqueue_cb;
+    unsigned i;
     pj_status_t status;
 
     /* Ignore if already registered */
@@ -645,8 +770,28 @@ static pj_status_t register_to_ioqueue(struct udp_transport *tp)
     ioqueue_cb.on_read_complete = &udp_on_read_complete;
     ioqueue_cb.on_write_complete = &udp_on_write_complete;
 
-    return pj_ioqueue_register_sock2(tp->base.pool, ioqueue, tp->sock,
-				     tp->grp_lock, tp, &ioqueue_cb, &tp->key);
+    status = pj_ioqueue_register_sock2(tp->base.pool, ioqueue, tp->sock,
+				       tp->grp_lock, tp, &ioqueue_cb, &tp->key);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Register the SO_REUSEPORT sockets, which report to the same
+     * transport. The sockets are spread among the event loops of the
+     * endpoint, starting after the main loop.
+     */
+    for (i=0; i<tp->rp_cnt; ++i) {
+	if (tp->rp_key[i] || tp->rp_sock[i] == PJ_INVALID_SOCKET)
+	    continue;
+
+	ioqueue = pjsip_endpt_get_loop_ioqueue(tp->base.endpt, i+1);
+	status = pj_ioqueue_register_sock2(tp->base.pool, ioqueue,
+					   tp->rp_sock[i], tp->grp_lock, tp,
+					   &ioqueue_cb, &tp->rp_key[i]);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+
+    return PJ_SUCCESS;
 }
 
 /* Start ioqueue asynchronous reading to all rdata */
@@ -655,22 +800,30 @@ static pj_status_t start_async_read(struct udp_transport *tp)
     int i;
     pj_status_t status;
 
-    /* Start reading the ioqueue. */
-    for (i=0; i<tp->rdata_cnt; ++i) {
+    /* Start reading the ioqueue, one operation per rdata batch. */
+    for (i=0; i<tp->rdata_cnt; i+=tp->recv_batch) {
 	pj_ssize_t size;
 
-	size = sizeof(tp->rdata[i]->pkt_info.packet);
-	tp->rdata[i]->pkt_info.src_addr_len = sizeof(tp->rdata[i]->pkt_info.src_addr);
-	status = pj_ioqueue_recvfrom(tp->key, 
-				     &tp->rdata[i]->tp_info.op_key.op_key,
-				     tp->rdata[i]->pkt_info.packet,
-				     &size, PJ_IOQUEUE_ALWAYS_ASYNC,
-				     &tp->rdata[i]->pkt_info.src_addr,
-				     &tp->rdata[i]->pkt_info.src_addr_len);
+	/* Skip the SO_REUSEPORT socket which has been closed */
+	if (get_rdata_key(tp, i) == NULL)
+	    continue;
+
+	status = start_read(tp, i, &size, PJ_IOQUEUE_ALWAYS_ASYNC);
+	if (status == PJ_ENOTSUP && tp->mmsg) {
+	    /* Batch receive is not supported by the ioqueue, read to each
+	     * rdata separately instead.
+	     */
+	    PJ_ASSERT_RETURN(i == 0, status);
+	    PJ_LOG(4,(tp->base.obj_name, "Batch receive is not supported"));
+	    tp->mmsg = NULL;
+	    tp->recv_batch = 1;
+	    status = start_read(tp, i, &size, PJ_IOQUEUE_ALWAYS_ASYNC);
+	}
+
 	if (status == PJ_SUCCESS) {
 	    pj_assert(!"Shouldn't happen because PJ_IOQUEUE_ALWAYS_ASYNC!");
-	    udp_on_read_complete(tp->key, &tp->rdata[i]->tp_info.op_key.op_key,
-				 size);
+	    udp_on_read_complete(get_rdata_key(tp, i),
+				 &tp->rdata[i]->tp_info.op_key.op_key, size);
 	} else if (status != PJ_EPENDING) {
 	    /* Error! */
 	    return status;
@@ -688,9 +841,11 @@ static pj_status_t start_async_read(struct udp_transport *tp)
  */
 static pj_status_t transport_attach( pjsip_endpoint *endpt,
 				     pjsip_transport_type_e type,
-				     pj_sock_t sock,
+				     unsigned sock_cnt,
+				     const pj_sock_t sock[],
 				     const pjsip_host_port *a_name,
 				     unsigned async_cnt,
+				     unsigned recv_batch,
 				     pjsip_transport **p_transport)
 {
     pj_pool_t *pool;
@@ -699,8 +854,8 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     unsigned i;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(endpt && sock!=PJ_INVALID_SOCKET && a_name && async_cnt>0,
-		     PJ_EINVAL);
+    PJ_ASSERT_RETURN(endpt && sock_cnt && sock[0]!=PJ_INVALID_SOCKET &&
+		     a_name && async_cnt>0, PJ_EINVAL);
 
     /* Object name. */
     if (type & PJSIP_TRANSPORT_IPV6) {
@@ -724,6 +879,14 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     /* Save pool. */
     tp->base.pool = pool;
 
+    /* Number of rdata for each read operation. */
+    if (recv_batch < 1)
+	recv_batch = 1;
+    else if (recv_batch > PJ_IOQUEUE_MAX_MMSG)
+	recv_batch = PJ_IOQUEUE_MAX_MMSG;
+    tp->recv_batch = recv_batch;
+    tp->sock_rdata_cnt = async_cnt * recv_batch;
+
     pj_memcpy(tp->base.obj_name, pool->obj_name, PJ_MAX_OBJ_NAME);
 
     /* Init reference counter. */
@@ -755,7 +918,7 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     tp->base.addr_len = sizeof(tp->base.local_addr);
 
     /* Init local address. */
-    status = pj_sock_getsockname(sock, &tp->base.local_addr, 
+    status = pj_sock_getsockname(sock[0], &tp->base.local_addr, 
 				 &tp->base.addr_len);
     if (status != PJ_SUCCESS)
 	goto on_error;
@@ -776,7 +939,18 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     /* Transport manager and timer will be initialized by tpmgr */
 
     /* Attach socket and assign name. */
-    udp_set_socket(tp, sock, a_name);
+    udp_set_socket(tp, sock[0], a_name);
+
+    /* The other sockets only receive, and report to this transport */
+    if (sock_cnt > 1) {
+	tp->rp_cnt = sock_cnt - 1;
+	tp->rp_sock = (pj_sock_t*)
+		      pj_pool_alloc(pool, tp->rp_cnt * sizeof(pj_sock_t));
+	tp->rp_key = (pj_ioqueue_key_t**)
+		     pj_pool_calloc(pool, tp->rp_cnt, sizeof(pj_ioqueue_key_t*));
+	for (i=0; i<tp->rp_cnt; ++i)
+	    tp->rp_sock[i] = sock[i+1];
+    }
 
     /* Register to ioqueue */
     status = register_to_ioqueue(tp);
@@ -801,12 +975,22 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 	goto on_error;
 
 
-    /* Create rdata and put it in the array. */
+    /* Each read operation receives to a batch of rdata. */
+    if (recv_batch > 1) {
+	tp->mmsg = (pj_ioqueue_mmsg*)
+		   pj_pool_calloc(tp->base.pool,
+				  sock_cnt * tp->sock_rdata_cnt,
+				  sizeof(pj_ioqueue_mmsg));
+    }
+
+    /* Create rdata and put it in the array, with async_cnt batches of
+     * rdata for each socket.
+     */
     tp->rdata_cnt = 0;
     tp->rdata = (pjsip_rx_data**)
-    		pj_pool_calloc(tp->base.pool, async_cnt, 
+    		pj_pool_calloc(tp->base.pool, sock_cnt * tp->sock_rdata_cnt, 
 			       sizeof(pjsip_rx_data*));
-    for (i=0; i<async_cnt; ++i) {
+    for (i=0; i<sock_cnt * tp->sock_rdata_cnt; ++i) {
 	pj_pool_t *rdata_pool = pjsip_endpt_create_pool(endpt, "rtd%p", 
 							PJSIP_POOL_RDATA_LEN,
 							PJSIP_POOL_RDATA_INC);
@@ -832,13 +1016,15 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 	*p_transport = &tp->base;
     
     PJ_LOG(4,(tp->base.obj_name, 
-	      "SIP %s started, published address is %s%.*s%s:%d",
+	      "SIP %s started, published address is %s%.*s%s:%d "
+	      "(%d socket(s))",
 	      pjsip_transport_get_type_desc((pjsip_transport_type_e)tp->base.key.type),
 	      ipv6_quoteb,
 	      (int)tp->base.local_name.host.slen,
 	      tp->base.local_name.host.ptr,
 	      ipv6_quotee,
-	      tp->base.local_name.port));
+	      tp->base.local_name.port,
+	      sock_cnt));
 
     return PJ_SUCCESS;
 
@@ -854,8 +1040,8 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_attach( pjsip_endpoint *endpt,
 						unsigned async_cnt,
 						pjsip_transport **p_transport)
 {
-    return transport_attach(endpt, PJSIP_TRANSPORT_UDP, sock, a_name,
-			    async_cnt, p_transport);
+    return transport_attach(endpt, PJSIP_TRANSPORT_UDP, 1, &sock, a_name,
+			    async_cnt, PJSIP_UDP_RECV_BATCH, p_transport);
 }
 
 PJ_DEF(pj_status_t) pjsip_udp_transport_attach2( pjsip_endpoint *endpt,
@@ -865,8 +1051,115 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_attach2( pjsip_endpoint *endpt,
 						 unsigned async_cnt,
 						 pjsip_transport **p_transport)
 {
-    return transport_attach(endpt, type, sock, a_name,
-			    async_cnt, p_transport);
+    return transport_attach(endpt, type, 1, &sock, a_name,
+			    async_cnt, PJSIP_UDP_RECV_BATCH, p_transport);
+}
+
+PJ_DEF(pj_status_t) pjsip_udp_transport_attach3( pjsip_endpoint *endpt,
+						 pjsip_transport_type_e type,
+						 unsigned sock_cnt,
+						 const pj_sock_t sock[],
+						 const pjsip_host_port *a_name,
+						 unsigned async_cnt,
+						 pjsip_transport **p_transport)
+{
+    return transport_attach(endpt, type, sock_cnt, sock, a_name,
+			    async_cnt, PJSIP_UDP_RECV_BATCH, p_transport);
+}
+
+/*
+ * pjsip_udp_transport_cfg_default()
+ */
+PJ_DEF(void) pjsip_udp_transport_cfg_default(pjsip_udp_transport_cfg *cfg,
+					     int af)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->af = af;
+    cfg->async_cnt = 1;
+    cfg->recv_batch = PJSIP_UDP_RECV_BATCH;
+    cfg->sock_cnt = 1;
+}
+
+/*
+ * pjsip_udp_transport_start2()
+ *
+ * Create a UDP socket with the specified settings and start a transport.
+ */
+PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
+					pjsip_endpoint *endpt,
+					const pjsip_udp_transport_cfg *cfg,
+					pjsip_transport **p_transport)
+{
+    pjsip_transport_type_e type;
+    const pj_sockaddr *local_a = NULL;
+    int addr_len = 0;
+    const pjsip_host_port *a_name;
+    pj_sock_t sock[MAX_SOCK_CNT];
+    unsigned sock_cnt, created;
+    pj_sockaddr bound_addr;
+    pj_status_t status;
+    char addr_buf[PJ_INET6_ADDRSTRLEN];
+    pjsip_host_port bound_name;
+
+    PJ_ASSERT_RETURN(endpt && cfg && cfg->async_cnt, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cfg->af==pj_AF_INET() || cfg->af==pj_AF_INET6(),
+		     PJ_EAFNOTSUP);
+
+    type = (cfg->af==pj_AF_INET6())? PJSIP_TRANSPORT_UDP6 :
+				     PJSIP_TRANSPORT_UDP;
+
+    /* Several sockets can only share the address with SO_REUSEPORT */
+    sock_cnt = cfg->sock_cnt ? cfg->sock_cnt : 1;
+    if (sock_cnt > MAX_SOCK_CNT)
+	sock_cnt = MAX_SOCK_CNT;
+    if (sock_cnt > 1 && pj_SO_REUSEPORT() == 0xFFFF) {
+	PJ_LOG(3,(THIS_FILE, "SO_REUSEPORT is not supported, using one "
+		  "UDP socket instead of %d", sock_cnt));
+	sock_cnt = 1;
+    }
+
+    if (cfg->bind_addr.addr.sa_family) {
+	local_a = &cfg->bind_addr;
+	addr_len = pj_sockaddr_get_len(&cfg->bind_addr);
+    }
+
+    status = create_socket(cfg->af, local_a, addr_len, (sock_cnt > 1),
+			   &sock[0]);
+    if (status != PJ_SUCCESS)
+	return status;
+    created = 1;
+
+    /* Bind the other sockets to the address and port of the first one */
+    if (sock_cnt > 1) {
+	addr_len = sizeof(bound_addr);
+	status = pj_sock_getsockname(sock[0], &bound_addr, &addr_len);
+    }
+    while (status == PJ_SUCCESS && created < sock_cnt) {
+	status = create_socket(cfg->af, &bound_addr, addr_len, PJ_TRUE,
+			       &sock[created]);
+	if (status == PJ_SUCCESS)
+	    ++created;
+    }
+
+    if (status == PJ_SUCCESS && cfg->addr_name.host.slen) {
+	a_name = &cfg->addr_name;
+    } else if (status == PJ_SUCCESS) {
+	/* Address name is not specified. 
+	 * Build a name based on bound address.
+	 */
+	status = get_published_name(sock[0], addr_buf, sizeof(addr_buf), 
+				    &bound_name);
+	a_name = &bound_name;
+    }
+
+    if (status != PJ_SUCCESS) {
+	while (created)
+	    pj_sock_close(sock[--created]);
+	return status;
+    }
+
+    return transport_attach(endpt, type, sock_cnt, sock, a_name,
+			    cfg->async_cnt, cfg->recv_batch, p_transport);
 }
 
 /*
@@ -888,7 +1181,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start( pjsip_endpoint *endpt,
     PJ_ASSERT_RETURN(endpt && async_cnt, PJ_EINVAL);
 
     status = create_socket(pj_AF_INET(), local_a, sizeof(pj_sockaddr_in), 
-			   &sock);
+			   PJ_FALSE, &sock);
     if (status != PJ_SUCCESS)
 	return status;
 
@@ -930,7 +1223,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start6(pjsip_endpoint *endpt,
     PJ_ASSERT_RETURN(endpt && async_cnt, PJ_EINVAL);
 
     status = create_socket(pj_AF_INET6(), local_a, sizeof(pj_sockaddr_in6), 
-			   &sock);
+			   PJ_FALSE, &sock);
     if (status != PJ_SUCCESS)
 	return status;
 
@@ -992,10 +1285,17 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_pause(pjsip_transport *transport,
      */
     tp->is_paused = PJ_TRUE;
 
-    /* Cancel the ioqueue operation. */
-    for (i=0; i<(unsigned)tp->rdata_cnt; ++i) {
-	pj_ioqueue_post_completion(tp->key, 
-				   &tp->rdata[i]->tp_info.op_key.op_key, -1);
+    /* Cancel the ioqueue operation, which is owned by the first rdata
+     * of each batch.
+     */
+    for (i=0; i<(unsigned)tp->rdata_cnt; i+=tp->recv_batch) {
+	pj_ioqueue_key_t *key = get_rdata_key(tp, i);
+
+	if (key) {
+	    pj_ioqueue_post_completion(key, 
+				       &tp->rdata[i]->tp_info.op_key.op_key,
+				       -1);
+	}
     }
 
     /* Destroy the socket? */
@@ -1012,7 +1312,9 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_pause(pjsip_transport *transport,
 	    }
 	}
 	tp->sock = PJ_INVALID_SOCKET;
-	
+
+	/* The restarted transport will only use the new socket */
+	close_rp_sockets(tp);
     }
 
     PJ_LOG(4,(tp->base.obj_name, "SIP UDP transport paused"));
@@ -1064,11 +1366,12 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_restart(pjsip_transport *transport,
 	    }
 	}
 	tp->sock = PJ_INVALID_SOCKET;
+	close_rp_sockets(tp);
 
 	/* Create the socket if it's not specified */
 	if (sock == PJ_INVALID_SOCKET) {
 	    status = create_socket(pj_AF_INET(), local, 
-				   sizeof(pj_sockaddr_in), &sock);
+				   sizeof(pj_sockaddr_in), PJ_FALSE, &sock);
 	    if (status != PJ_SUCCESS)
 		return status;
 	}
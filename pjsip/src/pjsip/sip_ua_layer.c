@@ -70,6 +70,17 @@ struct dlg_set
 };
 
 
+/* One shard of the dialog set hash table. Each shard has its own mutex,
+ * hash table, and free dlg_set nodes, so that messages belonging to
+ * dialog sets in different shards can be processed in parallel.
+ */
+struct dlg_shard
+{
+    pj_mutex_t		*mutex;
+    pj_hash_table_t	*dlg_table;
+    struct dlg_set	 free_dlgset_nodes;
+};
+
 /*
  * Module interface.
  */
@@ -78,10 +89,9 @@ static struct user_agent
     pjsip_module	 mod;
     pj_pool_t		*pool;
     pjsip_endpoint	*endpt;
-    pj_mutex_t		*mutex;
-    pj_hash_table_t	*dlg_table;
+    pj_mutex_t		*pool_mutex;
+    struct dlg_shard	 shard[PJSIP_UA_DLG_TABLE_SHARD_CNT];
     pjsip_ua_init_param  param;
-    struct dlg_set	 free_dlgset_nodes;
 
 } mod_ua = 
 {
@@ -102,6 +112,35 @@ static struct user_agent
   }
 };
 
+/* Get the shard of the dialog set table for the specified local tag hash.
+ * The hash is mixed first so that the shard doesn't depend only on the
+ * low bits of the hash, which also select the bucket in the shard's table.
+ */
+PJ_INLINE(struct dlg_shard*) get_shard(pj_uint32_t tag_hval)
+{
+    return &mod_ua.shard[((tag_hval * 2654435761U) >> 16) %
+			 PJSIP_UA_DLG_TABLE_SHARD_CNT];
+}
+
+/* Destroy the mutexes of the dialog set table. */
+static void destroy_shards(void)
+{
+    unsigned i;
+
+    if (mod_ua.pool_mutex) {
+	pj_mutex_destroy(mod_ua.pool_mutex);
+	mod_ua.pool_mutex = NULL;
+    }
+
+    for (i=0; i<PJSIP_UA_DLG_TABLE_SHARD_CNT; ++i) {
+	if (mod_ua.shard[i].mutex) {
+	    pj_mutex_destroy(mod_ua.shard[i].mutex);
+	    mod_ua.shard[i].mutex = NULL;
+	}
+	mod_ua.shard[i].dlg_table = NULL;
+    }
+}
+
 /* 
  * mod_ua_load()
  *
@@ -109,6 +148,7 @@ static struct user_agent
  */
 static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
 {
+    unsigned i;
     pj_status_t status;
 
     /* Initialize the user agent. */
@@ -118,15 +158,31 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
     if (mod_ua.pool == NULL)
 	return PJ_ENOMEM;
 
-    status = pj_mutex_create_recursive(mod_ua.pool, " ua%p", &mod_ua.mutex);
+    status = pj_mutex_create_simple(mod_ua.pool, " uapool%p",
+				    &mod_ua.pool_mutex);
     if (status != PJ_SUCCESS)
 	return status;
 
-    mod_ua.dlg_table = pj_hash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
-    if (mod_ua.dlg_table == NULL)
-	return PJ_ENOMEM;
+    for (i=0; i<PJSIP_UA_DLG_TABLE_SHARD_CNT; ++i) {
+	struct dlg_shard *shard = &mod_ua.shard[i];
+
+	status = pj_mutex_create_recursive(mod_ua.pool, " ua%p", 
+					   &shard->mutex);
+	if (status != PJ_SUCCESS) {
+	    destroy_shards();
+	    return status;
+	}
+
+	shard->dlg_table = pj_hash_create(mod_ua.pool, 
+					  PJSIP_MAX_DIALOG_COUNT / 
+					  PJSIP_UA_DLG_TABLE_SHARD_CNT + 1);
+	if (shard->dlg_table == NULL) {
+	    destroy_shards();
+	    return PJ_ENOMEM;
+	}
 
-    pj_list_init(&mod_ua.free_dlgset_nodes);
+	pj_list_init(&shard->free_dlgset_nodes);
+    }
 
     /* Initialize dialog lock. */
     status = pj_thread_local_alloc(&pjsip_dlg_lock_tls_id);
@@ -147,7 +203,7 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
 static pj_status_t mod_ua_unload(void)
 {
     pj_thread_local_free(pjsip_dlg_lock_tls_id);
-    pj_mutex_destroy(mod_ua.mutex);
+    destroy_shards();
 
     /* Release pool */
     if (mod_ua.pool) {
@@ -258,19 +314,22 @@ PJ_DEF(void) pjsip_ua_create_dlg_set_key( pj_pool_t *pool,
 
 /*
  * Acquire one dlg_set node to be put in the hash table.
- * This will first look in the free nodes list, then allocate
+ * This will first look in the free nodes list of the shard, then allocate
  * a new one from UA's pool when one is not available.
  */
-static struct dlg_set *alloc_dlgset_node(void)
+static struct dlg_set *alloc_dlgset_node(struct dlg_shard *shard)
 {
     struct dlg_set *set;
 
-    if (!pj_list_empty(&mod_ua.free_dlgset_nodes)) {
-	set = mod_ua.free_dlgset_nodes.next;
+    if (!pj_list_empty(&shard->free_dlgset_nodes)) {
+	set = shard->free_dlgset_nodes.next;
 	pj_list_erase(set);
 	return set;
     } else {
+	/* The pool is shared by all shards */
+	pj_mutex_lock(mod_ua.pool_mutex);
 	set = PJ_POOL_ALLOC_T(mod_ua.pool, struct dlg_set);
+	pj_mutex_unlock(mod_ua.pool_mutex);
 	return set;
     }
 }
@@ -282,6 +341,8 @@ static struct dlg_set *alloc_dlgset_node(void)
 PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
 					   pjsip_dialog *dlg )
 {
+    struct dlg_shard *shard;
+
     /* Sanity check. */
     PJ_ASSERT_RETURN(ua && dlg, PJ_EINVAL);
 
@@ -294,15 +355,16 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
     //		     (dlg->role==PJSIP_ROLE_UAS && dlg->remote.info->tag.slen
     //		      && dlg->remote.tag_hval != 0), PJ_EBUG);
 
-    /* Lock the user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the shard of the dialog set. */
+    shard = get_shard(dlg->local.tag_hval);
+    pj_mutex_lock(shard->mutex);
 
     /* For UAC, check if there is existing dialog in the same set. */
     if (dlg->role == PJSIP_ROLE_UAC) {
 	struct dlg_set *dlg_set;
 
 	dlg_set = (struct dlg_set*)
-		  pj_hash_get_lower( mod_ua.dlg_table,
+		  pj_hash_get_lower( shard->dlg_table,
                                      dlg->local.info->tag.ptr, 
 			             (unsigned)dlg->local.info->tag.slen,
 			             &dlg->local.tag_hval);
@@ -320,14 +382,14 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
 	    /* This is the first dialog in the dialog set. 
 	     * Create the dialog set and add this dialog to it.
 	     */
-	    dlg_set = alloc_dlgset_node();
+	    dlg_set = alloc_dlgset_node(shard);
 	    pj_list_init(&dlg_set->dlg_list);
 	    pj_list_push_back(&dlg_set->dlg_list, dlg);
 
 	    dlg->dlg_set = dlg_set;
 
 	    /* Register the dialog set in the hash table. */
-	    pj_hash_set_np_lower(mod_ua.dlg_table, 
+	    pj_hash_set_np_lower(shard->dlg_table, 
 			         dlg->local.info->tag.ptr,
                                  (unsigned)dlg->local.info->tag.slen,
 			         dlg->local.tag_hval, dlg_set->ht_entry,
@@ -338,20 +400,20 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
 	/* For UAS, create the dialog set with a single dialog as member. */
 	struct dlg_set *dlg_set;
 
-	dlg_set = alloc_dlgset_node();
+	dlg_set = alloc_dlgset_node(shard);
 	pj_list_init(&dlg_set->dlg_list);
 	pj_list_push_back(&dlg_set->dlg_list, dlg);
 
 	dlg->dlg_set = dlg_set;
 
-	pj_hash_set_np_lower(mod_ua.dlg_table, 
+	pj_hash_set_np_lower(shard->dlg_table, 
 		             dlg->local.info->tag.ptr,
                              (unsigned)dlg->local.info->tag.slen,
 		             dlg->local.tag_hval, dlg_set->ht_entry, dlg_set);
     }
 
-    /* Unlock user agent. */
-    pj_mutex_unlock(mod_ua.mutex);
+    /* Unlock the shard. */
+    pj_mutex_unlock(shard->mutex);
 
     /* Done. */
     return PJ_SUCCESS;
@@ -361,6 +423,7 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
 PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
 					     pjsip_dialog *dlg )
 {
+    struct dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *d;
 
@@ -370,8 +433,9 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
     /* Check that dialog has been registered. */
     PJ_ASSERT_RETURN(dlg->dlg_set, PJ_EINVALIDOP);
 
-    /* Lock user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the shard of the dialog set. */
+    shard = get_shard(dlg->local.tag_hval);
+    pj_mutex_lock(shard->mutex);
 
     /* Find this dialog from the dialog set. */
     dlg_set = (struct dlg_set*) dlg->dlg_set;
@@ -382,7 +446,7 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
 
     if (d != dlg) {
 	pj_assert(!"Dialog is not registered!");
-	pj_mutex_unlock(mod_ua.mutex);
+	pj_mutex_unlock(shard->mutex);
 	return PJ_EINVALIDOP;
     }
 
@@ -391,16 +455,16 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
 
     /* If dialog list is empty, remove the dialog set from the hash table. */
     if (pj_list_empty(&dlg_set->dlg_list)) {
-	pj_hash_set_lower(NULL, mod_ua.dlg_table, dlg->local.info->tag.ptr,
+	pj_hash_set_lower(NULL, shard->dlg_table, dlg->local.info->tag.ptr,
 		          (unsigned)dlg->local.info->tag.slen, 
 			  dlg->local.tag_hval, NULL);
 
 	/* Return dlg_set to free nodes. */
-	pj_list_push_back(&mod_ua.free_dlgset_nodes, dlg_set);
+	pj_list_push_back(&shard->free_dlgset_nodes, dlg_set);
     }
 
-    /* Unlock user agent. */
-    pj_mutex_unlock(mod_ua.mutex);
+    /* Unlock the shard. */
+    pj_mutex_unlock(shard->mutex);
 
     /* Done. */
     return PJ_SUCCESS;
@@ -424,13 +488,15 @@ PJ_DEF(pjsip_dialog*) pjsip_tsx_get_dlg( pjsip_transaction *tsx )
  */
 PJ_DEF(unsigned) pjsip_ua_get_dlg_set_count(void)
 {
-    unsigned count;
+    unsigned i, count = 0;
 
     PJ_ASSERT_RETURN(mod_ua.endpt, 0);
 
-    pj_mutex_lock(mod_ua.mutex);
-    count = pj_hash_count(mod_ua.dlg_table);
-    pj_mutex_unlock(mod_ua.mutex);
+    for (i=0; i<PJSIP_UA_DLG_TABLE_SHARD_CNT; ++i) {
+	pj_mutex_lock(mod_ua.shard[i].mutex);
+	count += pj_hash_count(mod_ua.shard[i].dlg_table);
+	pj_mutex_unlock(mod_ua.shard[i].mutex);
+    }
 
     return count;
 }
@@ -444,21 +510,25 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
 					   const pj_str_t *remote_tag,
 					   pj_bool_t lock_dialog)
 {
+    struct dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *dlg;
+    pj_uint32_t hval;
 
     PJ_ASSERT_RETURN(call_id && local_tag && remote_tag, NULL);
 
-    /* Lock user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the shard of the dialog set. */
+    hval = pj_hash_calc_tolower(0, NULL, local_tag);
+    shard = get_shard(hval);
+    pj_mutex_lock(shard->mutex);
 
     /* Lookup the dialog set. */
     dlg_set = (struct dlg_set*)
-    	      pj_hash_get_lower(mod_ua.dlg_table, local_tag->ptr,
-                                (unsigned)local_tag->slen, NULL);
+    	      pj_hash_get_lower(shard->dlg_table, local_tag->ptr,
+                                (unsigned)local_tag->slen, &hval);
     if (dlg_set == NULL) {
 	/* Not found */
-	pj_mutex_unlock(mod_ua.mutex);
+	pj_mutex_unlock(shard->mutex);
 	return NULL;
     }
 
@@ -474,38 +544,38 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
 
     if (dlg == (pjsip_dialog*)&dlg_set->dlg_list) {
 	/* Not found */
-	pj_mutex_unlock(mod_ua.mutex);
+	pj_mutex_unlock(shard->mutex);
 	return NULL;
     }
 
     /* Dialog has been found. It SHOULD have the right Call-ID!! */
     PJ_ASSERT_ON_FAIL(pj_strcmp(&dlg->call_id->id, call_id)==0, 
-			{pj_mutex_unlock(mod_ua.mutex); return NULL;});
+			{pj_mutex_unlock(shard->mutex); return NULL;});
 
     if (lock_dialog) {
 	if (pjsip_dlg_try_inc_lock(dlg) != PJ_SUCCESS) {
 
 	    /*
-	     * Unable to acquire dialog's lock while holding the user
-	     * agent's mutex. Release the UA mutex before retrying once
+	     * Unable to acquire dialog's lock while holding the mutex
+	     * of the shard. Release the shard mutex before retrying once
 	     * more.
 	     *
 	     * THIS MAY CAUSE RACE CONDITION!
 	     */
 
-	    /* Unlock user agent. */
-	    pj_mutex_unlock(mod_ua.mutex);
+	    /* Unlock the shard. */
+	    pj_mutex_unlock(shard->mutex);
 	    /* Lock dialog */
 	    pjsip_dlg_inc_lock(dlg);
 
 	} else {
-	    /* Unlock user agent. */
-	    pj_mutex_unlock(mod_ua.mutex);
+	    /* Unlock the shard. */
+	    pj_mutex_unlock(shard->mutex);
 	}
 
     } else {
-	/* Unlock user agent. */
-	pj_mutex_unlock(mod_ua.mutex);
+	/* Unlock the shard. */
+	pj_mutex_unlock(shard->mutex);
     }
 
     return dlg;
@@ -514,8 +584,11 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
 
 /*
  * Find the first dialog in dialog set in hash table for an incoming message.
+ * When the dialog set is found, the mutex of its shard is locked and
+ * returned in p_shard.
  */
-static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
+static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata,
+					     struct dlg_shard **p_shard )
 {
     /* CANCEL message doesn't have To tag, so we must lookup the dialog
      * by finding the INVITE UAS transaction being cancelled.
@@ -530,6 +603,8 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 	pj_str_t key;
 	pjsip_role_e role;
 	pjsip_transaction *tsx;
+	struct dlg_shard *shard;
+	struct dlg_set *dlg_set;
 
 	if (rdata->msg_info.msg->type == PJSIP_REQUEST_MSG)
 	    role = PJSIP_ROLE_UAS;
@@ -539,18 +614,44 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 	pjsip_tsx_create_key(rdata->tp_info.pool, &key, role, 
 			     pjsip_get_invite_method(), rdata);
 
+retry_on_deadlock:
 	/* Lookup the INVITE transaction */
 	tsx = pjsip_tsx_layer_find_tsx(&key, PJ_TRUE);
 
 	/* We should find the dialog attached to the INVITE transaction */
 	if (tsx) {
 	    dlg = (pjsip_dialog*) tsx->mod_data[mod_ua.mod.id];
-	    pj_grp_lock_release(tsx->grp_lock);
 
 	    /* Dlg may be NULL on some extreme condition
 	     * (e.g. during debugging where initially there is a dialog)
 	     */
-	    return dlg ? (struct dlg_set*) dlg->dlg_set : NULL;
+	    if (!dlg) {
+		pj_grp_lock_release(tsx->grp_lock);
+		return NULL;
+	    }
+
+	    /* Lock the shard while the transaction is still locked, so
+	     * that the dialog can't be unregistered in between. The shard
+	     * is normally locked before the transaction, so only try the
+	     * lock to avoid deadlock.
+	     */
+	    shard = get_shard(dlg->local.tag_hval);
+	    if (pj_mutex_trylock(shard->mutex) != PJ_SUCCESS) {
+		pj_grp_lock_release(tsx->grp_lock);
+		pj_thread_sleep(0);
+		goto retry_on_deadlock;
+	    }
+
+	    dlg_set = (struct dlg_set*) dlg->dlg_set;
+	    pj_grp_lock_release(tsx->grp_lock);
+
+	    if (!dlg_set) {
+		pj_mutex_unlock(shard->mutex);
+		return NULL;
+	    }
+
+	    *p_shard = shard;
+	    return dlg_set;
 
 	} else {
 	    return NULL;
@@ -559,17 +660,30 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 
     } else {
 	pj_str_t *tag;
+	struct dlg_shard *shard;
 	struct dlg_set *dlg_set;
+	pj_uint32_t hval;
 
 	if (rdata->msg_info.msg->type == PJSIP_REQUEST_MSG)
 	    tag = &rdata->msg_info.to->tag;
 	else
 	    tag = &rdata->msg_info.from->tag;
 
+	/* Lock the shard before looking up the dialog set. */
+	hval = pj_hash_calc_tolower(0, NULL, tag);
+	shard = get_shard(hval);
+	pj_mutex_lock(shard->mutex);
+
 	/* Lookup the dialog set. */
 	dlg_set = (struct dlg_set*)
-		  pj_hash_get_lower(mod_ua.dlg_table, tag->ptr, 
-				    (unsigned)tag->slen, NULL);
+		  pj_hash_get_lower(shard->dlg_table, tag->ptr, 
+				    (unsigned)tag->slen, &hval);
+	if (!dlg_set) {
+	    pj_mutex_unlock(shard->mutex);
+	    return NULL;
+	}
+
+	*p_shard = shard;
 	return dlg_set;
     }
 }
@@ -577,6 +691,7 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 /* On received requests. */
 static pj_bool_t mod_ua_on_rx_request(pjsip_rx_data *rdata)
 {
+    struct dlg_shard *shard;
     struct dlg_set *dlg_set;
     pj_str_t *from_tag;
     pjsip_dialog *dlg;
@@ -597,18 +712,16 @@ static pj_bool_t mod_ua_on_rx_request(pjsip_rx_data *rdata)
 
 retry_on_deadlock:
 
-    /* Lock user agent before looking up the dialog hash table. */
-    pj_mutex_lock(mod_ua.mutex);
-
-    /* Lookup the dialog set, based on the To tag header. */
-    dlg_set = find_dlg_set_for_msg(rdata);
+    /* Lookup the dialog set, based on the To tag header. This locks
+     * the shard of the dialog set when it's found.
+     */
+    dlg_set = find_dlg_set_for_msg(rdata, &shard);
 
     /* If dialog is not found, respond with 481 (Call/Transaction
      * Does Not Exist).
      */
     if (dlg_set == NULL) {
 	/* Unable to find dialog. */
-	pj_mutex_unlock(mod_ua.mutex);
 
 	if (rdata->msg_info.msg->line.req.method.id != PJSIP_ACK_METHOD) {
 	    PJ_LOG(5,(THIS_FILE, 
@@ -649,7 +762,7 @@ retry_on_deadlock:
 
 	if (first_dlg->remote.info->tag.slen != 0) {
 	    /* Not found. Mulfunction UAC? */
-	    pj_mutex_unlock(mod_ua.mutex);
+	    pj_mutex_unlock(shard->mutex);
 
 	    if (rdata->msg_info.msg->line.req.method.id != PJSIP_ACK_METHOD) {
 		PJ_LOG(5,(THIS_FILE, 
@@ -678,16 +791,16 @@ retry_on_deadlock:
     status = pjsip_dlg_try_inc_lock(dlg);
     if (status != PJ_SUCCESS) {
 	/* Failed to acquire dialog mutex immediately, this could be 
-	 * because of deadlock. Release UA mutex, yield, and retry 
+	 * because of deadlock. Release shard mutex, yield, and retry 
 	 * the whole thing once again.
 	 */
-	pj_mutex_unlock(mod_ua.mutex);
+	pj_mutex_unlock(shard->mutex);
 	pj_thread_sleep(0);
 	goto retry_on_deadlock;
     }
 
     /* Done with processing in UA layer, release lock */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Pass to dialog. */
     pjsip_dlg_on_rx_request(dlg, rdata);
@@ -705,6 +818,7 @@ retry_on_deadlock:
 static pj_bool_t mod_ua_on_rx_response(pjsip_rx_data *rdata)
 {
     pjsip_transaction *tsx;
+    struct dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *dlg;
     pj_status_t status;
@@ -723,19 +837,17 @@ retry_on_deadlock:
 
     dlg = NULL;
 
-    /* Lock user agent dlg table before we're doing anything. */
-    pj_mutex_lock(mod_ua.mutex);
-
     /* Check if transaction is present. */
     tsx = pjsip_rdata_get_tsx(rdata);
     if (tsx) {
 	/* Check if dialog is present in the transaction. */
 	dlg = pjsip_tsx_get_dlg(tsx);
-	if (!dlg) {
-	    /* Unlock dialog hash table. */
-	    pj_mutex_unlock(mod_ua.mutex);
+	if (!dlg)
 	    return PJ_FALSE;
-	}
+
+	/* Lock the shard of the dialog set. */
+	shard = get_shard(dlg->local.tag_hval);
+	pj_mutex_lock(shard->mutex);
 
 	/* Get the dialog set. */
 	dlg_set = (struct dlg_set*) dlg->dlg_set;
@@ -751,6 +863,7 @@ retry_on_deadlock:
 	 * dialog.
 	 */
 	pjsip_cseq_hdr *cseq_hdr = rdata->msg_info.cseq;
+	pj_uint32_t hval;
 
 	if (cseq_hdr->method.id != PJSIP_INVITE_METHOD ||
 	    rdata->msg_info.msg->line.status.code / 100 != 2)
@@ -759,22 +872,24 @@ retry_on_deadlock:
 	     * This must be some stateless response sent by other modules,
 	     * or a very late response.
 	     */
-	    /* Unlock dialog hash table. */
-	    pj_mutex_unlock(mod_ua.mutex);
 	    return PJ_FALSE;
 	}
 
+	/* Lock the shard of the dialog set. */
+	hval = pj_hash_calc_tolower(0, NULL, &rdata->msg_info.from->tag);
+	shard = get_shard(hval);
+	pj_mutex_lock(shard->mutex);
 
 	/* Get the dialog set. */
 	dlg_set = (struct dlg_set*)
-		  pj_hash_get_lower(mod_ua.dlg_table, 
+		  pj_hash_get_lower(shard->dlg_table, 
 			            rdata->msg_info.from->tag.ptr,
 			            (unsigned)rdata->msg_info.from->tag.slen,
-			            NULL);
+			            &hval);
 
 	if (!dlg_set) {
 	    /* Unlock dialog hash table. */
-	    pj_mutex_unlock(mod_ua.mutex);
+	    pj_mutex_unlock(shard->mutex);
 
 	    /* Strayed 2xx response!! */
 	    PJ_LOG(4,(THIS_FILE, 
@@ -844,7 +959,7 @@ retry_on_deadlock:
 		dlg = (*mod_ua.param.on_dlg_forked)(dlg_set->dlg_list.next, 
 						    rdata);
 		if (dlg == NULL) {
-		    pj_mutex_unlock(mod_ua.mutex);
+		    pj_mutex_unlock(shard->mutex);
 		    return PJ_TRUE;
 		}
 	    } else {
@@ -888,15 +1003,15 @@ retry_on_deadlock:
     if (status != PJ_SUCCESS) {
 	/* Failed to acquire dialog mutex. This could indicate a deadlock
 	 * situation, and for safety, try to avoid deadlock by releasing
-	 * UA mutex, yield, and retry the whole processing once again.
+	 * shard mutex, yield, and retry the whole processing once again.
 	 */
-	pj_mutex_unlock(mod_ua.mutex);
+	pj_mutex_unlock(shard->mutex);
 	pj_thread_sleep(0);
 	goto retry_on_deadlock;
     }
 
     /* We're done with processing in the UA layer, we can release the mutex */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Pass the response to the dialog. */
     pjsip_dlg_on_rx_response(dlg, rdata);
@@ -942,21 +1057,28 @@ PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_hash_iterator_t itbuf, *it;
     char dlginfo[128];
-
-    pj_mutex_lock(mod_ua.mutex);
+    unsigned i;
 
     PJ_LOG(3, (THIS_FILE, "Number of dialog sets: %u", 
-			  pj_hash_count(mod_ua.dlg_table)));
+			  pjsip_ua_get_dlg_set_count()));
 
-    if (detail && pj_hash_count(mod_ua.dlg_table)) {
-	PJ_LOG(3, (THIS_FILE, "Dumping dialog sets:"));
-	it = pj_hash_first(mod_ua.dlg_table, &itbuf);
-	for (; it != NULL; it = pj_hash_next(mod_ua.dlg_table, it))  {
+    if (!detail || pjsip_ua_get_dlg_set_count() == 0)
+	return;
+
+    PJ_LOG(3, (THIS_FILE, "Dumping dialog sets:"));
+
+    for (i=0; i<PJSIP_UA_DLG_TABLE_SHARD_CNT; ++i) {
+	struct dlg_shard *shard = &mod_ua.shard[i];
+
+	pj_mutex_lock(shard->mutex);
+
+	it = pj_hash_first(shard->dlg_table, &itbuf);
+	for (; it != NULL; it = pj_hash_next(shard->dlg_table, it))  {
 	    struct dlg_set *dlg_set;
 	    pjsip_dialog *dlg;
 	    const char *title;
 
-	    dlg_set = (struct dlg_set*) pj_hash_this(mod_ua.dlg_table, it);
+	    dlg_set = (struct dlg_set*) pj_hash_this(shard->dlg_table, it);
 	    if (!dlg_set || pj_list_empty(&dlg_set->dlg_list)) continue;
 
 	    /* First dialog in dialog set. */
@@ -976,9 +1098,10 @@ PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
 		dlg = dlg->next;
 	    }
 	}
-    }
 
-    pj_mutex_unlock(mod_ua.mutex);
+	pj_mutex_unlock(shard->mutex);
+    }
+#else
+    PJ_UNUSED_ARG(detail);
 #endif
 }
-
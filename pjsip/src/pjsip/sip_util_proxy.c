@@ -21,6 +21,7 @@
 #include <pjsip/sip_endpoint.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_msg.h>
+#include <pjsip/print_util.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
 #include <pj/except.h>
@@ -324,6 +325,422 @@ on_error:
 }
 
 
+/*
+ * Splice forwarding.
+ *
+ * The forwarded message is made of a few parsed headers, which the proxy
+ * and the transport layer need to inspect or modify, followed by the rest
+ * of the header block and the body of the received message, which are
+ * copied verbatim as one raw header.
+ */
+
+/* Raw header block, printed as is. */
+static int raw_hdr_print(pjsip_generic_string_hdr *hdr,
+			 char *buf, pj_size_t size)
+{
+    if ((pj_ssize_t)size < hdr->hvalue.slen)
+	return -1;
+
+    pj_memcpy(buf, hdr->hvalue.ptr, hdr->hvalue.slen);
+    return (int)hdr->hvalue.slen;
+}
+
+static pjsip_generic_string_hdr* raw_hdr_shallow_clone(pj_pool_t *pool,
+				    const pjsip_generic_string_hdr *rhs)
+{
+    pjsip_generic_string_hdr *hdr;
+
+    hdr = PJ_POOL_ALLOC_T(pool, pjsip_generic_string_hdr);
+    pj_memcpy(hdr, rhs, sizeof(*hdr));
+    return hdr;
+}
+
+static pjsip_generic_string_hdr* raw_hdr_clone(pj_pool_t *pool,
+				    const pjsip_generic_string_hdr *rhs)
+{
+    pjsip_generic_string_hdr *hdr = raw_hdr_shallow_clone(pool, rhs);
+
+    pj_strdup(pool, &hdr->hvalue, &rhs->hvalue);
+    return hdr;
+}
+
+static pjsip_hdr_vptr raw_hdr_vptr = 
+{
+    (pjsip_hdr_clone_fptr) &raw_hdr_clone,
+    (pjsip_hdr_clone_fptr) &raw_hdr_shallow_clone,
+    (pjsip_hdr_print_fptr) &raw_hdr_print,
+};
+
+/* Headers of the received message which are handled by splice forwarding */
+enum splice_hdr
+{
+    SPLICE_HDR_OTHER,
+    SPLICE_HDR_VIA,
+    SPLICE_HDR_ROUTE,
+    SPLICE_HDR_MAX_FWD,
+    SPLICE_HDR_CSEQ,
+    SPLICE_HDR_CLEN
+};
+
+static enum splice_hdr get_splice_hdr(const pj_str_t *hname)
+{
+    if (pj_stricmp2(hname, "Via")==0 || pj_stricmp2(hname, "v")==0)
+	return SPLICE_HDR_VIA;
+    else if (pj_stricmp2(hname, "Route")==0)
+	return SPLICE_HDR_ROUTE;
+    else if (pj_stricmp2(hname, "Max-Forwards")==0)
+	return SPLICE_HDR_MAX_FWD;
+    else if (pj_stricmp2(hname, "CSeq")==0)
+	return SPLICE_HDR_CSEQ;
+    else if (pj_stricmp2(hname, "Content-Length")==0 ||
+	     pj_stricmp2(hname, "l")==0)
+	return SPLICE_HDR_CLEN;
+    return SPLICE_HDR_OTHER;
+}
+
+/* Get the start of the next line. */
+static const char *splice_next_line(const char *p, const char *end)
+{
+    const char *eol = (const char*) pj_memchr(p, '\n', end-p);
+    return eol ? eol+1 : end;
+}
+
+/* Get the end of the first value of a comma separated header value. */
+static const char *splice_next_value(const char *p, const char *end)
+{
+    pj_bool_t quoted = PJ_FALSE;
+
+    for (; p < end; ++p) {
+	if (*p == '"')
+	    quoted = !quoted;
+	else if (*p == '\\' && quoted && p+1 < end)
+	    ++p;
+	else if (*p == ',' && !quoted)
+	    return p;
+    }
+    return end;
+}
+
+/*
+ * Copy the header block and the body of the received message to the
+ * message in tdata, leaving out the headers that have been added to
+ * the message as parsed headers, and the first strip_via Via values.
+ * Route and Max-Forwards headers are left out for requests only.
+ */
+static pj_status_t splice_raw_msg(pjsip_tx_data *tdata,
+				  const pjsip_rx_data *rdata,
+				  unsigned strip_via)
+{
+    const pj_bool_t is_req = (rdata->msg_info.msg->type==PJSIP_REQUEST_MSG);
+    const char *p = rdata->msg_info.msg_buf;
+    const char *end = p + rdata->msg_info.len;
+    pjsip_generic_string_hdr *raw;
+    pjsip_msg_body *body;
+    char *buf, *out;
+    pj_size_t body_len;
+
+    buf = out = (char*) pj_pool_alloc(tdata->pool, rdata->msg_info.len + 32);
+
+    /* Skip the request or status line */
+    p = splice_next_line(p, end);
+
+    /* Copy the headers, up to the blank line */
+    while (p < end) {
+	const char *hstart = p, *hend, *colon;
+	pj_str_t hname;
+	pj_bool_t copy = PJ_TRUE;
+
+	if (*p == '\r' || *p == '\n') {
+	    p = splice_next_line(p, end);
+	    break;
+	}
+
+	/* Find the end of the header, including continuation lines */
+	hend = splice_next_line(p, end);
+	while (hend < end && (*hend == ' ' || *hend == '\t'))
+	    hend = splice_next_line(hend, end);
+
+	colon = (const char*) pj_memchr(hstart, ':', hend-hstart);
+	if (colon == NULL)
+	    return PJSIP_EINVALIDHDR;
+
+	hname.ptr = (char*)hstart;
+	hname.slen = colon - hstart;
+	pj_strrtrim(&hname);
+
+	switch (get_splice_hdr(&hname)) {
+	case SPLICE_HDR_VIA:
+	    if (strip_via) {
+		const char *val = colon + 1;
+
+		/* Remove values until there's nothing left to strip */
+		while (strip_via && val < hend) {
+		    val = splice_next_value(val, hend);
+		    --strip_via;
+		    if (val < hend)
+			++val;
+		}
+
+		copy = PJ_FALSE;
+		if (val < hend) {
+		    /* Copy the header with the remaining values */
+		    pj_memcpy(out, hstart, colon + 1 - hstart);
+		    out += colon + 1 - hstart;
+		    pj_memcpy(out, val, hend - val);
+		    out += hend - val;
+		}
+	    }
+	    break;
+	case SPLICE_HDR_ROUTE:
+	case SPLICE_HDR_MAX_FWD:
+	    copy = !is_req;
+	    break;
+	case SPLICE_HDR_CSEQ:
+	    copy = PJ_FALSE;
+	    break;
+	case SPLICE_HDR_CLEN:
+	    copy = PJ_FALSE;
+	    break;
+	default:
+	    break;
+	}
+
+	if (copy) {
+	    pj_memcpy(out, hstart, hend - hstart);
+	    out += hend - hstart;
+	}
+
+	p = hend;
+    }
+
+    /* Only the body as declared by Content-Length is forwarded, the rest
+     * of a datagram is to be ignored. Content-Length is always written
+     * from the length of the body that is forwarded, since it's optional
+     * for UDP but the message may be forwarded over stream transport,
+     * where the receiver relies on it to find the end of the message.
+     */
+    body_len = end - p;
+    if (rdata->msg_info.clen && rdata->msg_info.clen->len >= 0 &&
+	(pj_size_t)rdata->msg_info.clen->len < body_len)
+    {
+	body_len = rdata->msg_info.clen->len;
+    }
+    out += pj_ansi_snprintf(out, 32, "Content-Length: %d\r\n",
+			    (int)body_len);
+
+    /* The last line break is printed by pjsip_msg_print() */
+    if (out > buf && out[-1] == '\n')
+	--out;
+    if (out > buf && out[-1] == '\r')
+	--out;
+
+    raw = PJ_POOL_ZALLOC_T(tdata->pool, pjsip_generic_string_hdr);
+    raw->type = PJSIP_H_OTHER;
+    raw->vptr = &raw_hdr_vptr;
+    raw->hvalue.ptr = buf;
+    raw->hvalue.slen = out - buf;
+    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)raw);
+
+    /* Body is copied verbatim. Content type of the body is left empty,
+     * since Content-Type and Content-Length are in the raw header block.
+     * Body is set even when it's empty, otherwise pjsip_msg_print() adds
+     * another Content-Length header.
+     */
+    body = PJ_POOL_ZALLOC_T(tdata->pool, pjsip_msg_body);
+    body->len = (unsigned)body_len;
+    body->data = pj_pool_alloc(tdata->pool, body->len + 1);
+    pj_memcpy(body->data, p, body->len);
+    body->print_body = &pjsip_print_text_body;
+    body->clone_data = &pjsip_clone_text_data;
+    tdata->msg->body = body;
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Create request to be forwarded, splicing the received packet.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_create_request_splice(pjsip_endpoint *endpt,
+						      pjsip_rx_data *rdata, 
+						      const pjsip_uri *uri,
+						      const pj_str_t *branch,
+						      unsigned options,
+						      pjsip_tx_data **p_tdata)
+{
+    pjsip_tx_data *tdata;
+    pjsip_msg *dst;
+    const pjsip_msg *src;
+    const pjsip_hdr *hsrc;
+    pjsip_via_hdr *hvia;
+    pjsip_max_fwd_hdr *hmaxfwd;
+    pj_status_t status;
+    PJ_USE_EXCEPTION;
+
+
+    PJ_ASSERT_RETURN(endpt && rdata && p_tdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN(rdata->msg_info.msg->type == PJSIP_REQUEST_MSG, 
+		     PJSIP_ENOTREQUESTMSG);
+    PJ_ASSERT_RETURN(rdata->msg_info.msg_buf && rdata->msg_info.via &&
+		     rdata->msg_info.cseq, PJSIP_EMISSINGHDR);
+
+    PJ_UNUSED_ARG(options);
+
+    status = pjsip_endpt_create_tdata(endpt, &tdata);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Always increment ref counter to 1 */
+    pjsip_tx_data_add_ref(tdata);
+
+    src = rdata->msg_info.msg;
+
+    PJ_TRY {
+	/* Create the request */
+	tdata->msg = dst = pjsip_msg_create(tdata->pool, PJSIP_REQUEST_MSG);
+
+	/* Duplicate request method */
+	pjsip_method_copy(tdata->pool, &dst->line.req.method,
+			  &src->line.req.method);
+
+	/* Set request URI */
+	dst->line.req.uri = (pjsip_uri*) 
+			    pjsip_uri_clone(tdata->pool, 
+					    uri ? uri : src->line.req.uri);
+
+	/* Add our own Via */
+	hvia = pjsip_via_hdr_create(tdata->pool);
+	if (branch)
+	    pj_strdup(tdata->pool, &hvia->branch_param, branch);
+	else {
+	    pj_str_t new_branch = pjsip_calculate_branch_id(rdata);
+	    pj_strdup(tdata->pool, &hvia->branch_param, &new_branch);
+	}
+	pjsip_msg_add_hdr(dst, (pjsip_hdr*)hvia);
+
+	/* The top Via of the request has the received and rport params,
+	 * which were added when the request was received.
+	 */
+	pjsip_msg_add_hdr(dst, (pjsip_hdr*)
+			  pjsip_hdr_clone(tdata->pool, rdata->msg_info.via));
+
+	/* Decrement Max-Forwards, or add one if it's not present. */
+	if (rdata->msg_info.max_fwd) {
+	    hmaxfwd = (pjsip_max_fwd_hdr*)
+		      pjsip_hdr_clone(tdata->pool, rdata->msg_info.max_fwd);
+	    --hmaxfwd->ivalue;
+	} else {
+	    hmaxfwd = pjsip_max_fwd_hdr_create(tdata->pool, 70);
+	}
+	pjsip_msg_add_hdr(dst, (pjsip_hdr*)hmaxfwd);
+
+	/* Route headers are needed to process the route set */
+	hsrc = (const pjsip_hdr*)
+	       pjsip_msg_find_hdr(src, PJSIP_H_ROUTE, NULL);
+	while (hsrc) {
+	    pjsip_msg_add_hdr(dst, (pjsip_hdr*)
+			      pjsip_hdr_clone(tdata->pool, hsrc));
+	    hsrc = (const pjsip_hdr*)
+		   pjsip_msg_find_hdr(src, PJSIP_H_ROUTE, hsrc->next);
+	}
+
+	/* CSeq is needed to describe the message */
+	pjsip_msg_add_hdr(dst, (pjsip_hdr*)
+			  pjsip_hdr_clone(tdata->pool, rdata->msg_info.cseq));
+
+	/* The rest is copied verbatim */
+	status = splice_raw_msg(tdata, rdata, 1);
+    }
+    PJ_CATCH_ANY {
+	status = PJ_ENOMEM;
+    }
+    PJ_END
+
+    if (status != PJ_SUCCESS) {
+	pjsip_tx_data_dec_ref(tdata);
+	return status;
+    }
+
+    *p_tdata = tdata;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Create response to be forwarded, splicing the received packet.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_create_response_splice(pjsip_endpoint *endpt,
+						       pjsip_rx_data *rdata, 
+						       unsigned options,
+						       pjsip_tx_data **p_tdata)
+{
+    pjsip_tx_data *tdata;
+    pjsip_msg *dst;
+    const pjsip_msg *src;
+    const pjsip_hdr *hvia = NULL;
+    pj_status_t status;
+    PJ_USE_EXCEPTION;
+
+    PJ_ASSERT_RETURN(endpt && rdata && p_tdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN(rdata->msg_info.msg->type == PJSIP_RESPONSE_MSG,
+		     PJSIP_ENOTRESPONSEMSG);
+    PJ_ASSERT_RETURN(rdata->msg_info.msg_buf && rdata->msg_info.cseq,
+		     PJSIP_EMISSINGHDR);
+
+    PJ_UNUSED_ARG(options);
+
+    status = pjsip_endpt_create_tdata(endpt, &tdata);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pjsip_tx_data_add_ref(tdata);
+
+    src = rdata->msg_info.msg;
+
+    PJ_TRY {
+	/* Create the response */
+	tdata->msg = dst = pjsip_msg_create(tdata->pool, PJSIP_RESPONSE_MSG);
+
+	/* Clone the status line */
+	dst->line.status.code = src->line.status.code;
+	pj_strdup(tdata->pool, &dst->line.status.reason, 
+		  &src->line.status.reason);
+
+	/* The first Via is removed, and the next one is needed to
+	 * determine where to forward the response.
+	 */
+	if (rdata->msg_info.via) {
+	    hvia = (const pjsip_hdr*)
+		   pjsip_msg_find_hdr(src, PJSIP_H_VIA,
+				      rdata->msg_info.via->next);
+	}
+	if (hvia) {
+	    pjsip_msg_add_hdr(dst, (pjsip_hdr*)
+			      pjsip_hdr_clone(tdata->pool, hvia));
+	}
+
+	/* CSeq is needed to describe the message */
+	pjsip_msg_add_hdr(dst, (pjsip_hdr*)
+			  pjsip_hdr_clone(tdata->pool, rdata->msg_info.cseq));
+
+	/* The rest is copied verbatim */
+	status = splice_raw_msg(tdata, rdata, (hvia ? 2 : 1));
+    }
+    PJ_CATCH_ANY {
+	status = PJ_ENOMEM;
+    }
+    PJ_END
+
+    if (status != PJ_SUCCESS) {
+	pjsip_tx_data_dec_ref(tdata);
+	return status;
+    }
+
+    *p_tdata = tdata;
+    return PJ_SUCCESS;
+}
+
+
 static void digest2str(const unsigned char digest[], char *output)
 {
     int i;
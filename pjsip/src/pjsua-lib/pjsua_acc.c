@@ -49,8 +49,8 @@ PJ_DEF(unsigned) pjsua_acc_get_count(void)
  */
 PJ_DEF(pj_bool_t) pjsua_acc_is_valid(pjsua_acc_id acc_id)
 {
-    return acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc) &&
-	   pjsua_var.acc[acc_id].valid;
+    return PJSUA_ACC_ID_IS_VALID(acc_id) &&
+	   PJSUA_ACC(acc_id)->valid;
 }
 
 
@@ -155,13 +155,267 @@ static pj_uint32_t calc_proxy_crc(const pj_str_t proxy[], pj_size_t cnt)
     return pj_crc32_final(&ctx);
 }
 
+/*
+ * Init account subsystem.
+ */
+pj_status_t pjsua_acc_subsys_init(const pjsua_config *cfg)
+{
+    unsigned i;
+
+    PJ_UNUSED_ARG(cfg);
+
+    /* Verify settings */
+    if (pjsua_var.ua_cfg.max_acc == 0) {
+	pjsua_var.ua_cfg.max_acc = 1;
+    }
+
+    /* Init account table. Like the call table, only the chunk pointers
+     * are allocated here.
+     */
+    pjsua_var.acc = (pjsua_acc**)
+		    pj_pool_calloc(pjsua_var.pool,
+				   (pjsua_var.ua_cfg.max_acc +
+				    PJSUA_ACC_CHUNK_SIZE - 1) /
+				   PJSUA_ACC_CHUNK_SIZE,
+				   sizeof(pjsua_acc*));
+    pjsua_var.acc_ids = (pjsua_acc_id*)
+			pj_pool_calloc(pjsua_var.pool,
+				       pjsua_var.ua_cfg.max_acc,
+				       sizeof(pjsua_acc_id));
+    pjsua_var.acc_table_size = 0;
+
+    /* Create the lookup indexes */
+    for (i=0; i<PJSUA_ACC_INDEX_CNT; ++i) {
+	pjsua_var.acc_index[i] = pj_hash_create2(pjsua_var.pool,
+						 PJSUA_ACC_CHUNK_SIZE,
+						 PJ_HASH_OPEN_ADDRESSING);
+	if (!pjsua_var.acc_index[i])
+	    return PJ_ENOMEM;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/* Add more accounts to the account table. */
+static pj_status_t grow_acc_table(void)
+{
+    unsigned chunk_idx = pjsua_var.acc_table_size / PJSUA_ACC_CHUNK_SIZE;
+    unsigned i, cnt;
+    pjsua_acc *chunk;
+
+    cnt = pjsua_var.ua_cfg.max_acc - pjsua_var.acc_table_size;
+    if (cnt == 0)
+	return PJ_ETOOMANY;
+    if (cnt > PJSUA_ACC_CHUNK_SIZE)
+	cnt = PJSUA_ACC_CHUNK_SIZE;
+
+    chunk = (pjsua_acc*) pj_pool_calloc(pjsua_var.pool, cnt,
+					sizeof(pjsua_acc));
+    if (!chunk)
+	return PJ_ENOMEM;
+
+    for (i=0; i<cnt; ++i)
+	chunk[i].index = pjsua_var.acc_table_size + i;
+
+    pjsua_var.acc[chunk_idx] = chunk;
+    pjsua_var.acc_table_size += cnt;
+
+    return PJ_SUCCESS;
+}
+
+
+/* Get the buffer size needed for the key of an account lookup index. */
+static pj_size_t acc_index_key_size(const pj_str_t *user,
+				    const pj_str_t *domain)
+{
+    return user->slen + domain->slen + 24;
+}
+
+/* Print the key of an account lookup index to key->ptr, which must have
+ * room for acc_index_key_size() characters. Transport type -1 matches any
+ * transport.
+ */
+static void acc_index_print_key(pj_str_t *key, unsigned idx,
+				const pj_str_t *user, const pj_str_t *domain,
+				int port, int tp_type)
+{
+    pj_size_t len = acc_index_key_size(user, domain);
+
+    switch (idx) {
+    case PJSUA_ACC_INDEX_USER_DOMAIN:
+	key->slen = pj_ansi_snprintf(key->ptr, len, "%.*s@%.*s",
+				     (int)user->slen, user->ptr,
+				     (int)domain->slen, domain->ptr);
+	break;
+    case PJSUA_ACC_INDEX_DOMAIN:
+	pj_strcpy(key, domain);
+	break;
+    case PJSUA_ACC_INDEX_DOMAIN_PORT:
+	key->slen = pj_ansi_snprintf(key->ptr, len, "%.*s:%d",
+				     (int)domain->slen, domain->ptr, port);
+	break;
+    case PJSUA_ACC_INDEX_USER_TP:
+	key->slen = pj_ansi_snprintf(key->ptr, len, "%d:%.*s", tp_type,
+				     (int)user->slen, user->ptr);
+	break;
+    default:
+	pj_assert(!"Invalid account index");
+	key->slen = 0;
+	break;
+    }
+}
+
+/* Build the key of an account lookup index. The key is allocated from
+ * the pool.
+ */
+static void acc_index_key(pj_pool_t *pool, pj_str_t *key, unsigned idx,
+			  const pj_str_t *user, const pj_str_t *domain,
+			  int port, int tp_type)
+{
+    key->ptr = (char*) pj_pool_alloc(pool, acc_index_key_size(user, domain));
+    acc_index_print_key(key, idx, user, domain, port, tp_type);
+}
+
+/* Check if account a comes before account b in the account priority
+ * list (pjsua_var.acc_ids).
+ */
+static pj_bool_t acc_index_before(const pjsua_acc *a, const pjsua_acc *b)
+{
+    if (a->cfg.priority != b->cfg.priority)
+	return a->cfg.priority > b->cfg.priority;
+    return a->prio_seq < b->prio_seq;
+}
+
+/* Get the first account with the specified key in an index. */
+static pjsua_acc *acc_index_find(unsigned idx, const pj_str_t *key)
+{
+    return (pjsua_acc*) pj_hash_get_lower(pjsua_var.acc_index[idx],
+					  key->ptr, (unsigned)key->slen,
+					  NULL);
+}
+
+/* Add the account to the lookup indexes. The hash table keeps a pointer
+ * to the key of the first account in the chain, so whenever the first
+ * account changes the hash entry is recreated.
+ */
+static void acc_index_add(pjsua_acc *acc)
+{
+    int tp_type = -1;
+    unsigned i;
+
+    pj_assert(acc->valid && !acc->indexed);
+
+    if (acc->cfg.transport_id != PJSUA_INVALID_ID)
+	tp_type = pjsua_var.tpdata[acc->cfg.transport_id].type;
+
+    for (i=0; i<PJSUA_ACC_INDEX_CNT; ++i) {
+	pj_hash_table_t *ht = pjsua_var.acc_index[i];
+	pjsua_acc_index_entry *e = &acc->idx[i];
+	pjsua_acc *head;
+	pj_uint32_t hval = 0;
+	pj_size_t size;
+
+	/* The account is not in the index, so the previous key buffer is
+	 * not referenced by the hash table and can be reused.
+	 */
+	size = acc_index_key_size(&acc->user_part, &acc->srv_domain);
+	if (e->key_size < size) {
+	    e->key.ptr = (char*) pj_pool_alloc(acc->pool, size);
+	    e->key_size = size;
+	}
+	acc_index_print_key(&e->key, i, &acc->user_part, &acc->srv_domain,
+			    acc->srv_port, tp_type);
+
+	head = (pjsua_acc*) pj_hash_get_lower(ht, e->key.ptr,
+					      (unsigned)e->key.slen, &hval);
+	if (head == NULL || acc_index_before(acc, head)) {
+	    e->next = head;
+	    if (head) {
+		pj_hash_set_np_lower(ht, e->key.ptr, (unsigned)e->key.slen,
+				     hval, NULL, NULL);
+	    }
+	    pj_hash_set_np_lower(ht, e->key.ptr, (unsigned)e->key.slen,
+				 hval, NULL, acc);
+	} else {
+	    pjsua_acc *p = head;
+
+	    while (p->idx[i].next && !acc_index_before(acc, p->idx[i].next))
+		p = p->idx[i].next;
+	    e->next = p->idx[i].next;
+	    p->idx[i].next = acc;
+	}
+    }
+
+    acc->indexed = PJ_TRUE;
+}
+
+/* Remove the account from the lookup indexes. */
+static void acc_index_remove(pjsua_acc *acc)
+{
+    unsigned i;
+
+    if (!acc->indexed)
+	return;
+
+    for (i=0; i<PJSUA_ACC_INDEX_CNT; ++i) {
+	pj_hash_table_t *ht = pjsua_var.acc_index[i];
+	pjsua_acc_index_entry *e = &acc->idx[i];
+	pjsua_acc *head;
+	pj_uint32_t hval = 0;
+
+	head = (pjsua_acc*) pj_hash_get_lower(ht, e->key.ptr,
+					      (unsigned)e->key.slen, &hval);
+	if (head == acc) {
+	    pj_hash_set_np_lower(ht, e->key.ptr, (unsigned)e->key.slen,
+				 hval, NULL, NULL);
+	    if (e->next) {
+		pjsua_acc_index_entry *ne = &e->next->idx[i];
+		pj_hash_set_np_lower(ht, ne->key.ptr, (unsigned)ne->key.slen,
+				     hval, NULL, e->next);
+	    }
+	} else {
+	    pjsua_acc *p = head;
+
+	    while (p && p->idx[i].next != acc)
+		p = p->idx[i].next;
+	    pj_assert(p != NULL);
+	    if (p)
+		p->idx[i].next = e->next;
+	}
+	e->next = NULL;
+    }
+
+    acc->indexed = PJ_FALSE;
+}
+
+/* Insert the account into the account priority list. */
+static void acc_ids_insert(pjsua_acc_id acc_id)
+{
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
+    unsigned i;
+
+    for (i=0; i<pjsua_var.acc_cnt; ++i) {
+	if (PJSUA_ACC(pjsua_var.acc_ids[i])->cfg.priority <
+	    acc->cfg.priority)
+	{
+	    break;
+	}
+    }
+    pj_array_insert(pjsua_var.acc_ids, sizeof(pjsua_var.acc_ids[0]),
+		    pjsua_var.acc_cnt, i, &acc_id);
+
+    /* Accounts with the same priority are ordered by insertion */
+    acc->prio_seq = ++pjsua_var.acc_prio_seq;
+}
+
 /*
  * Initialize a new account (after configuration is set).
  */
 static pj_status_t initialize_acc(unsigned acc_id)
 {
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[acc_id].cfg;
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(acc_id)->cfg;
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
     pjsip_name_addr *name_addr;
     pjsip_sip_uri *sip_reg_uri;
     pj_status_t status;
@@ -368,18 +622,13 @@ static pj_status_t initialize_acc(unsigned acc_id)
     }
 
     /* Mark account as valid */
-    pjsua_var.acc[acc_id].valid = PJ_TRUE;
+    PJSUA_ACC(acc_id)->valid = PJ_TRUE;
 
     /* Insert account ID into account ID array, sorted by priority */
-    for (i=0; i<pjsua_var.acc_cnt; ++i) {
-	if ( pjsua_var.acc[pjsua_var.acc_ids[i]].cfg.priority <
-	     pjsua_var.acc[acc_id].cfg.priority)
-	{
-	    break;
-	}
-    }
-    pj_array_insert(pjsua_var.acc_ids, sizeof(pjsua_var.acc_ids[0]),
-		    pjsua_var.acc_cnt, i, &acc_id);
+    acc_ids_insert(acc_id);
+
+    /* Add to the lookup indexes */
+    acc_index_add(acc);
 
     return PJ_SUCCESS;
 }
@@ -397,7 +646,7 @@ PJ_DEF(pj_status_t) pjsua_acc_add( const pjsua_acc_config *cfg,
     pj_status_t status = PJ_SUCCESS;
 
     PJ_ASSERT_RETURN(cfg, PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc_cnt < PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(pjsua_var.acc_cnt < pjsua_var.ua_cfg.max_acc,
 		     PJ_ETOOMANY);
 
     /* Must have a transport */
@@ -410,16 +659,23 @@ PJ_DEF(pj_status_t) pjsua_acc_add( const pjsua_acc_config *cfg,
     PJSUA_LOCK();
 
     /* Find empty account id. */
-    for (id=0; id < PJ_ARRAY_SIZE(pjsua_var.acc); ++id) {
-	if (pjsua_var.acc[id].valid == PJ_FALSE)
+    for (id=0; id < pjsua_var.acc_table_size; ++id) {
+	if (PJSUA_ACC(id)->valid == PJ_FALSE)
 	    break;
     }
 
-    /* Expect to find a slot */
-    PJ_ASSERT_ON_FAIL(	id < PJ_ARRAY_SIZE(pjsua_var.acc), 
-			{PJSUA_UNLOCK(); return PJ_EBUG;});
+    /* Grow the account table if it's full */
+    if (id == pjsua_var.acc_table_size) {
+	status = grow_acc_table();
+	if (status != PJ_SUCCESS) {
+	    pjsua_perror(THIS_FILE, "Error adding account", status);
+	    PJSUA_UNLOCK();
+	    pj_log_pop_indent();
+	    return status;
+	}
+    }
 
-    acc = &pjsua_var.acc[id];
+    acc = PJSUA_ACC(id);
 
     /* Create pool for this account. */
     if (acc->pool)
@@ -427,16 +683,19 @@ PJ_DEF(pj_status_t) pjsua_acc_add( const pjsua_acc_config *cfg,
     else
 	acc->pool = pjsua_pool_create("acc%p", 512, 256);
 
+    /* The index key buffers of the previous account were in the pool */
+    pj_bzero(acc->idx, sizeof(acc->idx));
+
     /* Copy config */
-    pjsua_acc_config_dup(acc->pool, &pjsua_var.acc[id].cfg, cfg);
+    pjsua_acc_config_dup(acc->pool, &PJSUA_ACC(id)->cfg, cfg);
     
     /* Normalize registration timeout and refresh delay */
-    if (pjsua_var.acc[id].cfg.reg_uri.slen) {
-        if (pjsua_var.acc[id].cfg.reg_timeout == 0) {
-            pjsua_var.acc[id].cfg.reg_timeout = PJSUA_REG_INTERVAL;
+    if (PJSUA_ACC(id)->cfg.reg_uri.slen) {
+        if (PJSUA_ACC(id)->cfg.reg_timeout == 0) {
+            PJSUA_ACC(id)->cfg.reg_timeout = PJSUA_REG_INTERVAL;
         }
-        if (pjsua_var.acc[id].cfg.reg_delay_before_refresh == 0) {
-            pjsua_var.acc[id].cfg.reg_delay_before_refresh =
+        if (PJSUA_ACC(id)->cfg.reg_delay_before_refresh == 0) {
+            PJSUA_ACC(id)->cfg.reg_delay_before_refresh =
                 PJSIP_REGISTER_CLIENT_DELAY_BEFORE_REFRESH;
         }
     }
@@ -482,12 +741,12 @@ PJ_DEF(pj_status_t) pjsua_acc_add( const pjsua_acc_config *cfg,
 	      (int)cfg->id.slen, cfg->id.ptr, id));
 
     /* If accounts has registration enabled, start registration */
-    if (pjsua_var.acc[id].cfg.reg_uri.slen) {
-	if (pjsua_var.acc[id].cfg.register_on_acc_add)
+    if (PJSUA_ACC(id)->cfg.reg_uri.slen) {
+	if (PJSUA_ACC(id)->cfg.register_on_acc_add)
             pjsua_acc_set_registration(id, PJ_TRUE);
     } else {
 	/* Otherwise subscribe to MWI, if it's enabled */
-	if (pjsua_var.acc[id].cfg.mwi_enabled)
+	if (PJSUA_ACC(id)->cfg.mwi_enabled)
 	    pjsua_start_mwi(id, PJ_TRUE);
 
 	/* Start publish too */
@@ -564,13 +823,13 @@ PJ_DEF(pj_status_t) pjsua_acc_add_local( pjsua_transport_id tid,
 PJ_DEF(pj_status_t) pjsua_acc_set_user_data(pjsua_acc_id acc_id,
 					    void *user_data)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id),
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id)->valid, PJ_EINVALIDOP);
 
     PJSUA_LOCK();
 
-    pjsua_var.acc[acc_id].cfg.user_data = user_data;
+    PJSUA_ACC(acc_id)->cfg.user_data = user_data;
 
     PJSUA_UNLOCK();
 
@@ -583,11 +842,11 @@ PJ_DEF(pj_status_t) pjsua_acc_set_user_data(pjsua_acc_id acc_id,
  */
 PJ_DEF(void*) pjsua_acc_get_user_data(pjsua_acc_id acc_id)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id),
 		     NULL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, NULL);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id)->valid, NULL);
 
-    return pjsua_var.acc[acc_id].cfg.user_data;
+    return PJSUA_ACC(acc_id)->cfg.user_data;
 }
 
 
@@ -599,16 +858,16 @@ PJ_DEF(pj_status_t) pjsua_acc_del(pjsua_acc_id acc_id)
     pjsua_acc *acc;
     unsigned i;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id),
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id)->valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Deleting account %d..", acc_id));
     pj_log_push_indent();
 
     PJSUA_LOCK();
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     /* Cancel keep-alive timer, if any */
     if (acc->ka_timer.id) {
@@ -644,6 +903,9 @@ PJ_DEF(pj_status_t) pjsua_acc_del(pjsua_acc_id acc_id)
     /* Delete server presence subscription */
     pjsua_pres_delete_acc(acc_id, 0);
 
+    /* Remove from the lookup indexes, the keys are in the account pool */
+    acc_index_remove(acc);
+
     /* Release account pool */
     if (acc->pool) {
 	pj_pool_release(acc->pool);
@@ -692,11 +954,11 @@ PJ_DEF(pj_status_t) pjsua_acc_get_config(pjsua_acc_id acc_id,
                                          pj_pool_t *pool,
                                          pjsua_acc_config *acc_cfg)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc)
-                     && pjsua_var.acc[acc_id].valid, PJ_EINVAL);
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id)
+                     && PJSUA_ACC(acc_id)->valid, PJ_EINVAL);
     //this now would not work due to corrupt header list
-    //pj_memcpy(acc_cfg, &pjsua_var.acc[acc_id].cfg, sizeof(*acc_cfg));
-    pjsua_acc_config_dup(pool, acc_cfg, &pjsua_var.acc[acc_id].cfg);
+    //pj_memcpy(acc_cfg, &PJSUA_ACC(acc_id)->cfg, sizeof(*acc_cfg));
+    pjsua_acc_config_dup(pool, acc_cfg, &PJSUA_ACC(acc_id)->cfg);
     return PJ_SUCCESS;
 }
 
@@ -782,7 +1044,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
     pj_bool_t update_mwi = PJ_FALSE;
     pj_status_t status = PJ_SUCCESS;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id),
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Modifying account %d", acc_id));
@@ -790,7 +1052,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 
     PJSUA_LOCK();
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
     if (!acc->valid) {
 	status = PJ_EINVAL;
 	goto on_return;
@@ -908,6 +1170,11 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 
     /* == Apply the new config == */
 
+    /* The account is added back to the lookup indexes after the new
+     * config is applied.
+     */
+    acc_index_remove(acc);
+
     /* Account ID. */
     if (id_name_addr && id_sip_uri) {
 	pj_strdup_with_null(acc->pool, &acc->cfg.id, &cfg->id);
@@ -937,15 +1204,9 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 	pj_assert(i < pjsua_var.acc_cnt);
 	pj_array_erase(pjsua_var.acc_ids, sizeof(acc_id),
 		       pjsua_var.acc_cnt, i);
-	for (i=0; i<pjsua_var.acc_cnt; ++i) {
-	    if (pjsua_var.acc[pjsua_var.acc_ids[i]].cfg.priority <
-		acc->cfg.priority)
-	    {
-		break;
-	    }
-	}
-	pj_array_insert(pjsua_var.acc_ids, sizeof(acc_id),
-			pjsua_var.acc_cnt, i, &acc_id);
+	--pjsua_var.acc_cnt;
+	acc_ids_insert(acc_id);
+	++pjsua_var.acc_cnt;
     }
 
     /* MWI */
@@ -1335,6 +1596,9 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
     /* Call hold type */
     acc->cfg.call_hold_type = cfg->call_hold_type;
 
+    /* Add back to the lookup indexes */
+    acc_index_add(acc);
+
     /* Unregister first */
     if (unreg_first) {
 	status = pjsua_acc_set_registration(acc->index, PJ_FALSE);
@@ -1394,16 +1658,16 @@ on_return:
 PJ_DEF(pj_status_t) pjsua_acc_set_online_status( pjsua_acc_id acc_id,
 						 pj_bool_t is_online)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id),
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id)->valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Acc %d: setting online status to %d..",
 	      acc_id, is_online));
     pj_log_push_indent();
 
-    pjsua_var.acc[acc_id].online_status = is_online;
-    pj_bzero(&pjsua_var.acc[acc_id].rpid, sizeof(pjrpid_element));
+    PJSUA_ACC(acc_id)->online_status = is_online;
+    pj_bzero(&PJSUA_ACC(acc_id)->rpid, sizeof(pjrpid_element));
     pjsua_pres_update_acc(acc_id, PJ_FALSE);
 
     pj_log_pop_indent();
@@ -1418,17 +1682,17 @@ PJ_DEF(pj_status_t) pjsua_acc_set_online_status2( pjsua_acc_id acc_id,
 						  pj_bool_t is_online,
 						  const pjrpid_element *pr)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id),
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id)->valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Acc %d: setting online status to %d..",
     	      acc_id, is_online));
     pj_log_push_indent();
 
     PJSUA_LOCK();
-    pjsua_var.acc[acc_id].online_status = is_online;
-    pjrpid_element_dup(pjsua_var.acc[acc_id].pool, &pjsua_var.acc[acc_id].rpid, pr);
+    PJSUA_ACC(acc_id)->online_status = is_online;
+    pjrpid_element_dup(PJSUA_ACC(acc_id)->pool, &PJSUA_ACC(acc_id)->rpid, pr);
     PJSUA_UNLOCK();
 
     pjsua_pres_update_acc(acc_id, PJ_TRUE);
@@ -2202,7 +2466,7 @@ static void regc_cb(struct pjsip_regc_cbparam *param)
 	    update_keep_alive(acc, PJ_FALSE, NULL);
 
 	    PJ_LOG(3,(THIS_FILE, "%s: unregistration success",
-		      pjsua_var.acc[acc->index].cfg.id.ptr));
+		      PJSUA_ACC(acc->index)->cfg.id.ptr));
 	} else {
 	    /* Check and update SIP outbound status first, since the result
 	     * will determine if we should update re-registration
@@ -2228,7 +2492,7 @@ static void regc_cb(struct pjsip_regc_cbparam *param)
 	    PJ_LOG(3, (THIS_FILE, 
 		       "%s: registration success, status=%d (%.*s), "
 		       "will re-register in %d seconds", 
-		       pjsua_var.acc[acc->index].cfg.id.ptr,
+		       PJSUA_ACC(acc->index)->cfg.id.ptr,
 		       param->code,
 		       (int)param->reason.slen, param->reason.ptr,
 		       param->expiration));
@@ -2303,7 +2567,7 @@ static pj_status_t pjsua_regc_init(int acc_id)
     pj_status_t status;
 
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     if (acc->cfg.reg_uri.slen == 0) {
 	PJ_LOG(3,(THIS_FILE, "Registrar URI is not specified"));
@@ -2376,10 +2640,10 @@ static pj_status_t pjsua_regc_init(int acc_id)
     /* If account is locked to specific transport, then set transport to
      * the client registration.
      */
-    if (pjsua_var.acc[acc_id].cfg.transport_id != PJSUA_INVALID_ID) {
+    if (PJSUA_ACC(acc_id)->cfg.transport_id != PJSUA_INVALID_ID) {
 	pjsip_tpselector tp_sel;
 
-	pjsua_init_tpselector(pjsua_var.acc[acc_id].cfg.transport_id, &tp_sel);
+	pjsua_init_tpselector(PJSUA_ACC(acc_id)->cfg.transport_id, &tp_sel);
 	pjsip_regc_set_transport(acc->regc, &tp_sel);
     }
 
@@ -2474,7 +2738,7 @@ static pj_status_t pjsua_regc_init(int acc_id)
 
 pj_bool_t pjsua_sip_acc_is_using_stun(pjsua_acc_id acc_id)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
 
     return acc->cfg.sip_stun_use != PJSUA_STUN_USE_DISABLED &&
 	    pjsua_var.ua_cfg.stun_srv_cnt != 0;
@@ -2490,9 +2754,9 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
     pj_status_t status = 0;
     pjsip_tx_data *tdata = 0;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id),
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id)->valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Acc %d: setting %sregistration..",
 	      acc_id, (renew? "" : "un")));
@@ -2500,19 +2764,19 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
 
     PJSUA_LOCK();
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     /* Cancel any re-registration timer */
-    if (pjsua_var.acc[acc_id].auto_rereg.timer.id) {
-	pjsua_var.acc[acc_id].auto_rereg.timer.id = PJ_FALSE;
-	pjsua_cancel_timer(&pjsua_var.acc[acc_id].auto_rereg.timer);
+    if (PJSUA_ACC(acc_id)->auto_rereg.timer.id) {
+	PJSUA_ACC(acc_id)->auto_rereg.timer.id = PJ_FALSE;
+	pjsua_cancel_timer(&PJSUA_ACC(acc_id)->auto_rereg.timer);
     }
 
     /* Reset pointer to registration transport */
-    pjsua_var.acc[acc_id].auto_rereg.reg_tp = NULL;
+    PJSUA_ACC(acc_id)->auto_rereg.reg_tp = NULL;
 
     if (renew) {
-	if (pjsua_var.acc[acc_id].regc == NULL) {
+	if (PJSUA_ACC(acc_id)->regc == NULL) {
 	    status = pjsua_regc_init(acc_id);
 	    if (status != PJ_SUCCESS) {
 		pjsua_perror(THIS_FILE, "Unable to create registration", 
@@ -2520,16 +2784,16 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
 		goto on_return;
 	    }
 	}
-	if (!pjsua_var.acc[acc_id].regc) {
+	if (!PJSUA_ACC(acc_id)->regc) {
 	    status = PJ_EINVALIDOP;
 	    goto on_return;
 	}
 
-	status = pjsip_regc_register(pjsua_var.acc[acc_id].regc, 1, 
+	status = pjsip_regc_register(PJSUA_ACC(acc_id)->regc, 1, 
 				     &tdata);
 
-	if (0 && status == PJ_SUCCESS && pjsua_var.acc[acc_id].cred_cnt) {
-	    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+	if (0 && status == PJ_SUCCESS && PJSUA_ACC(acc_id)->cred_cnt) {
+	    pjsua_acc *acc = PJSUA_ACC(acc_id);
 	    pjsip_authorization_hdr *h;
 	    char *uri;
 	    int d;
@@ -2550,24 +2814,24 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
 	}
 
     } else {
-	if (pjsua_var.acc[acc_id].regc == NULL) {
+	if (PJSUA_ACC(acc_id)->regc == NULL) {
 	    PJ_LOG(3,(THIS_FILE, "Currently not registered"));
 	    status = PJ_EINVALIDOP;
 	    goto on_return;
 	}
 
-	pjsua_pres_unpublish(&pjsua_var.acc[acc_id], 0);
+	pjsua_pres_unpublish(PJSUA_ACC(acc_id), 0);
 
-	status = pjsip_regc_unregister(pjsua_var.acc[acc_id].regc, &tdata);
+	status = pjsip_regc_unregister(PJSUA_ACC(acc_id)->regc, &tdata);
     }
 
     if (status == PJ_SUCCESS) {
-        if (pjsua_var.acc[acc_id].cfg.allow_via_rewrite &&
-            pjsua_var.acc[acc_id].via_addr.host.slen > 0)
+        if (PJSUA_ACC(acc_id)->cfg.allow_via_rewrite &&
+            PJSUA_ACC(acc_id)->via_addr.host.slen > 0)
         {
-            pjsip_regc_set_via_sent_by(pjsua_var.acc[acc_id].regc,
-                                       &pjsua_var.acc[acc_id].via_addr,
-                                       pjsua_var.acc[acc_id].via_tp);
+            pjsip_regc_set_via_sent_by(PJSUA_ACC(acc_id)->regc,
+                                       &PJSUA_ACC(acc_id)->via_addr,
+                                       PJSUA_ACC(acc_id)->via_tp);
         } else if (!pjsua_sip_acc_is_using_stun(acc_id)) {
             /* Choose local interface to use in Via if acc is not using
              * STUN
@@ -2580,15 +2844,15 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
         }
 
 	//pjsua_process_msg_data(tdata, NULL);
-	status = pjsip_regc_send( pjsua_var.acc[acc_id].regc, tdata );
+	status = pjsip_regc_send( PJSUA_ACC(acc_id)->regc, tdata );
     }
 
     /* Update pointer to registration transport */
     if (status == PJ_SUCCESS) {
 	pjsip_regc_info reg_info;
 
-	pjsip_regc_get_info(pjsua_var.acc[acc_id].regc, &reg_info);
-	pjsua_var.acc[acc_id].auto_rereg.reg_tp = reg_info.transport;
+	pjsip_regc_get_info(PJSUA_ACC(acc_id)->regc, &reg_info);
+	PJSUA_ACC(acc_id)->auto_rereg.reg_tp = reg_info.transport;
         
         if (pjsua_var.ua_cfg.cb.on_reg_started) {
             (*pjsua_var.ua_cfg.cb.on_reg_started)(acc_id, renew);
@@ -2597,7 +2861,7 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
 	    pjsua_reg_info rinfo;
 
 	    rinfo.cbparam = NULL;
-	    rinfo.regc = pjsua_var.acc[acc_id].regc;
+	    rinfo.regc = PJSUA_ACC(acc_id)->regc;
 	    rinfo.renew = renew;
             (*pjsua_var.ua_cfg.cb.on_reg_started2)(acc_id, &rinfo);
         }
@@ -2624,21 +2888,21 @@ on_return:
 PJ_DEF(pj_status_t) pjsua_acc_get_info( pjsua_acc_id acc_id,
 					pjsua_acc_info *info)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[acc_id].cfg;
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(acc_id)->cfg;
 
     PJ_ASSERT_RETURN(info != NULL, PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
     
     pj_bzero(info, sizeof(pjsua_acc_info));
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc), 
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id), 
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id)->valid, PJ_EINVALIDOP);
 
     PJSUA_LOCK();
     
-    if (pjsua_var.acc[acc_id].valid == PJ_FALSE) {
+    if (PJSUA_ACC(acc_id)->valid == PJ_FALSE) {
 	PJSUA_UNLOCK();
 	return PJ_EINVALIDOP;
     }
@@ -2701,8 +2965,8 @@ PJ_DEF(pj_status_t) pjsua_enum_accs(pjsua_acc_id ids[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	if (!pjsua_var.acc[i].valid)
+    for (i=0, c=0; c<*count && i<pjsua_var.acc_table_size; ++i) {
+	if (!PJSUA_ACC(i)->valid)
 	    continue;
 	ids[c] = i;
 	++c;
@@ -2728,8 +2992,8 @@ PJ_DEF(pj_status_t) pjsua_acc_enum_info( pjsua_acc_info info[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	if (!pjsua_var.acc[i].valid)
+    for (i=0, c=0; c<*count && i<pjsua_var.acc_table_size; ++i) {
+	if (!PJSUA_ACC(i)->valid)
 	    continue;
 
 	pjsua_acc_get_info(i, &info[c]);
@@ -2750,10 +3014,11 @@ PJ_DEF(pj_status_t) pjsua_acc_enum_info( pjsua_acc_info info[],
  */
 PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_outgoing(const pj_str_t *url)
 {
-    pj_str_t tmp;
+    pj_str_t tmp, key;
     pjsip_uri *uri;
     pjsip_sip_uri *sip_uri;
     pj_pool_t *tmp_pool;
+    pjsua_acc *acc;
     unsigned i;
 
     PJSUA_LOCK();
@@ -2773,14 +3038,14 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_outgoing(const pj_str_t *url)
 	!PJSIP_URI_SCHEME_IS_SIPS(uri)) 
     {
 	/* Return the first account with proxy */
-	for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<pjsua_var.acc_table_size; ++i) {
+	    if (!PJSUA_ACC(i)->valid)
 		continue;
-	    if (!pj_list_empty(&pjsua_var.acc[i].route_set))
+	    if (!pj_list_empty(&PJSUA_ACC(i)->route_set))
 		break;
 	}
 
-	if (i != PJ_ARRAY_SIZE(pjsua_var.acc)) {
+	if (i != pjsua_var.acc_table_size) {
 	    /* Found rather matching account */
 	    pj_pool_release(tmp_pool);
 	    PJSUA_UNLOCK();
@@ -2796,26 +3061,18 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_outgoing(const pj_str_t *url)
     sip_uri = (pjsip_sip_uri*) pjsip_uri_get_uri(uri);
 
     /* Find matching domain AND port */
-    for (i=0; i<pjsua_var.acc_cnt; ++i) {
-	unsigned acc_id = pjsua_var.acc_ids[i];
-	if (pj_stricmp(&pjsua_var.acc[acc_id].srv_domain, &sip_uri->host)==0 &&
-	    pjsua_var.acc[acc_id].srv_port == sip_uri->port)
-	{
-	    pj_pool_release(tmp_pool);
-	    PJSUA_UNLOCK();
-	    return acc_id;
-	}
-    }
+    acc_index_key(tmp_pool, &key, PJSUA_ACC_INDEX_DOMAIN_PORT,
+		  &sip_uri->user, &sip_uri->host, sip_uri->port, -1);
+    acc = acc_index_find(PJSUA_ACC_INDEX_DOMAIN_PORT, &key);
 
     /* If no match, try to match the domain part only */
-    for (i=0; i<pjsua_var.acc_cnt; ++i) {
-	unsigned acc_id = pjsua_var.acc_ids[i];
-	if (pj_stricmp(&pjsua_var.acc[acc_id].srv_domain, &sip_uri->host)==0)
-	{
-	    pj_pool_release(tmp_pool);
-	    PJSUA_UNLOCK();
-	    return acc_id;
-	}
+    if (!acc)
+	acc = acc_index_find(PJSUA_ACC_INDEX_DOMAIN, &sip_uri->host);
+
+    if (acc) {
+	pj_pool_release(tmp_pool);
+	PJSUA_UNLOCK();
+	return acc->index;
     }
 
 
@@ -2834,8 +3091,10 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_incoming(pjsip_rx_data *rdata)
 {
     pjsip_uri *uri;
     pjsip_sip_uri *sip_uri;
+    pjsip_transport_type_e type;
+    pjsua_acc *acc, *any_acc;
+    pj_str_t key;
     pjsua_acc_id id = PJSUA_INVALID_ID;
-    unsigned i;
 
     /* Check that there's at least one account configured */
     PJ_ASSERT_RETURN(pjsua_var.acc_cnt!=0, pjsua_var.default_acc);
@@ -2864,52 +3123,49 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_incoming(pjsip_rx_data *rdata)
     sip_uri = (pjsip_sip_uri*)pjsip_uri_get_uri(uri);
 
     /* Find account which has matching username and domain. */
-    for (i=0; i < pjsua_var.acc_cnt; ++i) {
-	unsigned acc_id = pjsua_var.acc_ids[i];
-	pjsua_acc *acc = &pjsua_var.acc[acc_id];
-
-	if (acc->valid && pj_stricmp(&acc->user_part, &sip_uri->user)==0 &&
-	    pj_stricmp(&acc->srv_domain, &sip_uri->host)==0) 
-	{
-	    /* Match ! */
-	    id = acc_id;
-	    goto on_return;
-	}
+    acc_index_key(rdata->tp_info.pool, &key, PJSUA_ACC_INDEX_USER_DOMAIN,
+		  &sip_uri->user, &sip_uri->host, 0, -1);
+    acc = acc_index_find(PJSUA_ACC_INDEX_USER_DOMAIN, &key);
+    if (acc) {
+	/* Match ! */
+	id = acc->index;
+	goto on_return;
     }
 
     /* No matching account, try match domain part only. */
-    for (i=0; i < pjsua_var.acc_cnt; ++i) {
-	unsigned acc_id = pjsua_var.acc_ids[i];
-	pjsua_acc *acc = &pjsua_var.acc[acc_id];
-
-	if (acc->valid && pj_stricmp(&acc->srv_domain, &sip_uri->host)==0) {
-	    /* Match ! */
-	    id = acc_id;
-	    goto on_return;
-	}
+    acc = acc_index_find(PJSUA_ACC_INDEX_DOMAIN, &sip_uri->host);
+    if (acc) {
+	/* Match ! */
+	id = acc->index;
+	goto on_return;
     }
 
-    /* No matching account, try match user part (and transport type) only. */
-    for (i=0; i < pjsua_var.acc_cnt; ++i) {
-	unsigned acc_id = pjsua_var.acc_ids[i];
-	pjsua_acc *acc = &pjsua_var.acc[acc_id];
-
-	if (acc->valid && pj_stricmp(&acc->user_part, &sip_uri->user)==0) {
-
-	    if (acc->cfg.transport_id != PJSUA_INVALID_ID) {
-		pjsip_transport_type_e type;
-		type = pjsip_transport_get_type_from_name(&sip_uri->transport_param);
-		if (type == PJSIP_TRANSPORT_UNSPECIFIED)
-		    type = PJSIP_TRANSPORT_UDP;
-
-		if (pjsua_var.tpdata[acc->cfg.transport_id].type != type)
-		    continue;
-	    }
-
-	    /* Match ! */
-	    id = acc_id;
-	    goto on_return;
-	}
+    /* No matching account, try match user part (and transport type) only.
+     * Accounts bound to a transport are indexed with the transport type,
+     * the others match any transport type.
+     */
+    type = pjsip_transport_get_type_from_name(&sip_uri->transport_param);
+    if (type == PJSIP_TRANSPORT_UNSPECIFIED)
+	type = PJSIP_TRANSPORT_UDP;
+
+    acc_index_key(rdata->tp_info.pool, &key, PJSUA_ACC_INDEX_USER_TP,
+		  &sip_uri->user, &sip_uri->host, 0, type);
+    acc = acc_index_find(PJSUA_ACC_INDEX_USER_TP, &key);
+
+    /* Skip accounts whose transport has been closed since indexed */
+    while (acc && pjsua_var.tpdata[acc->cfg.transport_id].type != type)
+	acc = acc->idx[PJSUA_ACC_INDEX_USER_TP].next;
+
+    acc_index_key(rdata->tp_info.pool, &key, PJSUA_ACC_INDEX_USER_TP,
+		  &sip_uri->user, &sip_uri->host, 0, -1);
+    any_acc = acc_index_find(PJSUA_ACC_INDEX_USER_TP, &key);
+    if (any_acc && (!acc || acc_index_before(any_acc, acc)))
+	acc = any_acc;
+
+    if (acc) {
+	/* Match ! */
+	id = acc->index;
+	goto on_return;
     }
 
 on_return:
@@ -2947,7 +3203,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_request(pjsua_acc_id acc_id,
     PJ_ASSERT_RETURN(method && target && p_tdata, PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     status = pjsip_endpt_create_request(pjsua_var.endpt, method, target, 
 					&acc->cfg.id, target,
@@ -2968,7 +3224,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_request(pjsua_acc_id acc_id,
     /* If account is locked to specific transport, then set that transport to
      * the transmit data.
      */
-    if (pjsua_var.acc[acc_id].cfg.transport_id != PJSUA_INVALID_ID) {
+    if (PJSUA_ACC(acc_id)->cfg.transport_id != PJSUA_INVALID_ID) {
 	pjsip_tpselector tp_sel;
 
 	pjsua_init_tpselector(acc->cfg.transport_id, &tp_sel);
@@ -2976,11 +3232,11 @@ PJ_DEF(pj_status_t) pjsua_acc_create_request(pjsua_acc_id acc_id,
     }
 
     /* If via_addr is set, use this address for the Via header. */
-    if (pjsua_var.acc[acc_id].cfg.allow_via_rewrite &&
-        pjsua_var.acc[acc_id].via_addr.host.slen > 0)
+    if (PJSUA_ACC(acc_id)->cfg.allow_via_rewrite &&
+        PJSUA_ACC(acc_id)->via_addr.host.slen > 0)
     {
-        tdata->via_addr = pjsua_var.acc[acc_id].via_addr;
-        tdata->via_tp = pjsua_var.acc[acc_id].via_tp;
+        tdata->via_addr = PJSUA_ACC(acc_id)->via_addr;
+        tdata->via_tp = PJSUA_ACC(acc_id)->via_tp;
     } else if (!pjsua_sip_acc_is_using_stun(acc_id)) {
         /* Choose local interface to use in Via if acc is not using
          * STUN
@@ -3040,7 +3296,7 @@ pj_status_t pjsua_acc_get_uac_addr(pjsua_acc_id acc_id,
     pjsip_tpmgr_fla2_param tfla2_prm;
 
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     /* If route-set is configured for the account, then URI is the
      * first entry of the route-set.
@@ -3234,7 +3490,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_uac_contact( pj_pool_t *pool,
 
     
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     /* If force_contact is configured, then use use it */
     if (acc->cfg.force_contact.slen) {
@@ -3323,7 +3579,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_uas_contact( pj_pool_t *pool,
     char transport_param[32];
     
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     /* If force_contact is configured, then use use it */
     if (acc->cfg.force_contact.slen) {
@@ -3400,7 +3656,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_uas_contact( pj_pool_t *pool,
     secure = (flag & PJSIP_TRANSPORT_SECURE) != 0;
 
     /* Init transport selector. */
-    pjsua_init_tpselector(pjsua_var.acc[acc_id].cfg.transport_id, &tp_sel);
+    pjsua_init_tpselector(PJSUA_ACC(acc_id)->cfg.transport_id, &tp_sel);
 
     /* Get local address suitable to send request from */
     pjsip_tpmgr_fla2_param_default(&tfla2_prm);
@@ -3472,12 +3728,19 @@ PJ_DEF(pj_status_t) pjsua_acc_set_transport( pjsua_acc_id acc_id,
     pjsua_acc *acc;
 
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     PJ_ASSERT_RETURN(tp_id >= 0 && tp_id < (int)PJ_ARRAY_SIZE(pjsua_var.tpdata),
 		     PJ_EINVAL);
     
+    PJSUA_LOCK();
+
+    /* Transport type is part of the lookup index key */
+    acc_index_remove(acc);
     acc->cfg.transport_id = tp_id;
+    acc_index_add(acc);
+
+    PJSUA_UNLOCK();
 
     return PJ_SUCCESS;
 }
@@ -3538,8 +3801,8 @@ static void schedule_reregistration(pjsua_acc *acc)
     {
 	unsigned i, cnt;
 
-	for (i = 0, cnt = 0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-	    if (pjsua_var.calls[i].acc_id == acc->index) {
+	for (i = 0, cnt = 0; i < pjsua_var.call_table_size; ++i) {
+	    if (PJSUA_CALL(i)->acc_id == acc->index) {
 		pjsua_call_hangup(i, 0, NULL, NULL);
 		++cnt;
 	    }
@@ -3621,8 +3884,8 @@ void pjsua_acc_on_tp_state_changed(pjsip_transport *tp,
     /* Enumerate accounts using this transport and perform actions
      * based on the transport state.
      */
-    for (i = 0; i < PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	pjsua_acc *acc = &pjsua_var.acc[i];
+    for (i = 0; i < pjsua_var.acc_table_size; ++i) {
+	pjsua_acc *acc = PJSUA_ACC(i);
 
 	/* Skip if this account is not valid OR auto re-registration
 	 * feature is disabled OR this transport is not used by this account.
@@ -3636,8 +3899,8 @@ void pjsua_acc_on_tp_state_changed(pjsip_transport *tp,
 	/* Release regc transport immediately
 	 * See https://trac.pjsip.org/repos/ticket/1481
 	 */
-	if (pjsua_var.acc[i].regc) {
-	    pjsip_regc_release_transport(pjsua_var.acc[i].regc);
+	if (PJSUA_ACC(i)->regc) {
+	    pjsip_regc_release_transport(PJSUA_ACC(i)->regc);
 	}
 
 	/* Schedule reregistration for this account */
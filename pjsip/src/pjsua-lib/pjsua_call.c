@@ -127,11 +127,15 @@ static pj_status_t process_pending_reinvite(pjsua_call *call);
  */
 static void reset_call(pjsua_call_id id)
 {
-    pjsua_call *call = &pjsua_var.calls[id];
+    pjsua_call *call = PJSUA_CALL(id);
+    pj_bool_t in_use = call->in_use;
+    pjsua_call_id next_free = call->next_free;
     unsigned i;
 
     pj_bzero(call, sizeof(*call));
     call->index = id;
+    call->in_use = in_use;
+    call->next_free = next_free;
     call->last_text.ptr = call->last_text_buf_;
     for (i=0; i<PJ_ARRAY_SIZE(call->media); ++i) {
 	pjsua_call_media *call_med = &call->media[i];
@@ -159,18 +163,26 @@ pj_status_t pjsua_call_subsys_init(const pjsua_config *cfg)
     const pj_str_t str_norefersub = { "norefersub", 10 };
     pj_status_t status;
 
-    /* Init calls array. */
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.calls); ++i)
-	reset_call(i);
-
     /* Copy config */
     pjsua_config_dup(pjsua_var.pool, &pjsua_var.ua_cfg, cfg);
 
     /* Verify settings */
-    if (pjsua_var.ua_cfg.max_calls >= PJSUA_MAX_CALLS) {
-	pjsua_var.ua_cfg.max_calls = PJSUA_MAX_CALLS;
+    if (pjsua_var.ua_cfg.max_calls == 0) {
+	pjsua_var.ua_cfg.max_calls = 1;
     }
 
+    /* Init call table. Only the chunk pointers are allocated here, the
+     * calls themselves are allocated when needed.
+     */
+    pjsua_var.calls = (pjsua_call**)
+		      pj_pool_calloc(pjsua_var.pool,
+				     (pjsua_var.ua_cfg.max_calls +
+				      PJSUA_CALL_CHUNK_SIZE - 1) /
+				     PJSUA_CALL_CHUNK_SIZE,
+				     sizeof(pjsua_call*));
+    pjsua_var.call_table_size = 0;
+    pjsua_var.call_free_head = pjsua_var.call_free_tail = PJSUA_INVALID_ID;
+
     /* Check the route URI's and force loose route if required */
     for (i=0; i<pjsua_var.ua_cfg.outbound_proxy_cnt; ++i) {
 	status = normalize_route_uri(pjsua_var.pool,
@@ -245,8 +257,8 @@ PJ_DEF(pj_status_t) pjsua_enum_calls( pjsua_call_id ids[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<pjsua_var.ua_cfg.max_calls; ++i) {
-	if (!pjsua_var.calls[i].inv)
+    for (i=0, c=0; c<*count && i<pjsua_var.call_table_size; ++i) {
+	if (!PJSUA_CALL(i)->inv)
 	    continue;
 	ids[c] = i;
 	++c;
@@ -260,49 +272,110 @@ PJ_DEF(pj_status_t) pjsua_enum_calls( pjsua_call_id ids[],
 }
 
 
-/* Allocate one call id */
-static pjsua_call_id alloc_call_id(void)
+/* Add more calls to the call table and put them in the free list. */
+static pj_status_t grow_call_table(void)
 {
-    pjsua_call_id cid;
+    unsigned chunk_idx = pjsua_var.call_table_size / PJSUA_CALL_CHUNK_SIZE;
+    unsigned i, cnt;
+    pjsua_call *chunk;
 
-#if 1
-    /* New algorithm: round-robin */
-    if (pjsua_var.next_call_id >= (int)pjsua_var.ua_cfg.max_calls ||
-	pjsua_var.next_call_id < 0)
-    {
-	pjsua_var.next_call_id = 0;
+    cnt = pjsua_var.ua_cfg.max_calls - pjsua_var.call_table_size;
+    if (cnt == 0)
+	return PJ_ETOOMANY;
+    if (cnt > PJSUA_CALL_CHUNK_SIZE)
+	cnt = PJSUA_CALL_CHUNK_SIZE;
+
+    chunk = (pjsua_call*) pj_pool_calloc(pjsua_var.pool, cnt,
+					 sizeof(pjsua_call));
+    if (!chunk)
+	return PJ_ENOMEM;
+
+    pjsua_var.calls[chunk_idx] = chunk;
+
+    for (i=0; i<cnt; ++i) {
+	pjsua_call_id cid = pjsua_var.call_table_size + i;
+
+	reset_call(cid);
+	chunk[i].next_free = (i+1 < cnt) ? cid + 1 : PJSUA_INVALID_ID;
     }
 
-    for (cid=pjsua_var.next_call_id;
-	 cid<(int)pjsua_var.ua_cfg.max_calls;
-	 ++cid)
-    {
-	if (pjsua_var.calls[cid].inv == NULL &&
-            pjsua_var.calls[cid].async_call.dlg == NULL)
-        {
-	    ++pjsua_var.next_call_id;
-	    return cid;
-	}
+    /* Append the new calls to the free list */
+    if (pjsua_var.call_free_tail == PJSUA_INVALID_ID) {
+	pjsua_var.call_free_head = pjsua_var.call_table_size;
+    } else {
+	PJSUA_CALL(pjsua_var.call_free_tail)->next_free =
+	    pjsua_var.call_table_size;
     }
+    pjsua_var.call_free_tail = pjsua_var.call_table_size + cnt - 1;
+    pjsua_var.call_table_size += cnt;
 
-    for (cid=0; cid < pjsua_var.next_call_id; ++cid) {
-	if (pjsua_var.calls[cid].inv == NULL &&
-            pjsua_var.calls[cid].async_call.dlg == NULL)
-        {
-	    ++pjsua_var.next_call_id;
-	    return cid;
-	}
+    PJ_LOG(5,(THIS_FILE, "Call table grown to %u calls",
+	      pjsua_var.call_table_size));
+
+    return PJ_SUCCESS;
+}
+
+/* Grow the call table to hold at least count calls. */
+pj_status_t pjsua_call_grow_table(unsigned count)
+{
+    PJ_ASSERT_RETURN(count <= pjsua_var.ua_cfg.max_calls, PJ_ETOOMANY);
+
+    while (pjsua_var.call_table_size < count) {
+	pj_status_t status = grow_call_table();
+	if (status != PJ_SUCCESS)
+	    return status;
     }
 
-#else
-    /* Old algorithm */
-    for (cid=0; cid<(int)pjsua_var.ua_cfg.max_calls; ++cid) {
-	if (pjsua_var.calls[cid].inv == NULL)
-	    return cid;
+    return PJ_SUCCESS;
+}
+
+/* Allocate one call id. Free call ids are reused in the order they are
+ * freed, so a call id is not reused right after its call has ended.
+ */
+static pjsua_call_id alloc_call_id(void)
+{
+    pjsua_call_id cid;
+    pjsua_call *call;
+
+    if (pjsua_var.call_free_head == PJSUA_INVALID_ID &&
+	grow_call_table() != PJ_SUCCESS)
+    {
+	return PJSUA_INVALID_ID;
     }
-#endif
 
-    return PJSUA_INVALID_ID;
+    cid = pjsua_var.call_free_head;
+    call = PJSUA_CALL(cid);
+
+    pjsua_var.call_free_head = call->next_free;
+    if (pjsua_var.call_free_head == PJSUA_INVALID_ID)
+	pjsua_var.call_free_tail = PJSUA_INVALID_ID;
+
+    /* Clear call descriptor */
+    reset_call(cid);
+    call->in_use = PJ_TRUE;
+    call->next_free = PJSUA_INVALID_ID;
+
+    return cid;
+}
+
+/* Return the call id to the free list. It's okay to call this more than
+ * once for the same call.
+ */
+static void free_call_id(pjsua_call_id cid)
+{
+    pjsua_call *call = PJSUA_CALL(cid);
+
+    if (!call->in_use)
+	return;
+
+    call->in_use = PJ_FALSE;
+    call->next_free = PJSUA_INVALID_ID;
+
+    if (pjsua_var.call_free_tail == PJSUA_INVALID_ID)
+	pjsua_var.call_free_head = cid;
+    else
+	PJSUA_CALL(pjsua_var.call_free_tail)->next_free = cid;
+    pjsua_var.call_free_tail = cid;
 }
 
 /* Get signaling secure level.
@@ -315,7 +388,7 @@ static int get_secure_level(pjsua_acc_id acc_id, const pj_str_t *dst_uri)
 {
     const pj_str_t tls = pj_str(";transport=tls");
     const pj_str_t sips = pj_str("sips:");
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
 
     if (pj_stristr(dst_uri, &sips))
 	return 2;
@@ -376,8 +449,8 @@ on_make_call_med_tp_complete(pjsua_call_id call_id,
 {
     pjmedia_sdp_session *offer = NULL;
     pjsip_inv_session *inv = NULL;
-    pjsua_call *call = &pjsua_var.calls[call_id];
-    pjsua_acc *acc = &pjsua_var.acc[call->acc_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
+    pjsua_acc *acc = PJSUA_ACC(call->acc_id);
     pjsip_dialog *dlg = call->async_call.dlg;
     unsigned options = 0;
     pjsip_tx_data *tdata;
@@ -550,6 +623,7 @@ on_error:
     if (call_id != -1) {
 	pjsua_media_channel_deinit(call_id);
 	reset_call(call_id);
+	free_call_id(call_id);
     }
 
     call->med_ch_cb = NULL;
@@ -652,7 +726,7 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
     pj_status_t status;
 
     /* Check that account is valid */
-    PJ_ASSERT_RETURN(acc_id>=0 || acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 || acc_id<(int)pjsua_var.acc_table_size,
 		     PJ_EINVAL);
 
     /* Check arguments */
@@ -678,7 +752,7 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
 	    goto on_error;
     }
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
     if (!acc->valid) {
 	pjsua_perror(THIS_FILE, "Unable to make call because account "
 		     "is not valid", PJ_EINVALIDOP);
@@ -695,10 +769,7 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
 	goto on_error;
     }
 
-    /* Clear call descriptor */
-    reset_call(call_id);
-
-    call = &pjsua_var.calls[call_id];
+    call = PJSUA_CALL(call_id);
 
     /* Associate session with account */
     call->acc_id = acc_id;
@@ -851,6 +922,7 @@ on_error:
     if (call_id != -1) {
 	pjsua_media_channel_deinit(call_id);
 	reset_call(call_id);
+	free_call_id(call_id);
     }
 
     pjsua_check_snd_dev_idle();
@@ -977,7 +1049,7 @@ static pj_status_t
 on_incoming_call_med_tp_complete(pjsua_call_id call_id,
                                  const pjsua_med_tp_state_info *info)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
     const pjmedia_sdp_session *offer=NULL;
     pjmedia_sdp_session *answer;
     pjsip_tx_data *response = NULL;
@@ -1129,10 +1201,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 	goto on_return;
     }
 
-    /* Clear call descriptor */
-    reset_call(call_id);
-
-    call = &pjsua_var.calls[call_id];
+    call = PJSUA_CALL(call_id);
 
     /* Mark call start time. */
     pj_gettimeofday(&call->start_time);
@@ -1217,7 +1286,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
      * the call.
      */
     acc_id = call->acc_id = pjsua_acc_find_for_incoming(rdata);
-    call->call_hold_type = pjsua_var.acc[acc_id].cfg.call_hold_type;
+    call->call_hold_type = PJSUA_ACC(acc_id)->cfg.call_hold_type;
 
     /* Get call's secure level */
     if (PJSIP_URI_SCHEME_IS_SIPS(rdata->msg_info.msg->line.req.uri))
@@ -1303,13 +1372,13 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     /* Verify that we can handle the request. */
     options |= PJSIP_INV_SUPPORT_100REL;
     options |= PJSIP_INV_SUPPORT_TIMER;
-    if (pjsua_var.acc[acc_id].cfg.require_100rel == PJSUA_100REL_MANDATORY)
+    if (PJSUA_ACC(acc_id)->cfg.require_100rel == PJSUA_100REL_MANDATORY)
 	options |= PJSIP_INV_REQUIRE_100REL;
-    if (pjsua_var.acc[acc_id].cfg.ice_cfg.enable_ice)
+    if (PJSUA_ACC(acc_id)->cfg.ice_cfg.enable_ice)
 	options |= PJSIP_INV_SUPPORT_ICE;
-    if (pjsua_var.acc[acc_id].cfg.use_timer == PJSUA_SIP_TIMER_REQUIRED)
+    if (PJSUA_ACC(acc_id)->cfg.use_timer == PJSUA_SIP_TIMER_REQUIRED)
 	options |= PJSIP_INV_REQUIRE_TIMER;
-    else if (pjsua_var.acc[acc_id].cfg.use_timer == PJSUA_SIP_TIMER_ALWAYS)
+    else if (PJSUA_ACC(acc_id)->cfg.use_timer == PJSUA_SIP_TIMER_ALWAYS)
 	options |= PJSIP_INV_ALWAYS_USE_TIMER;
 
     status = pjsip_inv_verify_request2(rdata, &options, offer, NULL, NULL,
@@ -1336,8 +1405,8 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     }
 
     /* Get suitable Contact header */
-    if (pjsua_var.acc[acc_id].contact.slen) {
-	contact = pjsua_var.acc[acc_id].contact;
+    if (PJSUA_ACC(acc_id)->contact.slen) {
+	contact = PJSUA_ACC(acc_id)->contact;
     } else {
 	status = pjsua_acc_create_uas_contact(rdata->tp_info.pool, &contact,
 					      acc_id, rdata);
@@ -1359,11 +1428,11 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 	goto on_return;
     }
 
-    if (pjsua_var.acc[acc_id].cfg.allow_via_rewrite &&
-        pjsua_var.acc[acc_id].via_addr.host.slen > 0)
+    if (PJSUA_ACC(acc_id)->cfg.allow_via_rewrite &&
+        PJSUA_ACC(acc_id)->via_addr.host.slen > 0)
     {
-        pjsip_dlg_set_via_sent_by(dlg, &pjsua_var.acc[acc_id].via_addr,
-                                  pjsua_var.acc[acc_id].via_tp);
+        pjsip_dlg_set_via_sent_by(dlg, &PJSUA_ACC(acc_id)->via_addr,
+                                  PJSUA_ACC(acc_id)->via_tp);
     } else if (!pjsua_sip_acc_is_using_stun(acc_id)) {
 	/* Choose local interface to use in Via if acc is not using
 	 * STUN. See https://trac.pjsip.org/repos/ticket/1804
@@ -1389,20 +1458,20 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     }
 
     /* Set credentials */
-    if (pjsua_var.acc[acc_id].cred_cnt) {
+    if (PJSUA_ACC(acc_id)->cred_cnt) {
 	pjsip_auth_clt_set_credentials(&dlg->auth_sess,
-				       pjsua_var.acc[acc_id].cred_cnt,
-				       pjsua_var.acc[acc_id].cred);
+				       PJSUA_ACC(acc_id)->cred_cnt,
+				       PJSUA_ACC(acc_id)->cred);
     }
 
     /* Set preference */
     pjsip_auth_clt_set_prefs(&dlg->auth_sess,
-			     &pjsua_var.acc[acc_id].cfg.auth_pref);
+			     &PJSUA_ACC(acc_id)->cfg.auth_pref);
 
     /* Disable Session Timers if not prefered and the incoming INVITE request
      * did not require it.
      */
-    if (pjsua_var.acc[acc_id].cfg.use_timer == PJSUA_SIP_TIMER_INACTIVE &&
+    if (PJSUA_ACC(acc_id)->cfg.use_timer == PJSUA_SIP_TIMER_INACTIVE &&
 	(options & PJSIP_INV_REQUIRE_TIMER) == 0)
     {
 	options &= ~(PJSIP_INV_SUPPORT_TIMER);
@@ -1410,7 +1479,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 
     /* If 100rel is optional and UAC supports it, use it. */
     if ((options & PJSIP_INV_REQUIRE_100REL)==0 &&
-	pjsua_var.acc[acc_id].cfg.require_100rel == PJSUA_100REL_OPTIONAL)
+	PJSUA_ACC(acc_id)->cfg.require_100rel == PJSUA_100REL_OPTIONAL)
     {
 	const pj_str_t token = { "100rel", 6};
 	pjsip_dialog_cap_status cap_status;
@@ -1444,10 +1513,10 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     /* If account is locked to specific transport, then lock dialog
      * to this transport too.
      */
-    if (pjsua_var.acc[acc_id].cfg.transport_id != PJSUA_INVALID_ID) {
+    if (PJSUA_ACC(acc_id)->cfg.transport_id != PJSUA_INVALID_ID) {
 	pjsip_tpselector tp_sel;
 
-	pjsua_init_tpselector(pjsua_var.acc[acc_id].cfg.transport_id, &tp_sel);
+	pjsua_init_tpselector(PJSUA_ACC(acc_id)->cfg.transport_id, &tp_sel);
 	pjsip_dlg_set_transport(dlg, &tp_sel);
     }
 
@@ -1514,7 +1583,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 
     /* Init Session Timers */
     status = pjsip_timer_init_session(inv,
-				    &pjsua_var.acc[acc_id].cfg.timer_setting);
+				    &PJSUA_ACC(acc_id)->cfg.timer_setting);
     if (status != PJ_SUCCESS) {
 	pjsua_perror(THIS_FILE, "Session Timer init failed", status);
         pjsip_dlg_respond(dlg, rdata, PJSIP_SC_INTERNAL_SERVER_ERROR, NULL, NULL, NULL);
@@ -1611,6 +1680,13 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 
     /* This INVITE request has been handled. */
 on_return:
+    /* Release the call id if the call was not created. */
+    if (call_id != PJSUA_INVALID_ID && PJSUA_CALL(call_id)->inv == NULL &&
+	PJSUA_CALL(call_id)->async_call.dlg == NULL)
+    {
+	free_call_id(call_id);
+    }
+
     pj_log_pop_indent();
     PJSUA_UNLOCK();
     return PJ_TRUE;
@@ -1626,8 +1702,11 @@ PJ_DEF(pj_bool_t) pjsua_call_is_active(pjsua_call_id call_id)
 {
     PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
 		     PJ_EINVAL);
-    return pjsua_var.calls[call_id].inv != NULL &&
-	   pjsua_var.calls[call_id].inv->state != PJSIP_INV_STATE_DISCONNECTED;
+    /* Call ids which have never been allocated are not active */
+    if (!PJSUA_CALL_ID_IS_VALID(call_id))
+	return PJ_FALSE;
+    return PJSUA_CALL(call_id)->inv != NULL &&
+	   PJSUA_CALL(call_id)->inv->state != PJSIP_INV_STATE_DISCONNECTED;
 }
 
 
@@ -1644,6 +1723,12 @@ pj_status_t acquire_call(const char *title,
     pj_time_val time_start, timeout;
     pjsip_dialog *dlg = NULL;
 
+    /* Call ids which have never been allocated have no call */
+    if (!PJSUA_CALL_ID_IS_VALID(call_id)) {
+	PJ_LOG(3,(THIS_FILE, "Invalid call_id %d in %s", call_id, title));
+	return PJ_EINVALIDOP;
+    }
+
     pj_gettimeofday(&time_start);
     timeout.sec = 0;
     timeout.msec = PJSUA_ACQUIRE_CALL_TIMEOUT;
@@ -1669,7 +1754,7 @@ pj_status_t acquire_call(const char *title,
 	}
 
 	has_pjsua_lock = PJ_TRUE;
-	call = &pjsua_var.calls[call_id];
+	call = PJSUA_CALL(call_id);
         if (call->inv)
             dlg = call->inv->dlg;
         else
@@ -1727,12 +1812,15 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
 
     pj_bzero(info, sizeof(*info));
 
+    if (!PJSUA_CALL_ID_IS_VALID(call_id))
+	return PJ_EINVALIDOP;
+
     /* Use PJSUA_LOCK() instead of acquire_call():
      *  https://trac.pjsip.org/repos/ticket/1371
      */
     PJSUA_LOCK();
 
-    call = &pjsua_var.calls[call_id];
+    call = PJSUA_CALL(call_id);
     dlg = (call->inv ? call->inv->dlg : call->async_call.dlg);
     if (!dlg) {
 	PJSUA_UNLOCK();
@@ -1947,7 +2035,9 @@ PJ_DEF(pj_status_t) pjsua_call_set_user_data( pjsua_call_id call_id,
 {
     PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
 		     PJ_EINVAL);
-    pjsua_var.calls[call_id].user_data = user_data;
+    if (!PJSUA_CALL_ID_IS_VALID(call_id))
+	return PJ_EINVALIDOP;
+    PJSUA_CALL(call_id)->user_data = user_data;
 
     return PJ_SUCCESS;
 }
@@ -1960,7 +2050,9 @@ PJ_DEF(void*) pjsua_call_get_user_data(pjsua_call_id call_id)
 {
     PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
 		     NULL);
-    return pjsua_var.calls[call_id].user_data;
+    if (!PJSUA_CALL_ID_IS_VALID(call_id))
+	return NULL;
+    return PJSUA_CALL(call_id)->user_data;
 }
 
 
@@ -1974,7 +2066,10 @@ PJ_DEF(pj_status_t) pjsua_call_get_rem_nat_type(pjsua_call_id call_id,
 		     PJ_EINVAL);
     PJ_ASSERT_RETURN(p_type != NULL, PJ_EINVAL);
 
-    *p_type = pjsua_var.calls[call_id].rem_nat_type;
+    if (!PJSUA_CALL_ID_IS_VALID(call_id))
+	return PJ_EINVALIDOP;
+
+    *p_type = PJSUA_CALL(call_id)->rem_nat_type;
     return PJ_SUCCESS;
 }
 
@@ -1995,9 +2090,12 @@ pjsua_call_get_med_transport_info(pjsua_call_id call_id,
 		     PJ_EINVAL);
     PJ_ASSERT_RETURN(t, PJ_EINVAL);
 
+    if (!PJSUA_CALL_ID_IS_VALID(call_id))
+	return PJ_EINVALIDOP;
+
     PJSUA_LOCK();
 
-    call = &pjsua_var.calls[call_id];
+    call = PJSUA_CALL(call_id);
 
     if (med_idx >= call->med_cnt) {
 	PJSUA_UNLOCK();
@@ -2019,7 +2117,7 @@ static pj_status_t
 on_answer_call_med_tp_complete(pjsua_call_id call_id,
                                const pjsua_med_tp_state_info *info)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
     pjmedia_sdp_session *sdp;
     int sip_err_code = (info? info->sip_err_code: 0);
     pj_status_t status = (info? info->status: PJ_SUCCESS);
@@ -2420,7 +2518,7 @@ PJ_DEF(pj_status_t) pjsua_call_set_hold2(pjsua_call_id call_id,
     if ((options & PJSUA_CALL_UPDATE_CONTACT) &&
 	pjsua_acc_is_valid(call->acc_id))
     {
-	new_contact = &pjsua_var.acc[call->acc_id].contact;
+	new_contact = &PJSUA_ACC(call->acc_id)->contact;
     }
 
     /* Create re-INVITE with new offer */
@@ -2541,7 +2639,7 @@ PJ_DEF(pj_status_t) pjsua_call_reinvite2(pjsua_call_id call_id,
     if ((call->opt.flag & PJSUA_CALL_UPDATE_CONTACT) &&
 	    pjsua_acc_is_valid(call->acc_id))
     {
-	new_contact = &pjsua_var.acc[call->acc_id].contact;
+	new_contact = &PJSUA_ACC(call->acc_id)->contact;
     }
 
     /* Create re-INVITE with new offer */
@@ -2650,7 +2748,7 @@ PJ_DEF(pj_status_t) pjsua_call_update2(pjsua_call_id call_id,
     if ((call->opt.flag & PJSUA_CALL_UPDATE_CONTACT) &&
 	    pjsua_acc_is_valid(call->acc_id))
     {
-	new_contact = &pjsua_var.acc[call->acc_id].contact;
+	new_contact = &PJSUA_ACC(call->acc_id)->contact;
     }
 
     /* Create UPDATE with new offer */
@@ -3053,8 +3151,8 @@ PJ_DEF(void) pjsua_call_hangup_all(void)
     // This may deadlock, see https://trac.pjsip.org/repos/ticket/1305
     //PJSUA_LOCK();
 
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-	if (pjsua_var.calls[i].inv)
+    for (i=0; i<pjsua_var.call_table_size; ++i) {
+	if (PJSUA_CALL(i)->inv)
 	    pjsua_call_hangup(i, 0, NULL, NULL);
     }
 
@@ -3073,7 +3171,7 @@ static void reinv_timer_cb(pj_timer_heap_t *th, pj_timer_entry *entry)
 
     PJ_UNUSED_ARG(th);
 
-    pjsua_var.calls[call_id].reinv_timer.id = PJ_FALSE;
+    PJSUA_CALL(call_id)->reinv_timer.id = PJ_FALSE;
 
     pj_log_push_indent();
 
@@ -3156,7 +3254,7 @@ static pj_bool_t check_lock_codec(pjsua_call *call)
     pj_status_t status;
 
     /* Check if lock codec is disabled */
-    if (!pjsua_var.acc[call->acc_id].cfg.lock_codec)
+    if (!PJSUA_ACC(call->acc_id)->cfg.lock_codec)
 	return PJ_FALSE;
 
     /* Check lock codec retry count */
@@ -3254,7 +3352,7 @@ static pj_bool_t check_ice_complete(pjsua_call *call, pj_bool_t *need_reinv)
 	    ice_info->sess_state == PJ_ICE_STRANS_STATE_RUNNING &&
 	    ice_info->role == PJ_ICE_SESS_ROLE_CONTROLLING)
 	{
-	    pjsua_ice_config *cfg=&pjsua_var.acc[call->acc_id].cfg.ice_cfg;
+	    pjsua_ice_config *cfg=&PJSUA_ACC(call->acc_id)->cfg.ice_cfg;
 	    if ((cfg->ice_always_update && !call->reinv_ice_sent) ||
 		pj_sockaddr_cmp(&tpinfo.sock_info.rtp_addr_name,
 				&call_med->rtp_addr))
@@ -3697,6 +3795,7 @@ static void pjsua_call_on_state_changed(pjsip_inv_session *inv,
 
 	/* Reset call */
 	reset_call(call->index);
+	free_call_id(call->index);
 
 	pjsua_check_snd_dev_idle();
 
@@ -4614,11 +4713,11 @@ static void on_call_transferred( pjsip_inv_session *inv,
 	 * Subsequent state changed in pjsua_inv_on_state_changed() will be
 	 * reported back to the server subscription.
 	 */
-	pjsua_var.calls[new_call].xfer_sub = sub;
+	PJSUA_CALL(new_call)->xfer_sub = sub;
 
 	/* Put the invite_data in the subscription. */
 	pjsip_evsub_set_mod_data(sub, pjsua_var.mod.id,
-				 &pjsua_var.calls[new_call]);
+				 PJSUA_CALL(new_call));
     }
 
 on_return:
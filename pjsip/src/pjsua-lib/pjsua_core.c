@@ -55,9 +55,6 @@ static void init_data()
 
     pj_bzero(&pjsua_var, sizeof(pjsua_var));
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i)
-	pjsua_var.acc[i].index = i;
-    
     for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.tpdata); ++i)
 	pjsua_var.tpdata[i].index = i;
 
@@ -103,6 +100,7 @@ PJ_DEF(void) pjsua_config_default(pjsua_config *cfg)
     pj_bzero(cfg, sizeof(*cfg));
 
     cfg->max_calls = ((PJSUA_MAX_CALLS) < 4) ? (PJSUA_MAX_CALLS) : 4;
+    cfg->max_acc = PJSUA_MAX_ACC;
     cfg->thread_cnt = 1;
     cfg->nat_type_in_sdp = 1;
     cfg->stun_ignore_failure = PJ_TRUE;
@@ -192,6 +190,7 @@ PJ_DEF(void) pjsua_transport_config_default(pjsua_transport_config *cfg)
 {
     pj_bzero(cfg, sizeof(*cfg));
     pjsip_tls_setting_default(&cfg->tls_setting);
+    cfg->sock_cnt = 1;
 }
 
 PJ_DEF(void) pjsua_transport_config_dup(pj_pool_t *pool,
@@ -502,12 +501,12 @@ static pj_bool_t options_on_rx_request(pjsip_rx_data *rdata)
 
     /* Get media socket info, make sure transport is ready */
 #if DISABLED_FOR_TICKET_1185
-    if (pjsua_var.calls[0].med_tp) {
+    if (PJSUA_CALL(0)->med_tp) {
 	pjmedia_transport_info tpinfo;
 	pjmedia_sdp_session *sdp;
 
 	pjmedia_transport_info_init(&tpinfo);
-	pjmedia_transport_get_info(pjsua_var.calls[0].med_tp, &tpinfo);
+	pjmedia_transport_get_info(PJSUA_CALL(0)->med_tp, &tpinfo);
 
 	/* Add SDP body, using call0's RTP address */
 	status = pjmedia_endpt_create_sdp(pjsua_var.med_endpt, tdata->pool, 1,
@@ -1036,6 +1035,11 @@ PJ_DEF(pj_status_t) pjsua_init( const pjsua_config *ua_cfg,
     if (status != PJ_SUCCESS)
 	goto on_error;
 
+    /* Initialize PJSUA account subsystem: */
+    status = pjsua_acc_subsys_init(ua_cfg);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
     /* Convert deprecated STUN settings */
     if (pjsua_var.ua_cfg.stun_srv_cnt==0) {
 	if (pjsua_var.ua_cfg.stun_domain.slen) {
@@ -1558,7 +1562,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	}
 
 	/* Deinit media channel of all calls (see #1717) */
-	for (i=0; i<(int)pjsua_var.ua_cfg.max_calls; ++i) {
+	for (i=0; i<(int)pjsua_var.call_table_size; ++i) {
 	    /* TODO: check if we're not allowed to send to network in the
 	     *       "flags", and if so do not do TURN allocation...
 	     */
@@ -1566,11 +1570,11 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	}
 
 	/* Set all accounts to offline */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<(int)pjsua_var.acc_table_size; ++i) {
+	    if (!PJSUA_ACC(i)->valid)
 		continue;
-	    pjsua_var.acc[i].online_status = PJ_FALSE;
-	    pj_bzero(&pjsua_var.acc[i].rpid, sizeof(pjrpid_element));
+	    PJSUA_ACC(i)->online_status = PJ_FALSE;
+	    pj_bzero(&PJSUA_ACC(i)->rpid, sizeof(pjrpid_element));
 	}
 
 	/* Terminate all presence subscriptions. */
@@ -1581,11 +1585,11 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	 */
 	/* First stage, get the maximum wait time */
 	max_wait = 100;
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<(int)pjsua_var.acc_table_size; ++i) {
+	    if (!PJSUA_ACC(i)->valid)
 		continue;
-	    if (pjsua_var.acc[i].cfg.unpublish_max_wait_time_msec > max_wait)
-		max_wait = pjsua_var.acc[i].cfg.unpublish_max_wait_time_msec;
+	    if (PJSUA_ACC(i)->cfg.unpublish_max_wait_time_msec > max_wait)
+		max_wait = PJSUA_ACC(i)->cfg.unpublish_max_wait_time_msec;
 	}
 	
 	/* No waiting if RX is disabled */
@@ -1596,33 +1600,33 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	/* Second stage, wait for unpublications to complete */
 	for (i=0; i<(int)(max_wait/50); ++i) {
 	    unsigned j;
-	    for (j=0; j<PJ_ARRAY_SIZE(pjsua_var.acc); ++j) {
-		if (!pjsua_var.acc[j].valid)
+	    for (j=0; j<pjsua_var.acc_table_size; ++j) {
+		if (!PJSUA_ACC(j)->valid)
 		    continue;
 
-		if (pjsua_var.acc[j].publish_sess)
+		if (PJSUA_ACC(j)->publish_sess)
 		    break;
 	    }
-	    if (j != PJ_ARRAY_SIZE(pjsua_var.acc))
+	    if (j != pjsua_var.acc_table_size)
 		busy_sleep(50);
 	    else
 		break;
 	}
 
 	/* Third stage, forcefully destroy unfinished unpublications */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (pjsua_var.acc[i].publish_sess) {
-		pjsip_publishc_destroy(pjsua_var.acc[i].publish_sess);
-		pjsua_var.acc[i].publish_sess = NULL;
+	for (i=0; i<(int)pjsua_var.acc_table_size; ++i) {
+	    if (PJSUA_ACC(i)->publish_sess) {
+		pjsip_publishc_destroy(PJSUA_ACC(i)->publish_sess);
+		PJSUA_ACC(i)->publish_sess = NULL;
 	    }
 	}
 
 	/* Unregister all accounts */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<(int)pjsua_var.acc_table_size; ++i) {
+	    if (!PJSUA_ACC(i)->valid)
 		continue;
 
-	    if (pjsua_var.acc[i].regc && (flags & PJSUA_DESTROY_NO_TX_MSG)==0)
+	    if (PJSUA_ACC(i)->regc && (flags & PJSUA_DESTROY_NO_TX_MSG)==0)
 	    {
 		pjsua_acc_set_registration(i, PJ_FALSE);
 	    }
@@ -1641,11 +1645,11 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	/* Wait until all unregistrations are done (ticket #364) */
 	/* First stage, get the maximum wait time */
 	max_wait = 100;
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<(int)pjsua_var.acc_table_size; ++i) {
+	    if (!PJSUA_ACC(i)->valid)
 		continue;
-	    if (pjsua_var.acc[i].cfg.unreg_timeout > max_wait)
-		max_wait = pjsua_var.acc[i].cfg.unreg_timeout;
+	    if (PJSUA_ACC(i)->cfg.unreg_timeout > max_wait)
+		max_wait = PJSUA_ACC(i)->cfg.unreg_timeout;
 	}
 	
 	/* No waiting if RX is disabled */
@@ -1656,14 +1660,14 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	/* Second stage, wait for unregistrations to complete */
 	for (i=0; i<(int)(max_wait/50); ++i) {
 	    unsigned j;
-	    for (j=0; j<PJ_ARRAY_SIZE(pjsua_var.acc); ++j) {
-		if (!pjsua_var.acc[j].valid)
+	    for (j=0; j<pjsua_var.acc_table_size; ++j) {
+		if (!PJSUA_ACC(j)->valid)
 		    continue;
 
-		if (pjsua_var.acc[j].regc)
+		if (PJSUA_ACC(j)->regc)
 		    break;
 	    }
-	    if (j != PJ_ARRAY_SIZE(pjsua_var.acc))
+	    if (j != pjsua_var.acc_table_size)
 		busy_sleep(50);
 	    else
 		break;
@@ -1699,10 +1703,10 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	}
 
 	/* Destroy accounts */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (pjsua_var.acc[i].pool) {
-		pj_pool_release(pjsua_var.acc[i].pool);
-		pjsua_var.acc[i].pool = NULL;
+	for (i=0; i<(int)pjsua_var.acc_table_size; ++i) {
+	    if (PJSUA_ACC(i)->pool) {
+		pj_pool_release(PJSUA_ACC(i)->pool);
+		PJSUA_ACC(i)->pool = NULL;
 	    }
 	}
     }
@@ -1921,6 +1925,7 @@ static void on_tp_state_callback(pjsip_transport *tp,
  */
 static pj_status_t create_sip_udp_sock(int af,
 				       const pjsua_transport_config *cfg,
+				       pj_bool_t reuse_port,
 				       pj_sock_t *p_sock,
 				       pj_sockaddr *p_pub_addr)
 {
@@ -1968,6 +1973,18 @@ static pj_status_t create_sip_udp_sock(int af,
     if (cfg->sockopt_params.cnt)
 	status = pj_sock_setsockopt_params(sock, &cfg->sockopt_params);
 
+    /* Apply SO_REUSEPORT, so that other sockets can share the address */
+    if (reuse_port) {
+	int enabled = 1;
+	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEPORT(),
+				    &enabled, sizeof(enabled));
+	if (status != PJ_SUCCESS) {
+	    pjsua_perror(THIS_FILE, "Error setting SO_REUSEPORT", status);
+	    pj_sock_close(sock);
+	    return status;
+	}
+    }
+
     /* Bind socket */
     status = pj_sock_bind(sock, &bind_addr, pj_sockaddr_get_len(&bind_addr));
     if (status != PJ_SUCCESS) {
@@ -2061,6 +2078,57 @@ static pj_status_t create_sip_udp_sock(int af,
 }
 
 
+/*
+ * Create another SIP UDP socket which shares the bound address of the
+ * first socket with SO_REUSEPORT.
+ */
+static pj_status_t create_sip_udp_rp_sock(const pjsua_transport_config *cfg,
+					  pj_sock_t first_sock,
+					  pj_sock_t *p_sock)
+{
+    pj_sockaddr bound_addr;
+    int namelen = sizeof(bound_addr);
+    int enabled = 1;
+    pj_sock_t sock;
+    pj_status_t status;
+
+    status = pj_sock_getsockname(first_sock, &bound_addr, &namelen);
+    if (status != PJ_SUCCESS) {
+	pjsua_perror(THIS_FILE, "getsockname() error", status);
+	return status;
+    }
+
+    status = pj_sock_socket(bound_addr.addr.sa_family, pj_SOCK_DGRAM(), 0,
+			    &sock);
+    if (status != PJ_SUCCESS) {
+	pjsua_perror(THIS_FILE, "socket() error", status);
+	return status;
+    }
+
+    /* Apply QoS, if specified */
+    status = pj_sock_apply_qos2(sock, cfg->qos_type, 
+				&cfg->qos_params, 
+				2, THIS_FILE, "SIP UDP socket");
+
+    /* Apply sockopt, if specified */
+    if (cfg->sockopt_params.cnt)
+	status = pj_sock_setsockopt_params(sock, &cfg->sockopt_params);
+
+    status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEPORT(),
+				&enabled, sizeof(enabled));
+    if (status == PJ_SUCCESS)
+	status = pj_sock_bind(sock, &bound_addr, namelen);
+    if (status != PJ_SUCCESS) {
+	pjsua_perror(THIS_FILE, "bind() error", status);
+	pj_sock_close(sock);
+	return status;
+    }
+
+    *p_sock = sock;
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Create SIP transport.
  */
@@ -2093,7 +2161,8 @@ PJ_DEF(pj_status_t) pjsua_transport_create( pjsip_transport_type_e type,
 	 */
 	pjsua_transport_config config;
 	char hostbuf[PJ_INET6_ADDRSTRLEN];
-	pj_sock_t sock = PJ_INVALID_SOCKET;
+	pj_sock_t sock[16];
+	unsigned sock_cnt, i;
 	pj_sockaddr pub_addr;
 	pjsip_host_port addr_name;
 
@@ -2103,6 +2172,16 @@ PJ_DEF(pj_status_t) pjsua_transport_create( pjsip_transport_type_e type,
 	    cfg = &config;
 	}
 
+	/* Several sockets can only share the address with SO_REUSEPORT */
+	sock_cnt = cfg->sock_cnt ? cfg->sock_cnt : 1;
+	if (sock_cnt > PJ_ARRAY_SIZE(sock))
+	    sock_cnt = PJ_ARRAY_SIZE(sock);
+	if (sock_cnt > 1 && pj_SO_REUSEPORT() == 0xFFFF) {
+	    PJ_LOG(3,(THIS_FILE, "SO_REUSEPORT is not supported, using one "
+		      "SIP UDP socket"));
+	    sock_cnt = 1;
+	}
+
 	/* Initialize the public address from the config, if any */
 	pj_sockaddr_init(pjsip_transport_type_get_af(type), &pub_addr, 
 			 NULL, (pj_uint16_t)cfg->port);
@@ -2121,21 +2200,32 @@ PJ_DEF(pj_status_t) pjsua_transport_create( pjsip_transport_type_e type,
 	 * (only when public address is not specified).
 	 */
 	status = create_sip_udp_sock(pjsip_transport_type_get_af(type),
-				     cfg, &sock, &pub_addr);
+				     cfg, (sock_cnt > 1), &sock[0], &pub_addr);
 	if (status != PJ_SUCCESS)
 	    goto on_return;
 
+	/* Create the other sockets on the same address */
+	for (i=1; i<sock_cnt; ++i) {
+	    status = create_sip_udp_rp_sock(cfg, sock[0], &sock[i]);
+	    if (status != PJ_SUCCESS) {
+		while (i-- > 0)
+		    pj_sock_close(sock[i]);
+		goto on_return;
+	    }
+	}
+
 	pj_ansi_strcpy(hostbuf, addr_string(&pub_addr));
 	addr_name.host = pj_str(hostbuf);
 	addr_name.port = pj_sockaddr_get_port(&pub_addr);
 
 	/* Create UDP transport */
-	status = pjsip_udp_transport_attach2(pjsua_var.endpt, type, sock,
-					     &addr_name, 1, &tp);
+	status = pjsip_udp_transport_attach3(pjsua_var.endpt, type, sock_cnt,
+					     sock, &addr_name, 1, &tp);
 	if (status != PJ_SUCCESS) {
 	    pjsua_perror(THIS_FILE, "Error creating SIP UDP transport", 
 			 status);
-	    pj_sock_close(sock);
+	    for (i=0; i<sock_cnt; ++i)
+		pj_sock_close(sock[i]);
 	    goto on_return;
 	}
 
@@ -2193,6 +2283,10 @@ PJ_DEF(pj_status_t) pjsua_transport_create( pjsip_transport_type_e type,
 	/* Copy the sockopt */
 	pj_memcpy(&tcp_cfg.sockopt_params, &cfg->sockopt_params,
 		  sizeof(tcp_cfg.sockopt_params));
+
+	/* Number of listener sockets */
+	if (cfg->sock_cnt)
+	    tcp_cfg.sock_cnt = cfg->sock_cnt;
 	
 	/* Create the TCP transport */
 	status = pjsip_tcp_transport_start3(pjsua_var.endpt, &tcp_cfg, &tcp);
@@ -2988,8 +3082,8 @@ PJ_DEF(void) pjsua_dump(pj_bool_t detail)
     pjmedia_endpt_dump(pjsua_get_pjmedia_endpt());
 
     PJ_LOG(3,(THIS_FILE, "Dumping media transports:"));
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i<pjsua_var.call_table_size; ++i) {
+	pjsua_call *call = PJSUA_CALL(i);
 	pjsua_acc_config *acc_cfg;
 	pjmedia_transport *tp[PJSUA_MAX_CALL_MEDIA*2];
 	unsigned tp_cnt = 0;
@@ -3016,7 +3110,7 @@ PJ_DEF(void) pjsua_dump(pj_bool_t detail)
 	    }
 	}
 
-	acc_cfg = &pjsua_var.acc[call->acc_id].cfg;
+	acc_cfg = &PJSUA_ACC(call->acc_id)->cfg;
 
 	/* Dump the media transports in this call */
 	for (j = 0; j < tp_cnt; ++j) {
@@ -3049,7 +3143,7 @@ PJ_DEF(void) pjsua_dump(pj_bool_t detail)
     } else {
 	unsigned i;
 
-	for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
+	for (i=0; i<pjsua_var.call_table_size; ++i) {
 	    if (pjsua_call_is_active(i)) {
 		/* Tricky logging, since call states log string tends to be 
 		 * longer than PJ_LOG_MAX_SIZE.
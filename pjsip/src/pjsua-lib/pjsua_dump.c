@@ -891,13 +891,13 @@ void print_call(const char *title,
 	        char *buf, pj_size_t size)
 {
     int len;
-    pjsip_inv_session *inv = pjsua_var.calls[call_id].inv;
+    pjsip_inv_session *inv = PJSUA_CALL(call_id)->inv;
     pjsip_dialog *dlg;
     char userinfo[128];
 
     /* Dump invite sesion info. */
 
-    dlg = (inv? inv->dlg: pjsua_var.calls[call_id].async_call.dlg);
+    dlg = (inv? inv->dlg: PJSUA_CALL(call_id)->async_call.dlg);
     len = pjsip_hdr_print_on(dlg->remote.info, userinfo, sizeof(userinfo));
     if (len < 0)
 	pj_ansi_strcpy(userinfo, "<--uri too long-->");
@@ -205,7 +205,7 @@ void pjsua_im_process_pager(int call_id, const pj_str_t *from,
 	    if (call_id == PJSUA_INVALID_ID) {
 		acc_id = pjsua_acc_find_for_incoming(rdata);
 	    } else {
-		pjsua_call *call = &pjsua_var.calls[call_id];
+		pjsua_call *call = PJSUA_CALL(call_id);
 		acc_id = call->acc_id;
 	    }
 
@@ -254,7 +254,7 @@ void pjsua_im_process_pager(int call_id, const pj_str_t *from,
 	    if (call_id == PJSUA_INVALID_ID) {
 		acc_id = pjsua_acc_find_for_incoming(rdata);
 	    } else {
-		pjsua_call *call = &pjsua_var.calls[call_id];
+		pjsua_call *call = PJSUA_CALL(call_id);
 		acc_id = call->acc_id;
 	    }
 
@@ -365,11 +365,11 @@ static void im_callback(void *token, pjsip_event *e)
 	    pjsip_auth_clt_init(&auth,pjsua_var.endpt,rdata->tp_info.pool, 0);
     
 	    pjsip_auth_clt_set_credentials(&auth, 
-		pjsua_var.acc[im_data->acc_id].cred_cnt,
-		pjsua_var.acc[im_data->acc_id].cred);
+		PJSUA_ACC(im_data->acc_id)->cred_cnt,
+		PJSUA_ACC(im_data->acc_id)->cred);
 
 	    pjsip_auth_clt_set_prefs(&auth, 
-				     &pjsua_var.acc[im_data->acc_id].cfg.auth_pref);
+				     &PJSUA_ACC(im_data->acc_id)->cfg.auth_pref);
 
 	    status = pjsip_auth_clt_reinit_req(&auth, rdata, tsx->last_tx,
 					       &tdata);
@@ -467,11 +467,11 @@ static void typing_callback(void *token, pjsip_event *e)
 	    pjsip_auth_clt_init(&auth,pjsua_var.endpt,rdata->tp_info.pool, 0);
     
 	    pjsip_auth_clt_set_credentials(&auth, 
-		pjsua_var.acc[im_data->acc_id].cred_cnt,
-		pjsua_var.acc[im_data->acc_id].cred);
+		PJSUA_ACC(im_data->acc_id)->cred_cnt,
+		PJSUA_ACC(im_data->acc_id)->cred);
 
 	    pjsip_auth_clt_set_prefs(&auth, 
-				     &pjsua_var.acc[im_data->acc_id].cfg.auth_pref);
+				     &PJSUA_ACC(im_data->acc_id)->cfg.auth_pref);
 
 	    status = pjsip_auth_clt_reinit_req(&auth, rdata, tsx->last_tx,
 					       &tdata);
@@ -519,7 +519,7 @@ PJ_DEF(pj_status_t) pjsua_im_send( pjsua_acc_id acc_id,
     /* To and message body must be specified. */
     PJ_ASSERT_RETURN(to && content, PJ_EINVAL);
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     /* Create request. */
     status = pjsip_endpt_create_request(pjsua_var.endpt, 
@@ -637,7 +637,7 @@ PJ_DEF(pj_status_t) pjsua_im_typing( pjsua_acc_id acc_id,
     pjsua_acc *acc;
     pj_status_t status;
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     /* Create request. */
     status = pjsip_endpt_create_request( pjsua_var.endpt, &pjsip_message_method,
@@ -129,7 +129,7 @@ pj_status_t pjsua_media_subsys_start(void)
 
 #if DISABLED_FOR_TICKET_1185
     /* Create media for calls, if none is specified */
-    if (pjsua_var.calls[0].media[0].tp == NULL) {
+    if (PJSUA_CALL(0)->media[0].tp == NULL) {
 	pjsua_transport_config transport_cfg;
 
 	/* Create default transport config */
@@ -194,7 +194,7 @@ pj_status_t pjsua_media_subsys_destroy(unsigned flags)
 #if 0
     // This part has been moved out to pjsua_destroy() (see also #1717).
     /* Close media transports */
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
+    for (i=0; i<pjsua_var.call_table_size; ++i) {
         /* TODO: check if we're not allowed to send to network in the
          *       "flags", and if so do not do TURN allocation...
          */
@@ -242,7 +242,7 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
     pj_sockaddr mapped_addr[2];
     pj_status_t status = PJ_SUCCESS;
     char addr_buf[PJ_INET6_ADDRSTRLEN+10];
-    pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+    pjsua_acc *acc = PJSUA_ACC(call_med->call->acc_id);
     pj_sock_t sock[2];
 
     use_ipv6 = (acc->cfg.ipv6_media_use != PJSUA_IPV6_DISABLED);
@@ -547,8 +547,8 @@ static pj_status_t create_udp_media_transports(pjsua_transport_config *cfg)
     unsigned i;
     pj_status_t status;
 
-    for (i=0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i < pjsua_var.call_table_size; ++i) {
+	pjsua_call *call = PJSUA_CALL(i);
 	unsigned strm_idx;
 
 	for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -563,8 +563,8 @@ static pj_status_t create_udp_media_transports(pjsua_transport_config *cfg)
     return PJ_SUCCESS;
 
 on_error:
-    for (i=0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i < pjsua_var.call_table_size; ++i) {
+	pjsua_call *call = PJSUA_CALL(i);
 	unsigned strm_idx;
 
 	for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -726,6 +726,20 @@ static pj_status_t parse_host_port(const pj_str_t *host_port,
     return PJ_SUCCESS;
 }
 
+/* Default port range of the STUN/TURN sockets starting at the specified
+ * port, when none is configured: ten ports for each call, but not past
+ * the last port number.
+ */
+static pj_uint16_t default_port_range(unsigned port)
+{
+    unsigned range = pjsua_var.ua_cfg.max_calls * 10;
+
+    if (range > 65535 - port)
+	range = 65535 - port;
+
+    return (pj_uint16_t)range;
+}
+
 /* Create ICE media transports (when ice is enabled) */
 static pj_status_t create_ice_media_transport(
 				const pjsua_transport_config *cfg,
@@ -740,7 +754,7 @@ static pj_status_t create_ice_media_transport(
     unsigned comp_cnt;
     pj_status_t status;
 
-    acc_cfg = &pjsua_var.acc[call_med->call->acc_id].cfg;
+    acc_cfg = &PJSUA_ACC(call_med->call->acc_id)->cfg;
 
     /* Make sure STUN server resolution has completed */
     status = resolve_stun_server(PJ_TRUE);
@@ -774,8 +788,7 @@ static pj_status_t create_ice_media_transport(
 		     &cfg->bound_addr, (pj_uint16_t)cfg->port);
     ice_cfg.stun.cfg.port_range = (pj_uint16_t)cfg->port_range;
     if (cfg->port != 0 && ice_cfg.stun.cfg.port_range == 0)
-	ice_cfg.stun.cfg.port_range = 
-				 (pj_uint16_t)(pjsua_var.ua_cfg.max_calls * 10);
+	ice_cfg.stun.cfg.port_range = default_port_range(cfg->port);
 
     /* Copy QoS setting to STUN setting */
     ice_cfg.stun.cfg.qos_type = cfg->qos_type;
@@ -808,8 +821,7 @@ static pj_status_t create_ice_media_transport(
 			 &cfg->bound_addr, (pj_uint16_t)cfg->port);
 	ice_cfg.turn.cfg.port_range = (pj_uint16_t)cfg->port_range;
 	if (cfg->port != 0 && ice_cfg.turn.cfg.port_range == 0)
-	    ice_cfg.turn.cfg.port_range = 
-				 (pj_uint16_t)(pjsua_var.ua_cfg.max_calls * 10);
+	    ice_cfg.turn.cfg.port_range = default_port_range(cfg->port);
     }
 
     /* Configure packet size for STUN and TURN sockets */
@@ -900,8 +912,8 @@ static pj_status_t create_ice_media_transports(pjsua_transport_config *cfg)
     unsigned i;
     pj_status_t status;
 
-    for (i=0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i < pjsua_var.call_table_size; ++i) {
+	pjsua_call *call = PJSUA_CALL(i);
 	unsigned strm_idx;
 
 	for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -916,8 +928,8 @@ static pj_status_t create_ice_media_transports(pjsua_transport_config *cfg)
     return PJ_SUCCESS;
 
 on_error:
-    for (i=0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i < pjsua_var.call_table_size; ++i) {
+	pjsua_call *call = PJSUA_CALL(i);
 	unsigned strm_idx;
 
 	for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -952,8 +964,8 @@ PJ_DEF(pj_status_t) pjsua_media_transports_create(
     PJSUA_LOCK();
 
     /* Delete existing media transports */
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i<pjsua_var.call_table_size; ++i) {
+	pjsua_call *call = PJSUA_CALL(i);
 	unsigned strm_idx;
 
 	for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -978,8 +990,8 @@ PJ_DEF(pj_status_t) pjsua_media_transports_create(
     }
 
     /* Set media transport auto_delete to True */
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i<pjsua_var.call_table_size; ++i) {
+	pjsua_call *call = PJSUA_CALL(i);
 	unsigned strm_idx;
 
 	for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -1002,12 +1014,24 @@ PJ_DEF(pj_status_t) pjsua_media_transports_attach(pjsua_media_transport tp[],
 						  pj_bool_t auto_delete)
 {
     unsigned i;
+    pj_status_t status;
 
     PJ_ASSERT_RETURN(tp && count==pjsua_var.ua_cfg.max_calls, PJ_EINVAL);
 
+    PJSUA_LOCK();
+
+    /* The calls are allocated on demand, make sure there is a call to
+     * assign each transport to.
+     */
+    status = pjsua_call_grow_table(count);
+    if (status != PJ_SUCCESS) {
+	PJSUA_UNLOCK();
+	return status;
+    }
+
     /* Assign the media transports */
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i<count; ++i) {
+	pjsua_call *call = PJSUA_CALL(i);
 	unsigned strm_idx;
 
 	for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -1026,6 +1050,8 @@ PJ_DEF(pj_status_t) pjsua_media_transports_attach(pjsua_media_transport tp[],
 	call->media[0].tp_auto_del = auto_delete;
     }
 
+    PJSUA_UNLOCK();
+
     return PJ_SUCCESS;
 }
 #endif
@@ -1220,7 +1246,7 @@ static pj_status_t call_media_init_cb(pjsua_call_media *call_med,
                                       int security_level,
                                       int *sip_err_code)
 {
-    pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+    pjsua_acc *acc = PJSUA_ACC(call_med->call->acc_id);
     pjmedia_transport_info tpinfo;
     int err_code = 0;
 
@@ -1379,7 +1405,7 @@ pj_status_t pjsua_call_media_init(pjsua_call_media *call_med,
 
         pjsua_set_media_tp_state(call_med, PJSUA_MED_TP_CREATING);
 
-	if (pjsua_var.acc[call_med->call->acc_id].cfg.ice_cfg.enable_ice) {
+	if (PJSUA_ACC(call_med->call->acc_id)->cfg.ice_cfg.enable_ice) {
 	    status = create_ice_media_transport(tcfg, call_med, async);
             if (async && status == PJ_EPENDING) {
 	        /* We will resume call media initialization in the
@@ -1418,7 +1444,7 @@ pj_status_t pjsua_call_media_init(pjsua_call_media *call_med,
 static pj_status_t media_channel_init_cb(pjsua_call_id call_id,
                                          const pjsua_med_tp_state_info *info)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
     pj_status_t status = (info? info->status : PJ_SUCCESS);
     unsigned mi;
 
@@ -1529,7 +1555,7 @@ on_return:
  */
 static void media_prov_clean_up(pjsua_call_id call_id, int idx)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
     unsigned i;
 
     if (call->med_prov_cnt > call->med_cnt) {
@@ -1584,8 +1610,8 @@ pj_status_t pjsua_media_channel_init(pjsua_call_id call_id,
 {
     const pj_str_t STR_AUDIO = { "audio", 5 };
     const pj_str_t STR_VIDEO = { "video", 5 };
-    pjsua_call *call = &pjsua_var.calls[call_id];
-    pjsua_acc *acc = &pjsua_var.acc[call->acc_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
+    pjsua_acc *acc = PJSUA_ACC(call->acc_id);
     pj_uint8_t maudidx[PJSUA_MAX_CALL_MEDIA];
     unsigned maudcnt = PJ_ARRAY_SIZE(maudidx);
     unsigned mtotaudcnt = PJ_ARRAY_SIZE(maudidx);
@@ -1904,7 +1930,7 @@ pj_status_t pjsua_media_channel_create_sdp(pjsua_call_id call_id,
     enum { MAX_MEDIA = PJSUA_MAX_CALL_MEDIA };
     pjmedia_sdp_session *sdp;
     pj_sockaddr origin;
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
     pjmedia_sdp_neg_state sdp_neg_state = PJMEDIA_SDP_NEG_STATE_NULL;
     unsigned mi;
     unsigned tot_bandw_tias = 0;
@@ -2037,7 +2063,7 @@ pj_status_t pjsua_media_channel_create_sdp(pjsua_call_id call_id,
 	    if (m->conn == NULL && sdp->conn == NULL) {
 		pj_bool_t use_ipv6;
 
-		use_ipv6 = (pjsua_var.acc[call->acc_id].cfg.ipv6_media_use !=
+		use_ipv6 = (PJSUA_ACC(call->acc_id)->cfg.ipv6_media_use !=
 			    PJSUA_IPV6_DISABLED);
 
 		m->conn = PJ_POOL_ZALLOC_T(pool, pjmedia_sdp_conn);
@@ -2160,8 +2186,8 @@ pj_status_t pjsua_media_channel_create_sdp(pjsua_call_id call_id,
      * media, i.e: secured and unsecured version, in the SDP offer.
      */
     if (!rem_sdp &&
-	pjsua_var.acc[call->acc_id].cfg.use_srtp == PJMEDIA_SRTP_OPTIONAL &&
-	pjsua_var.acc[call->acc_id].cfg.srtp_optional_dup_offer)
+	PJSUA_ACC(call->acc_id)->cfg.use_srtp == PJMEDIA_SRTP_OPTIONAL &&
+	PJSUA_ACC(call->acc_id)->cfg.srtp_optional_dup_offer)
     {
 	unsigned i;
 
@@ -2280,7 +2306,7 @@ static void stop_media_stream(pjsua_call *call, unsigned med_idx)
 
 static void stop_media_session(pjsua_call_id call_id)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
     unsigned mi;
 
     for (mi=0; mi<call->med_cnt; ++mi) {
@@ -2290,7 +2316,7 @@ static void stop_media_session(pjsua_call_id call_id)
 
 pj_status_t pjsua_media_channel_deinit(pjsua_call_id call_id)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
     unsigned mi;
 
     for (mi=0; mi<call->med_cnt; ++mi) {
@@ -2530,8 +2556,8 @@ pj_status_t pjsua_media_channel_update(pjsua_call_id call_id,
 				       const pjmedia_sdp_session *local_sdp,
 				       const pjmedia_sdp_session *remote_sdp)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
-    pjsua_acc *acc = &pjsua_var.acc[call->acc_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
+    pjsua_acc *acc = PJSUA_ACC(call->acc_id);
     pj_pool_t *tmp_pool = call->inv->pool_prov;
     unsigned mi;
     pj_bool_t got_media = PJ_FALSE;
@@ -3116,7 +3142,7 @@ pj_status_t pjsua_media_apply_xml_control(pjsua_call_id call_id,
 					  const pj_str_t *xml_st)
 {
 #if PJMEDIA_HAS_VIDEO
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = PJSUA_CALL(call_id);
     const pj_str_t PICT_FAST_UPDATE = {"picture_fast_update", 19};
 
     if (pj_strstr(xml_st, &PICT_FAST_UPDATE)) {
@@ -624,16 +624,16 @@ PJ_DEF(void) pjsua_pres_dump(pj_bool_t verbose)
 	
 	int count = 0;
 
-	for (acc_id=0; acc_id<PJ_ARRAY_SIZE(pjsua_var.acc); ++acc_id) {
+	for (acc_id=0; acc_id<pjsua_var.acc_table_size; ++acc_id) {
 
-	    if (!pjsua_var.acc[acc_id].valid)
+	    if (!PJSUA_ACC(acc_id)->valid)
 		continue;
 
-	    if (!pj_list_empty(&pjsua_var.acc[acc_id].pres_srv_list)) {
+	    if (!pj_list_empty(&PJSUA_ACC(acc_id)->pres_srv_list)) {
 		struct pjsua_srv_pres *uapres;
 
-		uapres = pjsua_var.acc[acc_id].pres_srv_list.next;
-		while (uapres != &pjsua_var.acc[acc_id].pres_srv_list) {
+		uapres = PJSUA_ACC(acc_id)->pres_srv_list.next;
+		while (uapres != &PJSUA_ACC(acc_id)->pres_srv_list) {
 		    ++count;
 		    uapres = uapres->next;
 		}
@@ -665,24 +665,24 @@ PJ_DEF(void) pjsua_pres_dump(pj_bool_t verbose)
      */
     PJ_LOG(3,(THIS_FILE, "Dumping pjsua server subscriptions:"));
 
-    for (acc_id=0; acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++acc_id) {
+    for (acc_id=0; acc_id<(int)pjsua_var.acc_table_size; ++acc_id) {
 
-	if (!pjsua_var.acc[acc_id].valid)
+	if (!PJSUA_ACC(acc_id)->valid)
 	    continue;
 
 	PJ_LOG(3,(THIS_FILE, "  %.*s",
-		  (int)pjsua_var.acc[acc_id].cfg.id.slen,
-		  pjsua_var.acc[acc_id].cfg.id.ptr));
+		  (int)PJSUA_ACC(acc_id)->cfg.id.slen,
+		  PJSUA_ACC(acc_id)->cfg.id.ptr));
 
-	if (pj_list_empty(&pjsua_var.acc[acc_id].pres_srv_list)) {
+	if (pj_list_empty(&PJSUA_ACC(acc_id)->pres_srv_list)) {
 
 	    PJ_LOG(3,(THIS_FILE, "  - none - "));
 
 	} else {
 	    struct pjsua_srv_pres *uapres;
 
-	    uapres = pjsua_var.acc[acc_id].pres_srv_list.next;
-	    while (uapres != &pjsua_var.acc[acc_id].pres_srv_list) {
+	    uapres = PJSUA_ACC(acc_id)->pres_srv_list.next;
+	    while (uapres != &PJSUA_ACC(acc_id)->pres_srv_list) {
 	    
 		PJ_LOG(3,(THIS_FILE, "    %10s %s",
 			  pjsip_evsub_get_state_name(uapres->sub),
@@ -827,7 +827,7 @@ static pj_bool_t pres_on_rx_request(pjsip_rx_data *rdata)
 
     /* Find which account for the incoming request. */
     acc_id = pjsua_acc_find_for_incoming(rdata);
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     PJ_LOG(4,(THIS_FILE, "Creating server subscription, using account %d",
 	      acc_id));
@@ -949,7 +949,7 @@ static pj_bool_t pres_on_rx_request(pjsip_rx_data *rdata)
     pjsip_evsub_set_mod_data(sub, pjsua_var.mod.id, uapres);
 
     /* Add server subscription to the list: */
-    pj_list_push_back(&pjsua_var.acc[acc_id].pres_srv_list, uapres);
+    pj_list_push_back(&PJSUA_ACC(acc_id)->pres_srv_list, uapres);
 
 
     /* Capture the value of Expires header. */
@@ -1059,10 +1059,10 @@ PJ_DEF(pj_status_t) pjsua_pres_notify( pjsua_acc_id acc_id,
     PJ_ASSERT_RETURN(acc_id!=-1 && srv_pres, PJ_EINVAL);
 
     /* Check that account ID is valid */
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id),
 		     PJ_EINVAL);
     /* Check that account is valid */
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id)->valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Acc %d: sending NOTIFY for srv_pres=0x%p..",
 	      acc_id, (int)(pj_ssize_t)srv_pres));
@@ -1070,7 +1070,7 @@ PJ_DEF(pj_status_t) pjsua_pres_notify( pjsua_acc_id acc_id,
 
     PJSUA_LOCK();
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     /* Check that the server presence subscription is still valid */
     if (pj_list_find_node(&acc->pres_srv_list, srv_pres) == NULL) {
@@ -1189,8 +1189,8 @@ static void publish_cb(struct pjsip_publishc_cbparam *param)
  */
 static pj_status_t send_publish(int acc_id, pj_bool_t active)
 {
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[acc_id].cfg;
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(acc_id)->cfg;
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
     pjsip_pres_status pres_status;
     pjsip_tx_data *tdata;
     pj_status_t status;
@@ -1303,8 +1303,8 @@ on_error:
 pj_status_t pjsua_pres_init_publish_acc(int acc_id)
 {
     const pj_str_t STR_PRESENCE = { "presence", 8 };
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[acc_id].cfg;
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(acc_id)->cfg;
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
     pj_status_t status;
 
     /* Create and init client publication session */
@@ -1356,7 +1356,7 @@ pj_status_t pjsua_pres_init_publish_acc(int acc_id)
 /* Init presence for account */
 pj_status_t pjsua_pres_init_acc(int acc_id)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
 
     /* Init presence subscription */
     pj_list_init(&acc->pres_srv_list);
@@ -1391,10 +1391,10 @@ void pjsua_pres_unpublish(pjsua_acc *acc, unsigned flags)
 /* Terminate server subscription for the account */
 void pjsua_pres_delete_acc(int acc_id, unsigned flags)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
     pjsua_srv_pres *uapres;
 
-    uapres = pjsua_var.acc[acc_id].pres_srv_list.next;
+    uapres = PJSUA_ACC(acc_id)->pres_srv_list.next;
 
     /* Notify all subscribers that we're no longer available */
     while (uapres != &acc->pres_srv_list) {
@@ -1408,7 +1408,7 @@ void pjsua_pres_delete_acc(int acc_id, unsigned flags)
 
 	pjsip_pres_get_status(uapres->sub, &pres_status);
 	
-	pres_status.info[0].basic_open = pjsua_var.acc[acc_id].online_status;
+	pres_status.info[0].basic_open = PJSUA_ACC(acc_id)->online_status;
 	pjsip_pres_set_status(uapres->sub, &pres_status);
 
 	if ((flags & PJSUA_DESTROY_NO_TX_MSG) == 0) {
@@ -1437,11 +1437,11 @@ void pjsua_pres_delete_acc(int acc_id, unsigned flags)
 /* Update server subscription (e.g. when our online status has changed) */
 void pjsua_pres_update_acc(int acc_id, pj_bool_t force)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[acc_id].cfg;
+    pjsua_acc *acc = PJSUA_ACC(acc_id);
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(acc_id)->cfg;
     pjsua_srv_pres *uapres;
 
-    uapres = pjsua_var.acc[acc_id].pres_srv_list.next;
+    uapres = PJSUA_ACC(acc_id)->pres_srv_list.next;
 
     while (uapres != &acc->pres_srv_list) {
 	
@@ -1782,7 +1782,7 @@ static void subscribe_buddy_presence(pjsua_buddy_id buddy_id)
     buddy = &pjsua_var.buddy[buddy_id];
     acc_id = pjsua_acc_find_for_outgoing(&buddy->uri);
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     PJ_LOG(4,(THIS_FILE, "Buddy %d: subscribing presence,using account %d..",
 	      buddy_id, acc_id));
@@ -2089,10 +2089,10 @@ pj_status_t pjsua_start_mwi(pjsua_acc_id acc_id, pj_bool_t force_renew)
     pjsip_tx_data *tdata;
     pj_status_t status = PJ_SUCCESS;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc)
-                     && pjsua_var.acc[acc_id].valid, PJ_EINVAL);
+    PJ_ASSERT_RETURN(PJSUA_ACC_ID_IS_VALID(acc_id)
+                     && PJSUA_ACC(acc_id)->valid, PJ_EINVAL);
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = PJSUA_ACC(acc_id);
 
     if (!acc->cfg.mwi_enabled || !acc->regc) {
 	if (acc->mwi_sub) {
@@ -2355,8 +2355,8 @@ static void pres_timer_cb(pj_timer_heap_t *th,
     entry->id = PJ_FALSE;
 
     /* Retry failed PUBLISH and MWI SUBSCRIBE requests */
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	pjsua_acc *acc = &pjsua_var.acc[i];
+    for (i=0; i<pjsua_var.acc_table_size; ++i) {
+	pjsua_acc *acc = PJSUA_ACC(i);
 
 	/* Acc may not be ready yet, otherwise assertion will happen */
 	if (!pjsua_acc_is_valid(i))
@@ -2447,8 +2447,8 @@ void pjsua_pres_shutdown(unsigned flags)
 	pjsua_var.pres_timer.id = PJ_FALSE;
     }
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	if (!pjsua_var.acc[i].valid)
+    for (i=0; i<pjsua_var.acc_table_size; ++i) {
+	if (!PJSUA_ACC(i)->valid)
 	    continue;
 	pjsua_pres_delete_acc(i, flags);
     }
@@ -2460,8 +2460,8 @@ void pjsua_pres_shutdown(unsigned flags)
     if ((flags & PJSUA_DESTROY_NO_TX_MSG) == 0) {
 	refresh_client_subscriptions();
 
-	for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (pjsua_var.acc[i].valid)
+	for (i=0; i<pjsua_var.acc_table_size; ++i) {
+	    if (PJSUA_ACC(i)->valid)
 		pjsua_pres_update_acc(i, PJ_FALSE);
 	}
     }
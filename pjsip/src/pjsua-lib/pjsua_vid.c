@@ -26,7 +26,7 @@
 #if PJSUA_HAS_VIDEO
 
 #define ENABLE_EVENT	    	1
-#define VID_TEE_MAX_PORT    	(PJSUA_MAX_CALLS + 1)
+#define VID_TEE_MAX_PORT    	(pjsua_var.ua_cfg.max_calls + 1)
 
 #define PJSUA_SHOW_WINDOW	1
 #define PJSUA_HIDE_WINDOW	0
@@ -707,7 +707,7 @@ static void dec_vid_win(pjsua_vid_win_id wid)
 /* Initialize video call media */
 pj_status_t pjsua_vid_channel_init(pjsua_call_media *call_med)
 {
-    pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+    pjsua_acc *acc = PJSUA_ACC(call_med->call->acc_id);
 
     call_med->strm.v.rdr_dev = acc->cfg.vid_rend_dev;
     call_med->strm.v.cap_dev = acc->cfg.vid_cap_dev;
@@ -738,7 +738,7 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
 				     const pjmedia_sdp_session *remote_sdp)
 {
     pjsua_call *call = call_med->call;
-    pjsua_acc  *acc  = &pjsua_var.acc[call->acc_id];
+    pjsua_acc  *acc  = PJSUA_ACC(call->acc_id);
     pjmedia_port *media_port;
     pj_status_t status;
  
@@ -778,7 +778,7 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
 
 #if defined(PJMEDIA_STREAM_ENABLE_KA) && PJMEDIA_STREAM_ENABLE_KA!=0
 	/* Enable/disable stream keep-alive and NAT hole punch. */
-	si->use_ka = pjsua_var.acc[call->acc_id].cfg.use_stream_ka;
+	si->use_ka = PJSUA_ACC(call->acc_id)->cfg.use_stream_ka;
 #endif
 
 	/* Try to get shared format ID between the capture device and 
@@ -891,7 +891,7 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
 	/* Setup encoding direction */
 	if (si->dir & PJMEDIA_DIR_ENCODING && !call->local_hold)
 	{
-            pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+            pjsua_acc *acc = PJSUA_ACC(call_med->call->acc_id);
 	    pjsua_vid_win *w;
 	    pjsua_vid_win_id wid;
 	    pj_bool_t just_created = PJ_FALSE;
@@ -1587,7 +1587,7 @@ static pj_status_t call_add_video(pjsua_call *call,
 				  pjmedia_dir dir)
 {
     pj_pool_t *pool = call->inv->pool_prov;
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[call->acc_id].cfg;
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(call->acc_id)->cfg;
     pjsua_call_media *call_med;
     const pjmedia_sdp_session *current_sdp;
     pjmedia_sdp_session *sdp;
@@ -1753,7 +1753,7 @@ static pj_status_t call_modify_video(pjsua_call *call,
     pj_assert(med_idx < (int)sdp->media_count);
 
     if (!remove) {
-	pjsua_acc_config *acc_cfg = &pjsua_var.acc[call->acc_id].cfg;
+	pjsua_acc_config *acc_cfg = &PJSUA_ACC(call->acc_id)->cfg;
 	pj_pool_t *pool = call->inv->pool_prov;
 	pjmedia_sdp_media *sdp_m;
 
@@ -1958,7 +1958,7 @@ static pj_status_t call_change_cap_dev(pjsua_call *call,
      */
     new_wid = vid_preview_get_win(cap_dev, PJ_FALSE);
     if (new_wid == PJSUA_INVALID_ID) {
-        pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+        pjsua_acc *acc = PJSUA_ACC(call_med->call->acc_id);
 
 	/* Create preview video window */
 	status = create_vid_win(PJSUA_WND_TYPE_PREVIEW,
@@ -2142,7 +2142,7 @@ PJ_DEF(pj_status_t) pjsua_call_set_vid_strm (
      * account default video capture device.
      */
     if (param_.cap_dev == PJMEDIA_VID_DEFAULT_CAPTURE_DEV) {
-	pjsua_acc_config *acc_cfg = &pjsua_var.acc[call->acc_id].cfg;
+	pjsua_acc_config *acc_cfg = &PJSUA_ACC(call->acc_id)->cfg;
 	param_.cap_dev = acc_cfg->vid_cap_dev;
 	
 	/* If the account default video capture device is
@@ -2203,8 +2203,11 @@ PJ_DEF(int) pjsua_call_get_vid_stream_idx(pjsua_call_id call_id)
     PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
 		     PJ_EINVAL);
 
+    if (!PJSUA_CALL_ID_IS_VALID(call_id))
+	return -1;
+
     PJSUA_LOCK();
-    call = &pjsua_var.calls[call_id];
+    call = PJSUA_CALL(call_id);
     call_get_vid_strm_info(call, &first_active, &first_inactive, NULL, NULL);
     PJSUA_UNLOCK();
 
@@ -2229,12 +2232,15 @@ PJ_DEF(pj_bool_t) pjsua_call_vid_stream_is_running( pjsua_call_id call_id,
     PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
 		     PJ_EINVAL);
 
+    if (!PJSUA_CALL_ID_IS_VALID(call_id))
+	return PJ_FALSE;
+
     /* Verify and normalize media index */
     if (med_idx == -1) {
 	med_idx = pjsua_call_get_vid_stream_idx(call_id);
     }
 
-    call = &pjsua_var.calls[call_id];
+    call = PJSUA_CALL(call_id);
     PJ_ASSERT_RETURN(med_idx >= 0 && med_idx < (int)call->med_cnt, PJ_EINVAL);
 
     call_med = &call->media[med_idx];
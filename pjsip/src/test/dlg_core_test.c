@@ -21,3 +21,224 @@
 #include "test.h"
 #include <pjsip.h>
 
+#include <pjlib.h>
+
+#define THIS_FILE   "dlg_core_test.c"
+
+/* Number of dialogs and lookup threads in the test */
+#define DLG_CNT		    64
+#define THREAD_CNT	    4
+
+#if defined(PJ_DEBUG) && PJ_DEBUG!=0
+#   define LOOKUP_CNT	    20000
+#else
+#   define LOOKUP_CNT	    200000
+#endif
+
+
+static pjsip_module mod_dlg_test =
+{
+    NULL, NULL,			    /* prev, next.		*/
+    { "mod-dlg-test", 12 },	    /* Name.			*/
+    -1,				    /* Id			*/
+};
+
+static pjsip_dialog *dlg[DLG_CNT];
+
+struct lookup_thread
+{
+    pj_thread_t	    *thread;
+    unsigned	     first;	    /* First dialog to look up	*/
+    unsigned	     cnt;	    /* Number of dialogs	*/
+    int		     rc;	    /* Result			*/
+};
+
+
+/*
+ * Repeatedly find the dialogs of the thread, with each lookup locking
+ * the dialog like an incoming in-dialog request does.
+ */
+static int lookup_thread_proc(void *arg)
+{
+    struct lookup_thread *lt = (struct lookup_thread*) arg;
+    unsigned i;
+
+    for (i=0; i<LOOKUP_CNT; ++i) {
+	pjsip_dialog *d = dlg[lt->first + i % lt->cnt];
+	pjsip_dialog *found;
+
+	found = pjsip_ua_find_dialog(&d->call_id->id, &d->local.info->tag,
+				     &d->remote.info->tag, PJ_TRUE);
+	if (found != d) {
+	    if (found)
+		pjsip_dlg_dec_lock(found);
+	    lt->rc = -10;
+	    return lt->rc;
+	}
+	pjsip_dlg_dec_lock(found);
+    }
+
+    return 0;
+}
+
+/*
+ * Look up the dialogs with the specified number of threads, each thread
+ * looking up its own subset of dialogs, and return the lookup rate.
+ */
+static int lookup_bench(pj_pool_t *pool, unsigned thread_cnt,
+			unsigned *p_rate)
+{
+    struct lookup_thread lt[THREAD_CNT];
+    pj_timestamp t1, t2;
+    pj_uint32_t msec;
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    pj_bzero(lt, sizeof(lt));
+
+    pj_get_timestamp(&t1);
+
+    for (i=0; i<thread_cnt; ++i) {
+	lt[i].first = i * (DLG_CNT / thread_cnt);
+	lt[i].cnt = DLG_CNT / thread_cnt;
+
+	status = pj_thread_create(pool, "dlgtest%p", &lookup_thread_proc,
+				  &lt[i], 0, 0, &lt[i].thread);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   error: unable to create thread", status);
+	    rc = -20;
+	    break;
+	}
+    }
+
+    for (i=0; i<thread_cnt; ++i) {
+	if (!lt[i].thread)
+	    continue;
+
+	pj_thread_join(lt[i].thread);
+	pj_thread_destroy(lt[i].thread);
+
+	if (lt[i].rc && !rc) {
+	    PJ_LOG(3,(THIS_FILE, "   error: dialog lookup mismatch in "
+				 "thread %d", i));
+	    rc = lt[i].rc;
+	}
+    }
+
+    pj_get_timestamp(&t2);
+
+    if (rc != 0)
+	return rc;
+
+    msec = pj_elapsed_msec(&t1, &t2);
+    if (msec == 0) msec = 1;
+
+    *p_rate = (unsigned)((pj_uint64_t)LOOKUP_CNT * thread_cnt * 1000 / msec);
+
+    PJ_LOG(3,(THIS_FILE, "    %d thread(s): %d lookups in %u msec, "
+			 "%u lookups/sec",
+	      thread_cnt, LOOKUP_CNT * thread_cnt, msec, *p_rate));
+
+    return 0;
+}
+
+int dlg_core_test(void)
+{
+    pj_str_t local = pj_str("<sip:alice@127.0.0.1>");
+    pj_str_t target = pj_str("sip:bob@127.0.0.1");
+    pj_str_t remote_tag = pj_str("no-such-tag");
+    pj_pool_t *pool;
+    unsigned i, created = 0, dlgset_cnt, rate1, rate;
+    pj_status_t status;
+    int rc = 0;
+
+    /* Init UA layer */
+    if (pjsip_ua_instance()->id == -1) {
+	pjsip_ua_init_param ua_param;
+	pj_bzero(&ua_param, sizeof(ua_param));
+	pjsip_ua_init_module(endpt, &ua_param);
+    }
+
+    pool = pjsip_endpt_create_pool(endpt, "dlgtest", 4000, 4000);
+    dlgset_cnt = pjsip_ua_get_dlg_set_count();
+
+    /* Create the dialogs. Each dialog has its own Call-ID and local tag,
+     * hence its own dialog set.
+     */
+    for (i=0; i<DLG_CNT; ++i) {
+	status = pjsip_dlg_create_uac(pjsip_ua_instance(), &local, NULL,
+				      &target, NULL, &dlg[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   error: unable to create dialog", status);
+	    rc = -30;
+	    goto on_return;
+	}
+
+	/* Keep the dialog alive until we're done */
+	pjsip_dlg_inc_session(dlg[i], &mod_dlg_test);
+	++created;
+    }
+
+    if (pjsip_ua_get_dlg_set_count() != dlgset_cnt + DLG_CNT) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting %d dialog sets, got %d",
+		  dlgset_cnt + DLG_CNT, pjsip_ua_get_dlg_set_count()));
+	rc = -40;
+	goto on_return;
+    }
+
+    /* Each dialog must be found by its own identification, and not
+     * with a different remote tag.
+     */
+    for (i=0; i<DLG_CNT; ++i) {
+	if (pjsip_ua_find_dialog(&dlg[i]->call_id->id,
+				 &dlg[i]->local.info->tag,
+				 &dlg[i]->remote.info->tag,
+				 PJ_FALSE) != dlg[i])
+	{
+	    PJ_LOG(3,(THIS_FILE, "   error: dialog %d not found", i));
+	    rc = -50;
+	    goto on_return;
+	}
+
+	if (pjsip_ua_find_dialog(&dlg[i]->call_id->id,
+				 &dlg[i]->local.info->tag,
+				 &remote_tag, PJ_FALSE) != NULL)
+	{
+	    PJ_LOG(3,(THIS_FILE, "   error: dialog found with wrong tag"));
+	    rc = -60;
+	    goto on_return;
+	}
+    }
+
+    /* Measure the lookup rate with single and multiple threads. Each
+     * thread looks up different dialogs, so with the dialog table sharded
+     * the threads should not contend with each other.
+     */
+    PJ_LOG(3,(THIS_FILE, "   dialog lookup benchmark (%d dialogs, %d "
+			 "shards):", DLG_CNT, PJSIP_UA_DLG_TABLE_SHARD_CNT));
+
+    rc = lookup_bench(pool, 1, &rate1);
+    if (rc != 0)
+	goto on_return;
+
+    rc = lookup_bench(pool, THREAD_CNT, &rate);
+    if (rc != 0)
+	goto on_return;
+
+    PJ_LOG(3,(THIS_FILE, "    %d threads rate is %d%% of single thread "
+			 "rate", THREAD_CNT,
+			 (int)((pj_uint64_t)rate * 100 / rate1)));
+
+on_return:
+    for (i=0; i<created; ++i)
+	pjsip_dlg_dec_session(dlg[i], &mod_dlg_test);
+
+    if (rc == 0 && pjsip_ua_get_dlg_set_count() != dlgset_cnt) {
+	PJ_LOG(3,(THIS_FILE, "   error: dialog sets are not unregistered"));
+	rc = -70;
+    }
+
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
@@ -33,6 +33,50 @@ static pj_bool_t verify_success(pjsip_msg *msg,
     return PJ_TRUE;
 }
 
+/* Invalid headers must be skipped, and the others parsed. */
+static pj_bool_t verify_skip_invalid_hdr(pjsip_msg *msg,
+					 pjsip_parser_err_report *err_list)
+{
+    const char *invalid_hdr[] = { "Max-Forwards", "CSeq", "Contact" };
+    pjsip_parser_err_report *e;
+    unsigned i;
+
+    if (!msg) {
+	PJ_LOG(3,(THIS_FILE, "   error: message is not parsed"));
+	return PJ_FALSE;
+    }
+
+    for (i=0, e=err_list->next; e!=err_list; ++i, e=e->next) {
+	if (i >= PJ_ARRAY_SIZE(invalid_hdr) ||
+	    pj_strcmp2(&e->hname, invalid_hdr[i]) != 0)
+	{
+	    PJ_LOG(3,(THIS_FILE, "   error: unexpected syntax error in %.*s",
+		      (int)e->hname.slen, e->hname.ptr));
+	    return PJ_FALSE;
+	}
+    }
+    if (i != PJ_ARRAY_SIZE(invalid_hdr)) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting %d syntax errors, got %d",
+		  (int)PJ_ARRAY_SIZE(invalid_hdr), i));
+	return PJ_FALSE;
+    }
+
+    if (pjsip_msg_find_hdr(msg, PJSIP_H_MAX_FORWARDS, NULL) ||
+	pjsip_msg_find_hdr(msg, PJSIP_H_CSEQ, NULL) ||
+	pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, NULL) ||
+	!pjsip_msg_find_hdr(msg, PJSIP_H_VIA, NULL) ||
+	!pjsip_msg_find_hdr(msg, PJSIP_H_FROM, NULL) ||
+	!pjsip_msg_find_hdr(msg, PJSIP_H_TO, NULL) ||
+	!pjsip_msg_find_hdr(msg, PJSIP_H_CALL_ID, NULL) ||
+	!pjsip_msg_find_hdr(msg, PJSIP_H_CONTENT_LENGTH, NULL))
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: invalid headers are not skipped"));
+	return PJ_FALSE;
+    }
+
+    return PJ_TRUE;
+}
+
 static struct test_entry
 {
     char	msg[1024];
@@ -66,14 +110,60 @@ static struct test_entry
 	"Via: SIP/2.0\r\n"
 	"\r\n",
 	&verify_success
+    },
+
+    /* Invalid headers between valid ones */
+    {
+	"INVITE sip:bob@example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK-err-test\r\n"
+	"Max-Forwards: seventy\r\n"
+	"From: <sip:alice@example.com>;tag=1234\r\n"
+	"To: <sip:bob@example.com>\r\n"
+	"CSeq: x INVITE\r\n"
+	"Call-ID: err-test@10.0.0.1\r\n"
+	"Contact: <sip:alice@10.0.0.1:5060\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n",
+	&verify_skip_invalid_hdr
     }
 };
 
 
+/* The rdata must not refer to the headers that fail to parse. */
+static int rdata_err_test(pj_pool_t *pool)
+{
+    struct test_entry *entry = &test_entries[PJ_ARRAY_SIZE(test_entries)-1];
+    pjsip_rx_data rdata;
+    pj_str_t buf;
+
+    pj_bzero(&rdata, sizeof(rdata));
+    rdata.tp_info.pool = pool;
+    pj_list_init(&rdata.msg_info.parse_err);
+
+    pj_strdup2_with_null(pool, &buf, entry->msg);
+    if (!pjsip_parse_rdata(buf.ptr, buf.slen, &rdata))
+	return -10;
+
+    if (rdata.msg_info.max_fwd || rdata.msg_info.cseq) {
+	PJ_LOG(3,(THIS_FILE, "   error: rdata refers to invalid header"));
+	return -20;
+    }
+
+    if (!rdata.msg_info.via || !rdata.msg_info.from || !rdata.msg_info.to ||
+	!rdata.msg_info.cid || !rdata.msg_info.clen)
+    {
+	return -30;
+    }
+
+    return 0;
+}
+
+
 int msg_err_test(void)
 {
     pj_pool_t *pool;
     unsigned i;
+    int rc = 0;
 
     PJ_LOG(3,(THIS_FILE, "Testing parsing error"));
 
@@ -81,11 +171,12 @@ int msg_err_test(void)
 
     for (i=0; i<PJ_ARRAY_SIZE(test_entries); ++i) {
 	pjsip_parser_err_report err_list, *e;
+	pjsip_msg *msg;
 
 	PJ_LOG(3,(THIS_FILE, "  Parsing msg %d", i));
 	pj_list_init(&err_list);
-	pjsip_parse_msg(pool, test_entries[i].msg,
-			strlen(test_entries[i].msg), &err_list);
+	msg = pjsip_parse_msg(pool, test_entries[i].msg,
+			      strlen(test_entries[i].msg), &err_list);
 
 	e = err_list.next;
 	while (e != &err_list) {
@@ -96,8 +187,16 @@ int msg_err_test(void)
 		      e->hname.ptr));
 	    e = e->next;
 	}
+
+	if (!(*test_entries[i].verify)(msg, &err_list)) {
+	    rc = -100 - i;
+	    goto on_return;
+	}
     }
 
+    rc = rdata_err_test(pool);
+
+on_return:
     pj_pool_release(pool);
-    return 0;
+    return rc;
 }
@@ -844,6 +844,293 @@ static pj_status_t simple_test(void)
 }
 
 
+/*
+ * Lazy header parsing test.
+ */
+static pj_status_t lazy_test(void)
+{
+    static char msgbuf[] =
+	"REGISTER sip:example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK-lazy-test\r\n"
+	"Max-Forwards: 70\r\n"
+	"From: <sip:alice@example.com>;tag=1234\r\n"
+	"To: <sip:alice@example.com>\r\n"
+	"Call-ID: lazy-test@10.0.0.1\r\n"
+	"CSeq: 1 REGISTER\r\n"
+	"Contact: <sip:alice@10.0.0.1:5060>;expires=60\r\n"
+	"m: <sip:alice@10.0.0.2:5060>\r\n"
+	"Expires:   120\r\n"
+	"X-Custom: some value\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n";
+    const pj_str_t STR_EXPIRES = { "Expires", 7 };
+    pj_bool_t old_lazy = pjsip_cfg()->endpt.lazy_hdr_parsing;
+    pjsip_rx_data rdata;
+    pj_pool_t *pool;
+    pjsip_msg *msg, *clone;
+    pjsip_hdr *hdr;
+    pjsip_contact_hdr *contact;
+    pjsip_expires_hdr *expires;
+    pjsip_sip_uri *uri;
+    char *buf, printbuf[1024];
+    pj_ssize_t len;
+    unsigned lazy_cnt;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  lazy header parsing test.."));
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+
+    /* The parser works on a copy since it may modify the buffer */
+    buf = (char*) pj_pool_alloc(pool, sizeof(msgbuf));
+    pj_memcpy(buf, msgbuf, sizeof(msgbuf));
+
+    pj_bzero(&rdata, sizeof(rdata));
+    rdata.tp_info.pool = pool;
+    pj_list_init(&rdata.msg_info.parse_err);
+
+    pjsip_cfg()->endpt.lazy_hdr_parsing = PJ_TRUE;
+    msg = pjsip_parse_rdata(buf, sizeof(msgbuf)-1, &rdata);
+    pjsip_cfg()->endpt.lazy_hdr_parsing = old_lazy;
+
+    if (!msg || !pj_list_empty(&rdata.msg_info.parse_err)) {
+	rc = -1100;
+	goto on_return;
+    }
+
+    /* Headers needed by the core must have been parsed */
+    if (!rdata.msg_info.via || !rdata.msg_info.cseq ||
+	!rdata.msg_info.from || !rdata.msg_info.to || !rdata.msg_info.cid ||
+	!rdata.msg_info.max_fwd || !rdata.msg_info.clen)
+    {
+	rc = -1110;
+	goto on_return;
+    }
+
+    /* Contact (twice) and Expires must have been left unparsed */
+    lazy_cnt = 0;
+    for (hdr=msg->hdr.next; hdr!=&msg->hdr; hdr=hdr->next) {
+	if (pjsip_hdr_is_lazy(hdr))
+	    ++lazy_cnt;
+    }
+    if (lazy_cnt != 3) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting 3 lazy headers, got %u",
+		  lazy_cnt));
+	rc = -1120;
+	goto on_return;
+    }
+
+    /* Unparsed headers must be printed as received */
+    len = pjsip_msg_print(msg, printbuf, sizeof(printbuf));
+    if (len < 1) {
+	rc = -1130;
+	goto on_return;
+    }
+    printbuf[len] = '\0';
+    if (!pj_ansi_strstr(printbuf, "\r\nm: <sip:alice@10.0.0.2:5060>\r\n") ||
+	!pj_ansi_strstr(printbuf, "\r\nExpires: 120\r\n"))
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: lazy headers not printed verbatim"));
+	rc = -1140;
+	goto on_return;
+    }
+
+    /* Clone while the headers are still unparsed */
+    clone = pjsip_msg_clone(pool, msg);
+
+    /* Lookups parse the headers they find. A loop over the header list
+     * which is at the parsed lazy header must still reach the next header.
+     */
+    for (hdr=msg->hdr.next; hdr!=&msg->hdr; hdr=hdr->next) {
+	if (pjsip_hdr_is_lazy(hdr) &&
+	    pj_stricmp(&hdr->name, &STR_EXPIRES) == 0)
+	{
+	    break;
+	}
+    }
+    if (hdr == &msg->hdr ||
+	pjsip_msg_find_hdr_by_name(msg, &STR_EXPIRES, NULL) == hdr ||
+	pj_strcmp2(&hdr->next->name, "X-Custom") != 0)
+    {
+	rc = -1145;
+	goto on_return;
+    }
+
+    contact = (pjsip_contact_hdr*)
+	      pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, NULL);
+    if (!contact || pjsip_hdr_is_lazy((pjsip_hdr*)contact) ||
+	contact->expires != 60)
+    {
+	rc = -1150;
+	goto on_return;
+    }
+    uri = (pjsip_sip_uri*) pjsip_uri_get_uri(contact->uri);
+    if (pj_strcmp2(&uri->host, "10.0.0.1") != 0 || uri->port != 5060) {
+	rc = -1160;
+	goto on_return;
+    }
+
+    /* The compact form must be found too */
+    contact = (pjsip_contact_hdr*)
+	      pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, contact->next);
+    if (!contact || pjsip_hdr_is_lazy((pjsip_hdr*)contact)) {
+	rc = -1170;
+	goto on_return;
+    }
+    uri = (pjsip_sip_uri*) pjsip_uri_get_uri(contact->uri);
+    if (pj_strcmp2(&uri->host, "10.0.0.2") != 0) {
+	rc = -1180;
+	goto on_return;
+    }
+
+    expires = (pjsip_expires_hdr*)
+	      pjsip_msg_find_hdr_by_name(msg, &STR_EXPIRES, NULL);
+    if (!expires || expires->type != PJSIP_H_EXPIRES || expires->ivalue != 120) {
+	rc = -1190;
+	goto on_return;
+    }
+
+    /* The clone must be usable independently */
+    if (!clone) {
+	rc = -1200;
+	goto on_return;
+    }
+    pjsip_msg_parse_lazy_hdrs(clone);
+    for (hdr=clone->hdr.next; hdr!=&clone->hdr; hdr=hdr->next) {
+	if (pjsip_hdr_is_lazy(hdr)) {
+	    rc = -1210;
+	    goto on_return;
+	}
+    }
+    expires = (pjsip_expires_hdr*)
+	      pjsip_msg_find_hdr(clone, PJSIP_H_EXPIRES, NULL);
+    if (!expires || expires->ivalue != 120) {
+	rc = -1220;
+	goto on_return;
+    }
+
+on_return:
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
+
+extern pj_bool_t pjsip_use_compact_form;
+
+/* Print the header to the buffer as NULL terminated string */
+static int print_hdr(void *hdr, char *buf, pj_size_t size)
+{
+    int len = pjsip_hdr_print_on(hdr, buf, size-1);
+    if (len >= 0)
+	buf[len] = '\0';
+    return len;
+}
+
+/*
+ * Pre-encoded header test.
+ */
+static pj_status_t encoded_hdr_test(void)
+{
+    const pj_str_t STR_CONTACT = { "Contact", 7 };
+    const pj_str_t STR_SUPPORTED = { "Supported", 9 };
+    pj_bool_t old_compact = pjsip_use_compact_form;
+    pj_pool_t *pool;
+    pjsip_contact_hdr *contact, *clone;
+    pjsip_hdr *hdr;
+    char *hvalue, orig[256], buf[256];
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  pre-encoded header test.."));
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+
+    hvalue = pj_pool_alloc(pool, 80);
+    pj_ansi_strcpy(hvalue, "<sip:alice@10.0.0.1:5060;transport=tcp>;expires=60");
+    contact = (pjsip_contact_hdr*)
+	      pjsip_parse_hdr(pool, &STR_CONTACT, hvalue, strlen(hvalue), NULL);
+    if (!contact) {
+	rc = -1300;
+	goto on_return;
+    }
+    if (print_hdr(contact, orig, sizeof(orig)) < 1) {
+	rc = -1310;
+	goto on_return;
+    }
+
+    /* Encoded header prints the same, and keeps its type */
+    if (pjsip_hdr_set_encoded(pool, (pjsip_hdr*)contact) != PJ_SUCCESS ||
+	!pjsip_hdr_is_encoded((pjsip_hdr*)contact) ||
+	contact->type != PJSIP_H_CONTACT)
+    {
+	rc = -1320;
+	goto on_return;
+    }
+    if (print_hdr(contact, buf, sizeof(buf)) < 1 || strcmp(buf, orig)) {
+	rc = -1330;
+	goto on_return;
+    }
+
+    /* Insufficient buffer */
+    if (pjsip_hdr_print_on(contact, buf, strlen(orig)) != -1) {
+	rc = -1340;
+	goto on_return;
+    }
+
+    /* Clones keep (and share) the encoding */
+    clone = (pjsip_contact_hdr*) pjsip_hdr_clone(pool, contact);
+    if (!pjsip_hdr_is_encoded((pjsip_hdr*)clone) || clone->expires != 60 ||
+	clone->vptr != contact->vptr ||
+	print_hdr(clone, buf, sizeof(buf)) < 1 || strcmp(buf, orig))
+    {
+	rc = -1350;
+	goto on_return;
+    }
+    clone = (pjsip_contact_hdr*) pjsip_hdr_shallow_clone(pool, contact);
+    if (!pjsip_hdr_is_encoded((pjsip_hdr*)clone) ||
+	print_hdr(clone, buf, sizeof(buf)) < 1 || strcmp(buf, orig))
+    {
+	rc = -1360;
+	goto on_return;
+    }
+
+    /* Modification after the encoding is cleared must be printed */
+    clone = (pjsip_contact_hdr*) pjsip_hdr_clone(pool, contact);
+    pjsip_hdr_clear_encoded((pjsip_hdr*)clone);
+    clone->expires = 30;
+    if (pjsip_hdr_is_encoded((pjsip_hdr*)clone) ||
+	print_hdr(clone, buf, sizeof(buf)) < 1 ||
+	!pj_ansi_strstr(buf, "expires=30"))
+    {
+	rc = -1370;
+	goto on_return;
+    }
+
+    /* Encoding is not used when the compact form setting is changed */
+    hvalue = pj_pool_alloc(pool, 40);
+    pj_ansi_strcpy(hvalue, "100rel, timer");
+    hdr = (pjsip_hdr*)
+	  pjsip_parse_hdr(pool, &STR_SUPPORTED, hvalue, strlen(hvalue), NULL);
+    if (!hdr) {
+	rc = -1380;
+	goto on_return;
+    }
+    pjsip_use_compact_form = PJ_FALSE;
+    pjsip_hdr_set_encoded(pool, hdr);
+    pjsip_use_compact_form = PJ_TRUE;
+    print_hdr(hdr, buf, sizeof(buf));
+    pjsip_use_compact_form = old_compact;
+    if (strcmp(buf, "k: 100rel, timer")) {
+	PJ_LOG(3,(THIS_FILE, "   error: got \"%s\"", buf));
+	rc = -1390;
+	goto on_return;
+    }
+
+on_return:
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
+
 #if INCLUDE_BENCHMARKS
 static int msg_benchmark(unsigned *p_detect, unsigned *p_parse, 
 			 unsigned *p_print)
@@ -919,6 +1206,67 @@ static int msg_benchmark(unsigned *p_detect, unsigned *p_parse,
     *p_print = (unsigned)avg_print;
     return status;
 }
+
+/* Benchmark parsing of message with invalid headers, where the parser
+ * needs to recover from syntax errors.
+ */
+static int msg_err_benchmark(unsigned *p_parse)
+{
+    static char msgbuf[] =
+	"INVITE sip:bob@example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK-err-bench\r\n"
+	"Max-Forwards: seventy\r\n"
+	"From: <sip:alice@example.com>;tag=1234\r\n"
+	"To: <sip:bob@example.com>\r\n"
+	"CSeq: x INVITE\r\n"
+	"Call-ID: err-bench@10.0.0.1\r\n"
+	"Contact: <sip:alice@10.0.0.1:5060\r\n"
+	"Expires: soon\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n";
+    pj_pool_t *pool;
+    pj_timestamp zero, t1, t2, parse_time;
+    pj_time_val elapsed;
+    pj_highprec_t avg_parse;
+    int loop;
+
+    zero.u64 = 0;
+    parse_time.u64 = 0;
+
+    for (loop=0; loop<LOOP; ++loop) {
+	pjsip_parser_err_report err_list;
+	pjsip_msg *msg;
+
+	pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+	pj_list_init(&err_list);
+
+	pj_get_timestamp(&t1);
+	msg = pjsip_parse_msg(pool, msgbuf, sizeof(msgbuf)-1, &err_list);
+	pj_get_timestamp(&t2);
+
+	pjsip_endpt_release_pool(endpt, pool);
+
+	if (msg == NULL) {
+	    PJ_LOG(3,(THIS_FILE, "   error: message is not parsed"));
+	    return -20;
+	}
+
+	pj_sub_timestamp(&t2, &t1);
+	pj_add_timestamp(&parse_time, &t2);
+    }
+
+    elapsed = pj_elapsed_time(&zero, &parse_time);
+    avg_parse = pj_elapsed_usec(&zero, &parse_time);
+    avg_parse = (pj_highprec_t)LOOP * 1000000 / avg_parse;
+
+    PJ_LOG(3,(THIS_FILE, 
+	      "    %d messages with invalid headers parsed in %d.%03ds "
+	      "(avg=%d msg parsing/sec)",
+	      LOOP, elapsed.sec, elapsed.msec, (unsigned)avg_parse));
+
+    *p_parse = (unsigned)avg_parse;
+    return PJ_SUCCESS;
+}
 #endif	/* INCLUDE_BENCHMARKS */
 
 /*****************************************************************************/
@@ -1994,6 +2342,7 @@ int msg_test(void)
 	unsigned detect;
 	unsigned parse;
 	unsigned print;
+	unsigned parse_err;
     } run[COUNT];
     unsigned i, max, avg_len;
     char desc[250];
@@ -2007,12 +2356,24 @@ int msg_test(void)
     if (status != PJ_SUCCESS)
 	return status;
 
+    status = lazy_test();
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = encoded_hdr_test();
+    if (status != PJ_SUCCESS)
+	return status;
+
 #if INCLUDE_BENCHMARKS
     for (i=0; i<COUNT; ++i) {
 	PJ_LOG(3,(THIS_FILE, "  benchmarking (%d of %d)..", i+1, COUNT));
 	status = msg_benchmark(&run[i].detect, &run[i].parse, &run[i].print);
 	if (status != PJ_SUCCESS)
 	    return status;
+
+	status = msg_err_benchmark(&run[i].parse_err);
+	if (status != PJ_SUCCESS)
+	    return status;
     }
 
     /* Calculate average message length */
@@ -2054,6 +2415,17 @@ int msg_test(void)
 		" worth of SIP messages that can be parsed per second). "
 		"The value is derived from msg-parse-per-sec above.");
 
+    /* Print maximum parse/sec of messages with invalid headers */
+    for (i=0, max=0; i<COUNT; ++i)
+	if (run[i].parse_err > max) max = run[i].parse_err;
+
+    PJ_LOG(3,("", "  Maximum invalid message parsing/sec=%u", max));
+
+    report_ival("msg-parse-err-per-sec", max, "msg/sec",
+		"Number of SIP messages with four invalid headers "
+		"can be <b>parsed</b> by <tt>pjsip_parse_msg()</tt> "
+		"per second, with the invalid headers skipped");
+
 
     /* Print maximum print/sec */
     for (i=0, max=0; i<COUNT; ++i)
@@ -78,9 +78,16 @@ void flush_events(unsigned duration)
     /* Process all events for the specified duration. */
     for (;;) {
 	pj_time_val timeout = {0, 1}, now;
+	unsigned i;
 
 	pjsip_endpt_handle_events(endpt, &timeout);
 
+	/* Poll the other event loops too */
+	for (i=1; i<pjsip_endpt_get_loop_count(endpt); ++i) {
+	    pj_time_val zero = {0, 0};
+	    pjsip_endpt_handle_loop_events(endpt, i, &zero, NULL);
+	}
+
 	pj_gettimeofday(&now);
 	if (PJ_TIME_VAL_GTE(now, stop_time))
 	    break;
@@ -365,6 +372,10 @@ int test_main(void)
     DO_TEST(inv_offer_answer_test());
 #endif
 
+#if INCLUDE_DLG_CORE_TEST
+    DO_TEST(dlg_core_test());
+#endif
+
 #if INCLUDE_REGC_TEST
     DO_TEST(regc_test());
 #endif
@@ -67,6 +67,7 @@ extern pj_caching_pool caching_pool;
 #define INCLUDE_TSX_TEST	INCLUDE_TSX_GROUP
 #define INCLUDE_TSX_DESTROY_TEST INCLUDE_TSX_GROUP
 #define INCLUDE_INV_OA_TEST	INCLUDE_INV_GROUP
+#define INCLUDE_DLG_CORE_TEST	INCLUDE_INV_GROUP
 #define INCLUDE_REGC_TEST	INCLUDE_REGC_GROUP
 
 
@@ -110,6 +111,9 @@ int transport_load_test(char *target_url);
 /* Invite session */
 int inv_offer_answer_test(void);
 
+/* Dialog */
+int dlg_core_test(void);
+
 /* Test main entry */
 int  test_main(void);
 
@@ -115,6 +115,612 @@ static int datagram_loop_test()
     return 0;
 }
 
+/*
+ * Overload control test. The endpoint is made permanently overloaded, then
+ * requests are sent to it over the loop transport.
+ */
+#define OVL_CALL_ID	"overload-test-call-id"
+#define OVL_TARGET	"sip:bob@130.0.0.1;transport=loop-dgram"
+
+static pj_bool_t ovl_on_rx_request(pjsip_rx_data *rdata);
+static pj_bool_t ovl_on_rx_response(pjsip_rx_data *rdata);
+
+static pjsip_module ovl_module =
+{
+    NULL, NULL,				/* prev and next	*/
+    { "Overload-Test", 13},		/* Name.		*/
+    -1,					/* Id			*/
+    PJSIP_MOD_PRIORITY_APPLICATION,	/* Priority		*/
+    NULL,				/* load()		*/
+    NULL,				/* start()		*/
+    NULL,				/* stop()		*/
+    NULL,				/* unload()		*/
+    &ovl_on_rx_request,			/* on_rx_request()	*/
+    &ovl_on_rx_response,		/* on_rx_response()	*/
+    NULL,				/* on_tsx_state()	*/
+};
+
+static struct
+{
+    int		req_cnt;
+    int		res_code;
+    int		retry_after;
+} ovl_recv;
+
+static pj_bool_t ovl_on_rx_request(pjsip_rx_data *rdata)
+{
+    if (pj_strcmp2(&rdata->msg_info.cid->id, OVL_CALL_ID) != 0)
+	return PJ_FALSE;
+
+    ++ovl_recv.req_cnt;
+    return PJ_TRUE;
+}
+
+static pj_bool_t ovl_on_rx_response(pjsip_rx_data *rdata)
+{
+    pjsip_retry_after_hdr *hdr;
+
+    if (pj_strcmp2(&rdata->msg_info.cid->id, OVL_CALL_ID) != 0)
+	return PJ_FALSE;
+
+    ovl_recv.res_code = rdata->msg_info.msg->line.status.code;
+    hdr = (pjsip_retry_after_hdr*)
+	  pjsip_msg_find_hdr(rdata->msg_info.msg, PJSIP_H_RETRY_AFTER, NULL);
+    if (hdr)
+	ovl_recv.retry_after = (int)hdr->ivalue;
+    return PJ_TRUE;
+}
+
+/* Send request with the specified method and To tag, and wait until it or
+ * its response is received. If expect_drop is set, the request is expected
+ * to be dropped, so only wait briefly and fail if anything is received.
+ */
+static int ovl_send_request2(pjsip_method_e method_id, const char *to_tag,
+			     pj_bool_t expect_drop)
+{
+    pj_str_t target, from, to, call_id;
+    pjsip_method method;
+    pjsip_tx_data *tdata;
+    pj_time_val timeout;
+    pj_status_t status;
+
+    target = pj_str(OVL_TARGET);
+    from = pj_str("<sip:alice@130.0.0.1>");
+    to = pj_str(OVL_TARGET);
+    call_id = pj_str(OVL_CALL_ID);
+
+    pjsip_method_set(&method, method_id);
+    status = pjsip_endpt_create_request(endpt, &method, &target, &from, &to,
+					NULL, &call_id, -1, NULL, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create request", status);
+	return -1;
+    }
+
+    if (to_tag) {
+	pjsip_to_hdr *to_hdr = PJSIP_MSG_TO_HDR(tdata->msg);
+	pj_strdup2(tdata->pool, &to_hdr->tag, to_tag);
+    }
+
+    pj_bzero(&ovl_recv, sizeof(ovl_recv));
+
+    status = pjsip_endpt_send_request_stateless(endpt, tdata, NULL, NULL);
+    if (status != PJ_SUCCESS) {
+	pjsip_tx_data_dec_ref(tdata);
+	app_perror("   error: unable to send request", status);
+	return -2;
+    }
+
+    pj_gettimeofday(&timeout);
+    if (expect_drop)
+	timeout.msec += 200;
+    else
+	timeout.sec += 2;
+    pj_time_val_normalize(&timeout);
+
+    while (ovl_recv.req_cnt == 0 && ovl_recv.res_code == 0) {
+	pj_time_val now;
+	pj_time_val poll_interval = { 0, 10 };
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout)) {
+	    if (expect_drop)
+		return 0;
+
+	    PJ_LOG(3,(THIS_FILE, "   error: timeout waiting for message"));
+	    return -3;
+	}
+
+	pjsip_endpt_handle_events(endpt, &poll_interval);
+    }
+
+    if (expect_drop) {
+	PJ_LOG(3,(THIS_FILE, "   error: request is not dropped"));
+	return -4;
+    }
+
+    return 0;
+}
+
+static int ovl_send_request(pjsip_method_e method_id, const char *to_tag)
+{
+    return ovl_send_request2(method_id, to_tag, PJ_FALSE);
+}
+
+static int overload_test(void)
+{
+    pjsip_overload_cfg cfg;
+    pjsip_overload_stat stat;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  overload control test"));
+
+    status = pjsip_endpt_register_module(endpt, &ovl_module);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to register module", status);
+	return -100;
+    }
+
+    /* The request being processed is always pending, so the endpoint is
+     * overloaded on every request.
+     */
+    pjsip_overload_cfg_default(&cfg);
+    cfg.max_rx_pending = 1;
+    cfg.max_latency = 0;
+    cfg.max_tsx_cnt = 0;
+    cfg.retry_after = 7;
+    status = pjsip_overload_init_module(endpt, &cfg);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to init overload module", status);
+	pjsip_endpt_unregister_module(endpt, &ovl_module);
+	return -110;
+    }
+
+    /* New INVITE must be rejected */
+    if (ovl_send_request(PJSIP_INVITE_METHOD, NULL) != 0) {
+	rc = -120; goto on_return;
+    }
+    if (ovl_recv.res_code != 503 || ovl_recv.retry_after != 7) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting 503 with Retry-After 7, "
+		  "got %d with Retry-After %d", ovl_recv.res_code,
+		  ovl_recv.retry_after));
+	rc = -130; goto on_return;
+    }
+
+    /* In-dialog request and BYE must pass */
+    if (ovl_send_request(PJSIP_INVITE_METHOD, "dlg-tag") != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -140; goto on_return;
+    }
+    if (ovl_send_request(PJSIP_BYE_METHOD, NULL) != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -150; goto on_return;
+    }
+
+    /* Request which doesn't create a dialog must pass by default */
+    if (ovl_send_request(PJSIP_OPTIONS_METHOD, NULL) != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -155; goto on_return;
+    }
+
+    status = pjsip_overload_get_stat(&stat);
+    if (status != PJ_SUCCESS || !stat.overloaded || stat.rejected_cnt != 1 ||
+	stat.overload_cnt != 1)
+    {
+	rc = -160; goto on_return;
+    }
+
+    /* Unless every request is to be rejected */
+    cfg.reject_all = PJ_TRUE;
+    pjsip_overload_set_cfg(&cfg);
+
+    if (ovl_send_request(PJSIP_OPTIONS_METHOD, NULL) != 0 ||
+	ovl_recv.res_code != 503)
+    {
+	rc = -165; goto on_return;
+    }
+
+    /* Remove the limit, the request must pass */
+    cfg.max_rx_pending = 0;
+    pjsip_overload_set_cfg(&cfg);
+
+    if (ovl_send_request(PJSIP_OPTIONS_METHOD, NULL) != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -170; goto on_return;
+    }
+
+    status = pjsip_overload_get_stat(&stat);
+    if (status != PJ_SUCCESS || stat.overloaded || stat.rejected_cnt != 2) {
+	rc = -180; goto on_return;
+    }
+
+on_return:
+    pjsip_endpt_unregister_module(endpt, pjsip_overload_instance());
+    pjsip_endpt_unregister_module(endpt, &ovl_module);
+    return rc;
+}
+
+/*
+ * Requests with several Call-IDs are sent while the receive queue pins
+ * the messages to the workers by Call-ID. The worker which processes each
+ * Call-ID is recorded, and all requests of the same Call-ID must be
+ * processed by the same worker.
+ */
+#define PIN_CALL_ID	"pin-test-call-id-"
+#define PIN_CALL_CNT	8
+#define PIN_ROUND_CNT	4
+
+static pj_bool_t pin_on_rx_request(pjsip_rx_data *rdata);
+
+static pjsip_module pin_module =
+{
+    NULL, NULL,				/* prev and next	*/
+    { "Pin-Test", 8},			/* Name.		*/
+    -1,					/* Id			*/
+    PJSIP_MOD_PRIORITY_APPLICATION,	/* Priority		*/
+    NULL,				/* load()		*/
+    NULL,				/* start()		*/
+    NULL,				/* stop()		*/
+    NULL,				/* unload()		*/
+    &pin_on_rx_request,			/* on_rx_request()	*/
+    NULL,				/* on_rx_response()	*/
+    NULL,				/* on_tsx_state()	*/
+};
+
+static struct
+{
+    pj_mutex_t	*mutex;
+    pj_thread_t	*worker[PIN_CALL_CNT];
+    int		 rx_cnt;
+    int		 mismatch_cnt;
+} pin_recv;
+
+static pj_bool_t pin_on_rx_request(pjsip_rx_data *rdata)
+{
+    const pj_str_t *call_id = &rdata->msg_info.cid->id;
+    pj_thread_t *this_thread = pj_thread_this();
+    int idx;
+
+    if (call_id->slen <= (int)sizeof(PIN_CALL_ID)-1 ||
+	pj_ansi_strncmp(call_id->ptr, PIN_CALL_ID, sizeof(PIN_CALL_ID)-1))
+    {
+	return PJ_FALSE;
+    }
+
+    idx = call_id->ptr[sizeof(PIN_CALL_ID)-1] - '0';
+    if (idx < 0 || idx >= PIN_CALL_CNT)
+	return PJ_FALSE;
+
+    pj_mutex_lock(pin_recv.mutex);
+    if (pin_recv.worker[idx] == NULL)
+	pin_recv.worker[idx] = this_thread;
+    else if (pin_recv.worker[idx] != this_thread)
+	++pin_recv.mismatch_cnt;
+    ++pin_recv.rx_cnt;
+    pj_mutex_unlock(pin_recv.mutex);
+
+    return PJ_TRUE;
+}
+
+static int pin_test(void)
+{
+    pj_pool_t *pool;
+    pj_time_val timeout;
+    pj_status_t status;
+    int i, j, worker_cnt, rc = 0;
+
+    pool = pjsip_endpt_create_pool(endpt, "pintest", 512, 512);
+    if (!pool)
+	return -400;
+
+    pj_bzero(&pin_recv, sizeof(pin_recv));
+    status = pj_mutex_create_simple(pool, "pintest", &pin_recv.mutex);
+    if (status != PJ_SUCCESS) {
+	pjsip_endpt_release_pool(endpt, pool);
+	return -405;
+    }
+
+    status = pjsip_endpt_register_module(endpt, &pin_module);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to register module", status);
+	rc = -410; goto on_return;
+    }
+
+    for (i=0; i<PIN_ROUND_CNT && rc == 0; ++i) {
+	for (j=0; j<PIN_CALL_CNT; ++j) {
+	    pj_str_t target, from, to, call_id;
+	    char call_id_buf[32];
+	    pjsip_tx_data *tdata;
+
+	    target = pj_str(OVL_TARGET);
+	    from = pj_str("<sip:alice@130.0.0.1>");
+	    to = pj_str(OVL_TARGET);
+	    pj_ansi_snprintf(call_id_buf, sizeof(call_id_buf), "%s%d",
+			     PIN_CALL_ID, j);
+	    call_id = pj_str(call_id_buf);
+
+	    status = pjsip_endpt_create_request(endpt,
+						&pjsip_options_method,
+						&target, &from, &to, NULL,
+						&call_id, -1, NULL, &tdata);
+	    if (status == PJ_SUCCESS) {
+		status = pjsip_endpt_send_request_stateless(endpt, tdata,
+							    NULL, NULL);
+		if (status != PJ_SUCCESS)
+		    pjsip_tx_data_dec_ref(tdata);
+	    }
+	    if (status != PJ_SUCCESS) {
+		app_perror("   error: unable to send request", status);
+		rc = -420;
+		break;
+	    }
+	}
+    }
+
+    pj_gettimeofday(&timeout);
+    timeout.sec += 5;
+
+    while (rc == 0 && pin_recv.rx_cnt < PIN_CALL_CNT * PIN_ROUND_CNT) {
+	pj_time_val now;
+	pj_time_val poll_interval = { 0, 10 };
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout)) {
+	    PJ_LOG(3,(THIS_FILE, "   error: received %d of %d requests",
+		      pin_recv.rx_cnt, PIN_CALL_CNT * PIN_ROUND_CNT));
+	    rc = -430;
+	    break;
+	}
+
+	pjsip_endpt_handle_events(endpt, &poll_interval);
+    }
+
+    if (rc == 0 && pin_recv.mismatch_cnt != 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: %d request(s) were processed by "
+		  "a different worker than earlier requests with the same "
+		  "Call-ID", pin_recv.mismatch_cnt));
+	rc = -440;
+    }
+
+    /* Also make sure that the requests are processed by the workers */
+    for (i=0, worker_cnt=0; rc == 0 && i<PIN_CALL_CNT; ++i) {
+	for (j=0; j<i && pin_recv.worker[j] != pin_recv.worker[i]; ++j)
+	    ;
+	if (j == i)
+	    ++worker_cnt;
+	if (pin_recv.worker[i] == pj_thread_this()) {
+	    PJ_LOG(3,(THIS_FILE, "   error: request is not processed by "
+		      "a worker"));
+	    rc = -450;
+	}
+    }
+    if (rc == 0) {
+	PJ_LOG(3,(THIS_FILE, "   %d Call-IDs were processed by %d worker(s)",
+		  PIN_CALL_CNT, worker_cnt));
+    }
+
+    pjsip_endpt_unregister_module(endpt, &pin_module);
+
+on_return:
+    pj_mutex_destroy(pin_recv.mutex);
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
+/*
+ * Receive queue test. Messages received by the loop transport are parsed
+ * and dispatched by the worker threads of the receive queue.
+ */
+static int rx_queue_test(void)
+{
+    pjsip_tpmgr *tpmgr = pjsip_endpt_get_tpmgr(endpt);
+    pjsip_rx_queue_cfg cfg;
+    pjsip_rx_queue_stat stat;
+    pjsip_transport *loop;
+    pj_sockaddr_in addr;
+    int rtt, pkt_lost;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  receive queue test"));
+
+    status = pjsip_endpt_acquire_transport(endpt, PJSIP_TRANSPORT_LOOP_DGRAM,
+					   &addr, sizeof(addr), NULL, &loop);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: loop transport is not configured", status);
+	return -200;
+    }
+
+    status = pjsip_endpt_register_module(endpt, &ovl_module);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to register module", status);
+	pjsip_transport_dec_ref(loop);
+	return -210;
+    }
+
+    pjsip_rx_queue_cfg_default(&cfg);
+    cfg.worker_cnt = 2;
+    status = pjsip_tpmgr_start_rx_queue(tpmgr, &cfg);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to start receive queue", status);
+	rc = -220; goto on_return;
+    }
+
+    status = transport_send_recv_test(PJSIP_TRANSPORT_LOOP_DGRAM, loop,
+				      OVL_TARGET, &rtt);
+    if (status != 0) {
+	rc = status; goto on_return;
+    }
+
+    status = transport_rt_test(PJSIP_TRANSPORT_LOOP_DGRAM, loop,
+			       OVL_TARGET, &pkt_lost);
+    if (status != 0) {
+	rc = status; goto on_return;
+    }
+    if (pkt_lost != 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: %d packet(s) was lost", pkt_lost));
+	rc = -230; goto on_return;
+    }
+
+    /* In-dialog request */
+    if (ovl_send_request(PJSIP_OPTIONS_METHOD, "dlg-tag") != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -240; goto on_return;
+    }
+
+    status = pjsip_tpmgr_get_rx_queue_stat(tpmgr, &stat);
+    if (status != PJ_SUCCESS) {
+	rc = -250; goto on_return;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "   queued: high=%u dialog=%u new=%u, max length=%u",
+	      stat.queued_cnt[PJSIP_RX_QUEUE_PRIO_HIGH],
+	      stat.queued_cnt[PJSIP_RX_QUEUE_PRIO_DIALOG],
+	      stat.queued_cnt[PJSIP_RX_QUEUE_PRIO_NEW], stat.max_len));
+
+    /* Responses are high priority, OPTIONS requests are new requests */
+    if (stat.queued_cnt[PJSIP_RX_QUEUE_PRIO_HIGH] == 0 ||
+	stat.queued_cnt[PJSIP_RX_QUEUE_PRIO_DIALOG] != 1 ||
+	stat.queued_cnt[PJSIP_RX_QUEUE_PRIO_NEW] == 0 ||
+	stat.dropped_cnt[PJSIP_RX_QUEUE_PRIO_HIGH] != 0)
+    {
+	rc = -260; goto on_return;
+    }
+
+    /* Messages are processed by the transport again after stopping */
+    pjsip_tpmgr_stop_rx_queue(tpmgr);
+
+    status = transport_send_recv_test(PJSIP_TRANSPORT_LOOP_DGRAM, loop,
+				      OVL_TARGET, &rtt);
+    if (status != 0) {
+	rc = status; goto on_return;
+    }
+
+    status = pjsip_tpmgr_get_rx_queue_stat(tpmgr, &stat);
+    if (status != PJ_SUCCESS || stat.len != 0 ||
+	stat.queued_cnt[PJSIP_RX_QUEUE_PRIO_DIALOG] != 1)
+    {
+	rc = -270; goto on_return;
+    }
+
+    /* Messages pinned to the workers by Call-ID */
+    cfg.worker_cnt = 3;
+    cfg.pin_call_id = PJ_TRUE;
+    status = pjsip_tpmgr_start_rx_queue(tpmgr, &cfg);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to start receive queue", status);
+	rc = -280; goto on_return;
+    }
+
+    status = transport_rt_test(PJSIP_TRANSPORT_LOOP_DGRAM, loop,
+			       OVL_TARGET, &pkt_lost);
+    if (status != 0) {
+	rc = status; goto on_return;
+    }
+    if (pkt_lost != 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: %d packet(s) was lost", pkt_lost));
+	rc = -290; goto on_return;
+    }
+
+    if (ovl_send_request(PJSIP_OPTIONS_METHOD, "dlg-tag") != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -295; goto on_return;
+    }
+
+    rc = pin_test();
+
+on_return:
+    pjsip_tpmgr_stop_rx_queue(tpmgr);
+    pjsip_endpt_unregister_module(endpt, &ovl_module);
+    pjsip_transport_dec_ref(loop);
+    return rc;
+}
+
+/*
+ * Rate limiting test. All messages of the loop transport come from the
+ * same source.
+ */
+static int rate_limit_test(void)
+{
+    pjsip_tpmgr *tpmgr = pjsip_endpt_get_tpmgr(endpt);
+    pjsip_rate_limit_cfg cfg;
+    pjsip_rate_limit_stat stat;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  rate limit test"));
+
+    status = pjsip_endpt_register_module(endpt, &ovl_module);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to register module", status);
+	return -300;
+    }
+
+    /* Two OPTIONS may arrive at once, and one more per second */
+    pjsip_rate_limit_cfg_default(&cfg);
+    cfg.all.rate = 1000;
+    cfg.all.burst = 1000;
+    cfg.method_cnt = 1;
+    cfg.method[0].method = pj_str("OPTIONS");
+    cfg.method[0].rate = 1;
+    cfg.method[0].burst = 2;
+    status = pjsip_tpmgr_set_rate_limit(tpmgr, &cfg);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to set rate limit", status);
+	rc = -310; goto on_return;
+    }
+
+    if (ovl_send_request(PJSIP_OPTIONS_METHOD, NULL) != 0 ||
+	ovl_recv.req_cnt != 1 ||
+	ovl_send_request(PJSIP_OPTIONS_METHOD, NULL) != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -320; goto on_return;
+    }
+
+    /* The third one must be dropped */
+    if (ovl_send_request2(PJSIP_OPTIONS_METHOD, NULL, PJ_TRUE) != 0) {
+	rc = -330; goto on_return;
+    }
+
+    /* Other methods have their own budget */
+    if (ovl_send_request(PJSIP_INVITE_METHOD, NULL) != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -340; goto on_return;
+    }
+
+    status = pjsip_tpmgr_get_rate_limit_stat(tpmgr, &stat);
+    if (status != PJ_SUCCESS || stat.source_cnt != 1 ||
+	stat.passed_cnt != 3 || stat.dropped_cnt != 1 ||
+	stat.method_dropped_cnt[0] != 1)
+    {
+	rc = -350; goto on_return;
+    }
+
+    pjsip_tpmgr_dump_transports(tpmgr);
+
+    /* Disabled */
+    pjsip_tpmgr_set_rate_limit(tpmgr, NULL);
+    if (ovl_send_request(PJSIP_OPTIONS_METHOD, NULL) != 0 ||
+	ovl_recv.req_cnt != 1)
+    {
+	rc = -360; goto on_return;
+    }
+
+on_return:
+    pjsip_tpmgr_set_rate_limit(tpmgr, NULL);
+    pjsip_endpt_unregister_module(endpt, &ovl_module);
+    return rc;
+}
+
 int transport_loop_test(void)
 {
     int status;
@@ -123,5 +729,17 @@ int transport_loop_test(void)
     if (status != 0)
 	return status;
 
+    status = overload_test();
+    if (status != 0)
+	return status;
+
+    status = rx_queue_test();
+    if (status != 0)
+	return status;
+
+    status = rate_limit_test();
+    if (status != 0)
+	return status;
+
     return 0;
 }
@@ -29,6 +29,89 @@
  * TCP transport test.
  */
 #if PJ_HAS_TCP
+
+/*
+ * TCP listener with several SO_REUSEPORT sockets. Connections to the
+ * listener are spread among the sockets, and all of them must be accepted.
+ */
+static int transport_tcp_reuseport_test(void)
+{
+    enum { CLIENT_CNT = 16 };
+    pjsip_tcp_transport_cfg cfg;
+    pjsip_tpmgr *tpmgr = pjsip_endpt_get_tpmgr(endpt);
+    pjsip_tpfactory *tpfactory;
+    pj_sock_t client[CLIENT_CNT];
+    pj_sockaddr addr;
+    unsigned tp_cnt;
+    pj_str_t s;
+    pj_status_t status;
+    int i, rc = 0;
+
+    if (pj_SO_REUSEPORT() == 0xFFFF) {
+	PJ_LOG(3,(THIS_FILE, "   SO_REUSEPORT is not supported, skipping "
+		  "SO_REUSEPORT test"));
+	return 0;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "   SO_REUSEPORT test"));
+
+    pjsip_tcp_transport_cfg_default(&cfg, pj_AF_INET());
+    pj_sockaddr_init(pj_AF_INET(), &cfg.bind_addr, pj_cstr(&s, "127.0.0.1"),
+		     0);
+    cfg.sock_cnt = 4;
+
+    status = pjsip_tcp_transport_start3(endpt, &cfg, &tpfactory);
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: unable to start TCP transport", status);
+	return -200;
+    }
+
+    tp_cnt = pjsip_tpmgr_get_transport_count(tpmgr);
+
+    /* Each accepted connection becomes a transport */
+    pj_sockaddr_cp(&addr, &tpfactory->local_addr);
+    for (i=0; i<CLIENT_CNT; ++i) {
+	client[i] = PJ_INVALID_SOCKET;
+	status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0,
+				&client[i]);
+	if (status == PJ_SUCCESS)
+	    status = pj_sock_connect(client[i], &addr,
+				     pj_sockaddr_get_len(&addr));
+	if (status != PJ_SUCCESS) {
+	    app_perror("   Error: unable to connect to listener", status);
+	    rc = -210;
+	    ++i;
+	    break;
+	}
+    }
+
+    flush_events(500);
+
+    if (rc == 0 &&
+	pjsip_tpmgr_get_transport_count(tpmgr) != tp_cnt + CLIENT_CNT)
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: accepted %d of %d connections",
+		  pjsip_tpmgr_get_transport_count(tpmgr) - tp_cnt,
+		  CLIENT_CNT));
+	rc = -220;
+    }
+
+    while (i-- > 0) {
+	if (client[i] != PJ_INVALID_SOCKET)
+	    pj_sock_close(client[i]);
+    }
+
+    /* Destroy the listener */
+    status = (*tpfactory->destroy)(tpfactory);
+    if (status != PJ_SUCCESS && rc == 0)
+	rc = -230;
+
+    flush_events(500);
+
+    return rc;
+}
+
+
 int transport_tcp_test(void)
 {
     enum { SEND_RECV_LOOP = 8 };
@@ -122,6 +205,28 @@ int transport_tcp_test(void)
     if (pkt_lost != 0)
 	PJ_LOG(3,(THIS_FILE, "   note: %d packet(s) was lost", pkt_lost));
 
+    /* Check the transmit statistics */
+    if (PJSIP_TCP_TX_COALESCE_SIZE > 0) {
+	pjsip_tp_tx_stat tx_stat;
+
+	status = pjsip_tcp_transport_get_tx_stat(tcp, &tx_stat);
+	if (status != PJ_SUCCESS) {
+	    pjsip_transport_dec_ref(tcp);
+	    return -76;
+	}
+
+	PJ_LOG(3,(THIS_FILE, "   tx: %u messages in %u writes, max %u/write",
+		  tx_stat.msg_cnt, tx_stat.write_cnt, tx_stat.max_msg_cnt));
+
+	if (tx_stat.write_cnt == 0 || tx_stat.msg_cnt < tx_stat.write_cnt ||
+	    tx_stat.max_msg_cnt == 0 ||
+	    tx_stat.msg_cnt > tx_stat.write_cnt * tx_stat.max_msg_cnt)
+	{
+	    pjsip_transport_dec_ref(tcp);
+	    return -78;
+	}
+    }
+
     /* Check again that reference counter is still 1. */
     if (pj_atomic_get(tcp->ref_cnt) != 1)
 	return -80;
@@ -144,6 +249,10 @@ int transport_tcp_test(void)
     PJ_LOG(3,(THIS_FILE, "   Flushing events, 1 second..."));
     flush_events(1000);
 
+    status = transport_tcp_reuseport_test();
+    if (status != 0)
+	return status;
+
     /* Done */
     return 0;
 }
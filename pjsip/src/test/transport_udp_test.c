@@ -25,6 +25,245 @@
 #define THIS_FILE   "transport_udp_test.c"
 
 
+/*
+ * UDP transport with several pending reads and batch receive.
+ */
+static int transport_udp_batch_test(void)
+{
+    pjsip_udp_transport_cfg cfg;
+    pjsip_transport *udp_tp;
+    pj_str_t s;
+    pj_status_t status;
+    int rtt, pkt_lost;
+
+    PJ_LOG(3,(THIS_FILE, "   batch receive test"));
+
+    pjsip_udp_transport_cfg_default(&cfg, pj_AF_INET());
+    pj_sockaddr_init(pj_AF_INET(), &cfg.bind_addr, pj_cstr(&s, "127.0.0.1"),
+		     TEST_UDP_PORT);
+    cfg.async_cnt = 2;
+    cfg.recv_batch = 8;
+
+    status = pjsip_udp_transport_start2(endpt, &cfg, &udp_tp);
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: unable to start UDP transport", status);
+	return -100;
+    }
+
+    if (pj_atomic_get(udp_tp->ref_cnt) != 1)
+	return -110;
+
+    status = transport_send_recv_test(PJSIP_TRANSPORT_UDP, udp_tp,
+				      "sip:alice@127.0.0.1:"TEST_UDP_PORT_STR,
+				      &rtt);
+    if (status != 0)
+	return status;
+
+    status = transport_rt_test(PJSIP_TRANSPORT_UDP, udp_tp,
+			       "sip:alice@127.0.0.1:"TEST_UDP_PORT_STR,
+			       &pkt_lost);
+    if (status != 0)
+	return status;
+
+    if (pkt_lost != 0)
+	PJ_LOG(3,(THIS_FILE, "   note: %d packet(s) was lost", pkt_lost));
+
+    if (pj_atomic_get(udp_tp->ref_cnt) != 1)
+	return -120;
+
+    pjsip_transport_dec_ref(udp_tp);
+    status = pjsip_transport_destroy(udp_tp);
+    if (status != PJ_SUCCESS)
+	return -130;
+
+    flush_events(500);
+
+    return 0;
+}
+
+
+/*
+ * UDP transport with several SO_REUSEPORT sockets. Requests are sent from
+ * several client sockets, so that they are spread among the sockets, and
+ * they must all be received by the same transport.
+ */
+#define RP_CALL_ID  "ReusePort-Test"
+
+static pjsip_transport *rp_tp;
+static int rp_rx_cnt;
+
+static pj_bool_t rp_on_rx_request(pjsip_rx_data *rdata)
+{
+    if (pj_strcmp2(&rdata->msg_info.cid->id, RP_CALL_ID) == 0) {
+	if (rdata->tp_info.transport == rp_tp)
+	    ++rp_rx_cnt;
+	return PJ_TRUE;
+    }
+    return PJ_FALSE;
+}
+
+static pjsip_module rp_module = 
+{
+    NULL, NULL,				/* prev and next	*/
+    { "ReusePort-Test", 14},		/* Name.		*/
+    -1,					/* Id			*/
+    PJSIP_MOD_PRIORITY_TSX_LAYER-1,	/* Priority		*/
+    NULL,				/* load()		*/
+    NULL,				/* start()		*/
+    NULL,				/* stop()		*/
+    NULL,				/* unload()		*/
+    &rp_on_rx_request,			/* on_rx_request()	*/
+    NULL,				/* on_rx_response()	*/
+    NULL,				/* on_tsx_state()	*/
+};
+
+static int transport_udp_reuseport_test(void)
+{
+    enum { CLIENT_CNT = 16 };
+    pjsip_udp_transport_cfg cfg;
+    pjsip_tpmgr *tpmgr = pjsip_endpt_get_tpmgr(endpt);
+    pj_sock_t client[CLIENT_CNT];
+    pj_sockaddr dst_addr, src_addr;
+    unsigned tp_cnt;
+    pj_str_t s;
+    pj_status_t status;
+    int i, rc = 0;
+
+    if (pj_SO_REUSEPORT() == 0xFFFF) {
+	PJ_LOG(3,(THIS_FILE, "   SO_REUSEPORT is not supported, skipping "
+		  "SO_REUSEPORT test"));
+	return 0;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "   SO_REUSEPORT test"));
+
+    /* Spread the sockets to two event loops. The loops are created for
+     * this test only, and then stay in the endpoint, where flush_events()
+     * polls them.
+     */
+    if (pjsip_endpt_get_loop_count(endpt) == 1) {
+	status = pjsip_endpt_create_loops(endpt, 2);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   Error: unable to create event loops", status);
+	    return -190;
+	}
+    }
+
+    tp_cnt = pjsip_tpmgr_get_transport_count(tpmgr);
+
+    pjsip_udp_transport_cfg_default(&cfg, pj_AF_INET());
+    pj_sockaddr_init(pj_AF_INET(), &cfg.bind_addr, pj_cstr(&s, "127.0.0.1"),
+		     TEST_UDP_PORT);
+    cfg.async_cnt = 2;
+    cfg.sock_cnt = 4;
+
+    status = pjsip_udp_transport_start2(endpt, &cfg, &rp_tp);
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: unable to start UDP transport", status);
+	return -200;
+    }
+
+    /* The sockets must be registered as one transport */
+    if (pjsip_tpmgr_get_transport_count(tpmgr) != tp_cnt + 1) {
+	rc = -210;
+	goto on_return;
+    }
+
+    status = pjsip_endpt_register_module(endpt, &rp_module);
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: unable to register module", status);
+	rc = -220;
+	goto on_return;
+    }
+
+    rp_rx_cnt = 0;
+    pj_sockaddr_cp(&dst_addr, &cfg.bind_addr);
+    pj_sockaddr_init(pj_AF_INET(), &src_addr, &s, 0);
+
+    for (i=0; i<CLIENT_CNT; ++i) {
+	char msg[512];
+	pj_ssize_t len;
+
+	client[i] = PJ_INVALID_SOCKET;
+	status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &client[i]);
+	if (status == PJ_SUCCESS)
+	    status = pj_sock_bind(client[i], &src_addr,
+				  pj_sockaddr_get_len(&src_addr));
+	if (status != PJ_SUCCESS) {
+	    app_perror("   Error: unable to create client socket", status);
+	    rc = -230;
+	    ++i;
+	    break;
+	}
+
+	len = pj_ansi_snprintf(msg, sizeof(msg),
+			       "MESSAGE sip:alice@127.0.0.1 SIP/2.0\r\n"
+			       "Via: SIP/2.0/UDP 127.0.0.1;"
+			       "branch=z9hG4bKreuseport%d\r\n"
+			       "From: <sip:bob@127.0.0.1>;tag=%d\r\n"
+			       "To: <sip:alice@127.0.0.1>\r\n"
+			       "Call-ID: " RP_CALL_ID "\r\n"
+			       "CSeq: %d MESSAGE\r\n"
+			       "Max-Forwards: 70\r\n"
+			       "Content-Length: 0\r\n\r\n",
+			       i, i, i+1);
+	status = pj_sock_sendto(client[i], msg, &len, 0, &dst_addr,
+				pj_sockaddr_get_len(&dst_addr));
+	if (status != PJ_SUCCESS) {
+	    app_perror("   Error: unable to send request", status);
+	    rc = -240;
+	    ++i;
+	    break;
+	}
+    }
+
+    /* Some of the sockets are in the second event loop, which must get
+     * its share of the requests.
+     */
+    if (rc == 0) {
+	unsigned j, cnt, total = 0;
+
+	for (j=0; j<100 && total == 0; ++j) {
+	    pj_time_val timeout = {0, 10};
+	    if (pjsip_endpt_handle_loop_events(endpt, 1, &timeout,
+					       &cnt) == PJ_SUCCESS)
+	    {
+		total += cnt;
+	    }
+	}
+	if (total == 0) {
+	    PJ_LOG(3,(THIS_FILE, "   error: no request in second loop"));
+	    rc = -245;
+	}
+    }
+
+    flush_events(500);
+
+    while (i-- > 0) {
+	if (client[i] != PJ_INVALID_SOCKET)
+	    pj_sock_close(client[i]);
+    }
+
+    if (rc == 0 && rp_rx_cnt != CLIENT_CNT) {
+	PJ_LOG(3,(THIS_FILE, "   error: received %d of %d requests",
+		  rp_rx_cnt, CLIENT_CNT));
+	rc = -250;
+    }
+
+    pjsip_endpt_unregister_module(endpt, &rp_module);
+
+on_return:
+    pjsip_transport_dec_ref(rp_tp);
+    status = pjsip_transport_destroy(rp_tp);
+    if (status != PJ_SUCCESS && rc == 0)
+	rc = -260;
+
+    flush_events(500);
+
+    return rc;
+}
+
+
 /*
  * UDP transport test.
  */
@@ -123,6 +362,14 @@ int transport_udp_test(void)
     PJ_LOG(3,(THIS_FILE, "   Flushing events, 1 second..."));
     flush_events(1000);
 
+    status = transport_udp_batch_test();
+    if (status != 0)
+	return status;
+
+    status = transport_udp_reuseport_test();
+    if (status != 0)
+	return status;
+
     /* Done */
     return 0;
 }
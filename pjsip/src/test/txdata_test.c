@@ -625,6 +625,418 @@ static int txdata_test_uri_params(void)
 }
 
 
+/*
+ * Check that the print buffer contains the printed message.
+ */
+static int check_tx_buf(pjsip_tx_data *tdata, char *buf, pj_size_t size)
+{
+    pj_ssize_t len;
+
+    len = pjsip_msg_print(tdata->msg, buf, size);
+    if (len < 0)
+	return -1;
+    if (tdata->buf.cur - tdata->buf.start != len ||
+	tdata->buf.end - tdata->buf.start < len ||
+	pj_memcmp(tdata->buf.start, buf, len) != 0 ||
+	*tdata->buf.cur != '\0')
+    {
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * This tests the print buffer of transmit data, which size follows the
+ * size of the printed message, and the reuse of transmit data.
+ */
+static int tx_buf_test(void)
+{
+    const pj_str_t hname = { "X-Filler", 8 };
+    pj_str_t target, from, to, hvalue;
+    pjsip_tx_data *tdata;
+    pjsip_hdr *hdr;
+    char *buf;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "   print buffer test"));
+
+    target = pj_str("sip:bob@example.com");
+    from = pj_str("<sip:alice@example.com>");
+    to = pj_str("<sip:bob@example.com>");
+
+    status = pjsip_endpt_create_request(endpt, &pjsip_options_method,
+					&target, &from, &to, NULL, NULL, -1,
+					NULL, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create request", status);
+	return -500;
+    }
+
+    buf = (char*) pj_pool_alloc(tdata->pool, PJSIP_MAX_PKT_LEN);
+
+    /* Small message */
+    status = pjsip_tx_data_encode(tdata);
+    if (status != PJ_SUCCESS || check_tx_buf(tdata, buf, PJSIP_MAX_PKT_LEN)) {
+	rc = -510;
+	goto on_return;
+    }
+#if PJSIP_HAS_SLAB_ALLOC && PJSIP_TX_BUF_MIN_SIZE > 0
+    if (tdata->buf.end - tdata->buf.start >= PJSIP_MAX_PKT_LEN / 2) {
+	PJ_LOG(3,(THIS_FILE, "   error: print buffer of %d bytes is too "
+			     "large for %d bytes message",
+			     (int)(tdata->buf.end - tdata->buf.start),
+			     (int)(tdata->buf.cur - tdata->buf.start)));
+	rc = -520;
+	goto on_return;
+    }
+#endif
+
+    /* Reprint larger message */
+    hvalue.slen = PJSIP_MAX_PKT_LEN / 2;
+    hvalue.ptr = (char*) pj_pool_alloc(tdata->pool, hvalue.slen);
+    pj_memset(hvalue.ptr, 'x', hvalue.slen);
+    hdr = (pjsip_hdr*) pjsip_generic_string_hdr_create(tdata->pool, &hname,
+						       &hvalue);
+    pjsip_msg_add_hdr(tdata->msg, hdr);
+    pjsip_tx_data_invalidate_msg(tdata);
+
+    status = pjsip_tx_data_encode(tdata);
+    if (status != PJ_SUCCESS || check_tx_buf(tdata, buf, PJSIP_MAX_PKT_LEN)) {
+	rc = -530;
+	goto on_return;
+    }
+
+    /* Reprint smaller message */
+    pj_list_erase(hdr);
+    pjsip_tx_data_invalidate_msg(tdata);
+
+    status = pjsip_tx_data_encode(tdata);
+    if (status != PJ_SUCCESS || check_tx_buf(tdata, buf, PJSIP_MAX_PKT_LEN)) {
+	rc = -540;
+	goto on_return;
+    }
+
+    /* Message too large */
+    pjsip_msg_add_hdr(tdata->msg, hdr);
+    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)
+		      pjsip_hdr_clone(tdata->pool, hdr));
+    pjsip_tx_data_invalidate_msg(tdata);
+
+    status = pjsip_tx_data_encode(tdata);
+    if (status != PJSIP_EMSGTOOLONG || pjsip_tx_data_is_valid(tdata)) {
+	rc = -550;
+	goto on_return;
+    }
+
+    /* Transmit data must be blank when it is reused */
+    pjsip_tx_data_dec_ref(tdata);
+    status = pjsip_endpt_create_tdata(endpt, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create transmit data", status);
+	return -560;
+    }
+    if (tdata->msg || tdata->buf.start || pjsip_tx_data_is_valid(tdata) ||
+	pj_atomic_get(tdata->ref_cnt) != 0)
+    {
+	rc = -570;
+    }
+    pjsip_tx_data_add_ref(tdata);
+
+on_return:
+    pjsip_tx_data_dec_ref(tdata);
+    return rc;
+}
+
+
+/*
+ * Parse the packet into rdata, as if it was received by transport.
+ */
+static pjsip_msg *splice_parse_rdata(pj_pool_t *pool, const char *pkt,
+				     pjsip_rx_data *rdata)
+{
+    pj_str_t buf;
+
+    pj_strdup2_with_null(pool, &buf, pkt);
+
+    pj_bzero(rdata, sizeof(*rdata));
+    rdata->tp_info.pool = pool;
+    rdata->msg_info.msg_buf = buf.ptr;
+    rdata->msg_info.len = (int)buf.slen;
+
+    return pjsip_parse_rdata(buf.ptr, buf.slen, rdata);
+}
+
+/*
+ * Check that the Via headers of the message have the specified branches.
+ */
+static int splice_check_via(const pjsip_msg *msg, const char *branch[],
+			    unsigned cnt)
+{
+    const pjsip_via_hdr *via = NULL;
+    unsigned i;
+
+    for (i=0; i<cnt; ++i) {
+	via = (const pjsip_via_hdr*)
+	      pjsip_msg_find_hdr(msg, PJSIP_H_VIA, via ? via->next : NULL);
+	if (!via || pj_strcmp2(&via->branch_param, branch[i]) != 0)
+	    return -1;
+    }
+    if (pjsip_msg_find_hdr(msg, PJSIP_H_VIA, via ? via->next : NULL))
+	return -1;
+
+    return 0;
+}
+
+/*
+ * Check the Content-Length of the message, which must appear once.
+ */
+static int splice_check_clen(const pjsip_msg *msg, int clen)
+{
+    const pjsip_clen_hdr *hclen;
+
+    hclen = (const pjsip_clen_hdr*)
+	    pjsip_msg_find_hdr(msg, PJSIP_H_CONTENT_LENGTH, NULL);
+    if (!hclen || hclen->len != clen ||
+	pjsip_msg_find_hdr(msg, PJSIP_H_CONTENT_LENGTH, hclen->next))
+    {
+	return -1;
+    }
+    if (clen && (!msg->body || msg->body->len != (unsigned)clen))
+	return -1;
+
+    return 0;
+}
+
+/*
+ * This tests splice forwarding of request and response, by parsing the
+ * forwarded message.
+ */
+static int splice_fwd_test(void)
+{
+    static const char *req_pkt =
+	"INVITE sip:bob@example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK-1111, "
+	     "SIP/2.0/UDP 10.0.0.2;branch=z9hG4bK-2222\r\n"
+	"v: SIP/2.0/TCP 10.0.0.3;branch=z9hG4bK-3333\r\n"
+	"Max-Forwards: 10\r\n"
+	"Route: <sip:proxy.example.com;lr>, <sip:next.example.com;lr>\r\n"
+	"From: <sip:alice@example.com>;tag=1234\r\n"
+	"To: <sip:bob@example.com>\r\n"
+	"Call-ID: splice-test\r\n"
+	"CSeq: 1 INVITE\r\n"
+	"X-Folded: one,\r\n two\r\n"
+	"Content-Type: text/plain\r\n"
+	"Content-Length: 5\r\n"
+	"\r\n"
+	"hello";
+    static const char *res_pkt =
+	"SIP/2.0 200 OK\r\n"
+	"Via: SIP/2.0/UDP proxy.example.com;branch=z9hG4bK-splice, "
+	     "SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK-1111, "
+	     "SIP/2.0/UDP 10.0.0.2;branch=z9hG4bK-2222\r\n"
+	"v: SIP/2.0/TCP 10.0.0.3;branch=z9hG4bK-3333\r\n"
+	"From: <sip:alice@example.com>;tag=1234\r\n"
+	"To: <sip:bob@example.com>;tag=5678\r\n"
+	"Call-ID: splice-test\r\n"
+	"CSeq: 1 INVITE\r\n"
+	"\r\n";
+    /* Datagram with trailing bytes after the body */
+    static const char *trail_pkt =
+	"MESSAGE sip:bob@example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK-1111\r\n"
+	"From: <sip:alice@example.com>;tag=1234\r\n"
+	"To: <sip:bob@example.com>\r\n"
+	"Call-ID: splice-test\r\n"
+	"CSeq: 2 MESSAGE\r\n"
+	"Content-Type: text/plain\r\n"
+	"Content-Length: 5\r\n"
+	"\r\n"
+	"hello"
+	"OPTIONS sip:carol@example.com SIP/2.0\r\n\r\n";
+    const char *req_branch[] = { "z9hG4bK-splice", "z9hG4bK-1111",
+				 "z9hG4bK-2222", "z9hG4bK-3333" };
+    const char *res_branch[] = { "z9hG4bK-1111", "z9hG4bK-2222",
+				 "z9hG4bK-3333" };
+    pj_str_t branch = pj_str("z9hG4bK-splice");
+    pj_str_t folded = pj_str("X-Folded: one,\r\n two\r\n");
+    pj_str_t trail = pj_str("OPTIONS");
+    pj_pool_t *pool;
+    pjsip_rx_data rdata;
+    pjsip_tx_data *tdata;
+    pjsip_via_hdr *via;
+    pjsip_msg *msg;
+    const pjsip_max_fwd_hdr *max_fwd;
+    const pjsip_hdr *route;
+    pj_str_t printed, out;
+    unsigned route_cnt;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "   splice forwarding test"));
+
+    pool = pjsip_endpt_create_pool(endpt, "splice", 4000, 4000);
+
+    /* Request */
+    if (!splice_parse_rdata(pool, req_pkt, &rdata)) {
+	rc = -600;
+	goto on_return;
+    }
+
+    status = pjsip_endpt_create_request_splice(endpt, &rdata, NULL, &branch,
+					       0, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to splice request", status);
+	rc = -610;
+	goto on_return;
+    }
+
+    /* Fill in our Via, as would be done by the transport layer */
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(tdata->msg, PJSIP_H_VIA, NULL);
+    via->transport = pj_str("UDP");
+    via->sent_by.host = pj_str("proxy.example.com");
+
+    status = pjsip_tx_data_encode(tdata);
+    if (status != PJ_SUCCESS) {
+	pjsip_tx_data_dec_ref(tdata);
+	rc = -620;
+	goto on_return;
+    }
+
+    pj_strset3(&printed, tdata->buf.start, tdata->buf.cur);
+    pj_strdup_with_null(pool, &out, &printed);
+    pjsip_tx_data_dec_ref(tdata);
+
+    /* Unmodified headers are copied verbatim */
+    if (pj_strstr(&out, &folded) == NULL) {
+	rc = -630;
+	goto on_return;
+    }
+
+    msg = pjsip_parse_msg(pool, out.ptr, out.slen, NULL);
+    if (!msg || msg->type != PJSIP_REQUEST_MSG) {
+	rc = -640;
+	goto on_return;
+    }
+
+    if (splice_check_via(msg, req_branch, PJ_ARRAY_SIZE(req_branch))) {
+	rc = -650;
+	goto on_return;
+    }
+
+    max_fwd = (const pjsip_max_fwd_hdr*)
+	      pjsip_msg_find_hdr(msg, PJSIP_H_MAX_FORWARDS, NULL);
+    if (!max_fwd || max_fwd->ivalue != 9 ||
+	pjsip_msg_find_hdr(msg, PJSIP_H_MAX_FORWARDS, max_fwd->next))
+    {
+	rc = -660;
+	goto on_return;
+    }
+
+    route_cnt = 0;
+    route = NULL;
+    while ((route=(const pjsip_hdr*)
+		  pjsip_msg_find_hdr(msg, PJSIP_H_ROUTE,
+				     route ? route->next : NULL)) != NULL)
+    {
+	++route_cnt;
+    }
+    if (route_cnt != 2) {
+	rc = -670;
+	goto on_return;
+    }
+
+    if (splice_check_clen(msg, 5) ||
+	pj_memcmp(msg->body->data, "hello", 5) != 0)
+    {
+	rc = -680;
+	goto on_return;
+    }
+
+    /* Only the body declared by Content-Length is forwarded */
+    if (!splice_parse_rdata(pool, trail_pkt, &rdata)) {
+	rc = -682;
+	goto on_return;
+    }
+
+    status = pjsip_endpt_create_request_splice(endpt, &rdata, NULL, &branch,
+					       0, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to splice request", status);
+	rc = -684;
+	goto on_return;
+    }
+
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(tdata->msg, PJSIP_H_VIA, NULL);
+    via->transport = pj_str("UDP");
+    via->sent_by.host = pj_str("proxy.example.com");
+
+    status = pjsip_tx_data_encode(tdata);
+    if (status != PJ_SUCCESS) {
+	pjsip_tx_data_dec_ref(tdata);
+	rc = -686;
+	goto on_return;
+    }
+
+    pj_strset3(&printed, tdata->buf.start, tdata->buf.cur);
+    pj_strdup_with_null(pool, &out, &printed);
+    pjsip_tx_data_dec_ref(tdata);
+
+    msg = pjsip_parse_msg(pool, out.ptr, out.slen, NULL);
+    if (!msg || pj_strstr(&out, &trail) != NULL || splice_check_clen(msg, 5)) {
+	rc = -688;
+	goto on_return;
+    }
+
+    /* Response */
+    if (!splice_parse_rdata(pool, res_pkt, &rdata)) {
+	rc = -700;
+	goto on_return;
+    }
+
+    status = pjsip_endpt_create_response_splice(endpt, &rdata, 0, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to splice response", status);
+	rc = -710;
+	goto on_return;
+    }
+
+    status = pjsip_tx_data_encode(tdata);
+    if (status != PJ_SUCCESS) {
+	pjsip_tx_data_dec_ref(tdata);
+	rc = -720;
+	goto on_return;
+    }
+
+    pj_strset3(&printed, tdata->buf.start, tdata->buf.cur);
+    pj_strdup_with_null(pool, &out, &printed);
+    pjsip_tx_data_dec_ref(tdata);
+
+    msg = pjsip_parse_msg(pool, out.ptr, out.slen, NULL);
+    if (!msg || msg->type != PJSIP_RESPONSE_MSG ||
+	msg->line.status.code != 200)
+    {
+	rc = -740;
+	goto on_return;
+    }
+
+    if (splice_check_via(msg, res_branch, PJ_ARRAY_SIZE(res_branch))) {
+	rc = -750;
+	goto on_return;
+    }
+
+    /* Content-Length is added since it's missing */
+    if (splice_check_clen(msg, 0)) {
+	rc = -780;
+	goto on_return;
+    }
+
+on_return:
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
+
 /*
  * create request benchmark
  */
@@ -796,6 +1208,14 @@ int txdata_test(void)
     if (status != 0)
 	return status;
 
+    status = tx_buf_test();
+    if (status != 0)
+	return status;
+
+    status = splice_fwd_test();
+    if (status != 0)
+	return status;
+
 
     /*
      * Benchmark create_request()